@@ -11,7 +11,7 @@ INSTALLDIR ?= $(DESTDIR)/usr/lib
 # Converts cr/lf to just lf
 DOS2UNIX = dos2unix
 
-LIBRARIES = -lstdc++
+LIBRARIES = -lstdc++ -lpthread
 
 MODULES = $(SRCS:.c=.o)
 MODULES := $(MODULES:.cpp=.o)
@@ -38,7 +38,7 @@ STATICLIB = lib$(TARGET).a
 SHAREDLIB = lib$(TARGET)-$(VER_MAJOR).$(VER_MINOR).so
 LIBNAME	= lib$(TARGET).so
 VERLIBNAME = $(LIBNAME).$(VER_MAJOR)
-HEADER = Source/FreeImage.h
+HEADER = Source/FreeImage.h Source/FreeImageView.h
 
 
 
@@ -50,7 +50,7 @@ dist: FreeImage
 	mkdir -p Dist
 	cp *.a Dist/
 	cp *.so Dist/
-	cp Source/FreeImage.h Dist/
+	cp $(HEADER) Dist/
 
 dos2unix:
 	@$(DOS2UNIX) $(SRCS) $(INCLS)
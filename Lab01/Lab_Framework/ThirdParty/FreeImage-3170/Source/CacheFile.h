@@ -26,39 +26,34 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FileMapping.h"
 
 // ----------------------------------------------------------
 
-static const int CACHE_SIZE = 32;
-static const int BLOCK_SIZE = (64 * 1024) - 8;
-
-// ----------------------------------------------------------
-
-#ifdef _WIN32
-#pragma pack(push, 1)
-#else
-#pragma pack(1)
-#endif // _WIN32
-
-struct Block {
-     unsigned nr;
-     unsigned next;
-     BYTE *data;
-};
-
-#ifdef _WIN32
-#pragma pack(pop)
-#else
-#pragma pack()
-#endif // _WIN32
+/// Size of a cache block
+static const int BLOCK_SIZE = 64 * 1024;
+/// Number of consecutive blocks mapped at once
+static const int WINDOW_BLOCKS = 16;
+/// Default number of bytes of the cache file mapped in memory
+static const unsigned CACHE_DEFAULT_BUDGET = 16 * 1024 * 1024;
 
 // ----------------------------------------------------------
 
+/**
+Block storage for the pages of a FIMULTIBITMAP.<br>
+Pages are stored as chains of fixed size blocks in a temporary file, which is
+memory-mapped by windows of WINDOW_BLOCKS blocks. At most 'budget' bytes are
+mapped at once, the least recently used window being unmapped first.
+When the cache is kept in memory, windows are allocated instead and never released.
+*/
 class CacheFile {
-	typedef std::list<Block *> PageCache;
-	typedef std::list<Block *>::iterator PageCacheIt;
-	typedef std::map<int, PageCacheIt> PageMap;
-	typedef std::map<int, PageCacheIt>::iterator PageMapIt;
+	/// A mapped (or allocated) window of blocks
+	struct Window {
+		BYTE *data;			//! first byte of the window
+		unsigned id;		//! window number in the cache file
+		int prev;			//! previous window in the LRU list (more recently used), -1 if none
+		int next;			//! next window in the LRU list (less recently used), -1 if none
+	};
 
 public :
 	CacheFile(const std::string filename, BOOL keep_in_memory);
@@ -71,22 +66,37 @@ public :
 	void deleteFile(int nr);
 
 private :
-	void cleanupMemCache();
 	int allocateBlock();
-	Block *lockBlock(int nr);
-	BOOL unlockBlock(int nr);
-	BOOL deleteBlock(int nr);
+	BYTE *getBlock(int nr);
+	int mapWindow(unsigned id);
+	void linkWindow(int slot);
+	void unlinkWindow(int slot);
+	void touchWindow(int slot);
 
 private :
-	FILE *m_file;
 	std::string m_filename;
-	std::list<int> m_free_pages;
-	PageCache m_page_cache_mem;
-	PageCache m_page_cache_disk;
-	PageMap m_page_map;
-	int m_page_count;
-	Block *m_current_block;
 	BOOL m_keep_in_memory;
+
+	/// next block of each block chain, 0 at the end of a chain
+	std::vector<unsigned> m_next;
+	/// released blocks, ready for reuse
+	std::vector<unsigned> m_free_blocks;
+
+	/// window slot of each window number, -1 if the window is not mapped
+	std::vector<int> m_window_slots;
+	/// mapped windows
+	std::vector<Window> m_windows;
+	/// file mappings backing the window slots (file cache only)
+	FileMapping *m_mappings;
+	/// maximum number of mapped windows (file cache only)
+	int m_max_windows;
+	/// most and least recently used windows
+	int m_lru_head;
+	int m_lru_tail;
+
+	// not copyable
+	CacheFile(const CacheFile&);
+	CacheFile& operator=(const CacheFile&);
 };
 
 #endif // CACHEFILE_H
@@ -0,0 +1,164 @@
+// ==========================================================
+// FastDeflate: whole buffer DEFLATE, ZLib and GZIP codec
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+/*
+FastDeflate compresses and decompresses buffers that are entirely in memory.
+It does not keep any state between calls and has no streaming interface, which
+lets both directions work on plain pointers instead of a sliding window.
+The streams it writes and reads are standard DEFLATE (RFC 1951), ZLib (RFC 1950)
+and GZIP (RFC 1952) streams, compatible with the bundled ZLib.
+
+The interface follows the one of libdeflate: a compressor or a decompressor is
+allocated once and may be used for any number of buffers, but by one thread at a time.
+*/
+
+#ifndef FASTDEFLATE_H
+#define FASTDEFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ----------------------------------------------------------
+//   Compression
+// ----------------------------------------------------------
+
+struct fastdeflate_compressor;
+
+/**
+Allocate a compressor.
+@param level Compression level, from 0 (stored blocks only) to 9 (smallest output)
+@return Returns the compressor, or NULL if the level is invalid or if there is not enough memory
+*/
+struct fastdeflate_compressor *fastdeflate_alloc_compressor(int level);
+
+/**
+Compress a buffer as a complete raw DEFLATE stream.
+@return Returns the size of the compressed data, or 0 if it did not fit in the output buffer
+*/
+size_t fastdeflate_deflate_compress(struct fastdeflate_compressor *compressor, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail);
+
+/**
+Compress a buffer as one piece of a raw DEFLATE stream.
+Matches may refer to the dict_nbytes bytes that precede 'in' in memory, which must
+be the data of the previous pieces (only the last 32 KB are used).
+A piece that is not final ends with an empty stored block (as a ZLib sync flush does),
+so that the pieces of a stream can be compressed independently then concatenated.
+@param dict_nbytes Number of bytes before 'in' that may be referenced
+@param final Nonzero for the last piece of the stream
+@return Returns the size of the compressed data, or 0 if it did not fit in the output buffer
+*/
+size_t fastdeflate_deflate_compress_chunk(struct fastdeflate_compressor *compressor, const void *in, size_t in_nbytes, size_t dict_nbytes, int final, void *out, size_t out_nbytes_avail);
+
+/**
+Compress a buffer as a ZLib stream
+@return Returns the size of the compressed data, or 0 if it did not fit in the output buffer
+*/
+size_t fastdeflate_zlib_compress(struct fastdeflate_compressor *compressor, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail);
+
+/**
+Compress a buffer as a GZIP stream
+@return Returns the size of the compressed data, or 0 if it did not fit in the output buffer
+*/
+size_t fastdeflate_gzip_compress(struct fastdeflate_compressor *compressor, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail);
+
+/**
+Worst case size of a raw DEFLATE stream (or of a piece of it) for in_nbytes bytes of input
+*/
+size_t fastdeflate_deflate_compress_bound(struct fastdeflate_compressor *compressor, size_t in_nbytes);
+
+/**
+Worst case size of a ZLib stream for in_nbytes bytes of input
+*/
+size_t fastdeflate_zlib_compress_bound(struct fastdeflate_compressor *compressor, size_t in_nbytes);
+
+/**
+Worst case size of a GZIP stream for in_nbytes bytes of input
+*/
+size_t fastdeflate_gzip_compress_bound(struct fastdeflate_compressor *compressor, size_t in_nbytes);
+
+void fastdeflate_free_compressor(struct fastdeflate_compressor *compressor);
+
+// ----------------------------------------------------------
+//   Decompression
+// ----------------------------------------------------------
+
+struct fastdeflate_decompressor;
+
+enum fastdeflate_result {
+	/// the stream was decoded
+	FASTDEFLATE_SUCCESS = 0,
+	/// the stream is invalid, truncated or its checksum does not match
+	FASTDEFLATE_BAD_DATA = 1,
+	/// the stream was decoded, but is shorter than the output buffer (when its exact size is expected)
+	FASTDEFLATE_SHORT_OUTPUT = 2,
+	/// the stream does not fit in the output buffer
+	FASTDEFLATE_INSUFFICIENT_SPACE = 3
+};
+
+/**
+Allocate a decompressor.
+@return Returns the decompressor, or NULL if there is not enough memory
+*/
+struct fastdeflate_decompressor *fastdeflate_alloc_decompressor(void);
+
+/**
+Decompress a raw DEFLATE stream.
+@param actual_in_nbytes_ret If not NULL, receives the size of the stream, which may be followed by other data
+@param actual_out_nbytes_ret If not NULL, receives the size of the decompressed data.
+If NULL, the decompressed data must fill the output buffer exactly.
+*/
+enum fastdeflate_result fastdeflate_deflate_decompress(struct fastdeflate_decompressor *decompressor, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail, size_t *actual_in_nbytes_ret, size_t *actual_out_nbytes_ret);
+
+/**
+Decompress a ZLib stream and check its Adler-32 checksum.
+Streams that need a preset dictionary are rejected.
+@param actual_out_nbytes_ret See fastdeflate_deflate_decompress
+*/
+enum fastdeflate_result fastdeflate_zlib_decompress(struct fastdeflate_decompressor *decompressor, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail, size_t *actual_out_nbytes_ret);
+
+/**
+Decompress a GZIP stream (its first member) and check its CRC-32 and size.
+@param actual_out_nbytes_ret See fastdeflate_deflate_decompress
+*/
+enum fastdeflate_result fastdeflate_gzip_decompress(struct fastdeflate_decompressor *decompressor, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail, size_t *actual_out_nbytes_ret);
+
+void fastdeflate_free_decompressor(struct fastdeflate_decompressor *decompressor);
+
+// ----------------------------------------------------------
+//   Checksums
+// ----------------------------------------------------------
+
+/**
+Update a running Adler-32 checksum, whose initial value is 1 (as with ZLib's adler32)
+*/
+uint32_t fastdeflate_adler32(uint32_t adler, const void *buffer, size_t len);
+
+/**
+Update a running CRC-32 checksum, whose initial value is 0 (as with ZLib's crc32)
+*/
+uint32_t fastdeflate_crc32(uint32_t crc, const void *buffer, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FASTDEFLATE_H
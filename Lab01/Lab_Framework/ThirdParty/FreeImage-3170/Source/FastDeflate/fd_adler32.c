@@ -0,0 +1,160 @@
+// ==========================================================
+// FastDeflate: Adler-32
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "fd_common.h"
+
+#ifdef FD_SSE2
+#include <emmintrin.h>
+#endif
+
+/// largest prime smaller than 65536
+#define ADLER_MOD	65521
+
+/// largest n such that 255 * n * (n + 1) / 2 + (n + 1) * (ADLER_MOD - 1) fits in 32 bits
+#define ADLER_NMAX	5552
+
+// ----------------------------------------------------------
+//   Portable implementation
+// ----------------------------------------------------------
+
+static void
+adler32_scalar(u32 *s1_ret, u32 *s2_ret, const u8 *p, size_t len) {
+	u32 s1 = *s1_ret;
+	u32 s2 = *s2_ret;
+
+	while(len > 0) {
+		size_t n = FD_MIN(len, (size_t)ADLER_NMAX);
+		len -= n;
+		while(n >= 4) {
+			s1 += p[0]; s2 += s1;
+			s1 += p[1]; s2 += s1;
+			s1 += p[2]; s2 += s1;
+			s1 += p[3]; s2 += s1;
+			p += 4;
+			n -= 4;
+		}
+		while(n--) {
+			s1 += *p++;
+			s2 += s1;
+		}
+		s1 %= ADLER_MOD;
+		s2 %= ADLER_MOD;
+	}
+
+	*s1_ret = s1;
+	*s2_ret = s2;
+}
+
+// ----------------------------------------------------------
+//   SSE2
+// ----------------------------------------------------------
+
+#ifdef FD_SSE2
+
+/**
+Process 32-byte blocks. Over a run of blocks, s2 receives 32 times the sum of the bytes
+of all the previous blocks, plus the bytes of each block weighted from 32 down to 1.
+The byte sums per position are kept on 16 bits and weighted with PMADDWD, which takes
+signed operands: a run is limited to 128 blocks so that a sum never exceeds 32767.
+*/
+static size_t
+adler32_sse2(u32 *s1_ret, u32 *s2_ret, const u8 *p, size_t len) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i weights_0 = _mm_set_epi16(25, 26, 27, 28, 29, 30, 31, 32);
+	const __m128i weights_1 = _mm_set_epi16(17, 18, 19, 20, 21, 22, 23, 24);
+	const __m128i weights_2 = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+	const __m128i weights_3 = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+	u32 s1 = *s1_ret;
+	u32 s2 = *s2_ret;
+	size_t done = 0;
+
+	while(len - done >= 32) {
+		size_t blocks = FD_MIN((len - done) / 32, (size_t)128);
+		const size_t n = blocks * 32;
+
+		__m128i v_s1 = zero;
+		__m128i v_s1_sums = zero;
+		__m128i v_bytes_0 = zero;
+		__m128i v_bytes_1 = zero;
+		__m128i v_bytes_2 = zero;
+		__m128i v_bytes_3 = zero;
+
+		do {
+			const __m128i d0 = _mm_loadu_si128((const __m128i *)p);
+			const __m128i d1 = _mm_loadu_si128((const __m128i *)(p + 16));
+
+			v_s1_sums = _mm_add_epi32(v_s1_sums, v_s1);
+			v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(d0, zero));
+			v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(d1, zero));
+			v_bytes_0 = _mm_add_epi16(v_bytes_0, _mm_unpacklo_epi8(d0, zero));
+			v_bytes_1 = _mm_add_epi16(v_bytes_1, _mm_unpackhi_epi8(d0, zero));
+			v_bytes_2 = _mm_add_epi16(v_bytes_2, _mm_unpacklo_epi8(d1, zero));
+			v_bytes_3 = _mm_add_epi16(v_bytes_3, _mm_unpackhi_epi8(d1, zero));
+			p += 32;
+		} while(--blocks);
+
+		__m128i v_s2 = _mm_slli_epi32(v_s1_sums, 5);
+		v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(v_bytes_0, weights_0));
+		v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(v_bytes_1, weights_1));
+		v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(v_bytes_2, weights_2));
+		v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(v_bytes_3, weights_3));
+
+		// horizontal sums, on 64 bits: a run adds less than 2^32 to s2 but the lanes are not reduced
+		u32 lanes[4];
+		u64 sum_s2 = (u64)s2 + (u64)s1 * n;
+		_mm_storeu_si128((__m128i *)lanes, v_s2);
+		sum_s2 += (u64)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		_mm_storeu_si128((__m128i *)lanes, v_s1);
+		s1 += lanes[0] + lanes[2];
+
+		s1 %= ADLER_MOD;
+		s2 = (u32)(sum_s2 % ADLER_MOD);
+		done += n;
+	}
+
+	*s1_ret = s1;
+	*s2_ret = s2;
+	return done;
+}
+
+#endif // FD_SSE2
+
+// ----------------------------------------------------------
+//   Public API
+// ----------------------------------------------------------
+
+uint32_t
+fastdeflate_adler32(uint32_t adler, const void *buffer, size_t len) {
+	const u8 *p = (const u8 *)buffer;
+	u32 s1 = adler & 0xFFFF;
+	u32 s2 = adler >> 16;
+
+	if(!buffer) {
+		return 1;
+	}
+
+#ifdef FD_SSE2
+	const size_t done = adler32_sse2(&s1, &s2, p, len);
+	p += done;
+	len -= done;
+#endif
+
+	adler32_scalar(&s1, &s2, p, len);
+
+	return (s2 << 16) | s1;
+}
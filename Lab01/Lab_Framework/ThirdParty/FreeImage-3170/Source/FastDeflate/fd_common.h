@@ -0,0 +1,237 @@
+// ==========================================================
+// FastDeflate: helpers shared by the codec sources
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FD_COMMON_H
+#define FD_COMMON_H
+
+#include "fastdeflate.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// ----------------------------------------------------------
+//   Types and compiler support
+// ----------------------------------------------------------
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#ifdef _MSC_VER
+#define FD_INLINE static __inline
+#else
+#define FD_INLINE static inline
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FD_LIKELY(expr)		__builtin_expect(!!(expr), 1)
+#define FD_UNLIKELY(expr)	__builtin_expect(!!(expr), 0)
+#else
+#define FD_LIKELY(expr)		(expr)
+#define FD_UNLIKELY(expr)	(expr)
+#endif
+
+#define FD_MIN(a, b)	(((a) < (b)) ? (a) : (b))
+#define FD_MAX(a, b)	(((a) > (b)) ? (a) : (b))
+
+// x86 and x86-64
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64) || defined(__i386__) || defined(_M_IX86)
+#define FD_X86
+#endif
+
+// SSE2 is part of the x86-64 baseline, 32-bit x86 builds must enable it explicitly
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FD_SSE2
+#endif
+
+// PCLMULQDQ is detected at runtime: the compiler must be able to target it on a per function basis
+
+#if defined(FD_X86) && defined(FD_SSE2)
+#if defined(_MSC_VER) && (_MSC_VER >= 1600)
+#define FD_PCLMUL
+#define FD_TARGET_PCLMUL
+#elif defined(__clang__)
+#if (__clang_major__ > 3) || ((__clang_major__ == 3) && (__clang_minor__ >= 8))
+#define FD_PCLMUL
+#define FD_TARGET_PCLMUL __attribute__((target("pclmul,sse2")))
+#endif
+#elif defined(__GNUC__)
+#if (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9))
+#define FD_PCLMUL
+#define FD_TARGET_PCLMUL __attribute__((target("pclmul,sse2")))
+#endif
+#endif
+#endif // FD_X86 && FD_SSE2
+
+// byte order, unaligned loads are only used on hosts that handle them well
+
+#if defined(FD_X86) || defined(__aarch64__) || defined(_M_ARM64) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+#define FD_LITTLE_ENDIAN
+#endif
+
+#if (defined(FD_X86) || defined(__aarch64__) || defined(_M_ARM64)) && defined(FD_LITTLE_ENDIAN)
+#define FD_FAST_UNALIGNED
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64) || defined(__aarch64__) || defined(_M_ARM64)
+#define FD_64BIT
+#endif
+
+// ----------------------------------------------------------
+//   Memory access
+// ----------------------------------------------------------
+
+FD_INLINE u16
+fd_load_le16(const u8 *p) {
+	return (u16)(p[0] | (p[1] << 8));
+}
+
+FD_INLINE u32
+fd_load_le32(const u8 *p) {
+#ifdef FD_LITTLE_ENDIAN
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+#else
+	return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+#endif
+}
+
+FD_INLINE u64
+fd_load_le64(const u8 *p) {
+#ifdef FD_LITTLE_ENDIAN
+	u64 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+#else
+	return (u64)fd_load_le32(p) | ((u64)fd_load_le32(p + 4) << 32);
+#endif
+}
+
+FD_INLINE void
+fd_store_le16(u8 *p, u16 v) {
+	p[0] = (u8)v;
+	p[1] = (u8)(v >> 8);
+}
+
+FD_INLINE void
+fd_store_le32(u8 *p, u32 v) {
+#ifdef FD_LITTLE_ENDIAN
+	memcpy(p, &v, sizeof(v));
+#else
+	p[0] = (u8)v;
+	p[1] = (u8)(v >> 8);
+	p[2] = (u8)(v >> 16);
+	p[3] = (u8)(v >> 24);
+#endif
+}
+
+FD_INLINE void
+fd_store_le64(u8 *p, u64 v) {
+#ifdef FD_LITTLE_ENDIAN
+	memcpy(p, &v, sizeof(v));
+#else
+	fd_store_le32(p, (u32)v);
+	fd_store_le32(p + 4, (u32)(v >> 32));
+#endif
+}
+
+FD_INLINE void
+fd_store_be32(u8 *p, u32 v) {
+	p[0] = (u8)(v >> 24);
+	p[1] = (u8)(v >> 16);
+	p[2] = (u8)(v >> 8);
+	p[3] = (u8)v;
+}
+
+FD_INLINE u32
+fd_load_be32(const u8 *p) {
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+}
+
+/**
+Index of the lowest set bit of a non-zero value
+*/
+FD_INLINE unsigned
+fd_ctz64(u64 v) {
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned)__builtin_ctzll(v);
+#elif defined(_MSC_VER) && defined(FD_64BIT)
+	unsigned long index;
+	_BitScanForward64(&index, v);
+	return (unsigned)index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if(_BitScanForward(&index, (u32)v)) {
+		return (unsigned)index;
+	}
+	_BitScanForward(&index, (u32)(v >> 32));
+	return (unsigned)index + 32;
+#else
+	unsigned index = 0;
+	while(!(v & 1)) {
+		v >>= 1;
+		index++;
+	}
+	return index;
+#endif
+}
+
+// ----------------------------------------------------------
+//   DEFLATE format (RFC 1951)
+// ----------------------------------------------------------
+
+#define FD_NUM_LITLEN_SYMS		288
+#define FD_NUM_OFFSET_SYMS		32
+#define FD_NUM_PRECODE_SYMS		19
+#define FD_END_OF_BLOCK			256
+
+#define FD_MIN_MATCH_LEN		3
+#define FD_MAX_MATCH_LEN		258
+#define FD_WINDOW_SIZE			32768
+
+#define FD_MAX_LITLEN_CODEWORD_LEN	15
+#define FD_MAX_OFFSET_CODEWORD_LEN	15
+#define FD_MAX_PRECODE_CODEWORD_LEN	7
+
+#define FD_BLOCKTYPE_STORED		0
+#define FD_BLOCKTYPE_STATIC		1
+#define FD_BLOCKTYPE_DYNAMIC	2
+
+/// Order in which the precode lengths are stored
+extern const u8 fd_precode_permutation[FD_NUM_PRECODE_SYMS];
+
+/// Match length slots: base length and number of extra bits of symbols 257 to 285
+extern const u16 fd_length_base[29];
+extern const u8 fd_length_extra_bits[29];
+
+/// Match offset slots: base offset and number of extra bits of symbols 0 to 29
+extern const u16 fd_offset_base[30];
+extern const u8 fd_offset_extra_bits[30];
+
+/// Compression level of a compressor, for the ZLib and GZIP headers
+int fd_compressor_level(const struct fastdeflate_compressor *c);
+
+#endif // FD_COMMON_H
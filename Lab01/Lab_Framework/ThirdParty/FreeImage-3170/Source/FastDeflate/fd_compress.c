@@ -0,0 +1,957 @@
+// ==========================================================
+// FastDeflate: DEFLATE compression
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "fd_common.h"
+
+/*
+The parsing follows ZLib: hash chains over the previous 32 KB, greedy matching for
+levels 1 to 3 and lazy matching for levels 4 to 9, with ZLib's search limits.
+Since the whole input is in memory, positions are plain offsets in the input (there is
+no window to slide), and matches are measured 8 bytes at a time.
+A block ends after 16383 literals and matches, as with ZLib's default memory level, and
+is written with whichever of a dynamic Huffman code, the static code or stored blocks
+takes the fewest bits.
+*/
+
+#define HASH_BITS		15
+#define HASH_SIZE		(1U << HASH_BITS)
+#define WINDOW_MASK		(FD_WINDOW_SIZE - 1)
+
+/// empty hash chain: seen from any position, it is more than a window away
+#define NO_POS			((u32)0 - (FD_WINDOW_SIZE + 1))
+
+/// positions must stay far enough from 2^32 for NO_POS to work
+#define MAX_POSITIONS	0xFFFF0000U
+
+/// literals and matches per block
+#define MAX_BLOCK_ITEMS	16383
+
+/// matches of 3 bytes farther than this are not worth their bits (lazy levels)
+#define TOO_FAR			4096
+
+// ----------------------------------------------------------
+//   Compressor state
+// ----------------------------------------------------------
+
+/**
+Search limits of a level, as in ZLib's configuration_table
+*/
+typedef struct {
+	/// reduce the search depth when the previous match is at least this long (lazy levels)
+	u16 good_len;
+	/// do not look for a better match after a match this long (lazy levels),
+	/// or index the positions of matches up to this length only (greedy levels)
+	u16 lazy_len;
+	/// stop the search at a match this long
+	u16 nice_len;
+	/// maximum number of hash chain entries to compare
+	u16 max_chain;
+} LevelParams;
+
+static const LevelParams s_level_params[10] = {
+	{ 0, 0, 0, 0 },
+	{ 4, 4, 8, 4 },
+	{ 4, 5, 16, 8 },
+	{ 4, 6, 32, 32 },
+	{ 4, 4, 16, 16 },
+	{ 8, 16, 32, 32 },
+	{ 8, 16, 128, 128 },
+	{ 8, 32, 128, 256 },
+	{ 32, 128, 258, 1024 },
+	{ 32, 258, 258, 4096 }
+};
+
+/**
+A run of literals followed by a match (the last sequence of a block has no match)
+*/
+typedef struct {
+	u32 litrunlen;
+	u16 length;
+	u16 offset;
+} Sequence;
+
+/**
+Output bit stream: bits are added at the top of a 64-bit buffer, and written a word at a time
+*/
+typedef struct {
+	u64 bitbuf;
+	unsigned bitcount;
+	u8 *next;
+	u8 *end;
+	int overflow;
+} BitStream;
+
+struct fastdeflate_compressor {
+	int level;
+	LevelParams params;
+
+	/// most recent position for each hash value
+	u32 head[HASH_SIZE];
+	/// previous position with the same hash, for the positions of the last 32 KB
+	u32 prev[FD_WINDOW_SIZE];
+
+	/// current block
+	Sequence sequences[MAX_BLOCK_ITEMS + 1];
+	u32 litlen_freqs[FD_NUM_LITLEN_SYMS];
+	u32 offset_freqs[FD_NUM_OFFSET_SYMS];
+
+	/// dynamic codes of the current block
+	u8 litlen_lens[FD_NUM_LITLEN_SYMS];
+	u32 litlen_codewords[FD_NUM_LITLEN_SYMS];
+	u8 offset_lens[FD_NUM_OFFSET_SYMS];
+	u32 offset_codewords[FD_NUM_OFFSET_SYMS];
+	u8 precode_lens[FD_NUM_PRECODE_SYMS];
+	u32 precode_codewords[FD_NUM_PRECODE_SYMS];
+	u32 precode_freqs[FD_NUM_PRECODE_SYMS];
+	/// run-length encoded codeword lengths: precode symbol in bits 0-4, extra bits above
+	u32 precode_items[FD_NUM_LITLEN_SYMS + FD_NUM_OFFSET_SYMS];
+	unsigned num_precode_items;
+	unsigned num_litlen_syms;
+	unsigned num_offset_syms;
+	unsigned num_explicit_lens;
+
+	/// static codes
+	u8 static_litlen_lens[FD_NUM_LITLEN_SYMS];
+	u32 static_litlen_codewords[FD_NUM_LITLEN_SYMS];
+	u8 static_offset_lens[FD_NUM_OFFSET_SYMS];
+	u32 static_offset_codewords[FD_NUM_OFFSET_SYMS];
+
+	/// slot of each match length, and of each offset (see offset_slot)
+	u8 length_slot[FD_MAX_MATCH_LEN + 1];
+	u8 offset_slot_table[512];
+};
+
+FD_INLINE unsigned
+offset_slot(const struct fastdeflate_compressor *c, unsigned offset) {
+	return (offset <= 256) ? c->offset_slot_table[offset - 1] : c->offset_slot_table[256 + ((offset - 1) >> 7)];
+}
+
+// ----------------------------------------------------------
+//   Huffman codes
+// ----------------------------------------------------------
+
+FD_INLINE u32
+reverse_codeword(u32 codeword, unsigned len) {
+	u32 reversed = 0;
+	while(len--) {
+		reversed = (reversed << 1) | (codeword & 1);
+		codeword >>= 1;
+	}
+	return reversed;
+}
+
+static int
+compare_u32(const void *a, const void *b) {
+	const u32 x = *(const u32 *)a;
+	const u32 y = *(const u32 *)b;
+	return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+/**
+Assign the canonical codewords of a code, bit-reversed since DEFLATE sends codewords from their first bit
+*/
+static void
+make_codewords(unsigned num_syms, const u8 *lens, u32 *codewords) {
+	unsigned count[FD_MAX_LITLEN_CODEWORD_LEN + 1];
+	u32 next_codeword[FD_MAX_LITLEN_CODEWORD_LEN + 2];
+	unsigned sym, len;
+
+	memset(count, 0, sizeof(count));
+	for(sym = 0; sym < num_syms; sym++) {
+		count[lens[sym]]++;
+	}
+	count[0] = 0;
+	next_codeword[1] = 0;
+	for(len = 1; len <= FD_MAX_LITLEN_CODEWORD_LEN; len++) {
+		next_codeword[len + 1] = (next_codeword[len] + count[len]) << 1;
+	}
+	for(sym = 0; sym < num_syms; sym++) {
+		len = lens[sym];
+		codewords[sym] = len ? reverse_codeword(next_codeword[len]++, len) : 0;
+	}
+}
+
+/**
+Build a length-limited Huffman code for the given symbol frequencies.
+The tree is built with the two-queue method over the symbols sorted by frequency,
+then the lengths over max_len are folded back as in the JPEG standard (annex K.3),
+which keeps the code complete. As ZLib does, a code always has at least two codewords.
+*/
+static void
+make_huffman_code(unsigned num_syms, unsigned max_len, const u32 *freqs, u8 *lens, u32 *codewords) {
+	u32 keys[FD_NUM_LITLEN_SYMS];
+	u32 node_freqs[2 * FD_NUM_LITLEN_SYMS];
+	u16 parents[2 * FD_NUM_LITLEN_SYMS];
+	u16 depths[2 * FD_NUM_LITLEN_SYMS];
+	unsigned len_counts[2 * FD_NUM_LITLEN_SYMS];
+	unsigned num_used = 0;
+	unsigned sym, i;
+
+	memset(lens, 0, num_syms);
+
+	// sort the used symbols by frequency, then by value
+	for(sym = 0; sym < num_syms; sym++) {
+		if(freqs[sym]) {
+			keys[num_used++] = (FD_MIN(freqs[sym], 0x7FFFFFU) << 9) | sym;
+		}
+	}
+
+	if(num_used < 2) {
+		// one codeword would not be a complete code: pair the used symbol with another one
+		const unsigned used = num_used ? (keys[0] & 0x1FF) : 0;
+		lens[used] = 1;
+		lens[(used == 0) ? 1 : 0] = 1;
+		make_codewords(num_syms, lens, codewords);
+		return;
+	}
+
+	qsort(keys, num_used, sizeof(u32), compare_u32);
+
+	// two-queue construction: leaves 0 to num_used - 1, then internal nodes in creation order
+	unsigned next_leaf = 0;
+	unsigned next_node = num_used;
+	unsigned new_node = num_used;
+	for(i = 0; i < num_used; i++) {
+		node_freqs[i] = keys[i] >> 9;
+	}
+	while(new_node < 2 * num_used - 1) {
+		unsigned picked[2];
+		unsigned k;
+		for(k = 0; k < 2; k++) {
+			if((next_leaf < num_used) && ((next_node == new_node) || (node_freqs[next_leaf] <= node_freqs[next_node]))) {
+				picked[k] = next_leaf++;
+			} else {
+				picked[k] = next_node++;
+			}
+		}
+		node_freqs[new_node] = node_freqs[picked[0]] + node_freqs[picked[1]];
+		parents[picked[0]] = (u16)new_node;
+		parents[picked[1]] = (u16)new_node;
+		new_node++;
+	}
+
+	// depths, from the root down: a parent is always created after its children
+	const unsigned root = 2 * num_used - 2;
+	unsigned max_depth = 0;
+	depths[root] = 0;
+	memset(len_counts, 0, sizeof(len_counts));
+	for(i = root; i-- > 0; ) {
+		depths[i] = (u16)(depths[parents[i]] + 1);
+		if(i < num_used) {
+			len_counts[depths[i]]++;
+			max_depth = FD_MAX(max_depth, depths[i]);
+		}
+	}
+
+	// move the leaves deeper than max_len up, keeping the code complete
+	for(i = max_depth; i > max_len; i--) {
+		while(len_counts[i] > 0) {
+			unsigned j = i - 2;
+			while(len_counts[j] == 0) {
+				j--;
+			}
+			len_counts[i] -= 2;
+			len_counts[i - 1] += 1;
+			len_counts[j + 1] += 2;
+			len_counts[j] -= 1;
+		}
+	}
+
+	// the least frequent symbols get the longest codewords
+	unsigned leaf = 0;
+	for(i = FD_MIN(max_depth, max_len); i >= 1; i--) {
+		unsigned n;
+		for(n = len_counts[i]; n > 0; n--) {
+			lens[keys[leaf++] & 0x1FF] = (u8)i;
+		}
+	}
+
+	make_codewords(num_syms, lens, codewords);
+}
+
+// ----------------------------------------------------------
+//   Bit stream
+// ----------------------------------------------------------
+
+FD_INLINE void
+add_bits(BitStream *os, u32 bits, unsigned n) {
+	os->bitbuf |= (u64)bits << os->bitcount;
+	os->bitcount += n;
+}
+
+/**
+Write the whole bytes of the bit buffer (at most 63 bits may be pending)
+*/
+FD_INLINE void
+flush_bits(BitStream *os) {
+	if(FD_LIKELY(os->end - os->next >= 8)) {
+		const unsigned n = os->bitcount >> 3;
+		fd_store_le64(os->next, os->bitbuf);
+		os->next += n;
+		os->bitbuf = n ? (os->bitbuf >> (n * 8)) : os->bitbuf;
+		os->bitcount &= 7;
+	} else {
+		while(os->bitcount >= 8) {
+			if(os->next == os->end) {
+				os->overflow = 1;
+				os->bitbuf = 0;
+				os->bitcount = 0;
+				break;
+			}
+			*os->next++ = (u8)os->bitbuf;
+			os->bitbuf >>= 8;
+			os->bitcount -= 8;
+		}
+	}
+}
+
+/**
+Pad with zero bits up to the next byte boundary and write everything
+*/
+static void
+align_bits(BitStream *os) {
+	if(os->bitcount & 7) {
+		add_bits(os, 0, 8 - (os->bitcount & 7));
+	}
+	flush_bits(os);
+}
+
+static void
+write_bytes(BitStream *os, const u8 *data, size_t n) {
+	if((size_t)(os->end - os->next) < n) {
+		os->overflow = 1;
+		return;
+	}
+	if(n == 0) {
+		return;
+	}
+	memcpy(os->next, data, n);
+	os->next += n;
+}
+
+// ----------------------------------------------------------
+//   Blocks
+// ----------------------------------------------------------
+
+/**
+Write data as stored blocks (an empty stored block when there is no data)
+*/
+static void
+write_stored_blocks(BitStream *os, const u8 *data, size_t n, int is_final) {
+	do {
+		const size_t len = FD_MIN(n, (size_t)0xFFFF);
+		u8 header[4];
+		n -= len;
+
+		add_bits(os, (is_final && (n == 0)) ? 1 : 0, 1);
+		add_bits(os, FD_BLOCKTYPE_STORED, 2);
+		align_bits(os);
+
+		fd_store_le16(header, (u16)len);
+		fd_store_le16(header + 2, (u16)~len);
+		write_bytes(os, header, 4);
+		write_bytes(os, data, len);
+		data += len;
+	} while(n > 0);
+}
+
+/**
+Cost in bits of stored blocks, starting at the current bit position
+*/
+static u64
+stored_blocks_cost(const BitStream *os, size_t n) {
+	const size_t num_blocks = FD_MAX((n + 0xFFFE) / 0xFFFF, (size_t)1);
+	const unsigned first_pad = (8 - ((os->bitcount + 3) & 7)) & 7;
+	return (u64)8 * n + (u64)num_blocks * (3 + 32) + first_pad + (u64)(num_blocks - 1) * 5;
+}
+
+/**
+Run-length encode the codeword lengths of the dynamic codes with the precode symbols
+16 (repeat the previous length), 17 and 18 (runs of zeros), and build the precode
+*/
+static void
+make_precode(struct fastdeflate_compressor *c) {
+	u8 lens[FD_NUM_LITLEN_SYMS + FD_NUM_OFFSET_SYMS];
+	const unsigned num_lens = c->num_litlen_syms + c->num_offset_syms;
+	unsigned i = 0;
+	unsigned n = 0;
+
+	memcpy(lens, c->litlen_lens, c->num_litlen_syms);
+	memcpy(lens + c->num_litlen_syms, c->offset_lens, c->num_offset_syms);
+	memset(c->precode_freqs, 0, sizeof(c->precode_freqs));
+
+	while(i < num_lens) {
+		const unsigned len = lens[i];
+		unsigned run = 1;
+		while((i + run < num_lens) && (lens[i + run] == len)) {
+			run++;
+		}
+		i += run;
+
+		if(len == 0) {
+			while(run >= 11) {
+				const unsigned count = FD_MIN(run, 138U);
+				c->precode_items[n++] = 18 | ((count - 11) << 5);
+				c->precode_freqs[18]++;
+				run -= count;
+			}
+			if(run >= 3) {
+				c->precode_items[n++] = 17 | ((run - 3) << 5);
+				c->precode_freqs[17]++;
+				run = 0;
+			}
+		} else {
+			c->precode_items[n++] = len;
+			c->precode_freqs[len]++;
+			run--;
+			while(run >= 3) {
+				const unsigned count = FD_MIN(run, 6U);
+				c->precode_items[n++] = 16 | ((count - 3) << 5);
+				c->precode_freqs[16]++;
+				run -= count;
+			}
+		}
+		while(run > 0) {
+			c->precode_items[n++] = len;
+			c->precode_freqs[len]++;
+			run--;
+		}
+	}
+	c->num_precode_items = n;
+
+	make_huffman_code(FD_NUM_PRECODE_SYMS, FD_MAX_PRECODE_CODEWORD_LEN, c->precode_freqs, c->precode_lens, c->precode_codewords);
+
+	c->num_explicit_lens = FD_NUM_PRECODE_SYMS;
+	while((c->num_explicit_lens > 4) && (c->precode_lens[fd_precode_permutation[c->num_explicit_lens - 1]] == 0)) {
+		c->num_explicit_lens--;
+	}
+}
+
+/**
+Cost in bits of the Huffman coded data of a block (without the extra bits, the same for all codes)
+*/
+static u64
+huffman_data_cost(const struct fastdeflate_compressor *c, const u8 *litlen_lens, const u8 *offset_lens) {
+	u64 cost = 0;
+	unsigned sym;
+	for(sym = 0; sym < FD_NUM_LITLEN_SYMS; sym++) {
+		cost += (u64)c->litlen_freqs[sym] * litlen_lens[sym];
+	}
+	for(sym = 0; sym < FD_NUM_OFFSET_SYMS; sym++) {
+		cost += (u64)c->offset_freqs[sym] * offset_lens[sym];
+	}
+	return cost;
+}
+
+static void
+write_dynamic_header(BitStream *os, const struct fastdeflate_compressor *c) {
+	unsigned i;
+
+	add_bits(os, c->num_litlen_syms - 257, 5);
+	add_bits(os, c->num_offset_syms - 1, 5);
+	add_bits(os, c->num_explicit_lens - 4, 4);
+	flush_bits(os);
+
+	for(i = 0; i < c->num_explicit_lens; i++) {
+		add_bits(os, c->precode_lens[fd_precode_permutation[i]], 3);
+		flush_bits(os);
+	}
+
+	for(i = 0; i < c->num_precode_items; i++) {
+		const u32 item = c->precode_items[i];
+		const unsigned sym = item & 0x1F;
+		add_bits(os, c->precode_codewords[sym], c->precode_lens[sym]);
+		if(sym >= 16) {
+			add_bits(os, item >> 5, (sym == 16) ? 2 : ((sym == 17) ? 3 : 7));
+		}
+		flush_bits(os);
+	}
+}
+
+static void
+write_sequences(BitStream *os, const struct fastdeflate_compressor *c, const u8 *in, const Sequence *seq, const u8 *litlen_lens, const u32 *litlen_codewords, const u8 *offset_lens, const u32 *offset_codewords) {
+	for(;;) {
+		u32 litrunlen = seq->litrunlen;
+
+		// three literals take at most 45 bits
+		while(litrunlen >= 3) {
+			add_bits(os, litlen_codewords[in[0]], litlen_lens[in[0]]);
+			add_bits(os, litlen_codewords[in[1]], litlen_lens[in[1]]);
+			add_bits(os, litlen_codewords[in[2]], litlen_lens[in[2]]);
+			flush_bits(os);
+			in += 3;
+			litrunlen -= 3;
+		}
+		while(litrunlen > 0) {
+			add_bits(os, litlen_codewords[*in], litlen_lens[*in]);
+			in++;
+			litrunlen--;
+		}
+		flush_bits(os);
+
+		if(seq->length == 0) {
+			break;
+		}
+
+		// a match takes at most 48 bits
+		const unsigned length = seq->length;
+		const unsigned offset = seq->offset;
+		const unsigned lslot = c->length_slot[length];
+		const unsigned oslot = offset_slot(c, offset);
+		add_bits(os, litlen_codewords[257 + lslot], litlen_lens[257 + lslot]);
+		add_bits(os, length - fd_length_base[lslot], fd_length_extra_bits[lslot]);
+		add_bits(os, offset_codewords[oslot], offset_lens[oslot]);
+		add_bits(os, offset - fd_offset_base[oslot], fd_offset_extra_bits[oslot]);
+		flush_bits(os);
+
+		in += length;
+		seq++;
+	}
+
+	add_bits(os, litlen_codewords[FD_END_OF_BLOCK], litlen_lens[FD_END_OF_BLOCK]);
+	flush_bits(os);
+}
+
+/**
+Write the block covering [in, in + in_nbytes), whose sequences and frequencies have been collected
+*/
+static void
+write_block(struct fastdeflate_compressor *c, BitStream *os, const u8 *in, size_t in_nbytes, int is_final) {
+	unsigned sym;
+
+	c->litlen_freqs[FD_END_OF_BLOCK]++;
+
+	// dynamic codes: symbols 286 and 287 are never used
+	make_huffman_code(FD_NUM_LITLEN_SYMS - 2, FD_MAX_LITLEN_CODEWORD_LEN, c->litlen_freqs, c->litlen_lens, c->litlen_codewords);
+	c->litlen_lens[286] = 0;
+	c->litlen_lens[287] = 0;
+	make_huffman_code(30, FD_MAX_OFFSET_CODEWORD_LEN, c->offset_freqs, c->offset_lens, c->offset_codewords);
+	c->offset_lens[30] = 0;
+	c->offset_lens[31] = 0;
+
+	c->num_litlen_syms = 286;
+	while((c->num_litlen_syms > 257) && (c->litlen_lens[c->num_litlen_syms - 1] == 0)) {
+		c->num_litlen_syms--;
+	}
+	c->num_offset_syms = 30;
+	while((c->num_offset_syms > 1) && (c->offset_lens[c->num_offset_syms - 1] == 0)) {
+		c->num_offset_syms--;
+	}
+	make_precode(c);
+
+	// costs in bits
+	u64 extra_bits = 0;
+	for(sym = 0; sym < 29; sym++) {
+		extra_bits += (u64)c->litlen_freqs[257 + sym] * fd_length_extra_bits[sym];
+	}
+	for(sym = 0; sym < 30; sym++) {
+		extra_bits += (u64)c->offset_freqs[sym] * fd_offset_extra_bits[sym];
+	}
+
+	u64 dynamic_cost = 3 + 5 + 5 + 4 + 3 * (u64)c->num_explicit_lens + extra_bits;
+	for(sym = 0; sym < FD_NUM_PRECODE_SYMS; sym++) {
+		dynamic_cost += (u64)c->precode_freqs[sym] * c->precode_lens[sym];
+	}
+	dynamic_cost += 2 * (u64)c->precode_freqs[16] + 3 * (u64)c->precode_freqs[17] + 7 * (u64)c->precode_freqs[18];
+	dynamic_cost += huffman_data_cost(c, c->litlen_lens, c->offset_lens);
+
+	const u64 static_cost = 3 + extra_bits + huffman_data_cost(c, c->static_litlen_lens, c->static_offset_lens);
+	const u64 stored_cost = stored_blocks_cost(os, in_nbytes);
+
+	if((stored_cost < dynamic_cost) && (stored_cost < static_cost)) {
+		write_stored_blocks(os, in, in_nbytes, is_final);
+	} else if(static_cost < dynamic_cost) {
+		add_bits(os, is_final ? 1 : 0, 1);
+		add_bits(os, FD_BLOCKTYPE_STATIC, 2);
+		write_sequences(os, c, in, c->sequences, c->static_litlen_lens, c->static_litlen_codewords, c->static_offset_lens, c->static_offset_codewords);
+	} else {
+		add_bits(os, is_final ? 1 : 0, 1);
+		add_bits(os, FD_BLOCKTYPE_DYNAMIC, 2);
+		write_dynamic_header(os, c);
+		write_sequences(os, c, in, c->sequences, c->litlen_lens, c->litlen_codewords, c->offset_lens, c->offset_codewords);
+	}
+}
+
+// ----------------------------------------------------------
+//   Match finding
+// ----------------------------------------------------------
+
+/// hash of the 3 bytes at p (4 bytes must be readable)
+FD_INLINE u32
+hash3(const u8 *p) {
+	return ((fd_load_le32(p) & 0xFFFFFF) * 0x1E35A7BDU) >> (32 - HASH_BITS);
+}
+
+FD_INLINE void
+insert_position(struct fastdeflate_compressor *c, const u8 *in_base, u32 pos) {
+	const u32 hash = hash3(in_base + pos);
+	c->prev[pos & WINDOW_MASK] = c->head[hash];
+	c->head[hash] = pos;
+}
+
+/**
+Length of the match between p and m, knowing that the first 'len' bytes match
+*/
+FD_INLINE unsigned
+match_length(const u8 *p, const u8 *m, unsigned len, unsigned max_len) {
+#ifdef FD_FAST_UNALIGNED
+	while(len + 8 <= max_len) {
+		const u64 diff = fd_load_le64(p + len) ^ fd_load_le64(m + len);
+		if(diff) {
+			return len + (fd_ctz64(diff) >> 3);
+		}
+		len += 8;
+	}
+#endif
+	while((len < max_len) && (p[len] == m[len])) {
+		len++;
+	}
+	return len;
+}
+
+/**
+Insert the position 'pos' and look for a match longer than best_len along its hash chain.
+At least 4 bytes must be readable at pos.
+@return Returns the length of the best match (best_len if none is longer)
+*/
+FD_INLINE unsigned
+find_match(struct fastdeflate_compressor *c, const u8 *in_base, u32 pos, unsigned max_len, unsigned nice_len, unsigned depth, unsigned best_len, unsigned *offset_ret) {
+	const u8 * const p = in_base + pos;
+	const u32 hash = hash3(p);
+	u32 candidate = c->head[hash];
+
+	c->head[hash] = pos;
+	c->prev[pos & WINDOW_MASK] = candidate;
+
+	if(best_len >= max_len) {
+		return best_len;
+	}
+	nice_len = FD_MIN(nice_len, max_len);
+
+	const u32 first_bytes = fd_load_le32(p) & 0xFFFFFF;
+
+	while(depth--) {
+		if((u32)(pos - candidate - 1) >= FD_WINDOW_SIZE) {
+			break;
+		}
+		const u8 * const m = in_base + candidate;
+		if((m[best_len] == p[best_len]) && ((fd_load_le32(m) & 0xFFFFFF) == first_bytes)) {
+			const unsigned len = match_length(p, m, 3, max_len);
+			if(len > best_len) {
+				best_len = len;
+				*offset_ret = pos - candidate;
+				if(len >= nice_len) {
+					break;
+				}
+			}
+		}
+		candidate = c->prev[candidate & WINDOW_MASK];
+	}
+
+	return best_len;
+}
+
+// ----------------------------------------------------------
+//   Parsing
+// ----------------------------------------------------------
+
+/**
+Start a new block at 'block_begin'
+*/
+FD_INLINE Sequence *
+begin_block(struct fastdeflate_compressor *c) {
+	memset(c->litlen_freqs, 0, sizeof(c->litlen_freqs));
+	memset(c->offset_freqs, 0, sizeof(c->offset_freqs));
+	c->sequences[0].litrunlen = 0;
+	c->sequences[0].length = 0;
+	return c->sequences;
+}
+
+FD_INLINE void
+record_literal(struct fastdeflate_compressor *c, Sequence *seq, u8 literal) {
+	c->litlen_freqs[literal]++;
+	seq->litrunlen++;
+}
+
+FD_INLINE Sequence *
+record_match(struct fastdeflate_compressor *c, Sequence *seq, unsigned length, unsigned offset) {
+	c->litlen_freqs[257 + c->length_slot[length]]++;
+	c->offset_freqs[offset_slot(c, offset)]++;
+	seq->length = (u16)length;
+	seq->offset = (u16)offset;
+	seq++;
+	seq->litrunlen = 0;
+	seq->length = 0;
+	return seq;
+}
+
+/**
+Greedy parsing (levels 1 to 3): take the longest match found at each position
+*/
+static void
+compress_greedy(struct fastdeflate_compressor *c, BitStream *os, const u8 *in_base, u32 begin, u32 end, int final) {
+	const LevelParams *params = &c->params;
+	u32 pos = begin;
+
+	do {
+		const u32 block_begin = pos;
+		Sequence *seq = begin_block(c);
+		unsigned items = 0;
+
+		while((pos < end) && (items < MAX_BLOCK_ITEMS)) {
+			const unsigned max_len = FD_MIN(end - pos, (u32)FD_MAX_MATCH_LEN);
+			unsigned length = 0;
+			unsigned offset = 0;
+
+			if(max_len >= 4) {
+				length = find_match(c, in_base, pos, max_len, params->nice_len, params->max_chain, 2, &offset);
+			}
+
+			if(length >= FD_MIN_MATCH_LEN) {
+				seq = record_match(c, seq, length, offset);
+				if(length <= params->lazy_len) {
+					// index the positions of short matches only
+					u32 p;
+					for(p = pos + 1; (p < pos + length) && (end - p >= 4); p++) {
+						insert_position(c, in_base, p);
+					}
+				}
+				pos += length;
+			} else {
+				record_literal(c, seq, in_base[pos]);
+				pos++;
+			}
+			items++;
+		}
+
+		write_block(c, os, in_base + block_begin, pos - block_begin, final && (pos == end));
+	} while(pos < end);
+}
+
+/**
+Lazy parsing (levels 4 to 9): a match is only taken if the next position has no longer match
+*/
+static void
+compress_lazy(struct fastdeflate_compressor *c, BitStream *os, const u8 *in_base, u32 begin, u32 end, int final) {
+	const LevelParams *params = &c->params;
+	// next position to look at, and first position not written yet (it holds a pending literal)
+	u32 pos = begin;
+	u32 written = begin;
+	// match found at the pending position
+	unsigned prev_length = 0;
+	unsigned prev_offset = 0;
+
+	do {
+		const u32 block_begin = written;
+		Sequence *seq = begin_block(c);
+		unsigned items = 0;
+
+		while((pos < end) && (items < MAX_BLOCK_ITEMS)) {
+			const unsigned max_len = FD_MIN(end - pos, (u32)FD_MAX_MATCH_LEN);
+			unsigned length = 0;
+			unsigned offset = 0;
+
+			if(max_len >= 4) {
+				if(prev_length < params->lazy_len) {
+					const unsigned depth = (prev_length >= params->good_len) ? (params->max_chain >> 2) : params->max_chain;
+					length = find_match(c, in_base, pos, max_len, params->nice_len, depth, FD_MAX(prev_length, 2U), &offset);
+					if((length <= prev_length) || ((length == FD_MIN_MATCH_LEN) && (offset > TOO_FAR))) {
+						length = 0;
+					}
+				} else {
+					insert_position(c, in_base, pos);
+				}
+			}
+
+			if((prev_length >= FD_MIN_MATCH_LEN) && (length == 0)) {
+				// the match at the pending position wins: positions up to pos are indexed already
+				u32 p;
+				seq = record_match(c, seq, prev_length, prev_offset);
+				items++;
+				const u32 match_end = written + prev_length;
+				for(p = pos + 1; (p < match_end) && (end - p >= 4); p++) {
+					insert_position(c, in_base, p);
+				}
+				written = match_end;
+				pos = match_end;
+				prev_length = 0;
+			} else {
+				if(written < pos) {
+					// the pending position gets a literal, the current one becomes pending
+					record_literal(c, seq, in_base[written]);
+					items++;
+					written++;
+				}
+				prev_length = length;
+				prev_offset = offset;
+				pos++;
+			}
+		}
+
+		if(pos == end) {
+			// flush the pending position
+			if(prev_length >= FD_MIN_MATCH_LEN) {
+				seq = record_match(c, seq, prev_length, prev_offset);
+				written += prev_length;
+				prev_length = 0;
+			}
+			while(written < end) {
+				record_literal(c, seq, in_base[written]);
+				written++;
+			}
+		}
+
+		write_block(c, os, in_base + block_begin, written - block_begin, final && (written == end));
+	} while(written < end);
+}
+
+// ----------------------------------------------------------
+//   Public API
+// ----------------------------------------------------------
+
+size_t
+fastdeflate_deflate_compress_chunk(struct fastdeflate_compressor *c, const void *in, size_t in_nbytes, size_t dict_nbytes, int final, void *out, size_t out_nbytes_avail) {
+	const u8 * const in_base = (const u8 *)in - dict_nbytes;
+	BitStream os;
+	u32 i;
+
+	if((dict_nbytes > MAX_POSITIONS) || (in_nbytes > MAX_POSITIONS - dict_nbytes)) {
+		return 0;
+	}
+
+	os.bitbuf = 0;
+	os.bitcount = 0;
+	os.next = (u8 *)out;
+	os.end = os.next + out_nbytes_avail;
+	os.overflow = 0;
+
+	const u32 begin = (u32)dict_nbytes;
+	const u32 end = (u32)(dict_nbytes + in_nbytes);
+
+	if((c->level == 0) || (in_nbytes == 0)) {
+		if((in_nbytes > 0) || final) {
+			if(c->level == 0) {
+				write_stored_blocks(&os, (const u8 *)in, in_nbytes, final);
+			} else {
+				// an empty block with the static code is the shortest
+				begin_block(c);
+				write_block(c, &os, (const u8 *)in, 0, final);
+			}
+		}
+	} else {
+		for(i = 0; i < HASH_SIZE; i++) {
+			c->head[i] = NO_POS;
+		}
+		// index the end of the dictionary
+		for(i = (begin > FD_WINDOW_SIZE) ? (begin - FD_WINDOW_SIZE) : 0; (i < begin) && (end - i >= 4); i++) {
+			insert_position(c, in_base, i);
+		}
+
+		if(c->level <= 3) {
+			compress_greedy(c, &os, in_base, begin, end, final);
+		} else {
+			compress_lazy(c, &os, in_base, begin, end, final);
+		}
+	}
+
+	if(!final) {
+		// sync flush: an empty stored block ends the chunk on a byte boundary
+		write_stored_blocks(&os, NULL, 0, 0);
+	}
+
+	align_bits(&os);
+
+	return os.overflow ? 0 : (size_t)(os.next - (u8 *)out);
+}
+
+size_t
+fastdeflate_deflate_compress(struct fastdeflate_compressor *c, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail) {
+	return fastdeflate_deflate_compress_chunk(c, in, in_nbytes, 0, 1, out, out_nbytes_avail);
+}
+
+size_t
+fastdeflate_deflate_compress_bound(struct fastdeflate_compressor *c, size_t in_nbytes) {
+	// a block is never larger than the stored blocks of its data, and holds at least
+	// MAX_BLOCK_ITEMS bytes unless it is the last one; a final or a sync flush block may follow
+	(void)c;
+	return in_nbytes + (in_nbytes / 2048) + 32;
+}
+
+struct fastdeflate_compressor *
+fastdeflate_alloc_compressor(int level) {
+	struct fastdeflate_compressor *c;
+	unsigned slot, i;
+
+	if((level < 0) || (level > 9)) {
+		return NULL;
+	}
+	c = (struct fastdeflate_compressor *)malloc(sizeof(struct fastdeflate_compressor));
+	if(!c) {
+		return NULL;
+	}
+	c->level = level;
+	c->params = s_level_params[level];
+
+	for(slot = 0; slot < 29; slot++) {
+		const unsigned last = (slot < 28) ? fd_length_base[slot + 1] : FD_MAX_MATCH_LEN + 1;
+		for(i = fd_length_base[slot]; i < last; i++) {
+			c->length_slot[i] = (u8)slot;
+		}
+	}
+	for(slot = 0; slot < 30; slot++) {
+		const unsigned last = fd_offset_base[slot] + (1U << fd_offset_extra_bits[slot]);
+		for(i = fd_offset_base[slot]; i < last; i++) {
+			if(i <= 256) {
+				c->offset_slot_table[i - 1] = (u8)slot;
+			} else {
+				c->offset_slot_table[256 + ((i - 1) >> 7)] = (u8)slot;
+			}
+		}
+	}
+
+	// RFC 1951, section 3.2.6
+	for(i = 0; i < 144; i++) {
+		c->static_litlen_lens[i] = 8;
+	}
+	for(; i < 256; i++) {
+		c->static_litlen_lens[i] = 9;
+	}
+	for(; i < 280; i++) {
+		c->static_litlen_lens[i] = 7;
+	}
+	for(; i < FD_NUM_LITLEN_SYMS; i++) {
+		c->static_litlen_lens[i] = 8;
+	}
+	for(i = 0; i < FD_NUM_OFFSET_SYMS; i++) {
+		c->static_offset_lens[i] = 5;
+	}
+	make_codewords(FD_NUM_LITLEN_SYMS, c->static_litlen_lens, c->static_litlen_codewords);
+	make_codewords(FD_NUM_OFFSET_SYMS, c->static_offset_lens, c->static_offset_codewords);
+
+	return c;
+}
+
+int
+fd_compressor_level(const struct fastdeflate_compressor *c) {
+	return c->level;
+}
+
+void
+fastdeflate_free_compressor(struct fastdeflate_compressor *c) {
+	free(c);
+}
@@ -0,0 +1,190 @@
+// ==========================================================
+// FastDeflate: CRC-32
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "fd_common.h"
+#include "fd_crc32_table.h"
+
+#ifdef FD_PCLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#if !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+#endif // FD_PCLMUL
+
+// ----------------------------------------------------------
+//   Portable implementation
+// ----------------------------------------------------------
+
+/**
+Slice-by-8: eight table lookups per 8 bytes, with no dependency between the lookups
+*/
+static u32
+crc32_slice8(u32 crc, const u8 *p, size_t len) {
+	while(len >= 8) {
+		const u32 v1 = fd_load_le32(p) ^ crc;
+		const u32 v2 = fd_load_le32(p + 4);
+		crc = fd_crc32_table[7][v1 & 0xFF] ^ fd_crc32_table[6][(v1 >> 8) & 0xFF] ^
+			fd_crc32_table[5][(v1 >> 16) & 0xFF] ^ fd_crc32_table[4][v1 >> 24] ^
+			fd_crc32_table[3][v2 & 0xFF] ^ fd_crc32_table[2][(v2 >> 8) & 0xFF] ^
+			fd_crc32_table[1][(v2 >> 16) & 0xFF] ^ fd_crc32_table[0][v2 >> 24];
+		p += 8;
+		len -= 8;
+	}
+	while(len--) {
+		crc = (crc >> 8) ^ fd_crc32_table[0][(crc ^ *p++) & 0xFF];
+	}
+	return crc;
+}
+
+// ----------------------------------------------------------
+//   Carry-less multiplication
+// ----------------------------------------------------------
+
+#ifdef FD_PCLMUL
+
+/// -1 until the CPU has been checked, then 0 or 1 (written the same way by any thread)
+static volatile int s_has_pclmul = -1;
+
+static int
+has_pclmul(void) {
+	int has = s_has_pclmul;
+	if(has < 0) {
+		unsigned ecx = 0;
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		ecx = (unsigned)info[2];
+#else
+		unsigned eax, ebx, edx;
+		if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+			ecx = 0;
+		}
+#endif
+		has = (ecx & (1U << 1)) ? 1 : 0;
+		s_has_pclmul = has;
+	}
+	return has;
+}
+
+/**
+Fold 16-byte blocks with PCLMULQDQ, then reduce the remainder with a Barrett reduction,
+as described by Intel in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+Instruction". The constants are powers of x modulo the bit-reflected CRC-32 polynomial P(x).
+@param crc Running CRC (not inverted)
+@param len Number of bytes, at least 64 and a multiple of 16
+*/
+FD_TARGET_PCLMUL static u32
+crc32_pclmul(u32 crc, const u8 *p, size_t len) {
+	// constants to fold 64 bytes at a time
+	const __m128i k_fold4 = _mm_set_epi32(0x00000001, (int)0xC6E41596U, 0x00000001, 0x54442BD4);
+	// constants to fold 16 bytes at a time, and 128 bits into 64
+	const __m128i k_fold1 = _mm_set_epi32(0x00000000, (int)0xCCAA009EU, 0x00000001, 0x751997D0);
+	// constant to fold 64 bits into 32
+	const __m128i k_fold64 = _mm_set_epi32(0x00000000, 0x00000000, 0x00000001, 0x63CD6124);
+	// P(x) and floor(x^64 / P(x)), for the Barrett reduction
+	const __m128i k_barrett = _mm_set_epi32(0x00000001, (int)0xF7011641U, 0x00000001, (int)0xDB710641U);
+	const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+
+	__m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p), _mm_cvtsi32_si128((int)crc));
+	__m128i x1 = _mm_loadu_si128((const __m128i *)(p + 16));
+	__m128i x2 = _mm_loadu_si128((const __m128i *)(p + 32));
+	__m128i x3 = _mm_loadu_si128((const __m128i *)(p + 48));
+	__m128i t0, t1, t2, t3;
+	p += 64;
+	len -= 64;
+
+	while(len >= 64) {
+		t0 = _mm_clmulepi64_si128(x0, k_fold4, 0x00);
+		t1 = _mm_clmulepi64_si128(x1, k_fold4, 0x00);
+		t2 = _mm_clmulepi64_si128(x2, k_fold4, 0x00);
+		t3 = _mm_clmulepi64_si128(x3, k_fold4, 0x00);
+		x0 = _mm_clmulepi64_si128(x0, k_fold4, 0x11);
+		x1 = _mm_clmulepi64_si128(x1, k_fold4, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k_fold4, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k_fold4, 0x11);
+		x0 = _mm_xor_si128(_mm_xor_si128(x0, t0), _mm_loadu_si128((const __m128i *)p));
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128((const __m128i *)(p + 16)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, t2), _mm_loadu_si128((const __m128i *)(p + 32)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, t3), _mm_loadu_si128((const __m128i *)(p + 48)));
+		p += 64;
+		len -= 64;
+	}
+
+	// fold the four accumulators into one
+	t0 = _mm_clmulepi64_si128(x0, k_fold1, 0x00);
+	x0 = _mm_clmulepi64_si128(x0, k_fold1, 0x11);
+	x0 = _mm_xor_si128(_mm_xor_si128(x0, t0), x1);
+	t0 = _mm_clmulepi64_si128(x0, k_fold1, 0x00);
+	x0 = _mm_clmulepi64_si128(x0, k_fold1, 0x11);
+	x0 = _mm_xor_si128(_mm_xor_si128(x0, t0), x2);
+	t0 = _mm_clmulepi64_si128(x0, k_fold1, 0x00);
+	x0 = _mm_clmulepi64_si128(x0, k_fold1, 0x11);
+	x0 = _mm_xor_si128(_mm_xor_si128(x0, t0), x3);
+
+	while(len >= 16) {
+		t0 = _mm_clmulepi64_si128(x0, k_fold1, 0x00);
+		x0 = _mm_clmulepi64_si128(x0, k_fold1, 0x11);
+		x0 = _mm_xor_si128(_mm_xor_si128(x0, t0), _mm_loadu_si128((const __m128i *)p));
+		p += 16;
+		len -= 16;
+	}
+
+	// 128 to 64 bits, then 64 to 32 bits
+	t0 = _mm_clmulepi64_si128(k_fold1, x0, 0x01);
+	x0 = _mm_xor_si128(_mm_srli_si128(x0, 8), t0);
+	t0 = _mm_srli_si128(x0, 4);
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k_fold64, 0x00);
+	x0 = _mm_xor_si128(x0, t0);
+
+	// Barrett reduction to the final 32 bits
+	t0 = x0;
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k_barrett, 0x10);
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k_barrett, 0x00);
+	x0 = _mm_xor_si128(x0, t0);
+
+	return (u32)_mm_cvtsi128_si32(_mm_srli_si128(x0, 4));
+}
+
+#endif // FD_PCLMUL
+
+// ----------------------------------------------------------
+//   Public API
+// ----------------------------------------------------------
+
+uint32_t
+fastdeflate_crc32(uint32_t crc, const void *buffer, size_t len) {
+	const u8 *p = (const u8 *)buffer;
+
+	if(!buffer) {
+		return 0;
+	}
+
+	crc = ~crc;
+
+#ifdef FD_PCLMUL
+	if((len >= 64) && has_pclmul()) {
+		const size_t n = len & ~(size_t)15;
+		crc = crc32_pclmul(crc, p, n);
+		p += n;
+		len -= n;
+	}
+#endif
+
+	return ~crc32_slice8(crc, p, len);
+}
@@ -0,0 +1,547 @@
+// ==========================================================
+// FastDeflate: DEFLATE decompression
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "fd_common.h"
+
+/*
+The whole input and the whole output are in memory: the decoder reads the input through
+a 64-bit bit buffer refilled a word at a time, and copies matches directly from the output.
+Huffman codes are decoded with a root table indexed by the next bits of the input, and
+subtables for the longer codewords, laid out as in ZLib's inflate_table.
+The decoder rejects the streams that ZLib's inflate rejects.
+*/
+
+// ----------------------------------------------------------
+//   Decode tables
+// ----------------------------------------------------------
+
+#define PRECODE_TABLEBITS	7
+#define LITLEN_TABLEBITS	11
+#define OFFSET_TABLEBITS	8
+
+// worst case sizes of the tables and their subtables, given by ZLib's 'enough' tool
+
+#define PRECODE_ENOUGH		128		// enough 19 7 7
+#define LITLEN_ENOUGH		2342	// enough 288 11 15
+#define OFFSET_ENOUGH		402		// enough 32 8 15
+
+/*
+Table entry layout:
+- bits 0-3: number of bits taken by the codeword (by the root index for a subtable link)
+- bits 4-7: number of extra bits of a length or an offset (number of index bits for a subtable link)
+- bits 8-23: literal, base length, base offset, precode symbol, or first entry of a subtable
+- bits 28-31: kind of entry
+*/
+
+#define ENTRY_LENGTH(entry)		((entry) & 0xF)
+#define ENTRY_EXTRA(entry)		(((entry) >> 4) & 0xF)
+#define ENTRY_VALUE(entry)		(((entry) >> 8) & 0xFFFF)
+
+#define ENTRY_INVALID		0x10000000U
+#define ENTRY_SUBTABLE		0x20000000U
+#define ENTRY_END_OF_BLOCK	0x40000000U
+#define ENTRY_LITERAL		0x80000000U
+
+#define MAKE_ENTRY(value, extra)	(((u32)(value) << 8) | ((u32)(extra) << 4))
+
+struct fastdeflate_decompressor {
+	u32 precode_table[PRECODE_ENOUGH];
+	u32 litlen_table[LITLEN_ENOUGH];
+	u32 offset_table[OFFSET_ENOUGH];
+
+	/// table entries of each symbol, without the codeword length
+	u32 precode_entries[FD_NUM_PRECODE_SYMS];
+	u32 litlen_entries[FD_NUM_LITLEN_SYMS];
+	u32 offset_entries[FD_NUM_OFFSET_SYMS];
+
+	u8 precode_lens[FD_NUM_PRECODE_SYMS];
+	u8 lens[FD_NUM_LITLEN_SYMS + FD_NUM_OFFSET_SYMS];
+
+	/// the tables hold the codes of static blocks
+	int static_codes_loaded;
+};
+
+FD_INLINE u32
+reverse_codeword(u32 codeword, unsigned len) {
+	u32 reversed = 0;
+	while(len--) {
+		reversed = (reversed << 1) | (codeword & 1);
+		codeword >>= 1;
+	}
+	return reversed;
+}
+
+/**
+Build the decode table of a canonical Huffman code.
+As ZLib does, over-subscribed codes are rejected, and incomplete codes are only accepted
+when they have a single codeword of length 1 (or no codeword at all), except for the precode.
+@return Returns 1 if successful, 0 if the code is invalid
+*/
+static int
+build_decode_table(u32 *table, unsigned table_bits, unsigned capacity, const u8 *lens, unsigned num_syms, const u32 *entries, int complete_only) {
+	unsigned count[FD_MAX_LITLEN_CODEWORD_LEN + 1];
+	unsigned offsets[FD_MAX_LITLEN_CODEWORD_LEN + 2];
+	u16 sorted[FD_NUM_LITLEN_SYMS];
+	const unsigned root_size = 1U << table_bits;
+	unsigned sym, len, i;
+
+	memset(count, 0, sizeof(count));
+	for(sym = 0; sym < num_syms; sym++) {
+		count[lens[sym]]++;
+	}
+
+	unsigned max_len = FD_MAX_LITLEN_CODEWORD_LEN;
+	while((max_len > 0) && (count[max_len] == 0)) {
+		max_len--;
+	}
+
+	// Kraft inequality
+	int left = 1;
+	for(len = 1; len <= FD_MAX_LITLEN_CODEWORD_LEN; len++) {
+		left <<= 1;
+		left -= (int)count[len];
+		if(left < 0) {
+			return 0;
+		}
+	}
+	if((left > 0) && (complete_only || (max_len > 1))) {
+		return 0;
+	}
+	if(left > 0) {
+		// the missing codewords are invalid
+		for(i = 0; i < root_size; i++) {
+			table[i] = ENTRY_INVALID;
+		}
+		if(max_len == 0) {
+			return 1;
+		}
+	}
+
+	// sort the symbols by codeword length, then by value
+	offsets[1] = 0;
+	for(len = 1; len <= FD_MAX_LITLEN_CODEWORD_LEN; len++) {
+		offsets[len + 1] = offsets[len] + count[len];
+	}
+	for(sym = 0; sym < num_syms; sym++) {
+		if(lens[sym]) {
+			sorted[offsets[lens[sym]]++] = (u16)sym;
+		}
+	}
+	const unsigned num_codewords = offsets[FD_MAX_LITLEN_CODEWORD_LEN + 1];
+
+	// assign the canonical codewords in order and fill the tables
+	u32 codeword = 0;
+	unsigned codeword_len = lens[sorted[0]];
+	unsigned subtable_prefix = root_size;
+	unsigned subtable_start = 0;
+	unsigned subtable_bits = 0;
+	unsigned next_subtable = root_size;
+
+	for(i = 0; i < num_codewords; i++) {
+		sym = sorted[i];
+		len = lens[sym];
+		codeword <<= (len - codeword_len);
+		codeword_len = len;
+
+		const u32 reversed = reverse_codeword(codeword, len);
+
+		if(len <= table_bits) {
+			const u32 entry = entries[sym] | len;
+			unsigned index;
+			for(index = reversed; index < root_size; index += 1U << len) {
+				table[index] = entry;
+			}
+		} else {
+			const unsigned prefix = reversed & (root_size - 1);
+			if(prefix != subtable_prefix) {
+				// the subtable is large enough for all the codewords starting with this prefix
+				unsigned bits = len - table_bits;
+				int room = 1 << bits;
+				while(bits + table_bits < max_len) {
+					room -= (int)count[bits + table_bits];
+					if(room <= 0) {
+						break;
+					}
+					bits++;
+					room <<= 1;
+				}
+				subtable_prefix = prefix;
+				subtable_start = next_subtable;
+				subtable_bits = bits;
+				next_subtable += 1U << bits;
+				if(next_subtable > capacity) {
+					return 0;
+				}
+				table[prefix] = ENTRY_SUBTABLE | MAKE_ENTRY(subtable_start, subtable_bits) | table_bits;
+			}
+			const u32 entry = entries[sym] | (len - table_bits);
+			unsigned index;
+			for(index = reversed >> table_bits; index < (1U << subtable_bits); index += 1U << (len - table_bits)) {
+				table[subtable_start + index] = entry;
+			}
+		}
+
+		count[len]--;
+		codeword++;
+	}
+
+	return 1;
+}
+
+static int
+load_static_codes(struct fastdeflate_decompressor *d) {
+	unsigned i;
+
+	for(i = 0; i < 144; i++) {
+		d->lens[i] = 8;
+	}
+	for(; i < 256; i++) {
+		d->lens[i] = 9;
+	}
+	for(; i < 280; i++) {
+		d->lens[i] = 7;
+	}
+	for(; i < FD_NUM_LITLEN_SYMS; i++) {
+		d->lens[i] = 8;
+	}
+	for(; i < FD_NUM_LITLEN_SYMS + FD_NUM_OFFSET_SYMS; i++) {
+		d->lens[i] = 5;
+	}
+
+	return build_decode_table(d->litlen_table, LITLEN_TABLEBITS, LITLEN_ENOUGH, d->lens, FD_NUM_LITLEN_SYMS, d->litlen_entries, 0) &&
+		build_decode_table(d->offset_table, OFFSET_TABLEBITS, OFFSET_ENOUGH, d->lens + FD_NUM_LITLEN_SYMS, FD_NUM_OFFSET_SYMS, d->offset_entries, 0);
+}
+
+// ----------------------------------------------------------
+//   Decompression
+// ----------------------------------------------------------
+
+/*
+Bit buffer: bits are consumed from the low end. A word refill may leave above 'bitsleft'
+some bits of the next input byte: they are ORed again, unchanged, by the next refill.
+Past the end of the input, zero bytes are added and counted in 'overread': a stream
+that uses them is truncated.
+*/
+
+#define BITS(n)				((u32)bitbuf & (((u32)1 << (n)) - 1))
+#define REMOVE_BITS(n)		(bitbuf >>= (n), bitsleft -= (n))
+
+#define REFILL_BITS() \
+	do { \
+		if(FD_LIKELY(in_end - in_next >= 8)) { \
+			bitbuf |= fd_load_le64(in_next) << bitsleft; \
+			in_next += (63 - bitsleft) >> 3; \
+			bitsleft |= 56; \
+		} else { \
+			while(bitsleft < 56) { \
+				if(in_next < in_end) { \
+					bitbuf |= (u64)*in_next++ << bitsleft; \
+				} else { \
+					overread++; \
+				} \
+				bitsleft += 8; \
+			} \
+			if(overread > 8) { \
+				goto bad_data; \
+			} \
+		} \
+	} while(0)
+
+enum fastdeflate_result
+fastdeflate_deflate_decompress(struct fastdeflate_decompressor *d, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail, size_t *actual_in_nbytes_ret, size_t *actual_out_nbytes_ret) {
+	const u8 *in_next = (const u8 *)in;
+	const u8 * const in_end = in_next + in_nbytes;
+	u8 * const out_begin = (u8 *)out;
+	u8 *out_next = out_begin;
+	u8 * const out_end = out_begin + out_nbytes_avail;
+
+	u64 bitbuf = 0;
+	unsigned bitsleft = 0;
+	size_t overread = 0;
+	unsigned is_final;
+	unsigned i;
+
+	do {
+		REFILL_BITS();
+
+		is_final = BITS(1);
+		REMOVE_BITS(1);
+		const unsigned block_type = BITS(2);
+		REMOVE_BITS(2);
+
+		if(block_type == FD_BLOCKTYPE_STORED) {
+			// align on a byte, then give back the bytes held by the bit buffer
+			REMOVE_BITS(bitsleft & 7);
+			const size_t held = bitsleft >> 3;
+			if(overread > held) {
+				goto bad_data;
+			}
+			in_next -= held - overread;
+			bitbuf = 0;
+			bitsleft = 0;
+			overread = 0;
+
+			if(in_end - in_next < 4) {
+				goto bad_data;
+			}
+			const size_t len = fd_load_le16(in_next);
+			const size_t nlen = fd_load_le16(in_next + 2);
+			in_next += 4;
+			if(len != (~nlen & 0xFFFF)) {
+				goto bad_data;
+			}
+			if(len > (size_t)(in_end - in_next)) {
+				goto bad_data;
+			}
+			if(len > (size_t)(out_end - out_next)) {
+				goto insufficient_space;
+			}
+			memcpy(out_next, in_next, len);
+			in_next += len;
+			out_next += len;
+			continue;
+		}
+
+		if(block_type == FD_BLOCKTYPE_STATIC) {
+			if(!d->static_codes_loaded) {
+				if(!load_static_codes(d)) {
+					goto bad_data;
+				}
+				d->static_codes_loaded = 1;
+			}
+		} else if(block_type == FD_BLOCKTYPE_DYNAMIC) {
+			d->static_codes_loaded = 0;
+
+			const unsigned num_litlen_syms = BITS(5) + 257;
+			REMOVE_BITS(5);
+			const unsigned num_offset_syms = BITS(5) + 1;
+			REMOVE_BITS(5);
+			const unsigned num_precode_syms = BITS(4) + 4;
+			REMOVE_BITS(4);
+			if((num_litlen_syms > 286) || (num_offset_syms > 30)) {
+				goto bad_data;
+			}
+
+			for(i = 0; i < FD_NUM_PRECODE_SYMS; i++) {
+				unsigned len = 0;
+				if(i < num_precode_syms) {
+					if(bitsleft < 3) {
+						REFILL_BITS();
+					}
+					len = BITS(3);
+					REMOVE_BITS(3);
+				}
+				d->precode_lens[fd_precode_permutation[i]] = (u8)len;
+			}
+			if(!build_decode_table(d->precode_table, PRECODE_TABLEBITS, PRECODE_ENOUGH, d->precode_lens, FD_NUM_PRECODE_SYMS, d->precode_entries, 1)) {
+				goto bad_data;
+			}
+
+			// the codeword lengths of both codes, run-length encoded with the precode
+			const unsigned num_lens = num_litlen_syms + num_offset_syms;
+			i = 0;
+			while(i < num_lens) {
+				if(bitsleft < PRECODE_TABLEBITS + 7) {
+					REFILL_BITS();
+				}
+				const u32 entry = d->precode_table[BITS(PRECODE_TABLEBITS)];
+				if(entry & ENTRY_INVALID) {
+					goto bad_data;
+				}
+				REMOVE_BITS(ENTRY_LENGTH(entry));
+				const unsigned sym = ENTRY_VALUE(entry);
+
+				if(sym < 16) {
+					d->lens[i++] = (u8)sym;
+					continue;
+				}
+
+				unsigned rep_val = 0;
+				unsigned rep_count;
+				if(sym == 16) {
+					if(i == 0) {
+						goto bad_data;
+					}
+					rep_val = d->lens[i - 1];
+					rep_count = 3 + BITS(2);
+					REMOVE_BITS(2);
+				} else if(sym == 17) {
+					rep_count = 3 + BITS(3);
+					REMOVE_BITS(3);
+				} else {
+					rep_count = 11 + BITS(7);
+					REMOVE_BITS(7);
+				}
+				if(rep_count > num_lens - i) {
+					goto bad_data;
+				}
+				memset(d->lens + i, (int)rep_val, rep_count);
+				i += rep_count;
+			}
+
+			if(d->lens[FD_END_OF_BLOCK] == 0) {
+				goto bad_data;
+			}
+			if(!build_decode_table(d->litlen_table, LITLEN_TABLEBITS, LITLEN_ENOUGH, d->lens, num_litlen_syms, d->litlen_entries, 0)) {
+				goto bad_data;
+			}
+			if(!build_decode_table(d->offset_table, OFFSET_TABLEBITS, OFFSET_ENOUGH, d->lens + num_litlen_syms, num_offset_syms, d->offset_entries, 0)) {
+				goto bad_data;
+			}
+		} else {
+			goto bad_data;
+		}
+
+		// Huffman coded data: a length, its extra bits, an offset and its extra bits take at most 48 bits
+		for(;;) {
+			if(bitsleft < 48) {
+				REFILL_BITS();
+			}
+
+			u32 entry = d->litlen_table[BITS(LITLEN_TABLEBITS)];
+			if(entry & ENTRY_SUBTABLE) {
+				REMOVE_BITS(LITLEN_TABLEBITS);
+				entry = d->litlen_table[ENTRY_VALUE(entry) + BITS(ENTRY_EXTRA(entry))];
+			}
+			REMOVE_BITS(ENTRY_LENGTH(entry));
+
+			if(entry & ENTRY_LITERAL) {
+				if(FD_UNLIKELY(out_next == out_end)) {
+					goto insufficient_space;
+				}
+				*out_next++ = (u8)ENTRY_VALUE(entry);
+				continue;
+			}
+			if(entry & (ENTRY_END_OF_BLOCK | ENTRY_INVALID)) {
+				if(entry & ENTRY_INVALID) {
+					goto bad_data;
+				}
+				break;
+			}
+
+			const size_t length = ENTRY_VALUE(entry) + BITS(ENTRY_EXTRA(entry));
+			REMOVE_BITS(ENTRY_EXTRA(entry));
+
+			entry = d->offset_table[BITS(OFFSET_TABLEBITS)];
+			if(entry & ENTRY_SUBTABLE) {
+				REMOVE_BITS(OFFSET_TABLEBITS);
+				entry = d->offset_table[ENTRY_VALUE(entry) + BITS(ENTRY_EXTRA(entry))];
+			}
+			REMOVE_BITS(ENTRY_LENGTH(entry));
+			if(entry & ENTRY_INVALID) {
+				goto bad_data;
+			}
+			const size_t offset = ENTRY_VALUE(entry) + BITS(ENTRY_EXTRA(entry));
+			REMOVE_BITS(ENTRY_EXTRA(entry));
+
+			if(FD_UNLIKELY(offset > (size_t)(out_next - out_begin))) {
+				goto bad_data;
+			}
+			if(FD_UNLIKELY(length > (size_t)(out_end - out_next))) {
+				goto insufficient_space;
+			}
+
+			u8 *dst = out_next;
+			const u8 *src = out_next - offset;
+			out_next += length;
+
+			if(FD_LIKELY((offset >= 8) && (out_end - out_next >= 8))) {
+				// word copies may write up to 7 bytes past the match, which is still in the buffer
+				do {
+					u64 v;
+					memcpy(&v, src, 8);
+					memcpy(dst, &v, 8);
+					src += 8;
+					dst += 8;
+				} while(dst < out_next);
+			} else if(offset == 1) {
+				memset(dst, *src, length);
+			} else {
+				do {
+					*dst++ = *src++;
+				} while(dst < out_next);
+			}
+		}
+	} while(!is_final);
+
+	// the rest of the last byte is padding, the whole bytes left in the bit buffer are not part of the stream
+	{
+		const size_t held = bitsleft >> 3;
+		if(overread > held) {
+			goto bad_data;
+		}
+		if(actual_in_nbytes_ret) {
+			*actual_in_nbytes_ret = (size_t)(in_next - (const u8 *)in) - (held - overread);
+		}
+	}
+
+	if(actual_out_nbytes_ret) {
+		*actual_out_nbytes_ret = (size_t)(out_next - out_begin);
+	} else if(out_next != out_end) {
+		return FASTDEFLATE_SHORT_OUTPUT;
+	}
+	return FASTDEFLATE_SUCCESS;
+
+bad_data:
+	return FASTDEFLATE_BAD_DATA;
+
+insufficient_space:
+	return FASTDEFLATE_INSUFFICIENT_SPACE;
+}
+
+// ----------------------------------------------------------
+//   Allocation
+// ----------------------------------------------------------
+
+struct fastdeflate_decompressor *
+fastdeflate_alloc_decompressor(void) {
+	struct fastdeflate_decompressor *d = (struct fastdeflate_decompressor *)malloc(sizeof(struct fastdeflate_decompressor));
+	unsigned sym;
+
+	if(!d) {
+		return NULL;
+	}
+
+	for(sym = 0; sym < FD_NUM_PRECODE_SYMS; sym++) {
+		d->precode_entries[sym] = MAKE_ENTRY(sym, 0);
+	}
+	for(sym = 0; sym < 256; sym++) {
+		d->litlen_entries[sym] = ENTRY_LITERAL | MAKE_ENTRY(sym, 0);
+	}
+	d->litlen_entries[FD_END_OF_BLOCK] = ENTRY_END_OF_BLOCK;
+	for(sym = 257; sym < 286; sym++) {
+		d->litlen_entries[sym] = MAKE_ENTRY(fd_length_base[sym - 257], fd_length_extra_bits[sym - 257]);
+	}
+	for(; sym < FD_NUM_LITLEN_SYMS; sym++) {
+		d->litlen_entries[sym] = ENTRY_INVALID;
+	}
+	for(sym = 0; sym < 30; sym++) {
+		d->offset_entries[sym] = MAKE_ENTRY(fd_offset_base[sym], fd_offset_extra_bits[sym]);
+	}
+	for(; sym < FD_NUM_OFFSET_SYMS; sym++) {
+		d->offset_entries[sym] = ENTRY_INVALID;
+	}
+	d->static_codes_loaded = 0;
+
+	return d;
+}
+
+void
+fastdeflate_free_decompressor(struct fastdeflate_decompressor *d) {
+	free(d);
+}
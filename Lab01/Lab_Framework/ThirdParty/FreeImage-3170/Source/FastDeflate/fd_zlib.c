@@ -0,0 +1,210 @@
+// ==========================================================
+// FastDeflate: ZLib and GZIP wrappers
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "fd_common.h"
+
+#define ZLIB_HEADER_SIZE	2
+#define ZLIB_TRAILER_SIZE	4
+#define ZLIB_CM_DEFLATE		8
+#define ZLIB_FDICT			0x20
+
+#define GZIP_HEADER_SIZE	10
+#define GZIP_TRAILER_SIZE	8
+#define GZIP_ID1			0x1F
+#define GZIP_ID2			0x8B
+#define GZIP_CM_DEFLATE		8
+#define GZIP_FHCRC			0x02
+#define GZIP_FEXTRA			0x04
+#define GZIP_FNAME			0x08
+#define GZIP_FCOMMENT		0x10
+#define GZIP_FRESERVED		0xE0
+#define GZIP_OS_UNKNOWN		255
+
+// ----------------------------------------------------------
+//   ZLib (RFC 1950)
+// ----------------------------------------------------------
+
+size_t
+fastdeflate_zlib_compress(struct fastdeflate_compressor *c, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail) {
+	u8 *p = (u8 *)out;
+	const int level = fd_compressor_level(c);
+
+	if(out_nbytes_avail < ZLIB_HEADER_SIZE + ZLIB_TRAILER_SIZE) {
+		return 0;
+	}
+
+	// CMF: deflate with a 32 KB window, FLG: level hint as ZLib writes it, and check bits
+	const unsigned level_hint = (level < 2) ? 0 : ((level < 6) ? 1 : ((level == 6) ? 2 : 3));
+	unsigned header = ((0x70 | ZLIB_CM_DEFLATE) << 8) | (level_hint << 6);
+	header += 31 - (header % 31);
+	p[0] = (u8)(header >> 8);
+	p[1] = (u8)header;
+
+	const size_t size = fastdeflate_deflate_compress(c, in, in_nbytes, p + ZLIB_HEADER_SIZE, out_nbytes_avail - ZLIB_HEADER_SIZE - ZLIB_TRAILER_SIZE);
+	if(size == 0) {
+		return 0;
+	}
+	fd_store_be32(p + ZLIB_HEADER_SIZE + size, fastdeflate_adler32(1, in, in_nbytes));
+
+	return ZLIB_HEADER_SIZE + size + ZLIB_TRAILER_SIZE;
+}
+
+size_t
+fastdeflate_zlib_compress_bound(struct fastdeflate_compressor *c, size_t in_nbytes) {
+	return ZLIB_HEADER_SIZE + fastdeflate_deflate_compress_bound(c, in_nbytes) + ZLIB_TRAILER_SIZE;
+}
+
+enum fastdeflate_result
+fastdeflate_zlib_decompress(struct fastdeflate_decompressor *d, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail, size_t *actual_out_nbytes_ret) {
+	const u8 *p = (const u8 *)in;
+	size_t actual_in = 0;
+	size_t actual_out = 0;
+
+	if(in_nbytes < ZLIB_HEADER_SIZE + ZLIB_TRAILER_SIZE) {
+		return FASTDEFLATE_BAD_DATA;
+	}
+	const unsigned header = ((unsigned)p[0] << 8) | p[1];
+	if(((p[0] & 0x0F) != ZLIB_CM_DEFLATE) || ((p[0] >> 4) > 7) || (header % 31 != 0) || (p[1] & ZLIB_FDICT)) {
+		return FASTDEFLATE_BAD_DATA;
+	}
+
+	const enum fastdeflate_result result = fastdeflate_deflate_decompress(d, p + ZLIB_HEADER_SIZE, in_nbytes - ZLIB_HEADER_SIZE - ZLIB_TRAILER_SIZE, out, out_nbytes_avail, &actual_in, actual_out_nbytes_ret ? &actual_out : NULL);
+	if(result != FASTDEFLATE_SUCCESS) {
+		return result;
+	}
+	if(!actual_out_nbytes_ret) {
+		actual_out = out_nbytes_avail;
+	}
+	if(fd_load_be32(p + ZLIB_HEADER_SIZE + actual_in) != fastdeflate_adler32(1, out, actual_out)) {
+		return FASTDEFLATE_BAD_DATA;
+	}
+	if(actual_out_nbytes_ret) {
+		*actual_out_nbytes_ret = actual_out;
+	}
+	return FASTDEFLATE_SUCCESS;
+}
+
+// ----------------------------------------------------------
+//   GZIP (RFC 1952)
+// ----------------------------------------------------------
+
+size_t
+fastdeflate_gzip_compress(struct fastdeflate_compressor *c, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail) {
+	u8 *p = (u8 *)out;
+	const int level = fd_compressor_level(c);
+
+	if(out_nbytes_avail < GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE) {
+		return 0;
+	}
+
+	// no file name nor time stamp, XFL tells the slowest and fastest levels as ZLib does
+	p[0] = GZIP_ID1;
+	p[1] = GZIP_ID2;
+	p[2] = GZIP_CM_DEFLATE;
+	p[3] = 0;
+	fd_store_le32(p + 4, 0);
+	p[8] = (level == 9) ? 2 : ((level == 1) ? 4 : 0);
+	p[9] = GZIP_OS_UNKNOWN;
+
+	const size_t size = fastdeflate_deflate_compress(c, in, in_nbytes, p + GZIP_HEADER_SIZE, out_nbytes_avail - GZIP_HEADER_SIZE - GZIP_TRAILER_SIZE);
+	if(size == 0) {
+		return 0;
+	}
+	fd_store_le32(p + GZIP_HEADER_SIZE + size, fastdeflate_crc32(0, in, in_nbytes));
+	fd_store_le32(p + GZIP_HEADER_SIZE + size + 4, (u32)in_nbytes);
+
+	return GZIP_HEADER_SIZE + size + GZIP_TRAILER_SIZE;
+}
+
+size_t
+fastdeflate_gzip_compress_bound(struct fastdeflate_compressor *c, size_t in_nbytes) {
+	return GZIP_HEADER_SIZE + fastdeflate_deflate_compress_bound(c, in_nbytes) + GZIP_TRAILER_SIZE;
+}
+
+enum fastdeflate_result
+fastdeflate_gzip_decompress(struct fastdeflate_decompressor *d, const void *in, size_t in_nbytes, void *out, size_t out_nbytes_avail, size_t *actual_out_nbytes_ret) {
+	const u8 *p = (const u8 *)in;
+	const u8 * const in_end = p + in_nbytes;
+	size_t actual_in = 0;
+	size_t actual_out = 0;
+
+	if(in_nbytes < GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE) {
+		return FASTDEFLATE_BAD_DATA;
+	}
+	const unsigned flags = p[3];
+	if((p[0] != GZIP_ID1) || (p[1] != GZIP_ID2) || (p[2] != GZIP_CM_DEFLATE) || (flags & GZIP_FRESERVED)) {
+		return FASTDEFLATE_BAD_DATA;
+	}
+	p += GZIP_HEADER_SIZE;
+
+	// optional fields, each of which must leave room for the trailer
+	if(flags & GZIP_FEXTRA) {
+		if(in_end - p < 2) {
+			return FASTDEFLATE_BAD_DATA;
+		}
+		const size_t xlen = fd_load_le16(p);
+		p += 2;
+		if((size_t)(in_end - p) < xlen + GZIP_TRAILER_SIZE) {
+			return FASTDEFLATE_BAD_DATA;
+		}
+		p += xlen;
+	}
+	if(flags & GZIP_FNAME) {
+		while((p < in_end) && (*p != 0)) {
+			p++;
+		}
+		if(in_end - p < 1 + GZIP_TRAILER_SIZE) {
+			return FASTDEFLATE_BAD_DATA;
+		}
+		p++;
+	}
+	if(flags & GZIP_FCOMMENT) {
+		while((p < in_end) && (*p != 0)) {
+			p++;
+		}
+		if(in_end - p < 1 + GZIP_TRAILER_SIZE) {
+			return FASTDEFLATE_BAD_DATA;
+		}
+		p++;
+	}
+	if(flags & GZIP_FHCRC) {
+		if(in_end - p < 2 + GZIP_TRAILER_SIZE) {
+			return FASTDEFLATE_BAD_DATA;
+		}
+		p += 2;
+	}
+	if(in_end - p < GZIP_TRAILER_SIZE) {
+		return FASTDEFLATE_BAD_DATA;
+	}
+
+	const enum fastdeflate_result result = fastdeflate_deflate_decompress(d, p, (size_t)(in_end - p) - GZIP_TRAILER_SIZE, out, out_nbytes_avail, &actual_in, actual_out_nbytes_ret ? &actual_out : NULL);
+	if(result != FASTDEFLATE_SUCCESS) {
+		return result;
+	}
+	if(!actual_out_nbytes_ret) {
+		actual_out = out_nbytes_avail;
+	}
+	p += actual_in;
+	if((fd_load_le32(p) != fastdeflate_crc32(0, out, actual_out)) || (fd_load_le32(p + 4) != (u32)actual_out)) {
+		return FASTDEFLATE_BAD_DATA;
+	}
+	if(actual_out_nbytes_ret) {
+		*actual_out_nbytes_ret = actual_out;
+	}
+	return FASTDEFLATE_SUCCESS;
+}
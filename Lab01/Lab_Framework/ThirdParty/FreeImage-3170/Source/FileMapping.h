@@ -0,0 +1,75 @@
+// ==========================================================
+// Memory-mapped file access
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FILEMAPPING_H
+#define FILEMAPPING_H
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+
+/**
+A region of a file mapped into memory.<br>
+A read-only mapping is copy-on-write: pages written by the process are
+private to the mapping and never reach the file. A read-write mapping
+is shared with the file, which is created or extended when needed.
+*/
+class FileMapping {
+public:
+	FileMapping();
+	~FileMapping();
+
+	/**
+	Map 'size' bytes of a file, starting at byte 'offset' (any value is accepted).
+	@return Returns TRUE if successful, FALSE otherwise
+	*/
+	BOOL open(const char *filename, UINT64 offset, size_t size, BOOL read_only);
+	/**
+	Unicode version of open (Windows only, returns FALSE on other platforms)
+	*/
+	BOOL openU(const wchar_t *filename, UINT64 offset, size_t size, BOOL read_only);
+	/**
+	Unmap the file. Pages modified through a read-write mapping are written back by the system.
+	*/
+	void close();
+
+	/// Returns the first mapped byte (the byte at 'offset' in the file), or NULL if nothing is mapped
+	BYTE *data() const {
+		return m_data;
+	}
+	/// Returns the number of bytes mapped from 'offset'
+	size_t size() const {
+		return m_size;
+	}
+
+private:
+	/// Start of the view, aligned on the system allocation granularity
+	void *m_view;
+	/// Length of the view
+	size_t m_view_size;
+	/// First byte requested by the user
+	BYTE *m_data;
+	/// Number of bytes requested by the user
+	size_t m_size;
+
+	// not copyable
+	FileMapping(const FileMapping&);
+	FileMapping& operator=(const FileMapping&);
+};
+
+#endif // FILEMAPPING_H
@@ -121,6 +121,8 @@
 
 FI_STRUCT (FIBITMAP) { void *data; };
 FI_STRUCT (FIMULTIBITMAP) { void *data; };
+FI_STRUCT (FISCANREADER) { void *data; };
+FI_STRUCT (FISCANWRITER) { void *data; };
 
 // Types used in the library (directly copied from Windows) -----------------
 
@@ -376,6 +378,34 @@ FI_STRUCT (FIICCPROFILE) {
 	void   *data;	//! points to a block of contiguous memory containing the profile
 };
 
+// Memory pool support ------------------------------------------------------
+
+FI_STRUCT (FIMEMORYPOOLSTATS) {
+	UINT64 requests;		//! number of pixel buffers allocated
+	UINT64 hits;			//! number of requests served from the pool
+	UINT64 thread_hits;		//! number of hits served by a thread cache, without going to the shared pool
+	UINT64 bytes_retained;	//! bytes held by the pool, ready for reuse
+	UINT64 bytes_in_use;	//! bytes currently used by bitmaps
+};
+
+// Deflate backend support --------------------------------------------------
+
+typedef DWORD (DLL_CALLCONV *FI_DeflateCompressProc)(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size, int level);
+typedef DWORD (DLL_CALLCONV *FI_DeflateUncompressProc)(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size);
+typedef DWORD (DLL_CALLCONV *FI_DeflateChecksumProc)(DWORD value, const BYTE *source, DWORD source_size);
+
+/**
+Whole buffer deflate codec used by the ZLib interface.
+Compressed buffers use the ZLib format (RFC 1950). Procs return the number of bytes
+written to target, or 0 if an error occured; level ranges from 0 (stored) to 9 (smallest).
+*/
+FI_STRUCT (FIDEFLATEBACKEND) {
+	const char *name;						//! backend name, reported by FreeImage_GetDeflateBackend
+	FI_DeflateCompressProc compress_proc;
+	FI_DeflateUncompressProc uncompress_proc;
+	FI_DeflateChecksumProc crc32_proc;		//! CRC-32 as used by ZLib, starting from 0
+};
+
 // Important enums ----------------------------------------------------------
 
 /** I/O image format identifiers.
@@ -639,6 +669,12 @@ typedef BOOL (DLL_CALLCONV *FI_SupportsExportBPPProc)(int bpp);
 typedef BOOL (DLL_CALLCONV *FI_SupportsExportTypeProc)(FREE_IMAGE_TYPE type);
 typedef BOOL (DLL_CALLCONV *FI_SupportsICCProfilesProc)(void);
 typedef BOOL (DLL_CALLCONV *FI_SupportsNoPixelsProc)(void);
+typedef void *(DLL_CALLCONV *FI_OpenScanlineReaderProc)(FreeImageIO *io, fi_handle handle, int flags, FIBITMAP **info);
+typedef unsigned (DLL_CALLCONV *FI_ReadScanlinesProc)(void *reader, BYTE *bits, unsigned pitch, unsigned count);
+typedef void (DLL_CALLCONV *FI_CloseScanlineReaderProc)(void *reader);
+typedef void *(DLL_CALLCONV *FI_OpenScanlineWriterProc)(FreeImageIO *io, fi_handle handle, FIBITMAP *info, int flags);
+typedef BOOL (DLL_CALLCONV *FI_WriteScanlinesProc)(void *writer, BYTE *bits, unsigned pitch, unsigned count);
+typedef BOOL (DLL_CALLCONV *FI_CloseScanlineWriterProc)(void *writer);
 
 FI_STRUCT (Plugin) {
 	FI_FormatProc format_proc;
@@ -657,6 +693,12 @@ FI_STRUCT (Plugin) {
 	FI_SupportsExportTypeProc supports_export_type_proc;
 	FI_SupportsICCProfilesProc supports_icc_profiles_proc;
 	FI_SupportsNoPixelsProc supports_no_pixels_proc;
+	FI_OpenScanlineReaderProc open_scanline_reader_proc;
+	FI_ReadScanlinesProc read_scanlines_proc;
+	FI_CloseScanlineReaderProc close_scanline_reader_proc;
+	FI_OpenScanlineWriterProc open_scanline_writer_proc;
+	FI_WriteScanlinesProc write_scanlines_proc;
+	FI_CloseScanlineWriterProc close_scanline_writer_proc;
 };
 
 typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
@@ -708,6 +750,7 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define JPEG_SUBSAMPLING_444 0x10000	//! save with no chroma subsampling (4:4:4)
 #define JPEG_OPTIMIZE		0x20000		//! on saving, compute optimal Huffman coding tables (can reduce a few percent of file size)
 #define JPEG_BASELINE		0x40000		//! save basic JPEG, without metadata or any markers
+#define JPEG_RESTART		0x80000		//! save with a restart marker after each row of MCUs (allows images to be decoded and encoded in parallel stripes)
 #define KOALA_DEFAULT       0
 #define LBM_DEFAULT         0
 #define MNG_DEFAULT         0
@@ -735,7 +778,7 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define RAW_DEFAULT         0		//! load the file as linear RGB 48-bit
 #define RAW_PREVIEW			1		//! try to load the embedded JPEG preview with included Exif Data or default to RGB 24-bit
 #define RAW_DISPLAY			2		//! load the file as RGB 24-bit
-#define RAW_HALFSIZE		4		//! output a half-size color image
+#define RAW_HALFSIZE		4		//! output a half-size color image (no demosaicing, fastest)
 #define RAW_UNPROCESSED		8		//! output a FIT_UINT16 raw Bayer image
 #define SGI_DEFAULT			0
 #define TARGA_DEFAULT       0
@@ -801,12 +844,25 @@ DLL_API void DLL_CALLCONV FreeImage_SetOutputMessageStdCall(FreeImage_OutputMess
 DLL_API void DLL_CALLCONV FreeImage_SetOutputMessage(FreeImage_OutputMessageFunction omf);
 DLL_API void DLL_CALLCONV FreeImage_OutputMessageProc(int fif, const char *fmt, ...);
 
+// Multithreading routines --------------------------------------------------
+
+DLL_API void DLL_CALLCONV FreeImage_SetThreadCount(int count);
+DLL_API int DLL_CALLCONV FreeImage_GetThreadCount(void);
+
+// Memory pool routines -----------------------------------------------------
+
+DLL_API void DLL_CALLCONV FreeImage_SetMemoryPool(BOOL enable, unsigned max_retained_mb FI_DEFAULT(256));
+DLL_API void DLL_CALLCONV FreeImage_PurgeMemoryPool(void);
+DLL_API void DLL_CALLCONV FreeImage_GetMemoryPoolStats(FIMEMORYPOOLSTATS *stats);
+
 // Allocate / Clone / Unload routines ---------------------------------------
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Allocate(int width, int height, int bpp, unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateT(FREE_IMAGE_TYPE type, int width, int height, int bpp FI_DEFAULT(8), unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
 DLL_API FIBITMAP * DLL_CALLCONV FreeImage_Clone(FIBITMAP *dib);
 DLL_API void DLL_CALLCONV FreeImage_Unload(FIBITMAP *dib);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MapRawFile(const char *filename, UINT64 offset, unsigned pitch, BOOL read_only, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MapRawFileU(const wchar_t *filename, UINT64 offset, unsigned pitch, BOOL read_only, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
 
 // Header loading routines
 DLL_API BOOL DLL_CALLCONV FreeImage_HasPixels(FIBITMAP *dib);
@@ -820,6 +876,20 @@ DLL_API BOOL DLL_CALLCONV FreeImage_Save(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, c
 DLL_API BOOL DLL_CALLCONV FreeImage_SaveU(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const wchar_t *filename, int flags FI_DEFAULT(0));
 DLL_API BOOL DLL_CALLCONV FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
 
+// Scanline streaming routines ---------------------------------------------
+
+DLL_API FISCANREADER *DLL_CALLCONV FreeImage_OpenScanlineReader(FREE_IMAGE_FORMAT fif, const char *filename, int flags FI_DEFAULT(0));
+DLL_API FISCANREADER *DLL_CALLCONV FreeImage_OpenScanlineReaderU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags FI_DEFAULT(0));
+DLL_API FISCANREADER *DLL_CALLCONV FreeImage_OpenScanlineReaderFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetScanlineReaderInfo(FISCANREADER *reader);
+DLL_API unsigned DLL_CALLCONV FreeImage_ReadScanlines(FISCANREADER *reader, BYTE *bits, unsigned pitch, unsigned count);
+DLL_API void DLL_CALLCONV FreeImage_CloseScanlineReader(FISCANREADER *reader);
+DLL_API FISCANWRITER *DLL_CALLCONV FreeImage_OpenScanlineWriter(FREE_IMAGE_FORMAT fif, const char *filename, FIBITMAP *info, int flags FI_DEFAULT(0));
+DLL_API FISCANWRITER *DLL_CALLCONV FreeImage_OpenScanlineWriterU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, FIBITMAP *info, int flags FI_DEFAULT(0));
+DLL_API FISCANWRITER *DLL_CALLCONV FreeImage_OpenScanlineWriterToHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FIBITMAP *info, int flags FI_DEFAULT(0));
+DLL_API BOOL DLL_CALLCONV FreeImage_WriteScanlines(FISCANWRITER *writer, BYTE *bits, unsigned pitch, unsigned count);
+DLL_API BOOL DLL_CALLCONV FreeImage_CloseScanlineWriter(FISCANWRITER *writer);
+
 // Memory I/O stream routines -----------------------------------------------
 
 DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMemory(BYTE *data FI_DEFAULT(0), DWORD size_in_bytes FI_DEFAULT(0));
@@ -864,6 +934,7 @@ DLL_API FIMULTIBITMAP * DLL_CALLCONV FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT
 DLL_API FIMULTIBITMAP * DLL_CALLCONV FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
 DLL_API BOOL DLL_CALLCONV FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
 DLL_API BOOL DLL_CALLCONV FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags FI_DEFAULT(0));
+DLL_API void DLL_CALLCONV FreeImage_SetMultiBitmapCacheSize(unsigned max_bytes);
 DLL_API int DLL_CALLCONV FreeImage_GetPageCount(FIMULTIBITMAP *bitmap);
 DLL_API void DLL_CALLCONV FreeImage_AppendPage(FIMULTIBITMAP *bitmap, FIBITMAP *data);
 DLL_API void DLL_CALLCONV FreeImage_InsertPage(FIMULTIBITMAP *bitmap, int page, FIBITMAP *data);
@@ -872,6 +943,8 @@ DLL_API FIBITMAP * DLL_CALLCONV FreeImage_LockPage(FIMULTIBITMAP *bitmap, int pa
 DLL_API void DLL_CALLCONV FreeImage_UnlockPage(FIMULTIBITMAP *bitmap, FIBITMAP *data, BOOL changed);
 DLL_API BOOL DLL_CALLCONV FreeImage_MovePage(FIMULTIBITMAP *bitmap, int target, int source);
 DLL_API BOOL DLL_CALLCONV FreeImage_GetLockedPageNumbers(FIMULTIBITMAP *bitmap, int *pages, int *count);
+DLL_API BOOL DLL_CALLCONV FreeImage_PrefetchPages(FIMULTIBITMAP *bitmap, int first, int count, unsigned max_bytes FI_DEFAULT(0));
+DLL_API void DLL_CALLCONV FreeImage_CancelPrefetch(FIMULTIBITMAP *bitmap);
 
 // Filetype request routines ------------------------------------------------
 
@@ -984,6 +1057,8 @@ DLL_API void DLL_CALLCONV FreeImage_ConvertLine8To32(BYTE *target, BYTE *source,
 DLL_API void DLL_CALLCONV FreeImage_ConvertLine16To32_555(BYTE *target, BYTE *source, int width_in_pixels);
 DLL_API void DLL_CALLCONV FreeImage_ConvertLine16To32_565(BYTE *target, BYTE *source, int width_in_pixels);
 DLL_API void DLL_CALLCONV FreeImage_ConvertLine24To32(BYTE *target, BYTE *source, int width_in_pixels);
+DLL_API void DLL_CALLCONV FreeImage_ConvertLineHalfToFloat(float *target, const WORD *source, int count);
+DLL_API void DLL_CALLCONV FreeImage_ConvertLineFloatToHalf(WORD *target, const float *source, int count);
 
 // Smart conversion routines ------------------------------------------------
 
@@ -1022,13 +1097,20 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_TmoReinhard05Ex(FIBITMAP *src, double i
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_TmoFattal02(FIBITMAP *src, double color_saturation FI_DEFAULT(0.5), double attenuation FI_DEFAULT(0.85));
 
+DLL_API void DLL_CALLCONV FreeImage_SetToneMappingFastMath(BOOL enable);
+DLL_API BOOL DLL_CALLCONV FreeImage_GetToneMappingFastMath(void);
+
 // ZLib interface -----------------------------------------------------------
 
 DLL_API DWORD DLL_CALLCONV FreeImage_ZLibCompress(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size);
+DLL_API DWORD DLL_CALLCONV FreeImage_ZLibCompressLevel(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size, int level);
 DLL_API DWORD DLL_CALLCONV FreeImage_ZLibUncompress(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size);
 DLL_API DWORD DLL_CALLCONV FreeImage_ZLibGZip(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size);
 DLL_API DWORD DLL_CALLCONV FreeImage_ZLibGUnzip(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size);
 DLL_API DWORD DLL_CALLCONV FreeImage_ZLibCRC32(DWORD crc, BYTE *source, DWORD source_size);
+DLL_API BOOL DLL_CALLCONV FreeImage_SetDeflateBackend(const FIDEFLATEBACKEND *backend);
+DLL_API const char *DLL_CALLCONV FreeImage_GetDeflateBackend(void);
+DLL_API const FIDEFLATEBACKEND *DLL_CALLCONV FreeImage_FindDeflateBackend(const char *name);
 
 // --------------------------------------------------------------------------
 // Metadata routines
@@ -1086,6 +1168,10 @@ DLL_API BOOL DLL_CALLCONV FreeImage_JPEGTransformCombined(const char *src_file,
 DLL_API BOOL DLL_CALLCONV FreeImage_JPEGTransformCombinedU(const wchar_t *src_file, const wchar_t *dst_file, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, BOOL perfect FI_DEFAULT(TRUE));
 DLL_API BOOL DLL_CALLCONV FreeImage_JPEGTransformCombinedFromMemory(FIMEMORY* src_stream, FIMEMORY* dst_stream, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, BOOL perfect FI_DEFAULT(TRUE));
 
+// JPEG decoder settings
+DLL_API void DLL_CALLCONV FreeImage_SetJPEGSIMD(BOOL enable);
+DLL_API BOOL DLL_CALLCONV FreeImage_GetJPEGSIMD(void);
+
 
 // --------------------------------------------------------------------------
 // Image manipulation toolkit
@@ -1103,6 +1189,10 @@ DLL_API BOOL DLL_CALLCONV FreeImage_FlipVertical(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rescale(FIBITMAP *dib, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert FI_DEFAULT(TRUE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleRect(FIBITMAP *dib, int dst_width, int dst_height, int left, int top, int right, int bottom, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+DLL_API BOOL DLL_CALLCONV FreeImage_RescaleInto(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadScaled(FREE_IMAGE_FORMAT fif, const char *filename, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadScaledU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadScaledFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), int flags FI_DEFAULT(0));
 
 // color manipulation routines (point operations)
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustCurve(FIBITMAP *dib, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
@@ -1127,10 +1217,12 @@ DLL_API BOOL DLL_CALLCONV FreeImage_SetComplexChannel(FIBITMAP *dst, FIBITMAP *s
 // copy / paste / composite routines
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Copy(FIBITMAP *dib, int left, int top, int right, int bottom);
 DLL_API BOOL DLL_CALLCONV FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha);
+DLL_API BOOL DLL_CALLCONV FreeImage_PasteWithAlpha(FIBITMAP *dst, FIBITMAP *src, int left, int top, BOOL premultiplied FI_DEFAULT(FALSE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom);
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg FI_DEFAULT(FALSE), RGBQUAD *appBkColor FI_DEFAULT(NULL), FIBITMAP *bg FI_DEFAULT(NULL));
 DLL_API BOOL DLL_CALLCONV FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib);
+DLL_API BOOL DLL_CALLCONV FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib);
 
 // background filling routines
 DLL_API BOOL DLL_CALLCONV FreeImage_FillBackground(FIBITMAP *dib, const void *color, int options FI_DEFAULT(0));
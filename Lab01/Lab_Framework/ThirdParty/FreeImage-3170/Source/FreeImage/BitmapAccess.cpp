@@ -37,6 +37,7 @@
 #include "FreeImageIO.h"
 #include "Utilities.h"
 #include "MapIntrospector.h"
+#include "FileMapping.h"
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -116,6 +117,8 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	BYTE *external_bits;
 	/** user provided pitch, 0 otherwise */
 	unsigned external_pitch;
+	/** file mapping owning the external pixels, NULL otherwise */
+	FileMapping *external_mapping;
 	//@}
 
 	//BYTE filler[1];			 // fill to 32-bit alignment
@@ -387,7 +390,7 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 			return NULL;
 		}
 
-		bitmap->data = (BYTE *)FreeImage_Aligned_Malloc(dib_size * sizeof(BYTE), FIBITMAP_ALIGNMENT);
+		bitmap->data = (BYTE *)FreeImage_Pool_Malloc(dib_size * sizeof(BYTE));
 
 		if (bitmap->data != NULL) {
 			memset(bitmap->data, 0, dib_size);
@@ -425,6 +428,7 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 
 			fih->external_bits = ext_bits;
 			fih->external_pitch = ext_pitch;
+			fih->external_mapping = NULL;
 
 			// write out the BITMAPINFOHEADER
 
@@ -492,6 +496,88 @@ FreeImage_AllocateT(FREE_IMAGE_TYPE type, int width, int height, int bpp, unsign
 	return FreeImage_AllocateBitmap(FALSE, NULL, 0, type, width, height, bpp, red_mask, green_mask, blue_mask);
 }
 
+// ----------------------------------------------------------
+
+/**
+Wrap the pixels of an opened file mapping into a FIBITMAP, which takes ownership of the mapping.
+@return Returns the new FIBITMAP, or NULL if it failed (the mapping is then deleted)
+*/
+static FIBITMAP *
+AllocateHeaderForMapping(FileMapping *mapping, unsigned pitch, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
+	FIBITMAP *dib = FreeImage_AllocateBitmap(FALSE, mapping->data(), pitch, type, width, height, bpp, red_mask, green_mask, blue_mask);
+	if (!dib) {
+		delete mapping;
+		return NULL;
+	}
+	((FREEIMAGEHEADER *)dib->data)->external_mapping = mapping;
+	return dib;
+}
+
+/**
+Compute the pitch and the number of bytes used by a raw pixel buffer.
+@return Returns FALSE if the pitch is too small or if the arguments are invalid
+*/
+static BOOL
+GetRawBitsSize(unsigned *pitch, int width, int height, int bpp, size_t *size) {
+	if ((width <= 0) || (height <= 0) || (bpp <= 0)) {
+		return FALSE;
+	}
+	const unsigned line = (unsigned)(((UINT64)width * bpp + 7) / 8);
+	if (*pitch == 0) {
+		// same pitch as a FreeImage allocated bitmap
+		*pitch = (line + 3) & ~3;
+	}
+	if (*pitch < line) {
+		return FALSE;
+	}
+	const UINT64 total = (UINT64)*pitch * (height - 1) + line;
+	if (total != (size_t)total) {
+		return FALSE;
+	}
+	*size = (size_t)total;
+	return TRUE;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_MapRawFile(const char *filename, UINT64 offset, unsigned pitch, BOOL read_only, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
+	size_t size = 0;
+	if (!GetRawBitsSize(&pitch, width, height, bpp, &size)) {
+		return NULL;
+	}
+
+	FileMapping *mapping = new(std::nothrow) FileMapping;
+	if (!mapping) {
+		return NULL;
+	}
+	if (!mapping->open(filename, offset, size, read_only)) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FreeImage_MapRawFile: failed to map %s", filename);
+		delete mapping;
+		return NULL;
+	}
+
+	return AllocateHeaderForMapping(mapping, pitch, type, width, height, bpp, red_mask, green_mask, blue_mask);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_MapRawFileU(const wchar_t *filename, UINT64 offset, unsigned pitch, BOOL read_only, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
+	size_t size = 0;
+	if (!GetRawBitsSize(&pitch, width, height, bpp, &size)) {
+		return NULL;
+	}
+
+	FileMapping *mapping = new(std::nothrow) FileMapping;
+	if (!mapping) {
+		return NULL;
+	}
+	if (!mapping->openU(filename, offset, size, read_only)) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FreeImage_MapRawFileU: failed to map input file");
+		delete mapping;
+		return NULL;
+	}
+
+	return AllocateHeaderForMapping(mapping, pitch, type, width, height, bpp, red_mask, green_mask, blue_mask);
+}
+
 void DLL_CALLCONV
 FreeImage_Unload(FIBITMAP *dib) {
 	if (NULL != dib) {	
@@ -522,8 +608,11 @@ FreeImage_Unload(FIBITMAP *dib) {
 			// delete embedded thumbnail
 			FreeImage_Unload(FreeImage_GetThumbnail(dib));
 
+			// unmap a file backed pixel buffer
+			delete ((FREEIMAGEHEADER *)dib->data)->external_mapping;
+
 			// delete bitmap ...
-			FreeImage_Aligned_Free(dib->data);
+			FreeImage_Pool_Free(dib->data);
 		}
 
 		free(dib);		// ... and the wrapper
@@ -585,6 +674,11 @@ FreeImage_Clone(FIBITMAP *dib) {
 		// reset thumbnail link for new_dib
 		((FREEIMAGEHEADER *)new_dib->data)->thumbnail = NULL;
 
+		// reset external pixels link for new_dib (the clone owns its pixels)
+		((FREEIMAGEHEADER *)new_dib->data)->external_bits = NULL;
+		((FREEIMAGEHEADER *)new_dib->data)->external_pitch = 0;
+		((FREEIMAGEHEADER *)new_dib->data)->external_mapping = NULL;
+
 		// copy possible ICC profile
 		FreeImage_CreateICCProfile(new_dib, src_iccProfile->data, src_iccProfile->size);
 		dst_iccProfile->flags = src_iccProfile->flags;
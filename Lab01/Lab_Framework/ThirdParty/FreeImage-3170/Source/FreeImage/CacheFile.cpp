@@ -26,28 +26,58 @@
 
 #include "CacheFile.h"
 
+#include <atomic>
+
+// ----------------------------------------------------------
+
+/// Number of bytes mapped by a window
+static const size_t WINDOW_SIZE = (size_t)WINDOW_BLOCKS * BLOCK_SIZE;
+
+/// Number of bytes of the cache files mapped in memory, set by FreeImage_SetMultiBitmapCacheSize
+static std::atomic<unsigned> s_cache_budget(CACHE_DEFAULT_BUDGET);
+
+void DLL_CALLCONV
+FreeImage_SetMultiBitmapCacheSize(unsigned max_bytes) {
+	s_cache_budget = (max_bytes != 0) ? max_bytes : CACHE_DEFAULT_BUDGET;
+}
+
 // ----------------------------------------------------------
 
 CacheFile::CacheFile(const std::string filename, BOOL keep_in_memory) :
-m_file(NULL),
 m_filename(filename),
-m_free_pages(),
-m_page_cache_mem(),
-m_page_cache_disk(),
-m_page_map(),
-m_page_count(0),
-m_current_block(NULL),
-m_keep_in_memory(keep_in_memory) {
+m_keep_in_memory(keep_in_memory),
+m_mappings(NULL),
+m_max_windows(0),
+m_lru_head(-1),
+m_lru_tail(-1) {
 }
 
 CacheFile::~CacheFile() {
+	close();
 }
 
 BOOL
 CacheFile::open() {
+	// block 0 is never used, so that 0 can end a chain of blocks
+	m_next.assign(1, 0);
+
 	if ((!m_filename.empty()) && (!m_keep_in_memory)) {
-		m_file = fopen(m_filename.c_str(), "w+b");
-		return (m_file != NULL);
+		// create an empty file, it grows (sparsely where supported) as windows are mapped
+		FILE *file = fopen(m_filename.c_str(), "w+b");
+		if (!file) {
+			return FALSE;
+		}
+		fclose(file);
+
+		m_max_windows = MAX((int)(s_cache_budget / WINDOW_SIZE), 2);
+		m_mappings = new(std::nothrow) FileMapping[m_max_windows];
+		if (!m_mappings) {
+			remove(m_filename.c_str());
+			return FALSE;
+		}
+		m_windows.reserve(m_max_windows);
+
+		return TRUE;
 	}
 
 	return (m_keep_in_memory == TRUE);
@@ -55,161 +85,171 @@ CacheFile::open() {
 
 void
 CacheFile::close() {
-	// dispose the cache entries
-
-	while (!m_page_cache_disk.empty()) {
-		Block *block = *m_page_cache_disk.begin();
-		m_page_cache_disk.pop_front();
-		delete [] block->data;
-		delete block;
-	}
-	while (!m_page_cache_mem.empty()) { 
-		Block *block = *m_page_cache_mem.begin(); 
-		m_page_cache_mem.pop_front(); 
-		delete [] block->data; 
-		delete block; 
-	} 
-
-	if (m_file) {
-		// close the file
+	// dispose the windows
 
-		fclose(m_file);
+	if (m_mappings) {
+		delete [] m_mappings;
+		m_mappings = NULL;
 
 		// delete the file
 
 		remove(m_filename.c_str());
+	} else {
+		for (size_t i = 0; i < m_windows.size(); i++) {
+			free(m_windows[i].data);
+		}
 	}
-}
 
-void
-CacheFile::cleanupMemCache() {
-	if (!m_keep_in_memory) {
-		if (m_page_cache_mem.size() > CACHE_SIZE) {
-			// flush the least used block to file
+	m_windows.clear();
+	m_window_slots.clear();
+	m_next.clear();
+	m_free_blocks.clear();
+	m_lru_head = m_lru_tail = -1;
+}
 
-			Block *old_block = m_page_cache_mem.back();
-			fseek(m_file, old_block->nr * BLOCK_SIZE, SEEK_SET);
-			fwrite(old_block->data, BLOCK_SIZE, 1, m_file);
+// ----------------------------------------------------------
 
-			// remove the data
+void
+CacheFile::unlinkWindow(int slot) {
+	Window &window = m_windows[slot];
 
-			delete [] old_block->data;
-			old_block->data = NULL;
+	if (window.prev != -1) {
+		m_windows[window.prev].next = window.next;
+	} else {
+		m_lru_head = window.next;
+	}
+	if (window.next != -1) {
+		m_windows[window.next].prev = window.prev;
+	} else {
+		m_lru_tail = window.prev;
+	}
+	window.prev = window.next = -1;
+}
 
-			// move the block to another list
+void
+CacheFile::linkWindow(int slot) {
+	// insert the window at the front of the LRU list
+
+	Window &window = m_windows[slot];
+	window.prev = -1;
+	window.next = m_lru_head;
+	if (m_lru_head != -1) {
+		m_windows[m_lru_head].prev = slot;
+	}
+	m_lru_head = slot;
+	if (m_lru_tail == -1) {
+		m_lru_tail = slot;
+	}
+}
 
-			m_page_cache_disk.splice(m_page_cache_disk.begin(), m_page_cache_mem, --m_page_cache_mem.end());
-			m_page_map[old_block->nr] = m_page_cache_disk.begin();
-		}
+void
+CacheFile::touchWindow(int slot) {
+	if (m_lru_head != slot) {
+		unlinkWindow(slot);
+		linkWindow(slot);
 	}
 }
 
 int
-CacheFile::allocateBlock() {
-	Block *block = new Block;
-	block->data = new BYTE[BLOCK_SIZE];
-	block->next = 0;
+CacheFile::mapWindow(unsigned id) {
+	int slot = -1;
+
+	if (m_mappings) {
+		if ((int)m_windows.size() < m_max_windows) {
+			slot = (int)m_windows.size();
+		} else {
+			// unmap the least recently used window, the system writes it back to the file
+
+			slot = m_lru_tail;
+			m_window_slots[m_windows[slot].id] = -1;
+			m_mappings[slot].close();
+		}
 
-	if (!m_free_pages.empty()) {
-		block->nr = *m_free_pages.begin();
-		m_free_pages.pop_front();
+		if (!m_mappings[slot].open(m_filename.c_str(), (UINT64)id * WINDOW_SIZE, WINDOW_SIZE, FALSE)) {
+			// an unmapped slot stays at the end of the LRU list, to be used first
+			return -1;
+		}
 	} else {
-		block->nr = m_page_count++;
+		slot = (int)m_windows.size();
 	}
 
-	m_page_cache_mem.push_front(block);
-	m_page_map[block->nr] = m_page_cache_mem.begin();
-
-	cleanupMemCache();
-
-	return block->nr;
-}
-
-Block *
-CacheFile::lockBlock(int nr) {
-	if (m_current_block == NULL) {
-		PageMapIt it = m_page_map.find(nr);
-
-		if (it != m_page_map.end()) {
-			m_current_block = *(it->second);
-
-			// the block is swapped out to disc. load it back
-			// and remove the block from the cache. it might get cached
-			// again as soon as the memory buffer fills up
-
-			if (m_current_block->data == NULL) {
-				m_current_block->data = new BYTE[BLOCK_SIZE];
+	if (slot == (int)m_windows.size()) {
+		Window window = { NULL, 0, -1, -1 };
+		m_windows.push_back(window);
+	} else {
+		unlinkWindow(slot);
+	}
 
-				fseek(m_file, m_current_block->nr * BLOCK_SIZE, SEEK_SET);
-				fread(m_current_block->data, BLOCK_SIZE, 1, m_file);
+	Window &window = m_windows[slot];
+	window.data = m_mappings ? m_mappings[slot].data() : (BYTE *)malloc(WINDOW_SIZE);
+	window.id = id;
+	if (!window.data) {
+		m_windows.pop_back();
+		return -1;
+	}
 
-				m_page_cache_mem.splice(m_page_cache_mem.begin(), m_page_cache_disk, it->second);
-				m_page_map[nr] = m_page_cache_mem.begin();
-			}
+	if (id >= m_window_slots.size()) {
+		m_window_slots.resize(id + 1, -1);
+	}
+	m_window_slots[id] = slot;
 
-			// if the memory cache size is too large, swap an item to disc
+	linkWindow(slot);
 
-			cleanupMemCache();
+	return slot;
+}
 
-			// return the current block
+BYTE *
+CacheFile::getBlock(int nr) {
+	const unsigned id = (unsigned)nr / WINDOW_BLOCKS;
 
-			return m_current_block;
+	int slot = (id < m_window_slots.size()) ? m_window_slots[id] : -1;
+	if (slot == -1) {
+		slot = mapWindow(id);
+		if (slot == -1) {
+			return NULL;
 		}
+	} else {
+		touchWindow(slot);
 	}
 
-	return NULL;
+	return m_windows[slot].data + (size_t)((unsigned)nr % WINDOW_BLOCKS) * BLOCK_SIZE;
 }
 
-BOOL
-CacheFile::unlockBlock(int nr) {
-	if (m_current_block) {
-		m_current_block = NULL;
+int
+CacheFile::allocateBlock() {
+	unsigned nr;
 
-		return TRUE;
+	if (!m_free_blocks.empty()) {
+		nr = m_free_blocks.back();
+		m_free_blocks.pop_back();
+	} else {
+		nr = (unsigned)m_next.size();
+		m_next.push_back(0);
 	}
+	m_next[nr] = 0;
 
-	return FALSE;
+	return (int)nr;
 }
 
-BOOL
-CacheFile::deleteBlock(int nr) {
-	if (!m_current_block) {
-		PageMapIt it = m_page_map.find(nr);
-
-		// remove block from cache
-
-		if (it != m_page_map.end())
-			m_page_map.erase(nr);
-
-		// add block to free page list
-
-		m_free_pages.push_back(nr);
-
-		return TRUE;
-	}
-
-	return FALSE;
-}
+// ----------------------------------------------------------
 
 BOOL
 CacheFile::readFile(BYTE *data, int nr, int size) {
-	if ((data) && (size > 0)) {
+	if ((data) && (size > 0) && (nr > 0)) {
 		int s = 0;
-		int block_nr = nr;
-
-		do {
-			int copy_nr = block_nr;
-
-			Block *block = lockBlock(copy_nr);
+		unsigned block_nr = (unsigned)nr;
 
-			block_nr = block->next;
-
-			memcpy(data + s, block->data, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
+		while ((block_nr != 0) && (s < size)) {
+			const BYTE *block = getBlock(block_nr);
+			if (!block) {
+				return FALSE;
+			}
 
-			unlockBlock(copy_nr);
+			memcpy(data + s, block, MIN(size - s, BLOCK_SIZE));
 
+			block_nr = m_next[block_nr];
 			s += BLOCK_SIZE;
-		} while (block_nr != 0);
+		}
 
 		return TRUE;
 	}
@@ -220,32 +260,31 @@ CacheFile::readFile(BYTE *data, int nr, int size) {
 int
 CacheFile::writeFile(BYTE *data, int size) {
 	if ((data) && (size > 0)) {
-		int nr_blocks_required = 1 + (size / BLOCK_SIZE);
-		int count = 0;
+		const int nr_blocks_required = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
 		int s = 0;
-		int stored_alloc;
-		int alloc;
-		
-		stored_alloc = alloc = allocateBlock();
-
-		do {
-			int copy_alloc = alloc;
-
-			Block *block = lockBlock(copy_alloc);
 
-			block->next = 0;
+		const int first = allocateBlock();
+		int alloc = first;
 
-			memcpy(block->data, data + s, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
+		for (int count = 0; count < nr_blocks_required; count++) {
+			BYTE *block = getBlock(alloc);
+			if (!block) {
+				deleteFile(first);
+				return 0;
+			}
 
-			if (count + 1 < nr_blocks_required)
-				alloc = block->next = allocateBlock();
+			memcpy(block, data + s, MIN(size - s, BLOCK_SIZE));
 
-			unlockBlock(copy_alloc);
+			if (count + 1 < nr_blocks_required) {
+				const int next = allocateBlock();
+				m_next[alloc] = next;
+				alloc = next;
+			}
 
-			s += BLOCK_SIZE;			
-		} while (++count < nr_blocks_required);
+			s += BLOCK_SIZE;
+		}
 
-		return stored_alloc;
+		return first;
 	}
 
 	return 0;
@@ -253,19 +292,13 @@ CacheFile::writeFile(BYTE *data, int size) {
 
 void
 CacheFile::deleteFile(int nr) {
-	do {
-		Block *block = lockBlock(nr);
-
-		if (block == NULL)
-			break;
-
-		int next = block->next;
-
-		unlockBlock(nr);
-
-		deleteBlock(nr);
-
-		nr = next;
-	} while (nr != 0);
+	// release the chain, the blocks are reused as they are (their data is not needed)
+	unsigned block_nr = (unsigned)nr;
+
+	while ((block_nr != 0) && (block_nr < m_next.size())) {
+		const unsigned next = m_next[block_nr];
+		m_next[block_nr] = 0;
+		m_free_blocks.push_back(block_nr);
+		block_nr = next;
+	}
 }
-
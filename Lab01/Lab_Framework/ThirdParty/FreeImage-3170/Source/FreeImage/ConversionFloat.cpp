@@ -21,6 +21,39 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "../OpenEXR/Half/half.h"
+
+// ----------------------------------------------------------
+//   half float (16-bit) <-> float (32-bit) line conversion
+// ----------------------------------------------------------
+
+/**
+Convert a line of IEEE 754 half floats to floats, e.g. to upload a half float texture.
+Uses F16C or SSE2 when available.
+@param target Output buffer of count floats
+@param source Input buffer of count half floats
+@param count Number of values to convert
+*/
+void DLL_CALLCONV
+FreeImage_ConvertLineHalfToFloat(float *target, const WORD *source, int count) {
+	if(count > 0) {
+		halfToFloatArray(target, (const half*)source, (size_t)count);
+	}
+}
+
+/**
+Convert a line of floats to IEEE 754 half floats, rounding to nearest even.
+Uses F16C or SSE2 when available.
+@param target Output buffer of count half floats
+@param source Input buffer of count floats
+@param count Number of values to convert
+*/
+void DLL_CALLCONV
+FreeImage_ConvertLineFloatToHalf(WORD *target, const float *source, int count) {
+	if(count > 0) {
+		floatToHalfArray((half*)target, source, (size_t)count);
+	}
+}
 
 // ----------------------------------------------------------
 //   smart convert X to Float
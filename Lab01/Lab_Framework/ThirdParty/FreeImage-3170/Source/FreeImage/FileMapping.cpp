@@ -0,0 +1,207 @@
+// ==========================================================
+// Memory-mapped file access
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include "FileMapping.h"
+
+// ----------------------------------------------------------
+
+FileMapping::FileMapping()
+: m_view(NULL), m_view_size(0), m_data(NULL), m_size(0) {
+}
+
+FileMapping::~FileMapping() {
+	close();
+}
+
+#ifdef _WIN32
+
+/**
+Map an opened file, extending it first if the mapping is writable
+*/
+static void *
+MapFileHandle(HANDLE file, UINT64 view_offset, size_t view_size, BOOL read_only) {
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+
+	void *view = NULL;
+
+	LARGE_INTEGER file_size;
+	if (GetFileSizeEx(file, &file_size)) {
+		const UINT64 end = view_offset + view_size;
+		BOOL valid = ((UINT64)file_size.QuadPart >= end) ? TRUE : FALSE;
+
+		if (!valid && !read_only) {
+			LARGE_INTEGER new_size;
+			new_size.QuadPart = (LONGLONG)end;
+			valid = SetFilePointerEx(file, new_size, NULL, FILE_BEGIN) && SetEndOfFile(file);
+		}
+
+		if (valid) {
+			// a read-only mapping is copy-on-write, so that writing to it cannot fault
+			HANDLE mapping = CreateFileMapping(file, NULL, read_only ? PAGE_WRITECOPY : PAGE_READWRITE, 0, 0, NULL);
+			if (mapping) {
+				view = MapViewOfFile(mapping, read_only ? FILE_MAP_COPY : FILE_MAP_WRITE,
+					(DWORD)(view_offset >> 32), (DWORD)(view_offset & 0xFFFFFFFF), view_size);
+				// the view keeps the mapping alive
+				CloseHandle(mapping);
+			}
+		}
+	}
+
+	CloseHandle(file);
+
+	return view;
+}
+
+static UINT64
+GetMappingGranularity() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+}
+
+#else
+
+static void *
+MapFileHandle(int fd, UINT64 view_offset, size_t view_size, BOOL read_only) {
+	if (fd == -1) {
+		return NULL;
+	}
+
+	void *view = NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) == 0) {
+		const UINT64 end = view_offset + view_size;
+		bool valid = ((UINT64)st.st_size >= end);
+
+		if (!valid && !read_only) {
+			valid = (ftruncate(fd, (off_t)end) == 0);
+		}
+
+		if (valid) {
+			// a read-only mapping is copy-on-write, so that writing to it cannot fault
+			view = mmap(NULL, view_size, PROT_READ | PROT_WRITE, read_only ? MAP_PRIVATE : MAP_SHARED, fd, (off_t)view_offset);
+			if (view == MAP_FAILED) {
+				view = NULL;
+			}
+		}
+	}
+
+	// the mapping keeps the file alive
+	::close(fd);
+
+	return view;
+}
+
+static UINT64
+GetMappingGranularity() {
+	return (UINT64)sysconf(_SC_PAGESIZE);
+}
+
+#endif // _WIN32
+
+// ----------------------------------------------------------
+
+BOOL
+FileMapping::open(const char *filename, UINT64 offset, size_t size, BOOL read_only) {
+	close();
+
+	if (!filename || (size == 0)) {
+		return FALSE;
+	}
+
+	// views must start on an allocation granularity boundary
+	const UINT64 view_offset = offset - (offset % GetMappingGranularity());
+	const size_t view_size = size + (size_t)(offset - view_offset);
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, read_only ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE), FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, read_only ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	m_view = MapFileHandle(file, view_offset, view_size, read_only);
+#else
+	int fd = ::open(filename, read_only ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+	m_view = MapFileHandle(fd, view_offset, view_size, read_only);
+#endif
+
+	if (!m_view) {
+		return FALSE;
+	}
+
+	m_view_size = view_size;
+	m_data = (BYTE *)m_view + (size_t)(offset - view_offset);
+	m_size = size;
+
+	return TRUE;
+}
+
+BOOL
+FileMapping::openU(const wchar_t *filename, UINT64 offset, size_t size, BOOL read_only) {
+	close();
+
+#ifdef _WIN32
+	if (!filename || (size == 0)) {
+		return FALSE;
+	}
+
+	const UINT64 view_offset = offset - (offset % GetMappingGranularity());
+	const size_t view_size = size + (size_t)(offset - view_offset);
+
+	HANDLE file = CreateFileW(filename, read_only ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE), FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, read_only ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	m_view = MapFileHandle(file, view_offset, view_size, read_only);
+
+	if (!m_view) {
+		return FALSE;
+	}
+
+	m_view_size = view_size;
+	m_data = (BYTE *)m_view + (size_t)(offset - view_offset);
+	m_size = size;
+
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+void
+FileMapping::close() {
+	if (m_view) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_view);
+#else
+		munmap(m_view, m_view_size);
+#endif
+	}
+	m_view = NULL;
+	m_view_size = 0;
+	m_data = NULL;
+	m_size = 0;
+}
@@ -29,6 +29,8 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <atomic>
+
 //----------------------------------------------------------------------
 
 static const char *s_copyright = "This program uses FreeImage, a free, open source image library supporting all common bitmap formats. See http://freeimage.sourceforge.net for details";
@@ -46,7 +48,11 @@ DllMain(HANDLE hModule, DWORD ul_reason_for_call, LPVOID lpReserved) {
 			break;
 
 		case DLL_PROCESS_DETACH :
-			FreeImage_DeInitialise();
+			// when the process terminates (lpReserved != NULL), the worker threads 
+			// have already been killed and nothing needs to be released
+			if (lpReserved == NULL) {
+				FreeImage_DeInitialise();
+			}
 			break;
 
 		case DLL_THREAD_ATTACH :
@@ -78,11 +84,13 @@ void FreeImage_SO_DeInitialise() {
 
 //----------------------------------------------------------------------
 
+#define FI_STRINGIZE_(x) #x
+#define FI_STRINGIZE(x) FI_STRINGIZE_(x)
+
 const char * DLL_CALLCONV
 FreeImage_GetVersion() {
-	static char s_version[16];
-	sprintf(s_version, "%d.%d.%d", FREEIMAGE_MAJOR_VERSION, FREEIMAGE_MINOR_VERSION, FREEIMAGE_RELEASE_SERIAL);
-	return s_version;
+	// constant string, so that concurrent callers never see a partially written buffer
+	return FI_STRINGIZE(FREEIMAGE_MAJOR_VERSION) "." FI_STRINGIZE(FREEIMAGE_MINOR_VERSION) "." FI_STRINGIZE(FREEIMAGE_RELEASE_SERIAL);
 }
 
 const char * DLL_CALLCONV
@@ -104,8 +112,10 @@ FreeImage_IsLittleEndian() {
 
 //----------------------------------------------------------------------
 
-static FreeImage_OutputMessageFunction freeimage_outputmessage_proc = NULL;
-static FreeImage_OutputMessageFunctionStdCall freeimage_outputmessagestdcall_proc = NULL; 
+// message handlers may be changed while other threads report errors,
+// so each message reads them once, atomically
+static std::atomic<FreeImage_OutputMessageFunction> freeimage_outputmessage_proc(NULL);
+static std::atomic<FreeImage_OutputMessageFunctionStdCall> freeimage_outputmessagestdcall_proc(NULL); 
 
 void DLL_CALLCONV
 FreeImage_SetOutputMessage(FreeImage_OutputMessageFunction omf) {
@@ -121,7 +131,10 @@ void DLL_CALLCONV
 FreeImage_OutputMessageProc(int fif, const char *fmt, ...) {
 	const int MSG_SIZE = 512; // 512 bytes should be more than enough for a short message
 
-	if ((fmt != NULL) && ((freeimage_outputmessage_proc != NULL) || (freeimage_outputmessagestdcall_proc != NULL))) {
+	const FreeImage_OutputMessageFunction message_proc = freeimage_outputmessage_proc;
+	const FreeImage_OutputMessageFunctionStdCall message_stdcall_proc = freeimage_outputmessagestdcall_proc;
+
+	if ((fmt != NULL) && ((message_proc != NULL) || (message_stdcall_proc != NULL))) {
 		char message[MSG_SIZE];
 		memset(message, 0, MSG_SIZE);
 
@@ -217,10 +230,10 @@ FreeImage_OutputMessageProc(int fif, const char *fmt, ...) {
 
 		// output the message to the user program
 
-		if (freeimage_outputmessage_proc != NULL)
-			freeimage_outputmessage_proc((FREE_IMAGE_FORMAT)fif, message);
+		if (message_proc != NULL)
+			message_proc((FREE_IMAGE_FORMAT)fif, message);
 
-		if (freeimage_outputmessagestdcall_proc != NULL)
-			freeimage_outputmessagestdcall_proc((FREE_IMAGE_FORMAT)fif, message); 
+		if (message_stdcall_proc != NULL)
+			message_stdcall_proc((FREE_IMAGE_FORMAT)fif, message); 
 	}
 }
@@ -29,6 +29,345 @@
 #include "Plugin.h"
 #include "../DeprecationManager/DeprecationMgr.h"
 
+// ----------------------------------------------------------
+//   Signature matching
+// ----------------------------------------------------------
+
+/**
+Number of bytes read once from the stream to identify its format.
+The largest offset checked is the PICT signature, at byte 522.
+*/
+static const unsigned SIGNATURE_SIZE = 528;
+
+/**
+Start of a stream, as read by FreeImage_GetFileTypeFromHandle.
+Bytes past the end of the stream are set to zero.
+*/
+struct FileHeader {
+	BYTE data[SIGNATURE_SIZE];	//! first bytes of the stream
+	unsigned size;				//! number of bytes actually read
+	long start;					//! stream position of data[0]
+};
+
+/// Result of a signature test
+enum SignatureMatch {
+	SIGNATURE_NO = 0,		//! the stream is not in this format
+	SIGNATURE_YES = 1,		//! the stream is in this format
+	SIGNATURE_UNSURE = -1	//! the header is not enough, the plugin must validate the stream
+};
+
+/**
+Test the header of a stream against the signature of a format.
+Each test gives the same answer as the Validate function of the plugin.
+*/
+typedef SignatureMatch (*SignatureProc)(const FileHeader& header);
+
+static inline WORD
+GetWordLE(const BYTE *p) {
+	return (WORD)(p[0] | (p[1] << 8));
+}
+
+static inline DWORD
+GetDWordLE(const BYTE *p) {
+	return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static inline SignatureMatch
+Match(BOOL condition) {
+	return condition ? SIGNATURE_YES : SIGNATURE_NO;
+}
+
+static SignatureMatch
+MatchBMP(const FileHeader& header) {
+	return Match((header.data[0] == 'B') && ((header.data[1] == 'M') || (header.data[1] == 'A')));
+}
+
+static SignatureMatch
+MatchICO(const FileHeader& header) {
+	// idReserved == 0, idType == 1 (icon), idCount > 0
+	return Match((GetWordLE(header.data) == 0) && (GetWordLE(header.data + 2) == 1) && (GetWordLE(header.data + 4) > 0));
+}
+
+static SignatureMatch
+MatchJPEG(const FileHeader& header) {
+	return Match((header.data[0] == 0xFF) && (header.data[1] == 0xD8));
+}
+
+static SignatureMatch
+MatchJNG(const FileHeader& header) {
+	static const BYTE jng_signature[8] = { 139, 74, 78, 71, 13, 10, 26, 10 };
+	return Match(memcmp(header.data, jng_signature, 8) == 0);
+}
+
+static SignatureMatch
+MatchKOALA(const FileHeader& header) {
+	return Match((header.data[0] == 0x00) && (header.data[1] == 0x60));
+}
+
+static SignatureMatch
+MatchIFF(const FileHeader& header) {
+	// FORM chunk of type ILBM (interleaved bitmap) or PBM (packed bitmap)
+	return Match((memcmp(header.data, "FORM", 4) == 0) && 
+		((memcmp(header.data + 8, "ILBM", 4) == 0) || (memcmp(header.data + 8, "PBM ", 4) == 0)));
+}
+
+static SignatureMatch
+MatchMNG(const FileHeader& header) {
+	static const BYTE mng_signature[8] = { 138, 77, 78, 71, 13, 10, 26, 10 };
+	return Match(memcmp(header.data, mng_signature, 8) == 0);
+}
+
+static SignatureMatch
+MatchPNM(const FileHeader& header) {
+	// the PNM plugin accepts any of P1 to P6, whatever the registered variant
+	return Match((header.data[0] == 'P') && (header.data[1] >= '1') && (header.data[1] <= '6'));
+}
+
+static SignatureMatch
+MatchPCX(const FileHeader& header) {
+	const BYTE *p = header.data;
+	return Match((header.size >= 4) && (p[0] == 0x0A) && (p[1] <= 5) && (p[2] <= 1) && ((p[3] == 1) || (p[3] == 8)));
+}
+
+static SignatureMatch
+MatchPNG(const FileHeader& header) {
+	static const BYTE png_signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	return Match(memcmp(header.data, png_signature, 8) == 0);
+}
+
+static SignatureMatch
+MatchRAS(const FileHeader& header) {
+	static const BYTE ras_signature[4] = { 0x59, 0xA6, 0x6A, 0x95 };
+	return Match(memcmp(header.data, ras_signature, 4) == 0);
+}
+
+static SignatureMatch
+MatchTARGA(const FileHeader& header) {
+	// TGA 2.0 files are identified by a footer, which is not part of the header:
+	// only the (weak) header test of older files can be done here
+	const BYTE *p = header.data;
+	const BYTE color_map_type = p[1];
+	const BYTE image_type = p[2];
+	const BYTE pixel_depth = p[16];
+
+	if ((color_map_type > 1) || (GetWordLE(p + 12) == 0) || (GetWordLE(p + 14) == 0)) {
+		return SIGNATURE_UNSURE;
+	}
+	if ((color_map_type == 1) && ((GetWordLE(p + 3) >= GetWordLE(p + 5)) || (p[7] == 0) || (p[7] > 32))) {
+		return SIGNATURE_UNSURE;
+	}
+	switch (image_type) {
+		case 1:		// TGA_CMAP
+		case 2:		// TGA_RGB
+		case 3:		// TGA_MONO
+		case 9:		// TGA_RLECMAP
+		case 10:	// TGA_RLERGB
+		case 11:	// TGA_RLEMONO
+			if ((pixel_depth == 8) || (pixel_depth == 16) || (pixel_depth == 24) || (pixel_depth == 32)) {
+				return SIGNATURE_YES;
+			}
+			break;
+	}
+	return SIGNATURE_UNSURE;
+}
+
+static SignatureMatch
+MatchTIFF(const FileHeader& header) {
+	const BYTE *p = header.data;
+	// classic TIFF (42) and Big TIFF (43), little-endian or big-endian
+	return Match(((p[0] == 0x49) && (p[1] == 0x49) && ((p[2] == 0x2A) || (p[2] == 0x2B)) && (p[3] == 0x00)) ||
+		((p[0] == 0x4D) && (p[1] == 0x4D) && (p[2] == 0x00) && ((p[3] == 0x2A) || (p[3] == 0x2B))));
+}
+
+static SignatureMatch
+MatchPSD(const FileHeader& header) {
+	return Match(memcmp(header.data, "8BPS", 4) == 0);
+}
+
+static SignatureMatch
+MatchXBM(const FileHeader& header) {
+	return Match((header.size >= 7) && (memcmp(header.data, "#define", 7) == 0));
+}
+
+static SignatureMatch
+MatchXPM(const FileHeader& header) {
+	// the magic string may be anywhere in the first 256 characters
+	const int count = (int)MIN(header.size, (unsigned)256);
+	for (int i = 0; i < (count - 9); i++) {
+		if (memcmp(header.data + i, "/* XPM */", 9) == 0) {
+			return SIGNATURE_YES;
+		}
+	}
+	return SIGNATURE_NO;
+}
+
+static SignatureMatch
+MatchDDS(const FileHeader& header) {
+	// "DDS " followed by a surface description of 124 bytes, with a pixel format of 32 bytes
+	return Match((memcmp(header.data, "DDS ", 4) == 0) && (GetDWordLE(header.data + 4) == 124) && (GetDWordLE(header.data + 76) == 32));
+}
+
+static SignatureMatch
+MatchGIF(const FileHeader& header) {
+	const BYTE *p = header.data;
+	return Match((memcmp(p, "GIF", 3) == 0) && 
+		(p[3] >= '0') && (p[3] <= '9') && (p[4] >= '0') && (p[4] <= '9') && (p[5] >= 'a') && (p[5] <= 'z'));
+}
+
+static SignatureMatch
+MatchHDR(const FileHeader& header) {
+	return Match((header.data[0] == '#') && (header.data[1] == '?'));
+}
+
+static SignatureMatch
+MatchSGI(const FileHeader& header) {
+	return Match((header.data[0] == 0x01) && (header.data[1] == 0xDA));
+}
+
+static SignatureMatch
+MatchEXR(const FileHeader& header) {
+	static const BYTE exr_signature[4] = { 0x76, 0x2F, 0x31, 0x01 };
+	return Match(memcmp(header.data, exr_signature, 4) == 0);
+}
+
+static SignatureMatch
+MatchJ2K(const FileHeader& header) {
+	return Match((header.data[0] == 0xFF) && (header.data[1] == 0x4F));
+}
+
+static SignatureMatch
+MatchJP2(const FileHeader& header) {
+	static const BYTE jp2_signature[12] = { 0x00, 0x00, 0x00, 0x0C, 0x6A, 0x50, 0x20, 0x20, 0x0D, 0x0A, 0x87, 0x0A };
+	return Match(memcmp(header.data, jp2_signature, 12) == 0);
+}
+
+static SignatureMatch
+MatchPFM(const FileHeader& header) {
+	return Match((header.data[0] == 'P') && ((header.data[1] == 'F') || (header.data[1] == 'f')));
+}
+
+static SignatureMatch
+MatchPICT(const FileHeader& header) {
+	// the signature follows a 512 bytes header and the picture size, from the start of the file
+	if (header.start != 0) {
+		return SIGNATURE_UNSURE;
+	}
+	static const BYTE pict_signature[6] = { 0x00, 0x11, 0x02, 0xFF, 0x0C, 0x00 };
+	return Match((header.size > 522) && (memcmp(header.data + 522, pict_signature, 6) == 0));
+}
+
+static SignatureMatch
+MatchWEBP(const FileHeader& header) {
+	return Match((memcmp(header.data, "RIFF", 4) == 0) && (memcmp(header.data + 8, "WEBP", 4) == 0));
+}
+
+static SignatureMatch
+MatchJXR(const FileHeader& header) {
+	return Match((header.data[0] == 0x49) && (header.data[1] == 0x49) && (header.data[2] == 0xBC));
+}
+
+/**
+Signature tests of the internal plugins, indexed by FREE_IMAGE_FORMAT.
+NULL entries are always validated by their plugin.
+*/
+static const SignatureProc s_signatures[] = {
+	MatchBMP,		// FIF_BMP
+	MatchICO,		// FIF_ICO
+	MatchJPEG,		// FIF_JPEG
+	MatchJNG,		// FIF_JNG
+	MatchKOALA,		// FIF_KOALA
+	MatchIFF,		// FIF_LBM
+	MatchMNG,		// FIF_MNG
+	MatchPNM,		// FIF_PBM
+	MatchPNM,		// FIF_PBMRAW
+	NULL,			// FIF_PCD
+	MatchPCX,		// FIF_PCX
+	MatchPNM,		// FIF_PGM
+	MatchPNM,		// FIF_PGMRAW
+	MatchPNG,		// FIF_PNG
+	MatchPNM,		// FIF_PPM
+	MatchPNM,		// FIF_PPMRAW
+	MatchRAS,		// FIF_RAS
+	MatchTARGA,		// FIF_TARGA
+	MatchTIFF,		// FIF_TIFF
+	NULL,			// FIF_WBMP
+	MatchPSD,		// FIF_PSD
+	NULL,			// FIF_CUT
+	MatchXBM,		// FIF_XBM
+	MatchXPM,		// FIF_XPM
+	MatchDDS,		// FIF_DDS
+	MatchGIF,		// FIF_GIF
+	MatchHDR,		// FIF_HDR
+	NULL,			// FIF_FAXG3
+	MatchSGI,		// FIF_SGI
+	MatchEXR,		// FIF_EXR
+	MatchJ2K,		// FIF_J2K
+	MatchJP2,		// FIF_JP2
+	MatchPFM,		// FIF_PFM
+	MatchPICT,		// FIF_PICT
+	NULL,			// FIF_RAW
+	MatchWEBP,		// FIF_WEBP
+	MatchJXR		// FIF_JXR
+};
+
+static const int SIGNATURE_COUNT = (int)(sizeof(s_signatures) / sizeof(s_signatures[0]));
+
+#define FIF_BIT(fif) ((UINT64)1 << (fif))
+
+/**
+Returns the set of formats (as FIF_BIT flags) whose signature may start with a given byte.
+Formats without a signature test are not part of the set.
+*/
+static UINT64
+GetCandidateFormats(BYTE first) {
+	// formats identified by bytes found anywhere in the header
+	const UINT64 any = FIF_BIT(FIF_TARGA) | FIF_BIT(FIF_XPM) | FIF_BIT(FIF_PICT);
+	const UINT64 pnm = FIF_BIT(FIF_PBM) | FIF_BIT(FIF_PBMRAW) | FIF_BIT(FIF_PGM) | FIF_BIT(FIF_PGMRAW) | FIF_BIT(FIF_PPM) | FIF_BIT(FIF_PPMRAW);
+
+	switch (first) {
+		case 0x00:
+			return any | FIF_BIT(FIF_ICO) | FIF_BIT(FIF_KOALA) | FIF_BIT(FIF_JP2);
+		case 0x01:
+			return any | FIF_BIT(FIF_SGI);
+		case 0x0A:
+			return any | FIF_BIT(FIF_PCX);
+		case '#':
+			return any | FIF_BIT(FIF_XBM) | FIF_BIT(FIF_HDR);
+		case '8':
+			return any | FIF_BIT(FIF_PSD);
+		case 'B':
+			return any | FIF_BIT(FIF_BMP);
+		case 'D':
+			return any | FIF_BIT(FIF_DDS);
+		case 'F':
+			return any | FIF_BIT(FIF_LBM);
+		case 'G':
+			return any | FIF_BIT(FIF_GIF);
+		case 'I':
+			return any | FIF_BIT(FIF_TIFF) | FIF_BIT(FIF_JXR);
+		case 'M':
+			return any | FIF_BIT(FIF_TIFF);
+		case 'P':
+			return any | pnm | FIF_BIT(FIF_PFM);
+		case 'R':
+			return any | FIF_BIT(FIF_WEBP);
+		case 0x59:
+			return any | FIF_BIT(FIF_RAS);
+		case 0x76:
+			return any | FIF_BIT(FIF_EXR);
+		case 0x89:
+			return any | FIF_BIT(FIF_PNG);
+		case 0x8A:
+			return any | FIF_BIT(FIF_MNG);
+		case 0x8B:
+			return any | FIF_BIT(FIF_JNG);
+		case 0xFF:
+			return any | FIF_BIT(FIF_JPEG) | FIF_BIT(FIF_J2K);
+		default:
+			return any;
+	}
+}
+
 // ----------------------------------------------------------
 
 FREE_IMAGE_FORMAT DLL_CALLCONV
@@ -36,9 +375,35 @@ FreeImage_GetFileTypeFromHandle(FreeImageIO *io, fi_handle handle, int size) {
 	if (handle != NULL) {
 		int fif_count = FreeImage_GetFIFCount();
 
+		// read the header once, the signatures of the internal plugins are matched against it
+		FileHeader header;
+		memset(header.data, 0, SIGNATURE_SIZE);
+		header.start = io->tell_proc(handle);
+		header.size = io->read_proc(header.data, 1, SIGNATURE_SIZE, handle);
+		io->seek_proc(handle, header.start, SEEK_SET);
+
+		const UINT64 candidates = GetCandidateFormats(header.data[0]);
+
+		// plugins are tried in registration order, as they may accept the same streams
 		for (int i = 0; i < fif_count; ++i) {
 			FREE_IMAGE_FORMAT fif = (FREE_IMAGE_FORMAT)i;
-			if (FreeImage_Validate(fif, io, handle)) {
+			SignatureMatch match = SIGNATURE_UNSURE;
+
+			if ((i < SIGNATURE_COUNT) && (s_signatures[i] != NULL)) {
+				if ((candidates & FIF_BIT(i)) == 0) {
+					continue;
+				}
+				if (FreeImage_IsPluginEnabled(fif) != TRUE) {
+					continue;
+				}
+				match = s_signatures[i](header);
+			}
+			if (match == SIGNATURE_UNSURE) {
+				// external plugin, or a signature that does not fit in the header
+				match = FreeImage_Validate(fif, io, handle) ? SIGNATURE_YES : SIGNATURE_NO;
+			}
+
+			if (match == SIGNATURE_YES) {
 				if(fif == FIF_TIFF) {
 					// many camera raw files use a TIFF signature ...
 					// ... try to revalidate against FIF_RAW (even if it breaks the code genericity)
@@ -25,10 +25,98 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
 
 static const int WHITE = 255;
 static const int BLACK = 0;
 
+// minimum number of pixels processed by a band of rows
+#define HALFTONE_GRAIN (256 * 1024)
+
+// number of pixels of a row between two progress updates of the error diffusion
+#define DIFFUSION_STEP 64
+
+// ==========================================================
+// 8-bit to 1-bit conversion
+//
+
+// reverses the bit order of a byte, so that the first pixel is the most significant bit
+static const BYTE REVERSE_BITS[256] = {
+	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+	0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+	0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+	0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+	0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+	0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+	0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+	0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+	0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+	0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+	0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+	0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+	0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+	0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+	0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+};
+
+// Set bit x of a 1-bit row when bits8[x] >= thresholds[x], clear it otherwise
+//
+static void ThresholdLine(BYTE *bits1, const BYTE *bits8, const BYTE *thresholds, unsigned width) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	for(; x + 16 <= width; x += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(bits8 + x));
+		const __m128i t = _mm_loadu_si128((const __m128i*)(thresholds + x));
+		// v >= t <=> max(v, t) == v
+		const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v));
+		bits1[x >> 3] = REVERSE_BITS[mask & 0xFF];
+		bits1[(x >> 3) + 1] = REVERSE_BITS[mask >> 8];
+	}
+#endif
+	for(; x < width; x += 8) {
+		const unsigned count = MIN(8U, width - x);
+		BYTE byte = 0;
+		for(unsigned i = 0; i < count; i++) {
+			byte |= (BYTE)((bits8[x + i] >= thresholds[x + i]) << (7 - i));
+		}
+		bits1[x >> 3] = byte;
+	}
+}
+
+// Convert a 8-bit image to a monochrome image, comparing row y against the threshold row (y % period). 
+// The threshold rows are stored in a width by period array.
+//
+static FIBITMAP* ThresholdRows(FIBITMAP *dib8, const BYTE *thresholds, unsigned period) {
+	const unsigned width = FreeImage_GetWidth(dib8);
+	const unsigned height = FreeImage_GetHeight(dib8);
+
+	// Allocate a new 1-bit DIB
+	FIBITMAP *new_dib = FreeImage_Allocate(width, height, 1);
+	if(NULL == new_dib) return NULL;
+	// Build a monochrome palette
+	RGBQUAD *pal = FreeImage_GetPalette(new_dib);
+	pal[0].rgbRed = pal[0].rgbGreen = pal[0].rgbBlue = 0;
+	pal[1].rgbRed = pal[1].rgbGreen = pal[1].rgbBlue = 255;
+
+	// Perform the thresholding by bands of rows
+	ParallelFor(0, height, MAX(1U, HALFTONE_GRAIN / width), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			ThresholdLine(FreeImage_GetScanLine(new_dib, y), FreeImage_GetScanLine(dib8, y), thresholds + (y % period) * width, width);
+		}
+	});
+
+	return new_dib;
+}
+
 // Floyd & Steinberg error diffusion dithering
 // This algorithm use the following filter
 //          *   7
@@ -40,23 +128,16 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 
 	int seed = 0;
 	int x, y, p, pixel, threshold, error;
-	int width, height, pitch;
+	int width, height;
 	BYTE *bits, *new_bits;
 	FIBITMAP *new_dib = NULL;
 
 	// allocate a 8-bit DIB
 	width = FreeImage_GetWidth(dib);
 	height = FreeImage_GetHeight(dib);
-	pitch = FreeImage_GetPitch(dib);
 	new_dib = FreeImage_Allocate(width, height, 8);
 	if(NULL == new_dib) return NULL;
 
-	// allocate space for error arrays
-	int *lerr = (int*)malloc (width * sizeof(int));
-	int *cerr = (int*)malloc (width * sizeof(int));
-	memset(lerr, 0, width * sizeof(int));
-	memset(cerr, 0, width * sizeof(int));
-
 	// left border
 	error = 0;
 	for(y = 0; y < height; y++) {
@@ -81,6 +162,27 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 		error = pixel - p;
 		new_bits[width-1] = (BYTE)p;
 	}
+
+	// Rows are processed as a wavefront: a row needs the errors of the previous row 
+	// up to one pixel ahead, so that row y can run DIFFUSION_STEP pixels behind row y - 1 
+	// on another thread. Rows are claimed in increasing order and the rows in flight 
+	// are consecutive, so that a ring of (band_count + 1) error rows is enough.
+	const unsigned band_count = MAX(1U, MIN(ParallelGetThreadCount(), (unsigned)height));
+	const unsigned ring = band_count + 1;
+
+	// allocate space for error arrays
+	int *errors = (int*)malloc(ring * width * sizeof(int));
+	std::atomic<int> *progress = new(std::nothrow) std::atomic<int>[height];
+	if(!errors || !progress) {
+		free(errors);
+		delete[] progress;
+		FreeImage_Unload(new_dib);
+		return NULL;
+	}
+	for(y = 0; y < height; y++) {
+		progress[y].store(0, std::memory_order_relaxed);
+	}
+
 	// top border
 	bits = FreeImage_GetBits(dib);
 	new_bits = FreeImage_GetBits(new_dib);
@@ -91,37 +193,50 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 		p = (pixel > threshold) ? WHITE : BLACK;
 		error = pixel - p;
 		new_bits[x] = (BYTE)p;
-		lerr[x] = INITERR(bits[x], p);
+		errors[x] = INITERR(bits[x], p);
 	}
+	progress[0].store(width, std::memory_order_release);
 
 	// interior bits
-	for(y = 1; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
-
-	    cerr[0] = INITERR(bits[0], new_bits[0]);
-		for(x = 1; x < width - 1; x++) {
-			error = (lerr[x-1] + 5 * lerr[x] + 3 * lerr[x+1] + 7 * cerr[x-1]) / 16;
-			pixel = bits[x] + error;
-			if(pixel > (WHITE / 2)) {		
-				new_bits[x] = WHITE;
-				cerr[x] = pixel - WHITE; 
-			} else {
-				new_bits[x] = BLACK;
-				cerr[x] = pixel - BLACK; 
+	std::atomic<int> next_row(1);
+	ParallelFor(0, band_count, 1, [&](unsigned, unsigned) {
+		for(int y = next_row++; y < height; y = next_row++) {
+			// scan left to right
+			const BYTE *bits = FreeImage_GetScanLine(dib, y);
+			BYTE *new_bits = FreeImage_GetScanLine(new_dib, y);
+			const int *lerr = errors + ((y - 1) % ring) * width;
+			int *cerr = errors + (y % ring) * width;
+			const std::atomic<int>& above = progress[y - 1];
+
+			int ready = above.load(std::memory_order_acquire);
+			cerr[0] = INITERR(bits[0], new_bits[0]);
+			for(int x = 1; x < width - 1; x++) {
+				// wait for lerr[x + 1]
+				while(ready < MIN(x + 2, width)) {
+					std::this_thread::yield();
+					ready = above.load(std::memory_order_acquire);
+				}
+				const int error = (lerr[x-1] + 5 * lerr[x] + 3 * lerr[x+1] + 7 * cerr[x-1]) / 16;
+				const int pixel = bits[x] + error;
+				if(pixel > (WHITE / 2)) {		
+					new_bits[x] = WHITE;
+					cerr[x] = pixel - WHITE; 
+				} else {
+					new_bits[x] = BLACK;
+					cerr[x] = pixel - BLACK; 
+				}
+				if((x % DIFFUSION_STEP) == 0) {
+					progress[y].store(x + 1, std::memory_order_release);
+				}
 			}
+			// set errors for the end of the row
+			cerr[width - 1] = INITERR (bits[width - 1], new_bits[width - 1]);
+			progress[y].store(width, std::memory_order_release);
 		}
-		// set errors for ends of the row
-		cerr[0] = INITERR (bits[0], new_bits[0]);
-		cerr[width - 1] = INITERR (bits[width - 1], new_bits[width - 1]);
-
-		// swap error buffers
-		int *terr = lerr; lerr = cerr; cerr = terr;
-	}
+	});
 
-	free(lerr);
-	free(cerr);
+	free(errors);
+	delete[] progress;
 
 	return new_dib;
 }
@@ -158,18 +273,14 @@ static int dithervalue(int x, int y, int size) {
 }
 
 // Ordered dithering with a Bayer matrix of size 2^order by 2^order
+// Returns a monochrome image
 //
 static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order) {
 	int x, y;
-	int width, height;
-	BYTE *bits, *new_bits;
+	int width;
 	FIBITMAP *new_dib = NULL;
 
-	// allocate a 8-bit DIB
 	width = FreeImage_GetWidth(dib);
-	height = FreeImage_GetHeight(dib);
-	new_dib = FreeImage_Allocate(width, height, 8);
-	if(NULL == new_dib) return NULL;
 
 	// build the dithering matrix
 	int l = (1 << order);	// square of dither matrix order; the dimensions of the matrix
@@ -179,20 +290,21 @@ static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order) {
 		matrix[i] = (BYTE)( 255 * (((double)dithervalue(i / l, i % l, order) + 0.5) / (l*l)) );
 	}
 
-	// perform the dithering
-	for(y = 0; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
-		for(x = 0; x < width; x++) {
-			if(bits[x] > matrix[(x % l) + l * (y % l)]) {
-				new_bits[x] = WHITE;
-			} else {
-				new_bits[x] = BLACK;
+	// tile the matrix rows over the image width: a pixel is white when 
+	// pixel > matrix[(x % l) + l * (y % l)], i.e. when pixel >= matrix + 1
+	BYTE *thresholds = (BYTE*)malloc(l * width * sizeof(BYTE));
+	if(thresholds) {
+		for(y = 0; y < l; y++) {
+			for(x = 0; x < width; x++) {
+				thresholds[y * width + x] = (BYTE)(matrix[(x % l) + l * y] + 1);
 			}
 		}
+
+		// perform the dithering
+		new_dib = ThresholdRows(dib, thresholds, l);
 	}
 
+	free(thresholds);
 	free(matrix);
 
 	return new_dib;
@@ -250,16 +362,11 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	   62, 55, 47, 37, 36, 46, 54, 61, 65, 72, 80, 90, 91, 81, 73, 66
 	};
 
-	int x, y, pixel;
-	int width, height;
-	BYTE *bits, *new_bits;
+	int x, y;
+	int width;
 	FIBITMAP *new_dib = NULL;
 
-	// allocate a 8-bit DIB
 	width = FreeImage_GetWidth(dib);
-	height = FreeImage_GetHeight(dib);
-	new_dib = FreeImage_Allocate(width, height, 8);
-	if(NULL == new_dib) return NULL;
 
 	// select the dithering matrix
 	int *matrix = NULL;
@@ -286,21 +393,21 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 		}
 	}
 
-	// perform the dithering
-	for(y = 0; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
+	// tile the matrix over the image width: a pixel is white when 
+	// pixel >= matrix[(y % l) + l * (x % l)]
+	BYTE *thresholds = (BYTE*)malloc(l * width * sizeof(BYTE));
+	if(NULL == thresholds) return NULL;
+	for(y = 0; y < l; y++) {
 		for(x = 0; x < width; x++) {
-			pixel = bits[x];
-			if(pixel >= matrix[(y % l) + l * (x % l)]) {
-				new_bits[x] = WHITE;
-			} else {
-				new_bits[x] = BLACK;
-			}
+			thresholds[y * width + x] = (BYTE)matrix[y + l * (x % l)];
 		}
 	}
 
+	// perform the dithering
+	new_dib = ThresholdRows(dib, thresholds, l);
+
+	free(thresholds);
+
 	return new_dib;
 }
 
@@ -310,7 +417,7 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 //
 FIBITMAP * DLL_CALLCONV
 FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm) {
-	FIBITMAP *input = NULL, *dib8 = NULL;
+	FIBITMAP *input = NULL, *dib8 = NULL, *new_dib = NULL;
 
 	if(!FreeImage_HasPixels(dib)) return NULL;
 
@@ -349,44 +456,46 @@ FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm) {
 	if(NULL == input) return NULL;
 
 	// Apply the dithering algorithm
+	// (ordered dithers directly output a 1-bit image)
 	switch(algorithm) {
 		case FID_FS:
 			dib8 = FloydSteinberg(input);
 			break;
 		case FID_BAYER4x4:
-			dib8 = OrderedDispersedDot(input, 2);
+			new_dib = OrderedDispersedDot(input, 2);
 			break;
 		case FID_BAYER8x8:
-			dib8 = OrderedDispersedDot(input, 3);
+			new_dib = OrderedDispersedDot(input, 3);
 			break;
 		case FID_BAYER16x16:
-			dib8 = OrderedDispersedDot(input, 4);
+			new_dib = OrderedDispersedDot(input, 4);
 			break;
 		case FID_CLUSTER6x6:
-			dib8 = OrderedClusteredDot(input, 3);
+			new_dib = OrderedClusteredDot(input, 3);
 			break;
 		case FID_CLUSTER8x8:
-			dib8 = OrderedClusteredDot(input, 4);
+			new_dib = OrderedClusteredDot(input, 4);
 			break;
 		case FID_CLUSTER16x16:
-			dib8 = OrderedClusteredDot(input, 8);
+			new_dib = OrderedClusteredDot(input, 8);
 			break;
 	}
 	if(input != dib) {
 		FreeImage_Unload(input);
 	}
 
-	// Build a greyscale palette (needed by threshold)
-	RGBQUAD *grey_pal = FreeImage_GetPalette(dib8);
-	for(int i = 0; i < 256; i++) {
-		grey_pal[i].rgbRed	= (BYTE)i;
-		grey_pal[i].rgbGreen = (BYTE)i;
-		grey_pal[i].rgbBlue	= (BYTE)i;
+	if(dib8) {
+		// Convert to 1-bit
+		const unsigned width = FreeImage_GetWidth(dib8);
+		BYTE *thresholds = (BYTE*)malloc(width * sizeof(BYTE));
+		if(thresholds) {
+			memset(thresholds, 128, width);
+			new_dib = ThresholdRows(dib8, thresholds, 1);
+			free(thresholds);
+		}
+		FreeImage_Unload(dib8);
 	}
-
-	// Convert to 1-bit
-	FIBITMAP *new_dib = FreeImage_Threshold(dib8, 128);
-	FreeImage_Unload(dib8);
+	if(NULL == new_dib) return NULL;
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(new_dib, dib);
@@ -437,34 +546,20 @@ FreeImage_Threshold(FIBITMAP *dib, BYTE T) {
 	}
 	if(NULL == dib8) return NULL;
 
-	// Allocate a new 1-bit DIB
-	int width = FreeImage_GetWidth(dib);
-	int height = FreeImage_GetHeight(dib);
-	FIBITMAP *new_dib = FreeImage_Allocate(width, height, 1);
-	if(NULL == new_dib) return NULL;
-	// Build a monochrome palette
-	RGBQUAD *pal = FreeImage_GetPalette(new_dib);
-	pal[0].rgbRed = pal[0].rgbGreen = pal[0].rgbBlue = 0;
-	pal[1].rgbRed = pal[1].rgbGreen = pal[1].rgbBlue = 255;
-
 	// Perform the thresholding
 	//
-	for(int y = 0; y < height; y++) {
-		BYTE *bits8 = FreeImage_GetScanLine(dib8, y);
-		BYTE *bits1 = FreeImage_GetScanLine(new_dib, y);
-		for(int x = 0; x < width; x++) {
-			if(bits8[x] < T) {
-				// Set bit(x, y) to 0
-				bits1[x >> 3] &= (0xFF7F >> (x & 0x7));
-			} else {
-				// Set bit(x, y) to 1
-				bits1[x >> 3] |= (0x80 >> (x & 0x7));
-			}
-		}
+	FIBITMAP *new_dib = NULL;
+	const unsigned width = FreeImage_GetWidth(dib8);
+	BYTE *thresholds = (BYTE*)malloc(width * sizeof(BYTE));
+	if(thresholds) {
+		memset(thresholds, T, width);
+		new_dib = ThresholdRows(dib8, thresholds, 1);
+		free(thresholds);
 	}
 	if(dib8 != dib) {
 		FreeImage_Unload(dib8);
 	}
+	if(NULL == new_dib) return NULL;
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(new_dib, dib);
@@ -22,6 +22,9 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#include <atomic>
 
 LFPQuantizer::LFPQuantizer(unsigned PaletteSize) :
 		m_size(0), m_limit(PaletteSize), m_index(0) {
@@ -49,93 +52,113 @@ FIBITMAP* LFPQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, RGBQUAD *Reserv
 
 	const unsigned src_pitch = FreeImage_GetPitch(dib);
 	const unsigned dst_pitch = FreeImage_GetPitch(dib8);
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
 
 	const BYTE * const src_bits = FreeImage_GetBits(dib);
 	BYTE * const dst_bits = FreeImage_GetBits(dib8);
 
-	unsigned last_color = -1;
-	int last_index = 0;
+	// Each band of rows is first quantized on its own, with the colors
+	// of the band in the order they appear. Merging the band palettes in
+	// band order then adds the colors to the palette in the same order as
+	// a single scan of the image would do.
+	const unsigned band_rows = MAX(1U, BAND_PIXELS / width);
+	const unsigned band_count = (height + band_rows - 1) / band_rows;
+
+	std::vector<BandPalette> bands(band_count);
+	std::atomic<bool> failed(false);
+
+	ParallelFor(0, band_count, 1, [&](unsigned first, unsigned last) {
+		for (unsigned band = first; (band < last) && !failed; ++band) {
+			LFPQuantizer quantizer(m_limit);
+			const unsigned first_row = band * band_rows;
+			const unsigned last_row = MIN(height, first_row + band_rows);
+			if (!quantizer.QuantizeRows(src_bits, src_pitch, bytespp, width, first_row, last_row, dst_bits, dst_pitch)) {
+				// this band alone has too many colors
+				failed = true;
+				return;
+			}
+			quantizer.WritePalette(bands[band].color);
+			bands[band].size = quantizer.m_size;
+		}
+	});
+
+	bool identity = true;
+	for (unsigned band = 0; (band < band_count) && !failed; ++band) {
+		BandPalette &palette = bands[band];
+		for (unsigned i = 0; i < palette.size; ++i) {
+			const int index = GetIndexForColor(palette.color[i]);
+			if (index == -1) {
+				failed = true;
+				break;
+			}
+			palette.index[i] = (BYTE)index;
+			identity = identity && (index == (int)i);
+		}
+	}
+	if (failed) {
+		FreeImage_Unload(dib8);
+		return NULL;
+	}
 
-	if (FreeImage_GetBPP(dib) == 24) {
-
-		// Getting the source pixel as an unsigned int is much faster than
-		// working with FI_RGBA_xxx and shifting. However, this may fail
-		// for the very last pixel, since its rgbReserved member (alpha)
-		// may actually point to an address beyond the bitmap's memory. So,
-		// we do not process the last scanline in the first loop.
-
-		// Process all but the last scanline.
-		for (unsigned y = 0; y < height - 1; ++y) {
-			BYTE *dst_line = dst_bits + y * dst_pitch;
-			const BYTE *src_line = src_bits + y * src_pitch;
-			for (unsigned x = 0; x < width; ++x) {
-				const unsigned color = *((unsigned *) src_line) & 0x00FFFFFF;
-				if (color != last_color) {
-					last_color = color;
-					last_index = GetIndexForColor(color);
-					if (last_index == -1) {
-						FreeImage_Unload(dib8);
-						return NULL;
+	// remap the band indices to the palette indices
+	if (!identity) {
+		ParallelFor(0, band_count, 1, [&](unsigned first, unsigned last) {
+			for (unsigned band = first; band < last; ++band) {
+				const BYTE *index = bands[band].index;
+				const unsigned last_row = MIN(height, (band + 1) * band_rows);
+				for (unsigned y = band * band_rows; y < last_row; ++y) {
+					BYTE *dst_line = dst_bits + y * dst_pitch;
+					for (unsigned x = 0; x < width; ++x) {
+						dst_line[x] = index[dst_line[x]];
 					}
 				}
-				dst_line[x] = last_index;
-				src_line += 3;
 			}
-		}
+		});
+	}
+
+	WritePalette(FreeImage_GetPalette(dib8));
+	return dib8;
+}
+
+/**
+ * Quantizes the rows [first, last) of a 24-bit or 32-bit image, putting
+ * their colors into the map in the order they appear.
+ * @return returns false, if the rows have more colors than the desired
+ * palette size
+ */
+bool LFPQuantizer::QuantizeRows(const BYTE *src_bits, unsigned src_pitch, unsigned bytespp, unsigned width, unsigned first, unsigned last, BYTE *dst_bits, unsigned dst_pitch) {
+
+	// Getting the source pixel as an unsigned int is much faster than
+	// working with FI_RGBA_xxx and shifting. However, with 24-bit pixels,
+	// this may fail for the very last pixel of the image, since its
+	// rgbReserved member (alpha) may actually point to an address beyond
+	// the bitmap's memory. So, the last pixel of each row is read byte by byte.
+	const unsigned fast_width = (bytespp == 3) ? width - 1 : width;
 
-		// Process all but the last pixel of the last scanline.
-		BYTE *dst_line = dst_bits + (height - 1) * dst_pitch;
-		const BYTE *src_line = src_bits + (height - 1) * src_pitch;
-		for (unsigned x = 0; x < width - 1; ++x) {
-			const unsigned color = *((unsigned *) src_line) & 0x00FFFFFF;
+	unsigned last_color = EMPTY_BUCKET;
+	int last_index = 0;
+
+	for (unsigned y = first; y < last; ++y) {
+		BYTE *dst_line = dst_bits + y * dst_pitch;
+		const BYTE *src_line = src_bits + y * src_pitch;
+		for (unsigned x = 0; x < width; ++x) {
+			const unsigned color = (x < fast_width) ? *((unsigned *) src_line) & 0x00FFFFFF :
+				0 | src_line[FI_RGBA_BLUE] << FI_RGBA_BLUE_SHIFT
+				| src_line[FI_RGBA_GREEN] << FI_RGBA_GREEN_SHIFT
+				| src_line[FI_RGBA_RED] << FI_RGBA_RED_SHIFT;
 			if (color != last_color) {
 				last_color = color;
 				last_index = GetIndexForColor(color);
 				if (last_index == -1) {
-					FreeImage_Unload(dib8);
-					return NULL;
+					return false;
 				}
 			}
 			dst_line[x] = last_index;
-			src_line += 3;
-		}
-
-		// Process the last pixel (src_line should already point to it).
-		const unsigned color = 0 | src_line[FI_RGBA_BLUE] << FI_RGBA_BLUE_SHIFT
-				| src_line[FI_RGBA_GREEN] << FI_RGBA_GREEN_SHIFT
-				| src_line[FI_RGBA_RED] << FI_RGBA_RED_SHIFT;
-		if (color != last_color) {
-			last_color = color;
-			last_index = GetIndexForColor(color);
-			if (last_index == -1) {
-				FreeImage_Unload(dib8);
-				return NULL;
-			}
-		}
-		dst_line[width - 1] = last_index;
-
-	} else {
-		for (unsigned y = 0; y < height; ++y) {
-			BYTE *dst_line = dst_bits + y * dst_pitch;
-			const BYTE *src_line = src_bits + y * src_pitch;
-			for (unsigned x = 0; x < width; ++x) {
-				const unsigned color = *((unsigned *) src_line) & 0x00FFFFFF;
-				if (color != last_color) {
-					last_color = color;
-					last_index = GetIndexForColor(color);
-					if (last_index == -1) {
-						FreeImage_Unload(dib8);
-						return NULL;
-					}
-				}
-				dst_line[x] = last_index;
-				src_line += 4;
-			}
+			src_line += bytespp;
 		}
 	}
 
-	WritePalette(FreeImage_GetPalette(dib8));
-	return dib8;
+	return true;
 }
 
 /**
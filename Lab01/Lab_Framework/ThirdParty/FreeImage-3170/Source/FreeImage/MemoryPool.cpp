@@ -0,0 +1,408 @@
+// ==========================================================
+// Pooled allocator for bitmap memory
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// Visual Studio 2013 and earlier cannot have thread_local objects:
+// the thread caches are then disabled and every thread uses the global pool
+#if !defined(_MSC_VER) || (_MSC_VER >= 1900)
+#define POOL_THREAD_CACHE
+#endif
+
+// ----------------------------------------------------------
+//   Size classes
+// ----------------------------------------------------------
+
+namespace {
+
+/// Block alignment: a cache line, which is enough for any SIMD load or store
+const size_t POOL_ALIGNMENT = 64;
+/// Smallest size class is 2^POOL_MIN_SHIFT bytes (1 KB)
+const unsigned POOL_MIN_SHIFT = 10;
+/// Largest size class is 2^POOL_MAX_SHIFT bytes (256 MB), larger blocks are never pooled
+const unsigned POOL_MAX_SHIFT = 28;
+/// Number of size classes per power of two, this bounds the wasted memory to 25%
+const unsigned POOL_STEPS = 4;
+/// Total number of size classes
+const unsigned POOL_CLASS_COUNT = (POOL_MAX_SHIFT - POOL_MIN_SHIFT) * POOL_STEPS + 1;
+/// Size class of a block that does not belong to the pool
+const unsigned POOL_UNPOOLED = 0xFFFFFFFF;
+
+/// Maximum number of blocks per size class in a thread cache
+const size_t THREAD_CACHE_BLOCKS = 4;
+/// Maximum number of bytes in a thread cache
+const size_t THREAD_CACHE_BYTES = (size_t)32 << 20;
+
+/**
+Header stored in front of every block returned by FreeImage_Pool_Malloc
+*/
+struct BlockHeader {
+	void *raw;				//! pointer returned by malloc
+	size_t size;			//! usable size of the block
+	unsigned size_class;	//! size class or POOL_UNPOOLED
+};
+
+/// Space reserved for the block header, keeps the user pointer aligned
+const size_t POOL_PREFIX = ((sizeof(BlockHeader) + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT) * POOL_ALIGNMENT;
+
+/**
+Returns the size class able to hold 'size' bytes, or POOL_UNPOOLED
+*/
+static unsigned
+SizeToClass(size_t size) {
+	if (size <= ((size_t)1 << POOL_MIN_SHIFT)) {
+		return 0;
+	}
+	if (size > ((size_t)1 << POOL_MAX_SHIFT)) {
+		return POOL_UNPOOLED;
+	}
+
+	// find 'shift' such that 2^shift < size <= 2^(shift+1)
+	unsigned shift = POOL_MIN_SHIFT;
+	while (((size_t)1 << (shift + 1)) < size) {
+		shift++;
+	}
+	const size_t base = (size_t)1 << shift;
+	const size_t step = base / POOL_STEPS;
+
+	return (shift - POOL_MIN_SHIFT) * POOL_STEPS + (unsigned)((size - base + step - 1) / step);
+}
+
+/**
+Returns the usable size of the blocks of a size class
+*/
+static size_t
+ClassToSize(unsigned size_class) {
+	const size_t base = (size_t)1 << (POOL_MIN_SHIFT + size_class / POOL_STEPS);
+	return base + (size_class % POOL_STEPS) * (base / POOL_STEPS);
+}
+
+static inline BlockHeader *
+GetHeader(void *mem) {
+	return (BlockHeader *)((BYTE *)mem - POOL_PREFIX);
+}
+
+/**
+Allocate an aligned block from the C heap and fill-in its header
+*/
+static void *
+RawAlloc(size_t size, unsigned size_class) {
+	void *raw = malloc(size + POOL_PREFIX + POOL_ALIGNMENT);
+	if (!raw) {
+		return NULL;
+	}
+	BYTE *mem = (BYTE *)raw + POOL_PREFIX;
+	mem += (POOL_ALIGNMENT - ((size_t)mem % POOL_ALIGNMENT)) % POOL_ALIGNMENT;
+
+	BlockHeader *header = GetHeader(mem);
+	header->raw = raw;
+	header->size = size;
+	header->size_class = size_class;
+
+	return mem;
+}
+
+static inline void
+RawFree(void *mem) {
+	free(GetHeader(mem)->raw);
+}
+
+// ----------------------------------------------------------
+//   Statistics and settings
+// ----------------------------------------------------------
+
+std::atomic<bool> s_enabled(false);
+std::atomic<size_t> s_max_retained((size_t)256 << 20);
+
+std::atomic<UINT64> s_requests(0);
+std::atomic<UINT64> s_hits(0);
+std::atomic<UINT64> s_thread_hits(0);
+std::atomic<size_t> s_bytes_retained(0);
+std::atomic<size_t> s_bytes_in_use(0);
+
+/**
+Try to account for 'size' more retained bytes, within the limit set by the user
+*/
+static bool
+ReserveRetained(size_t size) {
+	size_t retained = s_bytes_retained;
+	do {
+		if (retained + size > s_max_retained) {
+			return false;
+		}
+	} while (!s_bytes_retained.compare_exchange_weak(retained, retained + size));
+	return true;
+}
+
+// ----------------------------------------------------------
+//   Global pool
+// ----------------------------------------------------------
+
+/**
+Free lists shared by all threads, protected by a mutex
+*/
+class GlobalPool {
+public:
+	/// The pool is never destroyed, so that thread caches can be flushed at any time
+	static GlobalPool& instance() {
+		static GlobalPool *s_pool = new GlobalPool;
+		return *s_pool;
+	}
+
+	void *pop(unsigned size_class) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<void *>& blocks = m_blocks[size_class];
+		if (blocks.empty()) {
+			return NULL;
+		}
+		void *mem = blocks.back();
+		blocks.pop_back();
+		return mem;
+	}
+
+	/// The caller must have reserved the retained bytes
+	void push(void *mem) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_blocks[GetHeader(mem)->size_class].push_back(mem);
+	}
+
+	void purge() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (unsigned c = 0; c < POOL_CLASS_COUNT; c++) {
+			std::vector<void *>& blocks = m_blocks[c];
+			for (size_t i = 0; i < blocks.size(); i++) {
+				s_bytes_retained -= GetHeader(blocks[i])->size;
+				RawFree(blocks[i]);
+			}
+			std::vector<void *>().swap(blocks);
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<void *> m_blocks[POOL_CLASS_COUNT];
+};
+
+// ----------------------------------------------------------
+//   Thread cache
+// ----------------------------------------------------------
+
+#ifdef POOL_THREAD_CACHE
+
+class ThreadCache;
+
+/**
+List of the live thread caches, so that a purge can drain the caches of all threads
+*/
+struct CacheRegistry {
+	/// The registry is never destroyed, like the global pool
+	static CacheRegistry& instance() {
+		static CacheRegistry *s_registry = new CacheRegistry;
+		return *s_registry;
+	}
+
+	std::mutex mutex;
+	std::vector<ThreadCache *> caches;
+};
+
+/**
+A few blocks per size class, owned by one thread.
+The cache mutex is only contended while another thread purges the pool.
+Remaining blocks are handed to the global pool when the thread exits.
+*/
+class ThreadCache {
+public:
+	ThreadCache() : m_bytes(0) {
+		CacheRegistry& registry = CacheRegistry::instance();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.caches.push_back(this);
+	}
+
+	~ThreadCache() {
+		{
+			CacheRegistry& registry = CacheRegistry::instance();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			std::vector<ThreadCache *>& caches = registry.caches;
+			for (size_t i = 0; i < caches.size(); i++) {
+				if (caches[i] == this) {
+					caches[i] = caches.back();
+					caches.pop_back();
+					break;
+				}
+			}
+		}
+		flush();
+	}
+
+	void *pop(unsigned size_class) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<void *>& blocks = m_blocks[size_class];
+		if (blocks.empty()) {
+			return NULL;
+		}
+		void *mem = blocks.back();
+		blocks.pop_back();
+		m_bytes -= GetHeader(mem)->size;
+		return mem;
+	}
+
+	/// The caller must have reserved the retained bytes
+	bool push(void *mem) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const BlockHeader *header = GetHeader(mem);
+		std::vector<void *>& blocks = m_blocks[header->size_class];
+		if ((blocks.size() >= THREAD_CACHE_BLOCKS) || (m_bytes + header->size > THREAD_CACHE_BYTES)) {
+			return false;
+		}
+		blocks.push_back(mem);
+		m_bytes += header->size;
+		return true;
+	}
+
+	void flush() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		GlobalPool& pool = GlobalPool::instance();
+		for (unsigned c = 0; c < POOL_CLASS_COUNT; c++) {
+			std::vector<void *>& blocks = m_blocks[c];
+			for (size_t i = 0; i < blocks.size(); i++) {
+				pool.push(blocks[i]);
+			}
+			blocks.clear();
+		}
+		m_bytes = 0;
+	}
+
+	/// Hand the blocks of every thread cache to the global pool
+	static void flushAll() {
+		CacheRegistry& registry = CacheRegistry::instance();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		for (size_t i = 0; i < registry.caches.size(); i++) {
+			registry.caches[i]->flush();
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<void *> m_blocks[POOL_CLASS_COUNT];
+	size_t m_bytes;
+};
+
+static thread_local ThreadCache t_cache;
+
+#endif // POOL_THREAD_CACHE
+
+} // namespace
+
+// ----------------------------------------------------------
+//   Internal API
+// ----------------------------------------------------------
+
+void*
+FreeImage_Pool_Malloc(size_t amount) {
+	s_requests++;
+
+	const unsigned size_class = s_enabled ? SizeToClass(amount) : POOL_UNPOOLED;
+
+	if (size_class != POOL_UNPOOLED) {
+		void *mem = NULL;
+#ifdef POOL_THREAD_CACHE
+		mem = t_cache.pop(size_class);
+		if (mem) {
+			s_thread_hits++;
+		}
+#endif
+		if (!mem) {
+			mem = GlobalPool::instance().pop(size_class);
+		}
+		if (mem) {
+			const size_t size = GetHeader(mem)->size;
+			s_hits++;
+			s_bytes_retained -= size;
+			s_bytes_in_use += size;
+			return mem;
+		}
+		// round up, so that the block can be reused for any request of this class
+		amount = ClassToSize(size_class);
+	}
+
+	void *mem = RawAlloc(amount, size_class);
+	if (mem) {
+		s_bytes_in_use += amount;
+	}
+	return mem;
+}
+
+void
+FreeImage_Pool_Free(void *mem) {
+	if (!mem) {
+		return;
+	}
+
+	const BlockHeader *header = GetHeader(mem);
+	const size_t size = header->size;
+	s_bytes_in_use -= size;
+
+	if ((header->size_class != POOL_UNPOOLED) && s_enabled && ReserveRetained(size)) {
+#ifdef POOL_THREAD_CACHE
+		if (t_cache.push(mem)) {
+			return;
+		}
+#endif
+		GlobalPool::instance().push(mem);
+		return;
+	}
+
+	RawFree(mem);
+}
+
+// ----------------------------------------------------------
+//   Public API
+// ----------------------------------------------------------
+
+void DLL_CALLCONV
+FreeImage_SetMemoryPool(BOOL enable, unsigned max_retained_mb) {
+	s_max_retained = (size_t)max_retained_mb << 20;
+	s_enabled = enable ? true : false;
+	if (!enable) {
+		FreeImage_PurgeMemoryPool();
+	}
+}
+
+void DLL_CALLCONV
+FreeImage_PurgeMemoryPool() {
+#ifdef POOL_THREAD_CACHE
+	ThreadCache::flushAll();
+#endif
+	GlobalPool::instance().purge();
+}
+
+void DLL_CALLCONV
+FreeImage_GetMemoryPoolStats(FIMEMORYPOOLSTATS *stats) {
+	if (stats) {
+		stats->requests = s_requests;
+		stats->hits = s_hits;
+		stats->thread_hits = s_thread_hits;
+		stats->bytes_retained = s_bytes_retained;
+		stats->bytes_in_use = s_bytes_in_use;
+	}
+}
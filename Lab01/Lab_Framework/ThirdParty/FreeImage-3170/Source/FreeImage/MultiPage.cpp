@@ -35,6 +35,11 @@
 #include "Plugin.h"
 #include "Utilities.h"
 #include "FreeImage.h"
+#include "ThreadPool.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 // ----------------------------------------------------------
 
@@ -77,6 +82,10 @@ typedef std::list<BlockTypeS *>::iterator BlockListIterator;
 
 // ----------------------------------------------------------
 
+class PagePrefetcher;
+
+// ----------------------------------------------------------
+
 FI_STRUCT (MULTIBITMAPHEADER) {
 	PluginNode *node;
 	FREE_IMAGE_FORMAT fif;
@@ -91,6 +100,258 @@ FI_STRUCT (MULTIBITMAPHEADER) {
 	BOOL read_only;
 	FREE_IMAGE_FORMAT cache_fif;
 	int load_flags;
+	FIMEMORY *m_stream;
+	PagePrefetcher *m_prefetcher;
+};
+
+// ----------------------------------------------------------
+
+/// Memory held by prefetched pages when FreeImage_PrefetchPages is given no budget
+static const size_t PREFETCH_DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+/**
+Decodes pages of a multipage bitmap on the worker pool, ahead of FreeImage_LockPage.<br>
+Workers never use the IO of the multipage bitmap: each of them opens the source file,
+or wraps the source memory stream, on its own. Pages are decoded in the order they were
+requested. Decoding stops while the decoded pages exceed the memory budget, and resumes
+when they are taken.
+*/
+class PagePrefetcher {
+public:
+	PagePrefetcher(PluginNode *node, const char *filename, FIMEMORY *stream, int flags, int page_count)
+		: m_node(node), m_filename(filename ? filename : ""), m_stream(stream), m_flags(flags), m_page_count(page_count),
+		m_budget(PREFETCH_DEFAULT_BUDGET), m_ready_bytes(0), m_page_bytes(0), m_max_decoding(0), m_decoding(0) {
+	}
+
+	~PagePrefetcher() {
+		cancel();
+	}
+
+	/**
+	Queue pages [first, first + count) for decoding. Pages already queued or decoded are skipped.
+	*/
+	void schedule(int first, int count, size_t budget) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_budget = budget;
+		// the thread calling FreeImage_LockPage keeps one of the allowed threads busy
+		m_max_decoding = ParallelGetThreadCount() - 1;
+
+		const int last = MIN(first + count, m_page_count);
+		for (int page = MAX(first, 0); page < last; page++) {
+			if (m_pages.find(page) == m_pages.end()) {
+				m_pages[page] = PageEntry();
+				m_queue.push_back(page);
+			}
+		}
+
+		pump();
+	}
+
+	/**
+	Returns a decoded page and hands it over to the caller, waiting if the page is being decoded.
+	Returns NULL if the page was not prefetched, and forgets it if it was still waiting in the queue.
+	*/
+	FIBITMAP *take(int page) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		std::map<int, PageEntry>::iterator i = m_pages.find(page);
+		if (i == m_pages.end()) {
+			return NULL;
+		}
+		if (i->second.state == PAGE_QUEUED) {
+			// the caller will not wait for a worker: decoding right away is faster
+			m_pages.erase(i);
+			return NULL;
+		}
+
+		m_changed.wait(lock, [this, page, &i] {
+			i = m_pages.find(page);
+			return (i == m_pages.end()) || (i->second.state != PAGE_DECODING);
+		});
+		if (i == m_pages.end()) {
+			// decoding failed
+			return NULL;
+		}
+
+		FIBITMAP *dib = i->second.dib;
+		m_ready_bytes -= i->second.bytes;
+		m_pages.erase(i);
+
+		pump();
+
+		return dib;
+	}
+
+	/**
+	Forget the queued pages, wait for the pages being decoded and release all decoded pages
+	*/
+	void cancel() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_queue.clear();
+		m_changed.wait(lock, [this] { return m_decoding == 0; });
+
+		for (std::map<int, PageEntry>::iterator i = m_pages.begin(); i != m_pages.end(); ++i) {
+			FreeImage_Unload(i->second.dib);
+		}
+		m_pages.clear();
+		m_ready_bytes = 0;
+	}
+
+private:
+	enum PageState { PAGE_QUEUED, PAGE_DECODING, PAGE_READY };
+
+	struct PageEntry {
+		PageState state;
+		FIBITMAP *dib;
+		size_t bytes;
+
+		PageEntry() : state(PAGE_QUEUED), dib(NULL), bytes(0) {
+		}
+	};
+
+	struct DecodeTask {
+		PagePrefetcher *prefetcher;
+		int page;
+	};
+
+	/**
+	Start decoding queued pages, as long as workers and memory are available. m_mutex must be locked.
+	*/
+	void pump() {
+		while (!m_queue.empty() && (m_decoding < m_max_decoding)) {
+			// estimate the memory of the pages being decoded with the largest page seen so far,
+			// but never stall when nothing is pending
+			const size_t pending = m_ready_bytes + m_decoding * m_page_bytes;
+			if ((pending > 0) && (pending + m_page_bytes > m_budget)) {
+				break;
+			}
+
+			const int page = m_queue.front();
+			m_queue.pop_front();
+
+			std::map<int, PageEntry>::iterator i = m_pages.find(page);
+			if ((i == m_pages.end()) || (i->second.state != PAGE_QUEUED)) {
+				// taken while it was waiting in the queue
+				continue;
+			}
+
+			DecodeTask *task = new(std::nothrow) DecodeTask;
+			if (!task) {
+				m_pages.erase(i);
+				continue;
+			}
+			task->prefetcher = this;
+			task->page = page;
+
+			// the task cannot report its page before m_mutex is released
+			ParallelSubmit(&PagePrefetcher::run, task);
+
+			i->second.state = PAGE_DECODING;
+			m_decoding++;
+		}
+	}
+
+	static void run(void *context) {
+		DecodeTask *task = (DecodeTask *)context;
+		PagePrefetcher *prefetcher = task->prefetcher;
+		const int page = task->page;
+		delete task;
+
+		// a page that fails to decode is reported as missing, so that
+		// take() falls back to decoding it on the calling thread
+		FIBITMAP *dib = NULL;
+		try {
+			dib = prefetcher->load(page);
+		} catch(...) {
+			dib = NULL;
+		}
+		prefetcher->decoded(page, dib);
+	}
+
+	/**
+	Decode a page through a private handle on the source
+	*/
+	FIBITMAP *load(int page) {
+		FreeImageIO io;
+		fi_handle handle = NULL;
+		FIMEMORY *view = NULL;
+
+		if (m_stream) {
+			// a read-only view of the stream, with its own position
+			FIMEMORYHEADER *mem_header = (FIMEMORYHEADER *)m_stream->data;
+			SetMemoryIO(&io);
+			view = FreeImage_OpenMemory((BYTE *)mem_header->data, (DWORD)mem_header->file_length);
+			handle = (fi_handle)view;
+		} else {
+			SetDefaultIO(&io);
+			handle = (fi_handle)fopen(m_filename.c_str(), "rb");
+		}
+		if (!handle) {
+			return NULL;
+		}
+
+		FIBITMAP *dib = NULL;
+
+		void *data = FreeImage_Open(m_node, &io, handle, TRUE);
+		if (data != NULL) {
+			dib = (m_node->m_plugin->load_proc != NULL) ? m_node->m_plugin->load_proc(&io, handle, page, m_flags, data) : NULL;
+
+			FreeImage_Close(m_node, &io, handle, data);
+		}
+
+		if (view) {
+			FreeImage_CloseMemory(view);
+		} else {
+			fclose((FILE *)handle);
+		}
+
+		return dib;
+	}
+
+	void decoded(int page, FIBITMAP *dib) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::map<int, PageEntry>::iterator i = m_pages.find(page);
+		if (dib) {
+			PageEntry& entry = i->second;
+			entry.state = PAGE_READY;
+			entry.dib = dib;
+			entry.bytes = FreeImage_GetMemorySize(dib);
+			m_ready_bytes += entry.bytes;
+			m_page_bytes = MAX(m_page_bytes, entry.bytes);
+		} else {
+			m_pages.erase(i);
+		}
+		m_decoding--;
+
+		pump();
+
+		// notify while locked: a waiting cancel() may destroy this object as soon as the lock is released
+		m_changed.notify_all();
+	}
+
+private:
+	PluginNode *m_node;
+	std::string m_filename;
+	FIMEMORY *m_stream;
+	int m_flags;
+	int m_page_count;
+
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	/// Queued, decoding and decoded pages, indexed by page number
+	std::map<int, PageEntry> m_pages;
+	/// Pages waiting for a worker, in request order
+	std::deque<int> m_queue;
+	size_t m_budget;
+	/// Memory held by the decoded pages
+	size_t m_ready_bytes;
+	/// Memory used by the largest page decoded so far
+	size_t m_page_bytes;
+	unsigned m_max_decoding;
+	unsigned m_decoding;
 };
 
 // =====================================================================
@@ -275,6 +536,8 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, BOOL crea
 				header->m_cachefile = NULL;
 				header->cache_fif = fif;
 				header->load_flags = flags;
+				header->m_stream = NULL;
+				header->m_prefetcher = NULL;
 
 				// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
 
@@ -349,6 +612,8 @@ FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_h
 					header->m_cachefile = NULL;
 					header->cache_fif = fif;
 					header->load_flags = flags;
+					header->m_stream = NULL;
+					header->m_prefetcher = NULL;
 							
 					// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
 
@@ -493,6 +758,10 @@ FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags) {
 		
 		if (bitmap->data) {
 			MULTIBITMAPHEADER *header = FreeImage_GetMultiBitmapHeader(bitmap);			
+
+			// stop the workers before the source is closed
+
+			delete header->m_prefetcher;
 			
 			// saves changes only of images loaded directly from a file
 			if (header->changed && header->m_filename) {
@@ -736,6 +1005,18 @@ FreeImage_LockPage(FIMULTIBITMAP *bitmap, int page) {
 			}
 		}
 
+		// use the prefetched page, if any
+
+		if (header->m_prefetcher) {
+			FIBITMAP *dib = header->m_prefetcher->take(page);
+
+			if (dib) {
+				header->locked_pages[dib] = page;
+
+				return dib;
+			}
+		}
+
 		// open the bitmap
 
 		header->io->seek_proc(header->handle, 0, SEEK_SET);
@@ -888,6 +1169,47 @@ FreeImage_GetLockedPageNumbers(FIMULTIBITMAP *bitmap, int *pages, int *count) {
 	return FALSE;
 }
 
+BOOL DLL_CALLCONV
+FreeImage_PrefetchPages(FIMULTIBITMAP *bitmap, int first, int count, unsigned max_bytes) {
+	if ((bitmap) && (count > 0)) {
+		MULTIBITMAPHEADER *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+		// workers need their own access to the source, which a user handle cannot provide
+
+		if (!header->handle || (!header->m_filename && !header->m_stream)) {
+			return FALSE;
+		}
+		if (ParallelGetThreadCount() < 2) {
+			return FALSE;
+		}
+
+		try {
+			if (!header->m_prefetcher) {
+				header->m_prefetcher = new PagePrefetcher(header->node, header->m_filename, header->m_stream, header->load_flags, FreeImage_InternalGetPageCount(bitmap));
+			}
+
+			header->m_prefetcher->schedule(first, count, (max_bytes > 0) ? (size_t)max_bytes : PREFETCH_DEFAULT_BUDGET);
+
+			return TRUE;
+		} catch (std::bad_alloc &) {
+			FreeImage_OutputMessageProc(header->fif, FI_MSG_ERROR_MEMORY);
+		}
+	}
+
+	return FALSE;
+}
+
+void DLL_CALLCONV
+FreeImage_CancelPrefetch(FIMULTIBITMAP *bitmap) {
+	if (bitmap) {
+		MULTIBITMAPHEADER *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+		if (header->m_prefetcher) {
+			header->m_prefetcher->cancel();
+		}
+	}
+}
+
 // =====================================================================
 // Memory IO Multipage functions
 // =====================================================================
@@ -925,6 +1247,8 @@ FreeImage_LoadMultiBitmapFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int
 						header->m_cachefile = NULL;
 						header->cache_fif = fif;
 						header->load_flags = flags;
+						header->m_stream = stream;
+						header->m_prefetcher = NULL;
 
 						// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
 
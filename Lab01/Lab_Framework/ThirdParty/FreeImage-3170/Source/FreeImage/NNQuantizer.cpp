@@ -33,6 +33,7 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
 
 // Four primes near 500 - assume no image has a length so large
@@ -44,6 +45,10 @@
 #define prime3		487
 #define prime4		503
 
+// Number of colors cached by each band of rows when writing the output image
+#define CACHE_BITS	12
+#define CACHE_SIZE	(1 << CACHE_BITS)
+
 // ----------------------------------------------------------------
 
 NNQuantizer::NNQuantizer(int PaletteSize)
@@ -160,7 +165,7 @@ void NNQuantizer::inxbuild() {
 // Search for BGR values 0..255 (after net is unbiased) and return colour index
 // ----------------------------------------------------------------------------
 
-int NNQuantizer::inxsearch(int b, int g, int r) {
+int NNQuantizer::inxsearch(int b, int g, int r) const {
 	int i, j, dist, a, bestd;
 	int *p;
 	int best;
@@ -491,17 +496,33 @@ FIBITMAP* NNQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, RGBQUAD *Reserve
 	inxbuild();
 
 	// 6) Write output image using inxsearch(b,g,r)
+	// inxsearch only reads the network, so bands of rows are mapped in parallel. 
+	// Each band remembers the last colors it has looked up, since most images 
+	// use the same colors again and again
+
+	ParallelFor(0, img_height, MAX(1, 65536 / img_width), [&](unsigned first, unsigned last) {
+		unsigned cache_color[CACHE_SIZE];
+		BYTE cache_index[CACHE_SIZE];
+		// 0xFFFFFFFF is not a 24-bit color
+		memset(cache_color, 0xFF, sizeof(cache_color));
+
+		for (unsigned rows = first; rows < last; rows++) {
+			BYTE *new_bits = FreeImage_GetScanLine(new_dib, rows);
+			const BYTE *bits = FreeImage_GetScanLine(dib_ptr, rows);
+
+			for (int cols = 0; cols < img_width; cols++) {
+				const unsigned color = (bits[FI_RGBA_BLUE] << 16) | (bits[FI_RGBA_GREEN] << 8) | bits[FI_RGBA_RED];
+				const unsigned slot = (color * 2654435761U) >> (32 - CACHE_BITS);
+				if (cache_color[slot] != color) {
+					cache_color[slot] = color;
+					cache_index[slot] = (BYTE)inxsearch(bits[FI_RGBA_BLUE], bits[FI_RGBA_GREEN], bits[FI_RGBA_RED]);
+				}
+				new_bits[cols] = cache_index[slot];
 
-	for (WORD rows = 0; rows < img_height; rows++) {
-		BYTE *new_bits = FreeImage_GetScanLine(new_dib, rows);			
-		BYTE *bits = FreeImage_GetScanLine(dib_ptr, rows);
-
-		for (WORD cols = 0; cols < img_width; cols++) {
-			new_bits[cols] = (BYTE)inxsearch(bits[FI_RGBA_BLUE], bits[FI_RGBA_GREEN], bits[FI_RGBA_RED]);
-
-			bits += 3;
+				bits += 3;
+			}
 		}
-	}
+	});
 
 	return (FIBITMAP*) new_dib;
 }
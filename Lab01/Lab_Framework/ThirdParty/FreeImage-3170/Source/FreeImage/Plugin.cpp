@@ -37,6 +37,9 @@
 #include "Utilities.h"
 #include "FreeImageIO.h"
 #include "Plugin.h"
+#include "ThreadPool.h"
+
+#include <mutex>
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -57,6 +60,9 @@ s_search_list[] = {
 static int s_search_list_size = sizeof(s_search_list) / sizeof(char *);
 static PluginList *s_plugins = NULL;
 static int s_plugin_reference_count = 0;
+// serializes FreeImage_Initialise / FreeImage_DeInitialise
+// once initialized, the plugin list is never modified and may be read from any thread
+static std::mutex s_plugin_mutex;
 
 
 // =====================================================================
@@ -217,6 +223,8 @@ FreeImage_GetPluginList() {
 
 void DLL_CALLCONV
 FreeImage_Initialise(BOOL load_local_plugins_only) {
+	std::lock_guard<std::mutex> lock(s_plugin_mutex);
+
 	if (s_plugin_reference_count++ == 0) {
 		
 		/*
@@ -345,10 +353,19 @@ FreeImage_Initialise(BOOL load_local_plugins_only) {
 
 void DLL_CALLCONV
 FreeImage_DeInitialise() {
+	std::lock_guard<std::mutex> lock(s_plugin_mutex);
+
 	--s_plugin_reference_count;
 
 	if (s_plugin_reference_count == 0) {
+		// pending tasks may still use the plugins, stop the workers first
+		ParallelShutdown();
+
 		delete s_plugins;
+		s_plugins = NULL;
+
+		// give the pooled pixel buffers back to the system
+		FreeImage_PurgeMemoryPool();
 	}
 }
 
@@ -724,6 +741,41 @@ FreeImage_FIFSupportsNoPixels(FREE_IMAGE_FORMAT fif) {
 	return FALSE;
 }
 
+/**
+Check if a comma separated extension list (e.g. "tif,tiff") contains an extension.
+The comparison is case insensitive. Unlike strtok, this is safe to use from several threads.
+*/
+static BOOL
+ExtensionListContains(const char *list, const char *extension) {
+	if (!list) {
+		return FALSE;
+	}
+
+	const size_t length = strlen(extension);
+
+	while (*list) {
+		const char *end = strchr(list, ',');
+		const size_t token_length = end ? (size_t)(end - list) : strlen(list);
+
+		if (token_length == length) {
+			size_t i = 0;
+			while ((i < length) && (tolower(list[i]) == tolower(extension[i]))) {
+				i++;
+			}
+			if (i == length) {
+				return TRUE;
+			}
+		}
+
+		if (!end) {
+			break;
+		}
+		list = end + 1;
+	}
+
+	return FALSE;
+}
+
 FREE_IMAGE_FORMAT DLL_CALLCONV
 FreeImage_GetFIFFromFilename(const char *filename) {
 	if (filename != NULL) {
@@ -744,31 +796,10 @@ FreeImage_GetFIFFromFilename(const char *filename) {
 
 				if (FreeImage_stricmp(FreeImage_GetFormatFromFIF((FREE_IMAGE_FORMAT)i), extension) == 0) {
 					return (FREE_IMAGE_FORMAT)i;
-				} else {
-					// make a copy of the extension list and split it
-
-					char *copy = (char *)malloc(strlen(FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i)) + 1);
-					memset(copy, 0, strlen(FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i)) + 1);
-					memcpy(copy, FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i), strlen(FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i)));
-
-					// get the first token
-
-					char *token = strtok(copy, ",");
-
-					while (token != NULL) {
-						if (FreeImage_stricmp(token, extension) == 0) {
-							free(copy);
-
-								return (FREE_IMAGE_FORMAT)i;
-						}
-
-						token = strtok(NULL, ",");
-					}
-
-					// free the copy of the extension list
-
-					free(copy);
-				}	
+				} else if (ExtensionListContains(FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i), extension)) {
+					// the extension is one of the comma separated list
+					return (FREE_IMAGE_FORMAT)i;
+				}
 			}
 		}
 	}
@@ -22,6 +22,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
 #ifdef _MSC_VER
 // OpenEXR has many problems with MSVC warnings (why not just correct them ?), just ignore one of them
@@ -32,13 +33,20 @@
 #include "../OpenEXR/Iex/Iex.h"
 #include "../OpenEXR/IlmImf/ImfOutputFile.h"
 #include "../OpenEXR/IlmImf/ImfInputFile.h"
+#include "../OpenEXR/IlmImf/ImfTiledInputFile.h"
 #include "../OpenEXR/IlmImf/ImfRgbaFile.h"
 #include "../OpenEXR/IlmImf/ImfChannelList.h"
 #include "../OpenEXR/IlmImf/ImfRgba.h"
 #include "../OpenEXR/IlmImf/ImfArray.h"
 #include "../OpenEXR/IlmImf/ImfPreviewImage.h"
+#include "../OpenEXR/IlmImf/ImfThreading.h"
+#include "../OpenEXR/IlmImf/ImfVersion.h"
+#include "../OpenEXR/IlmThread/IlmThread.h"
 #include "../OpenEXR/Half/half.h"
 
+#include <thread>
+#include <mutex>
+
 
 // ==========================================================
 // Plugin Interface
@@ -111,6 +119,38 @@ public:
 
 // ----------------------------------------------------------
 
+/**
+Start the OpenEXR global thread pool, with one thread per hardware thread
+*/
+static void
+StartEXRThreadPool() {
+	const unsigned hardware = std::thread::hardware_concurrency();
+	Imf::setGlobalThreadCount((hardware > 1) ? (int)hardware : 2);
+}
+
+/**
+Get the number of threads given to an OpenEXR file after FreeImage_SetThreadCount.<br>
+OpenEXR files decompress and compress their line buffers and tiles on the OpenEXR global 
+thread pool, while the calling thread reads or writes the stream. A file opened with 
+n threads keeps 2n line buffers or tiles in flight, so n is half the FreeImage thread count.<br>
+Resizing the global pool waits for the tasks of every open file, so the pool is started 
+once, on first use, and is never resized afterwards.
+@return Returns the number of threads to give to an OpenEXR file, 0 to run on the calling thread only
+*/
+static int
+GetEXRThreadCount() {
+	static std::once_flag s_pool_started;
+
+	const int thread_count = (int)ParallelGetThreadCount();
+	if((thread_count < 2) || !IlmThread::supportsThreads()) {
+		return 0;
+	}
+	std::call_once(s_pool_started, StartEXRThreadPool);
+	return (thread_count + 1) / 2;
+}
+
+// ----------------------------------------------------------
+
 
 // ==========================================================
 // Plugin Implementation
@@ -189,8 +229,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// wrap the FreeImage IO stream
 		C_IStream istream(io, handle);
 
+		const int thread_count = GetEXRThreadCount();
+
 		// open the file
-		Imf::InputFile file(istream);
+		Imf::InputFile file(istream, thread_count);
 
 		// get file info			
 		const Imath::Box2i &dataWindow = file.header().dataWindow();
@@ -358,13 +400,14 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		if(bUseRgbaInterface) {
 			// use the RGBA interface (used when loading RY BY Y images )
 
-			const int chunk_size = 16;
+			// read at least 16 lines into each of the 2 * thread_count line buffers in flight
+			const int chunk_size = 32 * MAX(1, thread_count);
 
 			BYTE *scanline = (BYTE*)bits;
 
 			// re-open using the RGBA interface
 			io->seek_proc(handle, stream_start, SEEK_SET);
-			Imf::RgbaInputFile rgbaFile(istream);
+			Imf::RgbaInputFile rgbaFile(istream, thread_count);
 
 			// read the file in chunks
 			Imath::Box2i dw = dataWindow;
@@ -423,9 +466,18 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				}
 			}
 
-			// read the file
-			file.setFrameBuffer(frameBuffer);
-			file.readPixels(dataWindow.min.y, dataWindow.max.y);
+			if(Imf::isTiled(file.version()) && !Imf::isMultiPart(file.version())) {
+				// InputFile decodes a tiled file one row of tiles at a time, through an intermediate buffer :
+				// decode all the tiles of the full resolution level at once, straight into the dib
+				io->seek_proc(handle, stream_start, SEEK_SET);
+				Imf::TiledInputFile tiledFile(istream, thread_count);
+				tiledFile.setFrameBuffer(frameBuffer);
+				tiledFile.readTiles(0, tiledFile.numXTiles(0) - 1, 0, tiledFile.numYTiles(0) - 1, 0, 0);
+			} else {
+				// read the file
+				file.setFrameBuffer(frameBuffer);
+				file.readPixels(dataWindow.min.y, dataWindow.max.y);
+			}
 		}
 
 		// lastly, flip dib lines
@@ -522,14 +574,9 @@ SaveAsEXR_LC(C_OStream& ostream, FIBITMAP *dib, Imf::Header& header, int width,
 			case FIT_RGBAF:
 				rgbaChannels = Imf::WRITE_YCA;
 				for(y = 0; y < height; y++) {
-					FIRGBAF *src_bits = (FIRGBAF*)FreeImage_GetScanLine(dib, height - 1 - y);
-					for(x = 0; x < width; x++) {
-						Imf::Rgba &dst_bits = pixels[y][x];
-						dst_bits.r = src_bits[x].red;
-						dst_bits.g = src_bits[x].green;
-						dst_bits.b = src_bits[x].blue;
-						dst_bits.a = src_bits[x].alpha;
-					}
+					// Imf::Rgba and FIRGBAF both store R, G, B, A in this order
+					const float *src_bits = (float*)FreeImage_GetScanLine(dib, height - 1 - y);
+					floatToHalfArray(&pixels[y][0].r, src_bits, (size_t)width * 4);
 				}
 				break;
 			default:
@@ -538,7 +585,7 @@ SaveAsEXR_LC(C_OStream& ostream, FIBITMAP *dib, Imf::Header& header, int width,
 		}
 
 		// write the data
-		Imf::RgbaOutputFile file(ostream, header, rgbaChannels);
+		Imf::RgbaOutputFile file(ostream, header, rgbaChannels, GetEXRThreadCount());
 		file.setFrameBuffer (&pixels[0][0], 1, width);
 		file.writePixels (height);
 
@@ -670,15 +717,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			}
 
 			for(int y = 0; y < height; y++) {
-				float *src_bits = (float*)FreeImage_GetScanLine(dib, height - 1 - y);
+				const float *src_bits = (float*)FreeImage_GetScanLine(dib, height - 1 - y);
 				half *dst_bits = halfData + y * width * components;
-				for(int x = 0; x < width; x++) {
-					for(int c = 0; c < components; c++) {
-						dst_bits[c] = src_bits[c];
-					}
-					src_bits += components;
-					dst_bits += components;
-				}
+				floatToHalfArray(dst_bits, src_bits, (size_t)width * components);
 			}
 			bits = (BYTE*)halfData;
 			bytespc = sizeof(half);
@@ -712,7 +753,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		}
 
 		// write the data
-		Imf::OutputFile file (ostream, header);
+		Imf::OutputFile file (ostream, header, GetEXRThreadCount());
 		file.setFrameBuffer (frameBuffer);
 		file.writePixels (height);
 
@@ -38,10 +38,13 @@ extern "C" {
 #include "../LibJPEG/jinclude.h"
 #include "../LibJPEG/jpeglib.h"
 #include "../LibJPEG/jerror.h"
+#include "../LibJPEG/jsimd.h"
 }
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
+#include "ThreadPool.h"
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -1085,6 +1088,889 @@ store_size_info(FIBITMAP *dib, JDIMENSION width, JDIMENSION height) {
 	}
 }
 
+// ------------------------------------------------------------
+//   Scanline conversion helpers, shared by Load / Save and the scanline streams
+// ------------------------------------------------------------
+
+/**
+Set the decompression parameters, start the decompressor and create the dib with its header data.
+@param cinfo Decompressor, after jpeg_read_header
+@param flags Load flags
+@param header_only If TRUE, do not allocate the pixels
+@return Returns the dib, throws an error message on failure
+*/
+static FIBITMAP*
+jpeg_start_decompress_dib(j_decompress_ptr cinfo, int flags, BOOL header_only) {
+	FIBITMAP *dib = NULL;
+
+	// set parameters for decompression
+
+	unsigned int scale_denom = 1;		// fraction by which to scale image
+	int	requested_size = flags >> 16;	// requested user size in pixels
+	if(requested_size > 0) {
+		// the JPEG codec can perform x2, x4 or x8 scaling on loading
+		// try to find the more appropriate scaling according to user's need
+		double scale = MAX((double)cinfo->image_width, (double)cinfo->image_height) / (double)requested_size;
+		if(scale >= 8) {
+			scale_denom = 8;
+		} else if(scale >= 4) {
+			scale_denom = 4;
+		} else if(scale >= 2) {
+			scale_denom = 2;
+		}
+	}
+	cinfo->scale_num = 1;
+	cinfo->scale_denom = scale_denom;
+
+	if ((flags & JPEG_ACCURATE) != JPEG_ACCURATE) {
+		cinfo->dct_method          = JDCT_IFAST;
+		cinfo->do_fancy_upsampling = FALSE;
+	}
+
+	if ((flags & JPEG_GREYSCALE) == JPEG_GREYSCALE) {
+		// force loading as a 8-bit greyscale image
+		cinfo->out_color_space = JCS_GRAYSCALE;
+	}
+
+	// start decompressor and calculate output width and height
+
+	jpeg_start_decompress(cinfo);
+
+	// allocate dib and init header
+
+	if((cinfo->output_components == 4) && (cinfo->out_color_space == JCS_CMYK)) {
+		// CMYK image
+		if((flags & JPEG_CMYK) == JPEG_CMYK) {
+			// load as CMYK
+			dib = FreeImage_AllocateHeader(header_only, cinfo->output_width, cinfo->output_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+			if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
+			FreeImage_GetICCProfile(dib)->flags |= FIICC_COLOR_IS_CMYK;
+		} else {
+			// load as CMYK and convert to RGB
+			dib = FreeImage_AllocateHeader(header_only, cinfo->output_width, cinfo->output_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+			if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
+		}
+	} else {
+		// RGB or greyscale image
+		dib = FreeImage_AllocateHeader(header_only, cinfo->output_width, cinfo->output_height, 8 * cinfo->output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+		if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
+
+		if (cinfo->output_components == 1) {
+			// build a greyscale palette
+			RGBQUAD *colors = FreeImage_GetPalette(dib);
+
+			for (int i = 0; i < 256; i++) {
+				colors[i].rgbRed   = (BYTE)i;
+				colors[i].rgbGreen = (BYTE)i;
+				colors[i].rgbBlue  = (BYTE)i;
+			}
+		}
+	}
+	if(scale_denom != 1) {
+		// store original size info if a scaling was requested
+		store_size_info(dib, cinfo->image_width, cinfo->image_height);
+	}
+
+	// handle metrices
+
+	if (cinfo->density_unit == 1) {
+		// dots/inch
+		FreeImage_SetDotsPerMeterX(dib, (unsigned) (((float)cinfo->X_density) / 0.0254000 + 0.5));
+		FreeImage_SetDotsPerMeterY(dib, (unsigned) (((float)cinfo->Y_density) / 0.0254000 + 0.5));
+	} else if (cinfo->density_unit == 2) {
+		// dots/cm
+		FreeImage_SetDotsPerMeterX(dib, (unsigned) (cinfo->X_density * 100));
+		FreeImage_SetDotsPerMeterY(dib, (unsigned) (cinfo->Y_density * 100));
+	}
+
+	// read special markers
+
+	read_markers(cinfo, dib);
+
+	return dib;
+}
+
+/**
+Read the next scanline and convert it to the dib layout
+@param cinfo Started decompressor
+@param flags Load flags
+@param buffer One-row sample array, used by CMYK images only
+@param dst Output scanline
+*/
+static void
+jpeg_read_dib_scanline(j_decompress_ptr cinfo, int flags, JSAMPARRAY buffer, BYTE *dst) {
+	if((cinfo->out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
+		// convert from CMYK to RGB
+		JSAMPROW src = buffer[0];
+
+		jpeg_read_scanlines(cinfo, buffer, 1);
+
+		for(unsigned x = 0; x < cinfo->output_width; x++) {
+			WORD K = (WORD)src[3];
+			dst[FI_RGBA_RED]   = (BYTE)((K * src[0]) / 255);	// C -> R
+			dst[FI_RGBA_GREEN] = (BYTE)((K * src[1]) / 255);	// M -> G
+			dst[FI_RGBA_BLUE]  = (BYTE)((K * src[2]) / 255);	// Y -> B
+			src += 4;
+			dst += 3;
+		}
+	} else if((cinfo->out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) == JPEG_CMYK)) {
+		// convert from LibJPEG CMYK to standard CMYK
+		JSAMPROW src = buffer[0];
+
+		jpeg_read_scanlines(cinfo, buffer, 1);
+
+		for(unsigned x = 0; x < cinfo->output_width; x++) {
+			// CMYK pixels are inverted
+			dst[0] = ~src[0];	// C
+			dst[1] = ~src[1];	// M
+			dst[2] = ~src[2];	// Y
+			dst[3] = ~src[3];	// K
+			src += 4;
+			dst += 4;
+		}
+	} else {
+		// normal case (RGB or greyscale image)
+
+		jpeg_read_scanlines(cinfo, &dst, 1);
+
+		// swap red and blue components (see LibJPEG/jmorecfg.h: #define RGB_RED, ...)
+		// The default behavior of the JPEG library is kept "as is" because LibTIFF uses 
+		// LibJPEG "as is".
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		if(cinfo->output_components == 3) {
+			for(unsigned x = 0; x < cinfo->output_width; x++) {
+				INPLACESWAP(dst[0], dst[2]);
+				dst += 3;
+			}
+		}
+#endif
+	}
+}
+
+/**
+Check that a dib can be saved as JPEG
+@return Returns an error message, or NULL if the dib can be saved
+*/
+static const char*
+jpeg_check_dib(FIBITMAP *dib) {
+	const char *sError = "only 24-bit highcolor or 8-bit greyscale/palette bitmaps can be saved as JPEG";
+
+	FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
+	WORD bpp = (WORD)FreeImage_GetBPP(dib);
+
+	if ((bpp != 24) && (bpp != 8)) {
+		return sError;
+	}
+
+	if(bpp == 8) {
+		// allow grey, reverse grey and palette 
+		if ((color_type != FIC_MINISBLACK) && (color_type != FIC_MINISWHITE) && (color_type != FIC_PALETTE)) {
+			return sError;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+Set the compression parameters and the quality from the dib header data and the save flags
+*/
+static void
+jpeg_set_dib_parameters(j_compress_ptr cinfo, FIBITMAP *dib, int flags) {
+	// set parameters for compression 
+
+	cinfo->image_width = FreeImage_GetWidth(dib);
+	cinfo->image_height = FreeImage_GetHeight(dib);
+
+	switch(FreeImage_GetColorType(dib)) {
+		case FIC_MINISBLACK :
+		case FIC_MINISWHITE :
+			cinfo->in_color_space = JCS_GRAYSCALE;
+			cinfo->input_components = 1;
+			break;
+
+		default :
+			cinfo->in_color_space = JCS_RGB;
+			cinfo->input_components = 3;
+			break;
+	}
+
+	jpeg_set_defaults(cinfo);
+
+    // progressive-JPEG support
+	if((flags & JPEG_PROGRESSIVE) == JPEG_PROGRESSIVE) {
+		jpeg_simple_progression(cinfo);
+	}
+	
+	// compute optimal Huffman coding tables for the image
+	if((flags & JPEG_OPTIMIZE) == JPEG_OPTIMIZE) {
+		cinfo->optimize_coding = TRUE;
+	}
+
+	// Set JFIF density parameters from the DIB data
+
+	cinfo->X_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterX(dib));
+	cinfo->Y_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterY(dib));
+	cinfo->density_unit = 1;	// dots / inch
+
+	// thumbnail support (JFIF 1.02 extension markers)
+	if(FreeImage_GetThumbnail(dib) != NULL) {
+		cinfo->write_JFIF_header = 1; //<### force it, though when color is CMYK it will be incorrect
+		cinfo->JFIF_minor_version = 2;
+	}
+
+	// restart markers support
+	if((flags & JPEG_RESTART) == JPEG_RESTART) {
+		cinfo->restart_in_rows = 1;
+	}
+
+	// baseline JPEG support
+	if ((flags & JPEG_BASELINE) ==  JPEG_BASELINE) {
+		cinfo->write_JFIF_header = 0;	// No marker for non-JFIF colorspaces
+		cinfo->write_Adobe_marker = 0;	// write no Adobe marker by default				
+	}
+
+	// set subsampling options if required
+
+	if(cinfo->in_color_space == JCS_RGB) {
+		if((flags & JPEG_SUBSAMPLING_411) == JPEG_SUBSAMPLING_411) { 
+			// 4:1:1 (4x1 1x1 1x1) - CrH 25% - CbH 25% - CrV 100% - CbV 100%
+			// the horizontal color resolution is quartered
+			cinfo->comp_info[0].h_samp_factor = 4;	// Y 
+			cinfo->comp_info[0].v_samp_factor = 1; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb 
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr 
+			cinfo->comp_info[2].v_samp_factor = 1; 
+		} else if((flags & JPEG_SUBSAMPLING_420) == JPEG_SUBSAMPLING_420) {
+			// 4:2:0 (2x2 1x1 1x1) - CrH 50% - CbH 50% - CrV 50% - CbV 50%
+			// the chrominance resolution in both the horizontal and vertical directions is cut in half
+			cinfo->comp_info[0].h_samp_factor = 2;	// Y
+			cinfo->comp_info[0].v_samp_factor = 2; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr
+			cinfo->comp_info[2].v_samp_factor = 1; 
+		} else if((flags & JPEG_SUBSAMPLING_422) == JPEG_SUBSAMPLING_422){ //2x1 (low) 
+			// 4:2:2 (2x1 1x1 1x1) - CrH 50% - CbH 50% - CrV 100% - CbV 100%
+			// half of the horizontal resolution in the chrominance is dropped (Cb & Cr), 
+			// while the full resolution is retained in the vertical direction, with respect to the luminance
+			cinfo->comp_info[0].h_samp_factor = 2;	// Y 
+			cinfo->comp_info[0].v_samp_factor = 1; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb 
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr 
+			cinfo->comp_info[2].v_samp_factor = 1; 
+		} 
+		else if((flags & JPEG_SUBSAMPLING_444) == JPEG_SUBSAMPLING_444){ //1x1 (no subsampling) 
+			// 4:4:4 (1x1 1x1 1x1) - CrH 100% - CbH 100% - CrV 100% - CbV 100%
+			// the resolution of chrominance information (Cb & Cr) is preserved 
+			// at the same rate as the luminance (Y) information
+			cinfo->comp_info[0].h_samp_factor = 1;	// Y 
+			cinfo->comp_info[0].v_samp_factor = 1; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb 
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr 
+			cinfo->comp_info[2].v_samp_factor = 1;  
+		} 
+	}
+
+	// set quality
+	// the first 7 bits are reserved for low level quality settings
+	// the other bits are high level (i.e. enum-ish)
+
+	int quality;
+
+	if ((flags & JPEG_QUALITYBAD) == JPEG_QUALITYBAD) {
+		quality = 10;
+	} else if ((flags & JPEG_QUALITYAVERAGE) == JPEG_QUALITYAVERAGE) {
+		quality = 25;
+	} else if ((flags & JPEG_QUALITYNORMAL) == JPEG_QUALITYNORMAL) {
+		quality = 50;
+	} else if ((flags & JPEG_QUALITYGOOD) == JPEG_QUALITYGOOD) {
+		quality = 75;
+	} else 	if ((flags & JPEG_QUALITYSUPERB) == JPEG_QUALITYSUPERB) {
+		quality = 100;
+	} else {
+		if ((flags & 0x7F) == 0) {
+			quality = 75;
+		} else {
+			quality = flags & 0x7F;
+		}
+	}
+
+	jpeg_set_quality(cinfo, quality, TRUE); /* limit to baseline-JPEG values */
+}
+
+/**
+Convert a dib scanline to the compressor layout and write it
+@param cinfo Started compressor
+@param color_type Color type of the dib
+@param palette Palette of the dib, used by palettized images only
+@param source Input scanline
+@param target Conversion buffer, 3 bytes per pixel
+*/
+static void
+jpeg_write_dib_scanline(j_compress_ptr cinfo, FREE_IMAGE_COLOR_TYPE color_type, const RGBQUAD *palette, BYTE *source, BYTE *target) {
+	if(color_type == FIC_RGB) {
+		// 24-bit RGB image : need to swap red and blue channels
+		memcpy(target, source, cinfo->image_width * 3);
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		// swap R and B channels
+		BYTE *target_p = target;
+		for(unsigned x = 0; x < cinfo->image_width; x++) {
+			INPLACESWAP(target_p[0], target_p[2]);
+			target_p += 3;
+		}
+#endif
+		// write the scanline
+		jpeg_write_scanlines(cinfo, &target, 1);
+	}
+	else if(color_type == FIC_MINISBLACK) {
+		// 8-bit standard greyscale images
+		jpeg_write_scanlines(cinfo, &source, 1);
+	}
+	else if(color_type == FIC_PALETTE) {
+		// 8-bit palettized images are converted to 24-bit images
+		FreeImage_ConvertLine8To24(target, source, cinfo->image_width, (RGBQUAD*)palette);
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		// swap R and B channels
+		BYTE *target_p = target;
+		for(unsigned x = 0; x < cinfo->image_width; x++) {
+			INPLACESWAP(target_p[0], target_p[2]);
+			target_p += 3;
+		}
+#endif
+
+		jpeg_write_scanlines(cinfo, &target, 1);
+	}
+	else if(color_type == FIC_MINISWHITE) {
+		// reverse 8-bit greyscale image, so reverse grey value on the fly
+		for(unsigned i = 0; i < cinfo->image_width; i++) {
+			target[i] = (BYTE)(255 - source[i]);
+		}
+		jpeg_write_scanlines(cinfo, &target, 1);
+	}
+}
+
+// ------------------------------------------------------------
+//   Restart interval stripes, decoded and encoded on the worker pool
+// ------------------------------------------------------------
+
+/// Minimum number of pixels of an image decoded or encoded in stripes
+static const unsigned JPEG_STRIPE_MIN_PIXELS = 256 * 1024;
+
+/**
+Receives control for a fatal error of a stripe decoder or encoder.
+Nothing is reported: the image is then processed again by a single 
+decoder or encoder, which reports the error.
+*/
+METHODDEF(void)
+jpeg_stripe_error_exit (j_common_ptr cinfo) {
+	freeimage_error_ptr error_ptr = (freeimage_error_ptr)cinfo->err;
+
+	longjmp(error_ptr->setjmp_buffer, 1);
+}
+
+/**
+Warnings of a stripe decoder or encoder are not reported (see jpeg_stripe_error_exit)
+*/
+METHODDEF(void)
+jpeg_stripe_output_message (j_common_ptr cinfo) {
+}
+
+/**
+Locate the frame header and the scan header of a JPEG stream held in memory
+@param data JPEG stream, starting with the SOI marker
+@param size Size of the stream
+@param sof Receives the offset of the SOFn marker
+@param sos_end Receives the offset of the entropy-coded data following the first SOS marker
+@return Returns FALSE if the markers could not be parsed
+*/
+static BOOL
+jpeg_find_scan(const BYTE *data, size_t size, size_t *sof, size_t *sos_end) {
+	if((size < 4) || (data[0] != 0xFF) || (data[1] != 0xD8)) {
+		return FALSE;
+	}
+
+	*sof = 0;
+	size_t pos = 2;
+
+	while(pos + 4 <= size) {
+		if(data[pos] != 0xFF) {
+			return FALSE;
+		}
+		const BYTE marker = data[pos + 1];
+		if(marker == 0xFF) {
+			// fill byte
+			pos++;
+			continue;
+		}
+		const size_t length = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+		if((length < 2) || (pos + 2 + length > size)) {
+			return FALSE;
+		}
+		if((marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC)) {
+			// SOFn (but not DHT, JPG or DAC)
+			if(length < 8) {
+				return FALSE;
+			}
+			*sof = pos;
+		} else if(marker == 0xDA) {
+			// SOS
+			*sos_end = pos + 2 + length;
+			return (*sof != 0);
+		}
+		pos += 2 + length;
+	}
+
+	return FALSE;
+}
+
+/**
+Split the entropy-coded data of a scan at its restart markers
+@param data JPEG stream
+@param size Size of the stream
+@param sos_end Offset of the entropy-coded data (see jpeg_find_scan)
+@param intervals Receives the [start, end) offsets of each restart interval, RSTn markers excluded
+@return Returns FALSE if the markers are out of sequence or if the scan is not followed by the EOI marker
+*/
+static BOOL
+jpeg_find_restarts(const BYTE *data, size_t size, size_t sos_end, std::vector< std::pair<size_t, size_t> > &intervals) {
+	size_t start = sos_end;
+	size_t pos = sos_end;
+
+	while(pos + 1 < size) {
+		if(data[pos] != 0xFF) {
+			pos++;
+			continue;
+		}
+		const BYTE marker = data[pos + 1];
+		if(marker == 0x00) {
+			// stuffed zero byte
+			pos += 2;
+		} else if(marker == 0xFF) {
+			// fill byte
+			pos++;
+		} else if((marker >= JPEG_RST0) && (marker <= JPEG_RST0 + 7)) {
+			if(marker != JPEG_RST0 + (intervals.size() & 7)) {
+				return FALSE;
+			}
+			intervals.push_back(std::make_pair(start, pos));
+			pos += 2;
+			start = pos;
+		} else {
+			// end of the scan
+			intervals.push_back(std::make_pair(start, pos));
+			return (marker == JPEG_EOI);
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+Renumber the RSTn markers of entropy-coded data
+@param data Entropy-coded data
+@param size Size of the data
+@param index Index of the first restart marker in the image
+*/
+static void
+jpeg_renumber_restarts(BYTE *data, size_t size, unsigned index) {
+	size_t pos = 0;
+
+	while(pos + 1 < size) {
+		if(data[pos] != 0xFF) {
+			pos++;
+			continue;
+		}
+		const BYTE marker = data[pos + 1];
+		if((marker >= JPEG_RST0) && (marker <= JPEG_RST0 + 7)) {
+			data[pos + 1] = (BYTE)(JPEG_RST0 + (index++ & 7));
+			pos += 2;
+		} else if(marker == 0x00) {
+			pos += 2;
+		} else {
+			pos++;
+		}
+	}
+}
+
+/**
+Decode a stripe of an image with a decompressor of its own
+@param main Started decompressor of the image, gives the decompression parameters
+@param flags Load flags
+@param stream Stripe stream: the image header with the stripe height, the restart intervals of the stripe and EOI
+@param size Size of the stripe stream
+@param dib Destination image
+@param first_row First row of the stripe, counted from the top of the image
+@param rows Number of rows of the stripe
+@return Returns TRUE if the stripe was decoded without errors nor warnings
+*/
+static BOOL
+jpeg_decode_stripe(j_decompress_ptr main, int flags, BYTE *stream, size_t size, FIBITMAP *dib, unsigned first_row, unsigned rows) {
+	struct jpeg_decompress_struct cinfo;
+	ErrorManager fi_error_mgr;
+
+	cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
+	fi_error_mgr.pub.error_exit     = jpeg_stripe_error_exit;
+	fi_error_mgr.pub.output_message = jpeg_stripe_output_message;
+
+	if (setjmp(fi_error_mgr.setjmp_buffer)) {
+		jpeg_destroy_decompress(&cinfo);
+		return FALSE;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, stream, (unsigned long)size);
+	jpeg_read_header(&cinfo, TRUE);
+
+	// same parameters as the image decompressor (see jpeg_start_decompress_dib)
+	cinfo.dct_method          = main->dct_method;
+	cinfo.do_fancy_upsampling = main->do_fancy_upsampling;
+	cinfo.out_color_space     = main->out_color_space;
+
+	jpeg_start_decompress(&cinfo);
+
+	BOOL bResult = (cinfo.output_width == main->output_width) && (cinfo.output_height == rows) && (cinfo.output_components == main->output_components);
+
+	if(bResult) {
+		JSAMPARRAY buffer = NULL;
+		if(cinfo.out_color_space == JCS_CMYK) {
+			buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+		}
+
+		const unsigned height = FreeImage_GetHeight(dib);
+		while (cinfo.output_scanline < cinfo.output_height) {
+			jpeg_read_dib_scanline(&cinfo, flags, buffer, FreeImage_GetScanLine(dib, height - first_row - cinfo.output_scanline - 1));
+		}
+
+		jpeg_finish_decompress(&cinfo);
+
+		// corrupt data is left to the image decompressor, so that the warnings are reported
+		bResult = (cinfo.err->num_warnings == 0);
+	}
+
+	jpeg_destroy_decompress(&cinfo);
+
+	return bResult;
+}
+
+/**
+Decode an image with restart markers in stripes of MCU rows, on the worker pool.<br>
+Each stripe starts with a restart interval: it is decoded by a decompressor of its own, 
+from a copy of the image header followed by the restart intervals of the stripe. 
+The stripes give exactly the pixels of a single decompressor. 
+The input stream is left at its current position.
+@param cinfo Started decompressor of the image, no scanline read yet
+@param io FreeImage IO
+@param handle FreeImage IO handle
+@param stream_start Position of the SOI marker in the input stream
+@param flags Load flags
+@param dib Destination image, allocated by jpeg_start_decompress_dib
+@return Returns TRUE if the image was decoded, returns FALSE if the scanlines 
+still have to be read with cinfo (single scan without restart markers, scaled decoding, 
+small image, single thread, corrupt data ...)
+*/
+static BOOL
+jpeg_read_dib_parallel(j_decompress_ptr cinfo, FreeImageIO *io, fi_handle handle, long stream_start, int flags, FIBITMAP *dib) {
+	if((cinfo->restart_interval == 0) || cinfo->progressive_mode || cinfo->arith_code || jpeg_has_multiple_scans(cinfo) || (cinfo->comps_in_scan != cinfo->num_components)) {
+		return FALSE;
+	}
+	if((cinfo->output_width != cinfo->image_width) || (cinfo->output_height != cinfo->image_height) || (cinfo->output_scanline != 0)) {
+		return FALSE;
+	}
+	if(((double)cinfo->output_width * cinfo->output_height < JPEG_STRIPE_MIN_PIXELS) || (ParallelGetThreadCount() < 2) || (stream_start < 0)) {
+		return FALSE;
+	}
+
+	// stripes are made of whole MCU rows and start with a restart interval
+
+	const unsigned mcu_height = cinfo->block_size * ((cinfo->comps_in_scan == 1) ? 1 : cinfo->max_v_samp_factor);
+	const unsigned mcus_per_row = cinfo->MCUs_per_row;
+	const unsigned mcu_rows = cinfo->MCU_rows_in_scan;
+	const unsigned interval = cinfo->restart_interval;
+
+	unsigned a = interval, b = mcus_per_row;
+	while(b != 0) {
+		const unsigned r = a % b;
+		a = b;
+		b = r;
+	}
+	// number of MCU rows between two possible starts of a stripe
+	const unsigned step = interval / a;
+	const unsigned steps = (mcu_rows + step - 1) / step;
+	const unsigned max_stripes = 2 * ParallelGetThreadCount();
+	const unsigned stripe_mcu_rows = step * ((steps + max_stripes - 1) / max_stripes);
+	const unsigned stripe_count = (mcu_rows + stripe_mcu_rows - 1) / stripe_mcu_rows;
+	if(stripe_count < 2) {
+		return FALSE;
+	}
+
+	// read the whole stream and restore the input position for cinfo
+
+	BYTE *data = NULL;
+	size_t size = 0;
+
+	const long position = io->tell_proc(handle);
+	if((position >= 0) && (io->seek_proc(handle, 0, SEEK_END) == 0)) {
+		const long end = io->tell_proc(handle);
+		if(end > stream_start) {
+			size = (size_t)(end - stream_start);
+			data = (BYTE*)malloc(size);
+			if(data && ((io->seek_proc(handle, stream_start, SEEK_SET) != 0) || (io->read_proc(data, 1, (unsigned)size, handle) != size))) {
+				free(data);
+				data = NULL;
+			}
+		}
+		io->seek_proc(handle, position, SEEK_SET);
+	}
+	if(!data) {
+		return FALSE;
+	}
+
+	size_t sof = 0, sos_end = 0;
+	std::vector< std::pair<size_t, size_t> > intervals;
+	const size_t interval_count = ((size_t)mcus_per_row * mcu_rows + interval - 1) / interval;
+
+	if(!jpeg_find_scan(data, size, &sof, &sos_end) || !jpeg_find_restarts(data, size, sos_end, intervals) || (intervals.size() != interval_count)) {
+		free(data);
+		return FALSE;
+	}
+
+	std::vector<BOOL> decoded(stripe_count, FALSE);
+
+	ParallelFor(0, stripe_count, 1, [&](unsigned first, unsigned last) {
+		for(unsigned s = first; s < last; s++) {
+			const unsigned first_mcu_row = s * stripe_mcu_rows;
+			const unsigned last_mcu_row = MIN(mcu_rows, first_mcu_row + stripe_mcu_rows);
+			const size_t first_interval = (size_t)first_mcu_row * mcus_per_row / interval;
+			const size_t last_interval = ((size_t)last_mcu_row * mcus_per_row + interval - 1) / interval;
+			const unsigned first_row = first_mcu_row * mcu_height;
+			const unsigned rows = MIN(cinfo->output_height, last_mcu_row * mcu_height) - first_row;
+
+			// image header with the stripe height, restart intervals renumbered from RST0, EOI
+			size_t length = sos_end + 2;
+			for(size_t i = first_interval; i < last_interval; i++) {
+				length += intervals[i].second - intervals[i].first + 2;
+			}
+			BYTE *stream = (BYTE*)malloc(length);
+			if(!stream) {
+				continue;
+			}
+			memcpy(stream, data, sos_end);
+			stream[sof + 5] = (BYTE)(rows >> 8);
+			stream[sof + 6] = (BYTE)(rows & 0xFF);
+			BYTE *p = stream + sos_end;
+			for(size_t i = first_interval; i < last_interval; i++) {
+				memcpy(p, data + intervals[i].first, intervals[i].second - intervals[i].first);
+				p += intervals[i].second - intervals[i].first;
+				if(i + 1 < last_interval) {
+					*p++ = 0xFF;
+					*p++ = (BYTE)(JPEG_RST0 + ((i - first_interval) & 7));
+				}
+			}
+			*p++ = 0xFF;
+			*p++ = JPEG_EOI;
+
+			decoded[s] = jpeg_decode_stripe(cinfo, flags, stream, p - stream, dib, first_row, rows);
+
+			free(stream);
+		}
+	});
+
+	free(data);
+
+	for(unsigned s = 0; s < stripe_count; s++) {
+		if(!decoded[s]) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+Encode a stripe of an image with a compressor of its own, into a memory stream
+@param dib Source image
+@param flags Save flags
+@param first_row First row of the stripe, counted from the top of the image
+@param rows Number of rows of the stripe
+@param hmem Destination stream
+@return Returns TRUE if the stripe was encoded
+*/
+static BOOL
+jpeg_encode_stripe(FIBITMAP *dib, int flags, unsigned first_row, unsigned rows, FIMEMORY *hmem) {
+	struct jpeg_compress_struct cinfo;
+	ErrorManager fi_error_mgr;
+	FreeImageIO io;
+	BYTE * volatile target = NULL;
+
+	SetMemoryIO(&io);
+
+	cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
+	fi_error_mgr.pub.error_exit     = jpeg_stripe_error_exit;
+	fi_error_mgr.pub.output_message = jpeg_stripe_output_message;
+
+	if (setjmp(fi_error_mgr.setjmp_buffer)) {
+		jpeg_destroy_compress(&cinfo);
+		free(target);
+		return FALSE;
+	}
+
+	jpeg_create_compress(&cinfo);
+	jpeg_freeimage_dst(&cinfo, (fi_handle)hmem, &io);
+	jpeg_set_dib_parameters(&cinfo, dib, flags);
+	cinfo.image_height = rows;
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	// the header of the first stripe is the header of the image
+	if ((first_row == 0) && ((flags & JPEG_BASELINE) != JPEG_BASELINE)) {
+		write_markers(&cinfo, dib);
+	}
+
+	target = (BYTE*)malloc(cinfo.image_width * 3);
+	if (target == NULL) {
+		jpeg_destroy_compress(&cinfo);
+		return FALSE;
+	}
+
+	const FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	while (cinfo.next_scanline < cinfo.image_height) {
+		BYTE *source = FreeImage_GetScanLine(dib, height - first_row - cinfo.next_scanline - 1);
+		jpeg_write_dib_scanline(&cinfo, color_type, FreeImage_GetPalette(dib), source, target);
+	}
+
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	free(target);
+
+	return TRUE;
+}
+
+/**
+Encode an image with restart markers in stripes of MCU rows, on the worker pool.<br>
+Each stripe is encoded by a compressor of its own, then the entropy-coded data of the 
+stripes are joined with renumbered restart markers. The stream is the same as the 
+stream of a single compressor. 
+@param cinfo Compressor of the image, with its parameters set by jpeg_set_dib_parameters
+@param dib Source image
+@param flags Save flags
+@param io FreeImage IO
+@param handle FreeImage IO handle
+@return Returns TRUE if the image was written, returns FALSE if it still has to be 
+written with cinfo (no restart markers, progressive or optimized coding, small image, 
+single thread ...). Write errors are reported through cinfo.
+*/
+static BOOL
+jpeg_write_dib_parallel(j_compress_ptr cinfo, FIBITMAP *dib, int flags, FreeImageIO *io, fi_handle handle) {
+	// the stripes must share their Huffman tables and be made of a single scan
+	if((cinfo->restart_in_rows <= 0) || cinfo->optimize_coding || cinfo->arith_code || (cinfo->scan_info != NULL)) {
+		return FALSE;
+	}
+	if(((double)cinfo->image_width * cinfo->image_height < JPEG_STRIPE_MIN_PIXELS) || (ParallelGetThreadCount() < 2)) {
+		return FALSE;
+	}
+
+	// stripes are made of whole restart intervals
+
+	int max_v_samp_factor = 1;
+	for(int ci = 0; ci < cinfo->num_components; ci++) {
+		max_v_samp_factor = MAX(max_v_samp_factor, cinfo->comp_info[ci].v_samp_factor);
+	}
+	const unsigned mcu_height = DCTSIZE * max_v_samp_factor;
+	const unsigned mcu_rows = (cinfo->image_height + mcu_height - 1) / mcu_height;
+	const unsigned step = (unsigned)cinfo->restart_in_rows;
+	const unsigned steps = (mcu_rows + step - 1) / step;
+	const unsigned max_stripes = 2 * ParallelGetThreadCount();
+	const unsigned stripe_mcu_rows = step * ((steps + max_stripes - 1) / max_stripes);
+	const unsigned stripe_count = (mcu_rows + stripe_mcu_rows - 1) / stripe_mcu_rows;
+	if(stripe_count < 2) {
+		return FALSE;
+	}
+
+	BOOL bWritten = TRUE;
+
+	{
+		std::vector<FIMEMORY*> streams(stripe_count, (FIMEMORY*)NULL);
+		std::vector<BOOL> encoded(stripe_count, FALSE);
+
+		ParallelFor(0, stripe_count, 1, [&](unsigned first, unsigned last) {
+			for(unsigned s = first; s < last; s++) {
+				const unsigned first_row = s * stripe_mcu_rows * mcu_height;
+				const unsigned rows = MIN(cinfo->image_height, first_row + stripe_mcu_rows * mcu_height) - first_row;
+				streams[s] = FreeImage_OpenMemory();
+				if(streams[s]) {
+					encoded[s] = jpeg_encode_stripe(dib, flags, first_row, rows, streams[s]);
+				}
+			}
+		});
+
+		// locate the entropy-coded data of each stripe
+
+		std::vector<BYTE*> data(stripe_count, (BYTE*)NULL);
+		std::vector<size_t> start(stripe_count, 0), end(stripe_count, 0);
+		size_t sof = 0;
+
+		BOOL bResult = TRUE;
+		for(unsigned s = 0; (s < stripe_count) && bResult; s++) {
+			DWORD size = 0;
+			size_t stripe_sof = 0;
+			bResult = encoded[s] && FreeImage_AcquireMemory(streams[s], &data[s], &size);
+			bResult = bResult && jpeg_find_scan(data[s], size, &stripe_sof, &start[s]) && (size >= start[s] + 2);
+			bResult = bResult && (data[s][size - 2] == 0xFF) && (data[s][size - 1] == JPEG_EOI);
+			if(bResult) {
+				end[s] = size - 2;
+				if(s == 0) {
+					sof = stripe_sof;
+				}
+			}
+		}
+
+		if(bResult) {
+			// header of the first stripe with the image height
+			data[0][sof + 5] = (BYTE)(cinfo->image_height >> 8);
+			data[0][sof + 6] = (BYTE)(cinfo->image_height & 0xFF);
+			bWritten = (io->write_proc(data[0], 1, (unsigned)start[0], handle) == start[0]);
+
+			for(unsigned s = 0; (s < stripe_count) && bWritten; s++) {
+				const unsigned first_interval = s * (stripe_mcu_rows / step);
+				if(s > 0) {
+					const BYTE marker[2] = { 0xFF, (BYTE)(JPEG_RST0 + ((first_interval - 1) & 7)) };
+					bWritten = (io->write_proc((void*)marker, 1, 2, handle) == 2);
+				}
+				jpeg_renumber_restarts(data[s] + start[s], end[s] - start[s], first_interval);
+				bWritten = bWritten && (io->write_proc(data[s] + start[s], 1, (unsigned)(end[s] - start[s]), handle) == end[s] - start[s]);
+			}
+			if(bWritten) {
+				const BYTE marker[2] = { 0xFF, JPEG_EOI };
+				bWritten = (io->write_proc((void*)marker, 1, 2, handle) == 2);
+			}
+		}
+
+		for(unsigned s = 0; s < stripe_count; s++) {
+			if(streams[s]) {
+				FreeImage_CloseMemory(streams[s]);
+			}
+		}
+
+		if(!bResult) {
+			return FALSE;
+		}
+	}
+
+	if(!bWritten) {
+		JPEG_EXIT((j_common_ptr)cinfo, JERR_FILE_WRITE);
+	}
+
+	return TRUE;
+}
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -1182,6 +2068,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// step 2a: specify data source (eg, a handle)
 
+			const long stream_start = io->tell_proc(handle);
+
 			jpeg_freeimage_src(&cinfo, handle, io);
 
 			// step 2b: save special markers for later reading
@@ -1195,89 +2083,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			jpeg_read_header(&cinfo, TRUE);
 
-			// step 4: set parameters for decompression
-
-			unsigned int scale_denom = 1;		// fraction by which to scale image
-			int	requested_size = flags >> 16;	// requested user size in pixels
-			if(requested_size > 0) {
-				// the JPEG codec can perform x2, x4 or x8 scaling on loading
-				// try to find the more appropriate scaling according to user's need
-				double scale = MAX((double)cinfo.image_width, (double)cinfo.image_height) / (double)requested_size;
-				if(scale >= 8) {
-					scale_denom = 8;
-				} else if(scale >= 4) {
-					scale_denom = 4;
-				} else if(scale >= 2) {
-					scale_denom = 2;
-				}
-			}
-			cinfo.scale_num = 1;
-			cinfo.scale_denom = scale_denom;
-
-			if ((flags & JPEG_ACCURATE) != JPEG_ACCURATE) {
-				cinfo.dct_method          = JDCT_IFAST;
-				cinfo.do_fancy_upsampling = FALSE;
-			}
-
-			if ((flags & JPEG_GREYSCALE) == JPEG_GREYSCALE) {
-				// force loading as a 8-bit greyscale image
-				cinfo.out_color_space = JCS_GRAYSCALE;
-			}
-
-			// step 5a: start decompressor and calculate output width and height
+			// steps 4 to 6: set parameters, start decompressor, allocate dib and read special markers
 
-			jpeg_start_decompress(&cinfo);
-
-			// step 5b: allocate dib and init header
-
-			if((cinfo.output_components == 4) && (cinfo.out_color_space == JCS_CMYK)) {
-				// CMYK image
-				if((flags & JPEG_CMYK) == JPEG_CMYK) {
-					// load as CMYK
-					dib = FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
-					FreeImage_GetICCProfile(dib)->flags |= FIICC_COLOR_IS_CMYK;
-				} else {
-					// load as CMYK and convert to RGB
-					dib = FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
-				}
-			} else {
-				// RGB or greyscale image
-				dib = FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 8 * cinfo.output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-				if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
-
-				if (cinfo.output_components == 1) {
-					// build a greyscale palette
-					RGBQUAD *colors = FreeImage_GetPalette(dib);
-
-					for (int i = 0; i < 256; i++) {
-						colors[i].rgbRed   = (BYTE)i;
-						colors[i].rgbGreen = (BYTE)i;
-						colors[i].rgbBlue  = (BYTE)i;
-					}
-				}
-			}
-			if(scale_denom != 1) {
-				// store original size info if a scaling was requested
-				store_size_info(dib, cinfo.image_width, cinfo.image_height);
-			}
-
-			// step 5c: handle metrices
-
-			if (cinfo.density_unit == 1) {
-				// dots/inch
-				FreeImage_SetDotsPerMeterX(dib, (unsigned) (((float)cinfo.X_density) / 0.0254000 + 0.5));
-				FreeImage_SetDotsPerMeterY(dib, (unsigned) (((float)cinfo.Y_density) / 0.0254000 + 0.5));
-			} else if (cinfo.density_unit == 2) {
-				// dots/cm
-				FreeImage_SetDotsPerMeterX(dib, (unsigned) (cinfo.X_density * 100));
-				FreeImage_SetDotsPerMeterY(dib, (unsigned) (cinfo.Y_density * 100));
-			}
-			
-			// step 6: read special markers
-			
-			read_markers(&cinfo, dib);
+			dib = jpeg_start_decompress_dib(&cinfo, flags, header_only);
 
 			// --- header only mode => clean-up and return
 
@@ -1288,83 +2096,29 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				return dib;
 			}
 
-			// step 7a: while (scan lines remain to be read) jpeg_read_scanlines(...);
-
-			if((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
-				// convert from CMYK to RGB
+			// step 7: while (scan lines remain to be read) jpeg_read_scanlines(...);
+			// images with restart markers are decoded in stripes on the worker pool when possible
 
-				JSAMPARRAY buffer;		// output row buffer
-				unsigned row_stride;	// physical row width in output buffer
+			const BOOL parallel = jpeg_read_dib_parallel(&cinfo, io, handle, stream_start, flags, dib);
 
-				// JSAMPLEs per row in output buffer
-				row_stride = cinfo.output_width * cinfo.output_components;
-				// make a one-row-high sample array that will go away when done with image
-				buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
+			if (!parallel) {
+				JSAMPARRAY buffer = NULL;	// output row buffer
 
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
-
-					jpeg_read_scanlines(&cinfo, buffer, 1);
-
-					for(unsigned x = 0; x < cinfo.output_width; x++) {
-						WORD K = (WORD)src[3];
-						dst[FI_RGBA_RED]   = (BYTE)((K * src[0]) / 255);	// C -> R
-						dst[FI_RGBA_GREEN] = (BYTE)((K * src[1]) / 255);	// M -> G
-						dst[FI_RGBA_BLUE]  = (BYTE)((K * src[2]) / 255);	// Y -> B
-						src += 4;
-						dst += 3;
-					}
+				if(cinfo.out_color_space == JCS_CMYK) {
+					// make a one-row-high sample array that will go away when done with image
+					buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
 				}
-			} else if((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) == JPEG_CMYK)) {
-				// convert from LibJPEG CMYK to standard CMYK
-
-				JSAMPARRAY buffer;		// output row buffer
-				unsigned row_stride;	// physical row width in output buffer
-
-				// JSAMPLEs per row in output buffer
-				row_stride = cinfo.output_width * cinfo.output_components;
-				// make a one-row-high sample array that will go away when done with image
-				buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
 
 				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
-
-					jpeg_read_scanlines(&cinfo, buffer, 1);
-
-					for(unsigned x = 0; x < cinfo.output_width; x++) {
-						// CMYK pixels are inverted
-						dst[0] = ~src[0];	// C
-						dst[1] = ~src[1];	// M
-						dst[2] = ~src[2];	// Y
-						dst[3] = ~src[3];	// K
-						src += 4;
-						dst += 4;
-					}
+					jpeg_read_dib_scanline(&cinfo, flags, buffer, FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1));
 				}
-
-			} else {
-				// normal case (RGB or greyscale image)
-
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
-
-					jpeg_read_scanlines(&cinfo, &dst, 1);
-				}
-
-				// step 7b: swap red and blue components (see LibJPEG/jmorecfg.h: #define RGB_RED, ...)
-				// The default behavior of the JPEG library is kept "as is" because LibTIFF uses 
-				// LibJPEG "as is".
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-				SwapRedBlue32(dib);
-#endif
 			}
 
-			// step 8: finish decompression
+			// step 8: finish decompression (the stripe decompressors have read the whole stream)
 
-			jpeg_finish_decompress(&cinfo);
+			if (!parallel) {
+				jpeg_finish_decompress(&cinfo);
+			}
 
 			// step 9: release JPEG decompression object
 
@@ -1401,22 +2155,12 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		try {
 			// Check dib format
 
-			const char *sError = "only 24-bit highcolor or 8-bit greyscale/palette bitmaps can be saved as JPEG";
-
-			FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
-			WORD bpp = (WORD)FreeImage_GetBPP(dib);
-
-			if ((bpp != 24) && (bpp != 8)) {
+			const char *sError = jpeg_check_dib(dib);
+			if (sError) {
 				throw sError;
 			}
 
-			if(bpp == 8) {
-				// allow grey, reverse grey and palette 
-				if ((color_type != FIC_MINISBLACK) && (color_type != FIC_MINISWHITE) && (color_type != FIC_PALETTE)) {
-					throw sError;
-				}
-			}
-
+			FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
 
 			struct jpeg_compress_struct cinfo;
 			ErrorManager fi_error_mgr;
@@ -1444,125 +2188,17 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 			jpeg_freeimage_dst(&cinfo, handle, io);
 
-			// Step 3: set parameters for compression 
-
-			cinfo.image_width = FreeImage_GetWidth(dib);
-			cinfo.image_height = FreeImage_GetHeight(dib);
-
-			switch(color_type) {
-				case FIC_MINISBLACK :
-				case FIC_MINISWHITE :
-					cinfo.in_color_space = JCS_GRAYSCALE;
-					cinfo.input_components = 1;
-					break;
-
-				default :
-					cinfo.in_color_space = JCS_RGB;
-					cinfo.input_components = 3;
-					break;
-			}
+			// Step 3 and 4: set parameters for compression and quality
 
-			jpeg_set_defaults(&cinfo);
+			jpeg_set_dib_parameters(&cinfo, dib, flags);
 
-		    // progressive-JPEG support
-			if((flags & JPEG_PROGRESSIVE) == JPEG_PROGRESSIVE) {
-				jpeg_simple_progression(&cinfo);
-			}
-			
-			// compute optimal Huffman coding tables for the image
-			if((flags & JPEG_OPTIMIZE) == JPEG_OPTIMIZE) {
-				cinfo.optimize_coding = TRUE;
-			}
+			// images with restart markers are encoded in stripes on the worker pool when possible
 
-			// Set JFIF density parameters from the DIB data
-
-			cinfo.X_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterX(dib));
-			cinfo.Y_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterY(dib));
-			cinfo.density_unit = 1;	// dots / inch
-
-			// thumbnail support (JFIF 1.02 extension markers)
-			if(FreeImage_GetThumbnail(dib) != NULL) {
-				cinfo.write_JFIF_header = 1; //<### force it, though when color is CMYK it will be incorrect
-				cinfo.JFIF_minor_version = 2;
-			}
-
-			// baseline JPEG support
-			if ((flags & JPEG_BASELINE) ==  JPEG_BASELINE) {
-				cinfo.write_JFIF_header = 0;	// No marker for non-JFIF colorspaces
-				cinfo.write_Adobe_marker = 0;	// write no Adobe marker by default				
-			}
-
-			// set subsampling options if required
-
-			if(cinfo.in_color_space == JCS_RGB) {
-				if((flags & JPEG_SUBSAMPLING_411) == JPEG_SUBSAMPLING_411) { 
-					// 4:1:1 (4x1 1x1 1x1) - CrH 25% - CbH 25% - CrV 100% - CbV 100%
-					// the horizontal color resolution is quartered
-					cinfo.comp_info[0].h_samp_factor = 4;	// Y 
-					cinfo.comp_info[0].v_samp_factor = 1; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb 
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr 
-					cinfo.comp_info[2].v_samp_factor = 1; 
-				} else if((flags & JPEG_SUBSAMPLING_420) == JPEG_SUBSAMPLING_420) {
-					// 4:2:0 (2x2 1x1 1x1) - CrH 50% - CbH 50% - CrV 50% - CbV 50%
-					// the chrominance resolution in both the horizontal and vertical directions is cut in half
-					cinfo.comp_info[0].h_samp_factor = 2;	// Y
-					cinfo.comp_info[0].v_samp_factor = 2; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr
-					cinfo.comp_info[2].v_samp_factor = 1; 
-				} else if((flags & JPEG_SUBSAMPLING_422) == JPEG_SUBSAMPLING_422){ //2x1 (low) 
-					// 4:2:2 (2x1 1x1 1x1) - CrH 50% - CbH 50% - CrV 100% - CbV 100%
-					// half of the horizontal resolution in the chrominance is dropped (Cb & Cr), 
-					// while the full resolution is retained in the vertical direction, with respect to the luminance
-					cinfo.comp_info[0].h_samp_factor = 2;	// Y 
-					cinfo.comp_info[0].v_samp_factor = 1; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb 
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr 
-					cinfo.comp_info[2].v_samp_factor = 1; 
-				} 
-				else if((flags & JPEG_SUBSAMPLING_444) == JPEG_SUBSAMPLING_444){ //1x1 (no subsampling) 
-					// 4:4:4 (1x1 1x1 1x1) - CrH 100% - CbH 100% - CrV 100% - CbV 100%
-					// the resolution of chrominance information (Cb & Cr) is preserved 
-					// at the same rate as the luminance (Y) information
-					cinfo.comp_info[0].h_samp_factor = 1;	// Y 
-					cinfo.comp_info[0].v_samp_factor = 1; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb 
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr 
-					cinfo.comp_info[2].v_samp_factor = 1;  
-				} 
-			}
-
-			// Step 4: set quality
-			// the first 7 bits are reserved for low level quality settings
-			// the other bits are high level (i.e. enum-ish)
-
-			int quality;
-
-			if ((flags & JPEG_QUALITYBAD) == JPEG_QUALITYBAD) {
-				quality = 10;
-			} else if ((flags & JPEG_QUALITYAVERAGE) == JPEG_QUALITYAVERAGE) {
-				quality = 25;
-			} else if ((flags & JPEG_QUALITYNORMAL) == JPEG_QUALITYNORMAL) {
-				quality = 50;
-			} else if ((flags & JPEG_QUALITYGOOD) == JPEG_QUALITYGOOD) {
-				quality = 75;
-			} else 	if ((flags & JPEG_QUALITYSUPERB) == JPEG_QUALITYSUPERB) {
-				quality = 100;
-			} else {
-				if ((flags & 0x7F) == 0) {
-					quality = 75;
-				} else {
-					quality = flags & 0x7F;
-				}
+			if (jpeg_write_dib_parallel(&cinfo, dib, flags, io, handle)) {
+				jpeg_destroy_compress(&cinfo);
+				return TRUE;
 			}
 
-			jpeg_set_quality(&cinfo, quality, TRUE); /* limit to baseline-JPEG values */
-
 			// Step 5: Start compressor 
 
 			jpeg_start_compress(&cinfo, TRUE);
@@ -1575,41 +2211,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 			// Step 7: while (scan lines remain to be written) 
 
-			if(color_type == FIC_RGB) {
-				// 24-bit RGB image : need to swap red and blue channels
-				unsigned pitch = FreeImage_GetPitch(dib);
-				BYTE *target = (BYTE*)malloc(pitch * sizeof(BYTE));
-				if (target == NULL) {
-					throw FI_MSG_ERROR_MEMORY;
-				}
-
-				while (cinfo.next_scanline < cinfo.image_height) {
-					// get a copy of the scanline
-					memcpy(target, FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1), pitch);
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-					// swap R and B channels
-					BYTE *target_p = target;
-					for(unsigned x = 0; x < cinfo.image_width; x++) {
-						INPLACESWAP(target_p[0], target_p[2]);
-						target_p += 3;
-					}
-#endif
-					// write the scanline
-					jpeg_write_scanlines(&cinfo, &target, 1);
-				}
-				free(target);
-			}
-			else if(color_type == FIC_MINISBLACK) {
-				// 8-bit standard greyscale images
-				while (cinfo.next_scanline < cinfo.image_height) {
-					JSAMPROW b = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1);
-
-					jpeg_write_scanlines(&cinfo, &b, 1);
-				}
-			}
-			else if(color_type == FIC_PALETTE) {
-				// 8-bit palettized images are converted to 24-bit images
-				RGBQUAD *palette = FreeImage_GetPalette(dib);
+			{
 				BYTE *target = (BYTE*)malloc(cinfo.image_width * 3);
 				if (target == NULL) {
 					throw FI_MSG_ERROR_MEMORY;
@@ -1617,42 +2219,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 				while (cinfo.next_scanline < cinfo.image_height) {
 					BYTE *source = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1);
-					FreeImage_ConvertLine8To24(target, source, cinfo.image_width, palette);
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-					// swap R and B channels
-					BYTE *target_p = target;
-					for(unsigned x = 0; x < cinfo.image_width; x++) {
-						INPLACESWAP(target_p[0], target_p[2]);
-						target_p += 3;
-					}
-#endif
-
-
-					jpeg_write_scanlines(&cinfo, &target, 1);
-				}
-
-				free(target);
-			}
-			else if(color_type == FIC_MINISWHITE) {
-				// reverse 8-bit greyscale image, so reverse grey value on the fly
-				unsigned i;
-				BYTE reverse[256];
-				BYTE *target = (BYTE *)malloc(cinfo.image_width);
-				if (target == NULL) {
-					throw FI_MSG_ERROR_MEMORY;
-				}
-
-				for(i = 0; i < 256; i++) {
-					reverse[i] = (BYTE)(255 - i);
-				}
-
-				while(cinfo.next_scanline < cinfo.image_height) {
-					BYTE *source = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1);
-					for(i = 0; i < cinfo.image_width; i++) {
-						target[i] = reverse[ source[i] ];
-					}
-					jpeg_write_scanlines(&cinfo, &target, 1);
+					jpeg_write_dib_scanline(&cinfo, color_type, FreeImage_GetPalette(dib), source, target);
 				}
 
 				free(target);
@@ -1679,6 +2246,295 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return FALSE;
 }
 
+// ==========================================================
+//   Scanline streams
+// ==========================================================
+
+/**
+State of a scanline reader.<br>
+Every entry point establishes its own setjmp context before calling LibJPEG. 
+On error, jpeg_error_exit has already destroyed the decompressor.
+*/
+typedef struct tagScanlineReader {
+	struct jpeg_decompress_struct cinfo;
+	ErrorManager fi_error_mgr;
+	/// one-row sample array (CMYK images only)
+	JSAMPARRAY buffer;
+	/// header dib, owned by the reader until it is returned to the caller
+	FIBITMAP *dib;
+	int flags;
+	/// TRUE once LibJPEG signaled an error
+	BOOL failed;
+} ScanlineReader;
+
+/**
+State of a scanline writer (see ScanlineReader)
+*/
+typedef struct tagScanlineWriter {
+	struct jpeg_compress_struct cinfo;
+	ErrorManager fi_error_mgr;
+	FREE_IMAGE_COLOR_TYPE color_type;
+	RGBQUAD palette[256];
+	/// conversion buffer, 3 bytes per pixel
+	BYTE *target;
+	/// TRUE once LibJPEG signaled an error
+	BOOL failed;
+} ScanlineWriter;
+
+/**
+Read the file header and start the decompressor, throws an error message on failure
+*/
+static void
+jpeg_start_scanline_reader(ScanlineReader *reader, FreeImageIO *io, fi_handle handle) {
+	j_decompress_ptr cinfo = &reader->cinfo;
+	const int flags = reader->flags;
+
+	cinfo->err = jpeg_std_error(&reader->fi_error_mgr.pub);
+	reader->fi_error_mgr.pub.error_exit     = jpeg_error_exit;
+	reader->fi_error_mgr.pub.output_message = jpeg_output_message;
+
+	if (setjmp(reader->fi_error_mgr.setjmp_buffer)) {
+		jpeg_destroy_decompress(cinfo);
+		throw (const char*)NULL;
+	}
+
+	jpeg_create_decompress(cinfo);
+	jpeg_freeimage_src(cinfo, handle, io);
+
+	jpeg_save_markers(cinfo, JPEG_COM, 0xFFFF);
+	for(int m = 0; m < 16; m++) {
+		jpeg_save_markers(cinfo, JPEG_APP0 + m, 0xFFFF);
+	}
+
+	jpeg_read_header(cinfo, TRUE);
+
+	reader->dib = jpeg_start_decompress_dib(cinfo, flags, TRUE);
+
+	if ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE) {
+		// a rotation needs the whole image: let the caller load it
+		FITAG *tag = NULL;
+		FreeImage_GetMetadata(FIMD_EXIF_MAIN, reader->dib, "Orientation", &tag);
+		if (tag && (FreeImage_GetTagID(tag) == TAG_ORIENTATION) && (*((WORD *)FreeImage_GetTagValue(tag)) != 1)) {
+			throw (const char*)NULL;
+		}
+	}
+
+	if(cinfo->out_color_space == JCS_CMYK) {
+		reader->buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr)cinfo, JPOOL_IMAGE, cinfo->output_width * cinfo->output_components, 1);
+	}
+}
+
+static void * DLL_CALLCONV
+OpenScanlineReader(FreeImageIO *io, fi_handle handle, int flags, FIBITMAP **info) {
+	ScanlineReader *reader = (ScanlineReader*)malloc(sizeof(ScanlineReader));
+	if (!reader) {
+		return NULL;
+	}
+	memset(reader, 0, sizeof(ScanlineReader));
+	reader->flags = flags;
+
+	try {
+		jpeg_start_scanline_reader(reader, io, handle);
+
+		*info = reader->dib;
+		reader->dib = NULL;
+
+		return reader;
+
+	} catch (const char *text) {
+		jpeg_destroy_decompress(&reader->cinfo);
+		if (reader->dib) {
+			FreeImage_Unload(reader->dib);
+		}
+		free(reader);
+		if (text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+Decode up to 'count' rows, without a setjmp context of its own
+*/
+static unsigned
+jpeg_read_dib_scanlines(ScanlineReader *reader, BYTE *bits, unsigned pitch, unsigned count) {
+	j_decompress_ptr cinfo = &reader->cinfo;
+
+	unsigned lines = 0;
+
+	while ((lines < count) && (cinfo->output_scanline < cinfo->output_height)) {
+		jpeg_read_dib_scanline(cinfo, reader->flags, reader->buffer, bits + lines * pitch);
+		lines++;
+	}
+
+	return lines;
+}
+
+static unsigned DLL_CALLCONV
+ReadScanlines(void *data, BYTE *bits, unsigned pitch, unsigned count) {
+	ScanlineReader *reader = (ScanlineReader*)data;
+
+	if (reader->failed) {
+		return 0;
+	}
+	if (setjmp(reader->fi_error_mgr.setjmp_buffer)) {
+		reader->failed = TRUE;
+		return 0;
+	}
+
+	return jpeg_read_dib_scanlines(reader, bits, pitch, count);
+}
+
+static void DLL_CALLCONV
+CloseScanlineReader(void *data) {
+	ScanlineReader *reader = (ScanlineReader*)data;
+
+	// the remaining data is not needed, no need to call jpeg_finish_decompress
+	jpeg_destroy_decompress(&reader->cinfo);
+	free(reader);
+}
+
+static void * DLL_CALLCONV
+OpenScanlineWriter(FreeImageIO *io, fi_handle handle, FIBITMAP *info, int flags) {
+	const char *sError = jpeg_check_dib(info);
+	if (sError) {
+		FreeImage_OutputMessageProc(s_format_id, sError);
+		return NULL;
+	}
+
+	ScanlineWriter *writer = (ScanlineWriter*)malloc(sizeof(ScanlineWriter));
+	if (!writer) {
+		return NULL;
+	}
+	memset(writer, 0, sizeof(ScanlineWriter));
+
+	writer->color_type = FreeImage_GetColorType(info);
+	if (FreeImage_GetPalette(info)) {
+		memcpy(writer->palette, FreeImage_GetPalette(info), FreeImage_GetColorsUsed(info) * sizeof(RGBQUAD));
+	}
+
+	try {
+		j_compress_ptr cinfo = &writer->cinfo;
+
+		cinfo->err = jpeg_std_error(&writer->fi_error_mgr.pub);
+		writer->fi_error_mgr.pub.error_exit     = jpeg_error_exit;
+		writer->fi_error_mgr.pub.output_message = jpeg_output_message;
+
+		if (setjmp(writer->fi_error_mgr.setjmp_buffer)) {
+			jpeg_destroy_compress(cinfo);
+			throw (const char*)NULL;
+		}
+
+		jpeg_create_compress(cinfo);
+		jpeg_freeimage_dst(cinfo, handle, io);
+
+		jpeg_set_dib_parameters(cinfo, info, flags);
+
+		writer->target = (BYTE*)malloc(cinfo->image_width * 3);
+		if (!writer->target) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
+		jpeg_start_compress(cinfo, TRUE);
+
+		if ((flags & JPEG_BASELINE) !=  JPEG_BASELINE) {
+			write_markers(cinfo, info);
+		}
+
+		return writer;
+
+	} catch (const char *text) {
+		jpeg_destroy_compress(&writer->cinfo);
+		free(writer->target);
+		free(writer);
+		if (text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+	}
+
+	return NULL;
+}
+
+static BOOL DLL_CALLCONV
+WriteScanlines(void *data, BYTE *bits, unsigned pitch, unsigned count) {
+	ScanlineWriter *writer = (ScanlineWriter*)data;
+	j_compress_ptr cinfo = &writer->cinfo;
+
+	if (writer->failed) {
+		return FALSE;
+	}
+	if (setjmp(writer->fi_error_mgr.setjmp_buffer)) {
+		writer->failed = TRUE;
+		return FALSE;
+	}
+
+	for (unsigned y = 0; y < count; y++) {
+		jpeg_write_dib_scanline(cinfo, writer->color_type, writer->palette, bits + y * pitch, writer->target);
+	}
+
+	return TRUE;
+}
+
+/**
+Flush the compressor, returns FALSE if LibJPEG signaled an error
+*/
+static BOOL
+jpeg_finish_scanline_writer(ScanlineWriter *writer) {
+	if (setjmp(writer->fi_error_mgr.setjmp_buffer)) {
+		return FALSE;
+	}
+	jpeg_finish_compress(&writer->cinfo);
+	return TRUE;
+}
+
+static BOOL DLL_CALLCONV
+CloseScanlineWriter(void *data) {
+	ScanlineWriter *writer = (ScanlineWriter*)data;
+	j_compress_ptr cinfo = &writer->cinfo;
+
+	BOOL success = !writer->failed && (cinfo->next_scanline == cinfo->image_height);
+
+	if (success) {
+		success = jpeg_finish_scanline_writer(writer);
+	}
+
+	jpeg_destroy_compress(cinfo);
+	free(writer->target);
+	free(writer);
+
+	return success;
+}
+
+// ==========================================================
+//   SIMD decoding
+// ==========================================================
+
+/**
+Select the inner loops used by the JPEG decoder. 
+When SSE2 is available, the 8x8 integer IDCTs, the YCbCr to RGB conversion 
+and the merged upsampling use SIMD routines (the default). Both versions 
+give exactly the same pixels, the C version is kept for comparison. 
+The setting is global and not synchronized: change it only while no JPEG image 
+is being loaded or saved by another thread. It is read when a decoding pass starts.
+@param enable TRUE to use the SIMD routines, FALSE to use the C routines
+*/
+void DLL_CALLCONV
+FreeImage_SetJPEGSIMD(BOOL enable) {
+	jsimd_set_enabled(enable ? 1 : 0);
+}
+
+/**
+Returns TRUE when the JPEG decoder uses the SIMD routines, 
+FALSE when they are disabled or were not compiled in
+@see FreeImage_SetJPEGSIMD
+*/
+BOOL DLL_CALLCONV
+FreeImage_GetJPEGSIMD() {
+	return jsimd_is_enabled() ? TRUE : FALSE;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -1703,4 +2559,10 @@ InitJPEG(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->open_scanline_reader_proc = OpenScanlineReader;
+	plugin->read_scanlines_proc = ReadScanlines;
+	plugin->close_scanline_reader_proc = CloseScanlineReader;
+	plugin->open_scanline_writer_proc = OpenScanlineWriter;
+	plugin->write_scanlines_proc = WriteScanlines;
+	plugin->close_scanline_writer_proc = CloseScanlineWriter;
 }
@@ -30,6 +30,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include "ThreadPool.h"
 #include "../Metadata/FreeImageTag.h"
 
 // ----------------------------------------------------------
@@ -42,6 +43,7 @@
 
 #include "../ZLib/zlib.h"
 #include "../LibPNG/png.h"
+#include "../FastDeflate/fastdeflate.h"
 
 // ----------------------------------------------------------
 
@@ -500,222 +502,244 @@ ConfigureDecoder(png_structp png_ptr, png_infop info_ptr, int flags, FREE_IMAGE_
 	return TRUE;
 }
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	png_structp png_ptr = NULL;
-	png_infop info_ptr = NULL;
+/**
+Read the file header and create the dib with its header data (palette, transparency, background, resolution, ICC profile)
+@param png_ptr PNG handle, positioned after the signature
+@param info_ptr PNG info handle
+@param flags Load flags
+@param header_only If TRUE, do not allocate the pixels
+@return Returns the dib, throws an error message on failure
+*/
+static FIBITMAP*
+ReadHeader(png_structp png_ptr, png_infop info_ptr, int flags, BOOL header_only) {
 	png_uint_32 width, height;
 	int color_type;
 	int bit_depth;
 	int pixel_depth = 0;	// pixel_depth = bit_depth * channels
 
 	FIBITMAP *dib = NULL;
-	png_bytepp row_pointers = NULL;
 
-    fi_ioStructure fio;
-    fio.s_handle = handle;
-	fio.s_io = io;
-    
-	if (handle) {
-		BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+	// read the IHDR chunk
 
-		try {		
-			// check to see if the file is in fact a PNG file
+	png_read_info(png_ptr, info_ptr);
+	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, NULL, NULL, NULL);
 
-			BYTE png_check[PNG_BYTES_TO_CHECK];
+	// configure the decoder
 
-			io->read_proc(png_check, PNG_BYTES_TO_CHECK, 1, handle);
+	FREE_IMAGE_TYPE image_type = FIT_BITMAP;
 
-			if (png_sig_cmp(png_check, (png_size_t)0, PNG_BYTES_TO_CHECK) != 0) {
-				return NULL;	// Bad signature
-			}
-			
-			// create the chunk manage structure
+	if(!ConfigureDecoder(png_ptr, info_ptr, flags, &image_type)) {
+		throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+	}
 
-			png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, error_handler, warning_handler);
+	// update image info
 
-			if (!png_ptr) {
-				return NULL;			
-			}
+	color_type = png_get_color_type(png_ptr, info_ptr);
+	bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+	pixel_depth = bit_depth * png_get_channels(png_ptr, info_ptr);
 
-			// create the info structure
+	// create a dib and write the bitmap header
+	// set up the dib palette, if needed
 
-		    info_ptr = png_create_info_struct(png_ptr);
+	switch (color_type) {
+		case PNG_COLOR_TYPE_RGB:
+		case PNG_COLOR_TYPE_RGB_ALPHA:
+			dib = FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+			break;
 
-			if (!info_ptr) {
-				png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
-				return NULL;
-			}
+		case PNG_COLOR_TYPE_PALETTE:
+			dib = FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+			if(dib) {
+				png_colorp png_palette = NULL;
+				int palette_entries = 0;
 
-			// init the IO
+				png_get_PLTE(png_ptr,info_ptr, &png_palette, &palette_entries);
 
-			png_set_read_fn(png_ptr, &fio, _ReadProc);
+				palette_entries = MIN((unsigned)palette_entries, FreeImage_GetColorsUsed(dib));
 
-            if (setjmp(png_jmpbuf(png_ptr))) {
-				png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-				return NULL;
-			}
+				// store the palette
 
-			// because we have already read the signature...
+				RGBQUAD *palette = FreeImage_GetPalette(dib);
+				for(int i = 0; i < palette_entries; i++) {
+					palette[i].rgbRed   = png_palette[i].red;
+					palette[i].rgbGreen = png_palette[i].green;
+					palette[i].rgbBlue  = png_palette[i].blue;
+				}
+			}
+			break;
 
-			png_set_sig_bytes(png_ptr, PNG_BYTES_TO_CHECK);
+		case PNG_COLOR_TYPE_GRAY:
+			dib = FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 
-			// read the IHDR chunk
+			if(dib && (pixel_depth <= 8)) {
+				RGBQUAD *palette = FreeImage_GetPalette(dib);
+				const int palette_entries = 1 << pixel_depth;
 
-			png_read_info(png_ptr, info_ptr);
-			png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, NULL, NULL, NULL);
+				for(int i = 0; i < palette_entries; i++) {
+					palette[i].rgbRed   =
+					palette[i].rgbGreen =
+					palette[i].rgbBlue  = (BYTE)((i * 255) / (palette_entries - 1));
+				}
+			}
+			break;
 
-			// configure the decoder
+		default:
+			throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+	}
 
-			FREE_IMAGE_TYPE image_type = FIT_BITMAP;
+	if(!dib) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
 
-			if(!ConfigureDecoder(png_ptr, info_ptr, flags, &image_type)) {
-				throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+	// store the transparency table
+
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+		// array of alpha (transparency) entries for palette
+		png_bytep trans_alpha = NULL;
+		// number of transparent entries
+		int num_trans = 0;						
+		// graylevel or color sample values of the single transparent color for non-paletted images
+		png_color_16p trans_color = NULL;
+
+		png_get_tRNS(png_ptr, info_ptr, &trans_alpha, &num_trans, &trans_color);
+
+		if((color_type == PNG_COLOR_TYPE_GRAY) && trans_color) {
+			// single transparent color
+			if (trans_color->gray < 256) { 
+				BYTE table[256]; 
+				memset(table, 0xFF, 256); 
+				table[trans_color->gray] = 0; 
+				FreeImage_SetTransparencyTable(dib, table, 256); 
+			}
+			// check for a full transparency table, too
+			else if ((trans_alpha) && (pixel_depth <= 8)) {
+				FreeImage_SetTransparencyTable(dib, (BYTE *)trans_alpha, num_trans);
 			}
 
-			// update image info
+		} else if((color_type == PNG_COLOR_TYPE_PALETTE) && trans_alpha) {
+			// transparency table
+			FreeImage_SetTransparencyTable(dib, (BYTE *)trans_alpha, num_trans);
+		}
+	}
 
-			color_type = png_get_color_type(png_ptr, info_ptr);
-			bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-			pixel_depth = bit_depth * png_get_channels(png_ptr, info_ptr);
+	// store the background color (only supported for FIT_BITMAP types)
 
-			// create a dib and write the bitmap header
-			// set up the dib palette, if needed
+	if ((image_type == FIT_BITMAP) && png_get_valid(png_ptr, info_ptr, PNG_INFO_bKGD)) {
+		// Get the background color to draw transparent and alpha images over.
+		// Note that even if the PNG file supplies a background, you are not required to
+		// use it - you should use the (solid) application background if it has one.
 
-			switch (color_type) {
-				case PNG_COLOR_TYPE_RGB:
-				case PNG_COLOR_TYPE_RGB_ALPHA:
-					dib = FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					break;
+		png_color_16p image_background = NULL;
+		RGBQUAD rgbBkColor;
 
-				case PNG_COLOR_TYPE_PALETTE:
-					dib = FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					if(dib) {
-						png_colorp png_palette = NULL;
-						int palette_entries = 0;
+		if (png_get_bKGD(png_ptr, info_ptr, &image_background)) {
+			rgbBkColor.rgbRed      = (BYTE)image_background->red;
+			rgbBkColor.rgbGreen    = (BYTE)image_background->green;
+			rgbBkColor.rgbBlue     = (BYTE)image_background->blue;
+			rgbBkColor.rgbReserved = 0;
 
-						png_get_PLTE(png_ptr,info_ptr, &png_palette, &palette_entries);
+			FreeImage_SetBackgroundColor(dib, &rgbBkColor);
+		}
+	}
 
-						palette_entries = MIN((unsigned)palette_entries, FreeImage_GetColorsUsed(dib));
+	// get physical resolution
 
-						// store the palette
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_pHYs)) {
+		png_uint_32 res_x, res_y;
+		
+		// we'll overload this var and use 0 to mean no phys data,
+		// since if it's not in meters we can't use it anyway
 
-						RGBQUAD *palette = FreeImage_GetPalette(dib);
-						for(int i = 0; i < palette_entries; i++) {
-							palette[i].rgbRed   = png_palette[i].red;
-							palette[i].rgbGreen = png_palette[i].green;
-							palette[i].rgbBlue  = png_palette[i].blue;
-						}
-					}
-					break;
+		int res_unit_type = PNG_RESOLUTION_UNKNOWN;
 
-				case PNG_COLOR_TYPE_GRAY:
-					dib = FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+		png_get_pHYs(png_ptr,info_ptr, &res_x, &res_y, &res_unit_type);
 
-					if(dib && (pixel_depth <= 8)) {
-						RGBQUAD *palette = FreeImage_GetPalette(dib);
-						const int palette_entries = 1 << pixel_depth;
+		if (res_unit_type == PNG_RESOLUTION_METER) {
+			FreeImage_SetDotsPerMeterX(dib, res_x);
+			FreeImage_SetDotsPerMeterY(dib, res_y);
+		}
+	}
 
-						for(int i = 0; i < palette_entries; i++) {
-							palette[i].rgbRed   =
-							palette[i].rgbGreen =
-							palette[i].rgbBlue  = (BYTE)((i * 255) / (palette_entries - 1));
-						}
-					}
-					break;
+	// get possible ICC profile
 
-				default:
-					throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
-			}
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_iCCP)) {
+		png_charp profile_name = NULL;
+		png_bytep profile_data = NULL;
+		png_uint_32 profile_length = 0;
+		int  compression_type;
 
-			if(!dib) {
-				throw FI_MSG_ERROR_DIB_MEMORY;
-			}
+		png_get_iCCP(png_ptr, info_ptr, &profile_name, &compression_type, &profile_data, &profile_length);
 
-			// store the transparency table
-
-			if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
-				// array of alpha (transparency) entries for palette
-				png_bytep trans_alpha = NULL;
-				// number of transparent entries
-				int num_trans = 0;						
-				// graylevel or color sample values of the single transparent color for non-paletted images
-				png_color_16p trans_color = NULL;
-
-				png_get_tRNS(png_ptr, info_ptr, &trans_alpha, &num_trans, &trans_color);
-
-				if((color_type == PNG_COLOR_TYPE_GRAY) && trans_color) {
-					// single transparent color
-					if (trans_color->gray < 256) { 
-						BYTE table[256]; 
-						memset(table, 0xFF, 256); 
-						table[trans_color->gray] = 0; 
-						FreeImage_SetTransparencyTable(dib, table, 256); 
-					}
-					// check for a full transparency table, too
-					else if ((trans_alpha) && (pixel_depth <= 8)) {
-						FreeImage_SetTransparencyTable(dib, (BYTE *)trans_alpha, num_trans);
-					}
+		// copy ICC profile data (must be done after FreeImage_AllocateHeader)
 
-				} else if((color_type == PNG_COLOR_TYPE_PALETTE) && trans_alpha) {
-					// transparency table
-					FreeImage_SetTransparencyTable(dib, (BYTE *)trans_alpha, num_trans);
-				}
-			}
+		FreeImage_CreateICCProfile(dib, profile_data, profile_length);
+	}
 
-			// store the background color (only supported for FIT_BITMAP types)
+	return dib;
+}
 
-			if ((image_type == FIT_BITMAP) && png_get_valid(png_ptr, info_ptr, PNG_INFO_bKGD)) {
-				// Get the background color to draw transparent and alpha images over.
-				// Note that even if the PNG file supplies a background, you are not required to
-				// use it - you should use the (solid) application background if it has one.
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	png_structp png_ptr = NULL;
+	png_infop info_ptr = NULL;
+	png_uint_32 height;
 
-				png_color_16p image_background = NULL;
-				RGBQUAD rgbBkColor;
+	// both are used by the exception handler, after setjmp
+	FIBITMAP * volatile dib = NULL;
+	png_bytepp volatile row_pointers = NULL;
 
-				if (png_get_bKGD(png_ptr, info_ptr, &image_background)) {
-					rgbBkColor.rgbRed      = (BYTE)image_background->red;
-					rgbBkColor.rgbGreen    = (BYTE)image_background->green;
-					rgbBkColor.rgbBlue     = (BYTE)image_background->blue;
-					rgbBkColor.rgbReserved = 0;
+    fi_ioStructure fio;
+    fio.s_handle = handle;
+	fio.s_io = io;
+    
+	if (handle) {
+		BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
-					FreeImage_SetBackgroundColor(dib, &rgbBkColor);
-				}
-			}
+		try {		
+			// check to see if the file is in fact a PNG file
 
-			// get physical resolution
+			BYTE png_check[PNG_BYTES_TO_CHECK];
 
-			if (png_get_valid(png_ptr, info_ptr, PNG_INFO_pHYs)) {
-				png_uint_32 res_x, res_y;
-				
-				// we'll overload this var and use 0 to mean no phys data,
-				// since if it's not in meters we can't use it anyway
+			io->read_proc(png_check, PNG_BYTES_TO_CHECK, 1, handle);
 
-				int res_unit_type = PNG_RESOLUTION_UNKNOWN;
+			if (png_sig_cmp(png_check, (png_size_t)0, PNG_BYTES_TO_CHECK) != 0) {
+				return NULL;	// Bad signature
+			}
+			
+			// create the chunk manage structure
 
-				png_get_pHYs(png_ptr,info_ptr, &res_x, &res_y, &res_unit_type);
+			png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, error_handler, warning_handler);
 
-				if (res_unit_type == PNG_RESOLUTION_METER) {
-					FreeImage_SetDotsPerMeterX(dib, res_x);
-					FreeImage_SetDotsPerMeterY(dib, res_y);
-				}
+			if (!png_ptr) {
+				return NULL;			
 			}
 
-			// get possible ICC profile
+			// create the info structure
 
-			if (png_get_valid(png_ptr, info_ptr, PNG_INFO_iCCP)) {
-				png_charp profile_name = NULL;
-				png_bytep profile_data = NULL;
-				png_uint_32 profile_length = 0;
-				int  compression_type;
+		    info_ptr = png_create_info_struct(png_ptr);
 
-				png_get_iCCP(png_ptr, info_ptr, &profile_name, &compression_type, &profile_data, &profile_length);
+			if (!info_ptr) {
+				png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
+				return NULL;
+			}
 
-				// copy ICC profile data (must be done after FreeImage_AllocateHeader)
+			// init the IO
+
+			png_set_read_fn(png_ptr, &fio, _ReadProc);
 
-				FreeImage_CreateICCProfile(dib, profile_data, profile_length);
+            if (setjmp(png_jmpbuf(png_ptr))) {
+				png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+				return NULL;
 			}
 
+			// because we have already read the signature...
+
+			png_set_sig_bytes(png_ptr, PNG_BYTES_TO_CHECK);
+
+			// read the file header and create the dib
+
+			dib = ReadHeader(png_ptr, info_ptr, flags, header_only);
+
 			// --- header only mode => clean-up and return
 
 			if (header_only) {
@@ -730,6 +754,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// set the individual row_pointers to point at the correct offsets
 
+			height = png_get_image_height(png_ptr, info_ptr);
 			row_pointers = (png_bytepp)malloc(height * sizeof(png_bytep));
 
 			if (!row_pointers) {
@@ -801,248 +826,657 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 // --------------------------------------------------------------------------
 
-static BOOL DLL_CALLCONV
-Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
-	png_structp png_ptr;
-	png_infop info_ptr;
-	png_colorp palette = NULL;
+/**
+Set the file header from the dib header data and write it
+@param png_ptr PNG handle
+@param info_ptr PNG info handle
+@param dib Image to be saved (its pixels are not used)
+@param flags Save flags
+@param palette Returned palette, to be released with png_free after writing
+@param has_alpha_channel Returned TRUE if the rows are written with an alpha channel
+@return Returns the number of passes needed to write the rows
+*/
+static int
+WriteHeader(png_structp png_ptr, png_infop info_ptr, FIBITMAP *dib, int flags, png_colorp *palette, BOOL *has_alpha_channel) {
 	png_uint_32 width, height;
-	BOOL has_alpha_channel = FALSE;
-
 	RGBQUAD *pal;					// pointer to dib palette
 	int bit_depth, pixel_depth;		// pixel_depth = bit_depth * channels
 	int palette_entries;
 	int	interlace_type;
 
-	fi_ioStructure fio;
-    fio.s_handle = handle;
-	fio.s_io = io;
+	*palette = NULL;
+	*has_alpha_channel = FALSE;
 
-	if ((dib) && (handle)) {
-		try {
-			// create the chunk manage structure
+	// set physical resolution
 
-			png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, error_handler, warning_handler);
+	png_uint_32 res_x = (png_uint_32)FreeImage_GetDotsPerMeterX(dib);
+	png_uint_32 res_y = (png_uint_32)FreeImage_GetDotsPerMeterY(dib);
 
-			if (!png_ptr)  {
-				return FALSE;
-			}
+	if ((res_x > 0) && (res_y > 0))  {
+		png_set_pHYs(png_ptr, info_ptr, res_x, res_y, PNG_RESOLUTION_METER);
+	}
 
-			// allocate/initialize the image information data.
+	// Set the image information here.  Width and height are up to 2^31,
+	// bit_depth is one of 1, 2, 4, 8, or 16, but valid values also depend on
+	// the color_type selected. color_type is one of PNG_COLOR_TYPE_GRAY,
+	// PNG_COLOR_TYPE_GRAY_ALPHA, PNG_COLOR_TYPE_PALETTE, PNG_COLOR_TYPE_RGB,
+	// or PNG_COLOR_TYPE_RGB_ALPHA.  interlace is either PNG_INTERLACE_NONE or
+	// PNG_INTERLACE_ADAM7, and the compression_type and filter_type MUST
+	// currently be PNG_COMPRESSION_TYPE_BASE and PNG_FILTER_TYPE_BASE. REQUIRED
+
+	width = FreeImage_GetWidth(dib);
+	height = FreeImage_GetHeight(dib);
+	pixel_depth = FreeImage_GetBPP(dib);
+
+	BOOL bInterlaced = FALSE;
+	if( (flags & PNG_INTERLACED) == PNG_INTERLACED) {
+		interlace_type = PNG_INTERLACE_ADAM7;
+		bInterlaced = TRUE;
+	} else {
+		interlace_type = PNG_INTERLACE_NONE;
+	}
 
-			info_ptr = png_create_info_struct(png_ptr);
+	// set the ZLIB compression level or default to PNG default compression level (ZLIB level = 6)
+	int zlib_level = flags & 0x0F;
+	if((zlib_level >= 1) && (zlib_level <= 9)) {
+		png_set_compression_level(png_ptr, zlib_level);
+	} else if((flags & PNG_Z_NO_COMPRESSION) == PNG_Z_NO_COMPRESSION) {
+		png_set_compression_level(png_ptr, Z_NO_COMPRESSION);
+	}
 
-			if (!info_ptr)  {
-				png_destroy_write_struct(&png_ptr,  (png_infopp)NULL);
-				return FALSE;
+	// filtered strategy works better for high color images
+	if(pixel_depth >= 16){
+		png_set_compression_strategy(png_ptr, Z_FILTERED);
+		png_set_filter(png_ptr, 0, PNG_FILTER_NONE|PNG_FILTER_SUB|PNG_FILTER_PAETH);
+	} else {
+		png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
+	}
+
+	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	if(image_type == FIT_BITMAP) {
+		// standard image type
+		bit_depth = (pixel_depth > 8) ? 8 : pixel_depth;
+	} else {
+		// 16-bit greyscale or 16-bit RGB(A)
+		bit_depth = 16;
+	}
+
+	// check for transparent images
+	BOOL bIsTransparent = 
+		(image_type == FIT_BITMAP) && FreeImage_IsTransparent(dib) && (FreeImage_GetTransparencyCount(dib) > 0) ? TRUE : FALSE;
+
+	switch (FreeImage_GetColorType(dib)) {
+		case FIC_MINISWHITE:
+			if(!bIsTransparent) {
+				// Invert monochrome files to have 0 as black and 1 as white (no break here)
+				png_set_invert_mono(png_ptr);
 			}
+			// (fall through)
+
+		case FIC_MINISBLACK:
+			if(!bIsTransparent) {
+				png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
+					PNG_COLOR_TYPE_GRAY, interlace_type, 
+					PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+				break;
+			}
+			// If a monochrome image is transparent, save it with a palette
+			// (fall through)
 
-			// Set error handling.  REQUIRED if you aren't supplying your own
-			// error handling functions in the png_create_write_struct() call.
+		case FIC_PALETTE:
+		{
+			png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
+				PNG_COLOR_TYPE_PALETTE, interlace_type, 
+				PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
-			if (setjmp(png_jmpbuf(png_ptr)))  {
-				// if we get here, we had a problem reading the file
+			// set the palette
 
-				png_destroy_write_struct(&png_ptr, &info_ptr);
+			palette_entries = 1 << bit_depth;
+			*palette = (png_colorp)png_malloc(png_ptr, palette_entries * sizeof (png_color));
+			pal = FreeImage_GetPalette(dib);
 
-				return FALSE;
+			for (int i = 0; i < palette_entries; i++) {
+				(*palette)[i].red   = pal[i].rgbRed;
+				(*palette)[i].green = pal[i].rgbGreen;
+				(*palette)[i].blue  = pal[i].rgbBlue;
 			}
+			
+			png_set_PLTE(png_ptr, info_ptr, *palette, palette_entries);
 
-			// init the IO
-            
-			png_set_write_fn(png_ptr, &fio, _WriteProc, _FlushProc);
+			// You must not free palette here, because png_set_PLTE only makes a link to
+			// the palette that you malloced.  Wait until you are about to destroy
+			// the png structure.
 
-			// set physical resolution
+			break;
+		}
 
-			png_uint_32 res_x = (png_uint_32)FreeImage_GetDotsPerMeterX(dib);
-			png_uint_32 res_y = (png_uint_32)FreeImage_GetDotsPerMeterY(dib);
+		case FIC_RGBALPHA :
+			*has_alpha_channel = TRUE;
 
-			if ((res_x > 0) && (res_y > 0))  {
-				png_set_pHYs(png_ptr, info_ptr, res_x, res_y, PNG_RESOLUTION_METER);
+			png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
+				PNG_COLOR_TYPE_RGBA, interlace_type, 
+				PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+			// flip BGR pixels to RGB
+			if(image_type == FIT_BITMAP) {
+				png_set_bgr(png_ptr);
 			}
-	
-			// Set the image information here.  Width and height are up to 2^31,
-			// bit_depth is one of 1, 2, 4, 8, or 16, but valid values also depend on
-			// the color_type selected. color_type is one of PNG_COLOR_TYPE_GRAY,
-			// PNG_COLOR_TYPE_GRAY_ALPHA, PNG_COLOR_TYPE_PALETTE, PNG_COLOR_TYPE_RGB,
-			// or PNG_COLOR_TYPE_RGB_ALPHA.  interlace is either PNG_INTERLACE_NONE or
-			// PNG_INTERLACE_ADAM7, and the compression_type and filter_type MUST
-			// currently be PNG_COMPRESSION_TYPE_BASE and PNG_FILTER_TYPE_BASE. REQUIRED
+#endif
+			break;
 
-			width = FreeImage_GetWidth(dib);
-			height = FreeImage_GetHeight(dib);
-			pixel_depth = FreeImage_GetBPP(dib);
+		case FIC_RGB:
+			png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
+				PNG_COLOR_TYPE_RGB, interlace_type, 
+				PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
-			BOOL bInterlaced = FALSE;
-			if( (flags & PNG_INTERLACED) == PNG_INTERLACED) {
-				interlace_type = PNG_INTERLACE_ADAM7;
-				bInterlaced = TRUE;
-			} else {
-				interlace_type = PNG_INTERLACE_NONE;
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+			// flip BGR pixels to RGB
+			if(image_type == FIT_BITMAP) {
+				png_set_bgr(png_ptr);
 			}
+#endif
+			break;
+			
+		case FIC_CMYK:
+			break;
+	}
 
-			// set the ZLIB compression level or default to PNG default compression level (ZLIB level = 6)
-			int zlib_level = flags & 0x0F;
-			if((zlib_level >= 1) && (zlib_level <= 9)) {
-				png_set_compression_level(png_ptr, zlib_level);
-			} else if((flags & PNG_Z_NO_COMPRESSION) == PNG_Z_NO_COMPRESSION) {
-				png_set_compression_level(png_ptr, Z_NO_COMPRESSION);
-			}
+	// write possible ICC profile
 
-			// filtered strategy works better for high color images
-			if(pixel_depth >= 16){
-				png_set_compression_strategy(png_ptr, Z_FILTERED);
-				png_set_filter(png_ptr, 0, PNG_FILTER_NONE|PNG_FILTER_SUB|PNG_FILTER_PAETH);
-			} else {
-				png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
-			}
+	FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
+	if (iccProfile->size && iccProfile->data) {
+		png_set_iCCP(png_ptr, info_ptr, "Embedded Profile", 0, (png_const_bytep)iccProfile->data, iccProfile->size);
+	}
 
-			FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
-			if(image_type == FIT_BITMAP) {
-				// standard image type
-				bit_depth = (pixel_depth > 8) ? 8 : pixel_depth;
-			} else {
-				// 16-bit greyscale or 16-bit RGB(A)
-				bit_depth = 16;
+	// write metadata
+
+	WriteMetadata(png_ptr, info_ptr, dib);
+
+	// Optional gamma chunk is strongly suggested if you have any guess
+	// as to the correct gamma of the image.
+	// png_set_gAMA(png_ptr, info_ptr, gamma);
+
+	// set the transparency table
+
+	if (bIsTransparent) {
+		png_set_tRNS(png_ptr, info_ptr, FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib), NULL);
+	}
+
+	// set the background color
+
+	if(FreeImage_HasBackgroundColor(dib)) {
+		png_color_16 image_background;
+		RGBQUAD rgbBkColor;
+
+		FreeImage_GetBackgroundColor(dib, &rgbBkColor);
+		memset(&image_background, 0, sizeof(png_color_16));
+		image_background.blue  = rgbBkColor.rgbBlue;
+		image_background.green = rgbBkColor.rgbGreen;
+		image_background.red   = rgbBkColor.rgbRed;
+		image_background.index = rgbBkColor.rgbReserved;
+
+		png_set_bKGD(png_ptr, info_ptr, &image_background);
+	}
+	
+	// Write the file header information.
+
+	png_write_info(png_ptr, info_ptr);
+
+	// write out the image data
+
+#ifndef FREEIMAGE_BIGENDIAN
+	if (bit_depth == 16) {
+		// turn on 16 bit byte swapping
+		png_set_swap(png_ptr);
+	}
+#endif
+
+	int number_passes = 1;
+	if (bInterlaced) {
+		number_passes = png_set_interlace_handling(png_ptr);
+	}
+
+	return number_passes;
+}
+
+// --------------------------------------------------------------------------
+
+/// Number of filtered bytes compressed by a single task (whole rows are used)
+static const unsigned PNG_CHUNK_SIZE = 256 * 1024;
+/// Number of filtered bytes of the previous chunk used as a preset dictionary
+static const unsigned PNG_WINDOW_SIZE = 32 * 1024;
+
+/**
+Row layout and transforms used to write the rows without LibPNG
+*/
+typedef struct tagRowEncoder {
+	FIBITMAP *dib;
+	png_uint_32 height;
+	/// number of bytes in a PNG row, not counting the filter byte
+	png_size_t rowbytes;
+	/// distance between a byte and the corresponding byte of the previous pixel
+	unsigned filter_bpp;
+	/// PNG_FILTER_* mask of the filters to try
+	int filters;
+	/// transparent conversion from 32- to 24-bit
+	BOOL strip_alpha;
+	/// BGR to RGB conversion
+	BOOL swap_rgb;
+	/// 16-bit byte swapping
+	BOOL swap_bytes;
+	/// monochrome inversion
+	BOOL invert;
+} RowEncoder;
+
+/**
+A chunk of rows, filtered then deflated on its own
+*/
+typedef struct tagRowChunk {
+	png_uint_32 first_row;
+	png_uint_32 last_row;
+	/// deflated data, terminated by a sync flush (or the end of stream for the last chunk)
+	BYTE *data;
+	size_t size;
+	/// Adler-32 of the filtered rows
+	uLong adler;
+	BOOL failed;
+} RowChunk;
+
+/**
+Get the PNG row y (counted from the top) in the format LibPNG would write it
+*/
+static void
+TransformRow(const RowEncoder *encoder, BYTE *target, png_uint_32 y) {
+	const BYTE *source = FreeImage_GetScanLine(encoder->dib, encoder->height - y - 1);
+
+	if (encoder->strip_alpha) {
+		FreeImage_ConvertLine32To24(target, (BYTE*)source, FreeImage_GetWidth(encoder->dib));
+	} else {
+		memcpy(target, source, encoder->rowbytes);
+	}
+	if (encoder->swap_rgb) {
+		const unsigned bytespp = encoder->filter_bpp;
+		for (png_size_t x = 0; x < encoder->rowbytes; x += bytespp) {
+			INPLACESWAP(target[x], target[x + 2]);
+		}
+	}
+	if (encoder->swap_bytes) {
+		for (png_size_t x = 0; x < encoder->rowbytes; x += 2) {
+			INPLACESWAP(target[x], target[x + 1]);
+		}
+	}
+	if (encoder->invert) {
+		for (png_size_t x = 0; x < encoder->rowbytes; x++) {
+			target[x] = ~target[x];
+		}
+	}
+}
+
+static inline BYTE
+PaethPredictor(int a, int b, int c) {
+	const int p = a + b - c;
+	const int pa = abs(p - a);
+	const int pb = abs(p - b);
+	const int pc = abs(p - c);
+	return (BYTE)(((pa <= pb) && (pa <= pc)) ? a : ((pb <= pc) ? b : c));
+}
+
+/**
+Apply a PNG filter to a row. 
+The first byte of target receives the filter type, followed by rowbytes filtered bytes.
+@return Returns the sum of the absolute values of the filtered bytes (as signed bytes)
+*/
+static png_uint_32
+FilterRow(const RowEncoder *encoder, int filter, BYTE *target, const BYTE *row, const BYTE *prev) {
+	const png_size_t rowbytes = encoder->rowbytes;
+	const unsigned bpp = encoder->filter_bpp;
+	BYTE *dst = target + 1;
+
+	switch (filter) {
+		case PNG_FILTER_SUB:
+			target[0] = PNG_FILTER_VALUE_SUB;
+			for (png_size_t x = 0; x < rowbytes; x++) {
+				dst[x] = (BYTE)(row[x] - ((x >= bpp) ? row[x - bpp] : 0));
 			}
+			break;
+		case PNG_FILTER_UP:
+			target[0] = PNG_FILTER_VALUE_UP;
+			for (png_size_t x = 0; x < rowbytes; x++) {
+				dst[x] = (BYTE)(row[x] - prev[x]);
+			}
+			break;
+		case PNG_FILTER_AVG:
+			target[0] = PNG_FILTER_VALUE_AVG;
+			for (png_size_t x = 0; x < rowbytes; x++) {
+				const unsigned left = (x >= bpp) ? row[x - bpp] : 0;
+				dst[x] = (BYTE)(row[x] - ((left + prev[x]) >> 1));
+			}
+			break;
+		case PNG_FILTER_PAETH:
+			target[0] = PNG_FILTER_VALUE_PAETH;
+			for (png_size_t x = 0; x < rowbytes; x++) {
+				const BYTE left = (x >= bpp) ? row[x - bpp] : 0;
+				const BYTE upper_left = (x >= bpp) ? prev[x - bpp] : 0;
+				dst[x] = (BYTE)(row[x] - PaethPredictor(left, prev[x], upper_left));
+			}
+			break;
+		default:
+			target[0] = PNG_FILTER_VALUE_NONE;
+			memcpy(dst, row, rowbytes);
+			break;
+	}
 
-			// check for transparent images
-			BOOL bIsTransparent = 
-				(image_type == FIT_BITMAP) && FreeImage_IsTransparent(dib) && (FreeImage_GetTransparencyCount(dib) > 0) ? TRUE : FALSE;
+	png_uint_32 sum = 0;
+	for (png_size_t x = 0; x < rowbytes; x++) {
+		sum += (dst[x] < 128) ? dst[x] : 256 - dst[x];
+	}
+	return sum;
+}
 
-			switch (FreeImage_GetColorType(dib)) {
-				case FIC_MINISWHITE:
-					if(!bIsTransparent) {
-						// Invert monochrome files to have 0 as black and 1 as white (no break here)
-						png_set_invert_mono(png_ptr);
-					}
-					// (fall through)
-
-				case FIC_MINISBLACK:
-					if(!bIsTransparent) {
-						png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
-							PNG_COLOR_TYPE_GRAY, interlace_type, 
-							PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-						break;
+/**
+Transform and filter the rows of a chunk into 'filtered', choosing the filter of each row 
+with the minimum sum of absolute differences heuristic used by LibPNG
+*/
+static BOOL
+FilterChunk(const RowEncoder *encoder, const RowChunk *chunk, BYTE *filtered) {
+	const png_size_t rowbytes = encoder->rowbytes;
+	static const int candidates[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH };
+
+	// previous row, current row and a trial filtered row
+	BYTE *buffer = (BYTE*)malloc(3 * rowbytes + 1);
+	if (!buffer) {
+		return FALSE;
+	}
+	BYTE *prev = buffer;
+	BYTE *row = buffer + rowbytes;
+	BYTE *trial = buffer + 2 * rowbytes;
+
+	// the row above the first one is made of zeros
+	if (chunk->first_row > 0) {
+		TransformRow(encoder, prev, chunk->first_row - 1);
+	} else {
+		memset(prev, 0, rowbytes);
+	}
+
+	for (png_uint_32 y = chunk->first_row; y < chunk->last_row; y++) {
+		BYTE *target = filtered + (size_t)y * (rowbytes + 1);
+
+		TransformRow(encoder, row, y);
+
+		png_uint_32 best_sum = 0xFFFFFFFF;
+		for (int i = 0; i < 5; i++) {
+			if (encoder->filters & candidates[i]) {
+				if (best_sum == 0xFFFFFFFF) {
+					best_sum = FilterRow(encoder, candidates[i], target, row, prev);
+				} else {
+					const png_uint_32 sum = FilterRow(encoder, candidates[i], trial, row, prev);
+					if (sum < best_sum) {
+						best_sum = sum;
+						memcpy(target, trial, rowbytes + 1);
 					}
-					// If a monochrome image is transparent, save it with a palette
-					// (fall through)
+				}
+			}
+		}
 
-				case FIC_PALETTE:
-				{
-					png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
-						PNG_COLOR_TYPE_PALETTE, interlace_type, 
-						PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+		BYTE *tmp = prev;
+		prev = row;
+		row = tmp;
+	}
 
-					// set the palette
+	free(buffer);
 
-					palette_entries = 1 << bit_depth;
-					palette = (png_colorp)png_malloc(png_ptr, palette_entries * sizeof (png_color));
-					pal = FreeImage_GetPalette(dib);
+	return TRUE;
+}
 
-					for (int i = 0; i < palette_entries; i++) {
-						palette[i].red   = pal[i].rgbRed;
-						palette[i].green = pal[i].rgbGreen;
-						palette[i].blue  = pal[i].rgbBlue;
-					}
-					
-					png_set_PLTE(png_ptr, info_ptr, palette, palette_entries);
+/**
+Deflate the filtered rows of a chunk as a raw deflate stream, 
+primed with the end of the previous chunk so that the streams can be concatenated
+*/
+static BOOL
+DeflateChunk(RowChunk *chunk, const BYTE *filtered, size_t row_size, int level, BOOL last) {
+	const BYTE *input = filtered + (size_t)chunk->first_row * row_size;
+	const size_t length = (size_t)(chunk->last_row - chunk->first_row) * row_size;
 
-					// You must not free palette here, because png_set_PLTE only makes a link to
-					// the palette that you malloced.  Wait until you are about to destroy
-					// the png structure.
+	chunk->adler = fastdeflate_adler32(1, input, length);
 
-					break;
-				}
+	struct fastdeflate_compressor *compressor = fastdeflate_alloc_compressor(level);
+	if (!compressor) {
+		return FALSE;
+	}
 
-				case FIC_RGBALPHA :
-					has_alpha_channel = TRUE;
+	// the previous rows are filtered already and stay in memory
+	const size_t offset = (size_t)chunk->first_row * row_size;
+	const size_t window = MIN<size_t>(offset, PNG_WINDOW_SIZE);
 
-					png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
-						PNG_COLOR_TYPE_RGBA, interlace_type, 
-						PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	// a sync flush ends the stream on a byte boundary, without a final block
+	const size_t capacity = fastdeflate_deflate_compress_bound(compressor, length);
+	chunk->data = (BYTE*)malloc(capacity);
+	if (chunk->data) {
+		chunk->size = fastdeflate_deflate_compress_chunk(compressor, input, length, window, last, chunk->data, capacity);
+	}
 
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-					// flip BGR pixels to RGB
-					if(image_type == FIT_BITMAP) {
-						png_set_bgr(png_ptr);
-					}
-#endif
-					break;
-	
-				case FIC_RGB:
-					png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, 
-						PNG_COLOR_TYPE_RGB, interlace_type, 
-						PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	fastdeflate_free_compressor(compressor);
+
+	return (chunk->size > 0);
+}
 
+/**
+Write the image data of a non-interlaced image on the worker pool: chunks of rows are 
+filtered and deflated independently, then written as a single ZLib stream split 
+into one IDAT chunk per chunk of rows. The IEND chunk is written as well.
+@return Returns TRUE if the image data was written, returns FALSE if the rows 
+still have to be written with png_write_row (nothing has been written then)
+*/
+static BOOL
+WriteRowsParallel(png_structp png_ptr, png_infop info_ptr, FIBITMAP *dib, int flags, BOOL has_alpha_channel) {
+	if ((ParallelGetThreadCount() < 2) || (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE)) {
+		return FALSE;
+	}
+
+	// compression level, as set by WriteHeader
+	int level = flags & 0x0F;
+	if ((level < 1) || (level > 9)) {
+		if ((flags & PNG_Z_NO_COMPRESSION) == PNG_Z_NO_COMPRESSION) {
+			return FALSE;
+		}
+		level = 6;
+	}
+	const unsigned pixel_depth = FreeImage_GetBPP(dib);
+
+	const int color_type = png_get_color_type(png_ptr, info_ptr);
+	const int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+
+	RowEncoder encoder;
+	encoder.dib = dib;
+	encoder.height = png_get_image_height(png_ptr, info_ptr);
+	encoder.rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+	encoder.filter_bpp = MAX(1U, (unsigned)(png_get_channels(png_ptr, info_ptr) * bit_depth) / 8);
+	if (pixel_depth >= 16) {
+		encoder.filters = PNG_FILTER_NONE | PNG_FILTER_SUB | PNG_FILTER_PAETH;
+	} else if ((color_type == PNG_COLOR_TYPE_PALETTE) || (bit_depth < 8)) {
+		encoder.filters = PNG_FILTER_NONE;
+	} else {
+		encoder.filters = PNG_ALL_FILTERS;
+	}
+	encoder.strip_alpha = (pixel_depth == 32) && !has_alpha_channel;
 #if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-					// flip BGR pixels to RGB
-					if(image_type == FIT_BITMAP) {
-						png_set_bgr(png_ptr);
-					}
+	encoder.swap_rgb = (image_type == FIT_BITMAP) && ((color_type == PNG_COLOR_TYPE_RGB) || (color_type == PNG_COLOR_TYPE_RGB_ALPHA));
+#else
+	encoder.swap_rgb = FALSE;
 #endif
-					break;
-					
-				case FIC_CMYK:
-					break;
-			}
+#ifndef FREEIMAGE_BIGENDIAN
+	encoder.swap_bytes = (bit_depth == 16);
+#else
+	encoder.swap_bytes = FALSE;
+#endif
+	encoder.invert = (FreeImage_GetColorType(dib) == FIC_MINISWHITE) && (color_type == PNG_COLOR_TYPE_GRAY);
 
-			// write possible ICC profile
+	const size_t row_size = encoder.rowbytes + 1;
+	const png_uint_32 height = encoder.height;
+	if ((height == 0) || (row_size > ((size_t)-1) / height) || (row_size > PNG_UINT_31_MAX)) {
+		return FALSE;
+	}
+
+	// chunk boundaries only depend on the image, so that the output does not depend on the thread count
+	const png_uint_32 chunk_rows = MAX<png_uint_32>(1, (png_uint_32)(PNG_CHUNK_SIZE / row_size));
+	const unsigned chunk_count = (unsigned)((height + chunk_rows - 1) / chunk_rows);
+	if (chunk_count < 2) {
+		return FALSE;
+	}
+
+	BYTE *filtered = (BYTE*)malloc(row_size * height);
+	if (!filtered) {
+		return FALSE;
+	}
 
-			FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
-			if (iccProfile->size && iccProfile->data) {
-				png_set_iCCP(png_ptr, info_ptr, "Embedded Profile", 0, (png_const_bytep)iccProfile->data, iccProfile->size);
+	std::vector<RowChunk> chunks(chunk_count);
+	for (unsigned i = 0; i < chunk_count; i++) {
+		memset(&chunks[i], 0, sizeof(RowChunk));
+		chunks[i].first_row = i * chunk_rows;
+		chunks[i].last_row = MIN<png_uint_32>(height, (i + 1) * chunk_rows);
+	}
+
+	// each chunk is primed with the filtered rows of the previous one: filter all rows first
+	ParallelFor(0, chunk_count, 1, [&](unsigned first, unsigned last) {
+		for (unsigned i = first; i < last; i++) {
+			chunks[i].failed = !FilterChunk(&encoder, &chunks[i], filtered);
+		}
+	});
+	BOOL success = TRUE;
+	for (unsigned i = 0; i < chunk_count; i++) {
+		success = success && !chunks[i].failed;
+	}
+	if (success) {
+		ParallelFor(0, chunk_count, 1, [&](unsigned first, unsigned last) {
+			for (unsigned i = first; i < last; i++) {
+				chunks[i].failed = !DeflateChunk(&chunks[i], filtered, row_size, level, (i + 1 == chunk_count));
 			}
+		});
+		for (unsigned i = 0; i < chunk_count; i++) {
+			success = success && !chunks[i].failed;
+		}
+	}
 
-			// write metadata
+	free(filtered);
 
-			WriteMetadata(png_ptr, info_ptr, dib);
+	if (success) {
+		// ZLib header (no preset dictionary, 32K window), as written by deflate
+		const int level_flags = (level < 2) ? 0 : ((level < 6) ? 1 : ((level == 6) ? 2 : 3));
+		unsigned header = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8;
+		header |= (level_flags << 6);
+		header += 31 - (header % 31);
+		BYTE zlib_header[2] = { (BYTE)(header >> 8), (BYTE)(header & 0xFF) };
 
-			// Optional gamma chunk is strongly suggested if you have any guess
-			// as to the correct gamma of the image.
-			// png_set_gAMA(png_ptr, info_ptr, gamma);
+		uLong adler = chunks[0].adler;
+		for (unsigned i = 1; i < chunk_count; i++) {
+			adler = adler32_combine(adler, chunks[i].adler, (z_off_t)((chunks[i].last_row - chunks[i].first_row) * row_size));
+		}
+		BYTE zlib_trailer[4] = { (BYTE)(adler >> 24), (BYTE)(adler >> 16), (BYTE)(adler >> 8), (BYTE)adler };
 
-			// set the transparency table
+		try {
+			for (unsigned i = 0; i < chunk_count; i++) {
+				const BOOL first = (i == 0);
+				const BOOL last = (i + 1 == chunk_count);
+				const size_t length = chunks[i].size + (first ? 2 : 0) + (last ? 4 : 0);
+				if (length > PNG_UINT_31_MAX) {
+					png_error(png_ptr, "IDAT chunk too large");
+				}
+
+				png_write_chunk_start(png_ptr, (png_const_bytep)"IDAT", (png_uint_32)length);
+				if (first) {
+					png_write_chunk_data(png_ptr, zlib_header, 2);
+				}
+				png_write_chunk_data(png_ptr, chunks[i].data, chunks[i].size);
+				if (last) {
+					png_write_chunk_data(png_ptr, zlib_trailer, 4);
+				}
+				png_write_chunk_end(png_ptr);
+
+				free(chunks[i].data);
+				chunks[i].data = NULL;
+			}
 
-			if (bIsTransparent) {
-				png_set_tRNS(png_ptr, info_ptr, FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib), NULL);
+			// all the ancillary chunks were written by png_write_info
+			png_write_chunk(png_ptr, (png_const_bytep)"IEND", NULL, 0);
+
+		} catch (const char *) {
+			for (unsigned i = 0; i < chunk_count; i++) {
+				free(chunks[i].data);
 			}
+			throw;
+		}
+	} else {
+		for (unsigned i = 0; i < chunk_count; i++) {
+			free(chunks[i].data);
+		}
+	}
+
+	return success;
+}
+
+static BOOL DLL_CALLCONV
+Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
+	png_structp png_ptr;
+	png_infop info_ptr;
+	png_colorp palette = NULL;
+	png_uint_32 width, height;
+	BOOL has_alpha_channel = FALSE;
+	int pixel_depth;
 
-			// set the background color
+	fi_ioStructure fio;
+    fio.s_handle = handle;
+	fio.s_io = io;
 
-			if(FreeImage_HasBackgroundColor(dib)) {
-				png_color_16 image_background;
-				RGBQUAD rgbBkColor;
+	if ((dib) && (handle)) {
+		try {
+			// create the chunk manage structure
 
-				FreeImage_GetBackgroundColor(dib, &rgbBkColor);
-				memset(&image_background, 0, sizeof(png_color_16));
-				image_background.blue  = rgbBkColor.rgbBlue;
-				image_background.green = rgbBkColor.rgbGreen;
-				image_background.red   = rgbBkColor.rgbRed;
-				image_background.index = rgbBkColor.rgbReserved;
+			png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, error_handler, warning_handler);
 
-				png_set_bKGD(png_ptr, info_ptr, &image_background);
+			if (!png_ptr)  {
+				return FALSE;
 			}
-			
-			// Write the file header information.
 
-			png_write_info(png_ptr, info_ptr);
+			// allocate/initialize the image information data.
 
-			// write out the image data
+			info_ptr = png_create_info_struct(png_ptr);
 
-#ifndef FREEIMAGE_BIGENDIAN
-			if (bit_depth == 16) {
-				// turn on 16 bit byte swapping
-				png_set_swap(png_ptr);
+			if (!info_ptr)  {
+				png_destroy_write_struct(&png_ptr,  (png_infopp)NULL);
+				return FALSE;
 			}
-#endif
 
-			int number_passes = 1;
-			if (bInterlaced) {
-				number_passes = png_set_interlace_handling(png_ptr);
+			// Set error handling.  REQUIRED if you aren't supplying your own
+			// error handling functions in the png_create_write_struct() call.
+
+			if (setjmp(png_jmpbuf(png_ptr)))  {
+				// if we get here, we had a problem reading the file
+
+				png_destroy_write_struct(&png_ptr, &info_ptr);
+
+				return FALSE;
 			}
 
-			if ((pixel_depth == 32) && (!has_alpha_channel)) {
+			// init the IO
+            
+			png_set_write_fn(png_ptr, &fio, _WriteProc, _FlushProc);
+
+			// set the file header and write it
+
+			width = FreeImage_GetWidth(dib);
+			height = FreeImage_GetHeight(dib);
+			pixel_depth = FreeImage_GetBPP(dib);
+
+			const int number_passes = WriteHeader(png_ptr, info_ptr, dib, flags, &palette, &has_alpha_channel);
+
+			// large images are filtered and deflated on the worker pool
+			const BOOL parallel = WriteRowsParallel(png_ptr, info_ptr, dib, flags, has_alpha_channel);
+
+			if (parallel) {
+				// the image data and the end of the file have been written
+			} else if ((pixel_depth == 32) && (!has_alpha_channel)) {
 				BYTE *buffer = (BYTE *)malloc(width * 3);
 
 				// transparent conversion to 24-bit
@@ -1066,7 +1500,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			// It is REQUIRED to call this to finish writing the rest of the file
 			// Bug with png_flush
 
-			png_write_end(png_ptr, info_ptr);
+			if (!parallel) {
+				png_write_end(png_ptr, info_ptr);
+			}
 
 			// clean up after the write, and free any memory allocated
 			if (palette) {
@@ -1088,6 +1524,242 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return FALSE;
 }
 
+// ==========================================================
+//   Scanline streams
+// ==========================================================
+
+/**
+State of a scanline reader (non-interlaced files only)
+*/
+typedef struct tagScanlineReader {
+	fi_ioStructure fio;
+	png_structp png_ptr;
+	png_infop info_ptr;
+	/// TRUE once LibPNG signaled an error
+	BOOL failed;
+} ScanlineReader;
+
+/**
+State of a scanline writer (non-interlaced files only)
+*/
+typedef struct tagScanlineWriter {
+	fi_ioStructure fio;
+	png_structp png_ptr;
+	png_infop info_ptr;
+	png_colorp palette;
+	/// 32- to 24-bit conversion buffer, NULL if not needed
+	BYTE *buffer;
+	png_uint_32 width;
+	png_uint_32 height;
+	png_uint_32 next_line;
+	/// TRUE once LibPNG signaled an error
+	BOOL failed;
+} ScanlineWriter;
+
+static void * DLL_CALLCONV
+OpenScanlineReader(FreeImageIO *io, fi_handle handle, int flags, FIBITMAP **info) {
+	BYTE png_check[PNG_BYTES_TO_CHECK];
+
+	io->read_proc(png_check, PNG_BYTES_TO_CHECK, 1, handle);
+
+	if (png_sig_cmp(png_check, (png_size_t)0, PNG_BYTES_TO_CHECK) != 0) {
+		return NULL;	// Bad signature
+	}
+
+	ScanlineReader *reader = (ScanlineReader*)malloc(sizeof(ScanlineReader));
+	if (!reader) {
+		return NULL;
+	}
+	memset(reader, 0, sizeof(ScanlineReader));
+	reader->fio.s_io = io;
+	reader->fio.s_handle = handle;
+
+	FIBITMAP *dib = NULL;
+
+	try {
+		reader->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, error_handler, warning_handler);
+		if (!reader->png_ptr) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		reader->info_ptr = png_create_info_struct(reader->png_ptr);
+		if (!reader->info_ptr) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
+		png_set_read_fn(reader->png_ptr, &reader->fio, _ReadProc);
+		png_set_sig_bytes(reader->png_ptr, PNG_BYTES_TO_CHECK);
+
+		dib = ReadHeader(reader->png_ptr, reader->info_ptr, flags, TRUE);
+
+		if (png_get_interlace_type(reader->png_ptr, reader->info_ptr) != PNG_INTERLACE_NONE) {
+			// interlaced rows come in several passes: let the caller load the whole image
+			throw (const char*)NULL;
+		}
+
+		// metadata located before the image data
+		ReadMetadata(reader->png_ptr, reader->info_ptr, dib);
+
+		if (FreeImage_GetBPP(dib) == 32) {
+			FreeImage_SetTransparent(dib, (FreeImage_GetColorType(dib) == FIC_RGBALPHA) ? TRUE : FALSE);
+		}
+
+		png_set_benign_errors(reader->png_ptr, 1);
+
+		*info = dib;
+
+		return reader;
+
+	} catch (const char *text) {
+		if (reader->png_ptr) {
+			png_destroy_read_struct(&reader->png_ptr, reader->info_ptr ? &reader->info_ptr : (png_infopp)NULL, (png_infopp)NULL);
+		}
+		if (dib) {
+			FreeImage_Unload(dib);
+		}
+		free(reader);
+		if (text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+	}
+
+	return NULL;
+}
+
+static unsigned DLL_CALLCONV
+ReadScanlines(void *data, BYTE *bits, unsigned pitch, unsigned count) {
+	ScanlineReader *reader = (ScanlineReader*)data;
+
+	unsigned lines = 0;
+
+	if (!reader->failed) {
+		try {
+			for (; lines < count; lines++) {
+				png_read_row(reader->png_ptr, bits + lines * pitch, NULL);
+			}
+		} catch (const char *text) {
+			reader->failed = TRUE;
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+	}
+
+	return lines;
+}
+
+static void DLL_CALLCONV
+CloseScanlineReader(void *data) {
+	ScanlineReader *reader = (ScanlineReader*)data;
+
+	png_destroy_read_struct(&reader->png_ptr, &reader->info_ptr, (png_infopp)NULL);
+	free(reader);
+}
+
+static void * DLL_CALLCONV
+OpenScanlineWriter(FreeImageIO *io, fi_handle handle, FIBITMAP *info, int flags) {
+	if ((flags & PNG_INTERLACED) == PNG_INTERLACED) {
+		// interlaced rows are written in several passes: let the caller save the whole image
+		return NULL;
+	}
+
+	ScanlineWriter *writer = (ScanlineWriter*)malloc(sizeof(ScanlineWriter));
+	if (!writer) {
+		return NULL;
+	}
+	memset(writer, 0, sizeof(ScanlineWriter));
+	writer->fio.s_io = io;
+	writer->fio.s_handle = handle;
+	writer->width = FreeImage_GetWidth(info);
+	writer->height = FreeImage_GetHeight(info);
+
+	try {
+		writer->png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, error_handler, warning_handler);
+		if (!writer->png_ptr) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		writer->info_ptr = png_create_info_struct(writer->png_ptr);
+		if (!writer->info_ptr) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
+		png_set_write_fn(writer->png_ptr, &writer->fio, _WriteProc, _FlushProc);
+
+		BOOL has_alpha_channel = FALSE;
+		WriteHeader(writer->png_ptr, writer->info_ptr, info, flags, &writer->palette, &has_alpha_channel);
+
+		if ((FreeImage_GetBPP(info) == 32) && !has_alpha_channel) {
+			writer->buffer = (BYTE*)malloc(writer->width * 3);
+			if (!writer->buffer) {
+				throw FI_MSG_ERROR_MEMORY;
+			}
+		}
+
+		return writer;
+
+	} catch (const char *text) {
+		if (writer->png_ptr) {
+			if (writer->palette) {
+				png_free(writer->png_ptr, writer->palette);
+			}
+			png_destroy_write_struct(&writer->png_ptr, writer->info_ptr ? &writer->info_ptr : (png_infopp)NULL);
+		}
+		free(writer);
+		FreeImage_OutputMessageProc(s_format_id, text);
+	}
+
+	return NULL;
+}
+
+static BOOL DLL_CALLCONV
+WriteScanlines(void *data, BYTE *bits, unsigned pitch, unsigned count) {
+	ScanlineWriter *writer = (ScanlineWriter*)data;
+
+	if (writer->failed) {
+		return FALSE;
+	}
+
+	try {
+		for (unsigned y = 0; y < count; y++) {
+			if (writer->buffer) {
+				// transparent conversion to 24-bit
+				FreeImage_ConvertLine32To24(writer->buffer, bits + y * pitch, writer->width);
+				png_write_row(writer->png_ptr, writer->buffer);
+			} else {
+				png_write_row(writer->png_ptr, bits + y * pitch);
+			}
+			writer->next_line++;
+		}
+	} catch (const char *text) {
+		writer->failed = TRUE;
+		FreeImage_OutputMessageProc(s_format_id, text);
+	}
+
+	return !writer->failed;
+}
+
+static BOOL DLL_CALLCONV
+CloseScanlineWriter(void *data) {
+	ScanlineWriter *writer = (ScanlineWriter*)data;
+
+	BOOL success = !writer->failed && (writer->next_line == writer->height);
+
+	if (success) {
+		try {
+			png_write_end(writer->png_ptr, writer->info_ptr);
+		} catch (const char *text) {
+			success = FALSE;
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+	}
+
+	if (writer->palette) {
+		png_free(writer->png_ptr, writer->palette);
+	}
+	png_destroy_write_struct(&writer->png_ptr, &writer->info_ptr);
+	free(writer->buffer);
+	free(writer);
+
+	return success;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -1112,4 +1784,10 @@ InitPNG(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->open_scanline_reader_proc = OpenScanlineReader;
+	plugin->read_scanlines_proc = ReadScanlines;
+	plugin->close_scanline_reader_proc = CloseScanlineReader;
+	plugin->open_scanline_writer_proc = OpenScanlineWriter;
+	plugin->write_scanlines_proc = WriteScanlines;
+	plugin->close_scanline_writer_proc = CloseScanlineWriter;
 }
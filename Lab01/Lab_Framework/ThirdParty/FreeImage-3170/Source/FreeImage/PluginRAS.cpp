@@ -90,11 +90,20 @@ typedef struct tagSUNHEADER {
 // Internal functions
 // ==========================================================
 
+/**
+Run-Length decoder state, kept between calls to ReadData for one image
+*/
+typedef struct tagRLEState {
+	BYTE repchar;
+	BYTE remaining;
+} RLEState;
+
 static void
-ReadData(FreeImageIO *io, fi_handle handle, BYTE *buf, DWORD length, BOOL rle) {
+ReadData(FreeImageIO *io, fi_handle handle, BYTE *buf, DWORD length, BOOL rle, RLEState *state) {
 	// Read either Run-Length Encoded or normal image data
 
-	static BYTE repchar, remaining= 0;
+	BYTE &repchar = state->repchar;
+	BYTE &remaining = state->remaining;
 
 	if (rle) {
 		// Run-length encoded read
@@ -196,6 +205,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	WORD linelength;	// Length of raster line in bytes
 	WORD fill;			// Number of fill bytes per raster line
 	BOOL rle;			// TRUE if RLE file
+	RLEState rle_state = { 0, 0 };	// RLE decoder state
 	BOOL isRGB;			// TRUE if file type is RT_FORMAT_RGB
 	BYTE fillchar;
 
@@ -376,12 +386,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				bits = FreeImage_GetBits(dib) + (header.height - 1) * pitch;
 
 				for (y = 0; y < header.height; y++) {
-					ReadData(io, handle, bits, linelength, rle);
+					ReadData(io, handle, bits, linelength, rle, &rle_state);
 
 					bits -= pitch;
 
 					if (fill) {
-						ReadData(io, handle, &fillchar, fill, rle);
+						ReadData(io, handle, &fillchar, fill, rle, &rle_state);
 					}
 				}
 
@@ -397,7 +407,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (y = 0; y < header.height; y++) {
 					bits = FreeImage_GetBits(dib) + (header.height - 1 - y) * pitch;
 
-					ReadData(io, handle, buf, header.width * 3, rle);
+					ReadData(io, handle, buf, header.width * 3, rle, &rle_state);
 
 					bp = buf;
 
@@ -420,7 +430,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 
 					if (fill) {
-						ReadData(io, handle, &fillchar, fill, rle);
+						ReadData(io, handle, &fillchar, fill, rle, &rle_state);
 					}
 				}
 
@@ -437,7 +447,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (y = 0; y < header.height; y++) {
 					bits = FreeImage_GetBits(dib) + (header.height - 1 - y) * pitch;
 
-					ReadData(io, handle, buf, header.width * 4, rle);
+					ReadData(io, handle, buf, header.width * 4, rle, &rle_state);
 
 					bp = buf;
 
@@ -464,7 +474,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 
 					if (fill) {
-						ReadData(io, handle, &fillchar, fill, rle);
+						ReadData(io, handle, &fillchar, fill, rle, &rle_state);
 					}
 				}
 
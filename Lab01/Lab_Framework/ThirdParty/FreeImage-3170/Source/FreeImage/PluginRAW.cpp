@@ -23,6 +23,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 #include "../Metadata/FreeImageTag.h"
 
 // ==========================================================
@@ -136,6 +137,19 @@ public:
 	}
 };
 
+// ----------------------------------------------------------
+//   Worker pool adapter
+// ----------------------------------------------------------
+
+/**
+LibRaw parallel loop handler, runs the LibRaw bands on the FreeImage worker pool
+(black level subtraction, white balance, AHD demosaicing and output conversion)
+*/
+static void 
+libraw_ParallelForBands(void *data, unsigned begin, unsigned end, unsigned grain, parallel_band_callback band, void *context) {
+	ParallelForBands(begin, end, grain, band, context);
+}
+
 // ----------------------------------------------------------
 
 /**
@@ -701,6 +715,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		RawProcessor->imgdata.params.use_camera_matrix = 1;
 		// (-h) outputs the image in 50% size
 		RawProcessor->imgdata.params.half_size = ((flags & RAW_HALFSIZE) == RAW_HALFSIZE) ? 1 : 0;
+		// split the processing loops over the worker pool
+		if(ParallelGetThreadCount() > 1) {
+			RawProcessor->set_parallel_handler(libraw_ParallelForBands, NULL);
+		}
 
 		// open the datastream
 		if(RawProcessor->open_datastream(&datastream) != LIBRAW_SUCCESS) {
@@ -43,6 +43,10 @@
 
 #include "FreeImageIO.h"
 #include "PSDParser.h"
+#include "ThreadPool.h"
+
+#include "../ZLib/zlib.h"
+#include "../FastDeflate/fastdeflate.h"
 
 // --------------------------------------------------------------------------
 // GeoTIFF profile (see XTIFF.cpp)
@@ -1208,6 +1212,541 @@ FindLoadMethod(TIFF *tif, FREE_IMAGE_TYPE image_type, int flags) {
 	return loadMethod;
 }
 
+// ==========================================================
+// Parallel strip and tile decoding
+// ==========================================================
+
+/**
+Strips and tiles compressed with LZW, Deflate or PackBits are read as raw data on the 
+calling thread, then decompressed on the worker pool. The decoders below give the same 
+data as LibTIFF for valid data, and give up on anything else: the image is then read 
+again with LibTIFF, which reports the errors.
+*/
+typedef struct tagChunkDecoder {
+	uint16 compression;
+	uint16 bitspersample;
+	/// horizontal differencing, with a distance of 'stride' samples
+	BOOL predictor;
+	uint16 stride;
+	/// the byte order of the file is not the byte order of the host
+	BOOL swab;
+	/// size of a decoded row (scanline or tile row)
+	tmsize_t row_size;
+} ChunkDecoder;
+
+#define LZW_CODE_CLEAR	256
+#define LZW_CODE_EOI	257
+#define LZW_CODE_FIRST	258
+#define LZW_BITS_MIN	9
+#define LZW_BITS_MAX	12
+/// size of the LibTIFF code table, with room for encoders that clear the table late
+#define LZW_TABLE_SIZE	(4095 + 1024)
+
+/**
+Decode a strip or a tile compressed with (new style) LZW, see LibTIFF's LZWDecode
+*/
+static BOOL
+DecodeLZW(const BYTE *src, tmsize_t src_size, BYTE *dst, tmsize_t dst_size) {
+	// old-style bit-reversed codes are left to LibTIFF
+	if((src_size < 2) || ((src[0] == 0) && (src[1] & 0x1))) {
+		return FALSE;
+	}
+
+	WORD *prefix = (WORD*)malloc(LZW_TABLE_SIZE * (2 * sizeof(WORD) + 2));
+	if(!prefix) {
+		return FALSE;
+	}
+	WORD *length = prefix + LZW_TABLE_SIZE;
+	BYTE *suffix = (BYTE*)(length + LZW_TABLE_SIZE);
+	BYTE *firstchar = suffix + LZW_TABLE_SIZE;
+
+	for(unsigned code = 0; code < 256; code++) {
+		prefix[code] = 0;
+		length[code] = 1;
+		suffix[code] = firstchar[code] = (BYTE)code;
+	}
+
+	const BYTE *bp = src;
+	uint64 bitsleft = (uint64)src_size << 3;
+	DWORD nextdata = 0;
+	unsigned nextbits = 0;
+	unsigned nbits = LZW_BITS_MIN;
+	unsigned free_ent = LZW_CODE_FIRST;
+	unsigned maxcode = (1U << nbits) - 2;
+	// the data must start with a clear code (-2), a clear code is followed by a literal (-1)
+	int oldcode = -2;
+
+	BYTE *op = dst;
+	tmsize_t occ = dst_size;
+	BOOL bResult = FALSE;
+
+	while(occ > 0) {
+		if(bitsleft < nbits) {
+			break;
+		}
+		nextdata = (nextdata << 8) | *bp++;
+		nextbits += 8;
+		if(nextbits < nbits) {
+			nextdata = (nextdata << 8) | *bp++;
+			nextbits += 8;
+		}
+		unsigned code = (nextdata >> (nextbits - nbits)) & ((1U << nbits) - 1);
+		nextbits -= nbits;
+		bitsleft -= nbits;
+
+		if(code == LZW_CODE_EOI) {
+			break;
+		}
+		if(code == LZW_CODE_CLEAR) {
+			free_ent = LZW_CODE_FIRST;
+			nbits = LZW_BITS_MIN;
+			maxcode = (1U << nbits) - 2;
+			oldcode = -1;
+			continue;
+		}
+		if(oldcode == -2) {
+			break;
+		}
+		if(oldcode == -1) {
+			// first code after a clear code
+			if(code >= LZW_CODE_CLEAR) {
+				break;
+			}
+			*op++ = (BYTE)code;
+			occ--;
+			oldcode = (int)code;
+			continue;
+		}
+		if((code > free_ent) || (free_ent >= LZW_TABLE_SIZE)) {
+			break;
+		}
+
+		// add the new entry to the code table
+		prefix[free_ent] = (WORD)oldcode;
+		firstchar[free_ent] = firstchar[oldcode];
+		length[free_ent] = (WORD)(length[oldcode] + 1);
+		suffix[free_ent] = (code < free_ent) ? firstchar[code] : firstchar[oldcode];
+		if(++free_ent > maxcode) {
+			nbits = MIN<unsigned>(nbits + 1, LZW_BITS_MAX);
+			maxcode = (1U << nbits) - 2;
+		}
+		oldcode = (int)code;
+
+		// copy the string of the code (written in reverse)
+		unsigned len = length[code];
+		if(len == 0) {
+			break;
+		}
+		while(len > occ) {
+			// only the beginning of the string fits in the output buffer
+			code = prefix[code];
+			len--;
+		}
+		for(BYTE *tp = op + len; tp > op; ) {
+			*--tp = suffix[code];
+			code = prefix[code];
+		}
+		op += len;
+		occ -= len;
+	}
+	bResult = (occ == 0);
+
+	free(prefix);
+
+	return bResult;
+}
+
+/**
+Decode a Deflate strip or tile with ZLib's streaming decoder, see LibTIFF's ZIPDecode. 
+The output buffer may be filled before the end of the stream.
+*/
+static BOOL
+DecodeDeflateStream(const BYTE *src, tmsize_t src_size, BYTE *dst, tmsize_t dst_size) {
+	if(((tmsize_t)(uInt)src_size != src_size) || ((tmsize_t)(uInt)dst_size != dst_size)) {
+		return FALSE;
+	}
+
+	z_stream stream;
+	memset(&stream, 0, sizeof(z_stream));
+	if(inflateInit(&stream) != Z_OK) {
+		return FALSE;
+	}
+	stream.next_in = (Bytef*)src;
+	stream.avail_in = (uInt)src_size;
+	stream.next_out = dst;
+	stream.avail_out = (uInt)dst_size;
+
+	do {
+		const int state = inflate(&stream, Z_PARTIAL_FLUSH);
+		if((state == Z_STREAM_END) || (state != Z_OK)) {
+			break;
+		}
+	} while(stream.avail_out > 0);
+
+	const BOOL bResult = (stream.avail_out == 0);
+	inflateEnd(&stream);
+
+	return bResult;
+}
+
+/**
+Decode a strip or a tile compressed with Deflate. 
+The whole strip is in memory: FastDeflate decodes it at once, and the streaming decoder 
+is only used for the streams it does not accept as they are (data past the end of the strip, 
+or a damaged stream, which ZIPDecode decodes as far as possible).
+*/
+static BOOL
+DecodeDeflate(const BYTE *src, tmsize_t src_size, BYTE *dst, tmsize_t dst_size) {
+	struct fastdeflate_decompressor *decompressor = fastdeflate_alloc_decompressor();
+	if(!decompressor) {
+		return FALSE;
+	}
+	const enum fastdeflate_result result = fastdeflate_zlib_decompress(decompressor, src, (size_t)src_size, dst, (size_t)dst_size, NULL);
+	fastdeflate_free_decompressor(decompressor);
+
+	if(result == FASTDEFLATE_SUCCESS) {
+		return TRUE;
+	}
+	return DecodeDeflateStream(src, src_size, dst, dst_size);
+}
+
+/**
+Decode a strip or a tile compressed with PackBits, see LibTIFF's PackBitsDecode
+*/
+static BOOL
+DecodePackBits(const BYTE *src, tmsize_t src_size, BYTE *dst, tmsize_t dst_size) {
+	const BYTE *bp = src;
+	tmsize_t cc = src_size;
+	BYTE *op = dst;
+	tmsize_t occ = dst_size;
+
+	while((cc > 0) && (occ > 0)) {
+		int n = (int)(signed char)*bp++;
+		cc--;
+		if(n < 0) {
+			// replicate the next byte -n + 1 times
+			if(n == -128) {
+				continue;
+			}
+			n = -n + 1;
+			if((occ < n) || (cc < 1)) {
+				return FALSE;
+			}
+			memset(op, *bp++, n);
+			cc--;
+		} else {
+			// copy the next n + 1 bytes literally
+			n++;
+			if((occ < n) || (cc < n)) {
+				return FALSE;
+			}
+			memcpy(op, bp, n);
+			bp += n;
+			cc -= n;
+		}
+		op += n;
+		occ -= n;
+	}
+
+	return (occ == 0);
+}
+
+/**
+Undo the horizontal differencing of a row, see LibTIFF's horAcc8, horAcc16 and horAcc32
+*/
+template <class T> static void
+AccumulateRow(T *row, tmsize_t count, unsigned stride) {
+	for(tmsize_t i = stride; i < count; i++) {
+		row[i] = (T)(row[i] + row[i - stride]);
+	}
+}
+
+/**
+Decompress a strip or a tile, then apply the byte swapping and the predictor as LibTIFF does
+@param decoder Chunk layout
+@param src Raw data
+@param src_size Size of the raw data
+@param dst Decoded data
+@param dst_size Size of the decoded data, a multiple of the row size
+@return Returns FALSE if the data could not be decoded
+*/
+static BOOL
+DecodeChunk(const ChunkDecoder *decoder, const BYTE *src, tmsize_t src_size, BYTE *dst, tmsize_t dst_size) {
+	BOOL bResult = FALSE;
+
+	switch(decoder->compression) {
+		case COMPRESSION_LZW:
+			bResult = DecodeLZW(src, src_size, dst, dst_size);
+			break;
+		case COMPRESSION_ADOBE_DEFLATE:
+		case COMPRESSION_DEFLATE:
+			bResult = DecodeDeflate(src, src_size, dst, dst_size);
+			break;
+		case COMPRESSION_PACKBITS:
+			bResult = DecodePackBits(src, src_size, dst, dst_size);
+			break;
+	}
+	if(!bResult) {
+		return FALSE;
+	}
+
+	if(decoder->swab) {
+		switch(decoder->bitspersample) {
+			case 16:
+				TIFFSwabArrayOfShort((uint16*)dst, dst_size / 2);
+				break;
+			case 32:
+				TIFFSwabArrayOfLong((uint32*)dst, dst_size / 4);
+				break;
+			case 64:
+				TIFFSwabArrayOfDouble((double*)dst, dst_size / 8);
+				break;
+		}
+	}
+
+	if(decoder->predictor) {
+		const unsigned Bps = decoder->bitspersample / 8;
+		const tmsize_t count = decoder->row_size / Bps;
+		for(BYTE *row = dst; row < dst + dst_size; row += decoder->row_size) {
+			switch(Bps) {
+				case 1:
+					AccumulateRow<BYTE>(row, count, decoder->stride);
+					break;
+				case 2:
+					AccumulateRow<uint16>((uint16*)row, count, decoder->stride);
+					break;
+				case 4:
+					AccumulateRow<uint32>((uint32*)row, count, decoder->stride);
+					break;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+Check that the strips or the tiles of the current directory can be decoded in parallel
+@param tif TIFF handle
+@param row_size Size of a decoded row (scanline or tile row)
+@param decoder Receives the chunk layout
+@return Returns FALSE if the image must be read with LibTIFF
+*/
+static BOOL
+GetChunkDecoder(TIFF *tif, tmsize_t row_size, ChunkDecoder *decoder) {
+	uint16 compression = COMPRESSION_NONE;
+	uint16 bitspersample = 1;
+	uint16 samplesperpixel = 1;
+	uint16 planar_config = PLANARCONFIG_CONTIG;
+	uint16 fillorder = FILLORDER_MSB2LSB;
+	uint16 predictor = PREDICTOR_NONE;
+	uint16 photometric = PHOTOMETRIC_MINISWHITE;
+
+	if(ParallelGetThreadCount() < 2) {
+		return FALSE;
+	}
+
+	TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &compression);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bitspersample);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesperpixel);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar_config);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_FILLORDER, &fillorder);
+	TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric);
+
+	switch(compression) {
+		case COMPRESSION_LZW:
+		case COMPRESSION_ADOBE_DEFLATE:
+		case COMPRESSION_DEFLATE:
+			// the predictor tag is only known to these codecs
+			TIFFGetField(tif, TIFFTAG_PREDICTOR, &predictor);
+			break;
+		case COMPRESSION_PACKBITS:
+			break;
+		default:
+			return FALSE;
+	}
+	// subsampled YCbCr strips are not made of whole scanlines
+	if((planar_config != PLANARCONFIG_CONTIG) || (fillorder != FILLORDER_MSB2LSB) || (photometric == PHOTOMETRIC_YCBCR) || (row_size <= 0)) {
+		return FALSE;
+	}
+
+	decoder->compression = compression;
+	decoder->bitspersample = bitspersample;
+	decoder->stride = samplesperpixel;
+	decoder->row_size = row_size;
+
+	// horizontal differencing of 8-, 16- and 32-bit samples
+	if(predictor == PREDICTOR_HORIZONTAL) {
+		if((bitspersample != 8) && (bitspersample != 16) && (bitspersample != 32)) {
+			return FALSE;
+		}
+		decoder->predictor = TRUE;
+	} else if(predictor == PREDICTOR_NONE) {
+		decoder->predictor = FALSE;
+	} else {
+		return FALSE;
+	}
+
+	// byte swapping of 16-, 32- and 64-bit samples
+	decoder->swab = FALSE;
+	if(TIFFIsByteSwapped(tif)) {
+		if(bitspersample == 24) {
+			return FALSE;
+		}
+		decoder->swab = (bitspersample == 16) || (bitspersample == 32) || (bitspersample == 64);
+	}
+
+	return TRUE;
+}
+
+/**
+Get the size of the raw data of a strip or a tile, without the errors of TIFFRawStripSize64
+*/
+static uint64
+GetRawChunkSize(TIFF *tif, uint32 chunk) {
+	if(!_TIFFFillStriles(tif) || !tif->tif_dir.td_stripbytecount || (chunk >= tif->tif_dir.td_nstrips)) {
+		return 0;
+	}
+	return tif->tif_dir.td_stripbytecount[chunk];
+}
+
+/**
+Decode a set of strips or tiles on the worker pool.<br>
+The raw chunks are read on the calling thread, then each chunk is decoded and 
+passed to store(chunk_index, data), concurrently for different chunks.
+@param decoder Chunk layout
+@param count Number of chunks
+@param read_raw Function object reading the raw chunk i: read_raw(i, buffer, size), returns the size read or -1
+@param raw_size Function object returning the raw size of the chunk i
+@param chunk_size Function object returning the decoded size of the chunk i
+@param store Function object storing the decoded chunk i: store(i, data)
+@return Returns FALSE if a chunk could not be decoded: the image must then be read with LibTIFF
+*/
+template <class ReadRaw, class RawSize, class ChunkSize, class Store> static BOOL
+DecodeChunksParallel(const ChunkDecoder *decoder, uint32 count, ReadRaw read_raw, RawSize raw_size, ChunkSize chunk_size, Store store) {
+	if(count < 2) {
+		return FALSE;
+	}
+
+	// read the raw chunks into a single buffer
+
+	std::vector<size_t> offsets(count + 1, 0);
+	tmsize_t max_chunk_size = 0;
+	for(uint32 i = 0; i < count; i++) {
+		const uint64 size = raw_size(i);
+		const tmsize_t decoded_size = chunk_size(i);
+		// reject missing chunks and sizes that would not be valid compressed data
+		if((size == 0) || (decoded_size <= 0) || (size > 2 * (uint64)decoded_size + 1024)) {
+			return FALSE;
+		}
+		if((uint64)offsets[i] + size > (uint64)(((size_t)-1) / 2)) {
+			return FALSE;
+		}
+		offsets[i + 1] = offsets[i] + (size_t)size;
+		max_chunk_size = MAX(max_chunk_size, decoded_size);
+	}
+
+	BYTE *raw = (BYTE*)malloc(offsets[count]);
+	if(!raw) {
+		return FALSE;
+	}
+	for(uint32 i = 0; i < count; i++) {
+		const tmsize_t size = (tmsize_t)(offsets[i + 1] - offsets[i]);
+		if(read_raw(i, raw + offsets[i], size) != size) {
+			free(raw);
+			return FALSE;
+		}
+	}
+
+	// decode the chunks, at least 64 KB per band
+
+	std::vector<BOOL> decoded(count, FALSE);
+	const unsigned grain = (unsigned)MAX<tmsize_t>(1, (64 * 1024) / max_chunk_size);
+
+	ParallelFor(0, count, grain, [&](unsigned first, unsigned last) {
+		BYTE *buffer = (BYTE*)malloc(max_chunk_size);
+		if(buffer) {
+			for(unsigned i = first; i < last; i++) {
+				const tmsize_t size = chunk_size(i);
+				decoded[i] = DecodeChunk(decoder, raw + offsets[i], (tmsize_t)(offsets[i + 1] - offsets[i]), buffer, size);
+				if(decoded[i]) {
+					store(i, buffer);
+				}
+			}
+			free(buffer);
+		}
+	});
+
+	free(raw);
+
+	for(uint32 i = 0; i < count; i++) {
+		if(!decoded[i]) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+Decode the strips of a PLANARCONFIG_CONTIG image on the worker pool
+@param tif TIFF handle
+@param height Image height
+@param rowsperstrip Number of rows per strip
+@param store Function object storing a strip: store(strip_data, first_row, rows)
+@return Returns FALSE if the strips must be read with TIFFReadEncodedStrip
+*/
+template <class Store> static BOOL
+ReadStripsParallel(TIFF *tif, uint32 height, uint32 rowsperstrip, Store store) {
+	ChunkDecoder decoder;
+	if((height == 0) || (rowsperstrip == 0) || !GetChunkDecoder(tif, TIFFScanlineSize(tif), &decoder)) {
+		return FALSE;
+	}
+
+	const uint32 strip_rows = MIN(rowsperstrip, height);
+	const uint32 count = (uint32)(((uint64)height + strip_rows - 1) / strip_rows);
+	if(count > TIFFNumberOfStrips(tif)) {
+		return FALSE;
+	}
+
+	return DecodeChunksParallel(&decoder, count, 
+		[&](uint32 i, BYTE *buffer, tmsize_t size) { return TIFFReadRawStrip(tif, i, buffer, size); },
+		[&](uint32 i) { return GetRawChunkSize(tif, i); },
+		[&](uint32 i) { return TIFFVStripSize(tif, MIN(strip_rows, height - i * strip_rows)); },
+		[&](uint32 i, const BYTE *data) { store(data, i * strip_rows, (int32)MIN(strip_rows, height - i * strip_rows)); });
+}
+
+/**
+Decode the tiles of a PLANARCONFIG_CONTIG image on the worker pool
+@param tif TIFF handle
+@param width Image width
+@param height Image height
+@param tileWidth Tile width
+@param tileHeight Tile height
+@param store Function object storing a tile: store(tile_data, x, y)
+@return Returns FALSE if the tiles must be read with TIFFReadTile
+*/
+template <class Store> static BOOL
+ReadTilesParallel(TIFF *tif, uint32 width, uint32 height, uint32 tileWidth, uint32 tileHeight, Store store) {
+	ChunkDecoder decoder;
+	if((width == 0) || (height == 0) || (tileWidth == 0) || (tileHeight == 0) || !GetChunkDecoder(tif, TIFFTileRowSize(tif), &decoder)) {
+		return FALSE;
+	}
+
+	const uint32 across = (uint32)(((uint64)width + tileWidth - 1) / tileWidth);
+	const uint32 down = (uint32)(((uint64)height + tileHeight - 1) / tileHeight);
+	if((uint64)across * down > TIFFNumberOfTiles(tif)) {
+		return FALSE;
+	}
+	const tmsize_t tileSize = TIFFTileSize(tif);
+
+	return DecodeChunksParallel(&decoder, across * down, 
+		[&](uint32 i, BYTE *buffer, tmsize_t size) { return TIFFReadRawTile(tif, TIFFComputeTile(tif, (i % across) * tileWidth, (i / across) * tileHeight, 0, 0), buffer, size); },
+		[&](uint32 i) { return GetRawChunkSize(tif, TIFFComputeTile(tif, (i % across) * tileWidth, (i / across) * tileHeight, 0, 0)); },
+		[&](uint32) { return tileSize; },
+		[&](uint32 i, const BYTE *data) { store(data, (i % across) * tileWidth, (i / across) * tileHeight); });
+}
+
 // ==========================================================
 // TIFF thumbnail routines
 // ==========================================================
@@ -1886,32 +2425,42 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				
 				if(planar_config == PLANARCONFIG_CONTIG) {
 
-					for (uint32 y = 0; y < height; y += rowsperstrip) {
-						int32 strips = (y + rowsperstrip > height ? height - y : rowsperstrip);
-
-						if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf, strips * src_line) == -1) {
-							// ignore errors as they can be frequent and not really valid errors, especially with fax images
-							bThrowMessage = TRUE;							
-							/*
-							free(buf);
-							throw FI_MSG_ERROR_PARSING;
-							*/
-						} 
+					// copy the rows of a strip starting at row y
+					auto store_strip = [&](const BYTE *strip, uint32 y, int32 strips) {
+						BYTE *dst_bits = FreeImage_GetScanLine(dib, height - 1 - y);
 						if(src_line == dst_line) {
 							// channel count match
 							for (int l = 0; l < strips; l++) {							
-								memcpy(bits, buf + l * src_line, src_line);
-								bits -= dst_pitch;
+								memcpy(dst_bits, strip + l * src_line, src_line);
+								dst_bits -= dst_pitch;
 							}
 						}
 						else {
 							for (int l = 0; l < strips; l++) {
-								for(BYTE *pixel = bits, *src_pixel =  buf + l * src_line; pixel < bits + dst_pitch; pixel += Bpp, src_pixel += srcBpp) {
+								const BYTE *src_pixel = strip + l * src_line;
+								for(BYTE *pixel = dst_bits; pixel < dst_bits + dst_pitch; pixel += Bpp, src_pixel += srcBpp) {
 									AssignPixel(pixel, src_pixel, Bpp);
 								}
-								bits -= dst_pitch;
+								dst_bits -= dst_pitch;
 							}
 						}
+					};
+
+					// LZW, Deflate and PackBits strips are decoded on the worker pool
+					if(!ReadStripsParallel(tif, height, rowsperstrip, store_strip)) {
+						for (uint32 y = 0; y < height; y += rowsperstrip) {
+							int32 strips = (y + rowsperstrip > height ? height - y : rowsperstrip);
+
+							if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf, strips * src_line) == -1) {
+								// ignore errors as they can be frequent and not really valid errors, especially with fax images
+								bThrowMessage = TRUE;							
+								/*
+								free(buf);
+								throw FI_MSG_ERROR_PARSING;
+								*/
+							} 
+							store_strip(buf, y, strips);
+						}
 					}
 				}
 				else if(planar_config == PLANARCONFIG_SEPARATE) {
@@ -1982,7 +2531,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			// ---------------------------------------------------------------------------------
 
 			uint32 tileWidth, tileHeight;
-			uint32 src_line = 0;
 
 			// create a new DIB
 			dib = CreateImageType( header_only, image_type, width, height, bitspersample, samplesperpixel);
@@ -2025,35 +2573,35 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				// In the tiff file the lines are saved from up to down 
 				// In a DIB the lines must be saved from down to up
 
-				BYTE *bits = FreeImage_GetScanLine(dib, height - 1);
-				
-				for (uint32 y = 0; y < height; y += tileHeight) {						
-					int32 nrows = (y + tileHeight > height ? height - y : tileHeight);					
-
-					for (uint32 x = 0, rowSize = 0; x < width; x += tileWidth, rowSize += tileRowSize) {
-						memset(tileBuffer, 0, tileSize);
-
-						// read one tile
-						if (TIFFReadTile(tif, tileBuffer, x, y, 0, 0) < 0) {
-							free(tileBuffer);
-							throw "Corrupted tiled TIFF file";
-						}
-						// convert to strip
-						if(x + tileWidth > width) {
-							src_line = imageRowSize - rowSize;
-						} else {
-							src_line = tileRowSize;
-						}
-						BYTE *src_bits = tileBuffer;
-						BYTE *dst_bits = bits + rowSize;
-						for(int k = 0; k < nrows; k++) {
-							memcpy(dst_bits, src_bits, src_line);
-							src_bits += tileRowSize;
-							dst_bits -= dst_pitch;
+				// copy the rows of the tile at (x, y)
+				auto store_tile = [&](const BYTE *tile, uint32 x, uint32 y) {
+					const int32 nrows = (y + tileHeight > height ? height - y : tileHeight);
+					const uint32 rowSize = (x / tileWidth) * tileRowSize;
+					// convert to strip
+					const uint32 tile_line = (x + tileWidth > width) ? imageRowSize - rowSize : tileRowSize;
+					const BYTE *src_bits = tile;
+					BYTE *dst_bits = FreeImage_GetScanLine(dib, height - 1 - y) + rowSize;
+					for(int k = 0; k < nrows; k++) {
+						memcpy(dst_bits, src_bits, tile_line);
+						src_bits += tileRowSize;
+						dst_bits -= dst_pitch;
+					}
+				};
+
+				// LZW, Deflate and PackBits tiles are decoded on the worker pool
+				if(!ReadTilesParallel(tif, width, height, tileWidth, tileHeight, store_tile)) {
+					for (uint32 y = 0; y < height; y += tileHeight) {						
+						for (uint32 x = 0; x < width; x += tileWidth) {
+							memset(tileBuffer, 0, tileSize);
+
+							// read one tile
+							if (TIFFReadTile(tif, tileBuffer, x, y, 0, 0) < 0) {
+								free(tileBuffer);
+								throw "Corrupted tiled TIFF file";
+							}
+							store_tile(tileBuffer, x, y);
 						}
 					}
-
-					bits -= nrows * dst_pitch;
 				}
 
 #if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
@@ -2170,18 +2718,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						} 
 
 						// convert from half (16-bit) to float (32-bit)
-						// !!! use OpenEXR half helper class
-
-						half half_value;
 
 						for (uint32 l = 0; l < nrow; l++) {
-							WORD *src_pixel = (WORD*)(buf + l * src_line);
+							const WORD *src_pixel = (WORD*)(buf + l * src_line);
 							float *dst_pixel = (float*)bits;
 
-							for(tmsize_t x = 0; x < (tmsize_t)(src_line / sizeof(WORD)); x++) {
-								half_value.setBits(src_pixel[x]);
-								dst_pixel[x] = half_value;
-							}
+							FreeImage_ConvertLineHalfToFloat(dst_pixel, src_pixel, (int)(src_line / sizeof(WORD)));
 
 							bits -= dst_pitch;
 						}
@@ -2235,331 +2777,300 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 // --------------------------------------------------------------------------
 
-static BOOL 
-SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data, unsigned ifd, unsigned ifdCount) {
-	if (!dib || !handle || !data) {
-		return FALSE;
-	} 
-	
-	try { 
-		fi_TIFFIO *fio = (fi_TIFFIO*)data;
-		TIFF *out = fio->tif;
-
-		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
-
-		const uint32 width = FreeImage_GetWidth(dib);
-		const uint32 height = FreeImage_GetHeight(dib);
-		const uint16 bitsperpixel = (uint16)FreeImage_GetBPP(dib);
+/**
+Set the tags of the current directory from the dib header data
+@param out TIFF handle
+@param dib Image to be saved (its pixels are not used)
+@param page Page number, or -1 for a single page
+@param flags Save flags
+@param ifd Index of the directory (0 for the image, 1 for its thumbnail)
+@param ifdCount Number of directories written for the image
+@param photometric_out Returned photometric interpretation
+@param samplesperpixel_out Returned number of samples per pixel
+*/
+static void 
+WriteHeader(TIFF *out, FIBITMAP *dib, int page, int flags, unsigned ifd, unsigned ifdCount, uint16 *photometric_out, uint16 *samplesperpixel_out) {
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 
-		const FIICCPROFILE* iccProfile = FreeImage_GetICCProfile(dib);
-		
-		// setup out-variables based on dib and flag options
-		
-		uint16 bitspersample;
-		uint16 samplesperpixel;
-		uint16 photometric;
+	const uint32 width = FreeImage_GetWidth(dib);
+	const uint32 height = FreeImage_GetHeight(dib);
+	const uint16 bitsperpixel = (uint16)FreeImage_GetBPP(dib);
 
-		if(image_type == FIT_BITMAP) {
-			// standard image: 1-, 4-, 8-, 16-, 24-, 32-bit
+	const FIICCPROFILE* iccProfile = FreeImage_GetICCProfile(dib);
+	
+	// setup out-variables based on dib and flag options
+	
+	uint16 bitspersample;
+	uint16 samplesperpixel;
+	uint16 photometric;
 
-			samplesperpixel = ((bitsperpixel == 24) ? 3 : ((bitsperpixel == 32) ? 4 : 1));
-			bitspersample = bitsperpixel / samplesperpixel;
-			photometric	= GetPhotometric(dib);
+	if(image_type == FIT_BITMAP) {
+		// standard image: 1-, 4-, 8-, 16-, 24-, 32-bit
 
-			if((bitsperpixel == 8) && FreeImage_IsTransparent(dib)) {
-				// 8-bit transparent picture : convert later to 8-bit + 8-bit alpha
-				samplesperpixel = 2;
-				bitspersample = 8;
-			}
-			else if(bitsperpixel == 32) {
-				// 32-bit images : check for CMYK or alpha transparency
-
-				if((((iccProfile->flags & FIICC_COLOR_IS_CMYK) == FIICC_COLOR_IS_CMYK) || ((flags & TIFF_CMYK) == TIFF_CMYK))) {
-					// CMYK support
-					photometric = PHOTOMETRIC_SEPARATED;
-					TIFFSetField(out, TIFFTAG_INKSET, INKSET_CMYK);
-					TIFFSetField(out, TIFFTAG_NUMBEROFINKS, 4);
-				}
-				else if(photometric == PHOTOMETRIC_RGB) {
-					// transparency mask support
-					uint16 sampleinfo[1]; 
-					// unassociated alpha data is transparency information
-					sampleinfo[0] = EXTRASAMPLE_UNASSALPHA;
-					TIFFSetField(out, TIFFTAG_EXTRASAMPLES, 1, sampleinfo);
-				}
-			}
-		} else if(image_type == FIT_RGB16) {
-			// 48-bit RGB
+		samplesperpixel = ((bitsperpixel == 24) ? 3 : ((bitsperpixel == 32) ? 4 : 1));
+		bitspersample = bitsperpixel / samplesperpixel;
+		photometric	= GetPhotometric(dib);
 
-			samplesperpixel = 3;
-			bitspersample = bitsperpixel / samplesperpixel;
-			photometric	= PHOTOMETRIC_RGB;
-		} else if(image_type == FIT_RGBA16) {
-			// 64-bit RGBA
+		if((bitsperpixel == 8) && FreeImage_IsTransparent(dib)) {
+			// 8-bit transparent picture : convert later to 8-bit + 8-bit alpha
+			samplesperpixel = 2;
+			bitspersample = 8;
+		}
+		else if(bitsperpixel == 32) {
+			// 32-bit images : check for CMYK or alpha transparency
 
-			samplesperpixel = 4;
-			bitspersample = bitsperpixel / samplesperpixel;
 			if((((iccProfile->flags & FIICC_COLOR_IS_CMYK) == FIICC_COLOR_IS_CMYK) || ((flags & TIFF_CMYK) == TIFF_CMYK))) {
 				// CMYK support
 				photometric = PHOTOMETRIC_SEPARATED;
 				TIFFSetField(out, TIFFTAG_INKSET, INKSET_CMYK);
 				TIFFSetField(out, TIFFTAG_NUMBEROFINKS, 4);
 			}
-			else {
-				photometric	= PHOTOMETRIC_RGB;
+			else if(photometric == PHOTOMETRIC_RGB) {
 				// transparency mask support
 				uint16 sampleinfo[1]; 
 				// unassociated alpha data is transparency information
 				sampleinfo[0] = EXTRASAMPLE_UNASSALPHA;
 				TIFFSetField(out, TIFFTAG_EXTRASAMPLES, 1, sampleinfo);
 			}
-		} else if(image_type == FIT_RGBF) {
-			// 96-bit RGBF => store with a LogLuv encoding ?
-
-			samplesperpixel = 3;
-			bitspersample = bitsperpixel / samplesperpixel;
-			// the library converts to and from floating-point XYZ CIE values
-			if((flags & TIFF_LOGLUV) == TIFF_LOGLUV) {
-				photometric	= PHOTOMETRIC_LOGLUV;
-				TIFFSetField(out, TIFFTAG_SGILOGDATAFMT, SGILOGDATAFMT_FLOAT);
-				// TIFFSetField(out, TIFFTAG_STONITS, 1.0);   // assume unknown 
-			}
-			else {
-				// store with default compression (LZW) or with input compression flag
-				photometric	= PHOTOMETRIC_RGB;
-			}
-			
-		} else if (image_type == FIT_RGBAF) {
-			// 128-bit RGBAF => store with default compression (LZW) or with input compression flag
-			
-			samplesperpixel = 4;
-			bitspersample = bitsperpixel / samplesperpixel;
+		}
+	} else if(image_type == FIT_RGB16) {
+		// 48-bit RGB
+
+		samplesperpixel = 3;
+		bitspersample = bitsperpixel / samplesperpixel;
+		photometric	= PHOTOMETRIC_RGB;
+	} else if(image_type == FIT_RGBA16) {
+		// 64-bit RGBA
+
+		samplesperpixel = 4;
+		bitspersample = bitsperpixel / samplesperpixel;
+		if((((iccProfile->flags & FIICC_COLOR_IS_CMYK) == FIICC_COLOR_IS_CMYK) || ((flags & TIFF_CMYK) == TIFF_CMYK))) {
+			// CMYK support
+			photometric = PHOTOMETRIC_SEPARATED;
+			TIFFSetField(out, TIFFTAG_INKSET, INKSET_CMYK);
+			TIFFSetField(out, TIFFTAG_NUMBEROFINKS, 4);
+		}
+		else {
 			photometric	= PHOTOMETRIC_RGB;
-		} else {
-			// special image type (int, long, double, ...)
-			
-			samplesperpixel = 1;
-			bitspersample = bitsperpixel;
-			photometric	= PHOTOMETRIC_MINISBLACK;
+			// transparency mask support
+			uint16 sampleinfo[1]; 
+			// unassociated alpha data is transparency information
+			sampleinfo[0] = EXTRASAMPLE_UNASSALPHA;
+			TIFFSetField(out, TIFFTAG_EXTRASAMPLES, 1, sampleinfo);
 		}
-
-		// set image data type
-
-		WriteImageType(out, image_type);
-		
-		// write possible ICC profile
-
-		if (iccProfile->size && iccProfile->data) {
-			TIFFSetField(out, TIFFTAG_ICCPROFILE, iccProfile->size, iccProfile->data);
+	} else if(image_type == FIT_RGBF) {
+		// 96-bit RGBF => store with a LogLuv encoding ?
+
+		samplesperpixel = 3;
+		bitspersample = bitsperpixel / samplesperpixel;
+		// the library converts to and from floating-point XYZ CIE values
+		if((flags & TIFF_LOGLUV) == TIFF_LOGLUV) {
+			photometric	= PHOTOMETRIC_LOGLUV;
+			TIFFSetField(out, TIFFTAG_SGILOGDATAFMT, SGILOGDATAFMT_FLOAT);
+			// TIFFSetField(out, TIFFTAG_STONITS, 1.0);   // assume unknown 
 		}
+		else {
+			// store with default compression (LZW) or with input compression flag
+			photometric	= PHOTOMETRIC_RGB;
+		}
+		
+	} else if (image_type == FIT_RGBAF) {
+		// 128-bit RGBAF => store with default compression (LZW) or with input compression flag
+		
+		samplesperpixel = 4;
+		bitspersample = bitsperpixel / samplesperpixel;
+		photometric	= PHOTOMETRIC_RGB;
+	} else {
+		// special image type (int, long, double, ...)
+		
+		samplesperpixel = 1;
+		bitspersample = bitsperpixel;
+		photometric	= PHOTOMETRIC_MINISBLACK;
+	}
 
-		// handle standard width/height/bpp stuff
+	// set image data type
 
-		TIFFSetField(out, TIFFTAG_IMAGEWIDTH, width);
-		TIFFSetField(out, TIFFTAG_IMAGELENGTH, height);
-		TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, samplesperpixel);
-		TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, bitspersample);
-		TIFFSetField(out, TIFFTAG_PHOTOMETRIC, photometric);
-		TIFFSetField(out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);	// single image plane 
-		TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-		TIFFSetField(out, TIFFTAG_FILLORDER, FILLORDER_MSB2LSB);
-		TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(out, (uint32) -1)); 
+	WriteImageType(out, image_type);
+	
+	// write possible ICC profile
 
-		// handle metrics
+	if (iccProfile->size && iccProfile->data) {
+		TIFFSetField(out, TIFFTAG_ICCPROFILE, iccProfile->size, iccProfile->data);
+	}
 
-		WriteResolution(out, dib);
+	// handle standard width/height/bpp stuff
 
-		// multi-paging
+	TIFFSetField(out, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(out, TIFFTAG_IMAGELENGTH, height);
+	TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, samplesperpixel);
+	TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, bitspersample);
+	TIFFSetField(out, TIFFTAG_PHOTOMETRIC, photometric);
+	TIFFSetField(out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);	// single image plane 
+	TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+	TIFFSetField(out, TIFFTAG_FILLORDER, FILLORDER_MSB2LSB);
+	TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(out, (uint32) -1)); 
 
-		if (page >= 0) {
-			char page_number[20];
-			sprintf(page_number, "Page %d", page);
+	// handle metrics
 
-			TIFFSetField(out, TIFFTAG_SUBFILETYPE, (uint32)FILETYPE_PAGE);
-			TIFFSetField(out, TIFFTAG_PAGENUMBER, (uint16)page, (uint16)0);
-			TIFFSetField(out, TIFFTAG_PAGENAME, page_number);
+	WriteResolution(out, dib);
 
-		} else {
-			// is it a thumbnail ? 
-			TIFFSetField(out, TIFFTAG_SUBFILETYPE, (ifd == 0) ? (uint32)0 : (uint32)FILETYPE_REDUCEDIMAGE);
-		}
+	// multi-paging
 
-		// palettes (image colormaps are automatically scaled to 16-bits)
+	if (page >= 0) {
+		char page_number[20];
+		sprintf(page_number, "Page %d", page);
 
-		if (photometric == PHOTOMETRIC_PALETTE) {
-			uint16 *r, *g, *b;
-			uint16 nColors = (uint16)FreeImage_GetColorsUsed(dib);
-			RGBQUAD *pal = FreeImage_GetPalette(dib);
+		TIFFSetField(out, TIFFTAG_SUBFILETYPE, (uint32)FILETYPE_PAGE);
+		TIFFSetField(out, TIFFTAG_PAGENUMBER, (uint16)page, (uint16)0);
+		TIFFSetField(out, TIFFTAG_PAGENAME, page_number);
 
-			r = (uint16 *) _TIFFmalloc(sizeof(uint16) * 3 * nColors);
-			if(r == NULL) {
-				throw FI_MSG_ERROR_MEMORY;
-			}
-			g = r + nColors;
-			b = g + nColors;
+	} else {
+		// is it a thumbnail ? 
+		TIFFSetField(out, TIFFTAG_SUBFILETYPE, (ifd == 0) ? (uint32)0 : (uint32)FILETYPE_REDUCEDIMAGE);
+	}
 
-			for (int i = nColors - 1; i >= 0; i--) {
-				r[i] = SCALE((uint16)pal[i].rgbRed);
-				g[i] = SCALE((uint16)pal[i].rgbGreen);
-				b[i] = SCALE((uint16)pal[i].rgbBlue);
-			}
+	// palettes (image colormaps are automatically scaled to 16-bits)
 
-			TIFFSetField(out, TIFFTAG_COLORMAP, r, g, b);
+	if (photometric == PHOTOMETRIC_PALETTE) {
+		uint16 *r, *g, *b;
+		uint16 nColors = (uint16)FreeImage_GetColorsUsed(dib);
+		RGBQUAD *pal = FreeImage_GetPalette(dib);
 
-			_TIFFfree(r);
+		r = (uint16 *) _TIFFmalloc(sizeof(uint16) * 3 * nColors);
+		if(r == NULL) {
+			throw FI_MSG_ERROR_MEMORY;
 		}
+		g = r + nColors;
+		b = g + nColors;
 
-		// compression tag
+		for (int i = nColors - 1; i >= 0; i--) {
+			r[i] = SCALE((uint16)pal[i].rgbRed);
+			g[i] = SCALE((uint16)pal[i].rgbGreen);
+			b[i] = SCALE((uint16)pal[i].rgbBlue);
+		}
 
-		WriteCompression(out, bitspersample, samplesperpixel, photometric, flags);
+		TIFFSetField(out, TIFFTAG_COLORMAP, r, g, b);
 
-		// metadata
+		_TIFFfree(r);
+	}
 
-		WriteMetadata(out, dib);
+	// compression tag
 
-		// thumbnail tag
+	WriteCompression(out, bitspersample, samplesperpixel, photometric, flags);
 
-		if((ifd == 0) && (ifdCount > 1)) {
-			uint16 nsubifd = 1;
-			uint64 subifd[1];
-			subifd[0] = 0;
-			TIFFSetField(out, TIFFTAG_SUBIFD, nsubifd, subifd);
-		}
+	// metadata
 
-		// read the DIB lines from bottom to top
-		// and save them in the TIF
-		// -------------------------------------
-		
-		const uint32 pitch = FreeImage_GetPitch(dib);
+	WriteMetadata(out, dib);
 
-		if(image_type == FIT_BITMAP) {
-			// standard bitmap type
-		
-			switch(bitsperpixel) {
-				case 1 :
-				case 4 :
-				case 8 :
-				{
-					if((bitsperpixel == 8) && FreeImage_IsTransparent(dib)) {
-						// 8-bit transparent picture : convert to 8-bit + 8-bit alpha
-
-						// get the transparency table
-						BYTE *trns = FreeImage_GetTransparencyTable(dib);
-
-						BYTE *buffer = (BYTE *)malloc(2 * width * sizeof(BYTE));
-						if(buffer == NULL) {
-							throw FI_MSG_ERROR_MEMORY;
-						}
+	// thumbnail tag
 
-						for (int y = height - 1; y >= 0; y--) {
-							BYTE *bits = FreeImage_GetScanLine(dib, y);
+	if((ifd == 0) && (ifdCount > 1)) {
+		uint16 nsubifd = 1;
+		uint64 subifd[1];
+		subifd[0] = 0;
+		TIFFSetField(out, TIFFTAG_SUBIFD, nsubifd, subifd);
+	}
 
-							BYTE *p = bits, *b = buffer;
+	*photometric_out = photometric;
+	*samplesperpixel_out = samplesperpixel;
+}
 
-							for(uint32 x = 0; x < width; x++) {
-								// copy the 8-bit layer
-								b[0] = *p;
-								// convert the trns table to a 8-bit alpha layer
-								b[1] = trns[ b[0] ];
+/**
+Convert a dib scanline to the TIFF layout
+@param target Output buffer, at least MAX(line, 2 * width) bytes
+@param source Dib scanline
+@param dib Image to be saved (its pixels are not used)
+@param photometric Photometric interpretation returned by WriteHeader
+@param samplesperpixel Number of samples per pixel returned by WriteHeader
+@param flags Save flags
+*/
+static void 
+ConvertScanline(BYTE *target, BYTE *source, FIBITMAP *dib, uint16 photometric, uint16 samplesperpixel, int flags) {
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const uint32 width = FreeImage_GetWidth(dib);
+	const unsigned bitsperpixel = FreeImage_GetBPP(dib);
 
-								p++;
-								b += samplesperpixel;
-							}
+	if((image_type == FIT_BITMAP) && (bitsperpixel == 8) && FreeImage_IsTransparent(dib)) {
+		// 8-bit transparent picture : convert to 8-bit + 8-bit alpha
 
-							// write the scanline to disc
+		// get the transparency table
+		BYTE *trns = FreeImage_GetTransparencyTable(dib);
 
-							TIFFWriteScanline(out, buffer, height - y - 1, 0);
-						}
+		BYTE *p = source, *b = target;
 
-						free(buffer);
-					}
-					else {
-						// other cases
-						BYTE *buffer = (BYTE *)malloc(pitch * sizeof(BYTE));
-						if(buffer == NULL) {
-							throw FI_MSG_ERROR_MEMORY;
-						}
+		for(uint32 x = 0; x < width; x++) {
+			// copy the 8-bit layer
+			b[0] = *p;
+			// convert the trns table to a 8-bit alpha layer
+			b[1] = trns[ b[0] ];
 
-						for (uint32 y = 0; y < height; y++) {
-							// get a copy of the scanline
-							memcpy(buffer, FreeImage_GetScanLine(dib, height - y - 1), pitch);
-							// write the scanline to disc
-							TIFFWriteScanline(out, buffer, y, 0);
-						}
-						free(buffer);
-					}
+			p++;
+			b += samplesperpixel;
+		}
+	}
+	else if((image_type == FIT_BITMAP) && ((bitsperpixel == 24) || (bitsperpixel == 32))) {
+		// get a copy of the scanline
 
-					break;
-				}				
+		memcpy(target, source, FreeImage_GetLine(dib));
 
-				case 24:
-				case 32:
-				{
-					BYTE *buffer = (BYTE *)malloc(pitch * sizeof(BYTE));
-					if(buffer == NULL) {
-						throw FI_MSG_ERROR_MEMORY;
-					}
-
-					for (uint32 y = 0; y < height; y++) {
-						// get a copy of the scanline
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		if (photometric != PHOTOMETRIC_SEPARATED) {
+			// TIFFs store color data RGB(A) instead of BGR(A)
 
-						memcpy(buffer, FreeImage_GetScanLine(dib, height - y - 1), pitch);
+			BYTE *pBuf = target;
 
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-						if (photometric != PHOTOMETRIC_SEPARATED) {
-							// TIFFs store color data RGB(A) instead of BGR(A)
-		
-							BYTE *pBuf = buffer;
-		
-							for (uint32 x = 0; x < width; x++) {
-								INPLACESWAP(pBuf[0], pBuf[2]);
-								pBuf += samplesperpixel;
-							}
-						}
+			for (uint32 x = 0; x < width; x++) {
+				INPLACESWAP(pBuf[0], pBuf[2]);
+				pBuf += samplesperpixel;
+			}
+		}
 #endif
-						// write the scanline to disc
+	}
+	else if(image_type == FIT_RGBF && (flags & TIFF_LOGLUV) == TIFF_LOGLUV) {
+		// RGBF image => store as XYZ using a LogLuv encoding
+		tiff_ConvertLineRGBToXYZ(target, source, width);
+	}
+	else {
+		// just dump the dib (tiff supports all dib types)
+		memcpy(target, source, FreeImage_GetLine(dib));
+	}
+}
 
-						TIFFWriteScanline(out, buffer, y, 0);
-					}
+static BOOL 
+SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data, unsigned ifd, unsigned ifdCount) {
+	if (!dib || !handle || !data) {
+		return FALSE;
+	} 
+	
+	try { 
+		fi_TIFFIO *fio = (fi_TIFFIO*)data;
+		TIFF *out = fio->tif;
 
-					free(buffer);
+		const uint32 width = FreeImage_GetWidth(dib);
+		const uint32 height = FreeImage_GetHeight(dib);
 
-					break;
-				}
-			}//< switch (bitsperpixel)
+		uint16 photometric;
+		uint16 samplesperpixel;
 
-		} else if(image_type == FIT_RGBF && (flags & TIFF_LOGLUV) == TIFF_LOGLUV) {
-			// RGBF image => store as XYZ using a LogLuv encoding
+		WriteHeader(out, dib, page, flags, ifd, ifdCount, &photometric, &samplesperpixel);
 
-			BYTE *buffer = (BYTE *)malloc(pitch * sizeof(BYTE));
-			if(buffer == NULL) {
-				throw FI_MSG_ERROR_MEMORY;
-			}
+		// read the DIB lines from bottom to top
+		// and save them in the TIF
+		// -------------------------------------
 
-			for (uint32 y = 0; y < height; y++) {
-				// get a copy of the scanline and convert from RGB to XYZ
-				tiff_ConvertLineRGBToXYZ(buffer, FreeImage_GetScanLine(dib, height - y - 1), width);
-				// write the scanline to disc
-				TIFFWriteScanline(out, buffer, y, 0);
-			}
-			free(buffer);
-		} else {
-			// just dump the dib (tiff supports all dib types)
-			
-			BYTE *buffer = (BYTE *)malloc(pitch * sizeof(BYTE));
-			if(buffer == NULL) {
-				throw FI_MSG_ERROR_MEMORY;
-			}
-			
-			for (uint32 y = 0; y < height; y++) {
-				// get a copy of the scanline
-				memcpy(buffer, FreeImage_GetScanLine(dib, height - y - 1), pitch);
-				// write the scanline to disc
-				TIFFWriteScanline(out, buffer, y, 0);
-			}
-			free(buffer);
+		BYTE *buffer = (BYTE *)malloc(MAX<unsigned>(FreeImage_GetLine(dib), 2 * width) * sizeof(BYTE));
+		if(buffer == NULL) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
+		for (uint32 y = 0; y < height; y++) {
+			ConvertScanline(buffer, FreeImage_GetScanLine(dib, height - y - 1), dib, photometric, samplesperpixel, flags);
+			// write the scanline to disc
+			TIFFWriteScanline(out, buffer, y, 0);
 		}
 
+		free(buffer);
+
 		// write out the directory tag if we wrote a page other than -1 or if we have a thumbnail to write later
 
 		if( (page >= 0) || ((ifd == 0) && (ifdCount > 1)) ) {
@@ -2600,6 +3111,256 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return bResult;
 }
 
+// ==========================================================
+//   Scanline streams
+// ==========================================================
+
+/**
+State of a scanline reader.<br>
+Only contiguous strip images read with the generic method are streamed, 
+one strip at a time. The first directory of the file is read.
+*/
+typedef struct tagScanlineReader {
+	FreeImageIO *io;
+	fi_handle handle;
+	fi_TIFFIO *fio;
+	uint32 width;
+	uint32 height;
+	uint32 rowsperstrip;
+	/// TIFF scanline size
+	tmsize_t src_line;
+	/// dib scanline size
+	unsigned dst_line;
+	/// bytes per pixel (dib, file)
+	unsigned Bpp, srcBpp;
+	/// TRUE for 24- and 32-bit bitmaps
+	BOOL swap_red_blue;
+	/// decoded strip
+	BYTE *buf;
+	/// first row of the decoded strip, or (uint32)-1
+	uint32 strip_row;
+	uint32 next_row;
+	/// TRUE once a parsing error was reported
+	BOOL bThrowMessage;
+} ScanlineReader;
+
+/**
+State of a scanline writer (single page, no thumbnail)
+*/
+typedef struct tagScanlineWriter {
+	FreeImageIO *io;
+	fi_handle handle;
+	fi_TIFFIO *fio;
+	/// image description, alive until the writer is closed
+	FIBITMAP *info;
+	uint16 photometric;
+	uint16 samplesperpixel;
+	int flags;
+	/// conversion buffer
+	BYTE *buffer;
+	uint32 next_row;
+	BOOL failed;
+} ScanlineWriter;
+
+static void * DLL_CALLCONV
+OpenScanlineReader(FreeImageIO *io, fi_handle handle, int flags, FIBITMAP **info) {
+	fi_TIFFIO *fio = (fi_TIFFIO*)Open(io, handle, TRUE);
+	if (!fio) {
+		return NULL;
+	}
+	TIFF *tif = fio->tif;
+
+	// read the header data with the regular loader
+
+	FIBITMAP *dib = Load(io, handle, -1, flags | FIF_LOAD_NOPIXELS, fio);
+	if (!dib) {
+		Close(io, handle, fio);
+		return NULL;
+	}
+
+	uint16 bitspersample = 1;
+	uint16 samplesperpixel = 1;
+	uint16 planar_config = PLANARCONFIG_CONTIG;
+	uint32 rowsperstrip = (uint32)-1;
+
+	TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesperpixel);
+	TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bitspersample);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar_config);
+
+	const FREE_IMAGE_TYPE image_type = ReadImageType(tif, bitspersample, samplesperpixel);
+
+	ScanlineReader *reader = NULL;
+
+	if ((FindLoadMethod(tif, image_type, flags) == LoadAsGenericStrip) && (planar_config == PLANARCONFIG_CONTIG)) {
+		reader = (ScanlineReader*)malloc(sizeof(ScanlineReader));
+	}
+
+	if (reader) {
+		memset(reader, 0, sizeof(ScanlineReader));
+		reader->io = io;
+		reader->handle = handle;
+		reader->fio = fio;
+		reader->width = FreeImage_GetWidth(dib);
+		reader->height = FreeImage_GetHeight(dib);
+		reader->rowsperstrip = MIN(rowsperstrip, reader->height);
+		reader->src_line = TIFFScanlineSize(tif);
+		reader->dst_line = FreeImage_GetLine(dib);
+		reader->Bpp = FreeImage_GetBPP(dib) / 8;
+		reader->srcBpp = bitspersample * samplesperpixel / 8;
+		reader->strip_row = (uint32)-1;
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		reader->swap_red_blue = (image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) >= 24);
+#endif
+		reader->buf = (BYTE*)malloc(TIFFStripSize(tif) * sizeof(BYTE));
+
+		if (!reader->buf || (reader->rowsperstrip == 0) || ((reader->src_line != (tmsize_t)reader->dst_line) && (reader->Bpp == 0))) {
+			free(reader->buf);
+			free(reader);
+			reader = NULL;
+		} else {
+			memset(reader->buf, 0, TIFFStripSize(tif) * sizeof(BYTE));
+		}
+	}
+
+	if (!reader) {
+		// other layouts are loaded as a whole by the caller
+		FreeImage_Unload(dib);
+		Close(io, handle, fio);
+		return NULL;
+	}
+
+	*info = dib;
+
+	return reader;
+}
+
+static unsigned DLL_CALLCONV
+ReadScanlines(void *data, BYTE *bits, unsigned pitch, unsigned count) {
+	ScanlineReader *reader = (ScanlineReader*)data;
+	TIFF *tif = reader->fio->tif;
+
+	unsigned lines = 0;
+
+	for (; (lines < count) && (reader->next_row < reader->height); lines++, reader->next_row++) {
+		const uint32 row = reader->next_row;
+
+		if ((reader->strip_row == (uint32)-1) || (row >= reader->strip_row + reader->rowsperstrip)) {
+			// decode the strip holding the row
+			reader->strip_row = row - (row % reader->rowsperstrip);
+			const uint32 strips = MIN(reader->rowsperstrip, reader->height - reader->strip_row);
+
+			if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, reader->strip_row, 0), reader->buf, strips * reader->src_line) == -1) {
+				// ignore errors as they can be frequent and not really valid errors, especially with fax images
+				if (!reader->bThrowMessage) {
+					FreeImage_OutputMessageProc(s_format_id, "Warning: parsing error. Image may be incomplete or contain invalid data !");
+					reader->bThrowMessage = TRUE;
+				}
+			}
+		}
+
+		BYTE *src = reader->buf + (row - reader->strip_row) * reader->src_line;
+		BYTE *dst = bits + lines * pitch;
+
+		if (reader->src_line == (tmsize_t)reader->dst_line) {
+			// channel count match
+			memcpy(dst, src, reader->dst_line);
+		} else {
+			for (BYTE *pixel = dst; pixel < dst + reader->dst_line; pixel += reader->Bpp, src += reader->srcBpp) {
+				AssignPixel(pixel, src, reader->Bpp);
+			}
+		}
+
+		if (reader->swap_red_blue) {
+			for (BYTE *pixel = dst; pixel < dst + reader->dst_line; pixel += reader->Bpp) {
+				INPLACESWAP(pixel[0], pixel[2]);
+			}
+		}
+	}
+
+	return lines;
+}
+
+static void DLL_CALLCONV
+CloseScanlineReader(void *data) {
+	ScanlineReader *reader = (ScanlineReader*)data;
+
+	Close(reader->io, reader->handle, reader->fio);
+	free(reader->buf);
+	free(reader);
+}
+
+static void * DLL_CALLCONV
+OpenScanlineWriter(FreeImageIO *io, fi_handle handle, FIBITMAP *info, int flags) {
+	ScanlineWriter *writer = (ScanlineWriter*)malloc(sizeof(ScanlineWriter));
+	if (!writer) {
+		return NULL;
+	}
+	memset(writer, 0, sizeof(ScanlineWriter));
+	writer->io = io;
+	writer->handle = handle;
+	writer->info = info;
+	writer->flags = flags;
+
+	writer->fio = (fi_TIFFIO*)Open(io, handle, FALSE);
+	if (!writer->fio) {
+		free(writer);
+		return NULL;
+	}
+
+	try {
+		WriteHeader(writer->fio->tif, info, -1, flags, 0, 1, &writer->photometric, &writer->samplesperpixel);
+
+		writer->buffer = (BYTE*)malloc(MAX<unsigned>(FreeImage_GetLine(info), 2 * FreeImage_GetWidth(info)) * sizeof(BYTE));
+		if (!writer->buffer) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
+		return writer;
+
+	} catch(const char *text) {
+		Close(io, handle, writer->fio);
+		free(writer);
+		FreeImage_OutputMessageProc(s_format_id, text);
+	}
+
+	return NULL;
+}
+
+static BOOL DLL_CALLCONV
+WriteScanlines(void *data, BYTE *bits, unsigned pitch, unsigned count) {
+	ScanlineWriter *writer = (ScanlineWriter*)data;
+
+	for (unsigned y = 0; (y < count) && !writer->failed; y++) {
+		ConvertScanline(writer->buffer, bits + y * pitch, writer->info, writer->photometric, writer->samplesperpixel, writer->flags);
+
+		if (TIFFWriteScanline(writer->fio->tif, writer->buffer, writer->next_row, 0) < 0) {
+			writer->failed = TRUE;
+		}
+		writer->next_row++;
+	}
+
+	return !writer->failed;
+}
+
+static BOOL DLL_CALLCONV
+CloseScanlineWriter(void *data) {
+	ScanlineWriter *writer = (ScanlineWriter*)data;
+
+	BOOL success = !writer->failed && (writer->next_row == FreeImage_GetHeight(writer->info));
+
+	if (success) {
+		// write the strips left in memory and the directory
+		success = TIFFFlush(writer->fio->tif) ? TRUE : FALSE;
+	}
+
+	Close(writer->io, writer->handle, writer->fio);
+	free(writer->buffer);
+	free(writer);
+
+	return success;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -2628,4 +3389,10 @@ InitTIFF(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels; 
+	plugin->open_scanline_reader_proc = OpenScanlineReader;
+	plugin->read_scanlines_proc = ReadScanlines;
+	plugin->close_scanline_reader_proc = CloseScanlineReader;
+	plugin->open_scanline_writer_proc = OpenScanlineWriter;
+	plugin->write_scanlines_proc = WriteScanlines;
+	plugin->close_scanline_writer_proc = CloseScanlineWriter;
 }
@@ -77,10 +77,13 @@ ReadString(FreeImageIO *io, fi_handle handle) {
 	return cstr;
 }
 
+/**
+Encode a number in base 92 into a caller provided buffer of 16 chars (enough for more than 64 bits)
+@return Returns a pointer to the first digit inside b92
+*/
 static char *
-Base92(unsigned int num) {
-	static char b92[16]; //enough for more then 64 bits
-	static char digit[] = " .XoO+@#$%&*=-;:>,<1234567890qwertyuipasdfghjklzxcvbnmMNBVCZASDFGHJKLPIUYTREWQ!~^/()_`'][{}|";
+Base92(unsigned int num, char *b92) {
+	static const char digit[] = " .XoO+@#$%&*=-;:>,<1234567890qwertyuipasdfghjklzxcvbnmMNBVCZASDFGHJKLPIUYTREWQ!~^/()_`'][{}|";
 	b92[15] = '\0';
 	int i = 14;
 	do {
@@ -354,6 +357,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		new_line[] = "\",\n\"",
 		footer[] = "\"\n};\n",
 		buf[256]; //256 is more then enough to sprintf 4 ints into, or the base-92 chars and #rrggbb line
+		char b92[16]; // base-92 digits of a color index
 
 		if( io->write_proc(header, (unsigned int)strlen(header), 1, handle) != 1 )
 			return FALSE;
@@ -392,7 +396,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 					line++;
 				}
 				if( color2chrs.find(u.index) == color2chrs.end() ) { //new color
-					std::string chrs(Base92(num_colors));
+					std::string chrs(Base92(num_colors, b92));
 					color2chrs[u.index] = chrs;
 					chrs2color[num_colors] = rgb;
 					num_colors++;
@@ -411,7 +415,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 		//write colors, using map of chrs->rgb
 		for(x = 0; x < num_colors; x++ ) {
-			sprintf(buf, "%*s c #%02x%02x%02x", cpp, Base92(x), chrs2color[x].r, chrs2color[x].g, chrs2color[x].b );
+			sprintf(buf, "%*s c #%02x%02x%02x", cpp, Base92(x, b92), chrs2color[x].r, chrs2color[x].g, chrs2color[x].b );
 			if( io->write_proc(buf, (unsigned int)strlen(buf), 1, handle) != 1 )
 				return FALSE;
 			if( x == num_colors - 1 ) {
@@ -0,0 +1,459 @@
+// ==========================================================
+// Scanline streaming read / write
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifdef _MSC_VER
+#pragma warning (disable : 4786) // identifier was truncated to 'number' characters
+#endif
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImageIO.h"
+#include "Plugin.h"
+
+// ----------------------------------------------------------
+//   Streaming state
+// ----------------------------------------------------------
+
+/**
+State of a scanline reader.<br>
+When the plugin cannot stream the file, the whole image is decoded
+once into 'dib' and the scanlines are served from it.
+*/
+struct SCANREADERHEADER {
+	PluginNode *node;
+	FreeImageIO io;
+	fi_handle handle;
+	/// file opened by the library, NULL when reading from a user handle
+	FILE *file;
+	/// plugin reader, NULL in fallback mode
+	void *data;
+	/// image description (header only in streaming mode)
+	FIBITMAP *info;
+	/// whole image (fallback mode only)
+	FIBITMAP *dib;
+	/// next scanline to be read, counted from the top
+	unsigned next_line;
+};
+
+/**
+State of a scanline writer.<br>
+When the plugin cannot stream the file, the scanlines are accumulated
+into 'dib' and the whole image is saved when the writer is closed.
+*/
+struct SCANWRITERHEADER {
+	PluginNode *node;
+	FreeImageIO io;
+	fi_handle handle;
+	/// file opened by the library, NULL when writing to a user handle
+	FILE *file;
+	/// plugin writer, NULL in fallback mode
+	void *data;
+	/// image description (header only)
+	FIBITMAP *info;
+	/// whole image (fallback mode only)
+	FIBITMAP *dib;
+	/// save flags (fallback mode only)
+	int flags;
+	/// next scanline to be written, counted from the top
+	unsigned next_line;
+	/// TRUE once a write failed
+	BOOL failed;
+};
+
+// ----------------------------------------------------------
+//   Internal functions
+// ----------------------------------------------------------
+
+/**
+Copy the description of an image (everything but its pixels)
+@param src Source image
+@param header_only If TRUE, do not allocate the pixels of the copy
+@return Returns the copy if successful, NULL otherwise
+*/
+static FIBITMAP*
+CloneHeader(FIBITMAP *src, BOOL header_only) {
+	FIBITMAP *dst = FreeImage_AllocateHeaderT(header_only, FreeImage_GetImageType(src),
+		FreeImage_GetWidth(src), FreeImage_GetHeight(src), FreeImage_GetBPP(src),
+		FreeImage_GetRedMask(src), FreeImage_GetGreenMask(src), FreeImage_GetBlueMask(src));
+	if (!dst) {
+		return NULL;
+	}
+
+	if (FreeImage_GetPalette(src)) {
+		memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(src), FreeImage_GetColorsUsed(src) * sizeof(RGBQUAD));
+	}
+	FreeImage_SetTransparencyTable(dst, FreeImage_GetTransparencyTable(src), FreeImage_GetTransparencyCount(src));
+	FreeImage_SetTransparent(dst, FreeImage_IsTransparent(src));
+
+	RGBQUAD bkcolor;
+	if (FreeImage_GetBackgroundColor(src, &bkcolor)) {
+		FreeImage_SetBackgroundColor(dst, &bkcolor);
+	}
+
+	FreeImage_SetDotsPerMeterX(dst, FreeImage_GetDotsPerMeterX(src));
+	FreeImage_SetDotsPerMeterY(dst, FreeImage_GetDotsPerMeterY(src));
+
+	FIICCPROFILE *icc = FreeImage_GetICCProfile(src);
+	if (icc->data) {
+		FreeImage_CreateICCProfile(dst, icc->data, icc->size);
+	}
+	FreeImage_GetICCProfile(dst)->flags = icc->flags;
+
+	FreeImage_CloneMetadata(dst, src);
+
+	return dst;
+}
+
+/**
+Open a scanline reader on an opened handle.
+If the plugin has no native reader for the file, the image is fully decoded.
+*/
+static FISCANREADER*
+OpenReader(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FILE *file, int flags) {
+	PluginNode *node = ((fif >= 0) && (fif < FreeImage_GetFIFCount())) ? FreeImage_GetPluginList()->FindNodeFromFIF(fif) : NULL;
+	if (!node) {
+		return NULL;
+	}
+
+	FISCANREADER *reader = (FISCANREADER*)malloc(sizeof(FISCANREADER));
+	SCANREADERHEADER *header = reader ? new(std::nothrow) SCANREADERHEADER : NULL;
+	if (!header) {
+		free(reader);
+		FreeImage_OutputMessageProc((int)fif, FI_MSG_ERROR_MEMORY);
+		return NULL;
+	}
+	reader->data = header;
+
+	header->node = node;
+	header->io = *io;
+	header->handle = handle;
+	header->file = file;
+	header->data = NULL;
+	header->info = NULL;
+	header->dib = NULL;
+	header->next_line = 0;
+
+	const long start = io->tell_proc(handle);
+
+	if (node->m_plugin->open_scanline_reader_proc) {
+		header->data = node->m_plugin->open_scanline_reader_proc(&header->io, handle, flags, &header->info);
+	}
+
+	if (!header->data) {
+		// the plugin cannot stream this file: decode it as a whole
+		if (header->info) {
+			FreeImage_Unload(header->info);
+			header->info = NULL;
+		}
+		io->seek_proc(handle, start, SEEK_SET);
+
+		header->dib = FreeImage_LoadFromHandle(fif, &header->io, handle, flags);
+		header->info = header->dib;
+	}
+
+	if (!header->info) {
+		delete header;
+		free(reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+/**
+Open a scanline writer on an opened handle.
+If the plugin has no native writer for the image, the scanlines are accumulated in memory.
+*/
+static FISCANWRITER*
+OpenWriter(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FILE *file, FIBITMAP *info, int flags) {
+	PluginNode *node = ((fif >= 0) && (fif < FreeImage_GetFIFCount())) ? FreeImage_GetPluginList()->FindNodeFromFIF(fif) : NULL;
+	if (!node || !info) {
+		return NULL;
+	}
+
+	FISCANWRITER *writer = (FISCANWRITER*)malloc(sizeof(FISCANWRITER));
+	SCANWRITERHEADER *header = writer ? new(std::nothrow) SCANWRITERHEADER : NULL;
+	if (!header) {
+		free(writer);
+		FreeImage_OutputMessageProc((int)fif, FI_MSG_ERROR_MEMORY);
+		return NULL;
+	}
+	writer->data = header;
+
+	header->node = node;
+	header->io = *io;
+	header->handle = handle;
+	header->file = file;
+	header->data = NULL;
+	header->dib = NULL;
+	header->flags = flags;
+	header->next_line = 0;
+	header->failed = FALSE;
+
+	// keep our own description, the caller may release 'info' at any time
+	header->info = CloneHeader(info, TRUE);
+
+	if (header->info && node->m_plugin->open_scanline_writer_proc) {
+		header->data = node->m_plugin->open_scanline_writer_proc(&header->io, handle, header->info, flags);
+	}
+
+	if (header->info && !header->data) {
+		// the plugin cannot stream this image: save it as a whole on closing
+		if (node->m_plugin->save_proc) {
+			header->dib = CloneHeader(header->info, FALSE);
+		}
+	}
+
+	if (!header->data && !header->dib) {
+		if (header->info) {
+			FreeImage_Unload(header->info);
+		}
+		delete header;
+		free(writer);
+		return NULL;
+	}
+
+	return writer;
+}
+
+// ----------------------------------------------------------
+//   Scanline reader
+// ----------------------------------------------------------
+
+FISCANREADER * DLL_CALLCONV
+FreeImage_OpenScanlineReaderFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags) {
+	if (!io || !handle) {
+		return NULL;
+	}
+	return OpenReader(fif, io, handle, NULL, flags);
+}
+
+FISCANREADER * DLL_CALLCONV
+FreeImage_OpenScanlineReader(FREE_IMAGE_FORMAT fif, const char *filename, int flags) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FILE *handle = fopen(filename, "rb");
+
+	if (handle) {
+		FISCANREADER *reader = OpenReader(fif, &io, (fi_handle)handle, handle, flags);
+		if (!reader) {
+			fclose(handle);
+		}
+		return reader;
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_OpenScanlineReader: failed to open file %s", filename);
+	}
+
+	return NULL;
+}
+
+FISCANREADER * DLL_CALLCONV
+FreeImage_OpenScanlineReaderU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags) {
+#ifdef _WIN32
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FILE *handle = _wfopen(filename, L"rb");
+
+	if (handle) {
+		FISCANREADER *reader = OpenReader(fif, &io, (fi_handle)handle, handle, flags);
+		if (!reader) {
+			fclose(handle);
+		}
+		return reader;
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_OpenScanlineReaderU: failed to open input file");
+	}
+#endif
+	return NULL;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_GetScanlineReaderInfo(FISCANREADER *reader) {
+	return reader ? ((SCANREADERHEADER*)reader->data)->info : NULL;
+}
+
+unsigned DLL_CALLCONV
+FreeImage_ReadScanlines(FISCANREADER *reader, BYTE *bits, unsigned pitch, unsigned count) {
+	if (!reader || !bits) {
+		return 0;
+	}
+
+	SCANREADERHEADER *header = (SCANREADERHEADER*)reader->data;
+
+	const unsigned height = FreeImage_GetHeight(header->info);
+	count = MIN(count, height - header->next_line);
+	if (count == 0) {
+		return 0;
+	}
+
+	unsigned lines = 0;
+
+	if (header->data) {
+		lines = header->node->m_plugin->read_scanlines_proc(header->data, bits, pitch, count);
+	} else {
+		const unsigned line = FreeImage_GetLine(header->dib);
+		for (; lines < count; lines++) {
+			memcpy(bits + lines * pitch, FreeImage_GetScanLine(header->dib, height - 1 - (header->next_line + lines)), line);
+		}
+	}
+
+	header->next_line += lines;
+
+	return lines;
+}
+
+void DLL_CALLCONV
+FreeImage_CloseScanlineReader(FISCANREADER *reader) {
+	if (!reader) {
+		return;
+	}
+
+	SCANREADERHEADER *header = (SCANREADERHEADER*)reader->data;
+
+	if (header->data) {
+		header->node->m_plugin->close_scanline_reader_proc(header->data);
+	}
+	FreeImage_Unload(header->info);
+	if (header->file) {
+		fclose(header->file);
+	}
+
+	delete header;
+	free(reader);
+}
+
+// ----------------------------------------------------------
+//   Scanline writer
+// ----------------------------------------------------------
+
+FISCANWRITER * DLL_CALLCONV
+FreeImage_OpenScanlineWriterToHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FIBITMAP *info, int flags) {
+	if (!io || !handle) {
+		return NULL;
+	}
+	return OpenWriter(fif, io, handle, NULL, info, flags);
+}
+
+FISCANWRITER * DLL_CALLCONV
+FreeImage_OpenScanlineWriter(FREE_IMAGE_FORMAT fif, const char *filename, FIBITMAP *info, int flags) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FILE *handle = fopen(filename, "w+b");
+
+	if (handle) {
+		FISCANWRITER *writer = OpenWriter(fif, &io, (fi_handle)handle, handle, info, flags);
+		if (!writer) {
+			fclose(handle);
+		}
+		return writer;
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_OpenScanlineWriter: failed to open file %s", filename);
+	}
+
+	return NULL;
+}
+
+FISCANWRITER * DLL_CALLCONV
+FreeImage_OpenScanlineWriterU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, FIBITMAP *info, int flags) {
+#ifdef _WIN32
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FILE *handle = _wfopen(filename, L"w+b");
+
+	if (handle) {
+		FISCANWRITER *writer = OpenWriter(fif, &io, (fi_handle)handle, handle, info, flags);
+		if (!writer) {
+			fclose(handle);
+		}
+		return writer;
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_OpenScanlineWriterU: failed to open output file");
+	}
+#endif
+	return NULL;
+}
+
+BOOL DLL_CALLCONV
+FreeImage_WriteScanlines(FISCANWRITER *writer, BYTE *bits, unsigned pitch, unsigned count) {
+	if (!writer || !bits) {
+		return FALSE;
+	}
+
+	SCANWRITERHEADER *header = (SCANWRITERHEADER*)writer->data;
+
+	const unsigned height = FreeImage_GetHeight(header->info);
+	if (header->failed || (count > height - header->next_line)) {
+		header->failed = TRUE;
+		return FALSE;
+	}
+
+	if (header->data) {
+		if (!header->node->m_plugin->write_scanlines_proc(header->data, bits, pitch, count)) {
+			header->failed = TRUE;
+			return FALSE;
+		}
+	} else {
+		const unsigned line = FreeImage_GetLine(header->dib);
+		for (unsigned y = 0; y < count; y++) {
+			memcpy(FreeImage_GetScanLine(header->dib, height - 1 - (header->next_line + y)), bits + y * pitch, line);
+		}
+	}
+
+	header->next_line += count;
+
+	return TRUE;
+}
+
+BOOL DLL_CALLCONV
+FreeImage_CloseScanlineWriter(FISCANWRITER *writer) {
+	if (!writer) {
+		return FALSE;
+	}
+
+	SCANWRITERHEADER *header = (SCANWRITERHEADER*)writer->data;
+
+	BOOL success = !header->failed;
+	if (success && (header->next_line < FreeImage_GetHeight(header->info))) {
+		FreeImage_OutputMessageProc(header->node->m_id, "FreeImage_CloseScanlineWriter: the image is incomplete");
+		success = FALSE;
+	}
+
+	if (header->data) {
+		// the plugin finishes the file only if all the scanlines were written
+		success = header->node->m_plugin->close_scanline_writer_proc(header->data) && success;
+	} else if (success) {
+		success = FreeImage_SaveToHandle((FREE_IMAGE_FORMAT)header->node->m_id, header->dib, &header->io, header->handle, header->flags);
+	}
+
+	if (header->dib) {
+		FreeImage_Unload(header->dib);
+	}
+	FreeImage_Unload(header->info);
+	if (header->file) {
+		fclose(header->file);
+	}
+
+	delete header;
+	free(writer);
+
+	return success;
+}
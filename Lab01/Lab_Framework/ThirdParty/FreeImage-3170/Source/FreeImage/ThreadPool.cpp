@@ -0,0 +1,253 @@
+// ==========================================================
+// Worker thread pool and parallel loops
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "ThreadPool.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+
+// ----------------------------------------------------------
+//   Worker pool
+// ----------------------------------------------------------
+
+namespace {
+
+/**
+Lazily grown set of worker threads serving a FIFO job queue.
+Workers are never shrunk: idle workers only block on a condition variable.
+They are detached and stopped by shutdown(), never joined. The pool itself 
+is never destroyed, so that no static destructor waits for a thread while 
+the library is being unloaded.
+*/
+class WorkerPool {
+public:
+	static WorkerPool& instance() {
+		static WorkerPool *s_pool = new WorkerPool;
+		return *s_pool;
+	}
+
+	/// Make sure at least 'count' workers are running
+	void reserve(unsigned count) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while(m_workers < count) {
+			std::thread(&WorkerPool::run, this).detach();
+			m_workers++;
+		}
+	}
+
+	void submit(const std::function<void()> &job) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(job);
+		}
+		m_wakeup.notify_one();
+	}
+
+	/**
+	Let the workers run the jobs left in the queue, then wait until all of them 
+	have left their loop. The pool may be used again afterwards.
+	*/
+	void shutdown() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_wakeup.notify_all();
+		m_stopped.wait(lock, [this] { return m_workers == 0; });
+		m_stop = false;
+	}
+
+private:
+	WorkerPool() : m_workers(0), m_stop(false) {}
+
+	void run() {
+		for(;;) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wakeup.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+				if(m_jobs.empty()) {
+					// m_stop is set and nothing is left to do: 
+					// from here on, the thread does not touch the pool anymore
+					m_workers--;
+					m_stopped.notify_all();
+					return;
+				}
+				job = m_jobs.front();
+				m_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+private:
+	std::deque<std::function<void()> > m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	std::condition_variable m_stopped;
+	unsigned m_workers;
+	bool m_stop;
+};
+
+/**
+State shared by all participants of a ParallelForBands call.
+Bands are claimed through an atomic counter, so a helper that is scheduled
+late simply finds nothing left to do. The caller only waits for bands that
+have actually been claimed, which makes nested parallel loops deadlock-free.
+The first exception thrown by a band is kept, the remaining bands are skipped
+and the exception is rethrown to the caller by wait().
+*/
+class ParallelJob {
+public:
+	ParallelJob(unsigned begin, unsigned count, unsigned bands, ParallelBandProc proc, void *context)
+		: m_begin(begin), m_count(count), m_bands(bands), m_proc(proc), m_context(context), m_next(0), m_done(0), m_failed(false) {
+	}
+
+	void work() {
+		for(;;) {
+			const unsigned band = m_next++;
+			if(band >= m_bands) {
+				break;
+			}
+			const unsigned first = m_begin + (unsigned)(((unsigned long long)m_count * band) / m_bands);
+			const unsigned last = m_begin + (unsigned)(((unsigned long long)m_count * (band + 1)) / m_bands);
+			if(!m_failed) {
+				try {
+					m_proc(m_context, first, last);
+				} catch(...) {
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if(!m_failed) {
+						m_error = std::current_exception();
+						m_failed = true;
+					}
+				}
+			}
+			if(++m_done == m_bands) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_finished.notify_all();
+			}
+		}
+	}
+
+	void wait() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this] { return m_done == m_bands; });
+		if(m_error) {
+			std::rethrow_exception(m_error);
+		}
+	}
+
+private:
+	const unsigned m_begin;
+	const unsigned m_count;
+	const unsigned m_bands;
+	const ParallelBandProc m_proc;
+	void * const m_context;
+	std::atomic<unsigned> m_next;
+	std::atomic<unsigned> m_done;
+	std::atomic<bool> m_failed;
+	std::exception_ptr m_error;
+	std::mutex m_mutex;
+	std::condition_variable m_finished;
+};
+
+/// Requested thread count, 0 means 'use all hardware threads'
+std::atomic<int> s_thread_count(0);
+
+} // namespace
+
+// ----------------------------------------------------------
+//   Internal API
+// ----------------------------------------------------------
+
+unsigned
+ParallelGetThreadCount() {
+	const int count = s_thread_count;
+	if(count > 0) {
+		return (unsigned)count;
+	}
+	const unsigned hardware = std::thread::hardware_concurrency();
+	return (hardware > 0) ? hardware : 1;
+}
+
+void
+ParallelForBands(unsigned begin, unsigned end, unsigned grain, ParallelBandProc proc, void *context) {
+	if(end <= begin) {
+		return;
+	}
+	const unsigned count = end - begin;
+	if(grain == 0) {
+		grain = 1;
+	}
+
+	const unsigned threads = ParallelGetThreadCount();
+	const unsigned max_bands = (count + grain - 1) / grain;
+
+	if((threads <= 1) || (max_bands <= 1)) {
+		proc(context, begin, end);
+		return;
+	}
+
+	// use a few bands per thread so that uneven bands balance out
+	const unsigned bands = MIN(max_bands, threads * 4);
+	const unsigned helpers = MIN(threads, bands) - 1;
+
+	std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>(begin, count, bands, proc, context);
+
+	WorkerPool& pool = WorkerPool::instance();
+	pool.reserve(helpers);
+	for(unsigned i = 0; i < helpers; i++) {
+		pool.submit([job] { job->work(); });
+	}
+
+	job->work();
+	job->wait();
+}
+
+void
+ParallelSubmit(ParallelTaskProc proc, void *context) {
+	const unsigned threads = ParallelGetThreadCount();
+
+	WorkerPool& pool = WorkerPool::instance();
+	pool.reserve(MAX(threads, 2U) - 1);
+	pool.submit([proc, context] { proc(context); });
+}
+
+void
+ParallelShutdown() {
+	WorkerPool::instance().shutdown();
+}
+
+// ----------------------------------------------------------
+//   Public API
+// ----------------------------------------------------------
+
+void DLL_CALLCONV
+FreeImage_SetThreadCount(int count) {
+	s_thread_count = (count > 0) ? count : 0;
+}
+
+int DLL_CALLCONV
+FreeImage_GetThreadCount() {
+	return (int)ParallelGetThreadCount();
+}
@@ -19,8 +19,41 @@
 // Use at your own risk!
 // ==========================================================
 
+#include <atomic>
+
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ToneMapping.h"
+
+/// TRUE when the operators use the approximated log, exp and pow functions
+static std::atomic<BOOL> s_fast_math(FALSE);
+
+/**
+Select the math used by the tone mapping operators. 
+The exact math (the default) relies on the C runtime and gives the same result 
+whatever the number of threads. The fast math uses polynomial approximations 
+of log, exp and pow (vectorized when SSE2 is available), with a relative error 
+around 1e-6, and may change a few output values by one level. 
+@param enable TRUE to use the fast math, FALSE to use the exact math
+*/
+void DLL_CALLCONV
+FreeImage_SetToneMappingFastMath(BOOL enable) {
+	s_fast_math = enable ? TRUE : FALSE;
+}
+
+/**
+Returns TRUE when the tone mapping operators use the fast math
+@see FreeImage_SetToneMappingFastMath
+*/
+BOOL DLL_CALLCONV
+FreeImage_GetToneMappingFastMath() {
+	return s_fast_math;
+}
+
+BOOL 
+ToneMappingFastMath() {
+	return s_fast_math;
+}
 
 /**
 Performs a tone mapping on a 48-bit RGB or a 96-bit RGBF image and returns a 24-bit image. 
@@ -33,6 +33,7 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -44,6 +45,22 @@
 
 #define MAXCOLOR	256
 
+// Minimum number of pixels per band of the histogram
+#define HIST_GRAIN	65536
+
+/**
+Partial 3D histogram, built from a band of rows.<br>
+The c^2 moments are summed as integers, so that the merged histogram 
+does not depend on the number of bands.
+*/
+typedef struct tagHistogram3D {
+	LONG wt[SIZE_3D];
+	LONG mr[SIZE_3D];
+	LONG mg[SIZE_3D];
+	LONG mb[SIZE_3D];
+	INT64 m2[SIZE_3D];
+} Histogram3D;
+
 // Constructor / Destructor
 
 WuQuantizer::WuQuantizer(FIBITMAP *dib) {
@@ -103,49 +120,58 @@ WuQuantizer::Hist3D(LONG *vwt, LONG *vmr, LONG *vmg, LONG *vmb, float *m2, int R
 	int ind = 0;
 	int inr, ing, inb, table[256];
 	int i;
-	unsigned y, x;
 
 	for(i = 0; i < 256; i++)
 		table[i] = i * i;
 
-	if (FreeImage_GetBPP(m_dib) == 24) {
-		for(y = 0; y < height; y++) {
-			BYTE *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for(x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[y*width + x] = (WORD)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 3;
+	const unsigned bytespp = FreeImage_GetBPP(m_dib) / 8;
+
+	// one partial histogram per thread, each one filled with a band of rows
+	const unsigned pixel_bands = (unsigned)MAX<UINT64>(1, ((UINT64)width * height) / HIST_GRAIN);
+	const unsigned band_count = MIN(MIN(ParallelGetThreadCount(), pixel_bands), height);
+	const unsigned band_rows = (height + band_count - 1) / band_count;
+
+	std::vector<Histogram3D> partial(band_count);
+
+	ParallelFor(0, band_count, 1, [&](unsigned first, unsigned last) {
+		for(unsigned band = first; band < last; band++) {
+			Histogram3D &hist = partial[band];
+			const unsigned y_end = MIN(height, (band + 1) * band_rows);
+
+			for(unsigned y = band * band_rows; y < y_end; y++) {
+				const BYTE *bits = FreeImage_GetScanLine(m_dib, y);
+				WORD *qadd = Qadd + y * width;
+
+				for(unsigned x = 0; x < width; x++) {
+					const int r = (bits[FI_RGBA_RED] >> 3) + 1;
+					const int g = (bits[FI_RGBA_GREEN] >> 3) + 1;
+					const int b = (bits[FI_RGBA_BLUE] >> 3) + 1;
+					const int index = INDEX(r, g, b);
+					qadd[x] = (WORD)index;
+					// [r][g][b]
+					hist.wt[index]++;
+					hist.mr[index] += bits[FI_RGBA_RED];
+					hist.mg[index] += bits[FI_RGBA_GREEN];
+					hist.mb[index] += bits[FI_RGBA_BLUE];
+					hist.m2[index] += table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]];
+					bits += bytespp;
+				}
 			}
 		}
-	} else {
-		for(y = 0; y < height; y++) {
-			BYTE *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for(x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[y*width + x] = (WORD)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 4;
-			}
+	});
+
+	// merge the partial histograms
+	for(i = 0; i < SIZE_3D; i++) {
+		INT64 sum2 = 0;
+		for(unsigned band = 0; band < band_count; band++) {
+			const Histogram3D &hist = partial[band];
+			vwt[i] += hist.wt[i];
+			vmr[i] += hist.mr[i];
+			vmg[i] += hist.mg[i];
+			vmb[i] += hist.mb[i];
+			sum2 += hist.m2[i];
 		}
+		m2[i] += (float)sum2;
 	}
 
 	if( ReserveSize > 0 ) {
@@ -536,14 +562,18 @@ WuQuantizer::Quantize(int PaletteSize, int ReserveSize, RGBQUAD *ReservePalette)
 		}
 
 		int npitch = FreeImage_GetPitch(new_dib);
+		BYTE *dst_bits = FreeImage_GetBits(new_dib);
 
-		for (unsigned y = 0; y < height; y++) {
-			BYTE *new_bits = FreeImage_GetBits(new_dib) + (y * npitch);
+		ParallelFor(0, height, MAX(1U, HIST_GRAIN / width), [=](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				BYTE *new_bits = dst_bits + (y * npitch);
+				const WORD *qadd = Qadd + y * width;
 
-			for (unsigned x = 0; x < width; x++) {
-				new_bits[x] = tag[Qadd[y*width + x]];
+				for (unsigned x = 0; x < width; x++) {
+					new_bits[x] = tag[qadd[x]];
+				}
 			}
-		}
+		});
 
 		// output 'new_pal' as color look-up table contents,
 		// 'new_bits' as the quantized image (array of table addresses).
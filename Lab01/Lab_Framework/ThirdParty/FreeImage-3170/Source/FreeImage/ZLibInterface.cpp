@@ -23,6 +23,195 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "../ZLib/zutil.h"	/* must be the last header because of error C3163 in VS2008 (_vsnprintf defined in stdio.h) */
+#include "../FastDeflate/fastdeflate.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+
+// ----------------------------------------------------------
+//   Deflate backends
+// ----------------------------------------------------------
+
+static DWORD DLL_CALLCONV 
+ZLib_Compress(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size, int level) {
+	uLongf dest_len = (uLongf)target_size;
+
+	int zerr = compress2(target, &dest_len, source, source_size, level);
+	if(zerr != Z_OK) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "Zlib error : %s", zError(zerr));
+		return 0;
+	}
+	return (DWORD)dest_len;
+}
+
+static DWORD DLL_CALLCONV 
+ZLib_Uncompress(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size) {
+	uLongf dest_len = (uLongf)target_size;
+
+	int zerr = uncompress(target, &dest_len, source, source_size);
+	if(zerr != Z_OK) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "Zlib error : %s", zError(zerr));
+		return 0;
+	}
+	return (DWORD)dest_len;
+}
+
+static DWORD DLL_CALLCONV 
+ZLib_CRC32(DWORD crc, const BYTE *source, DWORD source_size) {
+	return (DWORD)crc32(crc, source, source_size);
+}
+
+/*
+FastDeflate works on whole buffers only, which is all the ZLib interface needs. 
+It is faster than ZLib for both directions, and writes streams of about the same size 
+at a given level. 
+*/
+
+static const char* 
+FastDeflate_Error(enum fastdeflate_result result) {
+	switch(result) {
+		case FASTDEFLATE_BAD_DATA:
+			return "data error";
+		case FASTDEFLATE_SHORT_OUTPUT:
+		case FASTDEFLATE_INSUFFICIENT_SPACE:
+			return "buffer error";
+		default:
+			return "unknown error";
+	}
+}
+
+static DWORD DLL_CALLCONV 
+FastDeflate_Compress(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size, int level) {
+	struct fastdeflate_compressor *compressor = fastdeflate_alloc_compressor(level);
+	if(!compressor) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FastDeflate error : %s", "insufficient memory");
+		return 0;
+	}
+	size_t dest_len = fastdeflate_zlib_compress(compressor, source, source_size, target, target_size);
+	fastdeflate_free_compressor(compressor);
+
+	if(dest_len == 0) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FastDeflate error : %s", "buffer error");
+	}
+	return (DWORD)dest_len;
+}
+
+static DWORD DLL_CALLCONV 
+FastDeflate_Uncompress(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size) {
+	struct fastdeflate_decompressor *decompressor = fastdeflate_alloc_decompressor();
+	if(!decompressor) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FastDeflate error : %s", "insufficient memory");
+		return 0;
+	}
+	size_t dest_len = 0;
+	enum fastdeflate_result result = fastdeflate_zlib_decompress(decompressor, source, source_size, target, target_size, &dest_len);
+	fastdeflate_free_decompressor(decompressor);
+
+	if(result != FASTDEFLATE_SUCCESS) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FastDeflate error : %s", FastDeflate_Error(result));
+		return 0;
+	}
+	return (DWORD)dest_len;
+}
+
+static DWORD DLL_CALLCONV 
+FastDeflate_CRC32(DWORD crc, const BYTE *source, DWORD source_size) {
+	return (DWORD)fastdeflate_crc32(crc, source, source_size);
+}
+
+static const FIDEFLATEBACKEND s_fastdeflate_backend = { "fastdeflate", FastDeflate_Compress, FastDeflate_Uncompress, FastDeflate_CRC32 };
+static const FIDEFLATEBACKEND s_zlib_backend = { "zlib", ZLib_Compress, ZLib_Uncompress, ZLib_CRC32 };
+
+/**
+Backend used by the ZLib interface. 
+It is read without locking: a backend is never freed once it has been selected, 
+so a call may keep on using the one it read while another thread selects a new one.
+*/
+static std::atomic<const FIDEFLATEBACKEND*> s_backend(&s_fastdeflate_backend);
+
+/// Copies of the user defined backends, protected by s_backends_mutex (writers only)
+static std::list<FIDEFLATEBACKEND> s_user_backends;
+static std::mutex s_backends_mutex;
+
+/**
+Returns the current backend
+*/
+static inline const FIDEFLATEBACKEND* 
+GetBackend() {
+	return s_backend.load(std::memory_order_acquire);
+}
+
+/**
+Select the codec used by the whole buffer routines of the ZLib interface. 
+The backend is copied and can be changed at any time: calls already running 
+complete with the previous codec. 
+The PNG and TIFF plugins do not use the backend: their whole buffer paths call FastDeflate, 
+and LibPNG and LibTIFF stream through the bundled ZLib. 
+
+@param backend Codec to use, or NULL to restore the built-in codec (FastDeflate)
+@return Returns TRUE if successful, returns FALSE if the backend is incomplete
+@see FreeImage_FindDeflateBackend
+*/
+BOOL DLL_CALLCONV 
+FreeImage_SetDeflateBackend(const FIDEFLATEBACKEND *backend) {
+	if(!backend) {
+		s_backend.store(&s_fastdeflate_backend, std::memory_order_release);
+		return TRUE;
+	}
+	if(!backend->name || !backend->compress_proc || !backend->uncompress_proc || !backend->crc32_proc) {
+		return FALSE;
+	}
+	if((backend == &s_fastdeflate_backend) || (backend == &s_zlib_backend)) {
+		s_backend.store(backend, std::memory_order_release);
+		return TRUE;
+	}
+
+	std::lock_guard<std::mutex> lock(s_backends_mutex);
+
+	// switching back and forth between the same backends does not grow the list
+	for(std::list<FIDEFLATEBACKEND>::const_iterator i = s_user_backends.begin(); i != s_user_backends.end(); ++i) {
+		if((i->name == backend->name) && (i->compress_proc == backend->compress_proc) && (i->uncompress_proc == backend->uncompress_proc) && (i->crc32_proc == backend->crc32_proc)) {
+			s_backend.store(&*i, std::memory_order_release);
+			return TRUE;
+		}
+	}
+	s_user_backends.push_back(*backend);
+	s_backend.store(&s_user_backends.back(), std::memory_order_release);
+
+	return TRUE;
+}
+
+/**
+Returns the name of the codec used by the ZLib interface
+*/
+const char * DLL_CALLCONV 
+FreeImage_GetDeflateBackend() {
+	return GetBackend()->name;
+}
+
+/**
+Returns a built-in codec, that may be passed to FreeImage_SetDeflateBackend. 
+
+@param name "fastdeflate" (the default codec) or "zlib" (the bundled ZLib)
+@return Returns the codec, or NULL if the name is unknown
+*/
+const FIDEFLATEBACKEND * DLL_CALLCONV 
+FreeImage_FindDeflateBackend(const char *name) {
+	if(name) {
+		if(strcmp(name, s_fastdeflate_backend.name) == 0) {
+			return &s_fastdeflate_backend;
+		}
+		if(strcmp(name, s_zlib_backend.name) == 0) {
+			return &s_zlib_backend;
+		}
+	}
+	return NULL;
+}
+
+// ----------------------------------------------------------
+//   ZLib interface
+// ----------------------------------------------------------
 
 /**
 Compresses a source buffer into a target buffer, using the ZLib library. 
@@ -38,19 +227,24 @@ which must be at least 0.1% larger than source_size plus 12 bytes.
 */
 DWORD DLL_CALLCONV 
 FreeImage_ZLibCompress(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size) {
-	uLongf dest_len = (uLongf)target_size;
+	return FreeImage_ZLibCompressLevel(target, target_size, source, source_size, Z_DEFAULT_COMPRESSION);
+}
 
-	int zerr = compress(target, &dest_len, source, source_size);
-	switch(zerr) {
-		case Z_MEM_ERROR:	// not enough memory
-		case Z_BUF_ERROR:	// not enough room in the output buffer
-			FreeImage_OutputMessageProc(FIF_UNKNOWN, "Zlib error : %s", zError(zerr));
-			return 0;
-		case Z_OK:
-			return dest_len;
-	}
+/**
+Same as FreeImage_ZLibCompress, with a user defined compression level.
 
-	return 0;
+@param level Compression level, from 0 (no compression) to 9 (best compression). 
+A negative value selects the default level (6).
+@see FreeImage_ZLibCompress
+*/
+DWORD DLL_CALLCONV 
+FreeImage_ZLibCompressLevel(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size, int level) {
+	if(level < 0) {
+		level = 6;
+	} else if(level > Z_BEST_COMPRESSION) {
+		level = Z_BEST_COMPRESSION;
+	}
+	return GetBackend()->compress_proc(target, target_size, source, source_size, level);
 }
 
 /**
@@ -70,20 +264,7 @@ compression library.
 */
 DWORD DLL_CALLCONV 
 FreeImage_ZLibUncompress(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size) {
-	uLongf dest_len = (uLongf)target_size;
-
-	int zerr = uncompress(target, &dest_len, source, source_size);
-	switch(zerr) {
-		case Z_MEM_ERROR:	// not enough memory
-		case Z_BUF_ERROR:	// not enough room in the output buffer
-		case Z_DATA_ERROR:	// input data was corrupted
-			FreeImage_OutputMessageProc(FIF_UNKNOWN, "Zlib error : %s", zError(zerr));
-			return 0;
-		case Z_OK:
-			return dest_len;
-	}
-
-	return 0;
+	return GetBackend()->uncompress_proc(target, target_size, source, source_size);
 }
 
 /**
@@ -101,28 +282,26 @@ which must be at least 0.1% larger than source_size plus 24 bytes.
 */
 DWORD DLL_CALLCONV 
 FreeImage_ZLibGZip(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size) {
-	uLongf dest_len = (uLongf)target_size - 12;
-	DWORD crc = crc32(0L, NULL, 0);
+	if(target_size < 12) {
+		return 0;
+	}
+	DWORD crc = 0;
+	const FIDEFLATEBACKEND *backend = GetBackend();
 
     // set up header (stolen from zlib/gzio.c)
     sprintf((char *)target, "%c%c%c%c%c%c%c%c", 0x1f, 0x8b,
          Z_DEFLATED, 0 /*flags*/, 0,0,0,0 /*time*/);
-    int zerr = compress2(target + 8, &dest_len, source, source_size, Z_BEST_COMPRESSION);
-	switch(zerr) {
-		case Z_MEM_ERROR:	// not enough memory
-		case Z_BUF_ERROR:	// not enough room in the output buffer
-			FreeImage_OutputMessageProc(FIF_UNKNOWN, "Zlib error : %s", zError(zerr));
-			return 0;
-        case Z_OK: {
-            // patch header, setup crc and length (stolen from mod_trace_output)
-            BYTE *p = target + 8; *p++ = 2; *p = OS_CODE; // xflags, os_code
- 	        crc = crc32(crc, source, source_size);
-	        memcpy(target + 4 + dest_len, &crc, 4);
-	        memcpy(target + 8 + dest_len, &source_size, 4);
-            return dest_len + 12;
-        }
-	}
-	return 0;
+	// the ZLib header and trailer of the stream are replaced by the GZIP ones
+    DWORD dest_len = backend->compress_proc(target + 8, target_size - 12, source, source_size, Z_BEST_COMPRESSION);
+	if(dest_len == 0) {
+		return 0;
+	}
+    // patch header, setup crc and length (stolen from mod_trace_output)
+    BYTE *p = target + 8; *p++ = 2; *p = OS_CODE; // xflags, os_code
+    crc = backend->crc32_proc(crc, source, source_size);
+    memcpy(target + 4 + dest_len, &crc, 4);
+    memcpy(target + 8 + dest_len, &source_size, 4);
+    return dest_len + 12;
 }
 
 /**
@@ -131,7 +310,8 @@ Upon entry, target_size is the total size of the destination buffer,
 which must be large enough to hold the entire uncompressed data. 
 The size of the uncompressed data must have been saved previously by the compressor 
 and transmitted to the decompressor by some mechanism outside the scope of this 
-compression library.
+compression library. 
+The stream is always decoded with FastDeflate, which checks its CRC and size.
 
 @param target Destination buffer
 @param target_size Size of the destination buffer, in bytes
@@ -140,76 +320,27 @@ compression library.
 @return Returns the actual size of the uncompressed buffer, returns 0 if an error occured
 @see FreeImage_ZLibGZip
 */
-
-static int get_byte(z_stream *stream) {
-    if (stream->avail_in <= 0) return EOF;
-    stream->avail_in--;
-    return *(stream->next_in)++;
-}
-
-static int checkheader(z_stream *stream) {
-    int flags, c;
-    DWORD len;
-
-    if (get_byte(stream) != 0x1f || get_byte(stream) != 0x8b)
-        return Z_DATA_ERROR;
-    if (get_byte(stream) != Z_DEFLATED || ((flags = get_byte(stream)) & 0xE0) != 0)
-        return Z_DATA_ERROR;
-    for (len = 0; len < 6; len++) (void)get_byte(stream);
-
-    if ((flags & 0x04) != 0) { /* skip the extra field */
-        len  =  (DWORD)get_byte(stream);
-        len += ((DWORD)get_byte(stream)) << 8;
-        /* len is garbage if EOF but the loop below will quit anyway */
-        while (len-- != 0 && get_byte(stream) != EOF) ;
-    }
-    if ((flags & 0x08) != 0) { /* skip the original file name */
-        while ((c = get_byte(stream)) != 0 && c != EOF) ;
-    }
-    if ((flags & 0x10) != 0) {   /* skip the .gz file comment */
-        while ((c = get_byte(stream)) != 0 && c != EOF) ;
-    }
-    if ((flags & 0x02) != 0) {  /* skip the header crc */
-        for (len = 0; len < 2; len++) (void)get_byte(stream);
-    }
-    return Z_OK;
-}
-
 DWORD DLL_CALLCONV 
 FreeImage_ZLibGUnzip(BYTE *target, DWORD target_size, BYTE *source, DWORD source_size) {
-    DWORD src_len  = source_size;
-    DWORD dest_len = target_size;
-    int   zerr     = Z_DATA_ERROR;
-
-    if (src_len > 0) {
-        z_stream stream;
-        memset(&stream, 0, sizeof (stream));
-        if ((zerr = inflateInit2(&stream, -MAX_WBITS)) == Z_OK) {
-            stream.next_in  = source;
-            stream.avail_in = source_size;
-
-            stream.next_out  = target;
-            stream.avail_out = target_size;
-
-            if ((zerr = checkheader(&stream)) == Z_OK) {
-                zerr = inflate (&stream, Z_NO_FLUSH);
-                dest_len = target_size - stream.avail_out;
-
-                if (zerr == Z_OK || zerr == Z_STREAM_END)
-                    inflateEnd(&stream);
-            } 
-        }
-    }
-    if (zerr != Z_OK && zerr != Z_STREAM_END) {
-        FreeImage_OutputMessageProc(FIF_UNKNOWN, "Zlib error : %s", zError(zerr));
-        return 0;
-    }
-    return dest_len;
+	struct fastdeflate_decompressor *decompressor = fastdeflate_alloc_decompressor();
+	if(!decompressor) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FastDeflate error : %s", "insufficient memory");
+		return 0;
+	}
+	size_t dest_len = 0;
+	enum fastdeflate_result result = fastdeflate_gzip_decompress(decompressor, source, source_size, target, target_size, &dest_len);
+	fastdeflate_free_decompressor(decompressor);
+
+	if(result != FASTDEFLATE_SUCCESS) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FastDeflate error : %s", FastDeflate_Error(result));
+		return 0;
+	}
+	return (DWORD)dest_len;
 }
 
 /**
 Update a running crc from source and return the updated crc, using the ZLib library.
-If source is NULL, this function returns the required initial value for the crc.
+If source is NULL, this function returns the required initial value for the crc (0).
 
 @param crc Running crc value
 @param source Source buffer
@@ -219,5 +350,8 @@ If source is NULL, this function returns the required initial value for the crc.
 DWORD DLL_CALLCONV 
 FreeImage_ZLibCRC32(DWORD crc, BYTE *source, DWORD source_size) {
 
-    return crc32(crc, source, source_size);
+	if(!source) {
+		return 0;
+	}
+    return GetBackend()->crc32_proc(crc, source, source_size);
 }
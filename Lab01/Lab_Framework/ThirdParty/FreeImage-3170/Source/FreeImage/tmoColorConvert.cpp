@@ -23,6 +23,11 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ThreadPool.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
 
 // ----------------------------------------------------------
 // Convert RGB to and from Yxy, same as in Reinhard et al. SIGGRAPH 2002
@@ -130,8 +135,6 @@ On output, pixel->red == Y, pixel->green == x, pixel->blue == y
 */
 BOOL 
 ConvertInPlaceRGBFToYxy(FIBITMAP *dib) {
-	float result[3];
-
 	if(FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
 
@@ -140,28 +143,29 @@ ConvertInPlaceRGBFToYxy(FIBITMAP *dib) {
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 	
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(unsigned y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += RGB2XYZ[i][0] * pixel[x].red;
-				result[i] += RGB2XYZ[i][1] * pixel[x].green;
-				result[i] += RGB2XYZ[i][2] * pixel[x].blue;
-			}
-			const float W = result[0] + result[1] + result[2];
-			const float Y = result[1];
-			if(W > 0) { 
-				pixel[x].red   = Y;			    // Y 
-				pixel[x].green = result[0] / W;	// x 
-				pixel[x].blue  = result[1] / W;	// y 	
-			} else {
-				pixel[x].red = pixel[x].green = pixel[x].blue = 0;
+	ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+		float result[3];
+		for(unsigned y = first; y < last; y++) {
+			FIRGBF *pixel = (FIRGBF*)(bits + y * pitch);
+			for(unsigned x = 0; x < width; x++) {
+				result[0] = result[1] = result[2] = 0;
+				for (int i = 0; i < 3; i++) {
+					result[i] += RGB2XYZ[i][0] * pixel[x].red;
+					result[i] += RGB2XYZ[i][1] * pixel[x].green;
+					result[i] += RGB2XYZ[i][2] * pixel[x].blue;
+				}
+				const float W = result[0] + result[1] + result[2];
+				const float Y = result[1];
+				if(W > 0) { 
+					pixel[x].red   = Y;			    // Y 
+					pixel[x].green = result[0] / W;	// x 
+					pixel[x].blue  = result[1] / W;	// y 	
+				} else {
+					pixel[x].red = pixel[x].green = pixel[x].blue = 0;
+				}
 			}
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
@@ -174,9 +178,6 @@ On input, pixel->red == Y, pixel->green == x, pixel->blue == y
 */
 BOOL 
 ConvertInPlaceYxyToRGBF(FIBITMAP *dib) {
-	float result[3];
-	float X, Y, Z;
-
 	if(FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
 
@@ -185,34 +186,36 @@ ConvertInPlaceYxyToRGBF(FIBITMAP *dib) {
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(unsigned y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			Y = pixel[x].red;	        // Y 
-			result[1] = pixel[x].green;	// x 
-			result[2] = pixel[x].blue;	// y 
-			if ((Y > EPSILON) && (result[1] > EPSILON) && (result[2] > EPSILON)) {
-				X = (result[1] * Y) / result[2];
-				Z = (X / result[1]) - X - Y;
-			} else {
-				X = Z = EPSILON;
-			}
-			pixel[x].red   = X;
-			pixel[x].green = Y;
-			pixel[x].blue  = Z;
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += XYZ2RGB[i][0] * pixel[x].red;
-				result[i] += XYZ2RGB[i][1] * pixel[x].green;
-				result[i] += XYZ2RGB[i][2] * pixel[x].blue;
+	ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+		float result[3];
+		float X, Y, Z;
+		for(unsigned y = first; y < last; y++) {
+			FIRGBF *pixel = (FIRGBF*)(bits + y * pitch);
+			for(unsigned x = 0; x < width; x++) {
+				Y = pixel[x].red;	        // Y 
+				result[1] = pixel[x].green;	// x 
+				result[2] = pixel[x].blue;	// y 
+				if ((Y > EPSILON) && (result[1] > EPSILON) && (result[2] > EPSILON)) {
+					X = (result[1] * Y) / result[2];
+					Z = (X / result[1]) - X - Y;
+				} else {
+					X = Z = EPSILON;
+				}
+				pixel[x].red   = X;
+				pixel[x].green = Y;
+				pixel[x].blue  = Z;
+				result[0] = result[1] = result[2] = 0;
+				for (int i = 0; i < 3; i++) {
+					result[i] += XYZ2RGB[i][0] * pixel[x].red;
+					result[i] += XYZ2RGB[i][1] * pixel[x].green;
+					result[i] += XYZ2RGB[i][2] * pixel[x].blue;
+				}
+				pixel[x].red   = result[0];	// R
+				pixel[x].green = result[1];	// G
+				pixel[x].blue  = result[2];	// B
 			}
-			pixel[x].red   = result[0];	// R
-			pixel[x].green = result[1];	// G
-			pixel[x].blue  = result[2];	// B
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
@@ -235,20 +238,47 @@ LuminanceFromYxy(FIBITMAP *Yxy, float *maxLum, float *minLum, float *worldLum) {
 	const unsigned height = FreeImage_GetHeight(Yxy);
 	const unsigned pitch  = FreeImage_GetPitch(Yxy);
 
+	const BOOL fast_math = ToneMappingFastMath();
+
+	// statistics of each row, combined in row order so that the result does not depend on the number of threads
+	std::vector<float> row_max(height), row_min(height);
+	std::vector<double> row_sum(height);
+
+	const BYTE *bits = (BYTE*)FreeImage_GetBits(Yxy);
+	ParallelFor(0, height, ToneMappingGrain(width), [&](unsigned first, unsigned last) {
+		std::vector<float> logY(fast_math ? width : 0);
+		for(unsigned y = first; y < last; y++) {
+			const FIRGBF *pixel = (FIRGBF*)(bits + y * pitch);
+			float max_lum = 0, min_lum = 0;
+			double sum = 0;
+			for(unsigned x = 0; x < width; x++) {
+				const float Y = MAX(0.0F, pixel[x].red);// avoid negative values
+				max_lum = (max_lum < Y) ? Y : max_lum;	// max Luminance in the scene
+				min_lum = (min_lum < Y) ? min_lum : Y;	// min Luminance in the scene
+				if(fast_math) {
+					logY[x] = 2.3e-5F + Y;
+				} else {
+					sum += log(2.3e-5F + Y);			// contrast constant in Tumblin paper
+				}
+			}
+			if(fast_math) {
+				FastLogArray(&logY[0], width);
+				for(unsigned x = 0; x < width; x++) {
+					sum += logY[x];
+				}
+			}
+			row_max[y] = max_lum;
+			row_min[y] = min_lum;
+			row_sum[y] = sum;
+		}
+	});
+
 	float max_lum = 0, min_lum = 0;
 	double sum = 0;
-
-	BYTE *bits = (BYTE*)FreeImage_GetBits(Yxy);
 	for(unsigned y = 0; y < height; y++) {
-		const FIRGBF *pixel = (FIRGBF*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float Y = MAX(0.0F, pixel[x].red);// avoid negative values
-			max_lum = (max_lum < Y) ? Y : max_lum;	// max Luminance in the scene
-			min_lum = (min_lum < Y) ? min_lum : Y;	// min Luminance in the scene
-			sum += log(2.3e-5F + Y);				// contrast constant in Tumblin paper
-		}
-		// next line
-		bits += pitch;
+		max_lum = MAX(max_lum, row_max[y]);
+		min_lum = MIN(min_lum, row_min[y]);
+		sum += row_sum[y];
 	}
 	// maximum luminance
 	*maxLum = max_lum;
@@ -280,25 +310,25 @@ ClampConvertRGBFTo24(FIBITMAP *src) {
 	const unsigned src_pitch  = FreeImage_GetPitch(src);
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
 
-	BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+	const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
 	BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
 
-	for(unsigned y = 0; y < height; y++) {
-		const FIRGBF *src_pixel = (FIRGBF*)src_bits;
-		BYTE *dst_pixel = (BYTE*)dst_bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float red   = (src_pixel[x].red > 1)   ? 1 : src_pixel[x].red;
-			const float green = (src_pixel[x].green > 1) ? 1 : src_pixel[x].green;
-			const float blue  = (src_pixel[x].blue > 1)  ? 1 : src_pixel[x].blue;
-			
-			dst_pixel[FI_RGBA_RED]   = (BYTE)(255.0F * red   + 0.5F);
-			dst_pixel[FI_RGBA_GREEN] = (BYTE)(255.0F * green + 0.5F);
-			dst_pixel[FI_RGBA_BLUE]  = (BYTE)(255.0F * blue  + 0.5F);
-			dst_pixel += 3;
+	ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			const FIRGBF *src_pixel = (FIRGBF*)(src_bits + y * src_pitch);
+			BYTE *dst_pixel = dst_bits + y * dst_pitch;
+			for(unsigned x = 0; x < width; x++) {
+				const float red   = (src_pixel[x].red > 1)   ? 1 : src_pixel[x].red;
+				const float green = (src_pixel[x].green > 1) ? 1 : src_pixel[x].green;
+				const float blue  = (src_pixel[x].blue > 1)  ? 1 : src_pixel[x].blue;
+				
+				dst_pixel[FI_RGBA_RED]   = (BYTE)(255.0F * red   + 0.5F);
+				dst_pixel[FI_RGBA_GREEN] = (BYTE)(255.0F * green + 0.5F);
+				dst_pixel[FI_RGBA_BLUE]  = (BYTE)(255.0F * blue  + 0.5F);
+				dst_pixel += 3;
+			}
 		}
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	});
 
 	return dst;
 }
@@ -327,20 +357,19 @@ ConvertRGBFToY(FIBITMAP *src) {
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
 
 	
-	BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+	const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
 	BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
 
-	for(unsigned y = 0; y < height; y++) {
-		const FIRGBF *src_pixel = (FIRGBF*)src_bits;
-		float  *dst_pixel = (float*)dst_bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float L = LUMA_REC709(src_pixel[x].red, src_pixel[x].green, src_pixel[x].blue);
-			dst_pixel[x] = (L > 0) ? L : 0;
+	ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			const FIRGBF *src_pixel = (FIRGBF*)(src_bits + y * src_pitch);
+			float  *dst_pixel = (float*)(dst_bits + y * dst_pitch);
+			for(unsigned x = 0; x < width; x++) {
+				const float L = LUMA_REC709(src_pixel[x].red, src_pixel[x].green, src_pixel[x].blue);
+				dst_pixel[x] = (L > 0) ? L : 0;
+			}
 		}
-		// next line
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	});
 
 	return dst;
 }
@@ -364,21 +393,50 @@ LuminanceFromY(FIBITMAP *dib, float *maxLum, float *minLum, float *Lav, float *L
 	unsigned height = FreeImage_GetHeight(dib);
 	unsigned pitch  = FreeImage_GetPitch(dib);
 
+	const BOOL fast_math = ToneMappingFastMath();
+
+	// statistics of each row, combined in row order so that the result does not depend on the number of threads
+	std::vector<float> row_max(height), row_min(height);
+	std::vector<double> row_sum(height), row_log_sum(height);
+
+	const BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
+	ParallelFor(0, height, ToneMappingGrain(width), [&](unsigned first, unsigned last) {
+		std::vector<float> logY(fast_math ? width : 0);
+		for(unsigned y = first; y < last; y++) {
+			const float *pixel = (float*)(bits + y * pitch);
+			float max_lum = -1e20F, min_lum = 1e20F;
+			double sumLum = 0, sumLogLum = 0;
+			for(unsigned x = 0; x < width; x++) {
+				const float Y = pixel[x];
+				max_lum = (max_lum < Y) ? Y : max_lum;				// max Luminance in the scene
+				min_lum = ((Y > 0) && (min_lum < Y)) ? min_lum : Y;	// min Luminance in the scene
+				sumLum += Y;										// average luminance
+				if(fast_math) {
+					logY[x] = 2.3e-5F + Y;
+				} else {
+					sumLogLum += log(2.3e-5F + Y);					// contrast constant in Tumblin paper
+				}
+			}
+			if(fast_math) {
+				FastLogArray(&logY[0], width);
+				for(unsigned x = 0; x < width; x++) {
+					sumLogLum += logY[x];
+				}
+			}
+			row_max[y] = max_lum;
+			row_min[y] = min_lum;
+			row_sum[y] = sumLum;
+			row_log_sum[y] = sumLogLum;
+		}
+	});
+
 	float max_lum = -1e20F, min_lum = 1e20F;
 	double sumLum = 0, sumLogLum = 0;
-
-	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
 	for(unsigned y = 0; y < height; y++) {
-		const float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			const float Y = pixel[x];
-			max_lum = (max_lum < Y) ? Y : max_lum;				// max Luminance in the scene
-			min_lum = ((Y > 0) && (min_lum < Y)) ? min_lum : Y;	// min Luminance in the scene
-			sumLum += Y;										// average luminance
-			sumLogLum += log(2.3e-5F + Y);						// contrast constant in Tumblin paper
-		}
-		// next line
-		bits += pitch;
+		max_lum = MAX(max_lum, row_max[y]);
+		min_lum = MIN(min_lum, row_min[y]);
+		sumLum += row_sum[y];
+		sumLogLum += row_log_sum[y];
 	}
 
 	// maximum luminance
@@ -429,7 +487,7 @@ and normalize between 0 and 1.
 */
 void 
 NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct) {
-	int x, y;
+	int y;
 	float maxLum, minLum;
 
 	if(minPrct > maxPrct) {
@@ -448,17 +506,25 @@ NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct) {
 		maxLum = 0, minLum = 0;
 		findMaxMinPercentile(Y, minPrct, &minLum, maxPrct, &maxLum);
 	} else {
+		std::vector<float> row_max(height), row_min(height);
+		const BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
+		ParallelFor(0, height, ToneMappingGrain(width), [&](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				const float *pixel = (float*)(bits + y * pitch);
+				float max_value = -1e20F, min_value = 1e20F;
+				for(int x = 0; x < width; x++) {
+					const float value = pixel[x];
+					max_value = (max_value < value) ? value : max_value;	// max Luminance in the scene
+					min_value = (min_value < value) ? min_value : value;	// min Luminance in the scene
+				}
+				row_max[y] = max_value;
+				row_min[y] = min_value;
+			}
+		});
 		maxLum = -1e20F, minLum = 1e20F;
-		BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
 		for(y = 0; y < height; y++) {
-			const float *pixel = (float*)bits;
-			for(x = 0; x < width; x++) {
-				const float value = pixel[x];
-				maxLum = (maxLum < value) ? value : maxLum;	// max Luminance in the scene
-				minLum = (minLum < value) ? minLum : value;	// min Luminance in the scene
-			}
-			// next line
-			bits += pitch;
+			maxLum = MAX(maxLum, row_max[y]);
+			minLum = MIN(minLum, row_min[y]);
 		}
 	}
 	if(maxLum == minLum) return;
@@ -466,14 +532,200 @@ NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct) {
 	// normalize to range 0..1 
 	const float divider = maxLum - minLum;
 	BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
-	for(y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(x = 0; x < width; x++) {
-			pixel[x] = (pixel[x] - minLum) / divider;
-			if(pixel[x] <= 0) pixel[x] = EPSILON;
-			if(pixel[x] > 1) pixel[x] = 1;
+	ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			float *pixel = (float*)(bits + y * pitch);
+			for(int x = 0; x < width; x++) {
+				pixel[x] = (pixel[x] - minLum) / divider;
+				if(pixel[x] <= 0) pixel[x] = EPSILON;
+				if(pixel[x] > 1) pixel[x] = 1;
+			}
 		}
-		// next line
-		bits += pitch;
+	});
+}
+
+// --------------------------------------------------------------------------
+// Fast math
+// log2 is computed from the float exponent and a series in (m-1)/(m+1) 
+// with the mantissa m in [sqrt(1/2)..sqrt(2)), exp2 from the rounded exponent 
+// and a polynomial in [-1/2..1/2]. Both have a relative error around 1e-7, 
+// pow(x, y) = exp2(y * log2(x)) is within 1e-6 for the exponents used by the operators. 
+// Arguments below the smallest normal float are clamped, log(0) returns log(FLT_MIN).
+// --------------------------------------------------------------------------
+
+static const float FAST_LN2   = 0.693147181F;	// log(2)
+static const float FAST_LOG2E = 1.442695041F;	// 1 / log(2)
+static const float FAST_SQRT2 = 1.414213562F;
+
+static inline float 
+FastLog2(float x) {
+	if(!(x >= FLT_MIN)) x = FLT_MIN;	// also catches NaN
+	if(x > FLT_MAX) x = FLT_MAX;
+
+	int bits;
+	memcpy(&bits, &x, sizeof(float));
+	int e = (bits >> 23) - 127;
+	bits = (bits & 0x007FFFFF) | 0x3F800000;
+	float m;
+	memcpy(&m, &bits, sizeof(float));
+	if(m > FAST_SQRT2) {
+		m *= 0.5F;
+		e++;
+	}
+	// log(m) = 2 * (t + t^3/3 + t^5/5 + t^7/7), with t = (m - 1) / (m + 1)
+	const float t = (m - 1) / (m + 1);
+	const float t2 = t * t;
+	const float ln_m = t * (2.0F + t2 * (0.666666667F + t2 * (0.4F + t2 * 0.285714286F)));
+
+	return (float)e + ln_m * FAST_LOG2E;
+}
+
+static inline float 
+FastExp2(float x) {
+	if(!(x > -126.0F)) x = -126.0F;	// also catches NaN
+	if(x > 127.0F) x = 127.0F;
+
+	const int n = (int)floor(x + 0.5F);
+	const float z = (x - (float)n) * FAST_LN2;
+	// exp(z) for z in [-log(2)/2..log(2)/2]
+	const float p = 1.0F + z * (1.0F + z * (0.5F + z * (0.166666667F + z * (0.041666667F + z * (0.008333333F + z * 0.001388889F)))));
+	const int bits = (n + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(float));
+
+	return p * scale;
+}
+
+#ifdef FREEIMAGE_SSE2
+
+static inline __m128 
+FastLog2_SSE2(__m128 x) {
+	// _mm_max_ps returns its second operand on NaN
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(FLT_MIN)), _mm_set1_ps(FLT_MAX));
+
+	const __m128i bits = _mm_castps_si128(x);
+	__m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+	const __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(FAST_SQRT2));
+	m = _mm_or_ps(_mm_andnot_ps(big, m), _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5F))));
+	e = _mm_sub_epi32(e, _mm_castps_si128(big));	// big is -1 where true
+
+	const __m128 one = _mm_set1_ps(1.0F);
+	const __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	const __m128 t2 = _mm_mul_ps(t, t);
+	__m128 p = _mm_add_ps(_mm_set1_ps(0.4F), _mm_mul_ps(t2, _mm_set1_ps(0.285714286F)));
+	p = _mm_add_ps(_mm_set1_ps(0.666666667F), _mm_mul_ps(t2, p));
+	p = _mm_add_ps(_mm_set1_ps(2.0F), _mm_mul_ps(t2, p));
+	const __m128 ln_m = _mm_mul_ps(t, p);
+
+	return _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(ln_m, _mm_set1_ps(FAST_LOG2E)));
+}
+
+static inline __m128 
+FastExp2_SSE2(__m128 x) {
+	// _mm_max_ps returns its second operand on NaN
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0F)), _mm_set1_ps(127.0F));
+
+	// floor(x + 0.5), as in the scalar version
+	const __m128 h = _mm_add_ps(x, _mm_set1_ps(0.5F));
+	__m128i n = _mm_cvttps_epi32(h);
+	n = _mm_add_epi32(n, _mm_castps_si128(_mm_cmplt_ps(h, _mm_cvtepi32_ps(n))));	// -1 where truncation rounded up
+
+	const __m128 z = _mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(n)), _mm_set1_ps(FAST_LN2));
+	__m128 p = _mm_add_ps(_mm_set1_ps(0.008333333F), _mm_mul_ps(z, _mm_set1_ps(0.001388889F)));
+	p = _mm_add_ps(_mm_set1_ps(0.041666667F), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(0.166666667F), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(0.5F), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0F), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0F), _mm_mul_ps(z, p));
+	const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+
+	return _mm_mul_ps(p, scale);
+}
+
+#endif // FREEIMAGE_SSE2
+
+/**
+Approximation of log(x)
+*/
+float 
+FastLog(float x) {
+	return FastLog2(x) * FAST_LN2;
+}
+
+/**
+Approximation of exp(x), clamped to [2^-126..2^127]
+*/
+float 
+FastExp(float x) {
+	return FastExp2(x * FAST_LOG2E);
+}
+
+/**
+Approximation of pow(x, y) for x >= 0. 
+Zero, negative and NaN values of x return 0 when y > 0.
+*/
+float 
+FastPow(float x, float y) {
+	if((y > 0) && !(x > 0)) {
+		return 0;
+	}
+	return FastExp2(y * FastLog2(x));
+}
+
+/**
+In-place log of an array
+*/
+void 
+FastLogArray(float *values, unsigned count) {
+	unsigned i = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128 ln2 = _mm_set1_ps(FAST_LN2);
+	for(; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(values + i, _mm_mul_ps(FastLog2_SSE2(_mm_loadu_ps(values + i)), ln2));
+	}
+#endif
+	for(; i < count; i++) {
+		values[i] = FastLog(values[i]);
+	}
+}
+
+/**
+In-place exp of an array
+*/
+void 
+FastExpArray(float *values, unsigned count) {
+	unsigned i = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128 log2e = _mm_set1_ps(FAST_LOG2E);
+	for(; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(values + i, FastExp2_SSE2(_mm_mul_ps(_mm_loadu_ps(values + i), log2e)));
+	}
+#endif
+	for(; i < count; i++) {
+		values[i] = FastExp(values[i]);
+	}
+}
+
+/**
+In-place pow of an array, using the same exponent for all values
+*/
+void 
+FastPowArray(float *values, unsigned count, float y) {
+	unsigned i = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128 exponent = _mm_set1_ps(y);
+	const __m128 zero = _mm_setzero_ps();
+	for(; i + 4 <= count; i += 4) {
+		const __m128 x = _mm_loadu_ps(values + i);
+		__m128 result = FastExp2_SSE2(_mm_mul_ps(exponent, FastLog2_SSE2(x)));
+		if(y > 0) {
+			result = _mm_and_ps(result, _mm_cmpgt_ps(x, zero));
+		}
+		_mm_storeu_ps(values + i, result);
+	}
+#endif
+	for(; i < count; i++) {
+		values[i] = FastPow(values[i], y);
 	}
 }
@@ -22,6 +22,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ThreadPool.h"
 
 // ----------------------------------------------------------
 // Logarithmic mapping operator
@@ -68,9 +69,7 @@ static BOOL
 ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float biasParam, const float exposure) {
 	const float LOG05 = -0.693147F;	// log(0.5) 
 
-	double Lmax, divider, interpol, biasP;
-	unsigned x, y;
-	double L;
+	double Lmax, divider, biasP;
 
 	if(FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
@@ -97,22 +96,50 @@ ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float
 	further acceleration is obtained by a Pad approximation of log(x + 1)
 	*/
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(x = 0; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
+
+	if(ToneMappingFastMath()) {
+		// vectorized bias function and log, one row at a time
+		const float fLmax = (float)Lmax;
+		const float fbiasP = (float)biasP;
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			std::vector<float> Yw(width), interpol(width);
+			for(unsigned y = first; y < last; y++) {
+				FIRGBF *pixel = (FIRGBF*)(bits + y * pitch);
+				for(unsigned x = 0; x < width; x++) {
+					Yw[x] = (pixel[x].red / avgLum) * exposure;
+					interpol[x] = Yw[x] / fLmax;
+				}
+				FastPowArray(&interpol[0], width, fbiasP);
+				for(unsigned x = 0; x < width; x++) {
+					interpol[x] = 2 + interpol[x] * 8;
+				}
+				FastLogArray(&interpol[0], width);
+				for(unsigned x = 0; x < width; x++) {
+					const double L = (Yw[x] < 2) ? pade_log(Yw[x]) : FastLog(Yw[x] + 1);
+					pixel[x].red = (float)((L / interpol[x]) / divider);
+				}
+			}
+		});
+	} else {
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				FIRGBF *pixel = (FIRGBF*)(bits + y * pitch);
+				for(unsigned x = 0; x < width; x++) {
+					double Yw = pixel[x].red / avgLum;
+					Yw *= exposure;
+					const double interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
+					const double L = pade_log(Yw);// log(Yw + 1)
+					pixel[x].red = (float)((L / interpol) / divider);
+				}
+			}
+		});
 	}
 
 #else
+	unsigned x, y;
 	unsigned index;
 	int i, j;
+	double L, interpol;
 
 	unsigned max_width  = width - (width % 3);
 	unsigned max_height = height - (height % 3); 
@@ -228,17 +255,30 @@ REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
 	const unsigned height = FreeImage_GetHeight(dib);
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 
+	const BOOL fast_math = ToneMappingFastMath();
+
 	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(unsigned y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			for(int i = 0; i < 3; i++) {
-				*pixel = (*pixel <= start) ? *pixel * slope : (1.099F * pow(*pixel, fgamma) - 0.099F);
-				pixel++;
+	ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+		std::vector<float> power(fast_math ? 3 * width : 0);
+		for(unsigned y = first; y < last; y++) {
+			float *pixel = (float*)(bits + y * pitch);
+			if(fast_math) {
+				// the channels of a row are contiguous
+				memcpy(&power[0], pixel, 3 * width * sizeof(float));
+				FastPowArray(&power[0], 3 * width, fgamma);
+				for(unsigned i = 0; i < 3 * width; i++) {
+					pixel[i] = (pixel[i] <= start) ? pixel[i] * slope : (1.099F * power[i] - 0.099F);
+				}
+			} else {
+				for(unsigned x = 0; x < width; x++) {
+					for(int i = 0; i < 3; i++) {
+						*pixel = (*pixel <= start) ? *pixel * slope : (1.099F * pow(*pixel, fgamma) - 0.099F);
+						pixel++;
+					}
+				}
 			}
 		}
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
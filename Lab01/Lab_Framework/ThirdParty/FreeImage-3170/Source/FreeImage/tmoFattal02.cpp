@@ -22,6 +22,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ThreadPool.h"
 
 // ----------------------------------------------------------
 // Gradient domain HDR compression
@@ -43,7 +44,6 @@ followed by a subsampling by 2.
 */
 static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 	FIBITMAP *h_dib = NULL, *v_dib = NULL, *dst = NULL;
-	float *src_pixel, *dst_pixel;
 
 	try {
 		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
@@ -60,44 +60,63 @@ static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 
 		// horizontal convolution dib -> h_dib
 
-		src_pixel = (float*)FreeImage_GetBits(dib);
-		dst_pixel = (float*)FreeImage_GetBits(h_dib);
-
-		for(unsigned y = 0; y < height; y++) {
-			// work on line y
-			for(unsigned x = 2; x < width - 2; x++) {
-				dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
-				dst_pixel[x] /= 16;
+		const float *h_src = (float*)FreeImage_GetBits(dib);
+		float *h_dst = (float*)FreeImage_GetBits(h_dib);
+
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				// work on line y
+				const float *src_pixel = h_src + y * pitch;
+				float *dst_pixel = h_dst + y * pitch;
+				for(unsigned x = 2; x < width - 2; x++) {
+					dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
+					dst_pixel[x] /= 16;
+				}
+				// boundary mirroring
+				dst_pixel[0] = (2 * src_pixel[2] + 8 * src_pixel[1] + 6 * src_pixel[0]) / 16;
+				dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
+				dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
+				dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
 			}
-			// boundary mirroring
-			dst_pixel[0] = (2 * src_pixel[2] + 8 * src_pixel[1] + 6 * src_pixel[0]) / 16;
-			dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
-			dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
-			dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
-
-			// next line
-			src_pixel += pitch;
-			dst_pixel += pitch;
-		}
+		});
 
-		// vertical convolution h_dib -> v_dib
+		// vertical convolution h_dib -> v_dib, one output line at a time
 
-		src_pixel = (float*)FreeImage_GetBits(h_dib);
-		dst_pixel = (float*)FreeImage_GetBits(v_dib);
+		const float *src_pixel = (float*)FreeImage_GetBits(h_dib);
+		float *dst_pixel = (float*)FreeImage_GetBits(v_dib);
 
-		for(unsigned x = 0; x < width; x++) {		
-			// work on column x
-			for(unsigned y = 2; y < height - 2; y++) {
-				const unsigned index = y*pitch + x;
-				dst_pixel[index] = src_pixel[index-2*pitch] + src_pixel[index+2*pitch] + 4 * (src_pixel[index-pitch] + src_pixel[index+pitch]) + 6 * src_pixel[index];
-				dst_pixel[index] /= 16;
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				if((y >= 2) && (y < height - 2)) {
+					for(unsigned x = 0; x < width; x++) {
+						const unsigned index = y*pitch + x;
+						dst_pixel[index] = src_pixel[index-2*pitch] + src_pixel[index+2*pitch] + 4 * (src_pixel[index-pitch] + src_pixel[index+pitch]) + 6 * src_pixel[index];
+						dst_pixel[index] /= 16;
+					}
+				}
+				// boundary mirroring
+				else if(y == 0) {
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[x] = (2 * src_pixel[x+2*pitch] + 8 * src_pixel[x+pitch] + 6 * src_pixel[x]) / 16;
+					}
+				}
+				else if(y == 1) {
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[x+pitch] = (src_pixel[x+3*pitch] + 4 * (src_pixel[x] + src_pixel[x+2*pitch]) + 7 * src_pixel[x+pitch]) / 16;
+					}
+				}
+				else if(y == height - 2) {
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[(height-2)*pitch+x] = (src_pixel[(height-4)*pitch+x] + 5 * src_pixel[(height-1)*pitch+x] + 4 * src_pixel[(height-3)*pitch+x] + 6 * src_pixel[(height-2)*pitch+x]) / 16;
+					}
+				}
+				else {
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[(height-1)*pitch+x] = (src_pixel[(height-3)*pitch+x] + 5 * src_pixel[(height-2)*pitch+x] + 10 * src_pixel[(height-1)*pitch+x]) / 16;
+					}
+				}
 			}
-			// boundary mirroring
-			dst_pixel[x] = (2 * src_pixel[x+2*pitch] + 8 * src_pixel[x+pitch] + 6 * src_pixel[x]) / 16;
-			dst_pixel[x+pitch] = (src_pixel[x+3*pitch] + 4 * (src_pixel[x] + src_pixel[x+2*pitch]) + 7 * src_pixel[x+pitch]) / 16;
-			dst_pixel[(height-2)*pitch+x] = (src_pixel[(height-4)*pitch+x] + 5 * src_pixel[(height-1)*pitch+x] + 4 * src_pixel[(height-3)*pitch+x] + 6 * src_pixel[(height-2)*pitch+x]) / 16;
-			dst_pixel[(height-1)*pitch+x] = (src_pixel[(height-3)*pitch+x] + 5 * src_pixel[(height-2)*pitch+x] + 10 * src_pixel[(height-1)*pitch+x]) / 16;
-		}
+		});
 
 		FreeImage_Unload(h_dib); h_dib = NULL;
 
@@ -171,30 +190,40 @@ static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
 		const unsigned pitch = FreeImage_GetPitch(H) / sizeof(float);
 		
 		const float divider = (float)(1 << (k + 1));
-		float average = 0;
 		
-		float *src_pixel = (float*)FreeImage_GetBits(H);
-		float *dst_pixel = (float*)FreeImage_GetBits(G);
+		const float *src_pixel = (float*)FreeImage_GetBits(H);
+		float *dst_bits = (float*)FreeImage_GetBits(G);
+
+		// sum of each row, combined in row order so that the result does not depend on the number of threads
+		std::vector<double> row_sum(height);
+
+		ParallelFor(0, height, ToneMappingGrain(width), [&](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				const unsigned n = (y == 0 ? 0 : y-1);
+				const unsigned s = (y+1 == height ? y : y+1);
+				float *dst_pixel = dst_bits + y * pitch;
+				double sum = 0;
+				for(unsigned x = 0; x < width; x++) {
+					const unsigned w = (x == 0 ? 0 : x-1);
+					const unsigned e = (x+1 == width ? x : x+1);		
+					// central difference
+					const float gx = (src_pixel[y*pitch+e] - src_pixel[y*pitch+w]) / divider; // [Hk(x+1, y) - Hk(x-1, y)] / 2**(k+1)
+					const float gy = (src_pixel[s*pitch+x] - src_pixel[n*pitch+x]) / divider; // [Hk(x, y+1) - Hk(x, y-1)] / 2**(k+1)
+					// gradient
+					dst_pixel[x] = sqrt(gx*gx + gy*gy);
+					// average gradient
+					sum += dst_pixel[x];
+				}
+				row_sum[y] = sum;
+			}
+		});
 
+		double average = 0;
 		for(unsigned y = 0; y < height; y++) {
-			const unsigned n = (y == 0 ? 0 : y-1);
-			const unsigned s = (y+1 == height ? y : y+1);
-			for(unsigned x = 0; x < width; x++) {
-				const unsigned w = (x == 0 ? 0 : x-1);
-				const unsigned e = (x+1 == width ? x : x+1);		
-				// central difference
-				const float gx = (src_pixel[y*pitch+e] - src_pixel[y*pitch+w]) / divider; // [Hk(x+1, y) - Hk(x-1, y)] / 2**(k+1)
-				const float gy = (src_pixel[s*pitch+x] - src_pixel[n*pitch+x]) / divider; // [Hk(x, y+1) - Hk(x, y-1)] / 2**(k+1)
-				// gradient
-				dst_pixel[x] = sqrt(gx*gx + gy*gy);
-				// average gradient
-				average += dst_pixel[x];
-			}
-			// next line
-			dst_pixel += pitch;
+			average += row_sum[y];
 		}
 		
-		*avgGrad = average / (width * height);
+		*avgGrad = (float)(average / ((double)width * height));
 
 		return G;
 
@@ -241,7 +270,6 @@ Compute the gradient attenuation function PHI(x, y)
 @return Returns the attenuation matrix Phi if successful, returns NULL otherwise
 */
 static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, float alpha, float beta) {
-	float *src_pixel, *dst_pixel;
 	FIBITMAP **phi = NULL;
 
 	try {
@@ -268,35 +296,47 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 			phi[k] = FreeImage_AllocateT(FIT_FLOAT, width, height);
 			if(!phi[k]) throw(1);
 			
-			src_pixel = (float*)FreeImage_GetBits(Gk);
-			dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-			for(unsigned y = 0; y < height; y++) {
-				for(unsigned x = 0; x < width; x++) {
-					// compute (alpha / grad) * (grad / alpha) ** beta
-					const float v = src_pixel[x] / ALPHA;
-					const float value = (float)pow((float)v, (float)(beta-1));
-					dst_pixel[x] = (value > 1) ? 1 : value;
+			const float *grad = (float*)FreeImage_GetBits(Gk);
+			float *attenuation = (float*)FreeImage_GetBits(phi[k]);
+			const BOOL fast_math = ToneMappingFastMath();
+			ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+				for(unsigned y = first; y < last; y++) {
+					const float *src_row = grad + y * pitch;
+					float *dst_row = attenuation + y * pitch;
+					if(fast_math) {
+						for(unsigned x = 0; x < width; x++) {
+							dst_row[x] = src_row[x] / ALPHA;
+						}
+						FastPowArray(dst_row, width, beta-1);
+						for(unsigned x = 0; x < width; x++) {
+							dst_row[x] = (dst_row[x] > 1) ? 1 : dst_row[x];
+						}
+					} else {
+						for(unsigned x = 0; x < width; x++) {
+							// compute (alpha / grad) * (grad / alpha) ** beta
+							const float v = src_row[x] / ALPHA;
+							const float value = (float)pow((float)v, (float)(beta-1));
+							dst_row[x] = (value > 1) ? 1 : value;
+						}
+					}
 				}
-				// next line
-				src_pixel += pitch;
-				dst_pixel += pitch;
-			}
+			});
 
 			if(k < nlevels-1) {
 				// compute PHI(k) = L( PHI(k+1) ) * phi(k)
 				FIBITMAP *L = FreeImage_Rescale(phi[k+1], width, height, FILTER_BILINEAR);
 				if(!L) throw(1);
 
-				src_pixel = (float*)FreeImage_GetBits(L);
-				dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-				for(unsigned y = 0; y < height; y++) {
-					for(unsigned x = 0; x < width; x++) {
-						dst_pixel[x] *= src_pixel[x];
+				const float *coarse = (float*)FreeImage_GetBits(L);
+				ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+					for(unsigned y = first; y < last; y++) {
+						const float *src_row = coarse + y * pitch;
+						float *dst_row = attenuation + y * pitch;
+						for(unsigned x = 0; x < width; x++) {
+							dst_row[x] *= src_row[x];
+						}
 					}
-					// next line
-					src_pixel += pitch;
-					dst_pixel += pitch;
-				}
+				});
 
 				FreeImage_Unload(L);
 
@@ -358,41 +398,40 @@ static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
 		gx  = (float*)FreeImage_GetBits(Gx);
 		gy  = (float*)FreeImage_GetBits(Gy);
 
-		for(unsigned y = 0; y < height; y++) {
-			const unsigned s = (y+1 == height ? y : y+1);
-			for(unsigned x = 0; x < width; x++) {				
-				const unsigned e = (x+1 == width ? x : x+1);
-				// forward difference
-				const unsigned index = y*pitch + x;
-				const float phi_xy = phi[index];
-				const float h_xy   = h[index];
-				gx[x] = (h[y*pitch+e] - h_xy) * phi_xy; // [H(x+1, y) - H(x, y)] * PHI(x, y)
-				gy[x] = (h[s*pitch+x] - h_xy) * phi_xy; // [H(x, y+1) - H(x, y)] * PHI(x, y)
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				const unsigned s = (y+1 == height ? y : y+1);
+				for(unsigned x = 0; x < width; x++) {				
+					const unsigned e = (x+1 == width ? x : x+1);
+					// forward difference
+					const unsigned index = y*pitch + x;
+					const float phi_xy = phi[index];
+					const float h_xy   = h[index];
+					gx[index] = (h[y*pitch+e] - h_xy) * phi_xy; // [H(x+1, y) - H(x, y)] * PHI(x, y)
+					gy[index] = (h[s*pitch+x] - h_xy) * phi_xy; // [H(x, y+1) - H(x, y)] * PHI(x, y)
+				}
 			}
-			// next line
-			gx += pitch;
-			gy += pitch;
-		}
+		});
 
 		// calculate the divergence
 
 		divG = FreeImage_AllocateT(image_type, width, height);
 		if(!divG) throw(1);
 		
-		gx  = (float*)FreeImage_GetBits(Gx);
-		gy  = (float*)FreeImage_GetBits(Gy);
 		divg = (float*)FreeImage_GetBits(divG);
 
-		for(unsigned y = 0; y < height; y++) {
-			for(unsigned x = 0; x < width; x++) {				
-				// backward difference approximation
-				// divG = Gx(x, y) - Gx(x-1, y) + Gy(x, y) - Gy(x, y-1)
-				const unsigned index = y*pitch + x;
-				divg[index] = gx[index] + gy[index];
-				if(x > 0) divg[index] -= gx[index-1];
-				if(y > 0) divg[index] -= gy[index-pitch];
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				for(unsigned x = 0; x < width; x++) {				
+					// backward difference approximation
+					// divG = Gx(x, y) - Gx(x-1, y) + Gy(x, y) - Gy(x, y-1)
+					const unsigned index = y*pitch + x;
+					divg[index] = gx[index] + gy[index];
+					if(x > 0) divg[index] -= gx[index-1];
+					if(y > 0) divg[index] -= gy[index-pitch];
+				}
 			}
-		}
+		});
 
 		// no longer needed ... 
 		FreeImage_Unload(Gx);
@@ -428,33 +467,48 @@ static FIBITMAP* LogLuminance(FIBITMAP *Y) {
 		const unsigned pitch  = FreeImage_GetPitch(H);
 
 		// find max & min luminance values
-		float maxLum = -1e20F, minLum = 1e20F;
+		std::vector<float> row_max(height), row_min(height);
 
 		BYTE *bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			const float *pixel = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
-				const float value = pixel[x];
-				maxLum = (maxLum < value) ? value : maxLum;	// max Luminance in the scene
-				minLum = (minLum < value) ? minLum : value;	// min Luminance in the scene
+		ParallelFor(0, height, ToneMappingGrain(width), [&](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				const float *pixel = (float*)(bits + y * pitch);
+				float max_value = -1e20F, min_value = 1e20F;
+				for(unsigned x = 0; x < width; x++) {
+					const float value = pixel[x];
+					max_value = (max_value < value) ? value : max_value;	// max Luminance in the scene
+					min_value = (min_value < value) ? min_value : value;	// min Luminance in the scene
+				}
+				row_max[y] = max_value;
+				row_min[y] = min_value;
 			}
-			// next line
-			bits += pitch;
+		});
+		float maxLum = -1e20F, minLum = 1e20F;
+		for(unsigned y = 0; y < height; y++) {
+			maxLum = MAX(maxLum, row_max[y]);
+			minLum = MIN(minLum, row_min[y]);
 		}
 		if(maxLum == minLum) throw(1);
 
 		// normalize to range 0..100 and take the logarithm
 		const float scale = 100.F / (maxLum - minLum);
-		bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			float *pixel = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
-				const float value = (pixel[x] - minLum) * scale;
-				pixel[x] = log(value + EPSILON);
+		const BOOL fast_math = ToneMappingFastMath();
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				float *pixel = (float*)(bits + y * pitch);
+				if(fast_math) {
+					for(unsigned x = 0; x < width; x++) {
+						pixel[x] = (pixel[x] - minLum) * scale + EPSILON;
+					}
+					FastLogArray(pixel, width);
+				} else {
+					for(unsigned x = 0; x < width; x++) {
+						const float value = (pixel[x] - minLum) * scale;
+						pixel[x] = log(value + EPSILON);
+					}
+				}
 			}
-			// next line
-			bits += pitch;
-		}
+		});
 
 		return H;
 
@@ -473,14 +527,24 @@ static void ExpLuminance(FIBITMAP *Y) {
 	const unsigned height = FreeImage_GetHeight(Y);
 	const unsigned pitch = FreeImage_GetPitch(Y);
 
+	const BOOL fast_math = ToneMappingFastMath();
+
 	BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
-	for(unsigned y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			pixel[x] = exp(pixel[x]) - EPSILON;
+	ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			float *pixel = (float*)(bits + y * pitch);
+			if(fast_math) {
+				FastExpArray(pixel, width);
+				for(unsigned x = 0; x < width; x++) {
+					pixel[x] -= EPSILON;
+				}
+			} else {
+				for(unsigned x = 0; x < width; x++) {
+					pixel[x] = exp(pixel[x]) - EPSILON;
+				}
+			}
 		}
-		bits += pitch;
-	}
+	});
 }
 
 // --------------------------------------------------------------------------
@@ -519,6 +583,8 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 			nlevels++;
 			minsize /= 2;
 		}
+		// images smaller than the coarsest level use a single level
+		nlevels = MAX(nlevels, 1);
 
 		// create the Gaussian pyramid
 		pyramid = (FIBITMAP**)malloc(nlevels * sizeof(FIBITMAP*));
@@ -650,20 +716,36 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		BYTE *bits_yin  = (BYTE*)FreeImage_GetBits(Yin);
 		BYTE *bits_yout = (BYTE*)FreeImage_GetBits(Yout);
 
-		for(unsigned y = 0; y < height; y++) {
-			float *Lin = (float*)bits_yin;
-			float *Lout = (float*)bits_yout;
-			float *color = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
-				for(unsigned c = 0; c < 3; c++) {
-					*color = (Lin[x] > 0) ? pow(*color/Lin[x], s) * Lout[x] : 0;
-					color++;
+		const BOOL fast_math = ToneMappingFastMath();
+
+		ParallelFor(0, height, ToneMappingGrain(width), [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				const float *Lin = (float*)(bits_yin + y * y_pitch);
+				const float *Lout = (float*)(bits_yout + y * y_pitch);
+				float *color = (float*)(bits + y * rgb_pitch);
+				if(fast_math) {
+					// the channels of a row are contiguous
+					for(unsigned x = 0; x < width; x++) {
+						for(unsigned c = 0; c < 3; c++) {
+							color[3 * x + c] = (Lin[x] > 0) ? color[3 * x + c] / Lin[x] : 0;
+						}
+					}
+					FastPowArray(color, 3 * width, s);
+					for(unsigned x = 0; x < width; x++) {
+						for(unsigned c = 0; c < 3; c++) {
+							color[3 * x + c] = (Lin[x] > 0) ? color[3 * x + c] * Lout[x] : 0;
+						}
+					}
+				} else {
+					for(unsigned x = 0; x < width; x++) {
+						for(unsigned c = 0; c < 3; c++) {
+							*color = (Lin[x] > 0) ? pow(*color/Lin[x], s) * Lout[x] : 0;
+							color++;
+						}
+					}
 				}
 			}
-			bits += rgb_pitch;
-			bits_yin += y_pitch;
-			bits_yout += y_pitch;
-		}
+		});
 
 		// not needed anymore
 		FreeImage_Unload(Yin);  Yin  = NULL;
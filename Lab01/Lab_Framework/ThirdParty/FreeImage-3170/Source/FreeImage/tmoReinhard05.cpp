@@ -23,6 +23,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ThreadPool.h"
 
 // ----------------------------------------------------------
 // Global and/or local tone mapping operator
@@ -52,9 +53,6 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 	float minLum = 1;	// min luminance
 	float maxLum = 1;	// max luminance
 
-	float L;		// pixel luminance
-	float I_g, I_l; // global and local light adaptation
-	float I_a;		// interpolated pixel light adaptation
 	float k;		// key (low-key means overall dark image, high-key means overall light image)
 
 	// check input parameters 
@@ -75,9 +73,12 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 	const unsigned y_pitch    = FreeImage_GetPitch(Y);
 
 	int i;
-	unsigned x, y;
+	unsigned y;
 	BYTE *bits = NULL, *Ybits = NULL;
 
+	const BOOL fast_math = ToneMappingFastMath();
+	const unsigned grain = ToneMappingGrain(width);
+
 	// get statistics about the data (but only if its really needed)
 
 	f = exp(-f);
@@ -95,8 +96,8 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 	}
 	m = (m > 0) ? m : (float)(0.3 + 0.7 * pow(k, 1.4F));
 
-	float max_color = -1e6F;
-	float min_color = +1e6F;
+	// color range of each row, combined in row order so that the result does not depend on the number of threads
+	std::vector<float> row_max(height), row_min(height);
 
 	// tone map image
 
@@ -105,26 +106,42 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 
 	if((a == 1) && (c == 0)) {
 		// when using default values, use a fastest code
+		// (the adaptation only depends on the pixel luminance, so it is computed once for the 3 channels)
+
+		ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+			std::vector<float> adaptation(width);
+			for(unsigned y = first; y < last; y++) {
+				const float *Y = (float*)(Ybits + y * y_pitch);
+				float *color   = (float*)(bits + y * dib_pitch);
+				float max_color = -1e6F;
+				float min_color = +1e6F;
+
+				if(fast_math) {
+					for(unsigned x = 0; x < width; x++) {
+						adaptation[x] = f * Y[x];
+					}
+					FastPowArray(&adaptation[0], width, m);
+				} else {
+					for(unsigned x = 0; x < width; x++) {
+						const float I_a = Y[x];	// luminance(x, y)
+						adaptation[x] = pow(f * I_a, m);
+					}
+				}
 
-		for(y = 0; y < height; y++) {
-			float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
-
-			for(x = 0; x < width; x++) {
-				I_a = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
+				for(unsigned x = 0; x < width; x++) {
+					for (int i = 0; i < 3; i++) {
+						*color /= ( *color + adaptation[x] );
+						
+						max_color = (*color > max_color) ? *color : max_color;
+						min_color = (*color < min_color) ? *color : min_color;
 
-					color++;
+						color++;
+					}
 				}
+				row_max[y] = max_color;
+				row_min[y] = min_color;
 			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
-		}
+		});
 	} else {
 		// complete algorithm
 
@@ -133,67 +150,97 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 		Cav[0] = Cav[1] = Cav[2] = 0;
 		if((a != 1) && (c != 0)) {
 			// channel averages are not needed when (a == 1) or (c == 0)
-			bits = (BYTE*)FreeImage_GetBits(dib);
-			for(y = 0; y < height; y++) {
-				float *color = (float*)bits;
-				for(x = 0; x < width; x++) {
-					for(i = 0; i < 3; i++) {
-						Cav[i] += *color;
-						color++;
+			std::vector<double> row_sum(3 * height);
+			ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+				for(unsigned y = first; y < last; y++) {
+					const float *color = (float*)(bits + y * dib_pitch);
+					double sum[3] = { 0, 0, 0 };
+					for(unsigned x = 0; x < width; x++) {
+						for(int i = 0; i < 3; i++) {
+							sum[i] += *color;
+							color++;
+						}
+					}
+					for(int i = 0; i < 3; i++) {
+						row_sum[3 * y + i] = sum[i];
 					}
 				}
-				// next line
-				bits += dib_pitch;
+			});
+			double sum[3] = { 0, 0, 0 };
+			for(y = 0; y < height; y++) {
+				for(i = 0; i < 3; i++) {
+					sum[i] += row_sum[3 * y + i];
+				}
 			}
-			const float image_size = (float)width * height;
+			const double image_size = (double)width * height;
 			for(i = 0; i < 3; i++) {
-				Cav[i] /= image_size;
+				Cav[i] = (float)(sum[i] / image_size);
 			}
 		}
 
 		// perform tone mapping
 
-		bits = (BYTE*)FreeImage_GetBits(dib);
-		for(y = 0; y < height; y++) {
-			const float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
-
-			for(x = 0; x < width; x++) {
-				L = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					I_l = c * *color + (1-c) * L;
-					I_g = c * Cav[i] + (1-c) * Lav;
-					I_a = a * I_l + (1-a) * I_g;
-					*color /= ( *color + pow(f * I_a, m) );
+		ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+			std::vector<float> adaptation(3 * width);
+			for(unsigned y = first; y < last; y++) {
+				const float *Y = (float*)(Ybits + y * y_pitch);
+				float *color   = (float*)(bits + y * dib_pitch);
+				float max_color = -1e6F;
+				float min_color = +1e6F;
+
+				for(unsigned x = 0; x < width; x++) {
+					const float L = Y[x];	// luminance(x, y)
+					for (int i = 0; i < 3; i++) {
+						const float I_l = c * color[3 * x + i] + (1-c) * L;	// local light adaptation
+						const float I_g = c * Cav[i] + (1-c) * Lav;			// global light adaptation
+						const float I_a = a * I_l + (1-a) * I_g;			// interpolated pixel light adaptation
+						adaptation[3 * x + i] = f * I_a;
+					}
+				}
+				if(fast_math) {
+					FastPowArray(&adaptation[0], 3 * width, m);
+				} else {
+					for(unsigned i = 0; i < 3 * width; i++) {
+						adaptation[i] = pow(adaptation[i], m);
+					}
+				}
+
+				for(unsigned i = 0; i < 3 * width; i++) {
+					*color /= ( *color + adaptation[i] );
 					
 					max_color = (*color > max_color) ? *color : max_color;
 					min_color = (*color < min_color) ? *color : min_color;
 
 					color++;
 				}
+				row_max[y] = max_color;
+				row_min[y] = min_color;
 			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
-		}
+		});
+	}
+
+	float max_color = -1e6F;
+	float min_color = +1e6F;
+	for(y = 0; y < height; y++) {
+		max_color = MAX(max_color, row_max[y]);
+		min_color = MIN(min_color, row_min[y]);
 	}
 
 	// normalize intensities
 
 	if(max_color != min_color) {
-		bits = (BYTE*)FreeImage_GetBits(dib);
 		const float range = max_color - min_color;
-		for(y = 0; y < height; y++) {
-			float *color = (float*)bits;
-			for(x = 0; x < width; x++) {
-				for(i = 0; i < 3; i++) {
-					*color = (*color - min_color) / range;
-					color++;
+		ParallelFor(0, height, grain, [=](unsigned first, unsigned last) {
+			for(unsigned y = first; y < last; y++) {
+				float *color = (float*)(bits + y * dib_pitch);
+				for(unsigned x = 0; x < width; x++) {
+					for(int i = 0; i < 3; i++) {
+						*color = (*color - min_color) / range;
+						color++;
+					}
 				}
 			}
-			// next line
-			bits += dib_pitch;
-		}
+		});
 	}
 
 	return TRUE;
@@ -35,9 +35,16 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
 
 #define RBLOCK		64	// image blocks of RBLOCK*RBLOCK pixels
 
+#define ROTATE_GRAIN	(64 * 1024)	// minimum number of pixels processed by a band of rows or columns
+
 // --------------------------------------------------------------------------
 
 /**
@@ -172,143 +179,148 @@ HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeigh
 }
 
 /**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-Parameter T can be BYTE, WORD of float. 
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
-@param bkcolor Background color
+Copies the pixels of a block of the destination image of a 90 or 270 degree rotation.
+The destination pixel (x, y) is the source pixel at src_origin + x * x_step + y * y_step.
+@param src_origin Source pixel of destination pixel (0, 0)
+@param x_step Source offset (in bytes) between destination pixels (x, y) and (x + 1, y)
+@param y_step Source offset (in bytes) between destination pixels (x, y) and (x, y + 1)
+@param bdest Destination pixels
+@param dst_pitch Destination scan width
+@param xs First column of the block
+@param xe One past the last column of the block
+@param ys First row of the block
+@param ye One past the last row of the block
 */
-template <class T> void 
-VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight, const void *bkcolor = NULL) {
-	int iYPos;
-
-	unsigned src_height = FreeImage_GetHeight(src);
-	unsigned dst_height = FreeImage_GetHeight(dst);
-
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
-
-	// background
-	const T pxlBlack[4] = {0, 0, 0, 0 };
-	const T *pxlBkg = static_cast<const T*>(bkcolor); // assume at least bytespp and 4*sizeof(T) max
-	if(!pxlBkg) {
-		// default background color is black
-		pxlBkg = pxlBlack;
-	}
-
-	// calculate the number of bytes per pixel
-	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-	// calculate the number of samples per pixel
-	const unsigned samples = bytespp / sizeof(T);
-
-	const unsigned src_pitch = FreeImage_GetPitch(src);
-	const unsigned dst_pitch = FreeImage_GetPitch(dst);
-	const unsigned index = col * bytespp;
-
-	BYTE *src_bits = FreeImage_GetBits(src) + index;
-	BYTE *dst_bits = FreeImage_GetBits(dst) + index;
-
-	// fill gap above skew with background
-	if(bkcolor) {
-		for(int k = 0; k < iOffset; k++) {
-			memcpy(dst_bits, bkcolor, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memcpy(&pxlOldLeft[0], bkcolor, bytespp);
-	} else {
-		for(int k = 0; k < iOffset; k++) {
-			memset(dst_bits, 0, bytespp);
-			dst_bits += dst_pitch;
+template <unsigned N> static void 
+RotateBlockT(const BYTE *src_origin, int x_step, int y_step, BYTE *bdest, unsigned dst_pitch, unsigned xs, unsigned xe, unsigned ys, unsigned ye) {
+	for(unsigned y = ys; y < ye; y++) {
+		const BYTE *src_bits = src_origin + (ptrdiff_t)xs * x_step + (ptrdiff_t)y * y_step;
+		PixelBytes<N> *dst_bits = (PixelBytes<N>*)(bdest + y * dst_pitch) + xs;
+		for(unsigned x = xs; x < xe; x++) {
+			*dst_bits++ = *(const PixelBytes<N>*)src_bits;
+			src_bits += x_step;
 		}
-		memset(&pxlOldLeft[0], 0, bytespp);
 	}
+}
 
-	for(unsigned i = 0; i < src_height; i++) {
-		// loop through column pixels
-		AssignPixel((BYTE*)(&pxlSrc[0]), src_bits, bytespp);
-		// calculate weights
-		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
-		}
-		// check boundaries
-		iYPos = i + iOffset;
-		if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-			// update left over on source
-			for(unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
+#ifdef FREEIMAGE_SSE2
+/**
+Same as RotateBlockT for 32-bit pixels, by tiles of 4x4 pixels. 
+The 4 source pixels of a tile row are next to each other (y_step is +4 or -4 bytes): 
+a tile is read as 4 vectors, transposed, then written as 4 vectors.
+*/
+static void 
+RotateBlock32(const BYTE *src_origin, int x_step, int y_step, BYTE *bdest, unsigned dst_pitch, unsigned xs, unsigned xe, unsigned ys, unsigned ye) {
+	const unsigned xe4 = xs + ((xe - xs) & ~3U);
+	const unsigned ye4 = ys + ((ye - ys) & ~3U);
+
+	for(unsigned y = ys; y < ye4; y += 4) {
+		for(unsigned x = xs; x < xe4; x += 4) {
+			// lowest address of the 4 source pixels of the first tile row
+			const BYTE *src_bits = src_origin + (ptrdiff_t)x * x_step + (ptrdiff_t)y * y_step + ((y_step < 0) ? 3 * y_step : 0);
+
+			__m128i r0 = _mm_loadu_si128((const __m128i*)(src_bits));
+			__m128i r1 = _mm_loadu_si128((const __m128i*)(src_bits + x_step));
+			__m128i r2 = _mm_loadu_si128((const __m128i*)(src_bits + 2 * x_step));
+			__m128i r3 = _mm_loadu_si128((const __m128i*)(src_bits + 3 * x_step));
+			if(y_step < 0) {
+				r0 = _mm_shuffle_epi32(r0, _MM_SHUFFLE(0, 1, 2, 3));
+				r1 = _mm_shuffle_epi32(r1, _MM_SHUFFLE(0, 1, 2, 3));
+				r2 = _mm_shuffle_epi32(r2, _MM_SHUFFLE(0, 1, 2, 3));
+				r3 = _mm_shuffle_epi32(r3, _MM_SHUFFLE(0, 1, 2, 3));
 			}
-			dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-			AssignPixel(dst_bits, (BYTE*)(&pxlSrc[0]), bytespp);
-		}
-		// save leftover for next pixel in scan
-		AssignPixel((BYTE*)(&pxlOldLeft[0]), (BYTE*)(&pxlLeft[0]), bytespp);
 
-		// next pixel in scan
-		src_bits += src_pitch;
+			// 4x4 transpose
+			const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+			const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+			const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+			const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+			BYTE *dst_bits = bdest + y * dst_pitch + x * 4;
+			_mm_storeu_si128((__m128i*)(dst_bits), _mm_unpacklo_epi64(t0, t1));
+			_mm_storeu_si128((__m128i*)(dst_bits + dst_pitch), _mm_unpackhi_epi64(t0, t1));
+			_mm_storeu_si128((__m128i*)(dst_bits + 2 * dst_pitch), _mm_unpacklo_epi64(t2, t3));
+			_mm_storeu_si128((__m128i*)(dst_bits + 3 * dst_pitch), _mm_unpackhi_epi64(t2, t3));
+		}
+		// right edge
+		RotateBlockT<4>(src_origin, x_step, y_step, bdest, dst_pitch, xe4, xe, y, y + 4);
 	}
-	// go to bottom point of skew
-	iYPos = src_height + iOffset;
-
-	if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-		dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-
-		// if still in image bounds, put leftovers there				
-		AssignPixel((BYTE*)(dst_bits), (BYTE*)(&pxlOldLeft[0]), bytespp);
+	// bottom edge
+	RotateBlockT<4>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ye4, ye);
+}
+#endif // FREEIMAGE_SSE2
 
-		// clear below skewed line with background
-		if(bkcolor) {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				AssignPixel((BYTE*)(dst_bits), (BYTE*)(bkcolor), bytespp);
-			}
-		} else {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				memset(dst_bits, 0, bytespp);
+/**
+Copies the pixels of a 90 or 270 degree rotation, by blocks of RBLOCK*RBLOCK pixels.
+Going through small blocks produces much less CPU cache misses than going through 
+whole rows and columns. Bands of RBLOCK destination rows are processed in parallel.
+@see RotateBlockT
+*/
+static void 
+RotateBlocks(const BYTE *src_origin, int x_step, int y_step, FIBITMAP *dst, unsigned bytespp) {
+	const unsigned dst_width  = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
+	BYTE *bdest = FreeImage_GetBits(dst);
+
+	ParallelFor(0, (dst_height + RBLOCK - 1) / RBLOCK, 1, [=](unsigned first, unsigned last) {
+		for(unsigned ys = first * RBLOCK; ys < MIN(dst_height, last * RBLOCK); ys += RBLOCK) {
+			const unsigned ye = MIN(dst_height, ys + RBLOCK);
+			for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
+				const unsigned xe = MIN(dst_width, xs + RBLOCK);
+				switch(bytespp) {
+					case 1:
+						RotateBlockT<1>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+						break;
+					case 2:
+						RotateBlockT<2>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+						break;
+					case 3:
+						RotateBlockT<3>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+						break;
+					case 4:
+#ifdef FREEIMAGE_SSE2
+						RotateBlock32(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+#else
+						RotateBlockT<4>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+#endif
+						break;
+					case 6:
+						RotateBlockT<6>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+						break;
+					case 8:
+						RotateBlockT<8>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+						break;
+					case 12:
+						RotateBlockT<12>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+						break;
+					case 16:
+						RotateBlockT<16>(src_origin, x_step, y_step, bdest, dst_pitch, xs, xe, ys, ye);
+						break;
+				}
 			}
 		}
-	}
+	});
 }
 
 /**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
-@param bkcolor Background color
+Transposes an image: pixel (x, y) of the source image becomes pixel (y, x) of the destination image.
+@param src Pointer to source image to transpose (any type but 1- and 4-bit images)
+@return Returns a pointer to a newly allocated transposed image if successful, returns NULL otherwise
 */
-static void 
-VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight, const void *bkcolor) {
-	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+static FIBITMAP* 
+Transpose(FIBITMAP *src) {
+	FIBITMAP *dst = FreeImage_AllocateT(FreeImage_GetImageType(src), FreeImage_GetHeight(src), FreeImage_GetWidth(src), FreeImage_GetBPP(src));
+	if(NULL == dst) return NULL;
 
-	switch(image_type) {
-		case FIT_BITMAP:
-			switch(FreeImage_GetBPP(src)) {
-				case 8:
-				case 24:
-				case 32:
-					VerticalSkewT<BYTE>(src, dst, col, iOffset, dWeight, bkcolor);
-					break;
-			}
-			break;
-			case FIT_UINT16:
-			case FIT_RGB16:
-			case FIT_RGBA16:
-				VerticalSkewT<WORD>(src, dst, col, iOffset, dWeight, bkcolor);
-				break;
-			case FIT_FLOAT:
-			case FIT_RGBF:
-			case FIT_RGBAF:
-				VerticalSkewT<float>(src, dst, col, iOffset, dWeight, bkcolor);
-				break;
-	}
-} 
+	// calculate the number of bytes per pixel
+	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+
+	// dst.SetPixel(x, y, src.GetPixel(y, x))
+	RotateBlocks(FreeImage_GetBits(src), FreeImage_GetPitch(src), bytespp, dst, bytespp);
+
+	return dst;
+}
 
 /**
 Rotates an image by 90 degrees (counter clockwise). 
@@ -369,40 +381,11 @@ Rotate90(FIBITMAP *src) {
 			}
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
 				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
 				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
 				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							BYTE *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							BYTE *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
+
+				// dst.SetPixel(x, y, src.GetPixel(dst_height - y - 1, x))
+				RotateBlocks(FreeImage_GetBits(src) + (dst_height - 1) * bytespp, src_pitch, -(int)bytespp, dst, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -412,21 +395,11 @@ Rotate90(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
 			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
-			}
+			// dst.SetPixel(x, y, src.GetPixel(src_width - 1 - y, x))
+			RotateBlocks(FreeImage_GetBits(src) + (src_width - 1) * bytespp, src_pitch, -(int)bytespp, dst, bytespp);
 		}
 		break;
 	}
@@ -442,7 +415,7 @@ Precise rotation, no filters required.
 */
 static FIBITMAP* 
 Rotate180(FIBITMAP *src) {
-	int x, y, k, pos;
+	int k, pos;
 
 	const int bpp = FreeImage_GetBPP(src);
 
@@ -482,18 +455,16 @@ Rotate180(FIBITMAP *src) {
 		{
 			 // Calculate the number of bytes per pixel
 			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+			const unsigned line = FreeImage_GetLine(src);
 
-			for(y = 0; y < src_height; y++) {
-				BYTE *src_bits = FreeImage_GetScanLine(src, y);
-				BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1) + (dst_width - 1) * bytespp;
-				for(x = 0; x < src_width; x++) {
-					// get pixel at (x, y)
-					// set pixel at (dst_width - x - 1, dst_height - y - 1)
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += bytespp;
-					dst_bits -= bytespp;					
-				}				
-			}
+			ParallelFor(0, src_height, MAX(1, ROTATE_GRAIN / src_width), [=](unsigned first, unsigned last) {
+				for(unsigned y = first; y < last; y++) {
+					// pixel (x, y) goes to (dst_width - x - 1, dst_height - y - 1)
+					BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1);
+					memcpy(dst_bits, FreeImage_GetScanLine(src, y), line);
+					ReversePixels(dst_bits, dst_width, bytespp);
+				}
+			});
 		}
 		break;
 	}
@@ -510,7 +481,7 @@ Code adapted from CxImage (http://www.xdp.it/cximage.htm)
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
+	int dlineup;
 
 	const unsigned bpp = FreeImage_GetBPP(src);
 
@@ -561,40 +532,11 @@ Rotate270(FIBITMAP *src) {
 			} 
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
 				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
+				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
 				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							BYTE *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							BYTE *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
+				// dst.SetPixel(x, y, src.GetPixel(y, dst_width - x - 1))
+				RotateBlocks(FreeImage_GetBits(src) + (dst_width - 1) * src_pitch, -(int)src_pitch, bytespp, dst, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -604,21 +546,11 @@ Rotate270(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
 			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
-			}
+			// dst.SetPixel(x, y, src.GetPixel(y, src_height - 1 - x))
+			RotateBlocks(FreeImage_GetBits(src) + (src_height - 1) * src_pitch, -(int)src_pitch, bytespp, dst, bytespp);
 		}
 		break;
 	}
@@ -645,6 +577,8 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	const double dSinE = sin(dRadAngle);
 	const double dTan = tan(dRadAngle / 2);
 
+	// rows (or columns) of each shear are independent from each other and are skewed in parallel
+
 	const unsigned src_width  = FreeImage_GetWidth(src);
 	const unsigned src_height = FreeImage_GetHeight(src);
 
@@ -663,32 +597,43 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		return NULL;
 	}
 	
-	for(u = 0; u < height_1; u++) {  
-		double dShear;
+	ParallelFor(0, height_1, MAX(1U, ROTATE_GRAIN / width_1), [=](unsigned first, unsigned last) {
+		for(unsigned u = first; u < last; u++) {  
+			double dShear;
 
-		if(dTan >= 0)	{
-			// Positive angle
-			dShear = (u + 0.5) * dTan;
-		}
-		else {
-			// Negative angle
-			dShear = (double(u) - height_1 + 0.5) * dTan;
+			if(dTan >= 0)	{
+				// Positive angle
+				dShear = (u + 0.5) * dTan;
+			}
+			else {
+				// Negative angle
+				dShear = (double(u) - height_1 + 0.5) * dTan;
+			}
+			int iShear = int(floor(dShear));
+			HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
 		}
-		int iShear = int(floor(dShear));
-		HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
-	}
+	});
 
 	// Perform 2nd shear  (vertical)
 	// ----------------------------------------------------------------------
+	// Going down the columns of a large image produces a CPU cache miss for almost 
+	// each pixel: the columns are skewed as the rows of the transposed images instead
 
 	// Calc 2nd shear (vertical) destination image dimensions
 	const unsigned width_2  = width_1;
 	unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
 
-	// Allocate image for 2nd shear
-	FIBITMAP *dst2 = FreeImage_AllocateT(image_type, width_2, height_2, bpp);
-	if(NULL == dst2) {
-		FreeImage_Unload(dst1);
+	// Transpose the result of the 1st shear
+	FIBITMAP *dst1_t = Transpose(dst1);
+	FreeImage_Unload(dst1);
+	if(NULL == dst1_t) {
+		return NULL;
+	}
+
+	// Allocate (transposed) image for 2nd shear
+	FIBITMAP *dst2_t = FreeImage_AllocateT(image_type, height_2, width_2, bpp);
+	if(NULL == dst2_t) {
+		FreeImage_Unload(dst1_t);
 		return NULL;
 	}
 
@@ -702,17 +647,31 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = -dSinE * (double(src_width) - width_2);
 	}
 
+	// the offsets are accumulated in the same order as a sequential loop would do
+	std::vector<double> offsets(MAX(width_2, height_2));
 	for(u = 0; u < width_2; u++, dOffset -= dSinE) {
-		int iShear = int(floor(dOffset));
-		VerticalSkew(dst1, dst2, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets[u] = dOffset;
+	}
+	ParallelFor(0, width_2, MAX(1U, ROTATE_GRAIN / height_2), [&](unsigned first, unsigned last) {
+		for(unsigned u = first; u < last; u++) {
+			int iShear = int(floor(offsets[u]));
+			HorizontalSkew(dst1_t, dst2_t, u, iShear, offsets[u] - double(iShear), bkcolor);
+		}
+	});
+
+	// Free result of 1st shear
+	FreeImage_Unload(dst1_t);
+
+	// Transpose back the result of the 2nd shear
+	FIBITMAP *dst2 = Transpose(dst2_t);
+	FreeImage_Unload(dst2_t);
+	if(NULL == dst2) {
+		return NULL;
 	}
 
 	// Perform 3rd shear (horizontal)
 	// ----------------------------------------------------------------------
 
-	// Free result of 1st shear
-	FreeImage_Unload(dst1);
-
 	// Calc 3rd shear (horizontal) destination image dimensions
 	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
 	const unsigned height_3 = height_2;
@@ -733,9 +692,14 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = dTan * ( (src_width - 1.0) * -dSinE + (1.0 - height_3) );
 	}
 	for(u = 0; u < height_3; u++, dOffset += dTan) {
-		int iShear = int(floor(dOffset));
-		HorizontalSkew(dst2, dst3, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets[u] = dOffset;
 	}
+	ParallelFor(0, height_3, MAX(1U, ROTATE_GRAIN / width_3), [&](unsigned first, unsigned last) {
+		for(unsigned u = first; u < last; u++) {
+			int iShear = int(floor(offsets[u]));
+			HorizontalSkew(dst2, dst3, u, iShear, offsets[u] - double(iShear), bkcolor);
+		}
+	});
 	// Free result of 2nd shear    
 	FreeImage_Unload(dst2);
 
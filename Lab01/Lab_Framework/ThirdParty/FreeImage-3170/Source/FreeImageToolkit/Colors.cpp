@@ -23,6 +23,14 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// minimum number of bytes processed by a band of rows
+#define COLORS_GRAIN	(256 * 1024)
 
 // ----------------------------------------------------------
 //   Macros + structures
@@ -35,6 +43,185 @@
 #define GET_NIBBLE(cn, byte)    ((cn) ? (GET_HI_NIBBLE(byte)) : (GET_LO_NIBBLE(byte))) 
 #define SET_NIBBLE(cn, byte, n) if (cn) SET_HI_NIBBLE(byte, n); else SET_LO_NIBBLE(byte, n) 
 
+// ----------------------------------------------------------
+//   Row kernels
+// ----------------------------------------------------------
+
+/**
+Invert the 'size' first bytes of each row of an image, by bands of rows
+*/
+static void 
+InvertRows(FIBITMAP *dib, unsigned size) {
+	ParallelFor(0, FreeImage_GetHeight(dib), MAX(1U, COLORS_GRAIN / size), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			BYTE *bits = FreeImage_GetScanLine(dib, y);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			const __m128i ones = _mm_set1_epi8(-1);
+			for(; x + 16 <= size; x += 16) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(bits + x));
+				_mm_storeu_si128((__m128i*)(bits + x), _mm_xor_si128(v, ones));
+			}
+#endif
+			for(; x < size; x++) {
+				bits[x] = ~bits[x];
+			}
+		}
+	});
+}
+
+/**
+Apply lookup tables to the bytes of the pixels of a 8-, 24- or 32-bit image, by bands of rows.<br>
+LUT[k] is applied to byte k of each pixel (for 8-bit images, LUT[0] is applied to each pixel), 
+a NULL table leaves the byte unchanged.<br>
+32-bit pixels, and 8-bit pixels by groups of 4, are read and written as 32-bit words, each byte 
+of a word being looked up in a table of words holding the LUT shifted to the byte position.
+*/
+static void 
+ApplyLUTs(FIBITMAP *dib, const BYTE *LUT[4]) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+
+	// bytes of a 32-bit word, in memory order
+	const BYTE *word_LUT[4];
+	unsigned luts = 0;
+	for(unsigned k = 0; k < 4; k++) {
+		word_LUT[k] = (bytespp == 1) ? LUT[0] : ((k < bytespp) ? LUT[k] : NULL);
+		luts += (word_LUT[k] != NULL);
+	}
+	if(luts == 0) {
+		return;
+	}
+
+	// use the word tables when at least two bytes of a word are transformed
+	const BOOL use_words = ((bytespp == 1) || (bytespp == 4)) && (luts > 1);
+	DWORD *table = NULL;
+	if(use_words) {
+		table = (DWORD*)malloc(4 * 256 * sizeof(DWORD));
+	}
+	if(table) {
+		for(unsigned k = 0; k < 4; k++) {
+#ifndef FREEIMAGE_BIGENDIAN
+			const unsigned shift = 8 * k;
+#else
+			const unsigned shift = 24 - 8 * k;
+#endif
+			for(unsigned v = 0; v < 256; v++) {
+				table[256 * k + v] = (DWORD)(word_LUT[k] ? word_LUT[k][v] : v) << shift;
+			}
+		}
+	}
+
+	ParallelFor(0, FreeImage_GetHeight(dib), MAX(1U, COLORS_GRAIN / FreeImage_GetLine(dib)), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			BYTE *bits = FreeImage_GetScanLine(dib, y);
+			unsigned x = 0;
+
+			if(table) {
+				// scanlines are DWORD aligned
+				DWORD *words = (DWORD*)bits;
+				const unsigned count = (bytespp == 4) ? width : width / 4;
+				for(unsigned i = 0; i < count; i++) {
+					const BYTE *b = (const BYTE*)&words[i];
+					words[i] = table[b[0]] | table[256 + b[1]] | table[512 + b[2]] | table[768 + b[3]];
+				}
+				x = (bytespp == 4) ? width : 4 * count;
+			}
+
+			if(bytespp == 1) {
+				const BYTE *lut = LUT[0];
+				for(; x < width; x++) {
+					bits[x] = lut[bits[x]];
+				}
+			} else {
+				for(bits += x * bytespp; x < width; x++) {
+					for(unsigned k = 0; k < bytespp; k++) {
+						if(LUT[k]) {
+							bits[k] = LUT[k][bits[k]];
+						}
+					}
+					bits += bytespp;
+				}
+			}
+		}
+	});
+
+	free(table);
+}
+
+/**
+Count the values of a 8-bit image or of a channel of a 24- or 32-bit image, by bands of rows.<br>
+Consecutive pixels are counted in 4 interleaved histograms, so that runs of equal values 
+do not serialize on the same counter.
+@param dib Input image
+@param histo Histogram of 256 values, filled by the function
+@param offset Byte offset of the channel within a pixel, or -1 for the grey level of the pixel
+*/
+static void 
+CountValues(FIBITMAP *dib, DWORD *histo, int offset) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+
+	// one partial histogram per thread, each one filled with a band of rows
+	const unsigned pixel_bands = (unsigned)MAX<UINT64>(1, ((UINT64)width * height) / COLORS_GRAIN);
+	const unsigned band_count = MIN(MIN(ParallelGetThreadCount(), pixel_bands), height);
+	const unsigned band_rows = (height + band_count - 1) / band_count;
+
+	std::vector<DWORD> partial(band_count * 4 * 256, 0);
+
+	ParallelFor(0, band_count, 1, [&](unsigned first, unsigned last) {
+		for(unsigned band = first; band < last; band++) {
+			DWORD *h0 = &partial[band * 4 * 256];
+			DWORD *h1 = h0 + 256;
+			DWORD *h2 = h0 + 512;
+			DWORD *h3 = h0 + 768;
+			const unsigned y_end = MIN(height, (band + 1) * band_rows);
+
+			for(unsigned y = band * band_rows; y < y_end; y++) {
+				const BYTE *bits = FreeImage_GetScanLine(dib, y);
+				unsigned x = 0;
+
+				if(offset < 0) {
+					for(; x + 4 <= width; x += 4) {
+						h0[GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE])]++;
+						bits += bytespp;
+						h1[GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE])]++;
+						bits += bytespp;
+						h2[GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE])]++;
+						bits += bytespp;
+						h3[GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE])]++;
+						bits += bytespp;
+					}
+					for(; x < width; x++) {
+						h0[GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE])]++;
+						bits += bytespp;
+					}
+				} else {
+					bits += offset;
+					for(; x + 4 <= width; x += 4) {
+						h0[bits[0]]++;
+						h1[bits[bytespp]]++;
+						h2[bits[2 * bytespp]]++;
+						h3[bits[3 * bytespp]]++;
+						bits += 4 * bytespp;
+					}
+					for(; x < width; x++) {
+						h0[bits[0]]++;
+						bits += bytespp;
+					}
+				}
+			}
+		}
+	});
+
+	// merge the partial histograms
+	memset(histo, 0, 256 * sizeof(DWORD));
+	for(size_t i = 0; i < partial.size(); i++) {
+		histo[i & 255] += partial[i];
+	}
+}
+
 // ----------------------------------------------------------
 
 
@@ -48,10 +235,8 @@ FreeImage_Invert(FIBITMAP *src) {
 
 	if (!FreeImage_HasPixels(src)) return FALSE;
 	
-	unsigned i, x, y, k;
+	unsigned i;
 	
-	const unsigned width = FreeImage_GetWidth(src);
-	const unsigned height = FreeImage_GetHeight(src);
 	const unsigned bpp = FreeImage_GetBPP(src);
 
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
@@ -74,13 +259,7 @@ FreeImage_Invert(FIBITMAP *src) {
 						pal[i].rgbBlue	= 255 - pal[i].rgbBlue;
 					}
 				} else {
-					for(y = 0; y < height; y++) {
-						BYTE *bits = FreeImage_GetScanLine(src, y);
-
-						for (x = 0; x < FreeImage_GetLine(src); x++) {
-							bits[x] = ~bits[x];
-						}
-					}
+					InvertRows(src, FreeImage_GetLine(src));
 				}
 
 				break;
@@ -89,18 +268,8 @@ FreeImage_Invert(FIBITMAP *src) {
 			case 24 :
 			case 32 :
 			{
-				// Calculate the number of bytes per pixel (3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / width;
-
-				for(y = 0; y < height; y++) {
-					BYTE *bits = FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						for(k = 0; k < bytespp; k++) {
-							bits[k] = ~bits[k];
-						}
-						bits += bytespp;
-					}
-				}
+				// invert each byte of each pixel
+				InvertRows(src, FreeImage_GetLine(src));
 
 				break;
 			}
@@ -109,18 +278,8 @@ FreeImage_Invert(FIBITMAP *src) {
 		}
 	}
 	else if((image_type == FIT_UINT16) || (image_type == FIT_RGB16) || (image_type == FIT_RGBA16)) {
-		// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-		const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
-
-		for(y = 0; y < height; y++) {
-			WORD *bits = (WORD*)FreeImage_GetScanLine(src, y);
-			for(x = 0; x < width; x++) {
-				for(k = 0; k < wordspp; k++) {
-					bits[k] = ~bits[k];
-				}
-				bits += wordspp;
-			}
-		}
+		// invert each word of each pixel
+		InvertRows(src, FreeImage_GetLine(src));
 	}
 	else {
 		// anything else ... 
@@ -146,9 +305,6 @@ plane (R,G, and B). Otherwise, the LUT is applied to the specified channel only.
 */
 BOOL DLL_CALLCONV 
 FreeImage_AdjustCurve(FIBITMAP *src, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel) {
-	unsigned x, y;
-	BYTE *bits = NULL;
-
 	if(!FreeImage_HasPixels(src) || !LUT || (FreeImage_GetImageType(src) != FIT_BITMAP))
 		return FALSE;
 
@@ -174,12 +330,8 @@ FreeImage_AdjustCurve(FIBITMAP *src, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel
 				}
 			}
 			else {
-				for(y = 0; y < FreeImage_GetHeight(src); y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < FreeImage_GetWidth(src); x++) {
-						bits[x] = LUT[ bits[x] ];
-					}
-				}
+				const BYTE *channel_LUT[4] = { LUT, NULL, NULL, NULL };
+				ApplyLUTs(src, channel_LUT);
 			}
 
 			break;
@@ -188,71 +340,38 @@ FreeImage_AdjustCurve(FIBITMAP *src, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel
 		case 24 :
 		case 32 :
 		{
-			int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+			// LUT applied to each byte of a pixel
+			const BYTE *channel_LUT[4] = { NULL, NULL, NULL, NULL };
 
 			switch(channel) {
 				case FICC_RGB :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE]	= LUT[ bits[FI_RGBA_BLUE] ];	// B
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							bits[FI_RGBA_RED]	= LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
+					channel_LUT[FI_RGBA_BLUE]	= LUT;	// B
+					channel_LUT[FI_RGBA_GREEN]	= LUT;	// G
+					channel_LUT[FI_RGBA_RED]	= LUT;	// R
 					break;
 
 				case FICC_BLUE :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE] = LUT[ bits[FI_RGBA_BLUE] ];		// B
-							
-							bits += bytespp;
-						}
-					}
+					channel_LUT[FI_RGBA_BLUE]	= LUT;	// B
 					break;
 
 				case FICC_GREEN :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							
-							bits += bytespp;
-						}
-					}
+					channel_LUT[FI_RGBA_GREEN]	= LUT;	// G
 					break;
 
 				case FICC_RED :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_RED] = LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
+					channel_LUT[FI_RGBA_RED]	= LUT;	// R
 					break;
 					
 				case FICC_ALPHA :
 					if(32 == bpp) {
-						for(y = 0; y < FreeImage_GetHeight(src); y++) {
-							bits =  FreeImage_GetScanLine(src, y);
-							for(x = 0; x < FreeImage_GetWidth(src); x++) {
-								bits[FI_RGBA_ALPHA] = LUT[ bits[FI_RGBA_ALPHA] ];	// A
-								
-								bits += bytespp;
-							}
-						}
+						channel_LUT[FI_RGBA_ALPHA] = LUT;	// A
 					}
 					break;
 
 				default:
 					break;
 			}
+			ApplyLUTs(src, channel_LUT);
 			break;
 		}
 	}
@@ -353,88 +472,41 @@ bit depth is not supported (nothing is done).
 */
 BOOL DLL_CALLCONV 
 FreeImage_GetHistogram(FIBITMAP *src, DWORD *histo, FREE_IMAGE_COLOR_CHANNEL channel) {
-	BYTE pixel;
-	BYTE *bits = NULL;
-	unsigned x, y;
-
 	if(!FreeImage_HasPixels(src) || !histo) return FALSE;
 
-	unsigned width  = FreeImage_GetWidth(src);
-	unsigned height = FreeImage_GetHeight(src);
 	unsigned bpp    = FreeImage_GetBPP(src);
 
 	if(bpp == 8) {
-		// clear histogram array
-		memset(histo, 0, 256 * sizeof(DWORD));
 		// compute histogram for black channel
-		for(y = 0; y < height; y++) {
-			bits = FreeImage_GetScanLine(src, y);
-			for(x = 0; x < width; x++) {
-				// get pixel value
-				pixel = bits[x];
-				histo[pixel]++;
-			}
-		}
+		CountValues(src, histo, 0);
 		return TRUE;
 	}
 	else if((bpp == 24) || (bpp == 32)) {
-		int bytespp = bpp / 8;	// bytes / pixel
-
-		// clear histogram array
-		memset(histo, 0, 256 * sizeof(DWORD));
-
 		switch(channel) {
 			case FICC_RED:
 				// compute histogram for red channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_RED];	// R
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				CountValues(src, histo, FI_RGBA_RED);
 				return TRUE;
 
 			case FICC_GREEN:
 				// compute histogram for green channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_GREEN];	// G
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				CountValues(src, histo, FI_RGBA_GREEN);
 				return TRUE;
 
 			case FICC_BLUE:
 				// compute histogram for blue channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_BLUE];	// B
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				CountValues(src, histo, FI_RGBA_BLUE);
 				return TRUE;
 
 			case FICC_BLACK:
 			case FICC_RGB:
-				// compute histogram for black channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						// RGB to GREY conversion
-						pixel = GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE]);
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				// compute histogram for black channel (RGB to GREY conversion)
+				CountValues(src, histo, -1);
 				return TRUE;
 				
 			default:
+				// clear histogram array
+				memset(histo, 0, 256 * sizeof(DWORD));
 				return FALSE;
 		}
 	}
@@ -25,11 +25,193 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// minimum number of bytes processed by a band of rows
+#define PASTE_GRAIN	(256 * 1024)
 
 // ----------------------------------------------------------
 //   Helpers
 // ----------------------------------------------------------
 
+/**
+Alpha blend a line of bytes with a constant alpha: dst = (src * alpha + dst * (256 - alpha)) / 256
+*/
+static void 
+BlendLine(BYTE *dst, const BYTE *src, unsigned count, unsigned alpha) {
+	unsigned i = 0;
+#ifdef FREEIMAGE_SSE2
+	// the sum of both products is at most 255 * 256 and fits in 16-bit unsigned lanes
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i a = _mm_set1_epi16((short)alpha);
+	const __m128i not_a = _mm_set1_epi16((short)(256 - alpha));
+	for(; i + 16 <= count; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), a), _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), not_a));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), a), _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), not_a));
+		lo = _mm_srli_epi16(lo, 8);
+		hi = _mm_srli_epi16(hi, 8);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for(; i < count; i++) {
+		dst[i] = (BYTE)(((src[i] - dst[i]) * alpha + (dst[i] << 8)) >> 8);
+	}
+}
+
+/**
+Copy (alpha > 255) or alpha blend with a constant alpha the rows of src over the rows of dst, by bands of rows
+*/
+static void 
+CombineRows(BYTE *dst_bits, unsigned dst_pitch, const BYTE *src_bits, unsigned src_pitch, unsigned line, unsigned height, unsigned alpha) {
+	ParallelFor(0, height, MAX(1U, PASTE_GRAIN / MAX(1U, line)), [=](unsigned first, unsigned last) {
+		for(unsigned rows = first; rows < last; rows++) {
+			BYTE *dst = dst_bits + (size_t)rows * dst_pitch;
+			const BYTE *src = src_bits + (size_t)rows * src_pitch;
+			if(alpha > 255) {
+				memcpy(dst, src, line);
+			} else {
+				BlendLine(dst, src, line, alpha);
+			}
+		}
+	});
+}
+
+/**
+Blend 32-bit pixels holding premultiplied alpha: dst = src + dst * (255 - src_alpha) / 255
+*/
+static void 
+BlendPremultipliedLine(BYTE *dst, const BYTE *src, unsigned width) {
+	unsigned x = 0;
+#if defined(FREEIMAGE_SSE2) && (FI_RGBA_ALPHA == 3)
+	// t / 255 == (t + 1 + (t >> 8)) >> 8 for t < 65535
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i half = _mm_set1_epi16(127);
+	const __m128i inv_mask = _mm_set1_epi8(-1);
+	for(; x + 4 <= width; x += 4) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + 4 * x));
+		const __m128i d = _mm_loadu_si128((const __m128i*)(dst + 4 * x));
+		// 255 - alpha in each byte of a pixel
+		__m128i a = _mm_srli_epi32(s, 24);
+		a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+		a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+		const __m128i inv = _mm_xor_si128(a, inv_mask);
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(inv, zero)), half);
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(inv, zero)), half);
+		lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, ones), _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, ones), _mm_srli_epi16(hi, 8)), 8);
+		_mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+	}
+#endif
+	for(src += 4 * x, dst += 4 * x; x < width; x++, src += 4, dst += 4) {
+		const unsigned inv = 255 - src[FI_RGBA_ALPHA];
+		for(int c = 0; c < 4; c++) {
+			dst[c] = (BYTE)MIN(255U, src[c] + (dst[c] * inv + 127) / 255);
+		}
+	}
+}
+
+/**
+Blend 32-bit pixels holding straight alpha with the Porter-Duff 'over' operator, rounding to nearest
+*/
+static void 
+BlendStraightLine(BYTE *dst, const BYTE *src, unsigned width) {
+	for(unsigned x = 0; x < width; x++, src += 4, dst += 4) {
+		const unsigned sa = src[FI_RGBA_ALPHA];
+		if(sa == 255) {
+			memcpy(dst, src, 4);
+		} else if(sa != 0) {
+			// weights scaled by 255 * 255
+			const unsigned w = dst[FI_RGBA_ALPHA] * (255 - sa);
+			const unsigned sum = sa * 255 + w;
+			dst[FI_RGBA_BLUE]  = (BYTE)((src[FI_RGBA_BLUE]  * sa * 255 + dst[FI_RGBA_BLUE]  * w + sum / 2) / sum);
+			dst[FI_RGBA_GREEN] = (BYTE)((src[FI_RGBA_GREEN] * sa * 255 + dst[FI_RGBA_GREEN] * w + sum / 2) / sum);
+			dst[FI_RGBA_RED]   = (BYTE)((src[FI_RGBA_RED]   * sa * 255 + dst[FI_RGBA_RED]   * w + sum / 2) / sum);
+			dst[FI_RGBA_ALPHA] = (BYTE)((sum + 127) / 255);
+		}
+	}
+}
+
+#ifdef FREEIMAGE_SSE2
+/**
+Blend a RGBAF pixel holding premultiplied alpha: dst = src + dst * (1 - src_alpha)
+*/
+static inline __m128 
+BlendPremultipliedPixelF(__m128 s, __m128 d) {
+	const __m128 sa = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+	return _mm_add_ps(s, _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(1), sa)));
+}
+
+/**
+Blend a RGBAF pixel holding straight alpha, without branches: 
+the color is zero when the blended alpha is not positive, as in the scalar loop
+*/
+static inline __m128 
+BlendStraightPixelF(__m128 s, __m128 d) {
+	const __m128 alpha_lane = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+	const __m128 sa = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+	const __m128 da = _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3));
+	const __m128 w = _mm_mul_ps(da, _mm_sub_ps(_mm_set1_ps(1), sa));
+	const __m128 alpha = _mm_add_ps(sa, w);
+	__m128 color = _mm_div_ps(_mm_add_ps(_mm_mul_ps(s, sa), _mm_mul_ps(d, w)), alpha);
+	color = _mm_and_ps(color, _mm_cmpgt_ps(alpha, _mm_setzero_ps()));
+	return _mm_or_ps(_mm_andnot_ps(alpha_lane, color), _mm_and_ps(alpha_lane, alpha));
+}
+#endif // FREEIMAGE_SSE2
+
+/**
+Blend RGBAF pixels with the Porter-Duff 'over' operator, holding premultiplied or straight alpha
+*/
+static void 
+BlendLineRGBAF(FIRGBAF *dst, const FIRGBAF *src, unsigned width, BOOL premultiplied) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	// one pixel per register, two independent pixels per iteration
+	if(premultiplied) {
+		for(; x + 2 <= width; x += 2) {
+			const __m128 p0 = BlendPremultipliedPixelF(_mm_loadu_ps((const float*)&src[x]), _mm_loadu_ps((const float*)&dst[x]));
+			const __m128 p1 = BlendPremultipliedPixelF(_mm_loadu_ps((const float*)&src[x + 1]), _mm_loadu_ps((const float*)&dst[x + 1]));
+			_mm_storeu_ps((float*)&dst[x], p0);
+			_mm_storeu_ps((float*)&dst[x + 1], p1);
+		}
+	} else {
+		for(; x + 2 <= width; x += 2) {
+			const __m128 p0 = BlendStraightPixelF(_mm_loadu_ps((const float*)&src[x]), _mm_loadu_ps((const float*)&dst[x]));
+			const __m128 p1 = BlendStraightPixelF(_mm_loadu_ps((const float*)&src[x + 1]), _mm_loadu_ps((const float*)&dst[x + 1]));
+			_mm_storeu_ps((float*)&dst[x], p0);
+			_mm_storeu_ps((float*)&dst[x + 1], p1);
+		}
+	}
+#endif
+	for(; x < width; x++) {
+		const float sa = src[x].alpha;
+		if(premultiplied) {
+			const float inv = 1 - sa;
+			dst[x].red   = src[x].red   + dst[x].red   * inv;
+			dst[x].green = src[x].green + dst[x].green * inv;
+			dst[x].blue  = src[x].blue  + dst[x].blue  * inv;
+			dst[x].alpha = src[x].alpha + dst[x].alpha * inv;
+		} else {
+			const float w = dst[x].alpha * (1 - sa);
+			const float alpha = sa + w;
+			if(alpha > 0) {
+				dst[x].red   = (src[x].red   * sa + dst[x].red   * w) / alpha;
+				dst[x].green = (src[x].green * sa + dst[x].green * w) / alpha;
+				dst[x].blue  = (src[x].blue  * sa + dst[x].blue  * w) / alpha;
+			} else {
+				dst[x].red = dst[x].green = dst[x].blue = 0;
+			}
+			dst[x].alpha = alpha;
+		}
+	}
+}
+
 /////////////////////////////////////////////////////////////
 // Alpha blending / combine functions
 
@@ -208,25 +390,8 @@ Combine8(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x);
 	BYTE *src_bits = FreeImage_GetBits(src_dib);	
 
-	if(alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// combine or alpha blend images
+	CombineRows(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetLine(src_dib), FreeImage_GetHeight(src_dib), alpha);
 
 	return TRUE;
 }
@@ -374,25 +539,8 @@ Combine24(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 3);
 	BYTE *src_bits = FreeImage_GetBits(src_dib);	
 
-	if(alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// combine or alpha blend images
+	CombineRows(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetLine(src_dib), FreeImage_GetHeight(src_dib), alpha);
 
 	return TRUE;
 }
@@ -416,25 +564,8 @@ Combine32(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 4);
 	BYTE *src_bits = FreeImage_GetBits(src_dib);	
 
-	if (alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for(unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// combine or alpha blend images
+	CombineRows(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetLine(src_dib), FreeImage_GetHeight(src_dib), alpha);
 
 	return TRUE;
 }
@@ -467,12 +598,7 @@ CombineSameType(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y) {
 	BYTE *src_bits = FreeImage_GetBits(src_dib);	
 
 	// combine images	
-	for(unsigned rows = 0; rows < src_height; rows++) {
-		memcpy(dst_bits, src_bits, src_line);
-
-		dst_bits += dst_pitch;
-		src_bits += src_pitch;
-	}
+	CombineRows(dst_bits, dst_pitch, src_bits, src_pitch, src_line, src_height, 256);
 
 	return TRUE;
 }
@@ -744,6 +870,65 @@ FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha) {
 	return bResult;
 }
 
+/**
+Alpha blend a sub part image with the current image, using the alpha channel of the sub part image.
+The result is the Porter-Duff 'over' operation: src is drawn over dst, and the dst alpha channel 
+receives the alpha of the combined image.<br>
+Both images must be 32-bit FIT_BITMAP images or FIT_RGBAF images. 
+@param dst Destination image
+@param src Source subimage
+@param left Specifies the left position of the sub image. 
+@param top Specifies the top position of the sub image. 
+@param premultiplied If TRUE, the color channels of both images are premultiplied with their 
+alpha channel (see FreeImage_PreMultiplyWithAlpha), and each channel is computed as 
+dst = src + dst * (1 - src_alpha). Otherwise, both images hold straight alpha.
+@return Returns TRUE if successful, FALSE otherwise.
+@see FreeImage_Paste
+*/
+BOOL DLL_CALLCONV 
+FreeImage_PasteWithAlpha(FIBITMAP *dst, FIBITMAP *src, int left, int top, BOOL premultiplied) {
+	if(!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst)) return FALSE;
+
+	// check the size of src image
+	if((left < 0) || (top < 0)) {
+		return FALSE;
+	}
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	if((left + width > FreeImage_GetWidth(dst)) || (top + height > FreeImage_GetHeight(dst))) {
+		return FALSE;
+	}
+
+	// check data type
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dst);
+	if((image_type != FreeImage_GetImageType(src)) || (FreeImage_GetBPP(src) != FreeImage_GetBPP(dst))) {
+		return FALSE;
+	}
+	if(!((image_type == FIT_BITMAP) && (FreeImage_GetBPP(src) == 32)) && (image_type != FIT_RGBAF)) {
+		return FALSE;
+	}
+
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+
+	ParallelFor(0, height, MAX(1U, PASTE_GRAIN / FreeImage_GetLine(src)), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			// scanlines are stored bottom-up
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, FreeImage_GetHeight(dst) - top - height + y) + left * bytespp;
+			const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+
+			if(image_type == FIT_RGBAF) {
+				BlendLineRGBAF((FIRGBAF*)dst_bits, (const FIRGBAF*)src_bits, width, premultiplied);
+			} else if(premultiplied) {
+				BlendPremultipliedLine(dst_bits, src_bits, width);
+			} else {
+				BlendStraightLine(dst_bits, src_bits, width);
+			}
+		}
+	});
+
+	return TRUE;
+}
+
 // ----------------------------------------------------------
 
 /** @brief Creates a dynamic read/write view into a FreeImage bitmap.
@@ -21,6 +21,14 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// minimum number of pixels processed by a band of rows
+#define DISPLAY_GRAIN	(64 * 1024)
 
 
 /**
@@ -57,17 +65,11 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 			return NULL;
 	}
 
-	int bytespp = (bpp == 8) ? 1 : 4;
+	const int bytespp = (bpp == 8) ? 1 : 4;
 
-	
-	int x, y, c;
-	BYTE alpha = 0, not_alpha;
-	BYTE index;
-	RGBQUAD fgc;	// foreground color
-	RGBQUAD bkc;	// background color
+	RGBQUAD file_bkc;	// background color
 
-	memset(&fgc, 0, sizeof(RGBQUAD));
-	memset(&bkc, 0, sizeof(RGBQUAD));
+	memset(&file_bkc, 0, sizeof(RGBQUAD));
 
 	// allocate the composite image
 	FIBITMAP *composite = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
@@ -84,13 +86,13 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 	BOOL bHasBkColor = FALSE;
 
 	if(useFileBkg && FreeImage_HasBackgroundColor(fg)) {
-		FreeImage_GetBackgroundColor(fg, &bkc);
+		FreeImage_GetBackgroundColor(fg, &file_bkc);
 		bHasBkColor = TRUE;
 	} else {
 		// no file background color
 		// use application background color ?
 		if(appBkColor) {
-			memcpy(&bkc, appBkColor, sizeof(RGBQUAD));
+			memcpy(&file_bkc, appBkColor, sizeof(RGBQUAD));
 			bHasBkColor = TRUE;
 		}
 		// use background image ?
@@ -99,84 +101,93 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 		}
 	}
 
-	for(y = 0; y < height; y++) {
-		// foreground
-		BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
-		// background
-		BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
-		// composite image
-		BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
-
-		for(x = 0; x < width; x++) {
-
-			// foreground color + alpha
-
-			if(bpp == 8) {
-				// get the foreground color
-				index = fg_bits[0];
-				memcpy(&fgc, &pal[index], sizeof(RGBQUAD));
-				// get the alpha
-				if(bIsTransparent) {
-					alpha = trns[index];
-				} else {
-					alpha = 255;
+	// composite by bands of rows
+	ParallelFor(0, height, MAX(1, DISPLAY_GRAIN / width), [=](unsigned first, unsigned last) {
+		int x, y, c;
+		BYTE alpha = 0, not_alpha;
+		BYTE index;
+		RGBQUAD fgc = { 0, 0, 0, 0 };	// foreground color
+		RGBQUAD bkc = file_bkc;			// background color
+
+		for(y = (int)first; y < (int)last; y++) {
+			// foreground
+			BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
+			// background
+			BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
+			// composite image
+			BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
+
+			for(x = 0; x < width; x++) {
+
+				// foreground color + alpha
+
+				if(bpp == 8) {
+					// get the foreground color
+					index = fg_bits[0];
+					memcpy(&fgc, &pal[index], sizeof(RGBQUAD));
+					// get the alpha
+					if(bIsTransparent) {
+						alpha = trns[index];
+					} else {
+						alpha = 255;
+					}
+				}
+				else if(bpp == 32) {
+					// get the foreground color
+					fgc.rgbBlue  = fg_bits[FI_RGBA_BLUE];
+					fgc.rgbGreen = fg_bits[FI_RGBA_GREEN];
+					fgc.rgbRed   = fg_bits[FI_RGBA_RED];
+					// get the alpha
+					alpha = fg_bits[FI_RGBA_ALPHA];
+				}
+
+				// background color
+
+				if(!bHasBkColor) {
+					if(bg) {
+						// get the background color from the background image
+						bkc.rgbBlue  = bg_bits[FI_RGBA_BLUE];
+						bkc.rgbGreen = bg_bits[FI_RGBA_GREEN];
+						bkc.rgbRed   = bg_bits[FI_RGBA_RED];
+					}
+					else {
+						// use a checkerboard pattern
+						c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
+						c = c ? c : 255;
+						bkc.rgbBlue  = (BYTE)c;
+						bkc.rgbGreen = (BYTE)c;
+						bkc.rgbRed   = (BYTE)c;
+					}
 				}
-			}
-			else if(bpp == 32) {
-				// get the foreground color
-				fgc.rgbBlue  = fg_bits[FI_RGBA_BLUE];
-				fgc.rgbGreen = fg_bits[FI_RGBA_GREEN];
-				fgc.rgbRed   = fg_bits[FI_RGBA_RED];
-				// get the alpha
-				alpha = fg_bits[FI_RGBA_ALPHA];
-			}
 
-			// background color
+				// composition
 
-			if(!bHasBkColor) {
-				if(bg) {
-					// get the background color from the background image
-					bkc.rgbBlue  = bg_bits[FI_RGBA_BLUE];
-					bkc.rgbGreen = bg_bits[FI_RGBA_GREEN];
-					bkc.rgbRed   = bg_bits[FI_RGBA_RED];
+				if(alpha == 0) {
+					// output = background
+					cp_bits[FI_RGBA_BLUE] = bkc.rgbBlue;
+					cp_bits[FI_RGBA_GREEN] = bkc.rgbGreen;
+					cp_bits[FI_RGBA_RED] = bkc.rgbRed;
+				}
+				else if(alpha == 255) {
+					// output = foreground
+					cp_bits[FI_RGBA_BLUE] = fgc.rgbBlue;
+					cp_bits[FI_RGBA_GREEN] = fgc.rgbGreen;
+					cp_bits[FI_RGBA_RED] = fgc.rgbRed;
 				}
 				else {
-					// use a checkerboard pattern
-					c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
-					c = c ? c : 255;
-					bkc.rgbBlue  = (BYTE)c;
-					bkc.rgbGreen = (BYTE)c;
-					bkc.rgbRed   = (BYTE)c;
+					// output = alpha * foreground + (1-alpha) * background
+					not_alpha = (BYTE)~alpha;
+					cp_bits[FI_RGBA_BLUE] = (BYTE)((alpha * (WORD)fgc.rgbBlue  + not_alpha * (WORD)bkc.rgbBlue) >> 8);
+					cp_bits[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)fgc.rgbGreen + not_alpha * (WORD)bkc.rgbGreen) >> 8);
+					cp_bits[FI_RGBA_RED] = (BYTE)((alpha * (WORD)fgc.rgbRed   + not_alpha * (WORD)bkc.rgbRed) >> 8);
 				}
-			}
-
-			// composition
 
-			if(alpha == 0) {
-				// output = background
-				cp_bits[FI_RGBA_BLUE] = bkc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = bkc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = bkc.rgbRed;
+				fg_bits += bytespp;
+				bg_bits += 3;
+				cp_bits += 3;
 			}
-			else if(alpha == 255) {
-				// output = foreground
-				cp_bits[FI_RGBA_BLUE] = fgc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = fgc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = fgc.rgbRed;
-			}
-			else {
-				// output = alpha * foreground + (1-alpha) * background
-				not_alpha = (BYTE)~alpha;
-				cp_bits[FI_RGBA_BLUE] = (BYTE)((alpha * (WORD)fgc.rgbBlue  + not_alpha * (WORD)bkc.rgbBlue) >> 8);
-				cp_bits[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)fgc.rgbGreen + not_alpha * (WORD)bkc.rgbGreen) >> 8);
-				cp_bits[FI_RGBA_RED] = (BYTE)((alpha * (WORD)fgc.rgbRed   + not_alpha * (WORD)bkc.rgbRed) >> 8);
-			}
-
-			fg_bits += bytespp;
-			bg_bits += 3;
-			cp_bits += 3;
 		}
-	}
+	});
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(composite, fg);
@@ -184,47 +195,143 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 	return composite;	
 }
 
+// ----------------------------------------------------------
+//   Alpha premultiplication
+// ----------------------------------------------------------
+
+/**
+Pre-multiply a row of 32-bit pixels: c = (c * a + 127) / 255, alpha is left unchanged
+*/
+static void
+PreMultiplyLine(BYTE *bits, unsigned width) {
+	unsigned x = 0;
+#if defined(FREEIMAGE_SSE2) && (FI_RGBA_ALPHA == 3)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(127);
+	const __m128i one = _mm_set1_epi16(1);
+	// keeps the alpha lane of each pixel untouched
+	const __m128i keep = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	for(; x + 4 <= width; x += 4, bits += 16) {
+		const __m128i p = _mm_loadu_si128((const __m128i*)bits);
+		__m128i lo = _mm_unpacklo_epi8(p, zero);
+		__m128i hi = _mm_unpackhi_epi8(p, zero);
+		// broadcast the alpha of each pixel to its 4 lanes, force the alpha factor to 255
+		__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+		__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+		alo = _mm_or_si128(_mm_andnot_si128(keep, alo), _mm_and_si128(keep, _mm_set1_epi16(255)));
+		ahi = _mm_or_si128(_mm_andnot_si128(keep, ahi), _mm_and_si128(keep, _mm_set1_epi16(255)));
+		// t = c * a + 127, t / 255 == (t + 1 + (t >> 8)) >> 8 for t < 65535
+		__m128i tlo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), bias);
+		__m128i thi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), bias);
+		tlo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(tlo, one), _mm_srli_epi16(tlo, 8)), 8);
+		thi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(thi, one), _mm_srli_epi16(thi, 8)), 8);
+		_mm_storeu_si128((__m128i*)bits, _mm_packus_epi16(tlo, thi));
+	}
+#endif
+	for(; x < width; x++, bits += 4) {
+		const WORD alpha = bits[FI_RGBA_ALPHA];
+		bits[FI_RGBA_BLUE] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_BLUE] + 127) / 255 );
+		bits[FI_RGBA_GREEN] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_GREEN] + 127) / 255 );
+		bits[FI_RGBA_RED] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_RED] + 127) / 255 );
+	}
+}
+
+/**
+Undo PreMultiplyLine: c = (c * 255 + a / 2) / a, clamped to 255. Pixels with a zero alpha become black.
+*/
+static void
+UnPreMultiplyLine(BYTE *bits, unsigned width) {
+	for(unsigned x = 0; x < width; x++, bits += 4) {
+		const unsigned alpha = bits[FI_RGBA_ALPHA];
+		if(alpha == 0xFF) {
+			continue;
+		}
+		if(alpha == 0x00) {
+			bits[FI_RGBA_BLUE] = 0x00;
+			bits[FI_RGBA_GREEN] = 0x00;
+			bits[FI_RGBA_RED] = 0x00;
+		} else {
+			const unsigned half = alpha / 2;
+			bits[FI_RGBA_BLUE] = (BYTE)MIN(255U, (bits[FI_RGBA_BLUE] * 255U + half) / alpha);
+			bits[FI_RGBA_GREEN] = (BYTE)MIN(255U, (bits[FI_RGBA_GREEN] * 255U + half) / alpha);
+			bits[FI_RGBA_RED] = (BYTE)MIN(255U, (bits[FI_RGBA_RED] * 255U + half) / alpha);
+		}
+	}
+}
+
+/**
+Pre-multiply or un-premultiply a 32-bit or RGBAF image by bands of rows
+*/
+static BOOL
+ConvertAlpha(FIBITMAP *dib, BOOL premultiply) {
+	if (!FreeImage_HasPixels(dib)) return FALSE;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	if (!(((image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) == 32)) || (image_type == FIT_RGBAF))) {
+		return FALSE;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	ParallelFor(0, height, MAX(1U, DISPLAY_GRAIN / width), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			if(image_type == FIT_BITMAP) {
+				BYTE *bits = FreeImage_GetScanLine(dib, y);
+				if(premultiply) {
+					PreMultiplyLine(bits, width);
+				} else {
+					UnPreMultiplyLine(bits, width);
+				}
+			} else {
+				FIRGBAF *pixel = (FIRGBAF*)FreeImage_GetScanLine(dib, y);
+				for(unsigned x = 0; x < width; x++, pixel++) {
+					const float alpha = pixel->alpha;
+					if(premultiply) {
+						pixel->red *= alpha;
+						pixel->green *= alpha;
+						pixel->blue *= alpha;
+					} else if(alpha > 0) {
+						pixel->red /= alpha;
+						pixel->green /= alpha;
+						pixel->blue /= alpha;
+					} else {
+						pixel->red = pixel->green = pixel->blue = 0;
+					}
+				}
+			}
+		}
+	});
+
+	return TRUE;
+}
+
 /**
 Pre-multiplies a 32-bit image's red-, green- and blue channels with it's alpha channel 
 for to be used with e.g. the Windows GDI function AlphaBlend(). 
 The transformation changes the red-, green- and blue channels according to the following equation:  
 channel(x, y) = channel(x, y) * alpha_channel(x, y) / 255  
+FIT_RGBAF images are also accepted, their channels are multiplied by the (unit) alpha.
 @param dib Input/Output dib to be premultiplied
 @return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
+@see FreeImage_UnPreMultiplyWithAlpha
 */
 BOOL DLL_CALLCONV 
 FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
-	if (!FreeImage_HasPixels(dib)) return FALSE;
-	
-	if ((FreeImage_GetBPP(dib) != 32) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
-		return FALSE;
-	}
+	return ConvertAlpha(dib, TRUE);
+}
 
-	int width = FreeImage_GetWidth(dib);
-	int height = FreeImage_GetHeight(dib);
-
-	for(int y = 0; y < height; y++) {
-		BYTE *bits = FreeImage_GetScanLine(dib, y);
-		for (int x = 0; x < width; x++, bits += 4) {
-			const BYTE alpha = bits[FI_RGBA_ALPHA];
-			// slightly faster: care for two special cases
-			if(alpha == 0x00) {
-				// special case for alpha == 0x00
-				// color * 0x00 / 0xFF = 0x00
-				bits[FI_RGBA_BLUE] = 0x00;
-				bits[FI_RGBA_GREEN] = 0x00;
-				bits[FI_RGBA_RED] = 0x00;
-			} else if(alpha == 0xFF) {
-				// nothing to do for alpha == 0xFF
-				// color * 0xFF / 0xFF = color
-				continue;
-			} else {
-				bits[FI_RGBA_BLUE] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_BLUE] + 127) / 255 );
-				bits[FI_RGBA_GREEN] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_GREEN] + 127) / 255 );
-				bits[FI_RGBA_RED] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_RED] + 127) / 255 );
-			}
-		}
-	}
-	return TRUE;
+/**
+Reverts FreeImage_PreMultiplyWithAlpha on a 32-bit or FIT_RGBAF image. 
+The transformation changes the red-, green- and blue channels according to the following equation:  
+channel(x, y) = channel(x, y) * 255 / alpha_channel(x, y)  
+Fully transparent pixels are set to black.
+@param dib Input/Output dib to be un-premultiplied
+@return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
+@see FreeImage_PreMultiplyWithAlpha
+*/
+BOOL DLL_CALLCONV 
+FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib) {
+	return ConvertAlpha(dib, FALSE);
 }
 
@@ -23,6 +23,133 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// minimum number of bytes processed by a band of rows
+#define FLIP_GRAIN	(256 * 1024)
+
+// ----------------------------------------------------------
+
+/**
+Reverse the order of the pixels of a row, in place
+*/
+template <unsigned N> static void 
+ReversePixelsT(BYTE *bits, unsigned width) {
+	PixelBytes<N> *left = (PixelBytes<N>*)bits;
+	PixelBytes<N> *right = left + width - 1;
+	while(left < right) {
+		const PixelBytes<N> tmp = *left;
+		*left++ = *right;
+		*right-- = tmp;
+	}
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Reverse the order of the 1-, 2- or 4-byte pixels of a 16-byte vector
+*/
+template <unsigned N> static inline __m128i 
+ReverseVector(__m128i v) {
+	if(N == 1) {
+		// swap the bytes of each word, then reverse the words
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	}
+	if(N <= 2) {
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	}
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+/**
+Reverse the order of the 1-, 2- or 4-byte pixels of a row, in place, 16 bytes at a time from both ends
+*/
+template <unsigned N> static void 
+ReversePixelsSSE2(BYTE *bits, unsigned width) {
+	BYTE *left = bits;
+	BYTE *right = bits + width * N;
+	while(right - left >= 32) {
+		right -= 16;
+		const __m128i l = _mm_loadu_si128((const __m128i*)left);
+		const __m128i r = _mm_loadu_si128((const __m128i*)right);
+		_mm_storeu_si128((__m128i*)left, ReverseVector<N>(r));
+		_mm_storeu_si128((__m128i*)right, ReverseVector<N>(l));
+		left += 16;
+	}
+	// middle of the row
+	ReversePixelsT<N>(left, (unsigned)(right - left) / N);
+}
+
+#endif // FREEIMAGE_SSE2
+
+void 
+ReversePixels(BYTE *bits, unsigned width, unsigned bytespp) {
+	switch(bytespp) {
+#ifdef FREEIMAGE_SSE2
+		case 1:
+			ReversePixelsSSE2<1>(bits, width);
+			break;
+		case 2:
+			ReversePixelsSSE2<2>(bits, width);
+			break;
+		case 4:
+			ReversePixelsSSE2<4>(bits, width);
+			break;
+#else
+		case 1:
+			ReversePixelsT<1>(bits, width);
+			break;
+		case 2:
+			ReversePixelsT<2>(bits, width);
+			break;
+		case 4:
+			ReversePixelsT<4>(bits, width);
+			break;
+#endif // FREEIMAGE_SSE2
+		case 3:
+			ReversePixelsT<3>(bits, width);
+			break;
+		case 6:
+			ReversePixelsT<6>(bits, width);
+			break;
+		case 8:
+			ReversePixelsT<8>(bits, width);
+			break;
+		case 12:
+			ReversePixelsT<12>(bits, width);
+			break;
+		case 16:
+			ReversePixelsT<16>(bits, width);
+			break;
+		default:
+			assert(FALSE);
+	}
+}
+
+/**
+Swap the content of two rows
+*/
+static void 
+SwapRows(BYTE *row1, BYTE *row2, unsigned size) {
+	BYTE buffer[1024];
+	while(size > 0) {
+		const unsigned count = MIN(size, (unsigned)sizeof(buffer));
+		memcpy(buffer, row1, count);
+		memcpy(row1, row2, count);
+		memcpy(row2, buffer, count);
+		row1 += count;
+		row2 += count;
+		size -= count;
+	}
+}
+
+// ----------------------------------------------------------
 
 /**
 Flip the image horizontally along the vertical axis.
@@ -33,90 +160,62 @@ BOOL DLL_CALLCONV
 FreeImage_FlipHorizontal(FIBITMAP *src) {
 	if (!FreeImage_HasPixels(src)) return FALSE;
 
-	unsigned line   = FreeImage_GetLine(src);
-	unsigned width	= FreeImage_GetWidth(src);
-	unsigned height = FreeImage_GetHeight(src);
-
-	unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+	const unsigned line   = FreeImage_GetLine(src);
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bpp    = FreeImage_GetBPP(src);
 
-	// copy between aligned memories
-	BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
-	if (!new_bits) return FALSE;
+	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-	// mirror the buffer
+	if (bpp == 1) {
+		// copy between aligned memories
+		BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
+		if (!new_bits) return FALSE;
 
-	for (unsigned y = 0; y < height; y++) {
-		BYTE *bits = FreeImage_GetScanLine(src, y);
-		memcpy(new_bits, bits, line);
+		for (unsigned y = 0; y < height; y++) {
+			BYTE *bits = FreeImage_GetScanLine(src, y);
+			memcpy(new_bits, bits, line);
 
-		switch (FreeImage_GetBPP(src)) {
-			case 1 :
-			{				
-				for(unsigned x = 0; x < width; x++) {
-					// get pixel at (x, y)
-					BOOL value = (new_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
-					// set pixel at (new_x, y)
-					unsigned new_x = width - 1 - x;
-					value ? bits[new_x >> 3] |= (0x80 >> (new_x & 0x7)) : bits[new_x >> 3] &= (0xff7f >> (new_x & 0x7));
-				}
+			for(unsigned x = 0; x < width; x++) {
+				// get pixel at (x, y)
+				BOOL value = (new_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
+				// set pixel at (new_x, y)
+				unsigned new_x = width - 1 - x;
+				value ? bits[new_x >> 3] |= (0x80 >> (new_x & 0x7)) : bits[new_x >> 3] &= (0xff7f >> (new_x & 0x7));
 			}
-			break;
-
-			case 4 :
-			{
-				for(unsigned c = 0; c < line; c++) {
-					bits[c] = new_bits[line - c - 1];
+		}
 
-					BYTE nibble = (bits[c] & 0xF0) >> 4;
+		FreeImage_Aligned_Free(new_bits);
 
-					bits[c] = bits[c] << 4;
-					bits[c] |= nibble;
-				}
-			}
-			break;
+		return TRUE;
+	}
 
-			case 8:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
+	// mirror the rows in place, by bands of rows
 
-			case 16:
-			{				
-				WORD *dst_data = (WORD*) bits; 				
-				WORD *src_data = (WORD*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
+	ParallelFor(0, height, MAX(1U, FLIP_GRAIN / line), [=](unsigned first, unsigned last) {
+		switch (bpp) {
+			case 4 :
+			{
+				for (unsigned y = first; y < last; y++) {
+					BYTE *bits = FreeImage_GetScanLine(src, y);
+					// reverse the bytes, then swap the nibbles of each byte
+					ReversePixels(bits, line, 1);
+					for(unsigned c = 0; c < line; c++) {
+						bits[c] = (BYTE)((bits[c] << 4) | (bits[c] >> 4));
+					}
+				}
 			}
 			break;
 
-			case 24 :
-			case 32 :
-			case 48:
-			case 64:
-			case 96:
-			case 128:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 		
-					for(unsigned k = 0; k < bytespp; k++) {
-						*dst_data++ = src_data[k];  
-					}
-					src_data -= bytespp;
-				} 
+			default:
+			{
+				for (unsigned y = first; y < last; y++) {
+					ReversePixels(FreeImage_GetScanLine(src, y), width, bytespp);
+				}
 			}
 			break;
-
 		}
-	}
-
-	FreeImage_Aligned_Free(new_bits);
+	});
 
 	return TRUE;
 }
@@ -130,37 +229,20 @@ Flip the image vertically along the horizontal axis.
 
 BOOL DLL_CALLCONV 
 FreeImage_FlipVertical(FIBITMAP *src) {
-	BYTE *From, *Mid;
-
 	if (!FreeImage_HasPixels(src)) return FALSE;
 
 	// swap the buffer
 
-	unsigned pitch  = FreeImage_GetPitch(src);
-	unsigned height = FreeImage_GetHeight(src);
-
-	// copy between aligned memories
-	Mid = (BYTE*)FreeImage_Aligned_Malloc(pitch * sizeof(BYTE), FIBITMAP_ALIGNMENT);
-	if (!Mid) return FALSE;
-
-	From = FreeImage_GetBits(src);
-	
-	unsigned line_s = 0;
-	unsigned line_t = (height-1) * pitch;
-
-	for(unsigned y = 0; y < height/2; y++) {
-
-		memcpy(Mid, From + line_s, pitch);
-		memcpy(From + line_s, From + line_t, pitch);
-		memcpy(From + line_t, Mid, pitch);
+	const unsigned pitch  = FreeImage_GetPitch(src);
+	const unsigned height = FreeImage_GetHeight(src);
 
-		line_s += pitch;
-		line_t -= pitch;
+	BYTE *bits = FreeImage_GetBits(src);
 
-	}
-
-	FreeImage_Aligned_Free(Mid);
+	ParallelFor(0, height / 2, MAX(1U, FLIP_GRAIN / pitch), [=](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			SwapRows(bits + y * pitch, bits + (height - 1 - y) * pitch, pitch);
+		}
+	});
 
 	return TRUE;
 }
-
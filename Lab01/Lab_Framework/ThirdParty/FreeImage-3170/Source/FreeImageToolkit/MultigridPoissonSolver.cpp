@@ -25,6 +25,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ThreadPool.h"
 
 static const int NPRE	= 1;		// Number of relaxation sweeps before ...
 static const int NPOST	= 1;		// ... and after the coarse-grid correction is computed
@@ -58,20 +59,21 @@ static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int nc) {
 	const float *uf_bits = (float*)FreeImage_GetBits(UF);
 
 	// interior points
-	{
-		float *uc_scan = uc_bits + uc_pitch;
-		for (row_uc = 1, row_uf = 2; row_uc < nc-1; row_uc++, row_uf += 2) {
-			const float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uc = 1, col_uf = 2; col_uc < nc-1; col_uc++, col_uf += 2) { 
-				// calculate 
-				// UC(row_uc, col_uc) = 
-				// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
-				float *uc_pixel = uc_scan + col_uc;
-				const float *uf_center = uf_scan + col_uf;
-				*uc_pixel = 0.5F * *uf_center + 0.125F * ( *(uf_center + uf_pitch) + *(uf_center - uf_pitch) + *(uf_center + 1) + *(uf_center - 1) );
+	if (nc > 2) {
+		ParallelFor(1, nc-1, ToneMappingGrain(nc), [=](unsigned first, unsigned last) {
+			for (int row_uc = first; row_uc < (int)last; row_uc++) {
+				float *uc_scan = uc_bits + row_uc * uc_pitch;
+				const float *uf_scan = uf_bits + 2 * row_uc * uf_pitch;
+				for (int col_uc = 1, col_uf = 2; col_uc < nc-1; col_uc++, col_uf += 2) { 
+					// calculate 
+					// UC(row_uc, col_uc) = 
+					// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
+					float *uc_pixel = uc_scan + col_uc;
+					const float *uf_center = uf_scan + col_uf;
+					*uc_pixel = 0.5F * *uf_center + 0.125F * ( *(uf_center + uf_pitch) + *(uf_center - uf_pitch) + *(uf_center + 1) + *(uf_center - 1) );
+				}
 			}
-			uc_scan += uc_pitch;
-		}
+		});
 	}
 	// boundary points
 	const int ncc = 2*nc-1;
@@ -130,8 +132,6 @@ solution is input as uc[0..nc-1][0..nc-1], where nc = nf/2 + 1. The fine-grid so
 returned in uf[0..nf-1][0..nf-1].
 */
 static void fmg_prolongate(FIBITMAP *UF, FIBITMAP *UC, int nf) {
-	int row_uc, row_uf, col_uc, col_uf;
-
 	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
 	const int uc_pitch  = FreeImage_GetPitch(UC) / sizeof(float);
 	
@@ -142,46 +142,68 @@ static void fmg_prolongate(FIBITMAP *UF, FIBITMAP *UC, int nf) {
 	{
 		const int nc = nf/2 + 1;
 
-		float *uf_scan = uf_bits;
-		const float *uc_scan = uc_bits;		
-		for (row_uc = 0; row_uc < nc; row_uc++) {
-			for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-				// calculate UF(2*row_uc, col_uf) = UC(row_uc, col_uc);
-				uf_scan[col_uf] = uc_scan[col_uc];
+		ParallelFor(0, nc, ToneMappingGrain(nc), [=](unsigned first, unsigned last) {
+			for (int row_uc = first; row_uc < (int)last; row_uc++) {
+				float *uf_scan = uf_bits + 2 * row_uc * uf_pitch;
+				const float *uc_scan = uc_bits + row_uc * uc_pitch;
+				for (int col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
+					// calculate UF(2*row_uc, col_uf) = UC(row_uc, col_uc);
+					uf_scan[col_uf] = uc_scan[col_uc];
+				}
 			}
-			uc_scan += uc_pitch;
-			uf_scan += 2 * uf_pitch;
-		}
+		});
 	}
-	// do odd-numbered columns, interpolating vertically
-	{		
-		for(row_uf = 1; row_uf < nf-1; row_uf += 2) {
+	// interpolate the odd-numbered rows vertically, then every row horizontally: 
+	// the vertical pass only reads the copied elements, so both can be done row by row
+	ParallelFor(0, nf, ToneMappingGrain(nf), [=](unsigned first, unsigned last) {
+		for (int row_uf = first; row_uf < (int)last; row_uf++) {
 			float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uf = 0; col_uf < nf; col_uf += 2) {
-				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
-				uf_scan[col_uf] = 0.5F * ( *(uf_scan + uf_pitch + col_uf) + *(uf_scan - uf_pitch + col_uf) );
+			// do odd-numbered rows, interpolating vertically
+			if ((row_uf & 1) && (row_uf < nf-1)) {
+				for (int col_uf = 0; col_uf < nf; col_uf += 2) {
+					// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
+					uf_scan[col_uf] = 0.5F * ( *(uf_scan + uf_pitch + col_uf) + *(uf_scan - uf_pitch + col_uf) );
+				}
 			}
-		}
-	}
-	// do even-numbered columns, interpolating horizontally
-	{
-		float *uf_scan = uf_bits;
-		for(row_uf = 0; row_uf < nf; row_uf++) {
-			for (col_uf = 1; col_uf < nf-1; col_uf += 2) {
+			// do odd-numbered columns, interpolating horizontally
+			for (int col_uf = 1; col_uf < nf-1; col_uf += 2) {
 				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) )
 				uf_scan[col_uf] = 0.5F * ( uf_scan[col_uf + 1] + uf_scan[col_uf - 1] );
 			}
-			uf_scan += uf_pitch;
 		}
+	});
+}
+
+/**
+Gauss-Seidel update of the red (red == TRUE) or black points of a row. 
+Red points are the points whose row + col is even.
+*/
+static inline void fmg_relaxRow(float *u_bits, const float *rhs_bits, int u_pitch, int rhs_pitch, int n, int row, BOOL red, float h2) {
+	float *u_scan = u_bits + row * u_pitch;
+	const float *rhs_scan = rhs_bits + row * rhs_pitch;
+	const int isw = red ? (2 - (row & 1)) : (1 + (row & 1));
+	for (int col = isw; col < n-1; col += 2) { 
+		// Gauss-Seidel formula
+		// calculate U(row, col) = 
+		// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
+		float *u_center = u_scan + col;
+		const float *rhs_center = rhs_scan + col;
+		*u_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
+		*u_center -= h2 * *rhs_center;
+		*u_center *= 0.25F;
 	}
 }
 
 /**
 Red-black Gauss-Seidel relaxation for model problem. Updates the current value of the solution
-u[0..n-1][0..n-1], using the right-hand side function rhs[0..n-1][0..n-1].
+u[0..n-1][0..n-1], using the right-hand side function rhs[0..n-1][0..n-1].<br>
+A red point only depends on black points and conversely, so that the rows of a sweep are 
+independent and the black sweep of a row can run as soon as its neighbours went through the red sweep. 
+The grid is split into bands of rows, and each band runs both sweeps in a single pass with a 
+lag of one row. The black sweep of the first and last row of each band is completed once all the bands are done. 
+The result is the same as two full sweeps, whatever the number of threads.
 */
 static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col, ipass, isw, jsw;
 	const float h = 1.0F / (n - 1);
 	const float h2 = h*h;
 
@@ -191,24 +213,32 @@ static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
 	float *u_bits = (float*)FreeImage_GetBits(U);
 	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
 
-	for (ipass = 0, jsw = 1; ipass < 2; ipass++, jsw = 3-jsw) { // Red and black sweeps
-		float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1, isw = jsw; row < n-1; row++, isw = 3-isw) {
-			for (col = isw; col < n-1; col += 2) { 
-				// Gauss-Seidel formula
-				// calculate U(row, col) = 
-				// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
-				float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*u_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
-				*u_center -= h2 * *rhs_center;
-				*u_center *= 0.25F;
+	// bands of interior rows [1 + band * band_rows, 1 + (band + 1) * band_rows)
+	const int band_rows = MAX((int)ToneMappingGrain(n), 2);
+	const int band_count = (n - 2 + band_rows - 1) / band_rows;
+
+	ParallelFor(0, band_count, 1, [=](unsigned first_band, unsigned last_band) {
+		for (int band = first_band; band < (int)last_band; band++) {
+			const int first = 1 + band * band_rows;
+			const int last = MIN(first + band_rows, n - 1);
+			for (int row = first; row < last; row++) {
+				fmg_relaxRow(u_bits, rhs_bits, u_pitch, rhs_pitch, n, row, TRUE, h2);
+				if (row - 1 > first) {
+					fmg_relaxRow(u_bits, rhs_bits, u_pitch, rhs_pitch, n, row - 1, FALSE, h2);
+				}
 			}
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
 		}
-	}
+	});
+	ParallelFor(0, band_count, 1, [=](unsigned first_band, unsigned last_band) {
+		for (int band = first_band; band < (int)last_band; band++) {
+			const int first = 1 + band * band_rows;
+			const int last = MIN(first + band_rows, n - 1);
+			fmg_relaxRow(u_bits, rhs_bits, u_pitch, rhs_pitch, n, first, FALSE, h2);
+			if (last - 1 > first) {
+				fmg_relaxRow(u_bits, rhs_bits, u_pitch, rhs_pitch, n, last - 1, FALSE, h2);
+			}
+		}
+	});
 }
 
 /**
@@ -216,8 +246,6 @@ Returns minus the residual for the model problem. Input quantities are u[0..n-1]
 rhs[0..n-1][0..n-1], while res[0..n-1][0..n-1] is returned.
 */
 static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col;
-
 	const float h = 1.0F / (n-1);	
 	const float h2i = 1.0F / (h*h);
 
@@ -230,12 +258,12 @@ static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
 	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
 
 	// interior points
-	{
-		float *res_scan = res_bits + res_pitch;
-		const float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1; row < n-1; row++) {
-			for (col = 1; col < n-1; col++) {
+	ParallelFor(1, n-1, ToneMappingGrain(n), [=](unsigned first, unsigned last) {
+		for (int row = first; row < (int)last; row++) {
+			float *res_scan = res_bits + row * res_pitch;
+			const float *u_scan = u_bits + row * u_pitch;
+			const float *rhs_scan = rhs_bits + row * rhs_pitch;
+			for (int col = 1; col < n-1; col++) {
 				// calculate RES(row, col) = 
 				// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
 				float *res_center = res_scan + col;
@@ -245,11 +273,8 @@ static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
 				*res_center *= -h2i;
 				*res_center += *rhs_center;
 			}
-			res_scan += res_pitch;
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
 		}
-	}
+	});
 
 	// boundary points
 	{
@@ -280,14 +305,16 @@ static void fmg_addint(FIBITMAP *UF, FIBITMAP *UC, FIBITMAP *RES, int nf) {
 	float *uf_bits = (float*)FreeImage_GetBits(UF);
 	const float *res_bits = (float*)FreeImage_GetBits(RES);
 
-	for(int row = 0; row < nf; row++) {
-		for(int col = 0; col < nf; col++) {
-			// calculate UF(row, col) = UF(row, col) + RES(row, col);
-			uf_bits[col] += res_bits[col];
+	ParallelFor(0, nf, ToneMappingGrain(nf), [=](unsigned first, unsigned last) {
+		for(int row = first; row < (int)last; row++) {
+			float *uf_scan = uf_bits + row * uf_pitch;
+			const float *res_scan = res_bits + row * res_pitch;
+			for(int col = 0; col < nf; col++) {
+				// calculate UF(row, col) = UF(row, col) + RES(row, col);
+				uf_scan[col] += res_scan[col];
+			}
 		}
-		uf_bits += uf_pitch;
-		res_bits += res_pitch;
-	}
+	});
 }
 
 /**
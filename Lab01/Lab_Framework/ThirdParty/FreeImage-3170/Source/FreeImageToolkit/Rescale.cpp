@@ -21,6 +21,38 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "FreeImageIO.h"
+
+/**
+Create the resampling filter used by the resize engine
+@return Returns the filter, or NULL if the filter is unknown or if memory is low
+*/
+static CGenericFilter *
+CreateFilter(FREE_IMAGE_FILTER filter) {
+	CGenericFilter *pFilter = NULL;
+	switch (filter) {
+		case FILTER_BOX:
+			pFilter = new(std::nothrow) CBoxFilter();
+			break;
+		case FILTER_BICUBIC:
+			pFilter = new(std::nothrow) CBicubicFilter();
+			break;
+		case FILTER_BILINEAR:
+			pFilter = new(std::nothrow) CBilinearFilter();
+			break;
+		case FILTER_BSPLINE:
+			pFilter = new(std::nothrow) CBSplineFilter();
+			break;
+		case FILTER_CATMULLROM:
+			pFilter = new(std::nothrow) CCatmullRomFilter();
+			break;
+		case FILTER_LANCZOS3:
+			pFilter = new(std::nothrow) CLanczos3Filter();
+			break;
+	}
+
+	return pFilter;
+}
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_RescaleRect(FIBITMAP *src, int dst_width, int dst_height, int src_left, int src_top, int src_right, int src_bottom, FREE_IMAGE_FILTER filter, unsigned flags) {
@@ -47,28 +79,7 @@ FreeImage_RescaleRect(FIBITMAP *src, int dst_width, int dst_height, int src_left
 	}
 
 	// select the filter
-	CGenericFilter *pFilter = NULL;
-	switch (filter) {
-		case FILTER_BOX:
-			pFilter = new(std::nothrow) CBoxFilter();
-			break;
-		case FILTER_BICUBIC:
-			pFilter = new(std::nothrow) CBicubicFilter();
-			break;
-		case FILTER_BILINEAR:
-			pFilter = new(std::nothrow) CBilinearFilter();
-			break;
-		case FILTER_BSPLINE:
-			pFilter = new(std::nothrow) CBSplineFilter();
-			break;
-		case FILTER_CATMULLROM:
-			pFilter = new(std::nothrow) CCatmullRomFilter();
-			break;
-		case FILTER_LANCZOS3:
-			pFilter = new(std::nothrow) CLanczos3Filter();
-			break;
-	}
-
+	CGenericFilter *pFilter = CreateFilter(filter);
 	if (!pFilter) {
 		return NULL;
 	}
@@ -93,6 +104,42 @@ FreeImage_Rescale(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTE
 	return FreeImage_RescaleRect(src, dst_width, dst_height, 0, 0, FreeImage_GetWidth(src), FreeImage_GetHeight(src), filter, FI_RESCALE_DEFAULT);
 }
 
+BOOL DLL_CALLCONV
+FreeImage_RescaleInto(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_FILTER filter, unsigned flags) {
+	if (!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst)) {
+		return FALSE;
+	}
+
+	// a greyscale source scaled into a 24-bit image is implicitly converted
+	if ((FreeImage_GetBPP(src) <= 8) && (FreeImage_GetBPP(dst) == 24)) {
+		flags |= FI_RESCALE_TRUE_COLOR;
+	}
+
+	CGenericFilter *pFilter = CreateFilter(filter);
+	if (!pFilter) {
+		return FALSE;
+	}
+
+	CResizeEngine Engine(pFilter);
+
+	// the engine writes straight into dst, which may be a view or a mapped bitmap
+	FIBITMAP *result = Engine.scale(src, FreeImage_GetWidth(dst), FreeImage_GetHeight(dst), 0, 0,
+			FreeImage_GetWidth(src), FreeImage_GetHeight(src), flags, dst);
+
+	delete pFilter;
+
+	if (!result) {
+		return FALSE;
+	}
+
+	if ((flags & FI_RESCALE_OMIT_METADATA) != FI_RESCALE_OMIT_METADATA) {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, src);
+	}
+
+	return TRUE;
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert) {
 	FIBITMAP *thumbnail = NULL;
@@ -190,3 +237,116 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert) {
 
 	return thumbnail;
 }
+
+// --------------------------------------------------------------------------
+// Downscaled loading
+
+/**
+Returns the load flags to use for loading an image at a size not below dst_width x dst_height.<br>
+JPEG images can be decoded at 1/2, 1/4 or 1/8 of their size directly in the DCT domain.
+The JPEG plugin selects the largest of these factors from the size requested in the upper
+16 bits of the load flags, so this size is derived from the image header.
+@param fif Format of the image
+@param io FreeImage IO functions
+@param handle Handle positioned at the start of the image
+@param dst_width Requested image width
+@param dst_height Requested image height
+@param flags Load flags given by the user
+@return Returns the flags to use for loading the image
+*/
+static int
+GetScaledLoadFlags(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int dst_width, int dst_height, int flags) {
+	if ((fif != FIF_JPEG) || ((flags >> 16) != 0) || ((flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS)) {
+		// not supported, or the user already requested a size
+		return flags;
+	}
+
+	// read the header only, then go back to the start of the image
+	const long start_pos = io->tell_proc(handle);
+	FIBITMAP *header = FreeImage_LoadFromHandle(fif, io, handle, (flags & ~JPEG_EXIFROTATE) | FIF_LOAD_NOPIXELS);
+	io->seek_proc(handle, start_pos, SEEK_SET);
+	if (!header) {
+		return flags;
+	}
+
+	const unsigned width = FreeImage_GetWidth(header);
+	const unsigned height = FreeImage_GetHeight(header);
+	FreeImage_Unload(header);
+
+	// largest downscaling factor that keeps both sides at least as large as requested
+	double scale = MIN((double)width / dst_width, (double)height / dst_height);
+	if ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE) {
+		// the image may be rotated by 90 degrees after decoding
+		scale = MIN(scale, MIN((double)width / dst_height, (double)height / dst_width));
+	}
+	if (scale < 2) {
+		return flags;
+	}
+
+	// the plugin picks the largest factor not above MAX(width, height) / requested_size
+	const int requested_size = (int)ceil(MAX(width, height) / scale);
+
+	return (flags & 0xFFFF) | (CLAMP(requested_size, 1, 0xFFFF) << 16);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadScaledFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int dst_width, int dst_height, FREE_IMAGE_FILTER filter, int flags) {
+	if (!io || !handle || (dst_width <= 0) || (dst_height <= 0)) {
+		return NULL;
+	}
+
+	FIBITMAP *dib = FreeImage_LoadFromHandle(fif, io, handle, GetScaledLoadFlags(fif, io, handle, dst_width, dst_height, flags));
+	if (!dib || !FreeImage_HasPixels(dib)) {
+		return dib;
+	}
+
+	if ((FreeImage_GetWidth(dib) == (unsigned)dst_width) && (FreeImage_GetHeight(dib) == (unsigned)dst_height)) {
+		return dib;
+	}
+
+	// final high quality resampling to the requested size
+	FIBITMAP *dst = FreeImage_Rescale(dib, dst_width, dst_height, filter);
+	FreeImage_Unload(dib);
+
+	return dst;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadScaled(FREE_IMAGE_FORMAT fif, const char *filename, int dst_width, int dst_height, FREE_IMAGE_FILTER filter, int flags) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FILE *handle = fopen(filename, "rb");
+
+	if (handle) {
+		FIBITMAP *bitmap = FreeImage_LoadScaledFromHandle(fif, &io, (fi_handle)handle, dst_width, dst_height, filter, flags);
+
+		fclose(handle);
+
+		return bitmap;
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadScaled: failed to open file %s", filename);
+	}
+
+	return NULL;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadScaledU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int dst_width, int dst_height, FREE_IMAGE_FILTER filter, int flags) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+#ifdef _WIN32
+	FILE *handle = _wfopen(filename, L"rb");
+
+	if (handle) {
+		FIBITMAP *bitmap = FreeImage_LoadScaledFromHandle(fif, &io, (fi_handle)handle, dst_width, dst_height, filter, flags);
+
+		fclose(handle);
+
+		return bitmap;
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadScaledU: failed to open input file");
+	}
+#endif
+	return NULL;
+}
@@ -22,6 +22,11 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "ThreadPool.h"
+
+#ifdef FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
 
 /**
 Returns the color type of a bitmap. In contrast to FreeImage_GetColorType,
@@ -165,10 +170,16 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 
 	 // allocate list of contributions 
 	m_WeightTable = (Contribution*)malloc(m_LineLength * sizeof(Contribution));
+	// allocate contributions for every pixel as a single block per precision
+	m_Weights = (double*)malloc(m_LineLength * m_WindowSize * sizeof(double));
+	m_FloatWeights = (float*)malloc(m_LineLength * m_WindowSize * sizeof(float));
+	m_FixedWeights = (short*)malloc(m_LineLength * m_WindowSize * sizeof(short));
 	for(unsigned u = 0; u < m_LineLength; u++) {
-		// allocate contributions for every pixel
-		m_WeightTable[u].Weights = (double*)malloc(m_WindowSize * sizeof(double));
+		m_WeightTable[u].Weights = m_Weights + u * m_WindowSize;
+		m_WeightTable[u].FloatWeights = m_FloatWeights + u * m_WindowSize;
+		m_WeightTable[u].FixedWeights = m_FixedWeights + u * m_WindowSize;
 	}
+	m_bFixedValid = TRUE;
 
 	// offset for discrete to continuous coordinate conversion
 	const double dOffset = (0.5 / dScale);
@@ -215,21 +226,71 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 			
 		}
 
+		// derive the single precision and fixed-point weights
+		{
+			const int iLimit = m_WeightTable[u].Right - m_WeightTable[u].Left;
+			const double * const weights = m_WeightTable[u].Weights;
+			float * const float_weights = m_WeightTable[u].FloatWeights;
+			short * const fixed_weights = m_WeightTable[u].FixedWeights;
+			const double dFixedOne = (double)(1 << FI_RESIZE_FIXED_BITS);
+			int iFixedTotal = 0;
+			int iLargest = 0;
+
+			for(int i = 0; i < iLimit; i++) {
+				float_weights[i] = (float)weights[i];
+				const double dFixed = floor(weights[i] * dFixedOne + 0.5);
+				if((dFixed < SHRT_MIN) || (dFixed > SHRT_MAX)) {
+					m_bFixedValid = FALSE;
+					fixed_weights[i] = 0;
+				} else {
+					fixed_weights[i] = (short)dFixed;
+				}
+				iFixedTotal += fixed_weights[i];
+				if(abs(fixed_weights[i]) > abs(fixed_weights[iLargest])) {
+					iLargest = i;
+				}
+			}
+			// make the fixed-point weights sum up to exactly one, so that
+			// flat areas are reproduced without any rounding drift
+			if((iLimit > 0) && (dTotalWeight > 0)) {
+				const int iFixed = fixed_weights[iLargest] + ((1 << FI_RESIZE_FIXED_BITS) - iFixedTotal);
+				if((iFixed < SHRT_MIN) || (iFixed > SHRT_MAX)) {
+					m_bFixedValid = FALSE;
+				} else {
+					fixed_weights[iLargest] = (short)iFixed;
+				}
+			}
+		}
+
 	} // next dst pixel
 }
 
 CWeightsTable::~CWeightsTable() {
-	for(unsigned u = 0; u < m_LineLength; u++) {
-		// free contributions for every pixel
-		free(m_WeightTable[u].Weights);
-	}
+	// free contributions of all pixels
+	free(m_Weights);
+	free(m_FloatWeights);
+	free(m_FixedWeights);
 	// free list of pixels contributions
 	free(m_WeightTable);
 }
 
 // --------------------------------------------------------------------------
 
-FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags) {
+/**
+Copy the pixels and the palette of an image into another image of the same size and format
+*/
+static void CopyPixels(FIBITMAP *src, FIBITMAP *dst) {
+	const unsigned height = FreeImage_GetHeight(dst);
+	const unsigned line = FreeImage_GetLine(dst);
+	for (unsigned y = 0; y < height; y++) {
+		memcpy(FreeImage_GetScanLine(dst, y), FreeImage_GetScanLine(src, y), line);
+	}
+	if (FreeImage_GetColorsUsed(dst) > 0) {
+		memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(src), FreeImage_GetColorsUsed(dst) * sizeof(RGBQUAD));
+	}
+}
+
+FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags, FIBITMAP *dst) {
 
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 	const unsigned src_bpp = FreeImage_GetBPP(src);
@@ -286,6 +347,15 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 		dst_bpp_s1 = dst_bpp;
 	}
 
+	// a user provided destination must match the scaled image
+	const BOOL owns_dst = (dst == NULL);
+	if (!owns_dst) {
+		if ((FreeImage_GetImageType(dst) != image_type) || (FreeImage_GetBPP(dst) != dst_bpp) || 
+			(FreeImage_GetWidth(dst) != dst_width) || (FreeImage_GetHeight(dst) != dst_height)) {
+			return NULL;
+		}
+	}
+
 	// early exit if destination size is equal to source size
 	if ((src_width == dst_width) && (src_height == dst_height)) {
 		FIBITMAP *out = src;
@@ -314,6 +384,17 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 		}
 
+		if (!owns_dst) {
+			if (!out) {
+				return NULL;
+			}
+			CopyPixels(out, dst);
+			if (out != src) {
+				FreeImage_Unload(out);
+			}
+			return dst;
+		}
+
 		return (out != src) ? out : FreeImage_Clone(src);
 	}
 
@@ -334,9 +415,11 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	}
 
 	// allocate the dst image
-	FIBITMAP *dst = FreeImage_AllocateT(image_type, dst_width, dst_height, dst_bpp, 0, 0, 0);
-	if (!dst) {
-		return NULL;
+	if (owns_dst) {
+		dst = FreeImage_AllocateT(image_type, dst_width, dst_height, dst_bpp, 0, 0, 0);
+		if (!dst) {
+			return NULL;
+		}
 	}
 	
 	if (dst_bpp == 8) {
@@ -392,7 +475,9 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 				// a temporary image
 				tmp = FreeImage_AllocateT(image_type, dst_width, src_height, dst_bpp_s1, 0, 0, 0);
 				if (!tmp) {
-					FreeImage_Unload(dst);
+					if (owns_dst) {
+						FreeImage_Unload(dst);
+					}
 					return NULL;
 				}
 			} else {
@@ -458,7 +543,9 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 				// a temporary image
 				tmp = FreeImage_AllocateT(image_type, src_width, dst_height, dst_bpp_s1, 0, 0, 0);
 				if (!tmp) {
-					FreeImage_Unload(dst);
+					if (owns_dst) {
+						FreeImage_Unload(dst);
+					}
 					return NULL;
 				}
 			} else {
@@ -505,10 +592,411 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	return dst;
 } 
 
+// --------------------------------------------------------------------------
+// Fast paths for 8-bit per channel and float images
+
+/// Minimum amount of work (in multiply-adds) a band should carry to be worth a thread
+static const unsigned RESIZE_BAND_WORK = 64 * 1024;
+
+/**
+Returns the number of lines per band, given an estimate of the work per line
+*/
+static inline unsigned
+GetBandGrain(unsigned work_per_line) {
+	return MAX(1U, RESIZE_BAND_WORK / MAX(1U, work_per_line));
+}
+
+/**
+Rounds, scales down and clamps a fixed-point accumulator to a byte
+*/
+static inline BYTE
+FixedToByte(int value) {
+	return (BYTE)CLAMP<int>((value + (1 << (FI_RESIZE_FIXED_BITS - 1))) >> FI_RESIZE_FIXED_BITS, 0, 0xFF);
+}
+
+/**
+Horizontal filtering of the rows [first_row, last_row) of a 8-, 24- or 32-bit
+image without palette, using fixed-point weights.
+*/
+static void
+HorizontalFilterFixed(const CWeightsTable& weightsTable, FIBITMAP *const src, unsigned first_row, unsigned last_row, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_width, unsigned bytespp) {
+	for (unsigned y = first_row; y < last_row; y++) {
+		// scale each row
+		const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * bytespp;
+		BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+
+		switch(bytespp) {
+			case 1:
+				for (unsigned x = 0; x < dst_width; x++) {
+					const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
+					const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
+					const short * const weights = weightsTable.getFixedWeights(x);
+					const BYTE * const pixel = src_bits + iLeft;
+					int value = 0;
+
+					for (unsigned i = 0; i < iLimit; i++) {
+						value += weights[i] * pixel[i];
+					}
+					dst_bits[x] = FixedToByte(value);
+				}
+				break;
+
+			case 3:
+				for (unsigned x = 0; x < dst_width; x++) {
+					const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
+					const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
+					const short * const weights = weightsTable.getFixedWeights(x);
+					const BYTE *pixel = src_bits + iLeft * 3;
+					int r = 0, g = 0, b = 0;
+
+					for (unsigned i = 0; i < iLimit; i++) {
+						const int weight = weights[i];
+						r += weight * pixel[FI_RGBA_RED];
+						g += weight * pixel[FI_RGBA_GREEN];
+						b += weight * pixel[FI_RGBA_BLUE];
+						pixel += 3;
+					}
+					dst_bits[FI_RGBA_RED]	= FixedToByte(r);
+					dst_bits[FI_RGBA_GREEN]	= FixedToByte(g);
+					dst_bits[FI_RGBA_BLUE]	= FixedToByte(b);
+					dst_bits += 3;
+				}
+				break;
+
+			case 4:
+				for (unsigned x = 0; x < dst_width; x++) {
+					const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
+					const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
+					const short * const weights = weightsTable.getFixedWeights(x);
+					const BYTE *pixel = src_bits + iLeft * 4;
+#ifdef FREEIMAGE_SSE2
+					// all four channels are accumulated at once, two source pixels per step
+					const __m128i zero = _mm_setzero_si128();
+					__m128i acc = _mm_set1_epi32(1 << (FI_RESIZE_FIXED_BITS - 1));
+					unsigned i = 0;
+					for (; i + 2 <= iLimit; i += 2) {
+						// widen two pixels to 16-bit and interleave them per channel: c0 c0' c1 c1' ...
+						__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)pixel), zero);
+						p = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+						const __m128i w = _mm_set1_epi32((int)(((unsigned)(WORD)weights[i + 1] << 16) | (WORD)weights[i]));
+						acc = _mm_add_epi32(acc, _mm_madd_epi16(p, w));
+						pixel += 8;
+					}
+					if (i < iLimit) {
+						__m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int *)pixel), zero);
+						p = _mm_unpacklo_epi16(p, zero);
+						acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32((WORD)weights[i])));
+					}
+					acc = _mm_srai_epi32(acc, FI_RESIZE_FIXED_BITS);
+					acc = _mm_packs_epi32(acc, acc);
+					acc = _mm_packus_epi16(acc, acc);
+					*(int *)dst_bits = _mm_cvtsi128_si32(acc);
+#else
+					int r = 0, g = 0, b = 0, a = 0;
+
+					for (unsigned i = 0; i < iLimit; i++) {
+						const int weight = weights[i];
+						r += weight * pixel[FI_RGBA_RED];
+						g += weight * pixel[FI_RGBA_GREEN];
+						b += weight * pixel[FI_RGBA_BLUE];
+						a += weight * pixel[FI_RGBA_ALPHA];
+						pixel += 4;
+					}
+					dst_bits[FI_RGBA_RED]	= FixedToByte(r);
+					dst_bits[FI_RGBA_GREEN]	= FixedToByte(g);
+					dst_bits[FI_RGBA_BLUE]	= FixedToByte(b);
+					dst_bits[FI_RGBA_ALPHA]	= FixedToByte(a);
+#endif // FREEIMAGE_SSE2
+					dst_bits += 4;
+				}
+				break;
+		}
+	}
+}
+
+/**
+Vertical filtering of the destination rows [first_row, last_row) of a 8-, 24- or
+32-bit image without palette, using fixed-point weights.<br>
+Since every channel of every pixel is filtered the same way in vertical direction,
+a row is processed as a plain array of 'line_bytes' bytes.
+*/
+static void
+VerticalFilterFixed(const CWeightsTable& weightsTable, FIBITMAP *const src, unsigned first_row, unsigned last_row, unsigned src_offset_bytes, unsigned src_offset_y, FIBITMAP *const dst, unsigned line_bytes) {
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const BYTE * const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_bytes;
+
+	// row accumulator for the bytes not handled by the vector loop
+	std::vector<int> accumulator(line_bytes);
+
+	for (unsigned y = first_row; y < last_row; y++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
+		const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
+		const short * const weights = weightsTable.getFixedWeights(y);
+		const BYTE * const src_bits = src_base + iLeft * src_pitch;
+		BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
+		unsigned x = 0;
+
+#ifdef FREEIMAGE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi32(1 << (FI_RESIZE_FIXED_BITS - 1));
+
+		for (; x + 16 <= line_bytes; x += 16) {
+			__m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+			const BYTE *row = src_bits + x;
+			unsigned i = 0;
+
+			for (; i + 2 <= iLimit; i += 2) {
+				// interleave two source rows byte by byte, so that _mm_madd_epi16
+				// computes row0 * w0 + row1 * w1 for four bytes at a time
+				const __m128i r0 = _mm_loadu_si128((const __m128i *)row);
+				const __m128i r1 = _mm_loadu_si128((const __m128i *)(row + src_pitch));
+				const __m128i w = _mm_set1_epi32((int)(((unsigned)(WORD)weights[i + 1] << 16) | (WORD)weights[i]));
+				const __m128i lo = _mm_unpacklo_epi8(r0, r1);
+				const __m128i hi = _mm_unpackhi_epi8(r0, r1);
+				acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+				acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+				acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+				acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+				row += 2 * src_pitch;
+			}
+			if (i < iLimit) {
+				// odd window size: pair the last row with zeros
+				const __m128i r0 = _mm_loadu_si128((const __m128i *)row);
+				const __m128i w = _mm_set1_epi32((WORD)weights[i]);
+				const __m128i lo = _mm_unpacklo_epi8(r0, zero);
+				const __m128i hi = _mm_unpackhi_epi8(r0, zero);
+				acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+				acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+				acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+				acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+			}
+
+			acc0 = _mm_srai_epi32(acc0, FI_RESIZE_FIXED_BITS);
+			acc1 = _mm_srai_epi32(acc1, FI_RESIZE_FIXED_BITS);
+			acc2 = _mm_srai_epi32(acc2, FI_RESIZE_FIXED_BITS);
+			acc3 = _mm_srai_epi32(acc3, FI_RESIZE_FIXED_BITS);
+			const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3));
+			_mm_storeu_si128((__m128i *)(dst_bits + x), packed);
+		}
+#endif // FREEIMAGE_SSE2
+
+		if (x < line_bytes) {
+			// remaining bytes: accumulate whole source rows, so that memory is read sequentially
+			const unsigned count = line_bytes - x;
+			int * const acc = &accumulator[0];
+			memset(acc, 0, count * sizeof(int));
+
+			for (unsigned i = 0; i < iLimit; i++) {
+				const int weight = weights[i];
+				const BYTE * const row = src_bits + i * src_pitch + x;
+				for (unsigned k = 0; k < count; k++) {
+					acc[k] += weight * row[k];
+				}
+			}
+			for (unsigned k = 0; k < count; k++) {
+				dst_bits[x + k] = FixedToByte(acc[k]);
+			}
+		}
+	}
+}
+
+/**
+Horizontal filtering of the rows [first_row, last_row) of a FIT_FLOAT, FIT_RGBF
+or FIT_RGBAF image, using single precision weights.
+*/
+static void
+HorizontalFilterFloat(const CWeightsTable& weightsTable, FIBITMAP *const src, unsigned first_row, unsigned last_row, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_width, unsigned floatspp) {
+	for (unsigned y = first_row; y < last_row; y++) {
+		// scale each row
+		const float * const src_bits = (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * floatspp;
+		float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
+
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
+			const float * const weights = weightsTable.getFloatWeights(x);
+			const float *pixel = src_bits + iLeft * floatspp;
+
+#ifdef FREEIMAGE_SSE2
+			if (floatspp == 4) {
+				// one RGBA pixel per vector
+				__m128 acc = _mm_setzero_ps();
+				for (unsigned i = 0; i < iLimit; i++) {
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(pixel)));
+					pixel += 4;
+				}
+				_mm_storeu_ps(dst_bits, acc);
+				dst_bits += 4;
+				continue;
+			}
+#endif // FREEIMAGE_SSE2
+
+			float value[4] = {0, 0, 0, 0};	// 4 = 128 bpp max
+			for (unsigned i = 0; i < iLimit; i++) {
+				const float weight = weights[i];
+				for (unsigned j = 0; j < floatspp; j++) {
+					value[j] += weight * pixel[j];
+				}
+				pixel += floatspp;
+			}
+			for (unsigned j = 0; j < floatspp; j++) {
+				dst_bits[j] = value[j];
+			}
+			dst_bits += floatspp;
+		}
+	}
+}
+
+/**
+Vertical filtering of the destination rows [first_row, last_row) of a FIT_FLOAT,
+FIT_RGBF or FIT_RGBAF image, using single precision weights.<br>
+A row is processed as a plain array of 'line_floats' floats.
+*/
+static void
+VerticalFilterFloat(const CWeightsTable& weightsTable, FIBITMAP *const src, unsigned first_row, unsigned last_row, unsigned src_offset_floats, unsigned src_offset_y, FIBITMAP *const dst, unsigned line_floats) {
+	const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(float);
+	const float * const src_base = (float *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_floats;
+
+	for (unsigned y = first_row; y < last_row; y++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
+		const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
+		const float * const weights = weightsTable.getFloatWeights(y);
+		const float * const src_bits = src_base + iLeft * src_pitch;
+		float * const dst_bits = (float *)FreeImage_GetScanLine(dst, y);
+		unsigned x = 0;
+
+#ifdef FREEIMAGE_SSE2
+		// one cache line (16 floats) per step
+		for (; x + 16 <= line_floats; x += 16) {
+			__m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps(), acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+			const float *row = src_bits + x;
+			for (unsigned i = 0; i < iLimit; i++) {
+				const __m128 w = _mm_set1_ps(weights[i]);
+				acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, _mm_loadu_ps(row)));
+				acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, _mm_loadu_ps(row + 4)));
+				acc2 = _mm_add_ps(acc2, _mm_mul_ps(w, _mm_loadu_ps(row + 8)));
+				acc3 = _mm_add_ps(acc3, _mm_mul_ps(w, _mm_loadu_ps(row + 12)));
+				row += src_pitch;
+			}
+			_mm_storeu_ps(dst_bits + x, acc0);
+			_mm_storeu_ps(dst_bits + x + 4, acc1);
+			_mm_storeu_ps(dst_bits + x + 8, acc2);
+			_mm_storeu_ps(dst_bits + x + 12, acc3);
+		}
+#endif // FREEIMAGE_SSE2
+
+		if (x < line_floats) {
+			// remaining floats: accumulate whole source rows into the destination
+			const unsigned count = line_floats - x;
+			float * const acc = dst_bits + x;
+			memset(acc, 0, count * sizeof(float));
+
+			for (unsigned i = 0; i < iLimit; i++) {
+				const float weight = weights[i];
+				const float * const row = src_bits + i * src_pitch + x;
+				for (unsigned k = 0; k < count; k++) {
+					acc[k] += weight * row[k];
+				}
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
 void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
 
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_width, src_width);
+	// allocate and calculate the contributions, shared read-only by all bands
+	const CWeightsTable weightsTable(m_pFilter, dst_width, src_width);
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned src_bpp = FreeImage_GetBPP(src);
+	const unsigned dst_bpp = FreeImage_GetBPP(dst);
+
+	// a row costs about one multiply-add per source sample and destination channel
+	const unsigned grain = GetBandGrain(FreeImage_GetLine(src) + FreeImage_GetLine(dst) * MAX(1U, src_width / dst_width));
+
+	switch(image_type) {
+		case FIT_BITMAP:
+			if ((src_bpp == dst_bpp) && (src_bpp == 24 || src_bpp == 32 || (src_bpp == 8 && !src_pal)) && weightsTable.isFixedValid()) {
+				const unsigned bytespp = src_bpp / 8;
+				ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+					HorizontalFilterFixed(weightsTable, src, first, last, src_offset_x, src_offset_y, dst, dst_width, bytespp);
+				});
+				return;
+			}
+			break;
+
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+		{
+			const unsigned floatspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(float);
+			ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+				HorizontalFilterFloat(weightsTable, src, first, last, src_offset_x, src_offset_y, dst, dst_width, floatspp);
+			});
+			return;
+		}
+
+		default:
+			break;
+	}
+
+	ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+		horizontalFilterBand(weightsTable, src, first, last, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
+	});
+}
+
+void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
+
+	// allocate and calculate the contributions, shared read-only by all bands
+	const CWeightsTable weightsTable(m_pFilter, dst_height, src_height);
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned src_bpp = FreeImage_GetBPP(src);
+	const unsigned dst_bpp = FreeImage_GetBPP(dst);
+
+	// a destination row costs about one multiply-add per byte and contributing source row
+	const unsigned window = MAX(1U, src_height / dst_height) + 2;
+	const unsigned row_grain = GetBandGrain(FreeImage_GetLine(dst) * window);
+
+	switch(image_type) {
+		case FIT_BITMAP:
+			if ((src_bpp == dst_bpp) && (src_bpp == 24 || src_bpp == 32 || (src_bpp == 8 && !src_pal)) && weightsTable.isFixedValid()) {
+				const unsigned bytespp = src_bpp / 8;
+				const unsigned line_bytes = width * bytespp;
+				ParallelFor(0, dst_height, row_grain, [&](unsigned first, unsigned last) {
+					VerticalFilterFixed(weightsTable, src, first, last, src_offset_x * bytespp, src_offset_y, dst, line_bytes);
+				});
+				return;
+			}
+			break;
+
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+		{
+			const unsigned floatspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(float);
+			const unsigned line_floats = width * floatspp;
+			ParallelFor(0, dst_height, row_grain, [&](unsigned first, unsigned last) {
+				VerticalFilterFloat(weightsTable, src, first, last, src_offset_x * floatspp, src_offset_y, dst, line_floats);
+			});
+			return;
+		}
+
+		default:
+			break;
+	}
+
+	// the generic filters walk down columns, so split the image into bands of columns
+	const unsigned col_grain = GetBandGrain(dst_height * window);
+	ParallelFor(0, width, col_grain, [&](unsigned first, unsigned last) {
+		verticalFilterBand(weightsTable, src, first, last, width, src_offset_x, src_offset_y, src_pal, dst, dst_height);
+	});
+}
+
+/// Performs generic horizontal image filtering of a band of rows
+void CResizeEngine::horizontalFilterBand(const CWeightsTable& weightsTable, FIBITMAP *const src, unsigned first_row, unsigned last_row, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
 
 	// step through rows
 	switch(FreeImage_GetImageType(src)) {
@@ -524,7 +1012,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -548,7 +1036,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -581,7 +1069,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -612,7 +1100,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -649,7 +1137,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette here
 							src_offset_x >>= 3;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -695,7 +1183,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -726,7 +1214,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -764,7 +1252,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -810,7 +1298,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -835,7 +1323,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -867,7 +1355,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -899,7 +1387,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -935,7 +1423,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -978,7 +1466,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 					// transparently convert the 16-bit non-transparent image to 24 bpp
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = first_row; y < last_row; y++) {
 							// scale each row
 							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1010,7 +1498,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						}
 					} else {
 						// image has 555 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = first_row; y < last_row; y++) {
 							// scale each row
 							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1047,7 +1535,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 24:
 				{
 					// scale the 24-bit non-transparent image into a 24 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					for (unsigned y = first_row; y < last_row; y++) {
 						// scale each row
 						const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 3;
 						BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1083,7 +1571,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 32:
 				{
 					// scale the 32-bit transparent image into a 32 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					for (unsigned y = first_row; y < last_row; y++) {
 						// scale each row
 						const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 4;
 						BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1126,7 +1614,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
@@ -1160,7 +1648,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
@@ -1198,7 +1686,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
@@ -1240,7 +1728,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
 			const unsigned floatspp = (FreeImage_GetLine(src) / src_width) / sizeof(float);
 
-			for(unsigned y = 0; y < height; y++) {
+			for(unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const float *src_bits = (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(float);
 				float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
@@ -1275,11 +1763,8 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 	}
 }
 
-/// Performs vertical image filtering
-void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
-
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_height, src_height);
+/// Performs generic vertical image filtering of a band of columns
+void CResizeEngine::verticalFilterBand(const CWeightsTable& weightsTable, FIBITMAP *const src, unsigned first_col, unsigned last_col, unsigned width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
 
 	// step through columns
 	switch(FreeImage_GetImageType(src)) {
@@ -1300,7 +1785,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the 1-bit non-transparent greyscale image to 8 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 									const unsigned index = x >> 3;
@@ -1330,7 +1815,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 									const unsigned index = x >> 3;
@@ -1366,7 +1851,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 1-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 									const unsigned index = x >> 3;
@@ -1401,7 +1886,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 									const unsigned index = x >> 3;
@@ -1439,7 +1924,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 1-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_col; x < last_col; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 4;
 								const unsigned index = x >> 3;
@@ -1490,7 +1975,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the non-transparent 4-bit greyscale image to 8 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_col; x < last_col; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x;
 								const unsigned index = x >> 1;
@@ -1523,7 +2008,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the non-transparent 4-bit image to 24 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_col; x < last_col; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 3;
 								const unsigned index = x >> 1;
@@ -1562,7 +2047,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 4-bit image to 32 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_col; x < last_col; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 4;
 								const unsigned index = x >> 1;
@@ -1613,7 +2098,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// scale the 8-bit non-transparent greyscale image into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 
@@ -1639,7 +2124,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 
@@ -1672,7 +2157,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 
@@ -1704,7 +2189,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_col; x < last_col; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 
@@ -1739,7 +2224,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_col; x < last_col; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 4;
 
@@ -1785,7 +2270,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = first_col; x < last_col; x++) {
 							// work on column x in dst
 							BYTE *dst_bits = dst_base + x * 3;
 
@@ -1816,7 +2301,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						}
 					} else {
 						// image has 555 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = first_col; x < last_col; x++) {
 							// work on column x in dst
 							BYTE *dst_bits = dst_base + x * 3;
 
@@ -1855,7 +2340,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 					const unsigned src_pitch = FreeImage_GetPitch(src);
 					const BYTE *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 3;
 
-					for (unsigned x = 0; x < width; x++) {
+					for (unsigned x = first_col; x < last_col; x++) {
 						// work on column x in dst
 						const unsigned index = x * 3;
 						BYTE *dst_bits = dst_base + index;
@@ -1894,7 +2379,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 					const unsigned src_pitch = FreeImage_GetPitch(src);
 					const BYTE *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 4;
 
-					for (unsigned x = 0; x < width; x++) {
+					for (unsigned x = first_col; x < last_col; x++) {
 						// work on column x in dst
 						const unsigned index = x * 4;
 						BYTE *dst_bits = dst_base + index;
@@ -1943,7 +2428,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src)	+ src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_col; x < last_col; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				WORD *dst_bits = dst_base + index;
@@ -1984,7 +2469,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_col; x < last_col; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				WORD *dst_bits = dst_base + index;
@@ -2030,7 +2515,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_col; x < last_col; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				WORD *dst_bits = dst_base + index;
@@ -2080,7 +2565,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(float);
 			const float *const src_base = (float *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * floatspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_col; x < last_col; x++) {
 				// work on column x in dst
 				const unsigned index = x * floatspp;	// pixel index
 				float *dst_bits = (float *)dst_base + index;
@@ -28,9 +28,15 @@
 #include "Utilities.h"
 #include "Filters.h" 
 
+/// Number of fractional bits of the fixed-point filter weights
+#define FI_RESIZE_FIXED_BITS	14
+
 /**
   Filter weights table.<br>
-  This class stores contribution information for an entire line (row or column).
+  This class stores contribution information for an entire line (row or column).<br>
+  Besides the double precision weights used by the generic filters, the table
+  keeps a single precision copy for the float fast paths and a fixed-point copy
+  (see FI_RESIZE_FIXED_BITS) for the 8-bit per channel fast paths.
 */
 class CWeightsTable
 {
@@ -41,6 +47,10 @@ class CWeightsTable
 typedef struct {
 	/// Normalized weights of neighboring pixels
 	double *Weights;
+	/// Single precision copy of the weights
+	float *FloatWeights;
+	/// Fixed-point copy of the weights
+	short *FixedWeights;
 	/// Bounds of source pixels window
 	unsigned Left, Right;
 } Contribution;
@@ -52,6 +62,12 @@ private:
 	unsigned m_WindowSize;
 	/// Length of line (no. of rows / cols) 
 	unsigned m_LineLength;
+	/// Storage for all weights of the line
+	double *m_Weights;
+	float *m_FloatWeights;
+	short *m_FixedWeights;
+	/// TRUE if all weights fit into the fixed-point range
+	BOOL m_bFixedValid;
 
 public:
 	/** 
@@ -74,15 +90,38 @@ public:
 	@param src_pos Pixel position in source line buffer
 	@return Returns the filter weight
 	*/
-	double getWeight(unsigned dst_pos, unsigned src_pos) {
+	double getWeight(unsigned dst_pos, unsigned src_pos) const {
 		return m_WeightTable[dst_pos].Weights[src_pos];
 	}
 
+	/** Retrieve the single precision weights of a destination pixel
+	@param dst_pos Pixel position in destination line buffer
+	@return Returns the weights, starting at the left boundary
+	*/
+	const float *getFloatWeights(unsigned dst_pos) const {
+		return m_WeightTable[dst_pos].FloatWeights;
+	}
+
+	/** Retrieve the fixed-point weights of a destination pixel
+	@param dst_pos Pixel position in destination line buffer
+	@return Returns the weights, starting at the left boundary
+	*/
+	const short *getFixedWeights(unsigned dst_pos) const {
+		return m_WeightTable[dst_pos].FixedWeights;
+	}
+
+	/** Check whether the fixed-point weights can be used
+	@return Returns TRUE if all weights are representable in fixed-point
+	*/
+	BOOL isFixedValid() const {
+		return m_bFixedValid;
+	}
+
 	/** Retrieve left boundary of source line buffer
 	@param dst_pos Pixel position in destination line buffer
 	@return Returns the left boundary of source line buffer
 	*/
-	unsigned getLeftBoundary(unsigned dst_pos) {
+	unsigned getLeftBoundary(unsigned dst_pos) const {
 		return m_WeightTable[dst_pos].Left;
 	}
 
@@ -90,7 +129,7 @@ public:
 	@param dst_pos Pixel position in destination line buffer
 	@return Returns the right boundary of source line buffer
 	*/
-	unsigned getRightBoundary(unsigned dst_pos) {
+	unsigned getRightBoundary(unsigned dst_pos) const {
 		return m_WeightTable[dst_pos].Right;
 	}
 };
@@ -155,14 +194,17 @@ public:
 	@param src_top Top boundary of the source rectangle to be scaled
 	@param src_width Width of the source rectangle to be scaled
 	@param src_height Height of the source rectangle to be scaled
-	@return Returns the scaled image if successful, returns NULL otherwise
+	@param dst Optional destination image (e.g. a view or a mapped bitmap), NULL to allocate a new one.
+	If provided, it must have the size dst_width x dst_height and the type and bit depth of the scaled image.
+	@return Returns the scaled image (or dst) if successful, returns NULL otherwise
 	*/
-	FIBITMAP* scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags);
+	FIBITMAP* scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags, FIBITMAP *dst = NULL);
 
 private:
 
 	/**
-	Performs horizontal image filtering
+	Performs horizontal image filtering.<br>
+	Rows are processed in parallel bands on the FreeImage worker pool.
 
 	@param src Source image
 	@param height Source / Destination image height
@@ -178,7 +220,10 @@ private:
 			FIBITMAP * const dst, const unsigned dst_width);
 
 	/**
-	Performs vertical image filtering
+	Performs vertical image filtering.<br>
+	Rows (fast paths) or columns (generic path) are processed in parallel
+	bands on the FreeImage worker pool.
+
 	@param src Source image
 	@param width Source / Destination image width
 	@param src_height Source image height
@@ -191,6 +236,24 @@ private:
 	void verticalFilter(FIBITMAP * const src, const unsigned width, const unsigned src_height,
 			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_height);
+
+	/**
+	Generic horizontal filtering of the rows [first_row, last_row)
+	@see horizontalFilter
+	*/
+	static void horizontalFilterBand(const CWeightsTable& weightsTable, FIBITMAP * const src,
+			const unsigned first_row, const unsigned last_row, const unsigned src_width,
+			unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_width);
+
+	/**
+	Generic vertical filtering of the columns [first_col, last_col)
+	@see verticalFilter
+	*/
+	static void verticalFilterBand(const CWeightsTable& weightsTable, FIBITMAP * const src,
+			const unsigned first_col, const unsigned last_col, const unsigned width,
+			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_height);
 };
 
 #endif //   _RESIZE_H_
@@ -0,0 +1,239 @@
+// ==========================================================
+// Typed pixel views over FreeImage bitmaps
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGEVIEW_H
+#define FREEIMAGEVIEW_H
+
+#include "FreeImage.h"
+
+#include <stddef.h>
+#include <iterator>
+
+/**
+@file FreeImageView.h
+Header-only C++ access to the pixels of a FIBITMAP.<br>
+FreeImage_GetPixelColor and FreeImage_SetPixelColor validate the bitmap and
+locate the scanline on every call. A FIImageView checks the image type once,
+when it is created, then gives typed access to the rows of the bitmap,
+so that loops over the pixels compile down to pointer arithmetic:
+<pre>
+FIImageView<RGBQUAD> view(dib);
+if(view.isValid()) {
+	for(FIImageView<RGBQUAD>::iterator it = view.begin(); it != view.end(); ++it) {
+		FIImageRow<RGBQUAD> row = *it;
+		for(unsigned x = 0; x < row.size(); x++) {
+			row[x].rgbReserved = 0xFF;
+		}
+	}
+}
+</pre>
+Rows are numbered as in FreeImage_GetScanLine, i.e. row 0 is the bottom row of the image.<br>
+Use a const pixel type (e.g. FIImageView<const FIRGBAF>) for read-only access.
+*/
+
+// ----------------------------------------------------------
+//   Pixel formats
+// ----------------------------------------------------------
+
+/**
+Maps a pixel type to the FreeImage image types it can view.<br>
+Only the specializations below are defined, so that viewing a bitmap through
+an unsupported pixel type is a compile time error.
+*/
+template <class T> struct FIPixelTraits;
+
+template <class T> struct FIPixelTraits<const T> : public FIPixelTraits<T> {
+};
+
+template <> struct FIPixelTraits<BYTE> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned bpp) { return (type == FIT_BITMAP) && (bpp == 8); }
+};
+
+template <> struct FIPixelTraits<WORD> {
+	// 16-bit RGB bitmaps are viewed as packed 555 / 565 words
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned bpp) { return (type == FIT_UINT16) || ((type == FIT_BITMAP) && (bpp == 16)); }
+};
+
+template <> struct FIPixelTraits<short> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_INT16); }
+};
+
+template <> struct FIPixelTraits<DWORD> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_UINT32); }
+};
+
+template <> struct FIPixelTraits<LONG> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_INT32); }
+};
+
+template <> struct FIPixelTraits<float> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_FLOAT); }
+};
+
+template <> struct FIPixelTraits<double> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_DOUBLE); }
+};
+
+template <> struct FIPixelTraits<FICOMPLEX> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_COMPLEX); }
+};
+
+template <> struct FIPixelTraits<RGBTRIPLE> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned bpp) { return (type == FIT_BITMAP) && (bpp == 24); }
+};
+
+template <> struct FIPixelTraits<RGBQUAD> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned bpp) { return (type == FIT_BITMAP) && (bpp == 32); }
+};
+
+template <> struct FIPixelTraits<FIRGB16> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_RGB16); }
+};
+
+template <> struct FIPixelTraits<FIRGBA16> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_RGBA16); }
+};
+
+template <> struct FIPixelTraits<FIRGBF> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_RGBF); }
+};
+
+template <> struct FIPixelTraits<FIRGBAF> {
+	static bool accepts(FREE_IMAGE_TYPE type, unsigned) { return (type == FIT_RGBAF); }
+};
+
+// ----------------------------------------------------------
+//   Rows
+// ----------------------------------------------------------
+
+/**
+A contiguous row of pixels: a pointer and a width, with no ownership.
+*/
+template <class T>
+class FIImageRow {
+public:
+	typedef T value_type;
+	typedef T* iterator;
+
+	FIImageRow() : _data(NULL), _size(0) {
+	}
+	FIImageRow(T *data, unsigned size) : _data(data), _size(size) {
+	}
+
+	/// Returns a pointer to the first pixel of the row
+	T* data() const { return _data; }
+	/// Returns the number of pixels in the row
+	unsigned size() const { return _size; }
+	/// Returns the pixel at column x (no bounds checking)
+	T& operator[](unsigned x) const { return _data[x]; }
+
+	T* begin() const { return _data; }
+	T* end() const { return _data + _size; }
+
+	/// Returns a row made of the pixels [first, first + count)
+	FIImageRow subRow(unsigned first, unsigned count) const { return FIImageRow(_data + first, count); }
+
+private:
+	T *_data;
+	unsigned _size;
+};
+
+// ----------------------------------------------------------
+//   Views
+// ----------------------------------------------------------
+
+/**
+A typed view of the pixels of a FIBITMAP.<br>
+The view does not own the bitmap, which must outlive it. A view over a bitmap whose
+type does not match the pixel type, or which has no pixels (header only bitmap),
+is invalid and empty.
+*/
+template <class T>
+class FIImageView {
+public:
+	typedef T value_type;
+	typedef FIImageRow<T> row_type;
+
+	/**
+	Forward iterator over the rows of a view, from the bottom row (row 0) upwards
+	*/
+	class iterator {
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef row_type value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const row_type* pointer;
+		typedef row_type reference;
+
+		iterator() : _bits(NULL), _pitch(0), _width(0) {
+		}
+		iterator(BYTE *bits, size_t pitch, unsigned width) : _bits(bits), _pitch(pitch), _width(width) {
+		}
+
+		row_type operator*() const { return row_type(reinterpret_cast<T*>(_bits), _width); }
+		iterator& operator++() { _bits += _pitch; return *this; }
+		iterator operator++(int) { iterator tmp(*this); _bits += _pitch; return tmp; }
+		bool operator==(const iterator& other) const { return _bits == other._bits; }
+		bool operator!=(const iterator& other) const { return _bits != other._bits; }
+
+	private:
+		BYTE *_bits;
+		size_t _pitch;
+		unsigned _width;
+	};
+
+	/// Creates an invalid view
+	FIImageView() : _bits(NULL), _pitch(0), _width(0), _height(0) {
+	}
+
+	/// Creates a view over dib, which is invalid when the pixel type does not match the image type
+	explicit FIImageView(FIBITMAP *dib) : _bits(NULL), _pitch(0), _width(0), _height(0) {
+		if(FreeImage_HasPixels(dib) && FIPixelTraits<T>::accepts(FreeImage_GetImageType(dib), FreeImage_GetBPP(dib))) {
+			_bits = FreeImage_GetBits(dib);
+			_pitch = FreeImage_GetPitch(dib);
+			_width = FreeImage_GetWidth(dib);
+			_height = FreeImage_GetHeight(dib);
+		}
+	}
+
+	/// Returns true if the view is bound to a bitmap of a matching type
+	bool isValid() const { return _bits != NULL; }
+
+	unsigned getWidth() const { return _width; }
+	unsigned getHeight() const { return _height; }
+	/// Returns the distance in bytes between two consecutive rows
+	size_t getPitch() const { return _pitch; }
+
+	/// Returns a pointer to the first pixel of row y (no bounds checking)
+	T* getScanLine(unsigned y) const { return reinterpret_cast<T*>(_bits + y * _pitch); }
+	/// Returns row y (no bounds checking)
+	row_type operator[](unsigned y) const { return row_type(getScanLine(y), _width); }
+	/// Returns the pixel at column x of row y (no bounds checking)
+	T& operator()(unsigned x, unsigned y) const { return getScanLine(y)[x]; }
+
+	iterator begin() const { return iterator(_bits, _pitch, _width); }
+	iterator end() const { return iterator(_bits + _height * _pitch, _pitch, _width); }
+
+private:
+	BYTE *_bits;
+	size_t _pitch;
+	unsigned _width;
+	unsigned _height;
+};
+
+#endif // FREEIMAGEVIEW_H
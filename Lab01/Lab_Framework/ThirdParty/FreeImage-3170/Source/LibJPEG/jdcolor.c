@@ -12,6 +12,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -677,6 +678,10 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
     case JCS_YCbCr:
       cconvert->pub.color_convert = ycc_rgb_convert;
       build_ycc_rgb_table(cinfo);
+#ifdef JSIMD_SUPPORTED
+      if (jsimd_can_color())
+	cconvert->pub.color_convert = jsimd_ycc_rgb_convert;
+#endif
       break;
     case JCS_BG_YCC:
       cconvert->pub.color_convert = ycc_rgb_convert;
@@ -20,6 +20,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
 /*
@@ -351,6 +352,25 @@ start_pass (j_decompress_ptr cinfo)
       break;
     }
   }
+
+#ifdef JSIMD_SUPPORTED
+  /* Substitute the SIMD versions of the 8x8 integer IDCTs,
+   * now that the multiplier tables are known.
+   */
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    if (! jsimd_can_idct(cinfo, compptr))
+      continue;
+#ifdef DCT_ISLOW_SUPPORTED
+    if (idct->pub.inverse_DCT[ci] == jpeg_idct_islow)
+      idct->pub.inverse_DCT[ci] = jsimd_idct_islow;
+#endif
+#ifdef DCT_IFAST_SUPPORTED
+    if (idct->pub.inverse_DCT[ci] == jpeg_idct_ifast)
+      idct->pub.inverse_DCT[ci] = jsimd_idct_ifast;
+#endif
+  }
+#endif
 }
 
 
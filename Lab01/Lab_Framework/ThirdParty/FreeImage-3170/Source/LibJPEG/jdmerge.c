@@ -36,6 +36,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 #ifdef UPSAMPLE_MERGING_SUPPORTED
 
@@ -396,6 +397,15 @@ jinit_merged_upsampler (j_decompress_ptr cinfo)
   }
 
   build_ycc_rgb_table(cinfo);
+
+#ifdef JSIMD_SUPPORTED
+  if (jsimd_can_color()) {
+    if (cinfo->max_v_samp_factor == 2)
+      upsample->upmethod = jsimd_h2v2_merged_upsample;
+    else
+      upsample->upmethod = jsimd_h2v1_merged_upsample;
+  }
+#endif
 }
 
 #endif /* UPSAMPLE_MERGING_SUPPORTED */
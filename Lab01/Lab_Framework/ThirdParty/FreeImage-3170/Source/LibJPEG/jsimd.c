@@ -0,0 +1,755 @@
+/*
+ * jsimd.c
+ *
+ * This file is part of the FreeImage distribution of the IJG software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains SSE2 versions of the decompressor's inner loops:
+ * the 8x8 integer IDCTs (jidctint.c, jidctfst.c), the YCbCr=>RGB color
+ * conversion (jdcolor.c) and the merged upsamplers (jdmerge.c).
+ *
+ * The routines are bit-exact replacements.  The IDCTs work on 16-bit
+ * samples between the passes where the C code uses ints; when a
+ * dequantized coefficient or an intermediate value of a block does not
+ * fit, the block is handed to the C routine.  This never happens with
+ * valid 8-bit baseline data.  All other arithmetic is done in the same
+ * fixed-point representation as the C code, so the results are identical.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#ifdef JSIMD_SUPPORTED
+#include <emmintrin.h>
+#endif
+
+
+/* The switch is a plain int: it must only be changed while no codec is
+ * running (see FreeImage_SetJPEGSIMD).  The modules read it once, when a
+ * decoding pass starts.
+ */
+static int simd_enabled = 1;
+
+
+GLOBAL(void)
+jsimd_set_enabled (int enabled)
+{
+  simd_enabled = enabled ? 1 : 0;
+}
+
+
+GLOBAL(int)
+jsimd_is_enabled (void)
+{
+#ifdef JSIMD_SUPPORTED
+  return simd_enabled;
+#else
+  return 0;
+#endif
+}
+
+
+#ifdef JSIMD_SUPPORTED
+
+
+/*
+ * Selection tests, called by the module initialization routines.
+ */
+
+GLOBAL(boolean)
+jsimd_can_idct (j_decompress_ptr cinfo, jpeg_component_info * compptr)
+{
+  MULTIPLIER * quantptr = (MULTIPLIER *) compptr->dct_table;
+  int i;
+
+  if (! simd_enabled || SIZEOF(MULTIPLIER) != 4)
+    return FALSE;
+#ifdef USE_ACCURATE_ROUNDING
+  /* jidctfst.c rounds its descaling steps, the SSE2 version doesn't */
+  if (cinfo->dct_method == JDCT_IFAST)
+    return FALSE;
+#endif
+  /* The multipliers are packed to 16 bits */
+  for (i = 0; i < DCTSIZE2; i++) {
+    if (quantptr[i] < 0 || quantptr[i] > 32767)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+GLOBAL(boolean)
+jsimd_can_color (void)
+{
+  return simd_enabled ? TRUE : FALSE;
+}
+
+
+/*
+ * Common IDCT helpers.
+ * A block is held in 8 registers of 8 16-bit samples, one register per row.
+ */
+
+/* Pairs of 16-bit constants for _mm_madd_epi16 on interleaved samples */
+#define PAIR(a,b)  _mm_set_epi16((short) (b), (short) (a), (short) (b), \
+				 (short) (a), (short) (b), (short) (a), \
+				 (short) (b), (short) (a))
+
+/* Interleave rows a and b, lower or upper four columns */
+#define INTERLEAVE(a,b,half)  ((half) ? _mm_unpackhi_epi16(a, b) : \
+				_mm_unpacklo_epi16(a, b))
+
+
+/*
+ * Load and dequantize the coefficients.  Returns FALSE when a product
+ * exceeds 15 bits plus sign: the 32-bit passes below could then
+ * overflow where the C code doesn't.
+ */
+
+LOCAL(boolean)
+dequantize (JCOEFPTR coef_block, MULTIPLIER * quantptr, __m128i * in)
+{
+  __m128i bad = _mm_setzero_si128();
+  __m128i c, q, lo, hi, sign;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    c = _mm_loadu_si128((const __m128i *) (coef_block + i * DCTSIZE));
+    q = _mm_packs_epi32(
+	  _mm_loadu_si128((const __m128i *) (quantptr + i * DCTSIZE)),
+	  _mm_loadu_si128((const __m128i *) (quantptr + i * DCTSIZE + 4)));
+    lo = _mm_mullo_epi16(c, q);
+    hi = _mm_mulhi_epi16(c, q);
+    sign = _mm_srai_epi16(lo, 15);
+    bad = _mm_or_si128(bad, _mm_xor_si128(hi, sign));
+    bad = _mm_or_si128(bad, _mm_xor_si128(_mm_srai_epi16(lo, 14), sign));
+    in[i] = lo;
+  }
+  return _mm_movemask_epi8(_mm_cmpeq_epi16(bad, _mm_setzero_si128())) == 0xFFFF;
+}
+
+
+/*
+ * Blocks whose AC terms are all zero are common; the C code reduces them
+ * to a single sample through its zero-column and zero-row shortcuts.
+ * Returns TRUE when the AC terms are zero.
+ */
+
+LOCAL(boolean)
+ac_zero (JCOEFPTR coef_block)
+{
+  __m128i ac = _mm_setzero_si128();
+  int i;
+
+  for (i = 1; i < DCTSIZE; i++)
+    ac = _mm_or_si128(ac, _mm_loadu_si128((const __m128i *)
+					  (coef_block + i * DCTSIZE)));
+  ac = _mm_or_si128(ac, _mm_srli_si128(_mm_loadu_si128((const __m128i *)
+							coef_block), 2));
+  return _mm_movemask_epi8(_mm_cmpeq_epi16(ac, _mm_setzero_si128())) == 0xFFFF;
+}
+
+
+/* Fill the block with the sample given by the descaled DC term */
+
+LOCAL(void)
+store_dc (j_decompress_ptr cinfo, int dcval,
+	  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i sample;
+  int i;
+
+  sample = _mm_set1_epi8((char) IDCT_range_limit(cinfo)[dcval & RANGE_MASK]);
+  for (i = 0; i < DCTSIZE; i++)
+    _mm_storel_epi64((__m128i *) (output_buf[i] + output_col), sample);
+}
+
+
+/*
+ * Pack the 32-bit results of a pass to 16 bits.
+ * Returns FALSE when a result doesn't fit.
+ */
+
+LOCAL(boolean)
+pack_pass (const __m128i * lo, const __m128i * hi, __m128i * out)
+{
+  __m128i bias = _mm_set1_epi32(32768);
+  __m128i range = _mm_setzero_si128();
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    range = _mm_or_si128(range, _mm_add_epi32(lo[i], bias));
+    range = _mm_or_si128(range, _mm_add_epi32(hi[i], bias));
+    out[i] = _mm_packs_epi32(lo[i], hi[i]);
+  }
+  range = _mm_srli_epi32(range, 16);
+  return _mm_movemask_epi8(_mm_cmpeq_epi32(range, _mm_setzero_si128())) == 0xFFFF;
+}
+
+
+/* Transpose an 8x8 block of 16-bit samples */
+
+LOCAL(void)
+transpose (const __m128i * in, __m128i * out)
+{
+  __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+  __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+  a0 = _mm_unpacklo_epi16(in[0], in[1]);
+  a1 = _mm_unpackhi_epi16(in[0], in[1]);
+  a2 = _mm_unpacklo_epi16(in[2], in[3]);
+  a3 = _mm_unpackhi_epi16(in[2], in[3]);
+  a4 = _mm_unpacklo_epi16(in[4], in[5]);
+  a5 = _mm_unpackhi_epi16(in[4], in[5]);
+  a6 = _mm_unpacklo_epi16(in[6], in[7]);
+  a7 = _mm_unpackhi_epi16(in[6], in[7]);
+
+  b0 = _mm_unpacklo_epi32(a0, a2);
+  b1 = _mm_unpackhi_epi32(a0, a2);
+  b2 = _mm_unpacklo_epi32(a1, a3);
+  b3 = _mm_unpackhi_epi32(a1, a3);
+  b4 = _mm_unpacklo_epi32(a4, a6);
+  b5 = _mm_unpackhi_epi32(a4, a6);
+  b6 = _mm_unpacklo_epi32(a5, a7);
+  b7 = _mm_unpackhi_epi32(a5, a7);
+
+  out[0] = _mm_unpacklo_epi64(b0, b4);
+  out[1] = _mm_unpackhi_epi64(b0, b4);
+  out[2] = _mm_unpacklo_epi64(b1, b5);
+  out[3] = _mm_unpackhi_epi64(b1, b5);
+  out[4] = _mm_unpacklo_epi64(b2, b6);
+  out[5] = _mm_unpackhi_epi64(b2, b6);
+  out[6] = _mm_unpacklo_epi64(b3, b7);
+  out[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+
+/*
+ * Emit the block.  col[k] holds output column k (one sample per row),
+ * already range limited to the signed 10-bit RANGE_MASK window;
+ * adding CENTERJSAMPLE and saturating gives what IDCT_range_limit gives.
+ */
+
+LOCAL(void)
+store_block (const __m128i * col, JSAMPARRAY output_buf,
+	     JDIMENSION output_col)
+{
+  __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  __m128i c01, c23, c45, c67, t0, t1, t2, t3, u0, u1, u2, u3, r;
+
+  c01 = _mm_packus_epi16(_mm_add_epi16(col[0], center),
+			 _mm_add_epi16(col[1], center));
+  c23 = _mm_packus_epi16(_mm_add_epi16(col[2], center),
+			 _mm_add_epi16(col[3], center));
+  c45 = _mm_packus_epi16(_mm_add_epi16(col[4], center),
+			 _mm_add_epi16(col[5], center));
+  c67 = _mm_packus_epi16(_mm_add_epi16(col[6], center),
+			 _mm_add_epi16(col[7], center));
+
+  t0 = _mm_unpacklo_epi8(c01, c23);
+  t1 = _mm_unpackhi_epi8(c01, c23);
+  t2 = _mm_unpacklo_epi8(c45, c67);
+  t3 = _mm_unpackhi_epi8(c45, c67);
+  u0 = _mm_unpacklo_epi8(t0, t1);	/* rows 0-3, columns 0-3 */
+  u1 = _mm_unpackhi_epi8(t0, t1);	/* rows 4-7, columns 0-3 */
+  u2 = _mm_unpacklo_epi8(t2, t3);	/* rows 0-3, columns 4-7 */
+  u3 = _mm_unpackhi_epi8(t2, t3);	/* rows 4-7, columns 4-7 */
+
+  r = _mm_unpacklo_epi32(u0, u2);
+  _mm_storel_epi64((__m128i *) (output_buf[0] + output_col), r);
+  _mm_storel_epi64((__m128i *) (output_buf[1] + output_col),
+		   _mm_srli_si128(r, 8));
+  r = _mm_unpackhi_epi32(u0, u2);
+  _mm_storel_epi64((__m128i *) (output_buf[2] + output_col), r);
+  _mm_storel_epi64((__m128i *) (output_buf[3] + output_col),
+		   _mm_srli_si128(r, 8));
+  r = _mm_unpacklo_epi32(u1, u3);
+  _mm_storel_epi64((__m128i *) (output_buf[4] + output_col), r);
+  _mm_storel_epi64((__m128i *) (output_buf[5] + output_col),
+		   _mm_srli_si128(r, 8));
+  r = _mm_unpackhi_epi32(u1, u3);
+  _mm_storel_epi64((__m128i *) (output_buf[6] + output_col), r);
+  _mm_storel_epi64((__m128i *) (output_buf[7] + output_col),
+		   _mm_srli_si128(r, 8));
+}
+
+
+#ifdef DCT_ISLOW_SUPPORTED
+
+/*
+ * One 1-D LL&M pass of jidctint.c over four columns (half = 0 or 1)
+ * of the 8 rows in[].  The 32-bit results are not descaled.
+ * The zero-AC shortcuts of the C code give the same values as the
+ * full computation, so they need no counterpart here.
+ */
+
+LOCAL(void)
+islow_1d (const __m128i * in, __m128i * out, int half, __m128i fudge)
+{
+  __m128i p04, p26, p75, p31, p71, p53;
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13, z2, z3;
+
+  p04 = INTERLEAVE(in[0], in[4], half);
+  p26 = INTERLEAVE(in[2], in[6], half);
+  p75 = INTERLEAVE(in[7], in[5], half);
+  p31 = INTERLEAVE(in[3], in[1], half);
+  p71 = INTERLEAVE(in[7], in[1], half);
+  p53 = INTERLEAVE(in[5], in[3], half);
+
+  /* Even part */
+
+  tmp2 = _mm_madd_epi16(p26, PAIR(4433 + 6270, 4433));
+  tmp3 = _mm_madd_epi16(p26, PAIR(4433, 4433 - 15137));
+
+  tmp0 = _mm_add_epi32(_mm_madd_epi16(p04, PAIR(8192, 8192)), fudge);
+  tmp1 = _mm_add_epi32(_mm_madd_epi16(p04, PAIR(8192, -8192)), fudge);
+
+  tmp10 = _mm_add_epi32(tmp0, tmp2);
+  tmp13 = _mm_sub_epi32(tmp0, tmp2);
+  tmp11 = _mm_add_epi32(tmp1, tmp3);
+  tmp12 = _mm_sub_epi32(tmp1, tmp3);
+
+  /* Odd part, with z1 folded into the coefficients */
+
+  z2 = _mm_add_epi32(_mm_madd_epi16(p75, PAIR(9633 - 16069, 9633)),
+		     _mm_madd_epi16(p31, PAIR(9633 - 16069, 9633)));
+  z3 = _mm_add_epi32(_mm_madd_epi16(p75, PAIR(9633, 9633 - 3196)),
+		     _mm_madd_epi16(p31, PAIR(9633, 9633 - 3196)));
+
+  tmp0 = _mm_add_epi32(_mm_madd_epi16(p71, PAIR(2446 - 7373, -7373)), z2);
+  tmp3 = _mm_add_epi32(_mm_madd_epi16(p71, PAIR(-7373, 12299 - 7373)), z3);
+  tmp1 = _mm_add_epi32(_mm_madd_epi16(p53, PAIR(16819 - 20995, -20995)), z3);
+  tmp2 = _mm_add_epi32(_mm_madd_epi16(p53, PAIR(-20995, 25172 - 20995)), z2);
+
+  /* Final output stage */
+
+  out[0] = _mm_add_epi32(tmp10, tmp3);
+  out[7] = _mm_sub_epi32(tmp10, tmp3);
+  out[1] = _mm_add_epi32(tmp11, tmp2);
+  out[6] = _mm_sub_epi32(tmp11, tmp2);
+  out[2] = _mm_add_epi32(tmp12, tmp1);
+  out[5] = _mm_sub_epi32(tmp12, tmp1);
+  out[3] = _mm_add_epi32(tmp13, tmp0);
+  out[4] = _mm_sub_epi32(tmp13, tmp0);
+}
+
+
+/*
+ * Replaces jpeg_idct_islow.
+ * CONST_BITS = 13 and PASS1_BITS = 2 are folded into the shifts.
+ */
+
+GLOBAL(void)
+jsimd_idct_islow (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i in[DCTSIZE], ws[DCTSIZE], lo[DCTSIZE], hi[DCTSIZE];
+  MULTIPLIER * quantptr = (MULTIPLIER *) compptr->dct_table;
+  INT32 dc = (INT32) coef_block[0] * quantptr[0];
+  __m128i fudge;
+  int i;
+  SHIFT_TEMPS
+
+  /* DC only: both passes reduce to DESCALE(DC << PASS1_BITS, PASS1_BITS+3) */
+
+  if (dc >= -16384 && dc < 16384 && ac_zero(coef_block)) {
+    store_dc(cinfo, (int) RIGHT_SHIFT(dc * 4 + 16, 5), output_buf, output_col);
+    return;
+  }
+
+  /* Pass 1: process columns from input */
+
+  if (! dequantize(coef_block, quantptr, in)) {
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+  fudge = _mm_set1_epi32(1 << 10);
+  islow_1d(in, lo, 0, fudge);
+  islow_1d(in, hi, 1, fudge);
+  for (i = 0; i < DCTSIZE; i++) {
+    lo[i] = _mm_srai_epi32(lo[i], 11);
+    hi[i] = _mm_srai_epi32(hi[i], 11);
+  }
+  if (! pack_pass(lo, hi, ws)) {
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 2: process rows from work array.
+   * Only bits 18..27 of the results survive RANGE_MASK, so the 32-bit
+   * arithmetic gives the same samples as the C code's INT32 arithmetic.
+   */
+
+  transpose(ws, in);
+  fudge = _mm_set1_epi32(1 << 17);
+  islow_1d(in, lo, 0, fudge);
+  islow_1d(in, hi, 1, fudge);
+  for (i = 0; i < DCTSIZE; i++) {
+    ws[i] = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo[i], 4), 22),
+			    _mm_srai_epi32(_mm_slli_epi32(hi[i], 4), 22));
+  }
+  store_block(ws, output_buf, output_col);
+}
+
+#endif /* DCT_ISLOW_SUPPORTED */
+
+
+#ifdef DCT_IFAST_SUPPORTED
+
+/*
+ * One 1-D AA&N pass of jidctfst.c over four columns (half = 0 or 1)
+ * of the 8 rows in[].  CONST_BITS = 8.
+ */
+
+LOCAL(void)
+ifast_1d (const __m128i * in, __m128i * out, int half)
+{
+  __m128i p04, p26, p17, p53;
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  __m128i tmp10, tmp11, tmp12, tmp13, z5;
+
+  p04 = INTERLEAVE(in[0], in[4], half);
+  p26 = INTERLEAVE(in[2], in[6], half);
+  p17 = INTERLEAVE(in[1], in[7], half);
+  p53 = INTERLEAVE(in[5], in[3], half);
+
+  /* Even part */
+
+  tmp10 = _mm_madd_epi16(p04, PAIR(1, 1));
+  tmp11 = _mm_madd_epi16(p04, PAIR(1, -1));
+
+  tmp13 = _mm_madd_epi16(p26, PAIR(1, 1));
+  tmp12 = _mm_sub_epi32(_mm_srai_epi32(_mm_madd_epi16(p26, PAIR(362, -362)),
+				       8), tmp13);
+
+  tmp0 = _mm_add_epi32(tmp10, tmp13);
+  tmp3 = _mm_sub_epi32(tmp10, tmp13);
+  tmp1 = _mm_add_epi32(tmp11, tmp12);
+  tmp2 = _mm_sub_epi32(tmp11, tmp12);
+
+  /* Odd part */
+
+  tmp7 = _mm_add_epi32(_mm_madd_epi16(p17, PAIR(1, 1)),
+		       _mm_madd_epi16(p53, PAIR(1, 1)));
+  tmp11 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(p17, PAIR(362, 362)),
+				       _mm_madd_epi16(p53, PAIR(-362, -362))),
+			 8);
+
+  z5 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(p53, PAIR(473, -473)),
+				    _mm_madd_epi16(p17, PAIR(473, -473))), 8);
+  tmp10 = _mm_sub_epi32(_mm_srai_epi32(_mm_madd_epi16(p17, PAIR(277, -277)),
+				       8), z5);
+  tmp12 = _mm_add_epi32(_mm_srai_epi32(_mm_madd_epi16(p53, PAIR(-669, 669)),
+				       8), z5);
+
+  tmp6 = _mm_sub_epi32(tmp12, tmp7);
+  tmp5 = _mm_sub_epi32(tmp11, tmp6);
+  tmp4 = _mm_add_epi32(tmp10, tmp5);
+
+  out[0] = _mm_add_epi32(tmp0, tmp7);
+  out[7] = _mm_sub_epi32(tmp0, tmp7);
+  out[1] = _mm_add_epi32(tmp1, tmp6);
+  out[6] = _mm_sub_epi32(tmp1, tmp6);
+  out[2] = _mm_add_epi32(tmp2, tmp5);
+  out[5] = _mm_sub_epi32(tmp2, tmp5);
+  out[4] = _mm_add_epi32(tmp3, tmp4);
+  out[3] = _mm_sub_epi32(tmp3, tmp4);
+}
+
+
+/*
+ * Replaces jpeg_idct_ifast.
+ */
+
+GLOBAL(void)
+jsimd_idct_ifast (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i in[DCTSIZE], ws[DCTSIZE], lo[DCTSIZE], hi[DCTSIZE];
+  MULTIPLIER * quantptr = (MULTIPLIER *) compptr->dct_table;
+  INT32 dc = (INT32) coef_block[0] * quantptr[0];
+  int i;
+  SHIFT_TEMPS
+
+  /* DC only: both passes reduce to IDESCALE(DC, PASS1_BITS+3) */
+
+  if (dc >= -16384 && dc < 16384 && ac_zero(coef_block)) {
+    store_dc(cinfo, (int) RIGHT_SHIFT(dc, 5), output_buf, output_col);
+    return;
+  }
+
+  /* Pass 1: process columns from input */
+
+  if (! dequantize(coef_block, quantptr, in)) {
+    jpeg_idct_ifast(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+  ifast_1d(in, lo, 0);
+  ifast_1d(in, hi, 1);
+  if (! pack_pass(lo, hi, ws)) {
+    jpeg_idct_ifast(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 2: process rows from work array, descale by PASS1_BITS+3 */
+
+  transpose(ws, in);
+  ifast_1d(in, lo, 0);
+  ifast_1d(in, hi, 1);
+  for (i = 0; i < DCTSIZE; i++) {
+    ws[i] = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo[i], 17), 22),
+			    _mm_srai_epi32(_mm_slli_epi32(hi[i], 17), 22));
+  }
+  store_block(ws, output_buf, output_col);
+}
+
+#endif /* DCT_IFAST_SUPPORTED */
+
+
+/*
+ * YCbCr=>RGB conversion, same fixed-point terms as build_ycc_rgb_table:
+ *	R = Y + round(1.402 * Cr)
+ *	G = Y + ((- 0.344136286 * Cb - 0.714136286 * Cr + ONE_HALF) >> 16)
+ *	B = Y + round(1.772 * Cb)
+ * The multipliers are split into an integer and a 16-bit part.
+ */
+
+#define SCALEBITS	16	/* speediest right-shift on some machines */
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+#define CFIX(x)		((INT32) ((x) * (1L<<SCALEBITS) + 0.5))
+
+
+/* Chroma terms of 8 pixels, term[0..2] = red, green, blue */
+
+LOCAL(void)
+chroma_terms (__m128i cb, __m128i cr, __m128i * term)
+{
+  __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  __m128i k_r = _mm_set1_epi16((short) (CFIX(1.402) - (1L<<SCALEBITS)));
+  __m128i k_b = _mm_set1_epi16((short) (CFIX(1.772) - (2L<<SCALEBITS)));
+  __m128i k_g = PAIR(- CFIX(0.344136286),
+		     (1L<<SCALEBITS) - CFIX(0.714136286));
+  __m128i half = _mm_set1_epi32(ONE_HALF);
+  __m128i lo, hi;
+
+  cb = _mm_sub_epi16(cb, center);
+  cr = _mm_sub_epi16(cr, center);
+
+  /* rounded high half of the product: mulhi plus bit 15 of mullo */
+  term[0] = _mm_add_epi16(_mm_add_epi16(cr, _mm_mulhi_epi16(cr, k_r)),
+			  _mm_srli_epi16(_mm_mullo_epi16(cr, k_r), 15));
+  term[2] = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(cb, cb),
+					_mm_mulhi_epi16(cb, k_b)),
+			  _mm_srli_epi16(_mm_mullo_epi16(cb, k_b), 15));
+
+  lo = _mm_madd_epi16(_mm_unpacklo_epi16(cb, cr), k_g);
+  hi = _mm_madd_epi16(_mm_unpackhi_epi16(cb, cr), k_g);
+  lo = _mm_srai_epi32(_mm_add_epi32(lo, half), SCALEBITS);
+  hi = _mm_srai_epi32(_mm_add_epi32(hi, half), SCALEBITS);
+  term[1] = _mm_sub_epi16(_mm_packs_epi32(lo, hi), cr);
+}
+
+
+/*
+ * Emit 16 RGB pixels.  term[] holds the red, green and blue terms
+ * of pixels 0-7 followed by those of pixels 8-15.
+ */
+
+LOCAL(void)
+rgb_16 (__m128i y, const __m128i * term, JSAMPROW outptr)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i mask1 = _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF);
+  __m128i mask2 = _mm_set_epi32(0xFFFF, (int) 0xFF000000,
+				0xFFFF, (int) 0xFF000000);
+  __m128i ylo = _mm_unpacklo_epi8(y, zero);
+  __m128i yhi = _mm_unpackhi_epi8(y, zero);
+  __m128i r, g, b, rg, bz, p[4];
+  int i;
+
+  r = _mm_packus_epi16(_mm_add_epi16(ylo, term[0]),
+		       _mm_add_epi16(yhi, term[3]));
+  g = _mm_packus_epi16(_mm_add_epi16(ylo, term[1]),
+		       _mm_add_epi16(yhi, term[4]));
+  b = _mm_packus_epi16(_mm_add_epi16(ylo, term[2]),
+		       _mm_add_epi16(yhi, term[5]));
+
+  /* RGB0 quadruplets */
+  rg = _mm_unpacklo_epi8(r, g);
+  bz = _mm_unpacklo_epi8(b, zero);
+  p[0] = _mm_unpacklo_epi16(rg, bz);
+  p[1] = _mm_unpackhi_epi16(rg, bz);
+  rg = _mm_unpackhi_epi8(r, g);
+  bz = _mm_unpackhi_epi8(b, zero);
+  p[2] = _mm_unpacklo_epi16(rg, bz);
+  p[3] = _mm_unpackhi_epi16(rg, bz);
+
+  /* squeeze each register to 12 bytes */
+  for (i = 0; i < 4; i++) {
+    p[i] = _mm_or_si128(_mm_and_si128(p[i], mask1),
+			_mm_and_si128(_mm_srli_epi64(p[i], 8), mask2));
+    p[i] = _mm_or_si128(_mm_move_epi64(p[i]),
+			_mm_slli_si128(_mm_srli_si128(p[i], 8), 6));
+  }
+
+  _mm_storeu_si128((__m128i *) outptr,
+		   _mm_or_si128(p[0], _mm_slli_si128(p[1], 12)));
+  _mm_storeu_si128((__m128i *) (outptr + 16),
+		   _mm_or_si128(_mm_srli_si128(p[1], 4),
+				_mm_slli_si128(p[2], 8)));
+  _mm_storeu_si128((__m128i *) (outptr + 32),
+		   _mm_or_si128(_mm_srli_si128(p[2], 8),
+				_mm_slli_si128(p[3], 4)));
+}
+
+
+/* Convert 16 pixels of full resolution Y, Cb, Cr */
+
+LOCAL(void)
+ycc_rgb_16 (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	    JSAMPROW outptr)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i y = _mm_loadu_si128((const __m128i *) inptr0);
+  __m128i cb = _mm_loadu_si128((const __m128i *) inptr1);
+  __m128i cr = _mm_loadu_si128((const __m128i *) inptr2);
+  __m128i term[6];
+
+  chroma_terms(_mm_unpacklo_epi8(cb, zero), _mm_unpacklo_epi8(cr, zero),
+	       term);
+  chroma_terms(_mm_unpackhi_epi8(cb, zero), _mm_unpackhi_epi8(cr, zero),
+	       term + 3);
+  rgb_16(y, term, outptr);
+}
+
+
+/*
+ * Replaces ycc_rgb_convert.
+ * The last pixels of a row go through a scratch buffer so that
+ * nothing is read or written past the ends of the rows.
+ */
+
+GLOBAL(void)
+jsimd_ycc_rgb_convert (j_decompress_ptr cinfo,
+		       JSAMPIMAGE input_buf, JDIMENSION input_row,
+		       JSAMPARRAY output_buf, int num_rows)
+{
+  JSAMPROW inptr0, inptr1, inptr2, outptr;
+  JDIMENSION col, rest;
+  JDIMENSION num_cols = cinfo->output_width;
+  JSAMPLE tmp[4][16 * RGB_PIXELSIZE];
+
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr = *output_buf++;
+    for (col = 0; col + 16 <= num_cols; col += 16) {
+      ycc_rgb_16(inptr0 + col, inptr1 + col, inptr2 + col,
+		 outptr + col * RGB_PIXELSIZE);
+    }
+    rest = num_cols - col;
+    if (rest > 0) {
+      MEMZERO(tmp, SIZEOF(tmp));
+      MEMCOPY(tmp[0], inptr0 + col, rest * SIZEOF(JSAMPLE));
+      MEMCOPY(tmp[1], inptr1 + col, rest * SIZEOF(JSAMPLE));
+      MEMCOPY(tmp[2], inptr2 + col, rest * SIZEOF(JSAMPLE));
+      ycc_rgb_16(tmp[0], tmp[1], tmp[2], tmp[3]);
+      MEMCOPY(outptr + col * RGB_PIXELSIZE, tmp[3],
+	      rest * RGB_PIXELSIZE * SIZEOF(JSAMPLE));
+    }
+  }
+}
+
+
+/*
+ * Merged upsampling: 16 output pixels share the terms of 8 chroma samples.
+ */
+
+LOCAL(void)
+merged_16 (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	   JSAMPROW outptr)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i y = _mm_loadu_si128((const __m128i *) inptr0);
+  __m128i cb = _mm_loadl_epi64((const __m128i *) inptr1);
+  __m128i cr = _mm_loadl_epi64((const __m128i *) inptr2);
+  __m128i t[3], term[6];
+  int i;
+
+  chroma_terms(_mm_unpacklo_epi8(cb, zero), _mm_unpacklo_epi8(cr, zero), t);
+  for (i = 0; i < 3; i++) {
+    term[i] = _mm_unpacklo_epi16(t[i], t[i]);
+    term[i + 3] = _mm_unpackhi_epi16(t[i], t[i]);
+  }
+  rgb_16(y, term, outptr);
+}
+
+
+/* Upsample and convert one output row, with an odd width as in jdmerge.c */
+
+LOCAL(void)
+merged_row (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	    JSAMPROW outptr, JDIMENSION num_cols)
+{
+  JDIMENSION col, rest;
+  JSAMPLE tmp[4][16 * RGB_PIXELSIZE];
+
+  for (col = 0; col + 16 <= num_cols; col += 16) {
+    merged_16(inptr0 + col, inptr1 + (col >> 1), inptr2 + (col >> 1),
+	      outptr + col * RGB_PIXELSIZE);
+  }
+  rest = num_cols - col;
+  if (rest > 0) {
+    MEMZERO(tmp, SIZEOF(tmp));
+    MEMCOPY(tmp[0], inptr0 + col, rest * SIZEOF(JSAMPLE));
+    MEMCOPY(tmp[1], inptr1 + (col >> 1), ((rest + 1) >> 1) * SIZEOF(JSAMPLE));
+    MEMCOPY(tmp[2], inptr2 + (col >> 1), ((rest + 1) >> 1) * SIZEOF(JSAMPLE));
+    merged_16(tmp[0], tmp[1], tmp[2], tmp[3]);
+    MEMCOPY(outptr + col * RGB_PIXELSIZE, tmp[3],
+	    rest * RGB_PIXELSIZE * SIZEOF(JSAMPLE));
+  }
+}
+
+
+/*
+ * Replaces h2v1_merged_upsample.
+ */
+
+GLOBAL(void)
+jsimd_h2v1_merged_upsample (j_decompress_ptr cinfo,
+			    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+			    JSAMPARRAY output_buf)
+{
+  merged_row(input_buf[0][in_row_group_ctr],
+	     input_buf[1][in_row_group_ctr],
+	     input_buf[2][in_row_group_ctr],
+	     output_buf[0], cinfo->output_width);
+}
+
+
+/*
+ * Replaces h2v2_merged_upsample.
+ */
+
+GLOBAL(void)
+jsimd_h2v2_merged_upsample (j_decompress_ptr cinfo,
+			    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+			    JSAMPARRAY output_buf)
+{
+  JSAMPROW inptr1 = input_buf[1][in_row_group_ctr];
+  JSAMPROW inptr2 = input_buf[2][in_row_group_ctr];
+
+  merged_row(input_buf[0][in_row_group_ctr*2], inptr1, inptr2,
+	     output_buf[0], cinfo->output_width);
+  merged_row(input_buf[0][in_row_group_ctr*2 + 1], inptr1, inptr2,
+	     output_buf[1], cinfo->output_width);
+}
+
+#endif /* JSIMD_SUPPORTED */
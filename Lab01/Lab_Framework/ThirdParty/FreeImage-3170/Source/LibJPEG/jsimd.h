@@ -0,0 +1,75 @@
+/*
+ * jsimd.h
+ *
+ * This file is part of the FreeImage distribution of the IJG software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This include file declares the SIMD versions of the decompressor's
+ * inner loops (jsimd.c).  Each routine gives exactly the same output as
+ * the C routine it replaces, and falls back to it whenever its narrower
+ * arithmetic could differ (corrupt data, unusual quantization tables).
+ * The module initialization routines select the SIMD routines when the
+ * jsimd_can_xxx() tests succeed.
+ */
+
+
+/* Same SSE2 test as FREEIMAGE_SSE2 in FreeImage's Utilities.h. */
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#if BITS_IN_JSAMPLE == 8 && RGB_PIXELSIZE == 3 && \
+    RGB_RED == 0 && RGB_GREEN == 1 && RGB_BLUE == 2
+#define JSIMD_SUPPORTED
+#endif
+#endif
+
+
+/* Short forms of external names for systems with brain-damaged linkers. */
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jsimd_set_enabled	jSSetEnabled
+#define jsimd_is_enabled	jSIsEnabled
+#define jsimd_can_idct		jSCanIDCT
+#define jsimd_can_color		jSCanColor
+#define jsimd_idct_islow	jSIDislow
+#define jsimd_idct_ifast	jSIDifast
+#define jsimd_ycc_rgb_convert	jSYCCRGB
+#define jsimd_h2v1_merged_upsample	jSH2V1Merged
+#define jsimd_h2v2_merged_upsample	jSH2V2Merged
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+
+/* Process wide switch, the SIMD routines are enabled by default.
+ * The selection is made when a decompression pass starts.
+ */
+EXTERN(void) jsimd_set_enabled JPP((int enabled));
+EXTERN(int) jsimd_is_enabled JPP((void));
+
+#ifdef JPEG_INTERNALS
+
+/* TRUE when the 8x8 integer IDCTs can use the multiplier table of compptr */
+EXTERN(boolean) jsimd_can_idct JPP((j_decompress_ptr cinfo,
+				    jpeg_component_info * compptr));
+/* TRUE when the YCbCr->RGB conversions can be used */
+EXTERN(boolean) jsimd_can_color JPP((void));
+
+EXTERN(void) jsimd_idct_islow
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jsimd_idct_ifast
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+
+/* Replaces ycc_rgb_convert (jdcolor.c) */
+EXTERN(void) jsimd_ycc_rgb_convert
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf, JDIMENSION input_row,
+	 JSAMPARRAY output_buf, int num_rows));
+/* Replace h2v1_merged_upsample and h2v2_merged_upsample (jdmerge.c) */
+EXTERN(void) jsimd_h2v1_merged_upsample
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
+	 JDIMENSION in_row_group_ctr, JSAMPARRAY output_buf));
+EXTERN(void) jsimd_h2v2_merged_upsample
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
+	 JDIMENSION in_row_group_ctr, JSAMPARRAY output_buf));
+
+#endif /* JPEG_INTERNALS */
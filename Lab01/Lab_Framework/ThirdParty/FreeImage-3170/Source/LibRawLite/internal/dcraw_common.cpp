@@ -4211,9 +4211,51 @@ void CLASS green_matching()
   free(img);
 }
 
+#ifdef LIBRAW_LIBRARY_BUILD
+struct scale_colors_wb_job
+{
+  unsigned top, left, bottom, right;
+  double (*dsum)[8];
+};
+
+/* Grey box sums of the 8-row block rows [first,last), one dsum per block row */
+void CLASS scale_colors_wb_band(void *job, unsigned first, unsigned last)
+{
+  scale_colors_wb_job *wb = (scale_colors_wb_job *) job;
+  unsigned row, col, x, y, c, sum[8];
+  int val;
+
+  for (unsigned block=first; block < last; block++) {
+    row = wb->top + block*8;
+    for (col=wb->left; col < wb->right; col += 8) {
+      memset (sum, 0, sizeof sum);
+      for (y=row; y < row+8 && y < wb->bottom; y++)
+	for (x=col; x < col+8 && x < wb->right; x++)
+	  FORC4 {
+	    if (filters) {
+	      c = fcol(y,x);
+	      val = BAYER2(y,x);
+	    } else
+	      val = image[y*width+x][c];
+	    if ((unsigned) val > maximum-25) goto skip_block;
+	    if ((val -= cblack[c]) < 0) val = 0;
+	    sum[c] += val;
+	    sum[c+4]++;
+	    if (filters) break;
+	  }
+      FORC(8) wb->dsum[block][c] += sum[c];
+skip_block: ;
+    }
+  }
+}
+#endif
+
 void CLASS scale_colors()
 {
-  unsigned bottom, right, size, row, col, ur, uc, i, x, y, c, sum[8];
+  unsigned bottom, right, size, row, col, ur, uc, i, c, sum[8];
+#ifndef LIBRAW_LIBRARY_BUILD
+  unsigned x, y;
+#endif
   int val, dark, sat;
   double dsum[8], dmin, dmax;
   float scale_mul[4], fr, fc;
@@ -4229,6 +4271,18 @@ void CLASS scale_colors()
     memset (dsum, 0, sizeof dsum);
     bottom = MIN (greybox[1]+greybox[3], height);
     right  = MIN (greybox[0]+greybox[2], width);
+#ifdef LIBRAW_LIBRARY_BUILD
+    // one dsum per 8-row block row, merged in order, so that dsum does not
+    // depend on the number of threads
+    scale_colors_wb_job wb = { greybox[1], greybox[0], bottom, right, 0 };
+    unsigned blocks = bottom > greybox[1] ? (bottom - greybox[1] + 7) / 8 : 0;
+    wb.dsum = (double (*)[8]) calloc (MAX(blocks,1), sizeof *wb.dsum);
+    merror (wb.dsum, "scale_colors()");
+    parallel_for(0, blocks, 1, &LibRaw::scale_colors_wb_band, &wb);
+    for (i=0; i < blocks; i++)
+      FORC(8) dsum[c] += wb.dsum[i][c];
+    free (wb.dsum);
+#else
     for (row=greybox[1]; row < bottom; row += 8)
       for (col=greybox[0]; col < right; col += 8) {
 	memset (sum, 0, sizeof sum);
@@ -4249,6 +4303,7 @@ void CLASS scale_colors()
 	FORC(8) dsum[c] += sum[c];
 skip_block: ;
       }
+#endif
     FORC4 if (dsum[c]) pre_mul[c] = dsum[c+4] / dsum[c];
   }
   if (use_camera_wb && cam_mul[0] != -1) {
@@ -5188,6 +5243,42 @@ void CLASS ahd_interpolate_combine_homogeneous_pixels(int top, int left, ushort
     }
   }
 }
+#ifdef LIBRAW_LIBRARY_BUILD
+struct ahd_interpolate_job
+{
+  unsigned tiles_down, tiles_across;
+  unsigned row_phase, col_phase, phase_across;
+  char *done;
+};
+
+/* Interpolates the tiles [first,last) of the current phase.  A tile reads
+   image[] 2 pixels beyond its TS x TS box and writes its interior, which
+   overlaps the box of the next tile, so only the tiles whose row and column
+   have the phase parity run together: they are at least one tile apart */
+void CLASS ahd_interpolate_band(void *job, unsigned first, unsigned last)
+{
+  ahd_interpolate_job *ahd = (ahd_interpolate_job *) job;
+  char *buffer = (char *) ::malloc (26*TS*TS);
+  if (!buffer) return;
+  ushort (*rgb)[TS][TS][3] = (ushort(*)[TS][TS][3]) buffer;
+  short (*lab)[TS][TS][3] = (short (*)[TS][TS][3])(buffer + 12*TS*TS);
+  char (*homo)[TS][2] = (char  (*)[TS][2])    (buffer + 24*TS*TS);
+
+  for (unsigned i=first; i < last; i++) {
+    unsigned tile_row = ahd->row_phase + 2 * (i / ahd->phase_across);
+    unsigned tile_col = ahd->col_phase + 2 * (i % ahd->phase_across);
+    int top = 2 + tile_row * (TS-6);
+    int left = 2 + tile_col * (TS-6);
+    ahd_interpolate_green_h_and_v(top, left, rgb);
+    ahd_interpolate_r_and_b_and_convert_to_cielab(top, left, rgb, lab);
+    ahd_interpolate_build_homogeneity_map(top, left, lab, homo);
+    ahd_interpolate_combine_homogeneous_pixels(top, left, rgb, homo);
+    ahd->done[tile_row * ahd->tiles_across + tile_col] = 1;
+  }
+  ::free (buffer);
+}
+#endif
+
 void CLASS ahd_interpolate()
 {
   int i, j, k, top, left;
@@ -5203,6 +5294,36 @@ void CLASS ahd_interpolate()
   border_interpolate(5);
 
 #ifdef LIBRAW_LIBRARY_BUILD
+  if (callbacks.parallel_cb && height > 7 && width > 7) {
+    ahd_interpolate_job job;
+    job.tiles_down = (height-7 + TS-7) / (TS-6);
+    job.tiles_across = (width-7 + TS-7) / (TS-6);
+    unsigned tiles = job.tiles_down * job.tiles_across;
+    job.done = (char *) calloc (tiles, 1);
+    merror (job.done, "ahd_interpolate()");
+    if (callbacks.progress_cb && (*callbacks.progress_cb)(callbacks.progresscb_data,LIBRAW_PROGRESS_INTERPOLATE,0,height-7)) {
+      free (job.done);
+      throw LIBRAW_EXCEPTION_CANCELLED_BY_CALLBACK;
+    }
+    // the CFA samples rewritten by a tile keep their value, so the phase
+    // order gives the same image as the serial raster order
+    for (unsigned phase=0; phase < 4; phase++) {
+      job.row_phase = phase >> 1;
+      job.col_phase = phase & 1;
+      if (job.row_phase >= job.tiles_down || job.col_phase >= job.tiles_across)
+        continue;
+      unsigned phase_down = (job.tiles_down - job.row_phase + 1) / 2;
+      job.phase_across = (job.tiles_across - job.col_phase + 1) / 2;
+      parallel_for(0, phase_down * job.phase_across, 1, &LibRaw::ahd_interpolate_band, &job);
+    }
+    for (unsigned tile=0; tile < tiles; tile++)
+      if (!job.done[tile]) {
+        free (job.done);
+        merror (0, "ahd_interpolate()");
+      }
+    free (job.done);
+    return;
+  }
 #ifdef LIBRAW_USE_OPENMP
 #pragma omp parallel private(buffer,rgb,lab,homo,top,left,i,j,k) shared(xyz_cam,terminate_flag)
 #endif
@@ -245,6 +245,8 @@ void        crw_init_tables (unsigned table, ushort *huff[2]);
     void ahd_interpolate_r_and_b_and_convert_to_cielab(int top, int left, ushort (*inout_rgb)[TS][TS][3], short (*out_lab)[TS][TS][3]);
     void ahd_interpolate_build_homogeneity_map(int top, int left, short (*lab)[TS][TS][3], char (*out_homogeneity_map)[TS][2]);
     void ahd_interpolate_combine_homogeneous_pixels(int top, int left, ushort (*rgb)[TS][TS][3], char (*homogeneity_map)[TS][2]);
+    void ahd_interpolate_band(void *job, unsigned first, unsigned last);
+    void scale_colors_wb_band(void *job, unsigned first, unsigned last);
 
 #undef TS
 
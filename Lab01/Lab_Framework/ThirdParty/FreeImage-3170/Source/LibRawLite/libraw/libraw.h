@@ -78,6 +78,7 @@ DllDef    void                libraw_set_memerror_handler(libraw_data_t*, memory
 DllDef    void                libraw_set_exifparser_handler(libraw_data_t*, exif_parser_callback cb, void *datap);
 DllDef    void                libraw_set_dataerror_handler(libraw_data_t*,data_callback func,void *datap);
 DllDef    void                libraw_set_progress_handler(libraw_data_t*,progress_callback cb,void *datap);
+DllDef    void                libraw_set_parallel_handler(libraw_data_t*,parallel_callback cb,void *datap);
 DllDef    const char *        libraw_unpack_function_name(libraw_data_t* lr);
 DllDef    int                 libraw_get_decoder_info(libraw_data_t* lr,libraw_decoder_info_t* d);
 DllDef    int libraw_COLOR(libraw_data_t*,int row, int col);
@@ -129,6 +130,8 @@ class DllDef LibRaw
     void                        set_memerror_handler( memory_callback cb,void *data) {callbacks.memcb_data = data; callbacks.mem_cb = cb; }
     void                        set_dataerror_handler(data_callback func, void *data) { callbacks.datacb_data = data; callbacks.data_cb = func;}
     void                        set_progress_handler(progress_callback pcb, void *data) { callbacks.progresscb_data = data; callbacks.progress_cb = pcb;}
+    /* black level, white balance, AHD and output conversion loops run through pcb when set */
+    void                        set_parallel_handler(parallel_callback pcb, void *data) { callbacks.parallelcb_data = data; callbacks.parallel_cb = pcb;}
 
     /* helpers */
     static const char*          version();
@@ -198,6 +201,17 @@ protected:
     virtual void lin_interpolate_loop(int code[16][16][32],int size);
     virtual void scale_colors_loop(float scale_mul[4]);
 
+    /* Parallel loops: 'method' is called with disjoint [first,last) sub-ranges,
+       concurrently when a parallel handler is set, so it must not throw */
+    typedef void (LibRaw::*parallel_method)(void *job, unsigned first, unsigned last);
+    struct parallel_context { LibRaw *self; parallel_method method; void *job; };
+    static void parallel_band(void *context, unsigned first, unsigned last);
+    void        parallel_for(unsigned begin, unsigned end, unsigned grain, parallel_method method, void *job);
+    void        copy_bayer_band(void *job, unsigned first, unsigned last);
+    void        scale_colors_band(void *job, unsigned first, unsigned last);
+    void        convert_to_rgb_band(void *job, unsigned first, unsigned last);
+    void        copy_mem_image_band(void *job, unsigned first, unsigned last);
+
     int FCF(int row,int col) { 
         int rr,cc;
         if (libraw_internal_data.unpacker_data.fuji_layout) {
@@ -122,6 +122,11 @@ DllDef void default_data_callback(void *data,const char *file, const int offset)
 
 typedef int (* progress_callback) (void *data,enum LibRaw_progress stage, int iteration,int expected);
 
+/* Processes the indices [first,last) of a parallel loop */
+typedef void (* parallel_band_callback)(void *context, unsigned first, unsigned last);
+/* Calls band() for disjoint sub-ranges covering [begin,end), possibly concurrently, and returns when all are done */
+typedef void (* parallel_callback)(void *data, unsigned begin, unsigned end, unsigned grain, parallel_band_callback band, void *context);
+
 typedef struct
 {
     memory_callback mem_cb;
@@ -135,6 +140,9 @@ typedef struct
 
 	exif_parser_callback exif_cb;
 	void *exifparser_data;
+
+    parallel_callback parallel_cb;
+    void *parallelcb_data;
 } libraw_callbacks_t;
 
 
@@ -155,6 +155,13 @@ extern "C"
         LibRaw *ip = (LibRaw*) lr->parent_class;
         ip->set_progress_handler(cb,data);
 
+    }
+    void  libraw_set_parallel_handler(libraw_data_t* lr, parallel_callback cb,void *data)
+    {
+        if(!lr) return;
+        LibRaw *ip = (LibRaw*) lr->parent_class;
+        ip->set_parallel_handler(cb,data);
+
     }
 
     // DCRAW
@@ -1891,41 +1891,83 @@ void LibRaw::copy_fuji_uncropped(unsigned short cblack[4],unsigned short *dmaxp)
     }
 }
 
-void LibRaw::copy_bayer(unsigned short cblack[4],unsigned short *dmaxp)
+void LibRaw::parallel_band(void *context, unsigned first, unsigned last)
 {
-  // Both cropped and uncropped
-  int row;
+  parallel_context *pc = (parallel_context *) context;
+  (pc->self->*pc->method)(pc->job, first, last);
+}
 
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp parallel for default(shared)
-#endif
-  for (row=0; row < S.height; row++)
+void LibRaw::parallel_for(unsigned begin, unsigned end, unsigned grain, parallel_method method, void *job)
+{
+  if (begin >= end)
+    return;
+  if (callbacks.parallel_cb)
     {
-      int col;
+      parallel_context context = { this, method, job };
+      (*callbacks.parallel_cb)(callbacks.parallelcb_data, begin, end, grain, &LibRaw::parallel_band, &context);
+    }
+  else
+    (this->*method)(job, begin, end);
+}
+
+// Loops with a reduction are split in a fixed number of chunks so that
+// the merged result does not depend on the way the bands are scheduled
+#define LIBRAW_PARALLEL_CHUNKS 16
+#define CHUNK_BEGIN(chunk,chunks,count) ((unsigned)(((unsigned long long)(count) * (chunk)) / (chunks)))
+
+struct copy_bayer_job
+{
+  unsigned short *cblack;
+  unsigned chunks;
+  unsigned short dmax[LIBRAW_PARALLEL_CHUNKS];
+};
+
+void LibRaw::copy_bayer_band(void *job, unsigned first, unsigned last)
+{
+  copy_bayer_job *cb = (copy_bayer_job *) job;
+  unsigned short *cblack = cb->cblack;
+  // chunks hold whole row pairs, rows merged by shrink stay in the same band
+  unsigned pairs = (S.height + 1) / 2;
+
+  for (unsigned chunk = first; chunk < last; chunk++)
+    {
+      int row_end = MIN(2 * CHUNK_BEGIN(chunk + 1, cb->chunks, pairs), S.height);
       unsigned short ldmax = 0;
-      for (col=0; col < S.width; col++)
+      for (int row = 2 * CHUNK_BEGIN(chunk, cb->chunks, pairs); row < row_end; row++)
         {
-          unsigned short val = imgdata.rawdata.raw_image[(row+S.top_margin)*S.raw_pitch/2+(col+S.left_margin)];
-          int cc = fcol(row,col);
-          if(val>cblack[cc])
+          int col;
+          for (col=0; col < S.width; col++)
             {
-              val-=cblack[cc];
-              if(val>ldmax)ldmax = val;
+              unsigned short val = imgdata.rawdata.raw_image[(row+S.top_margin)*S.raw_pitch/2+(col+S.left_margin)];
+              int cc = fcol(row,col);
+              if(val>cblack[cc])
+                {
+                  val-=cblack[cc];
+                  if(val>ldmax)ldmax = val;
+                }
+              else
+                val = 0;
+              imgdata.image[((row) >> IO.shrink)*S.iwidth + ((col) >> IO.shrink)][cc] = val;
             }
-          else
-            val = 0;
-          imgdata.image[((row) >> IO.shrink)*S.iwidth + ((col) >> IO.shrink)][cc] = val;
         }
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp critical(dataupdate)
-#endif
-      {
-        if(*dmaxp < ldmax)
-          *dmaxp = ldmax;
-      }
+      cb->dmax[chunk] = ldmax;
     }
 }
 
+void LibRaw::copy_bayer(unsigned short cblack[4],unsigned short *dmaxp)
+{
+  // Both cropped and uncropped
+  copy_bayer_job job;
+  job.cblack = cblack;
+  job.chunks = callbacks.parallel_cb ? LIBRAW_PARALLEL_CHUNKS : 1;
+
+  parallel_for(0, job.chunks, 1, &LibRaw::copy_bayer_band, &job);
+
+  for (unsigned chunk = 0; chunk < job.chunks; chunk++)
+    if(*dmaxp < job.dmax[chunk])
+      *dmaxp = job.dmax[chunk];
+}
+
 
 int LibRaw::raw2image_ex(int do_subtract_black)
 {
@@ -2274,6 +2316,49 @@ void LibRaw::get_mem_image_format(int* width, int* height, int* colors, int* bps
   *bps = O.output_bps;
 }
 
+struct copy_mem_image_job
+{
+  void *scan0;
+  int stride, bgr;
+  int soff, rstep, cstep;
+};
+
+void LibRaw::copy_mem_image_band(void *job, unsigned first, unsigned last)
+{
+  copy_mem_image_job *cm = (copy_mem_image_job *) job;
+  uchar *ppm;
+  ushort *ppm2;
+  int c, row, col;
+  int soff = cm->soff + first * (S.width * cm->cstep + cm->rstep);
+
+  for (row=first; row < (int)last; row++, soff += cm->rstep)
+    {
+      uchar *bufp = ((uchar*)cm->scan0)+row*cm->stride;
+      ppm2 = (ushort*) (ppm = bufp);
+      // keep trivial decisions in the outer loop for speed
+      if (cm->bgr) {
+        if (O.output_bps == 8) {
+          for (col=0; col < S.width; col++, soff += cm->cstep)
+            FORBGR *ppm++ = imgdata.color.curve[imgdata.image[soff][c]]>>8;
+        }
+        else {
+          for (col=0; col < S.width; col++, soff += cm->cstep)
+            FORBGR *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
+        }
+      }
+      else {
+        if (O.output_bps == 8) {
+          for (col=0; col < S.width; col++, soff += cm->cstep)
+            FORRGB *ppm++ = imgdata.color.curve[imgdata.image[soff][c]]>>8;
+        }
+        else {
+          for (col=0; col < S.width; col++, soff += cm->cstep)
+            FORRGB *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
+        }
+      }
+    }
+}
+
 int LibRaw::copy_mem_image(void* scan0, int stride, int bgr)
 
 {
@@ -2304,42 +2389,15 @@ int LibRaw::copy_mem_image(void* scan0, int stride, int bgr)
     S.iwidth  = S.width;
 
     if (S.flip & 4) SWAP(S.height,S.width);
-    uchar *ppm;
-    ushort *ppm2;
-    int c, row, col, soff, rstep, cstep;
+    copy_mem_image_job job;
+    job.scan0 = scan0;
+    job.stride = stride;
+    job.bgr = bgr;
+    job.soff  = flip_index (0, 0);
+    job.cstep = flip_index (0, 1) - job.soff;
+    job.rstep = flip_index (1, 0) - flip_index (0, S.width);
 
-    soff  = flip_index (0, 0);
-    cstep = flip_index (0, 1) - soff;
-    rstep = flip_index (1, 0) - flip_index (0, S.width);
-
-    for (row=0; row < S.height; row++, soff += rstep)
-      {
-        uchar *bufp = ((uchar*)scan0)+row*stride;
-        ppm2 = (ushort*) (ppm = bufp);
-        // keep trivial decisions in the outer loop for speed
-        if (bgr) {
-          if (O.output_bps == 8) {
-            for (col=0; col < S.width; col++, soff += cstep)
-              FORBGR *ppm++ = imgdata.color.curve[imgdata.image[soff][c]]>>8;
-          }
-          else {
-            for (col=0; col < S.width; col++, soff += cstep)
-              FORBGR *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
-          }
-        }
-        else {
-          if (O.output_bps == 8) {
-            for (col=0; col < S.width; col++, soff += cstep)
-              FORRGB *ppm++ = imgdata.color.curve[imgdata.image[soff][c]]>>8;
-          }
-          else {
-            for (col=0; col < S.width; col++, soff += cstep)
-              FORRGB *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
-          }
-        }
-
-//            bufp += stride;           // go to the next line
-      }
+    parallel_for(0, S.height, 16, &LibRaw::copy_mem_image_band, &job);
 
     S.iheight = s_iheight;
     S.iwidth = s_iwidth;
@@ -2927,37 +2985,85 @@ void LibRaw::exp_bef(float shift, float smooth)
 #define ULIM(x,y,z) ((y) < (z) ? LIM(x,y,z) : LIM(x,z,y))
 #define CLIP(x) LIM(x,0,65535)
 
-void LibRaw::convert_to_rgb_loop(float out_cam[3][4])
+struct convert_to_rgb_job
+{
+  float (*out_cam)[4];
+  unsigned chunks;
+  int (*histogram)[4][LIBRAW_HISTOGRAM_SIZE];
+};
+
+void LibRaw::convert_to_rgb_band(void *job, unsigned first, unsigned last)
 {
-  int row,col,c;
+  convert_to_rgb_job *cr = (convert_to_rgb_job *) job;
+  float (*out_cam)[4] = cr->out_cam;
+  int c;
   float out[3];
-  ushort *img;
-  memset(libraw_internal_data.output_data.histogram,0,sizeof(int)*LIBRAW_HISTOGRAM_SIZE*4);
-  for (img=imgdata.image[0], row=0; row < S.height; row++)
-    for (col=0; col < S.width; col++, img+=4) {
-      if (!libraw_internal_data.internal_output_params.raw_color) {
-        out[0] = out[1] = out[2] = 0;
-        for(c=0; c< imgdata.idata.colors; c++) {
-          out[0] += out_cam[0][c] * img[c];
-          out[1] += out_cam[1][c] * img[c];
-          out[2] += out_cam[2][c] * img[c];
+
+  for (unsigned chunk = first; chunk < last; chunk++)
+    {
+      int (*histogram)[LIBRAW_HISTOGRAM_SIZE] = cr->histogram[chunk];
+      unsigned pix_end = CHUNK_BEGIN(chunk + 1, cr->chunks, S.height) * S.width;
+      ushort *img = imgdata.image[CHUNK_BEGIN(chunk, cr->chunks, S.height) * S.width];
+      for (ushort *img_end = imgdata.image[pix_end]; img < img_end; img+=4) {
+        if (!libraw_internal_data.internal_output_params.raw_color) {
+          out[0] = out[1] = out[2] = 0;
+          for(c=0; c< imgdata.idata.colors; c++) {
+            out[0] += out_cam[0][c] * img[c];
+            out[1] += out_cam[1][c] * img[c];
+            out[2] += out_cam[2][c] * img[c];
+          }
+          for(c=0;c<3;c++) img[c] = CLIP((int) out[c]);
         }
-        for(c=0;c<3;c++) img[c] = CLIP((int) out[c]);
+        for(c=0; c< imgdata.idata.colors; c++) histogram[c][img[c] >> 3]++;
       }
-      for(c=0; c< imgdata.idata.colors; c++) libraw_internal_data.output_data.histogram[c][img[c] >> 3]++;
     }
+}
 
+void LibRaw::convert_to_rgb_loop(float out_cam[3][4])
+{
+  convert_to_rgb_job job;
+  job.out_cam = out_cam;
+  job.chunks = 1;
+  job.histogram = (int (*)[4][LIBRAW_HISTOGRAM_SIZE]) libraw_internal_data.output_data.histogram;
+  memset(libraw_internal_data.output_data.histogram,0,sizeof(int)*LIBRAW_HISTOGRAM_SIZE*4);
+
+  // one histogram per chunk, added up in chunk order
+  int (*histograms)[4][LIBRAW_HISTOGRAM_SIZE] = NULL;
+  if (callbacks.parallel_cb)
+    histograms = (int (*)[4][LIBRAW_HISTOGRAM_SIZE]) ::calloc(LIBRAW_PARALLEL_CHUNKS, sizeof *histograms);
+  if (histograms)
+    {
+      job.chunks = LIBRAW_PARALLEL_CHUNKS;
+      job.histogram = histograms;
+    }
+
+  parallel_for(0, job.chunks, 1, &LibRaw::convert_to_rgb_band, &job);
+
+  if (histograms)
+    {
+      for (unsigned chunk = 0; chunk < job.chunks; chunk++)
+        for (int c = 0; c < 4; c++)
+          for (int i = 0; i < LIBRAW_HISTOGRAM_SIZE; i++)
+            libraw_internal_data.output_data.histogram[c][i] += histograms[chunk][c][i];
+      ::free(histograms);
+    }
 }
 
 void LibRaw::scale_colors_loop(float scale_mul[4])
 {
-  unsigned size = S.iheight*S.iwidth;
+  parallel_for(0, S.iheight, 16, &LibRaw::scale_colors_band, scale_mul);
+}
 
+void LibRaw::scale_colors_band(void *job, unsigned first, unsigned last)
+{
+  float *scale_mul = (float *) job;
+  unsigned begin = first*S.iwidth*4;
+  unsigned end = last*S.iwidth*4;
 
   if (C.cblack[4] && C.cblack[5])
     {
       int val;
-      for (unsigned i=0; i < size*4; i++)
+      for (unsigned i=begin; i < end; i++)
         {
           if (!(val = imgdata.image[0][i])) continue;
           val -= C.cblack[6 + i/4 / S.iwidth % C.cblack[4] * C.cblack[5] +
@@ -2969,7 +3075,7 @@ void LibRaw::scale_colors_loop(float scale_mul[4])
     }
   else if(C.cblack[0]||C.cblack[1]||C.cblack[2]||C.cblack[3])
     {
-      for (unsigned i=0; i < size*4; i++)
+      for (unsigned i=begin; i < end; i++)
         {
           int val = imgdata.image[0][i];
           if (!val) continue;
@@ -2980,7 +3086,7 @@ void LibRaw::scale_colors_loop(float scale_mul[4])
     }
   else // BL is zero
     {
-      for (unsigned i=0; i < size*4; i++)
+      for (unsigned i=begin; i < end; i++)
         {
           int val = imgdata.image[0][i];
           val *= scale_mul[i & 3];
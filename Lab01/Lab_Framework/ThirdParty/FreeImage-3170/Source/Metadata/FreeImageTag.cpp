@@ -39,6 +39,7 @@ FI_STRUCT (FITAGHEADER) {
 	DWORD count;		// number of components (in 'tag data types' units)
 	DWORD length;		// value length in bytes
 	void *value;		// tag value
+	char *text;			// string built by FreeImage_TagToString
 };
 
 // --------------------------------------------------------------------------
@@ -71,6 +72,7 @@ FreeImage_DeleteTag(FITAG *tag) {
 			free(tag_header->key); 
 			free(tag_header->description); 
 			free(tag_header->value);
+			free(tag_header->text);
 			// delete the tag
 			free(tag->data);
 		}
@@ -336,6 +338,9 @@ FreeImage_GetTagMemorySize(FITAG *tag) {
 		if (tag_header->description) {
 			size += strlen(tag_header->description) + 1;
 		}
+		if (tag_header->text) {
+			size += strlen(tag_header->text) + 1;
+		}
 		if (tag_header->value) {
 			switch (tag_header->type) {
 				case FIDT_ASCII:
@@ -351,3 +356,18 @@ FreeImage_GetTagMemorySize(FITAG *tag) {
 	}
 	return size;
 }
+
+const char* 
+FreeImage_SetTagText(FITAG *tag, const char *text) {
+	if (tag && text) {
+		FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
+		char *copy = (char*)malloc(strlen(text) + 1);
+		if (copy) {
+			strcpy(copy, text);
+		}
+		free(tag_header->text);
+		tag_header->text = copy;
+		return copy;
+	}
+	return NULL;
+}
@@ -307,6 +307,16 @@ Calculate the memory size required by a tag, including the size of the structure
 */
 size_t FreeImage_GetTagMemorySize(FITAG *tag);
 
+/**
+Store a copy of the string returned by FreeImage_TagToString inside the tag. 
+The copy stays valid until the next conversion of the same tag or until the tag is deleted, 
+so that conversions of different tags never share a buffer, whatever the thread.
+@param tag The converted tag
+@param text String representation of the tag
+@return Returns the copy owned by the tag, returns NULL if there is not enough memory
+*/
+const char* FreeImage_SetTagText(FITAG *tag, const char *text);
+
 // --------------------------------------------------------------------------
 
 /**
@@ -36,13 +36,11 @@ Convert a tag to a C string
 static const char* 
 ConvertAnyTag(FITAG *tag) {
 	char format[MAX_TEXT_EXTENT];
-	static std::string buffer;
+	std::string buffer;
 	DWORD i;
 
 	if(!tag)
 		return NULL;
-
-	buffer.erase();
 	
 	// convert the tag value to a string buffer
 
@@ -248,7 +246,7 @@ ConvertAnyTag(FITAG *tag) {
 		}
 	}
 
-	return buffer.c_str();
+	return FreeImage_SetTagText(tag, buffer.c_str());
 }
 
 /**
@@ -257,13 +255,11 @@ Convert a Exif tag to a C string
 static const char* 
 ConvertExifTag(FITAG *tag) {
 	char format[MAX_TEXT_EXTENT];
-	static std::string buffer;
+	std::string buffer;
 
 	if(!tag)
 		return NULL;
 
-	buffer.erase();
-
 	// convert the tag value to a string buffer
 
 	switch(FreeImage_GetTagID(tag)) {
@@ -314,7 +310,7 @@ ConvertExifTag(FITAG *tag) {
 
 				sprintf(format, "[%d,%d,%d] [%d,%d,%d]", blackR, blackG, blackB, whiteR, whiteG, whiteB);
 				buffer += format;
-				return buffer.c_str();
+				return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 
 		}
@@ -342,7 +338,7 @@ ConvertExifTag(FITAG *tag) {
 				if(j > 0 && j < 7)
 					buffer += componentStrings[j];
 			}
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -354,7 +350,7 @@ ConvertExifTag(FITAG *tag) {
 				buffer += " bit/pixel";
 			else 
 				buffer += " bits/pixel";
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -367,7 +363,7 @@ ConvertExifTag(FITAG *tag) {
 		{
 			FIRational r(tag);
 			buffer = r.toString();
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -407,7 +403,7 @@ ConvertExifTag(FITAG *tag) {
 			FIRational r(tag);
 			buffer = r.toString();
 			buffer += " sec";
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -418,7 +414,7 @@ ConvertExifTag(FITAG *tag) {
 			LONG apexPower = 1 << apexValue;
 			sprintf(format, "1/%d sec", (int)apexPower);
 			buffer += format;
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -431,7 +427,7 @@ ConvertExifTag(FITAG *tag) {
 			double fStop = pow(rootTwo, apertureApex);
 			sprintf(format, "F%.1f", fStop);
 			buffer += format;
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -441,7 +437,7 @@ ConvertExifTag(FITAG *tag) {
 			double fnumber = r.doubleValue();
 			sprintf(format, "F%.1f", fnumber);
 			buffer += format;
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -451,7 +447,7 @@ ConvertExifTag(FITAG *tag) {
 			double focalLength = r.doubleValue();
 			sprintf(format, "%.1f mm", focalLength);
 			buffer += format;
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -460,7 +456,7 @@ ConvertExifTag(FITAG *tag) {
 			unsigned short focalLength = *((unsigned short *)FreeImage_GetTagValue(tag));
 			sprintf(format, "%hu mm", focalLength);
 			buffer += format;
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -515,7 +511,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", flash);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -528,7 +524,7 @@ ConvertExifTag(FITAG *tag) {
 			} else {
 				sprintf(format, "Unknown (%d)", sceneType);
 				buffer += format;
-				return buffer.c_str();
+				return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -544,7 +540,7 @@ ConvertExifTag(FITAG *tag) {
 				double distance = r.doubleValue();
 				sprintf(format, "%.3f meters", distance);
 				buffer += format;
-				return buffer.c_str();
+				return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -660,7 +656,7 @@ ConvertExifTag(FITAG *tag) {
 			} else {
 				sprintf(format, "Unknown (%d)", fileSource);
 				buffer += format;
-				return buffer.c_str();
+				return FreeImage_SetTagText(tag, buffer.c_str());
 			}
         }
 		break;
@@ -689,7 +685,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown program (%d)", exposureProgram);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -706,7 +702,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown rendering (%d)", customRendered);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -725,7 +721,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown mode (%d)", exposureMode);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -742,7 +738,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", whiteBalance);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -763,7 +759,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", sceneType);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -786,7 +782,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", gainControl);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -805,7 +801,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", contrast);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -824,7 +820,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", saturation);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -843,7 +839,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", sharpness);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -864,7 +860,7 @@ ConvertExifTag(FITAG *tag) {
 				default:
 					sprintf(format, "Unknown (%d)", distanceRange);
 					buffer += format;
-					return buffer.c_str();
+					return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -877,7 +873,7 @@ ConvertExifTag(FITAG *tag) {
 			}
 			sprintf(format, "%d", isoEquiv);
 			buffer += format;
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -890,7 +886,7 @@ ConvertExifTag(FITAG *tag) {
 				buffer += userComment[i];
 			}
 			buffer += '\0';
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 
@@ -977,7 +973,7 @@ ConvertExifTag(FITAG *tag) {
 			}
 
 			buffer += format;
-			return buffer.c_str();
+			return FreeImage_SetTagText(tag, buffer.c_str());
 		}
 		break;
 	}
@@ -991,13 +987,11 @@ Convert a Exif GPS tag to a C string
 static const char* 
 ConvertExifGPSTag(FITAG *tag) {
 	char format[MAX_TEXT_EXTENT];
-	static std::string buffer;
+	std::string buffer;
 
 	if(!tag)
 		return NULL;
 
-	buffer.erase();
-
 	// convert the tag value to a string buffer
 
 	switch(FreeImage_GetTagID(tag)) {
@@ -1026,7 +1020,7 @@ ConvertExifGPSTag(FITAG *tag) {
 
 				sprintf(format, "%d:%d:%.2f", dd, mm, ss);
 				buffer += format;
-				return buffer.c_str();
+				return FreeImage_SetTagText(tag, buffer.c_str());
 			}
 		}
 		break;
@@ -47,6 +47,30 @@
 #include <assert.h>
 #include "half.h"
 
+//
+// Same SSE2 test as FREEIMAGE_SSE2 in FreeImage's Utilities.h.  F16C is
+// only used after checking the CPU at run time, so it does not need to
+// be enabled for the whole file.
+//
+
+#if defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64) || \
+    (defined (_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define HALF_SSE2
+    #include <emmintrin.h>
+    #if defined (_MSC_VER) && (_MSC_VER >= 1700)
+	#define HALF_F16C
+	#define HALF_F16C_TARGET
+	#include <intrin.h>
+	#include <immintrin.h>
+    #elif defined (__clang__) || (defined (__GNUC__) && \
+	  ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+	#define HALF_F16C
+	#define HALF_F16C_TARGET __attribute__ ((target ("f16c")))
+	#include <cpuid.h>
+	#include <immintrin.h>
+    #endif
+#endif
+
 using namespace std;
 
 //-------------------------------------------------------------
@@ -308,3 +332,251 @@ printBits (char c[35], float f)
 
     c[34] = 0;
 }
+
+
+//---------------------------------------------------------------------
+// Bulk conversion
+//
+// The SSE2 versions use integer arithmetic to compute exactly what
+// the _toFloat table and half (float) produce.  The F16C instructions
+// give the same results, except that signalling NANs are made quiet.
+//---------------------------------------------------------------------
+
+namespace {
+
+#if defined (HALF_SSE2)
+
+inline __m128i
+selectBits (__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128 (_mm_and_si128 (mask, a), _mm_andnot_si128 (mask, b));
+}
+
+
+inline __m128
+halfToFloat4 (__m128i h)
+{
+    //
+    // h holds four halfs in the low 16 bits of each 32-bit lane.
+    // Shift exponent and significand into place and rebias the
+    // exponent; infinities and NANs need a second rebias, zeroes
+    // and denormals are renormalized by the FPU.
+    //
+
+    const __m128i expMask = _mm_set1_epi32 (0x0f800000);
+    const __m128i rebias  = _mm_set1_epi32 (112 << 23);
+
+    __m128i o = _mm_slli_epi32 (_mm_and_si128 (h, _mm_set1_epi32 (0x7fff)), 13);
+    __m128i e = _mm_and_si128 (o, expMask);
+    o = _mm_add_epi32 (o, rebias);
+    o = _mm_add_epi32 (o, _mm_and_si128 (_mm_cmpeq_epi32 (e, expMask), rebias));
+
+    __m128 d = _mm_sub_ps (_mm_castsi128_ps (_mm_add_epi32 (o, _mm_set1_epi32 (1 << 23))),
+			   _mm_castsi128_ps (_mm_set1_epi32 (113 << 23)));
+
+    o = selectBits (_mm_cmpeq_epi32 (e, _mm_setzero_si128 ()), _mm_castps_si128 (d), o);
+    o = _mm_or_si128 (o, _mm_slli_epi32 (_mm_and_si128 (h, _mm_set1_epi32 (0x8000)), 16));
+
+    return _mm_castsi128_ps (o);
+}
+
+
+inline __m128i
+floatToHalf4 (__m128 f)
+{
+    //
+    // Returns four halfs in the low 16 bits of each 32-bit lane,
+    // rounded to nearest, ties to even, like half (float).
+    //
+
+    const __m128i x = _mm_castps_si128 (f);
+    const __m128i sign = _mm_and_si128 (_mm_srli_epi32 (x, 16), _mm_set1_epi32 (0x8000));
+    const __m128i a = _mm_and_si128 (x, _mm_set1_epi32 (0x7fffffff));
+
+    //
+    // Normalized half: rebias the exponent and round the significand
+    //
+
+    __m128i r = _mm_sub_epi32 (a, _mm_set1_epi32 ((112 << 23) - 0xfff));
+    r = _mm_add_epi32 (r, _mm_and_si128 (_mm_srli_epi32 (a, 13), _mm_set1_epi32 (1)));
+    r = _mm_srli_epi32 (r, 13);
+
+    //
+    // Denormalized half or zero: adding 0.5 lets the FPU shift and
+    // round the significand, the ulp of 0.5 is the smallest denormal
+    //
+
+    __m128i d = _mm_castps_si128 (_mm_add_ps (_mm_castsi128_ps (a), _mm_set1_ps (0.5f)));
+    d = _mm_sub_epi32 (d, _mm_set1_epi32 (0x3f000000));
+    r = selectBits (_mm_cmplt_epi32 (a, _mm_set1_epi32 (0x38800000)), d, r);
+
+    //
+    // Overflow and infinity map to infinity, NANs keep the upper
+    // bits of their significand and at least one bit set
+    //
+
+    __m128i m = _mm_srli_epi32 (_mm_and_si128 (a, _mm_set1_epi32 (0x007fffff)), 13);
+    m = _mm_or_si128 (m, _mm_and_si128 (_mm_cmpeq_epi32 (m, _mm_setzero_si128 ()),
+					_mm_set1_epi32 (1)));
+    __m128i big = _mm_or_si128 (_mm_set1_epi32 (0x7c00),
+				_mm_and_si128 (_mm_cmpgt_epi32 (a, _mm_set1_epi32 (0x7f800000)), m));
+    r = selectBits (_mm_cmpgt_epi32 (a, _mm_set1_epi32 (0x477fffff)), big, r);
+
+    return _mm_or_si128 (r, sign);
+}
+
+
+size_t
+halfToFloatSSE2 (float dst[], const unsigned short src[], size_t n)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+	__m128i h = _mm_loadu_si128 ((const __m128i *) (src + i));
+	_mm_storeu_ps (dst + i,     halfToFloat4 (_mm_unpacklo_epi16 (h, zero)));
+	_mm_storeu_ps (dst + i + 4, halfToFloat4 (_mm_unpackhi_epi16 (h, zero)));
+    }
+
+    return i;
+}
+
+
+inline __m128i
+signExtend16 (__m128i v)
+{
+    return _mm_srai_epi32 (_mm_slli_epi32 (v, 16), 16);
+}
+
+
+size_t
+floatToHalfSSE2 (unsigned short dst[], const float src[], size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+	__m128i lo = signExtend16 (floatToHalf4 (_mm_loadu_ps (src + i)));
+	__m128i hi = signExtend16 (floatToHalf4 (_mm_loadu_ps (src + i + 4)));
+	_mm_storeu_si128 ((__m128i *) (dst + i), _mm_packs_epi32 (lo, hi));
+    }
+
+    return i;
+}
+
+#endif // HALF_SSE2
+
+#if defined (HALF_F16C)
+
+bool
+cpuHasF16C ()
+{
+    //
+    // F16C instructions are VEX encoded, the OS must save the AVX state
+    //
+
+    unsigned int ecx;
+
+#if defined (_MSC_VER)
+    int info[4];
+    __cpuid (info, 1);
+    ecx = (unsigned int) info[2];
+#else
+    unsigned int eax, ebx, edx;
+
+    if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx))
+	return false;
+#endif
+
+    const unsigned int osxsaveAvxF16c = (1u << 27) | (1u << 28) | (1u << 29);
+
+    if ((ecx & osxsaveAvxF16c) != osxsaveAvxF16c)
+	return false;
+
+#if defined (_MSC_VER)
+    unsigned int xcr0 = (unsigned int) _xgetbv (0);
+#else
+    unsigned int xcr0, xcr0High;
+    __asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0High) : "c" (0));
+#endif
+
+    return (xcr0 & 6) == 6;
+}
+
+
+const bool hasF16C = cpuHasF16C ();
+
+
+HALF_F16C_TARGET size_t
+halfToFloatF16C (float dst[], const unsigned short src[], size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+	__m128i h = _mm_loadu_si128 ((const __m128i *) (src + i));
+	_mm_storeu_ps (dst + i,     _mm_cvtph_ps (h));
+	_mm_storeu_ps (dst + i + 4, _mm_cvtph_ps (_mm_unpackhi_epi64 (h, h)));
+    }
+
+    return i;
+}
+
+
+HALF_F16C_TARGET size_t
+floatToHalfF16C (unsigned short dst[], const float src[], size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+	__m128i lo = _mm_cvtps_ph (_mm_loadu_ps (src + i), 0);
+	__m128i hi = _mm_cvtps_ph (_mm_loadu_ps (src + i + 4), 0);
+	_mm_storeu_si128 ((__m128i *) (dst + i), _mm_unpacklo_epi64 (lo, hi));
+    }
+
+    return i;
+}
+
+#endif // HALF_F16C
+
+} // namespace
+
+
+HALF_EXPORT void
+halfToFloatArray (float dst[], const half src[], size_t n)
+{
+    size_t i = 0;
+
+#if defined (HALF_F16C)
+    if (hasF16C)
+	i = halfToFloatF16C (dst, (const unsigned short *) src, n);
+    else
+#endif
+#if defined (HALF_SSE2)
+	i = halfToFloatSSE2 (dst, (const unsigned short *) src, n);
+#endif
+
+    for (; i < n; ++i)
+	dst[i] = src[i];
+}
+
+
+HALF_EXPORT void
+floatToHalfArray (half dst[], const float src[], size_t n)
+{
+    size_t i = 0;
+
+#if defined (HALF_F16C)
+    if (hasF16C)
+	i = floatToHalfF16C ((unsigned short *) dst, src, n);
+    else
+#endif
+#if defined (HALF_SSE2)
+	i = floatToHalfSSE2 ((unsigned short *) dst, src, n);
+#endif
+
+    for (; i < n; ++i)
+	dst[i] = src[i];
+}
@@ -87,6 +87,7 @@
 
 #include "halfExport.h"    // for definition of HALF_EXPORT
 #include <iostream>
+#include <stddef.h>
 
 class half
 {
@@ -240,6 +241,22 @@ HALF_EXPORT void        printBits   (char  c[19], half  h);
 HALF_EXPORT void        printBits   (char  c[35], float f);
 
 
+//---------------------------------------------------------------------
+// Bulk conversion
+//
+//	halfToFloatArray(dst,src,n)	converts n halfs to floats
+//
+//	floatToHalfArray(dst,src,n)	converts n floats to halfs
+//
+// The results are identical to converting the values one by one
+// with the half class (except that NANs may come back quiet), but
+// eight values are converted at a time with SIMD instructions.
+//---------------------------------------------------------------------
+
+HALF_EXPORT void        halfToFloatArray (float dst[], const half src[], size_t n);
+HALF_EXPORT void        floatToHalfArray (half dst[], const float src[], size_t n);
+
+
 //-------------------------------------------------------------------------
 // Limits
 //
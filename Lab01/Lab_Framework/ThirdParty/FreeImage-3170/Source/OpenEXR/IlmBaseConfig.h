@@ -5,7 +5,7 @@ and you want IlmBase to use it for multithreaded file I/O.
 #if defined(_MSC_VER) || defined(__MINGW32__)
 #undef HAVE_PTHREAD
 #else
-#undef HAVE_PTHREAD
+#define HAVE_PTHREAD 1
 #endif
 
 /**
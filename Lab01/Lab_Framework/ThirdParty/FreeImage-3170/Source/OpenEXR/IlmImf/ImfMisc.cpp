@@ -52,6 +52,7 @@
 #include <ImfConvert.h>
 #include <ImfPartType.h>
 #include <ImfTileDescription.h>
+#include <half.h>
 #include "ImfNamespace.h"
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
@@ -269,6 +270,51 @@ numLinesInBuffer (Compressor * compressor)
 }
 
 
+namespace {
+
+bool
+hostIsLittleEndian ()
+{
+    const unsigned short one = 1;
+    return *(const unsigned char *) &one == 1;
+}
+
+
+void
+copyHalfsIntoFloats (const char *& readPtr,
+                     char * writePtr,
+                     char * endPtr,
+                     size_t xStride)
+{
+    //
+    // Convert contiguous halfs in the byte order of this machine
+    // to floats xStride bytes apart, a block at a time.
+    //
+
+    const size_t blockSize = 64;
+    float block[blockSize];
+
+    while (writePtr <= endPtr)
+    {
+        size_t n = (endPtr - writePtr) / xStride + 1;
+
+        if (n > blockSize)
+            n = blockSize;
+
+        halfToFloatArray (block, (const half *) readPtr, n);
+        readPtr += n * sizeof (half);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            *(float *) writePtr = block[i];
+            writePtr += xStride;
+        }
+    }
+}
+
+} // namespace
+
+
 void
 copyIntoFrameBuffer (const char *& readPtr,
 		     char * writePtr,
@@ -447,6 +493,16 @@ copyIntoFrameBuffer (const char *& readPtr,
 
               case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:
 
+                if (hostIsLittleEndian ())
+                {
+                    //
+                    // XDR halfs are little-endian
+                    //
+
+                    copyHalfsIntoFloats (readPtr, writePtr, endPtr, xStride);
+                    break;
+                }
+
                 while (writePtr <= endPtr)
                 {
                     half h;
@@ -610,13 +666,7 @@ copyIntoFrameBuffer (const char *& readPtr,
 
               case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:
 
-                while (writePtr <= endPtr)
-                {
-                    half h = *(half *) readPtr;
-                    *(float *) writePtr = float (h);
-                    readPtr += sizeof (half);
-                    writePtr += xStride;
-                }
+                copyHalfsIntoFloats (readPtr, writePtr, endPtr, xStride);
                 break;
 
               case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT:
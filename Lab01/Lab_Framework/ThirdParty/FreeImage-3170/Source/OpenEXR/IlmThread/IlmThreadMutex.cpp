@@ -41,7 +41,7 @@
 
 #include "IlmBaseConfig.h"
 
-//#if !defined(_WIN32) && !defined(_WIN64) && !defined(HAVE_PTHREAD)
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(HAVE_PTHREAD)
 
 #include "IlmThreadMutex.h"
 
@@ -56,4 +56,4 @@ void Mutex::unlock () const {}
 
 ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_EXIT
 
-//#endif
+#endif
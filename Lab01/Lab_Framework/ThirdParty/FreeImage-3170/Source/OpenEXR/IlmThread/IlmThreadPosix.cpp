@@ -47,11 +47,6 @@
 #include "Iex.h"
 #include <assert.h>
 
-extern "C"
-{
-    typedef void * (* Start) (void *);
-}
-
 ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_ENTER
 
 
@@ -63,10 +58,11 @@ supportsThreads ()
 
 namespace {
 
-void
+void *
 threadLoop (void * t)
 {
-    return (reinterpret_cast<Thread*>(t))->run();
+    (reinterpret_cast<Thread*>(t))->run();
+    return 0;
 }
 
 } // namespace
@@ -88,7 +84,7 @@ Thread::~Thread ()
 void
 Thread::start ()
 {
-    if (int error = ::pthread_create (&_thread, 0, Start (threadLoop), this))
+    if (int error = ::pthread_create (&_thread, 0, threadLoop, this))
 	IEX_NAMESPACE::throwErrnoExc ("Cannot create new thread (%T).", error);
 }
 
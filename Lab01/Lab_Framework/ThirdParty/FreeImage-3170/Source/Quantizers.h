@@ -187,7 +187,7 @@ protected:
 	void inxbuild();
 
 	/// Search for BGR values 0..255 (after net is unbiased) and return colour index
-	int inxsearch(int b, int g, int r);
+	int inxsearch(int b, int g, int r) const;
 
 	/// Search for biased BGR values
 	int contest(int b, int g, int r);
@@ -287,6 +287,22 @@ protected:
 		unsigned index;
 	} MapEntry;
 
+	/**
+	 * Minimum number of pixels in a band of rows. The bands are quantized
+	 * in parallel, before their palettes are merged.
+	 */
+	static const unsigned BAND_PIXELS = 65536;
+
+	/**
+	 * The colors of a band of rows, in the order they appear in the band,
+	 * and their indices in the merged palette.
+	 */
+	typedef struct BandPalette {
+		unsigned color[MAX_SIZE];
+		BYTE index[MAX_SIZE];
+		unsigned size;
+	} BandPalette;
+
 	/** The hash table. */
 	MapEntry *m_map;
 
@@ -334,6 +350,14 @@ protected:
 	 */
 	int GetIndexForColor(unsigned color);
 
+	/**
+	 * Quantizes the rows [first, last) of a 24-bit or 32-bit image,
+	 * putting their colors into the map in the order they appear.
+	 * @return returns false, if the rows have more colors than the
+	 * desired palette size
+	 */
+	bool QuantizeRows(const BYTE *src_bits, unsigned src_pitch, unsigned bytespp, unsigned width, unsigned first, unsigned last, BYTE *dst_bits, unsigned dst_pitch);
+
 	/**
 	 * Adds the specified number of entries of the specified reserve
 	 * palette to the newly created palette.
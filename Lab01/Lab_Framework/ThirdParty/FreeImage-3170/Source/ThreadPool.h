@@ -0,0 +1,95 @@
+// ==========================================================
+// Worker thread pool and parallel loops
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+
+/**
+Callback used by ParallelForBands.
+@param context User data passed to ParallelForBands
+@param first First index of the band to process
+@param last One past the last index of the band to process
+*/
+typedef void (*ParallelBandProc)(void *context, unsigned first, unsigned last);
+
+/**
+Callback used by ParallelSubmit.
+@param context User data passed to ParallelSubmit
+*/
+typedef void (*ParallelTaskProc)(void *context);
+
+/**
+Returns the number of threads (including the calling thread) that parallel
+loops are allowed to use. This is the value set by FreeImage_SetThreadCount,
+or the number of hardware threads if no value was set.
+*/
+unsigned ParallelGetThreadCount();
+
+/**
+Split the range [begin, end) into bands of at least 'grain' indices and process
+them on the FreeImage worker pool. The calling thread takes part in the work and
+the function returns when all bands have been processed. Small ranges, or a
+thread count of 1, run inline on the calling thread.<br>
+If a band throws, the bands not yet started are skipped and the first exception
+is rethrown on the calling thread, as it would be by a serial loop.
+@param begin First index of the range
+@param end One past the last index of the range
+@param grain Minimum number of indices per band
+@param proc Band callback
+@param context User data passed to the band callback
+*/
+void ParallelForBands(unsigned begin, unsigned end, unsigned grain, ParallelBandProc proc, void *context);
+
+/**
+Run a task on the FreeImage worker pool and return immediately.<br>
+Tasks are started in submission order. The caller owns the context and
+must keep it alive until the task has run, which is usually signalled by
+the task itself. Nobody waits for a task, so it must not throw: a task that 
+lets an exception escape terminates the program.
+@param proc Task callback
+@param context User data passed to the task callback
+*/
+void ParallelSubmit(ParallelTaskProc proc, void *context);
+
+/**
+Stop the worker threads, after the tasks already submitted have run. 
+Called by FreeImage_DeInitialise; workers are started again on demand.
+*/
+void ParallelShutdown();
+
+/**
+Typed front-end for ParallelForBands.<br>
+'body' is any function object callable as body(unsigned first, unsigned last).
+It is called concurrently for disjoint bands, so it must not write shared state
+outside of the band it was given.
+*/
+template <class Body>
+static void ParallelBandInvoke(void *context, unsigned first, unsigned last) {
+	(*static_cast<Body *>(context))(first, last);
+}
+
+template <class Body>
+inline void ParallelFor(unsigned begin, unsigned end, unsigned grain, Body body) {
+	ParallelForBands(begin, end, grain, &ParallelBandInvoke<Body>, &body);
+}
+
+#endif // THREADPOOL_H
@@ -37,8 +37,27 @@ void NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct);
 
 FIBITMAP* ClampConvertRGBFTo24(FIBITMAP *src);
 
+BOOL ToneMappingFastMath();
+
+float FastLog(float x);
+float FastExp(float x);
+float FastPow(float x, float y);
+
+void FastLogArray(float *values, unsigned count);
+void FastExpArray(float *values, unsigned count);
+void FastPowArray(float *values, unsigned count, float y);
+
 #ifdef __cplusplus
 }
 #endif
 
+/**
+Number of rows processed by a worker of the tone mapping operators, 
+so that each band holds about 64K pixels
+*/
+inline unsigned ToneMappingGrain(unsigned width) {
+	const unsigned rows = (64 * 1024) / (width ? width : 1);
+	return rows ? rows : 1;
+}
+
 #endif // TONE_MAPPING_H
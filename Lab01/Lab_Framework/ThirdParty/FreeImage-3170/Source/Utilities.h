@@ -64,6 +64,21 @@
 void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment);
 void FreeImage_Aligned_Free(void* mem);
 
+// Bitmap pixel buffers, recycled by size class when the memory pool is enabled
+// defined in MemoryPool.cpp (blocks are aligned on a 64 bytes boundary)
+
+void* FreeImage_Pool_Malloc(size_t amount);
+void FreeImage_Pool_Free(void* mem);
+
+// ==========================================================
+//   SIMD support
+// ==========================================================
+
+// SSE2 is part of the x86-64 baseline, 32-bit x86 builds must enable it explicitly
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FREEIMAGE_SSE2
+#endif
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -356,6 +371,22 @@ AssignPixel(BYTE* dst, const BYTE* src, unsigned bytesperpixel) {
 	}
 }
 
+/**
+Pixel of N bytes, copied as a whole
+*/
+template <unsigned N> struct PixelBytes {
+	BYTE bytes[N];
+};
+
+/**
+Reverse the order of the pixels of a row, in place.
+@param bits Row to be processed
+@param width Number of pixels in the row
+@param bytespp Number of bytes per pixel (1, 2, 3, 4, 6, 8, 12 or 16)
+@see See definition in Flip.cpp
+*/
+void ReversePixels(BYTE *bits, unsigned width, unsigned bytespp);
+
 /**
 Swap red and blue channels in a 24- or 32-bit dib. 
 @return Returns TRUE if successful, returns FALSE otherwise
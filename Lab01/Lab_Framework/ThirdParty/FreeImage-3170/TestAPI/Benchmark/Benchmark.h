@@ -0,0 +1,61 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef BENCHMARK_FREEIMAGE_API_H
+#define BENCHMARK_FREEIMAGE_API_H
+
+#include "../TestSuite.h"
+
+#include <functional>
+
+// Some useful tools
+// ==========================================================
+double benchSeconds(const std::function<void()>& run);
+double benchMegabytes(FIBITMAP *dib);
+void benchThreads(const char *label, const std::function<void()>& run, unsigned thread_count);
+
+// ZLib interface benchmarks
+// ==========================================================
+void benchZLibLevels(const char *lpszDirectory);
+
+// Image type conversion benchmarks
+// ==========================================================
+void benchHalfConversion();
+
+// JPEG codec benchmarks
+// ==========================================================
+void benchJPEGSIMD(const char *lpszDirectory);
+void benchJPEGRestart(unsigned thread_count);
+
+// Tone mapping benchmarks
+// ==========================================================
+void benchToneMapping(unsigned thread_count);
+
+// Multithreading benchmarks
+// ==========================================================
+void benchParallelPNG(unsigned thread_count);
+void benchParallelTIFF(unsigned thread_count);
+void benchParallelEXR(unsigned thread_count);
+void benchParallelRAW(unsigned thread_count);
+void benchParallelColors(unsigned thread_count);
+void benchParallelBlend(unsigned thread_count);
+void benchParallelDither(unsigned thread_count);
+void benchParallelQuantize(unsigned thread_count);
+void benchParallelRotate(unsigned thread_count);
+
+#endif // BENCHMARK_FREEIMAGE_API_H
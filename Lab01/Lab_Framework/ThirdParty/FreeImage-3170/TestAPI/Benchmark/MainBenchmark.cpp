@@ -0,0 +1,87 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "Benchmark.h"
+
+#include <thread>
+
+// ----------------------------------------------------------
+
+/**
+	FreeImage error handler
+	@param fif Format / Plugin responsible for the error 
+	@param message Error message
+*/
+void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message) {
+	printf("\n*** "); 
+	if(fif != FIF_UNKNOWN) {
+		printf("%s Format\n", FreeImage_GetFormatFromFIF(fif));
+	}
+	printf("%s", message);
+	printf(" ***\n");
+}
+
+// ----------------------------------------------------------
+
+/**
+Timings of the optimized code paths. 
+These are not tests: they only check their own results and print the throughput. 
+The optional argument is the directory of the images used by the file format benchmarks.
+*/
+int main(int argc, char *argv[]) {
+	const char *lpszDirectory = (argc > 1) ? argv[1] : "../../../Assets/Textures";
+	const unsigned thread_count = (std::thread::hardware_concurrency() > 2) ? std::thread::hardware_concurrency() : 2;
+
+#if defined(FREEIMAGE_LIB) || !defined(WIN32)
+	FreeImage_Initialise();
+#endif
+
+	// initialize our own FreeImage error handler
+	FreeImage_SetOutputMessage(FreeImageErrorHandler);
+
+	// ZLib interface and PNG codec at each compression level
+	benchZLibLevels(lpszDirectory);
+
+	// half float conversions
+	benchHalfConversion();
+
+	// JPEG decoder, C inner loops versus SIMD routines
+	benchJPEGSIMD(lpszDirectory);
+
+	// tone mapping operators, with and without the fast math
+	benchToneMapping(thread_count);
+
+	// parallel codecs and image processing, 1 thread versus all threads
+	benchParallelPNG(thread_count);
+	benchJPEGRestart(thread_count);
+	benchParallelTIFF(thread_count);
+	benchParallelEXR(thread_count);
+	benchParallelRAW(thread_count);
+	benchParallelColors(thread_count);
+	benchParallelBlend(thread_count);
+	benchParallelDither(thread_count);
+	benchParallelQuantize(thread_count);
+	benchParallelRotate(thread_count);
+
+#if defined(FREEIMAGE_LIB) || !defined(WIN32)
+	FreeImage_DeInitialise();
+#endif
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "Benchmark.h"
+
+#include <string.h>
+
+// ----------------------------------------------------------
+
+/**
+Convert a 4K RGBA image between half and float, compared with a memory copy of the float side
+*/
+void benchHalfConversion() {
+	printf("benchHalfConversion ...\n");
+
+	const size_t count = 3840 * 2160 * 4;
+	std::vector<WORD> halfs(count);
+	std::vector<float> floats(count);
+	std::vector<float> copy(count);
+	for(size_t i = 0; i < count; i++) {
+		halfs[i] = (WORD)(i * 7919);
+	}
+
+	// the first pass only touches the memory
+	double copy_ms = 0, to_float_ms = 0, to_half_ms = 0;
+	for(int pass = 0; pass < 2; pass++) {
+		copy_ms = 1000 * benchSeconds([&]() { memcpy(&copy[0], &floats[0], count * sizeof(float)); });
+		to_float_ms = 1000 * benchSeconds([&]() { FreeImage_ConvertLineHalfToFloat(&floats[0], &halfs[0], (int)count); });
+		to_half_ms = 1000 * benchSeconds([&]() { FreeImage_ConvertLineFloatToHalf(&halfs[0], &floats[0], (int)count); });
+	}
+
+	printf("... 4K RGBA half to float in %.1f ms, float to half in %.1f ms (float copy %.1f ms)\n", to_float_ms, to_half_ms, copy_ms);
+}
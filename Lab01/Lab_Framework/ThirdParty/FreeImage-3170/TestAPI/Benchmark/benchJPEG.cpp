@@ -0,0 +1,107 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "Benchmark.h"
+
+// ----------------------------------------------------------
+
+/**
+Decode the JPEG images of a directory with the C inner loops, then with the SIMD routines
+*/
+void benchJPEGSIMD(const char *lpszDirectory) {
+	printf("benchJPEGSIMD ...\n");
+
+	if(!FreeImage_GetJPEGSIMD()) {
+		printf("... SIMD routines not available, skipping\n");
+		return;
+	}
+
+	// read the files into memory, so that only the decoder is timed
+	std::vector<FIMEMORY*> streams;
+	std::vector<std::string> files = listFiles(lpszDirectory);
+	for(size_t i = 0; i < files.size(); i++) {
+		if(FreeImage_GetFileType(files[i].c_str()) != FIF_JPEG) {
+			continue;
+		}
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		FILE *stream = fopen(files[i].c_str(), "rb");
+		assert(stream != NULL);
+		BYTE buffer[4096];
+		size_t count;
+		while((count = fread(buffer, 1, sizeof(buffer), stream)) > 0) {
+			FreeImage_WriteMemory(buffer, 1, (unsigned)count, hmem);
+		}
+		fclose(stream);
+		streams.push_back(hmem);
+	}
+	if(streams.empty()) {
+		printf("... no JPEG image in %s, skipping\n", lpszDirectory);
+		return;
+	}
+
+	double ms[2];
+	for(int simd = 0; simd < 2; simd++) {
+		FreeImage_SetJPEGSIMD(simd);
+		ms[simd] = 1000 * benchSeconds([&streams]() {
+			for(size_t i = 0; i < streams.size(); i++) {
+				FreeImage_SeekMemory(streams[i], 0, SEEK_SET);
+				FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_JPEG, streams[i], JPEG_DEFAULT);
+				assert(dib != NULL);
+				FreeImage_Unload(dib);
+			}
+		});
+	}
+	FreeImage_SetJPEGSIMD(TRUE);
+
+	printf("... %d JPEG images decoded in %.0f ms (C), %.0f ms (SIMD)\n", (int)streams.size(), ms[0], ms[1]);
+
+	for(size_t i = 0; i < streams.size(); i++) {
+		FreeImage_CloseMemory(streams[i]);
+	}
+}
+
+/**
+Encode and decode a large image with restart markers, which are processed in stripes
+*/
+void benchJPEGRestart(unsigned thread_count) {
+	printf("benchJPEGRestart ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(1024, 683, 128);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	FIBITMAP *large = FreeImage_Rescale(dib24, 4096, 2732, FILTER_BILINEAR);
+	assert(large != NULL);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	benchThreads("4096 x 2732 JPEG save", [large, hmem]() {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		BOOL bResult = FreeImage_SaveToMemory(FIF_JPEG, large, hmem, JPEG_RESTART);
+		assert(bResult == TRUE);
+	}, thread_count);
+	benchThreads("4096 x 2732 JPEG load", [hmem]() {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_JPEG, hmem, JPEG_DEFAULT);
+		assert(dib != NULL);
+		FreeImage_Unload(dib);
+	}, thread_count);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(large);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+}
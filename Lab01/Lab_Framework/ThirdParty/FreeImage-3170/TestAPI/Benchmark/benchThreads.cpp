@@ -0,0 +1,247 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "Benchmark.h"
+
+// ----------------------------------------------------------
+
+void benchParallelPNG(unsigned thread_count) {
+	printf("benchParallelPNG ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(1024, 1024, 128);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	FIBITMAP *large = FreeImage_Rescale(dib24, 4096, 4096, FILTER_BILINEAR);
+	assert(large != NULL);
+
+	benchThreads("4096 x 4096 24-bit PNG save", [large]() {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		BOOL bResult = FreeImage_SaveToMemory(FIF_PNG, large, hmem, PNG_DEFAULT);
+		assert(bResult == TRUE);
+		FreeImage_CloseMemory(hmem);
+	}, thread_count);
+
+	FreeImage_Unload(large);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+}
+
+void benchParallelTIFF(unsigned thread_count) {
+	printf("benchParallelTIFF ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(1024, 1024, 64);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	FIBITMAP *large = FreeImage_Rescale(dib24, 4096, 4096, FILTER_BILINEAR);
+	assert(large != NULL);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	BOOL bResult = FreeImage_SaveToMemory(FIF_TIFF, large, hmem, TIFF_LZW);
+	assert(bResult == TRUE);
+
+	benchThreads("4096 x 4096 24-bit LZW TIFF load", [hmem]() {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_TIFF, hmem);
+		assert(dib != NULL);
+		FreeImage_Unload(dib);
+	}, thread_count);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(large);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+}
+
+void benchParallelEXR(unsigned thread_count) {
+	printf("benchParallelEXR ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(1024, 512, 64);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(dib24);
+	FIBITMAP *large = FreeImage_Rescale(rgbf, 4096, 2048, FILTER_BILINEAR);
+	assert(large != NULL);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	BOOL bResult = FreeImage_SaveToMemory(FIF_EXR, large, hmem, EXR_PIZ);
+	assert(bResult == TRUE);
+
+	benchThreads("4096 x 2048 RGBF PIZ EXR load", [hmem]() {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_EXR, hmem);
+		assert(dib != NULL);
+		FreeImage_Unload(dib);
+	}, thread_count);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(large);
+	FreeImage_Unload(rgbf);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+}
+
+void benchParallelRAW(unsigned thread_count) {
+	printf("benchParallelRAW ...\n");
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	createBayerDNG(hmem, 4000, 3000);
+
+	const int flags[] = { RAW_DEFAULT, RAW_HALFSIZE };
+	const char *labels[] = { "4000 x 3000 DNG load at full size", "4000 x 3000 DNG load at half size" };
+	for(int i = 0; i < 2; i++) {
+		const int load_flags = flags[i];
+		benchThreads(labels[i], [hmem, load_flags]() {
+			FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+			FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_RAW, hmem, load_flags);
+			assert(dib != NULL);
+			FreeImage_Unload(dib);
+		}, thread_count);
+	}
+
+	FreeImage_CloseMemory(hmem);
+}
+
+void benchParallelColors(unsigned thread_count) {
+	printf("benchParallelColors ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(4096, 4096, 64);
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib8);
+	assert(dib32 != NULL);
+
+	benchThreads("4096 x 4096 RGBA AdjustColors", [dib32]() {
+		BOOL bResult = FreeImage_AdjustColors(dib32, 10, 10, 1.2, FALSE);
+		assert(bResult == TRUE);
+	}, thread_count);
+	benchThreads("4096 x 4096 RGBA GetHistogram", [dib32]() {
+		DWORD histo[256];
+		BOOL bResult = FreeImage_GetHistogram(dib32, histo, FICC_BLACK);
+		assert(bResult == TRUE);
+	}, thread_count);
+
+	FreeImage_Unload(dib32);
+	FreeImage_Unload(dib8);
+}
+
+void benchParallelBlend(unsigned thread_count) {
+	printf("benchParallelBlend ...\n");
+
+	FIBITMAP *src = createBlendImage(4096, 4096, 32, 3);
+	FIBITMAP *dst = createBlendImage(4096, 4096, 32, 101);
+	FreeImage_PreMultiplyWithAlpha(src);
+	FreeImage_PreMultiplyWithAlpha(dst);
+	FIBITMAP *srcf = FreeImage_ConvertToRGBAF(src);
+	FIBITMAP *dstf = FreeImage_ConvertToRGBAF(dst);
+	assert(srcf && dstf);
+
+	benchThreads("4096 x 4096 RGBA Paste", [dst, src]() {
+		BOOL bResult = FreeImage_Paste(dst, src, 0, 0, 128);
+		assert(bResult == TRUE);
+	}, thread_count);
+	benchThreads("4096 x 4096 RGBA PasteWithAlpha", [dst, src]() {
+		BOOL bResult = FreeImage_PasteWithAlpha(dst, src, 0, 0, TRUE);
+		assert(bResult == TRUE);
+	}, thread_count);
+	benchThreads("4096 x 4096 RGBAF PasteWithAlpha (straight alpha)", [dstf, srcf]() {
+		BOOL bResult = FreeImage_PasteWithAlpha(dstf, srcf, 0, 0, FALSE);
+		assert(bResult == TRUE);
+	}, thread_count);
+
+	FreeImage_Unload(dstf);
+	FreeImage_Unload(srcf);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(src);
+}
+
+void benchParallelDither(unsigned thread_count) {
+	printf("benchParallelDither ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(4096, 4096, 64);
+	assert(dib8 != NULL);
+
+	const FREE_IMAGE_DITHER algorithms[] = { FID_FS, FID_BAYER8x8 };
+	const char *labels[] = { "4096 x 4096 Floyd-Steinberg", "4096 x 4096 Bayer 8x8" };
+	for(int i = 0; i < 2; i++) {
+		const FREE_IMAGE_DITHER algorithm = algorithms[i];
+		benchThreads(labels[i], [dib8, algorithm]() {
+			FIBITMAP *dib1 = FreeImage_Dither(dib8, algorithm);
+			assert(dib1 != NULL);
+			FreeImage_Unload(dib1);
+		}, thread_count);
+	}
+	benchThreads("4096 x 4096 Threshold", [dib8]() {
+		FIBITMAP *dib1 = FreeImage_Threshold(dib8, 128);
+		assert(dib1 != NULL);
+		FreeImage_Unload(dib1);
+	}, thread_count);
+
+	FreeImage_Unload(dib8);
+}
+
+void benchParallelQuantize(unsigned thread_count) {
+	printf("benchParallelQuantize ...\n");
+
+	// a 24-bit image with many colors
+	const unsigned width = 2048;
+	const unsigned height = 1536;
+	FIBITMAP *dib24 = FreeImage_Allocate(width, height, 24);
+	assert(dib24 != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib24, y);
+		for(unsigned x = 0; x < width; x++, bits += 3) {
+			bits[FI_RGBA_RED] = (BYTE)(x * 255 / width);
+			bits[FI_RGBA_GREEN] = (BYTE)(y * 255 / height);
+			bits[FI_RGBA_BLUE] = (BYTE)((x ^ y) >> 3);
+		}
+	}
+
+	const FREE_IMAGE_QUANTIZE quantizers[] = { FIQ_WUQUANT, FIQ_NNQUANT };
+	const char *labels[] = { "2048 x 1536 Wu quantization", "2048 x 1536 NeuQuant quantization" };
+	for(int i = 0; i < 2; i++) {
+		const FREE_IMAGE_QUANTIZE quantize = quantizers[i];
+		benchThreads(labels[i], [dib24, quantize]() {
+			FIBITMAP *dib8 = FreeImage_ColorQuantize(dib24, quantize);
+			assert(dib8 != NULL);
+			FreeImage_Unload(dib8);
+		}, thread_count);
+	}
+
+	FreeImage_Unload(dib24);
+}
+
+void benchParallelRotate(unsigned thread_count) {
+	printf("benchParallelRotate ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(4096, 4096, 64);
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib8);
+	assert(dib32 != NULL);
+
+	const double angles[] = { 90, 30 };
+	const char *labels[] = { "4096 x 4096 32-bit rotation by 90 degrees", "4096 x 4096 32-bit rotation by 30 degrees" };
+	for(int i = 0; i < 2; i++) {
+		const double angle = angles[i];
+		benchThreads(labels[i], [dib32, angle]() {
+			FIBITMAP *rotated = FreeImage_Rotate(dib32, angle, NULL);
+			assert(rotated != NULL);
+			FreeImage_Unload(rotated);
+		}, thread_count);
+	}
+
+	benchThreads("4096 x 4096 32-bit horizontal flip", [dib32]() {
+		BOOL bResult = FreeImage_FlipHorizontal(dib32);
+		assert(bResult == TRUE);
+	}, thread_count);
+
+	FreeImage_Unload(dib32);
+	FreeImage_Unload(dib8);
+}
@@ -0,0 +1,53 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "Benchmark.h"
+
+// ----------------------------------------------------------
+
+/**
+Time the tone mapping operators with the exact math, then with the fast math
+*/
+void benchToneMapping(unsigned thread_count) {
+	const FREE_IMAGE_TMO operators[] = { FITMO_DRAGO03, FITMO_REINHARD05, FITMO_FATTAL02 };
+	const char *names[] = { "Drago03", "Reinhard05", "Fattal02" };
+
+	printf("benchToneMapping ...\n");
+
+	FIBITMAP *src = createHDRImage(2048, 1024);
+	assert(src != NULL);
+
+	for(int i = 0; i < 3; i++) {
+		const FREE_IMAGE_TMO tmo = operators[i];
+		char label[64];
+
+		for(int fast_math = 0; fast_math < 2; fast_math++) {
+			FreeImage_SetToneMappingFastMath(fast_math ? TRUE : FALSE);
+			sprintf(label, "2048 x 1024 %s%s", names[i], fast_math ? " (fast math)" : "");
+			benchThreads(label, [src, tmo]() {
+				FIBITMAP *dst = FreeImage_ToneMapping(src, tmo, 0, 0);
+				assert(dst != NULL);
+				FreeImage_Unload(dst);
+			}, thread_count);
+		}
+	}
+	FreeImage_SetToneMappingFastMath(FALSE);
+
+	FreeImage_Unload(src);
+}
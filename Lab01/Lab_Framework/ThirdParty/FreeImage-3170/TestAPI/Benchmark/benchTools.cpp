@@ -0,0 +1,56 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "Benchmark.h"
+
+#include <chrono>
+
+// ----------------------------------------------------------
+
+/**
+Returns the wall clock time taken by a call, in seconds
+*/
+double benchSeconds(const std::function<void()>& run) {
+	typedef std::chrono::steady_clock clock;
+
+	const clock::time_point start = clock::now();
+	run();
+	return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+/**
+Returns the size of the pixels of an image, in MB
+*/
+double benchMegabytes(FIBITMAP *dib) {
+	return FreeImage_GetPitch(dib) * (double)FreeImage_GetHeight(dib) / (1024.0 * 1024.0);
+}
+
+/**
+Time a call using a single worker thread, then using thread_count threads
+@param label Description of the call, e.g. "4096 x 4096 24-bit PNG save"
+*/
+void benchThreads(const char *label, const std::function<void()>& run, unsigned thread_count) {
+	FreeImage_SetThreadCount(1);
+	const double single_ms = 1000 * benchSeconds(run);
+	FreeImage_SetThreadCount(thread_count);
+	const double multi_ms = 1000 * benchSeconds(run);
+	FreeImage_SetThreadCount(0);
+
+	printf("... %s in %.1f ms (1 thread), %.1f ms (%d threads)\n", label, single_ms, multi_ms, (int)thread_count);
+}
@@ -0,0 +1,116 @@
+// ==========================================================
+// FreeImage 3 Benchmarks
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "Benchmark.h"
+
+#include <string.h>
+
+// ----------------------------------------------------------
+
+/**
+Encode and decode the images of a directory at each compression level,
+as raw pixels with each built-in backend of the ZLib interface, and as PNG files in memory
+*/
+void benchZLibLevels(const char *lpszDirectory) {
+	printf("benchZLibLevels ...\n");
+
+	std::vector<FIBITMAP*> images;
+	std::vector<std::string> files = listFiles(lpszDirectory);
+	for(size_t i = 0; i < files.size(); i++) {
+		FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(files[i].c_str());
+		if(fif != FIF_UNKNOWN) {
+			FIBITMAP *dib = FreeImage_Load(fif, files[i].c_str());
+			if(dib) {
+				images.push_back(dib);
+			}
+		}
+	}
+	if(images.empty()) {
+		printf("... %s not found or empty, skipping\n", lpszDirectory);
+		return;
+	}
+
+	DWORD max_size = 0;
+	double total_mb = 0;
+	for(size_t i = 0; i < images.size(); i++) {
+		const DWORD size = FreeImage_GetPitch(images[i]) * FreeImage_GetHeight(images[i]);
+		max_size = (size > max_size) ? size : max_size;
+		total_mb += benchMegabytes(images[i]);
+	}
+	const DWORD target_size = max_size + max_size / 1000 + 12;
+	BYTE *compressed = (BYTE*)malloc(target_size);
+	BYTE *uncompressed = (BYTE*)malloc(max_size);
+	assert(compressed && uncompressed);
+
+	const char *backends[] = { "fastdeflate", "zlib" };
+	for(int k = 0; k < 2; k++) {
+		BOOL bResult = FreeImage_SetDeflateBackend(FreeImage_FindDeflateBackend(backends[k]));
+		assert(bResult == TRUE);
+
+		for(int level = 1; level <= 9; level++) {
+			double deflate_s = 0, inflate_s = 0;
+			double packed_mb = 0;
+
+			for(size_t i = 0; i < images.size(); i++) {
+				BYTE *bits = FreeImage_GetBits(images[i]);
+				const DWORD size = FreeImage_GetPitch(images[i]) * FreeImage_GetHeight(images[i]);
+
+				DWORD packed = 0, unpacked = 0;
+				deflate_s += benchSeconds([&]() { packed = FreeImage_ZLibCompressLevel(compressed, target_size, bits, size, level); });
+				inflate_s += benchSeconds([&]() { unpacked = FreeImage_ZLibUncompress(uncompressed, size, compressed, packed); });
+				assert(unpacked == size);
+				assert(memcmp(uncompressed, bits, size) == 0);
+				packed_mb += packed / (1024.0 * 1024.0);
+			}
+
+			printf("... %s level %d: ratio %.3f, deflate %.1f MB/s, inflate %.1f MB/s\n",
+				backends[k], level, packed_mb / total_mb, total_mb / deflate_s, total_mb / inflate_s);
+		}
+	}
+	FreeImage_SetDeflateBackend(NULL);
+
+	for(int level = 1; level <= 9; level++) {
+		double png_save_s = 0, png_load_s = 0;
+		double png_mb = 0;
+
+		for(size_t i = 0; i < images.size(); i++) {
+			FIBITMAP *dib = images[i];
+			FIMEMORY *hmem = FreeImage_OpenMemory();
+			BOOL bResult = FALSE;
+			FIBITMAP *png = NULL;
+			png_save_s += benchSeconds([&]() { bResult = FreeImage_SaveToMemory(FIF_PNG, dib, hmem, level); });
+			assert(bResult == TRUE);
+			png_mb += FreeImage_TellMemory(hmem) / (1024.0 * 1024.0);
+			FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+			png_load_s += benchSeconds([&]() { png = FreeImage_LoadFromMemory(FIF_PNG, hmem); });
+			assert(png != NULL);
+			FreeImage_Unload(png);
+			FreeImage_CloseMemory(hmem);
+		}
+
+		printf("... PNG level %d: ratio %.3f, save %.1f MB/s, load %.1f MB/s\n",
+			level, png_mb / total_mb, total_mb / png_save_s, total_mb / png_load_s);
+	}
+
+	free(uncompressed);
+	free(compressed);
+	for(size_t i = 0; i < images.size(); i++) {
+		FreeImage_Unload(images[i]);
+	}
+}
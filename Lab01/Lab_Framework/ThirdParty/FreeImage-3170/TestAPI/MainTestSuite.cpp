@@ -62,6 +62,9 @@ int main(int argc, char *argv[]) {
 	// test plugins capabilities
 	showPlugins();
 
+	// test file type detection
+	testGetFileType(128, 128);
+
 	// test the clone function
 	testAllocateCloneUnload("exif.jpg");
 
@@ -71,10 +74,22 @@ int main(int argc, char *argv[]) {
 	// test loading / saving / converting image types using the TIFF plugin
 	testImageTypeTIFF(width, height);
 
+	// test the bulk half float conversions
+	testHalfConversion();
+
+	// test the typed pixel views
+	testImageView(width, height);
+
 	// test memory IO
 	testMemIO("sample.png");
 	testMemIO("exif.jxr");
 
+	// test scanline streaming
+	testScanlines("sample.png");
+
+	// test the ZLib interface
+	testZLib();
+
 	// test multipage functions
 	testMultiPage("sample.png");
 
@@ -86,6 +101,8 @@ int main(int argc, char *argv[]) {
 
 	// test JPEG lossless transform & cropping
 	testJPEG();
+	testJPEGSIMD("../../../Assets/Textures");
+	testJPEGRestart(4);
 
 	// test get/set channel
 	testImageChannels(width, height);
@@ -102,6 +119,46 @@ int main(int argc, char *argv[]) {
 	// test wrapped user buffer
 	testWrappedBuffer("exif.jpg", 0);
 
+	// test the resampling engine
+	testResize(width, height);
+
+	// test the parallel tone mapping operators
+	testToneMapping(width, height, 4);
+	testMultigridPoissonSolver(4);
+
+	// test concurrent decoding of the framework textures
+	testConcurrentLoad("../../../Assets/Textures", 16);
+
+	// test the pooled bitmap allocator
+	testMemoryPool(8);
+
+	// test the parallel PNG encoder
+	testParallelPNG(4);
+
+	// test the parallel color quantizers
+	testParallelQuantize(4);
+
+	// test the parallel rotations and flips
+	testParallelRotate(4);
+
+	// test the parallel TIFF strip decoding
+	testParallelTIFF(4);
+
+	// test the multithreaded EXR codecs
+	testParallelEXR(4);
+
+	// test the multithreaded RAW processing
+	testParallelRAW(4);
+
+	// test the parallel color adjustments and histograms
+	testParallelColors(4);
+
+	// test the parallel alpha blending
+	testParallelBlend(4);
+
+	// test the parallel dithering and thresholding
+	testParallelDither(4);
+
 #if defined(FREEIMAGE_LIB) || !defined(WIN32)
 	FreeImage_DeInitialise();
 #endif
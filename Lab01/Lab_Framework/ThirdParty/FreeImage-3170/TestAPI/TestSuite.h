@@ -30,6 +30,10 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 
+#include <string>
+#include <vector>
+#include <functional>
+
 #if (defined(WIN32) || defined(__WIN32__))
 #if (defined(_DEBUG))
 #include <crtdbg.h>
@@ -39,11 +43,20 @@
 
 // Some useful tools
 // ==========================================================
+void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message);
 FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale);
+FIBITMAP* createHDRImage(unsigned width, unsigned height);
+void createBayerDNG(FIMEMORY *hmem, unsigned width, unsigned height);
+FIBITMAP* createBlendImage(unsigned width, unsigned height, unsigned bpp, unsigned seed);
+std::vector<std::string> listFiles(const char *lpszDirectory);
+unsigned long long hashBuffer(const void *data, size_t size, unsigned long long hash = 14695981039346656037ULL);
+unsigned long long hashBitmap(FIBITMAP *dib);
+unsigned long long runAndCompareThreads(const std::function<unsigned long long()>& run, unsigned thread_count);
 
 // Test plugins capabilities
 // ==========================================================
 void showPlugins();
+void testGetFileType(unsigned width, unsigned height);
 
 // Image types test suite
 // ==========================================================
@@ -51,6 +64,8 @@ void testAllocateCloneUnload(const char *lpszPathName);
 BOOL testAllocateCloneUnloadType(FREE_IMAGE_TYPE image_type, unsigned width, unsigned height);
 void testImageType(unsigned width, unsigned height);
 void testImageTypeTIFF(unsigned width, unsigned height);
+void testHalfConversion();
+void testImageView(unsigned width, unsigned height);
 
 // Header loading test suite
 // ==========================================================
@@ -65,6 +80,16 @@ void testExifRaw();
 
 void testMemIO(const char *lpszPathName);
 
+// Scanline streaming test suite
+// ==========================================================
+
+void testScanlines(const char *lpszPathName);
+
+// ZLib interface test suite
+// ==========================================================
+
+void testZLib();
+
 // Multipage test suite
 // ==========================================================
 
@@ -76,6 +101,8 @@ void testMultiPageMemory(const char *lpszPathName);
 // ==========================================================
 
 void testJPEG();
+void testJPEGSIMD(const char *lpszDirectory);
+void testJPEGRestart(unsigned thread_count);
 
 // Channels test suite
 // ==========================================================
@@ -92,6 +119,32 @@ void testThumbnail(const char *lpszPathName, int flags);
 
 void testWrappedBuffer(const char *lpszPathName, int flags);
 
+// Resampling test suite
+// ==========================================================
+
+void testResize(unsigned width, unsigned height);
+
+// Tone mapping test suite
+// ==========================================================
+
+void testToneMapping(unsigned width, unsigned height, unsigned thread_count);
+void testMultigridPoissonSolver(unsigned thread_count);
+
+// Multithreading test suite
+// ==========================================================
+
+void testConcurrentLoad(const char *lpszDirectory, unsigned thread_count);
+void testMemoryPool(unsigned thread_count);
+void testParallelPNG(unsigned thread_count);
+void testParallelQuantize(unsigned thread_count);
+void testParallelRotate(unsigned thread_count);
+void testParallelTIFF(unsigned thread_count);
+void testParallelEXR(unsigned thread_count);
+void testParallelRAW(unsigned thread_count);
+void testParallelColors(unsigned thread_count);
+void testParallelBlend(unsigned thread_count);
+void testParallelDither(unsigned thread_count);
+
 #endif // TEST_FREEIMAGE_API_H
 
 
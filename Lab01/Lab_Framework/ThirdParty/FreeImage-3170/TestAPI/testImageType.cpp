@@ -21,6 +21,9 @@
 
 
 #include "TestSuite.h"
+#include "FreeImageView.h"
+
+#include <string.h>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -496,3 +499,212 @@ void testImageTypeTIFF(unsigned width, unsigned height) {
 	FreeImage_Unload(src);
 
 }
+
+// ----------------------------------------------------------
+
+static unsigned floatBits(float f) {
+	unsigned u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static float bitsFloat(unsigned u) {
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+/** Reference half to float conversion */
+static float referenceHalfToFloat(WORD h) {
+	const int e = (h >> 10) & 0x1F;
+	const int m = h & 0x3FF;
+	float value;
+	if(e == 0) {
+		value = (float)ldexp((double)m, -24);
+	} else if(e == 31) {
+		value = m ? bitsFloat(0x7FC00000) : bitsFloat(0x7F800000);
+	} else {
+		value = (float)ldexp((double)(m | 0x400), e - 25);
+	}
+	return (h & 0x8000) ? -value : value;
+}
+
+/** Reference float to half conversion, round to nearest, ties to even */
+static WORD referenceFloatToHalf(float f) {
+	const unsigned x = floatBits(f);
+	const WORD sign = (WORD)((x >> 16) & 0x8000);
+	const unsigned a = x & 0x7FFFFFFF;
+
+	if(a > 0x7F800000) {
+		return sign | 0x7E00;
+	}
+	if(a >= 0x477FF000) {
+		// above 65520 (halfway between 65504 and 65536)
+		return sign | 0x7C00;
+	}
+	if(a < 0x38800000) {
+		// denormalized half or zero
+		const double v = ldexp(fabs((double)f), 24);
+		double r = floor(v);
+		const double d = v - r;
+		if((d > 0.5) || ((d == 0.5) && (fmod(r, 2) == 1))) {
+			r += 1;
+		}
+		return sign | (WORD)r;
+	}
+	const unsigned m = a - (112 << 23);
+	unsigned r = m >> 13;
+	const unsigned rem = m & 0x1FFF;
+	if((rem > 0x1000) || ((rem == 0x1000) && (r & 1))) {
+		r++;
+	}
+	return sign | (WORD)r;
+}
+
+static BOOL sameHalf(WORD h, WORD reference) {
+	const BOOL nan = ((h & 0x7FFF) > 0x7C00);
+	const BOOL reference_nan = ((reference & 0x7FFF) > 0x7C00);
+	if(nan || reference_nan) {
+		// NaNs may come back quiet
+		return nan && reference_nan && ((h & 0x8000) == (reference & 0x8000));
+	}
+	return (h == reference);
+}
+
+void testHalfConversion() {
+	printf("testHalfConversion ...\n");
+
+	// every half pattern, at every alignment of the vector loop
+	std::vector<WORD> all_halfs(65536 + 7);
+	std::vector<float> all_floats(65536 + 7);
+	for(unsigned i = 0; i < 65536; i++) {
+		all_halfs[i] = (WORD)i;
+	}
+	for(int offset = 0; offset < 8; offset++) {
+		FreeImage_ConvertLineHalfToFloat(&all_floats[offset], &all_halfs[0], 65536);
+		for(unsigned i = 0; i < 65536; i++) {
+			const float value = all_floats[offset + i];
+			const float reference = referenceHalfToFloat((WORD)i);
+			if(reference != reference) {
+				assert((value != value) && ((floatBits(value) >> 31) == (i >> 15)));
+			} else {
+				assert(floatBits(value) == floatBits(reference));
+			}
+		}
+	}
+
+	// every half value, the midpoints between them and random bit patterns
+	std::vector<float> floats;
+	for(unsigned i = 0; i < 65536; i++) {
+		const unsigned u = floatBits(referenceHalfToFloat((WORD)i));
+		floats.push_back(bitsFloat(u));
+		floats.push_back(bitsFloat(u + 0x1000));
+		floats.push_back(bitsFloat(u + 0x0FFF));
+		floats.push_back(bitsFloat(u + 0x1001));
+	}
+	const unsigned edges[] = {
+		0x00000001, 0x007FFFFF, 0x00800000, 0x33000000, 0x33000001, 0x337FFFFF, 0x33C00000,
+		0x387FC000, 0x387FE000, 0x387FFFFF, 0x38800000, 0x477FE000, 0x477FEFFF, 0x477FF000,
+		0x477FFFFF, 0x47800000, 0x7F7FFFFF, 0x7F800000, 0x7F800001, 0x7FC00000, 0x7FFFFFFF
+	};
+	for(size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+		floats.push_back(bitsFloat(edges[i]));
+		floats.push_back(bitsFloat(edges[i] | 0x80000000));
+	}
+	unsigned seed = 12345;
+	for(int i = 0; i < 1000000; i++) {
+		seed = seed * 1664525 + 1013904223;
+		floats.push_back(bitsFloat(seed));
+	}
+	std::vector<WORD> halfs(floats.size());
+	FreeImage_ConvertLineFloatToHalf(&halfs[0], &floats[0], (int)floats.size());
+	for(size_t i = 0; i < floats.size(); i++) {
+		assert(sameHalf(halfs[i], referenceFloatToHalf(floats[i])));
+	}
+}
+
+// ----------------------------------------------------------
+
+/**
+Sum the pixels of a 32-bit image through a typed view, reading each pixel once
+*/
+static unsigned long long sumView(FIBITMAP *dib) {
+	unsigned long long sum = 0;
+	FIImageView<const RGBQUAD> view(dib);
+	for(FIImageView<const RGBQUAD>::iterator it = view.begin(); it != view.end(); ++it) {
+		const FIImageRow<const RGBQUAD> row = *it;
+		for(const RGBQUAD *pixel = row.begin(); pixel != row.end(); pixel++) {
+			sum += pixel->rgbRed + pixel->rgbGreen + pixel->rgbBlue + pixel->rgbReserved;
+		}
+	}
+	return sum;
+}
+
+void testImageView(unsigned width, unsigned height) {
+	printf("testImageView ...\n");
+
+	// a view is only valid for a matching pixel type
+	FIBITMAP *dib32 = FreeImage_Allocate(width, height, 32);
+	FIBITMAP *dib24 = FreeImage_Allocate(width, height, 24);
+	FIBITMAP *dibf = FreeImage_AllocateT(FIT_RGBAF, width, height);
+	FIBITMAP *header = FreeImage_Load(FIF_PNG, "sample.png", FIF_LOAD_NOPIXELS);
+	assert(dib32 && dib24 && dibf && header);
+	assert(FIImageView<RGBQUAD>(dib32).isValid());
+	assert(!FIImageView<RGBQUAD>(dib24).isValid());
+	assert(FIImageView<const RGBTRIPLE>(dib24).isValid());
+	assert(!FIImageView<FIRGBF>(dibf).isValid());
+	assert(!FIImageView<const BYTE>(header).isValid() && !FIImageView<const RGBTRIPLE>(header).isValid() && !FIImageView<const RGBQUAD>(header).isValid());
+	assert(!FIImageView<RGBQUAD>(NULL).isValid());
+	assert(FIImageView<RGBQUAD>(NULL).begin() == FIImageView<RGBQUAD>(NULL).end());
+
+	// writes through the view match FreeImage_GetPixelColor
+	FIImageView<RGBQUAD> view(dib32);
+	assert((view.getWidth() == width) && (view.getHeight() == height) && (view.getPitch() == FreeImage_GetPitch(dib32)));
+	unsigned rows = 0;
+	for(FIImageView<RGBQUAD>::iterator it = view.begin(); it != view.end(); ++it, rows++) {
+		FIImageRow<RGBQUAD> row = *it;
+		assert((BYTE*)row.data() == FreeImage_GetScanLine(dib32, rows));
+		for(unsigned x = 0; x < row.size(); x++) {
+			row[x].rgbRed = (BYTE)x;
+			row[x].rgbGreen = (BYTE)rows;
+			row[x].rgbBlue = (BYTE)(x ^ rows);
+			row[x].rgbReserved = 0xFF;
+		}
+	}
+	assert(rows == height);
+	for(unsigned y = 0; y < height; y += 7) {
+		for(unsigned x = 0; x < width; x += 5) {
+			RGBQUAD color;
+			FreeImage_GetPixelColor(dib32, x, y, &color);
+			assert(memcmp(&color, &view(x, y), sizeof(RGBQUAD)) == 0);
+			assert(&view[y][x] == &view(x, y));
+			assert((color.rgbRed == (BYTE)x) && (color.rgbGreen == (BYTE)y) && (color.rgbBlue == (BYTE)(x ^ y)));
+		}
+	}
+
+	// sub rows address the same pixels
+	FIImageRow<RGBQUAD> sub = view[height / 2].subRow(2, 5);
+	assert((sub.size() == 5) && (&sub[0] == &view(2, height / 2)) && (sub.end() == &view(7, height / 2)));
+
+	// float views
+	FIImageView<FIRGBAF> viewf(dibf);
+	assert(viewf.isValid());
+	viewf(width - 1, height - 1).alpha = 0.5F;
+	assert(((FIRGBAF*)FreeImage_GetScanLine(dibf, height - 1))[width - 1].alpha == 0.5F);
+
+	// the view gives the same result as per pixel accesses
+	unsigned long long sum = 0;
+	for(unsigned y = 0; y < height; y++) {
+		for(unsigned x = 0; x < width; x++) {
+			RGBQUAD color;
+			FreeImage_GetPixelColor(dib32, x, y, &color);
+			sum += color.rgbRed + color.rgbGreen + color.rgbBlue + color.rgbReserved;
+		}
+	}
+	assert(sum == sumView(dib32));
+
+	FreeImage_Unload(header);
+	FreeImage_Unload(dibf);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib32);
+}
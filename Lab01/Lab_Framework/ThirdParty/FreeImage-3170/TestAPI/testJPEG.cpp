@@ -22,6 +22,8 @@
 
 #include "TestSuite.h"
 
+#include <string.h>
+
 // Local test functions
 // ----------------------------------------------------------
 
@@ -194,6 +196,255 @@ void testJPEGSameFile(const char *src_file) {
 	assert(bResult);
 }
 
+void testJPEGLoadScaled(const char *src_file) {
+	FIBITMAP *dib = FreeImage_Load(FIF_JPEG, src_file, JPEG_DEFAULT);
+	assert(dib);
+	const int width = (int)FreeImage_GetWidth(dib);
+	const int height = (int)FreeImage_GetHeight(dib);
+	FreeImage_Unload(dib);
+
+	// downscaled decoding followed by a final resampling
+	const int dst_width = width / 5;
+	const int dst_height = height / 3;
+	dib = FreeImage_LoadScaled(FIF_JPEG, src_file, dst_width, dst_height, FILTER_CATMULLROM, JPEG_DEFAULT);
+	assert(dib);
+	assert((FreeImage_GetWidth(dib) == (unsigned)dst_width) && (FreeImage_GetHeight(dib) == (unsigned)dst_height));
+	// the original size is stored when the image was decoded at a reduced scale
+	FITAG *tag = NULL;
+	BOOL bResult = FreeImage_GetMetadata(FIMD_COMMENTS, dib, "OriginalJPEGWidth", &tag);
+	assert((bResult == TRUE) && (tag != NULL));
+	FreeImage_Unload(dib);
+
+	// upscaling only resamples the full size image
+	dib = FreeImage_LoadScaled(FIF_JPEG, src_file, width + 10, height + 10, FILTER_BILINEAR, JPEG_DEFAULT);
+	assert(dib);
+	assert((FreeImage_GetWidth(dib) == (unsigned)(width + 10)) && (FreeImage_GetHeight(dib) == (unsigned)(height + 10)));
+	FreeImage_Unload(dib);
+}
+
+/**
+Decode a JPEG stream with or without the SIMD routines
+*/
+static FIBITMAP* loadJPEG(FIMEMORY *hmem, int flags, BOOL simd) {
+	FreeImage_SetJPEGSIMD(simd);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_JPEG, hmem, flags);
+	assert(dib != NULL);
+	return dib;
+}
+
+/**
+Returns TRUE when two images have the same size and pixels
+*/
+static BOOL samePixels(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return FALSE;
+	}
+	const unsigned line = FreeImage_GetLine(dib1);
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), line) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Decode a JPEG stream with each load flag, with and without the SIMD routines, 
+and check that both give the same pixels
+*/
+static void compareSIMD(FIMEMORY *hmem) {
+	const int load_flags[] = { JPEG_DEFAULT, JPEG_ACCURATE, JPEG_GREYSCALE };
+
+	for(int i = 0; i < 3; i++) {
+		FIBITMAP *c = loadJPEG(hmem, load_flags[i], FALSE);
+		FIBITMAP *simd = loadJPEG(hmem, load_flags[i], TRUE);
+		assert(samePixels(c, simd));
+		FreeImage_Unload(simd);
+		FreeImage_Unload(c);
+	}
+}
+
+/**
+The SIMD inner loops of the JPEG decoder must give exactly the pixels of the C version
+*/
+void testJPEGSIMD(const char *lpszDirectory) {
+	const int subsampling[] = { JPEG_SUBSAMPLING_411, JPEG_SUBSAMPLING_420, JPEG_SUBSAMPLING_422, JPEG_SUBSAMPLING_444 };
+	const int quality[] = { 10, 75, 100 };
+
+	printf("testJPEGSIMD ...\n");
+
+	if(!FreeImage_GetJPEGSIMD()) {
+		printf("... SIMD routines not available, skipping\n");
+		return;
+	}
+
+	// synthetic color image with an odd width, saved with every chroma subsampling
+	const unsigned width = 333, height = 171;
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+	FIBITMAP *src = FreeImage_ConvertTo24Bits(zone);
+	assert(src != NULL);
+	FreeImage_Unload(zone);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++, bits += 3) {
+			bits[FI_RGBA_RED] = (BYTE)(x * 255 / width);
+			bits[FI_RGBA_BLUE] = (BYTE)((x ^ y) & 0xFF);
+		}
+	}
+
+	for(int s = 0; s < 4; s++) {
+		for(int q = 0; q < 3; q++) {
+			FIMEMORY *hmem = FreeImage_OpenMemory();
+			BOOL bResult = FreeImage_SaveToMemory(FIF_JPEG, src, hmem, subsampling[s] | quality[q] | (q == 1 ? JPEG_PROGRESSIVE : 0));
+			assert(bResult);
+			compareSIMD(hmem);
+			FreeImage_CloseMemory(hmem);
+		}
+	}
+	FreeImage_Unload(src);
+
+	// framework textures
+	std::vector<std::string> files = listFiles(lpszDirectory);
+	for(size_t i = 0; i < files.size(); i++) {
+		if(FreeImage_GetFileType(files[i].c_str()) != FIF_JPEG) {
+			continue;
+		}
+		FILE *stream = fopen(files[i].c_str(), "rb");
+		assert(stream != NULL);
+		fseek(stream, 0, SEEK_END);
+		std::vector<BYTE> buffer(ftell(stream));
+		fseek(stream, 0, SEEK_SET);
+		if(!buffer.empty() && fread(&buffer[0], 1, buffer.size(), stream) == buffer.size()) {
+			FIMEMORY *hmem = FreeImage_OpenMemory(&buffer[0], (DWORD)buffer.size());
+			compareSIMD(hmem);
+			FreeImage_CloseMemory(hmem);
+		}
+		fclose(stream);
+	}
+
+	FreeImage_SetJPEGSIMD(TRUE);
+}
+
+/**
+Save an image with restart markers into a new memory stream
+*/
+static FIMEMORY* saveJPEGRestart(FIBITMAP *dib, int flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	BOOL bResult = FreeImage_SaveToMemory(FIF_JPEG, dib, hmem, flags | JPEG_RESTART);
+	assert(bResult == TRUE);
+	return hmem;
+}
+
+/**
+Save an image with restart markers using 1, 2 and thread_count threads, 
+and check that the streams are the same. Returns the stream saved using the default thread count.
+*/
+static FIMEMORY* saveJPEGAndCompareThreads(FIBITMAP *dib, int flags, unsigned thread_count) {
+	runAndCompareThreads([dib, flags]() {
+		FIMEMORY *hmem = saveJPEGRestart(dib, flags);
+		BYTE *data = NULL;
+		DWORD size = 0;
+		FreeImage_AcquireMemory(hmem, &data, &size);
+		const unsigned long long hash = hashBuffer(data, size);
+		FreeImage_CloseMemory(hmem);
+		return hash;
+	}, thread_count);
+
+	return saveJPEGRestart(dib, flags);
+}
+
+/**
+Decode a JPEG stream using 1, 2 and thread_count threads, with each load flag, 
+and check that the pixels are the same
+*/
+static void loadJPEGAndCompareThreads(FIMEMORY *hmem, unsigned thread_count) {
+	const int load_flags[] = { JPEG_DEFAULT, JPEG_ACCURATE, JPEG_GREYSCALE };
+
+	for(int i = 0; i < 3; i++) {
+		const int flags = load_flags[i];
+		runAndCompareThreads([hmem, flags]() {
+			FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+			FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_JPEG, hmem, flags);
+			assert(dib != NULL);
+			const unsigned long long hash = hashBitmap(dib);
+			FreeImage_Unload(dib);
+			return hash;
+		}, thread_count);
+	}
+}
+
+/**
+Images with restart markers are decoded and encoded in stripes: the streams and the pixels 
+must not depend on the number of threads
+*/
+void testJPEGRestart(unsigned thread_count) {
+	const int subsampling[] = { JPEG_SUBSAMPLING_411, JPEG_SUBSAMPLING_420, JPEG_SUBSAMPLING_422, JPEG_SUBSAMPLING_444 };
+
+	printf("testJPEGRestart ...\n");
+
+	// synthetic images with odd sizes
+	const unsigned width = 1531, height = 1021;
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+	FIBITMAP *src = FreeImage_ConvertTo24Bits(zone);
+	assert(src != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++, bits += 3) {
+			bits[FI_RGBA_RED] = (BYTE)(x * 255 / width);
+			bits[FI_RGBA_BLUE] = (BYTE)((x ^ y) & 0xFF);
+		}
+	}
+	FIBITMAP *palettized = FreeImage_ColorQuantize(src, FIQ_WUQUANT);
+	assert(palettized != NULL);
+
+	for(int s = 0; s < 4; s++) {
+		FIMEMORY *hmem = saveJPEGAndCompareThreads(src, subsampling[s] | JPEG_QUALITYGOOD, thread_count);
+		loadJPEGAndCompareThreads(hmem, thread_count);
+		FreeImage_CloseMemory(hmem);
+	}
+	const int other_flags[] = { JPEG_QUALITYSUPERB | JPEG_BASELINE, JPEG_QUALITYBAD | JPEG_OPTIMIZE, JPEG_PROGRESSIVE };
+	for(int i = 0; i < 3; i++) {
+		FIMEMORY *hmem = saveJPEGAndCompareThreads(src, other_flags[i], thread_count);
+		loadJPEGAndCompareThreads(hmem, thread_count);
+		FreeImage_CloseMemory(hmem);
+	}
+	FIBITMAP *others[] = { zone, palettized };
+	for(int i = 0; i < 2; i++) {
+		FIMEMORY *hmem = saveJPEGAndCompareThreads(others[i], JPEG_DEFAULT, thread_count);
+		loadJPEGAndCompareThreads(hmem, thread_count);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// a truncated stream is decoded as a single decoder would decode it
+	{
+		FIMEMORY *hmem = saveJPEGAndCompareThreads(src, JPEG_DEFAULT, thread_count);
+		BYTE *data = NULL;
+		DWORD size = 0;
+		FreeImage_AcquireMemory(hmem, &data, &size);
+		FIMEMORY *truncated = FreeImage_OpenMemory(data, size * 2 / 3);
+		printf("... a premature end of file warning is expected\n");
+		loadJPEGAndCompareThreads(truncated, thread_count);
+		FreeImage_CloseMemory(truncated);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// stripes are not used without restart markers
+	{
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		BOOL bResult = FreeImage_SaveToMemory(FIF_JPEG, src, hmem, JPEG_DEFAULT);
+		assert(bResult == TRUE);
+		loadJPEGAndCompareThreads(hmem, thread_count);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(palettized);
+	FreeImage_Unload(src);
+	FreeImage_Unload(zone);
+}
+
 // Main test function
 // ----------------------------------------------------------
 
@@ -213,4 +464,7 @@ void testJPEG() {
 
 	// using the same file for src & dst is allowed
 	testJPEGSameFile(src_file);
+
+	// downscaled decoding
+	testJPEGLoadScaled(src_file);
 }
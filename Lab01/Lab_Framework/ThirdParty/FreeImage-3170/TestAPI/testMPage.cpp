@@ -91,6 +91,135 @@ void testMPageCache(const char *src_filename, const char *dst_filename) {
 	FreeImage_CloseMultiBitmap(out, 0); 
 }
 
+/**
+Fill a pixel pattern that depends on the page number
+*/
+static void fillPage(FIBITMAP *dib, int page) {
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			bits[x] = (BYTE)(x + y + page);
+		}
+	}
+}
+
+static BOOL checkPage(FIBITMAP *dib, int page) {
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			if(bits[x] != (BYTE)(x + y + page)) {
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/**
+Build a multipage file whose cache is larger than the cache budget, 
+so that the cache windows are evicted, and check every saved page
+*/
+void testMPageCacheBudget(const char *dst_filename) {
+
+	// 1 byte is rounded up to the minimum budget (two windows)
+	FreeImage_SetMultiBitmapCacheSize(1);
+
+	FIMULTIBITMAP *out = FreeImage_OpenMultiBitmap(FIF_TIFF, dst_filename, TRUE, FALSE, FALSE); 
+	assert(out != NULL);
+
+	// 12 pages of about 500 KB each, plus a page deleted on the way to recycle its cache blocks
+	const int page_count = 12;
+	for(int i = 0; i < page_count; i++) { 		
+		FIBITMAP *page = FreeImage_Allocate(480, 360, 24);
+		assert(page != NULL);
+		fillPage(page, i);
+		FreeImage_AppendPage(out, page); 
+		if(i == 3) {
+			fillPage(page, 255);
+			FreeImage_AppendPage(out, page); 
+			FreeImage_DeletePage(out, 4);
+		}
+		FreeImage_Unload(page); 
+	} 
+	assert(FreeImage_GetPageCount(out) == page_count);
+
+	FreeImage_CloseMultiBitmap(out, 0); 
+
+	// restore the default budget
+	FreeImage_SetMultiBitmapCacheSize(0);
+
+	// check the pages, in reverse order
+	FIMULTIBITMAP *in = FreeImage_OpenMultiBitmap(FIF_TIFF, dst_filename, FALSE, TRUE, TRUE); 
+	assert(in != NULL);
+	assert(FreeImage_GetPageCount(in) == page_count);
+	for(int i = page_count - 1; i >= 0; i--) {
+		FIBITMAP *page = FreeImage_LockPage(in, i);
+		assert(page != NULL);
+		assert(checkPage(page, i));
+		FreeImage_UnlockPage(in, page, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(in, 0); 
+}
+
+/**
+Read the pages written by testMPageCacheBudget while they are prefetched, 
+from a file and from a memory stream, with a budget smaller than the file
+*/
+void testMPagePrefetch(const char *src_filename) {
+
+	FreeImage_SetThreadCount(4);
+
+	// from a file
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_TIFF, src_filename, FALSE, TRUE, TRUE); 
+	assert(src != NULL);
+	const int page_count = FreeImage_GetPageCount(src);
+
+	BOOL bResult = FreeImage_PrefetchPages(src, 0, page_count, 2 * 1024 * 1024);
+	assert(bResult);
+	for(int i = 0; i < page_count; i++) {
+		FIBITMAP *page = FreeImage_LockPage(src, i);
+		assert(page != NULL);
+		assert(checkPage(page, i));
+		FreeImage_UnlockPage(src, page, FALSE);
+	}
+
+	// closing cancels the pages still in flight
+	FreeImage_PrefetchPages(src, 0, page_count);
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	// from memory
+	FILE *file = fopen(src_filename, "rb");
+	assert(file != NULL);
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	BYTE *buffer = (BYTE*)malloc(size);
+	assert(buffer != NULL);
+	const size_t read = fread(buffer, 1, size, file);
+	assert(read == (size_t)size);
+	fclose(file);
+
+	FIMEMORY *stream = FreeImage_OpenMemory(buffer, size);
+	FIMULTIBITMAP *mem_src = FreeImage_LoadMultiBitmapFromMemory(FIF_TIFF, stream, 0);
+	assert(mem_src != NULL);
+
+	bResult = FreeImage_PrefetchPages(mem_src, page_count / 2, page_count);
+	assert(bResult);
+	for(int i = page_count - 1; i >= 0; i--) {
+		FIBITMAP *page = FreeImage_LockPage(mem_src, i);
+		assert(page != NULL);
+		assert(checkPage(page, i));
+		FreeImage_UnlockPage(mem_src, page, FALSE);
+	}
+	FreeImage_CancelPrefetch(mem_src);
+
+	FreeImage_CloseMultiBitmap(mem_src, 0);
+	FreeImage_CloseMemory(stream);
+	free(buffer);
+
+	FreeImage_SetThreadCount(0);
+}
+
 // --------------------------------------------------------------------------
 
 BOOL testCloneMultiPage(FREE_IMAGE_FORMAT fif, const char *input, const char *output, int output_flag) {
@@ -190,4 +319,6 @@ void testMultiPage(const char *lpszPathName) {
 
 	// test multipage cache
 	testMPageCache(lpszPathName, "mpages.tif");
+	testMPageCacheBudget("mpages.tif");
+	testMPagePrefetch("mpages.tif");
 }
@@ -36,3 +36,65 @@ void showPlugins() {
 	printf("\n");
 }
 
+// File type detection
+// ----------------------------------------------------------
+
+/**
+Save an image in a given format and check the format detected from the saved stream
+*/
+static void testGetFileTypeFormat(FIBITMAP *dib, FREE_IMAGE_FORMAT fif, FREE_IMAGE_FORMAT expected) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(hmem != NULL);
+
+	if(FreeImage_SaveToMemory(fif, dib, hmem, 0)) {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		const FREE_IMAGE_FORMAT detected = FreeImage_GetFileTypeFromMemory(hmem, 0);
+		if(detected != expected) {
+			printf("... %s detected as %s\n", FreeImage_GetFormatFromFIF(fif), FreeImage_GetFormatFromFIF(detected));
+		}
+		assert(detected == expected);
+		// detection does not move the stream
+		assert(FreeImage_TellMemory(hmem) == 0);
+	}
+
+	FreeImage_CloseMemory(hmem);
+}
+
+void testGetFileType(unsigned width, unsigned height) {
+	printf("testGetFileType ...\n");
+
+	FIBITMAP *grey = createZonePlateImage(width, height, 128);
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(grey);
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(grey);
+	assert(grey && rgb && rgbf);
+
+	const FREE_IMAGE_FORMAT formats[] = {
+		FIF_BMP, FIF_ICO, FIF_JPEG, FIF_PNG, FIF_TARGA, FIF_TIFF, FIF_PSD, FIF_XPM,
+		FIF_GIF, FIF_J2K, FIF_JP2, FIF_WEBP, FIF_JXR
+	};
+	for(unsigned i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		FIBITMAP *dib = FreeImage_FIFSupportsExportBPP(formats[i], 24) ? rgb : grey;
+		testGetFileTypeFormat(dib, formats[i], formats[i]);
+	}
+
+	// all the PNM formats share the same signatures, the first registered one wins
+	testGetFileTypeFormat(grey, FIF_PGM, FIF_PBM);
+	testGetFileTypeFormat(rgb, FIF_PPMRAW, FIF_PBM);
+
+	// float formats
+	testGetFileTypeFormat(rgbf, FIF_HDR, FIF_HDR);
+	testGetFileTypeFormat(rgbf, FIF_EXR, FIF_EXR);
+	testGetFileTypeFormat(rgbf, FIF_PFM, FIF_PFM);
+
+	// not an image
+	{
+		BYTE text[] = "This is not an image file, just some text long enough to fill a header.";
+		FIMEMORY *hmem = FreeImage_OpenMemory(text, sizeof(text));
+		assert(FreeImage_GetFileTypeFromMemory(hmem, 0) == FIF_UNKNOWN);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(rgbf);
+	FreeImage_Unload(rgb);
+	FreeImage_Unload(grey);
+}
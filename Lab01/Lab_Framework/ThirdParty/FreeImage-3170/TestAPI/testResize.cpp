@@ -0,0 +1,153 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+/**
+Returns the largest absolute difference between the samples of two 8-bit per channel images.
+The channel count of 'dib2' may be larger than the one of 'dib1' (e.g. greyscale vs RGB):
+each sample of 'dib1' is then compared with the first channels of 'dib2'.
+*/
+static int maxByteDifference(FIBITMAP *dib1, FIBITMAP *dib2) {
+	const unsigned width = FreeImage_GetWidth(dib1);
+	const unsigned height = FreeImage_GetHeight(dib1);
+	const unsigned bytespp1 = FreeImage_GetLine(dib1) / width;
+	const unsigned bytespp2 = FreeImage_GetLine(dib2) / width;
+	const unsigned channels1 = (bytespp1 < 3) ? bytespp1 : 3;
+	const unsigned channels2 = (bytespp2 < 3) ? bytespp2 : 3;
+	int max_diff = 0;
+
+	assert(width == FreeImage_GetWidth(dib2) && height == FreeImage_GetHeight(dib2));
+
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *bits1 = FreeImage_GetScanLine(dib1, y);
+		const BYTE *bits2 = FreeImage_GetScanLine(dib2, y);
+		for(unsigned x = 0; x < width; x++) {
+			for(unsigned c = 0; c < channels2; c++) {
+				const int diff = abs((int)bits1[c % channels1] - (int)bits2[c]);
+				if(diff > max_diff) max_diff = diff;
+			}
+			bits1 += bytespp1;
+			bits2 += bytespp2;
+		}
+	}
+
+	return max_diff;
+}
+
+/**
+Returns the largest absolute difference between a 24-bit image and a FIT_RGBF image, in 8-bit units
+*/
+static int maxFloatDifference(FIBITMAP *dib, FIBITMAP *dibf) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	int max_diff = 0;
+
+	assert(width == FreeImage_GetWidth(dibf) && height == FreeImage_GetHeight(dibf));
+
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dib, y);
+		const FIRGBF *bitsf = (FIRGBF*)FreeImage_GetScanLine(dibf, y);
+		for(unsigned x = 0; x < width; x++) {
+			float value = bitsf[x].red;
+			value = (value < 0) ? 0 : ((value > 1) ? 1 : value);
+			const int diff = abs((int)bits[FI_RGBA_RED] - (int)(255 * value + 0.5F));
+			if(diff > max_diff) max_diff = diff;
+			bits += 3;
+		}
+	}
+
+	return max_diff;
+}
+
+/**
+Rescale an image using 1, 2 and 4 threads, check that the results are identical 
+and return the image rescaled using the default thread count
+*/
+static FIBITMAP* rescaleAndCompareThreads(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTER filter) {
+	const unsigned long long hash = runAndCompareThreads([src, dst_width, dst_height, filter]() {
+		FIBITMAP *dst = FreeImage_Rescale(src, dst_width, dst_height, filter);
+		assert(dst != NULL);
+		const unsigned long long hash = hashBitmap(dst);
+		FreeImage_Unload(dst);
+		return hash;
+	}, 4);
+
+	FIBITMAP *dst = FreeImage_Rescale(src, dst_width, dst_height, filter);
+	assert(hashBitmap(dst) == hash);
+
+	return dst;
+}
+
+/**
+Check that the 8-, 24- and 32-bit fast paths agree with each other and with the float path
+*/
+static void testResizeFilter(FIBITMAP *grey, int dst_width, int dst_height, FREE_IMAGE_FILTER filter) {
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(grey);
+	FIBITMAP *rgba = FreeImage_ConvertTo32Bits(grey);
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(grey);
+	assert(rgb && rgba && rgbf);
+
+	FIBITMAP *grey_dst = rescaleAndCompareThreads(grey, dst_width, dst_height, filter);
+	FIBITMAP *rgb_dst = rescaleAndCompareThreads(rgb, dst_width, dst_height, filter);
+	FIBITMAP *rgba_dst = rescaleAndCompareThreads(rgba, dst_width, dst_height, filter);
+
+	FIBITMAP *rgbf_dst = FreeImage_Rescale(rgbf, dst_width, dst_height, filter);
+	assert(rgbf_dst);
+
+	// all channels are filtered the same way, whatever the pixel layout
+	assert(maxByteDifference(grey_dst, rgb_dst) == 0);
+	assert(maxByteDifference(grey_dst, rgba_dst) == 0);
+
+	// fixed-point weights stay within rounding of the float result
+	// when downsampling (when upsampling, the overshoot of negative lobes
+	// is clamped between the passes of 8-bit images, but not of float images)
+	if((unsigned)dst_width < FreeImage_GetWidth(grey)) {
+		assert(maxFloatDifference(rgb_dst, rgbf_dst) <= 1);
+	}
+
+	FreeImage_Unload(rgbf_dst);
+	FreeImage_Unload(rgba_dst);
+	FreeImage_Unload(rgb_dst);
+	FreeImage_Unload(grey_dst);
+	FreeImage_Unload(rgbf);
+	FreeImage_Unload(rgba);
+	FreeImage_Unload(rgb);
+}
+
+/**
+Test the resampling engine
+*/
+void testResize(unsigned width, unsigned height) {
+	printf("testResize ...\n");
+
+	FIBITMAP *grey = createZonePlateImage(width, height, 128);
+	assert(grey);
+
+	const FREE_IMAGE_FILTER filters[] = { FILTER_BOX, FILTER_BILINEAR, FILTER_CATMULLROM, FILTER_LANCZOS3 };
+
+	for(unsigned i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
+		// downsampling
+		testResizeFilter(grey, width / 3 + 1, height / 4 + 3, filters[i]);
+		// upsampling
+		testResizeFilter(grey, width * 3 / 2 + 1, height * 5 / 4 + 3, filters[i]);
+	}
+
+	FreeImage_Unload(grey);
+}
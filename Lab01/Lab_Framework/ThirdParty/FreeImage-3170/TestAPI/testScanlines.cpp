@@ -0,0 +1,252 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <string.h>
+
+// ----------------------------------------------------------
+
+static unsigned DLL_CALLCONV
+myReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return (unsigned)fread(buffer, size, count, (FILE *)handle);
+}
+
+static unsigned DLL_CALLCONV
+myWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return (unsigned)fwrite(buffer, size, count, (FILE *)handle);
+}
+
+static int DLL_CALLCONV
+mySeekProc(fi_handle handle, long offset, int origin) {
+	return fseek((FILE *)handle, offset, origin);
+}
+
+static long DLL_CALLCONV
+myTellProc(fi_handle handle) {
+	return ftell((FILE *)handle);
+}
+
+/**
+Compare the pixels of two images of the same size and format
+*/
+static BOOL samePixels(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if(!dib1 || !dib2) {
+		return FALSE;
+	}
+	if((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return FALSE;
+	}
+	const unsigned line = FreeImage_GetLine(dib1);
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), line) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Read a file a few scanlines at a time and check the rows against a regular loading
+*/
+static void testScanlineReader(FREE_IMAGE_FORMAT fif, const char *lpszPathName, int flags) {
+	FIBITMAP *reference = FreeImage_Load(fif, lpszPathName, flags);
+	assert(reference != NULL);
+
+	FISCANREADER *reader = FreeImage_OpenScanlineReader(fif, lpszPathName, flags);
+	assert(reader != NULL);
+
+	FIBITMAP *info = FreeImage_GetScanlineReaderInfo(reader);
+	const unsigned width = FreeImage_GetWidth(info);
+	const unsigned height = FreeImage_GetHeight(info);
+	assert(width == FreeImage_GetWidth(reference));
+	assert(height == FreeImage_GetHeight(reference));
+	assert(FreeImage_GetBPP(info) == FreeImage_GetBPP(reference));
+	assert(FreeImage_GetImageType(info) == FreeImage_GetImageType(reference));
+
+	// rows are delivered top-down, with a caller defined pitch
+	const unsigned line = FreeImage_GetLine(info);
+	const unsigned pitch = line + 5;
+	const unsigned band = 7;
+	BYTE *bits = (BYTE*)malloc(band * pitch);
+	assert(bits != NULL);
+
+	unsigned y = 0;
+	unsigned lines = 0;
+	while((lines = FreeImage_ReadScanlines(reader, bits, pitch, band)) > 0) {
+		for(unsigned i = 0; i < lines; i++, y++) {
+			assert(memcmp(bits + i * pitch, FreeImage_GetScanLine(reference, height - 1 - y), line) == 0);
+		}
+	}
+	assert(y == height);
+
+	free(bits);
+	FreeImage_CloseScanlineReader(reader);
+	FreeImage_Unload(reference);
+}
+
+/**
+Write an image a few scanlines at a time, then check the file against a regular saving
+*/
+static void testScanlineWriter(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *lpszPathName, int flags) {
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+	const unsigned band = 5;
+	BYTE *bits = (BYTE*)malloc(band * line);
+	assert(bits != NULL);
+
+	BOOL bResult = FALSE;
+
+	// the writer keeps its own copy of the image description
+	FISCANWRITER *writer = FreeImage_OpenScanlineWriter(fif, lpszPathName, dib, flags);
+	assert(writer != NULL);
+
+	for(unsigned y = 0; y < height; y += band) {
+		const unsigned count = (y + band > height) ? height - y : band;
+		for(unsigned i = 0; i < count; i++) {
+			memcpy(bits + i * line, FreeImage_GetScanLine(dib, height - 1 - (y + i)), line);
+		}
+		bResult = FreeImage_WriteScanlines(writer, bits, line, count);
+		assert(bResult == TRUE);
+	}
+
+	// writing past the last row fails
+	bResult = FreeImage_WriteScanlines(writer, bits, line, 1);
+	assert(bResult == FALSE);
+
+	free(bits);
+
+	// a failed write fails the whole stream
+	bResult = FreeImage_CloseScanlineWriter(writer);
+	assert(bResult == FALSE);
+
+	// write again, without the extra row this time
+	writer = FreeImage_OpenScanlineWriter(fif, lpszPathName, dib, flags);
+	assert(writer != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		bResult = FreeImage_WriteScanlines(writer, FreeImage_GetScanLine(dib, height - 1 - y), line, 1);
+		assert(bResult == TRUE);
+	}
+	bResult = FreeImage_CloseScanlineWriter(writer);
+	assert(bResult == TRUE);
+
+	// compare with a regular saving
+	bResult = FreeImage_Save(fif, dib, "scanlines_ref.bin", flags);
+	assert(bResult == TRUE);
+
+	FIBITMAP *streamed = FreeImage_Load(fif, lpszPathName, 0);
+	FIBITMAP *saved = FreeImage_Load(fif, "scanlines_ref.bin", 0);
+	assert(samePixels(streamed, saved));
+	FreeImage_Unload(saved);
+	FreeImage_Unload(streamed);
+
+	remove("scanlines_ref.bin");
+}
+
+/**
+An image with missing rows is not completed
+*/
+static void testScanlineWriterIncomplete(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *lpszPathName) {
+	FISCANWRITER *writer = FreeImage_OpenScanlineWriter(fif, lpszPathName, dib, 0);
+	assert(writer != NULL);
+	BOOL bResult = FreeImage_WriteScanlines(writer, FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - 1), FreeImage_GetPitch(dib), 1);
+	assert(bResult == TRUE);
+	bResult = FreeImage_CloseScanlineWriter(writer);
+	assert(bResult == FALSE);
+}
+
+// ----------------------------------------------------------
+
+void testScanlines(const char *lpszPathName) {
+	printf("testScanlines ...\n");
+
+	FIBITMAP *dib = FreeImage_Load(FreeImage_GetFileType(lpszPathName), lpszPathName, 0);
+	assert(dib != NULL);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib);
+	FIBITMAP *dib8 = FreeImage_ConvertToGreyscale(dib);
+	FIBITMAP *dib16 = FreeImage_ConvertToType(dib8, FIT_UINT16);
+	assert(dib24 && dib8 && dib16);
+
+	const FREE_IMAGE_FORMAT formats[] = { FIF_PNG, FIF_TIFF, FIF_JPEG, FIF_BMP };
+	const char *names[] = { "scanlines.png", "scanlines.tif", "scanlines.jpg", "scanlines.bmp" };
+
+	for(int i = 0; i < 4; i++) {
+		// native streams (BMP goes through the whole image fallback)
+		testScanlineWriter(formats[i], dib24, names[i], 0);
+		testScanlineReader(formats[i], names[i], 0);
+
+		testScanlineWriter(formats[i], dib8, names[i], 0);
+		testScanlineReader(formats[i], names[i], 0);
+
+		if(formats[i] != FIF_JPEG) {
+			testScanlineWriter(formats[i], dib, names[i], 0);
+			testScanlineReader(formats[i], names[i], 0);
+		}
+		if(FreeImage_FIFSupportsExportType(formats[i], FIT_UINT16)) {
+			testScanlineWriter(formats[i], dib16, names[i], 0);
+			testScanlineReader(formats[i], names[i], 0);
+		}
+
+		testScanlineWriterIncomplete(formats[i], dib24, names[i]);
+
+		remove(names[i]);
+	}
+
+	// save options are honored
+	testScanlineWriter(FIF_JPEG, dib24, "scanlines.jpg", JPEG_QUALITYSUPERB | JPEG_PROGRESSIVE);
+	testScanlineReader(FIF_JPEG, "scanlines.jpg", JPEG_ACCURATE);
+	testScanlineWriter(FIF_TIFF, dib24, "scanlines.tif", TIFF_DEFLATE);
+	testScanlineReader(FIF_TIFF, "scanlines.tif", 0);
+	testScanlineWriter(FIF_PNG, dib8, "scanlines.png", PNG_Z_BEST_COMPRESSION);
+	testScanlineReader(FIF_PNG, "scanlines.png", 0);
+
+	// interlaced PNG files are loaded as a whole
+	testScanlineWriter(FIF_PNG, dib24, "scanlines.png", PNG_INTERLACED);
+	testScanlineReader(FIF_PNG, "scanlines.png", 0);
+
+	// reading from a handle
+	FreeImage_Save(FIF_JPEG, dib24, "scanlines.jpg", 0);
+	FILE *file = fopen("scanlines.jpg", "rb");
+	assert(file != NULL);
+	FreeImageIO io;
+	io.read_proc = myReadProc;
+	io.write_proc = myWriteProc;
+	io.seek_proc = mySeekProc;
+	io.tell_proc = myTellProc;
+	FISCANREADER *reader = FreeImage_OpenScanlineReaderFromHandle(FIF_JPEG, &io, (fi_handle)file, 0);
+	assert(reader != NULL);
+	BYTE *bits = (BYTE*)malloc(FreeImage_GetLine(FreeImage_GetScanlineReaderInfo(reader)));
+	unsigned total = 0;
+	while(FreeImage_ReadScanlines(reader, bits, 0, 1) == 1) {
+		total++;
+	}
+	assert(total == FreeImage_GetHeight(dib24));
+	free(bits);
+	FreeImage_CloseScanlineReader(reader);
+	fclose(file);
+
+	remove("scanlines.png");
+	remove("scanlines.tif");
+	remove("scanlines.jpg");
+
+	FreeImage_Unload(dib16);
+	FreeImage_Unload(dib8);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib);
+}
@@ -0,0 +1,1072 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <string>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+// ----------------------------------------------------------
+
+/**
+Load an image and return its hash, or 0 if the image cannot be loaded
+*/
+static unsigned long long loadAndHash(const std::string& path) {
+	const FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(path.c_str());
+	if(fif == FIF_UNKNOWN) {
+		return 0;
+	}
+	FIBITMAP *dib = FreeImage_Load(fif, path.c_str(), 0);
+	const unsigned long long hash = hashBitmap(dib);
+	FreeImage_Unload(dib);
+	return hash;
+}
+
+// ----------------------------------------------------------
+
+/**
+Decode every image of a directory from many threads at once,
+and check the results against a single-threaded decoding.
+*/
+void testConcurrentLoad(const char *lpszDirectory, unsigned thread_count) {
+	printf("testConcurrentLoad ...\n");
+
+	// only keep the files FreeImage recognizes
+	std::vector<std::string> files = listFiles(lpszDirectory);
+	for(size_t i = files.size(); i > 0; i--) {
+		if(FreeImage_GetFileType(files[i - 1].c_str()) == FIF_UNKNOWN) {
+			files.erase(files.begin() + (i - 1));
+		}
+	}
+	if(files.empty()) {
+		printf("... %s not found or without images, skipping\n", lpszDirectory);
+		return;
+	}
+
+	// reference results: every image must decode, otherwise a failed load would match a failed reference
+	std::vector<unsigned long long> reference(files.size());
+	for(size_t i = 0; i < files.size(); i++) {
+		reference[i] = loadAndHash(files[i]);
+		assert(reference[i] != 0);
+	}
+
+	// each thread decodes all files, starting at a different file
+	const unsigned rounds = 2;
+	std::atomic<unsigned> mismatches(0);
+	std::vector<std::thread> threads;
+
+	for(unsigned t = 0; t < thread_count; t++) {
+		threads.push_back(std::thread([&files, &reference, &mismatches, rounds, t]() {
+			for(size_t n = 0; n < rounds * files.size(); n++) {
+				const size_t i = (t + n) % files.size();
+				if(loadAndHash(files[i]) != reference[i]) {
+					mismatches++;
+				}
+			}
+		}));
+	}
+	for(size_t t = 0; t < threads.size(); t++) {
+		threads[t].join();
+	}
+
+	printf("... decoded %d files %d times from %d threads\n", (int)files.size(), (int)(rounds * thread_count), (int)thread_count);
+
+	assert(mismatches == 0);
+}
+
+/**
+Allocate and release bitmaps of various sizes from many threads,
+with the memory pool enabled, and check that buffers are recycled.
+*/
+void testMemoryPool(unsigned thread_count) {
+	printf("testMemoryPool ...\n");
+
+	const unsigned rounds = 50;
+	const int sizes[] = { 17, 256, 300, 1024 };
+	const unsigned size_count = sizeof(sizes) / sizeof(sizes[0]);
+	std::atomic<unsigned> errors(0);
+	std::vector<std::thread> threads;
+
+	FIMEMORYPOOLSTATS before;
+	FreeImage_GetMemoryPoolStats(&before);
+
+	FreeImage_SetMemoryPool(TRUE, 64);
+
+	for(unsigned t = 0; t < thread_count; t++) {
+		threads.push_back(std::thread([&sizes, &errors, size_count, rounds, t]() {
+			for(unsigned n = 0; n < rounds; n++) {
+				const int size = sizes[(t + n) % size_count];
+				FIBITMAP *dib = FreeImage_Allocate(size, size, 32);
+				if(!dib) {
+					errors++;
+					continue;
+				}
+				// recycled buffers must be cleared and aligned like fresh ones
+				BYTE *bits = FreeImage_GetBits(dib);
+				if(((size_t)bits % 16) != 0 || bits[0] != 0 || bits[FreeImage_GetPitch(dib) - 1] != 0) {
+					errors++;
+				}
+				memset(bits, 0xFF, FreeImage_GetPitch(dib) * size);
+				FreeImage_Unload(dib);
+			}
+		}));
+	}
+	for(size_t t = 0; t < threads.size(); t++) {
+		threads[t].join();
+	}
+
+	FIMEMORYPOOLSTATS stats;
+	FreeImage_GetMemoryPoolStats(&stats);
+
+	printf("... %d requests, %d hits (%d from thread caches), %d KB retained\n", 
+		(int)(stats.requests - before.requests), (int)(stats.hits - before.hits), 
+		(int)(stats.thread_hits - before.thread_hits), (int)(stats.bytes_retained >> 10));
+
+	assert(errors == 0);
+	assert(stats.requests - before.requests >= thread_count * rounds);
+	assert(stats.hits > before.hits);
+	assert(stats.bytes_retained <= ((UINT64)64 << 20));
+
+	// a purge also drains the cache of a thread that is still running
+	std::atomic<int> step(0);
+	std::thread worker([&step]() {
+		FreeImage_Unload(FreeImage_Allocate(64, 64, 32));
+		step = 1;
+		while(step != 2) {
+			std::this_thread::yield();
+		}
+	});
+	while(step != 1) {
+		std::this_thread::yield();
+	}
+	FreeImage_PurgeMemoryPool();
+	FreeImage_GetMemoryPoolStats(&stats);
+	step = 2;
+	worker.join();
+	assert(stats.bytes_retained == 0);
+
+	// disabling the pool gives the retained memory back
+	FreeImage_SetMemoryPool(FALSE);
+	FreeImage_GetMemoryPoolStats(&stats);
+	assert(stats.bytes_retained == 0);
+}
+
+/**
+Save an image as PNG and return the hash of the decoded file
+*/
+static unsigned long long savePNGAndHash(FIBITMAP *dib, int flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	BOOL bResult = FreeImage_SaveToMemory(FIF_PNG, dib, hmem, flags);
+	assert(bResult == TRUE);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_PNG, hmem);
+	assert(loaded != NULL);
+	const unsigned long long hash = hashBitmap(loaded);
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+	return hash;
+}
+
+/**
+Check that a PNG file saved with any number of threads decodes to the same image
+*/
+static void savePNGAndCompareThreads(FIBITMAP *dib, int flags, unsigned thread_count) {
+	runAndCompareThreads([dib, flags]() { return savePNGAndHash(dib, flags); }, thread_count);
+}
+
+void testParallelPNG(unsigned thread_count) {
+	printf("testParallelPNG ...\n");
+
+	FIBITMAP *dib8 = createZonePlateImage(1024, 1024, 128);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib24);
+	FIBITMAP *dib32a = FreeImage_Clone(dib32);
+	FIBITMAP *palettized = FreeImage_ColorQuantize(dib24, FIQ_WUQUANT);
+	FIBITMAP *dib16 = FreeImage_ConvertToType(dib8, FIT_UINT16);
+	FIBITMAP *rgba16 = FreeImage_ConvertToRGBA16(dib32);
+	FIBITMAP *wide = createZonePlateImage(4096, 1024, 64);
+	FIBITMAP *mono = FreeImage_Threshold(wide, 128);
+	FIBITMAP *miniswhite = FreeImage_Threshold(wide, 128);
+	assert(dib8 && dib24 && dib32 && dib32a && palettized && dib16 && rgba16 && mono && miniswhite);
+
+	// an alpha channel with some variations
+	FreeImage_SetTransparent(dib32a, TRUE);
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib32a); y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib32a, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(dib32a); x++, bits += 4) {
+			bits[FI_RGBA_ALPHA] = (BYTE)(x ^ y);
+		}
+	}
+	RGBQUAD *pal = FreeImage_GetPalette(miniswhite);
+	pal[0].rgbRed = pal[0].rgbGreen = pal[0].rgbBlue = 255;
+	pal[1].rgbRed = pal[1].rgbGreen = pal[1].rgbBlue = 0;
+	assert(FreeImage_GetColorType(miniswhite) == FIC_MINISWHITE);
+
+	savePNGAndCompareThreads(dib8, PNG_Z_BEST_SPEED, thread_count);
+	savePNGAndCompareThreads(dib24, PNG_DEFAULT, thread_count);
+	savePNGAndCompareThreads(dib32, PNG_Z_BEST_SPEED, thread_count);
+	savePNGAndCompareThreads(dib32a, PNG_Z_BEST_SPEED, thread_count);
+	savePNGAndCompareThreads(palettized, PNG_Z_BEST_COMPRESSION, thread_count);
+	savePNGAndCompareThreads(dib16, PNG_Z_BEST_SPEED, thread_count);
+	savePNGAndCompareThreads(rgba16, PNG_Z_BEST_SPEED, thread_count);
+	savePNGAndCompareThreads(mono, PNG_Z_BEST_SPEED, thread_count);
+	savePNGAndCompareThreads(miniswhite, PNG_Z_BEST_SPEED, thread_count);
+	savePNGAndCompareThreads(dib24, PNG_INTERLACED, thread_count);
+	savePNGAndCompareThreads(dib24, PNG_Z_NO_COMPRESSION, thread_count);
+
+	// the pixels survive the round trip
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FreeImage_SetThreadCount(thread_count);
+	BOOL bResult = FreeImage_SaveToMemory(FIF_PNG, dib32a, hmem, PNG_DEFAULT);
+	FreeImage_SetThreadCount(0);
+	assert(bResult == TRUE);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_PNG, hmem);
+	assert(loaded != NULL);
+	assert(hashBitmap(loaded) == hashBitmap(dib32a));
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+
+	FreeImage_Unload(miniswhite);
+	FreeImage_Unload(mono);
+	FreeImage_Unload(wide);
+	FreeImage_Unload(rgba16);
+	FreeImage_Unload(dib16);
+	FreeImage_Unload(palettized);
+	FreeImage_Unload(dib32a);
+	FreeImage_Unload(dib32);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+}
+
+/**
+Quantize an image with any number of threads, check that the results (pixels and palette) are the same and return one of them
+*/
+static FIBITMAP* quantizeAndCompareThreads(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize, int ReserveSize, RGBQUAD *ReservePalette, unsigned thread_count) {
+	FIBITMAP *result = NULL;
+	runAndCompareThreads([&]() {
+		FreeImage_Unload(result);
+		result = FreeImage_ColorQuantizeEx(dib, quantize, 256, ReserveSize, ReservePalette);
+		return hashBitmap(result);
+	}, thread_count);
+	return result;
+}
+
+void testParallelQuantize(unsigned thread_count) {
+	printf("testParallelQuantize ...\n");
+
+	// a 24-bit image with many colors
+	const unsigned width = 512;
+	const unsigned height = 384;
+	FIBITMAP *dib24 = FreeImage_Allocate(width, height, 24);
+	assert(dib24 != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib24, y);
+		for(unsigned x = 0; x < width; x++, bits += 3) {
+			bits[FI_RGBA_RED] = (BYTE)(x * 255 / width);
+			bits[FI_RGBA_GREEN] = (BYTE)(y * 255 / height);
+			bits[FI_RGBA_BLUE] = (BYTE)((x ^ y) >> 3);
+		}
+	}
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib24);
+	assert(dib32 != NULL);
+
+	RGBQUAD reserve[3] = { { 0, 0, 255, 0 }, { 255, 255, 255, 0 }, { 10, 20, 30, 0 } };
+
+	FIBITMAP *wu = quantizeAndCompareThreads(dib24, FIQ_WUQUANT, 0, NULL, thread_count);
+	assert(wu != NULL);
+
+	FIBITMAP *result = quantizeAndCompareThreads(dib32, FIQ_WUQUANT, 3, reserve, thread_count);
+	assert(result != NULL);
+	FreeImage_Unload(result);
+
+	result = quantizeAndCompareThreads(dib24, FIQ_NNQUANT, 3, reserve, thread_count);
+	assert(result != NULL);
+	FreeImage_Unload(result);
+
+	// too many colors for the LFP quantizer
+	result = quantizeAndCompareThreads(dib24, FIQ_LFPQUANT, 0, NULL, thread_count);
+	assert(result == NULL);
+
+	// the LFP quantizer is lossless when the palette is large enough
+	FIBITMAP *few = FreeImage_ColorQuantizeEx(dib24, FIQ_WUQUANT, 250);
+	FIBITMAP *few24 = FreeImage_ConvertTo24Bits(few);
+	FIBITMAP *few32 = FreeImage_ConvertTo32Bits(few);
+	assert(few && few24 && few32);
+	for(int k = 0; k < 2; k++) {
+		FIBITMAP *src = k ? few32 : few24;
+		const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+		result = quantizeAndCompareThreads(src, FIQ_LFPQUANT, k ? 3 : 0, reserve, thread_count);
+		assert(result != NULL);
+		const RGBQUAD *pal = FreeImage_GetPalette(result);
+		for(unsigned y = 0; y < height; y++) {
+			const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+			const BYTE *dst_bits = FreeImage_GetScanLine(result, y);
+			for(unsigned x = 0; x < width; x++, src_bits += bytespp) {
+				const RGBQUAD &color = pal[dst_bits[x]];
+				assert(color.rgbRed == src_bits[FI_RGBA_RED] && color.rgbGreen == src_bits[FI_RGBA_GREEN] && color.rgbBlue == src_bits[FI_RGBA_BLUE]);
+			}
+		}
+		if(k) {
+			// the reserved colors are at the end of the palette
+			assert(memcmp(pal + 253, reserve, sizeof(reserve)) == 0);
+		}
+		FreeImage_Unload(result);
+	}
+
+	FreeImage_Unload(few32);
+	FreeImage_Unload(few24);
+	FreeImage_Unload(few);
+	FreeImage_Unload(wu);
+	FreeImage_Unload(dib32);
+	FreeImage_Unload(dib24);
+}
+
+/**
+Rotate an image with any number of threads, check that the results are the same and return one of them
+*/
+static FIBITMAP* rotateAndCompareThreads(FIBITMAP *dib, double angle, unsigned thread_count) {
+	FIBITMAP *result = NULL;
+	runAndCompareThreads([&]() {
+		FreeImage_Unload(result);
+		result = FreeImage_Rotate(dib, angle, NULL);
+		assert(result != NULL);
+		return hashBitmap(result);
+	}, thread_count);
+	return result;
+}
+
+/**
+Check that a quarter turn moves every pixel where expected. In scanline coordinates 
+(row 0 at the bottom), the pixel (x, y) of src goes to (height - 1 - y, x) when 
+turning by 90 degrees (counter clockwise) and to (y, width - 1 - x) when turning by 270 degrees.
+*/
+static void checkQuarterTurn(FIBITMAP *src, FIBITMAP *dst, int angle) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	assert((FreeImage_GetWidth(dst) == height) && (FreeImage_GetHeight(dst) == width));
+	assert(FreeImage_GetImageType(dst) == FreeImage_GetImageType(src));
+	assert(FreeImage_GetBPP(dst) == FreeImage_GetBPP(src));
+
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++, src_bits += bytespp) {
+			const unsigned dst_x = (angle == 90) ? height - 1 - y : y;
+			const unsigned dst_y = (angle == 90) ? x : width - 1 - x;
+			const BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_y) + dst_x * bytespp;
+			assert(memcmp(dst_bits, src_bits, bytespp) == 0);
+		}
+	}
+}
+
+void testParallelRotate(unsigned thread_count) {
+	printf("testParallelRotate ...\n");
+
+	// odd sizes, so that the last blocks and the middle row are partial
+	const unsigned width = 1031;
+	const unsigned height = 517;
+	FIBITMAP *dib32 = FreeImage_Allocate(width, height, 32);
+	assert(dib32 != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib32, y);
+		for(unsigned x = 0; x < width; x++, bits += 4) {
+			bits[FI_RGBA_RED] = (BYTE)x;
+			bits[FI_RGBA_GREEN] = (BYTE)y;
+			bits[FI_RGBA_BLUE] = (BYTE)((x ^ y) >> 2);
+			bits[FI_RGBA_ALPHA] = (BYTE)(x + y);
+		}
+	}
+
+	FIBITMAP *images[] = {
+		FreeImage_ConvertToGreyscale(dib32),
+		FreeImage_ConvertTo24Bits(dib32),
+		FreeImage_Clone(dib32),
+		FreeImage_ConvertToType(dib32, FIT_RGBAF),
+		NULL
+	};
+	images[4] = FreeImage_ConvertToType(images[0], FIT_UINT16);
+
+	const double angles[] = { 90, 180, 270, 30, -45 };
+
+	for(int i = 0; i < 5; i++) {
+		FIBITMAP *dib = images[i];
+		assert(dib != NULL);
+		const unsigned long long hash = hashBitmap(dib);
+
+		for(int k = 0; k < 5; k++) {
+			FIBITMAP *rotated = rotateAndCompareThreads(dib, angles[k], thread_count);
+			if((angles[k] == 90) || (angles[k] == 270)) {
+				checkQuarterTurn(dib, rotated, (int)angles[k]);
+			}
+			FreeImage_Unload(rotated);
+		}
+
+		// four quarter turns give back the original image
+		FIBITMAP *rotated = FreeImage_Clone(dib);
+		for(int k = 0; k < 4; k++) {
+			FIBITMAP *next = FreeImage_Rotate(rotated, 90, NULL);
+			assert(next != NULL);
+			FreeImage_Unload(rotated);
+			rotated = next;
+		}
+		assert(hashBitmap(rotated) == hash);
+		FreeImage_Unload(rotated);
+
+		// a half turn is a horizontal flip followed by a vertical flip
+		FIBITMAP *flipped = FreeImage_Clone(dib);
+		FreeImage_SetThreadCount(thread_count);
+		BOOL bResult = FreeImage_FlipHorizontal(flipped) && FreeImage_FlipVertical(flipped);
+		assert(bResult == TRUE);
+		rotated = rotateAndCompareThreads(dib, 180, thread_count);
+		assert(hashBitmap(rotated) == hashBitmap(flipped));
+		FreeImage_Unload(rotated);
+
+		// flipping twice gives back the original image
+		bResult = FreeImage_FlipHorizontal(flipped) && FreeImage_FlipVertical(flipped);
+		assert(bResult == TRUE);
+		assert(hashBitmap(flipped) == hash);
+		FreeImage_Unload(flipped);
+		FreeImage_SetThreadCount(0);
+
+		FreeImage_Unload(dib);
+	}
+
+	FreeImage_Unload(dib32);
+}
+
+/**
+Load a TIFF image from memory using 1, 2 and thread_count threads, check that the results are the same 
+and return their hash
+*/
+static unsigned long long loadTIFFAndCompareThreads(FIMEMORY *hmem, unsigned thread_count) {
+	return runAndCompareThreads([hmem]() {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_TIFF, hmem);
+		const unsigned long long hash = hashBitmap(dib);
+		FreeImage_Unload(dib);
+		return hash;
+	}, thread_count);
+}
+
+/**
+Message handler used while decoding damaged files on purpose: the decoder warnings are expected, 
+they are counted instead of being printed
+*/
+static std::atomic<unsigned> s_expected_messages(0);
+
+static void expectedMessageHandler(FREE_IMAGE_FORMAT, const char *) {
+	s_expected_messages++;
+}
+
+void testParallelTIFF(unsigned thread_count) {
+	printf("testParallelTIFF ...\n");
+
+	// odd sizes, so that the last strip is partial
+	FIBITMAP *dib8 = createZonePlateImage(1031, 517, 64);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib24);
+	FIBITMAP *palettized = FreeImage_ColorQuantize(dib24, FIQ_WUQUANT);
+	FIBITMAP *mono = FreeImage_Threshold(dib8, 128);
+	FIBITMAP *dib16 = FreeImage_ConvertToType(dib8, FIT_UINT16);
+	FIBITMAP *rgb16 = FreeImage_ConvertToRGB16(dib24);
+	FIBITMAP *dibf = FreeImage_ConvertToType(dib8, FIT_FLOAT);
+	FIBITMAP *dib64 = FreeImage_ConvertToType(dib8, FIT_DOUBLE);
+	assert(dib8 && dib24 && dib32 && palettized && mono && dib16 && rgb16 && dibf && dib64);
+
+	FIBITMAP *images[] = { dib8, dib24, dib32, palettized, mono, dib16, rgb16, dibf, dib64 };
+	const int compressions[] = { TIFF_LZW, TIFF_DEFLATE, TIFF_ADOBE_DEFLATE, TIFF_PACKBITS };
+
+	for(size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+		for(size_t k = 0; k < sizeof(compressions) / sizeof(compressions[0]); k++) {
+			FIMEMORY *hmem = FreeImage_OpenMemory();
+			BOOL bResult = FreeImage_SaveToMemory(FIF_TIFF, images[i], hmem, compressions[k]);
+			assert(bResult == TRUE);
+
+			// the pixels survive the round trip
+			const unsigned long long hash = loadTIFFAndCompareThreads(hmem, thread_count);
+			assert(hash == hashBitmap(images[i]));
+
+			// damaged strips give the same result as a single-threaded decoding
+			BYTE *data = NULL;
+			DWORD size_in_bytes = 0;
+			bResult = FreeImage_AcquireMemory(hmem, &data, &size_in_bytes);
+			assert(bResult == TRUE);
+			for(DWORD pos = size_in_bytes / 4; pos < size_in_bytes / 2; pos += 997) {
+				data[pos] ^= 0x5A;
+			}
+			FreeImage_SetOutputMessage(expectedMessageHandler);
+			loadTIFFAndCompareThreads(hmem, thread_count);
+			FreeImage_SetOutputMessage(FreeImageErrorHandler);
+
+			FreeImage_CloseMemory(hmem);
+		}
+	}
+	printf("... %u decoder warnings about the damaged strips were expected and hidden\n", (unsigned)s_expected_messages);
+
+	for(size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+		FreeImage_Unload(images[i]);
+	}
+}
+
+/**
+Save an image as EXR into a new memory stream
+*/
+static FIMEMORY* saveEXR(FIBITMAP *dib, int flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	BOOL bResult = FreeImage_SaveToMemory(FIF_EXR, dib, hmem, flags);
+	assert(bResult == TRUE);
+	return hmem;
+}
+
+/**
+Save an image as EXR using 1, 2 and thread_count threads and check that the files are the same, 
+then check that the file decodes to the same image with 1, 2 and thread_count threads
+*/
+static void saveEXRAndCompareThreads(FIBITMAP *dib, int flags, unsigned thread_count) {
+	runAndCompareThreads([dib, flags]() {
+		FIMEMORY *hmem = saveEXR(dib, flags);
+		BYTE *data = NULL;
+		DWORD size_in_bytes = 0;
+		FreeImage_AcquireMemory(hmem, &data, &size_in_bytes);
+		const unsigned long long hash = hashBuffer(data, size_in_bytes);
+		FreeImage_CloseMemory(hmem);
+		return hash;
+	}, thread_count);
+
+	FIMEMORY *hmem = saveEXR(dib, flags);
+	runAndCompareThreads([hmem]() {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_EXR, hmem);
+		assert(loaded != NULL);
+		const unsigned long long hash = hashBitmap(loaded);
+		FreeImage_Unload(loaded);
+		return hash;
+	}, thread_count);
+	FreeImage_CloseMemory(hmem);
+}
+
+void testParallelEXR(unsigned thread_count) {
+	printf("testParallelEXR ...\n");
+
+	// even sizes, as needed by EXR_LC
+	FIBITMAP *dib8 = createZonePlateImage(1030, 518, 64);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib24);
+	FIBITMAP *dibf = FreeImage_ConvertToType(dib8, FIT_FLOAT);
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(dib24);
+	FIBITMAP *rgbaf = FreeImage_ConvertToRGBAF(dib32);
+	assert(dib8 && dib24 && dib32 && dibf && rgbf && rgbaf);
+
+	FIBITMAP *images[] = { dibf, rgbf, rgbaf };
+	const int flags[] = { EXR_DEFAULT, EXR_NONE, EXR_ZIP, EXR_PIZ, EXR_PXR24, EXR_B44, EXR_FLOAT | EXR_ZIP };
+
+	for(size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+		for(size_t k = 0; k < sizeof(flags) / sizeof(flags[0]); k++) {
+			saveEXRAndCompareThreads(images[i], flags[k], thread_count);
+		}
+	}
+	saveEXRAndCompareThreads(rgbf, EXR_LC, thread_count);
+	saveEXRAndCompareThreads(rgbf, EXR_LC | EXR_B44, thread_count);
+
+	// the pixels survive a lossless round trip
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FreeImage_SetThreadCount(thread_count);
+	BOOL bResult = FreeImage_SaveToMemory(FIF_EXR, rgbaf, hmem, EXR_FLOAT | EXR_ZIP);
+	assert(bResult == TRUE);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_EXR, hmem);
+	assert(loaded != NULL);
+	assert(hashBitmap(loaded) == hashBitmap(rgbaf));
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_SetThreadCount(0);
+
+	FreeImage_Unload(rgbaf);
+	FreeImage_Unload(rgbf);
+	FreeImage_Unload(dibf);
+	FreeImage_Unload(dib32);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+}
+
+// ----------------------------------------------------------
+
+/**
+Load a RAW image from memory using 1, 2 and thread_count threads, check that the results are the same 
+and return the image loaded using the default thread count
+*/
+static FIBITMAP* loadRAWAndCompareThreads(FIMEMORY *hmem, int flags, unsigned thread_count) {
+	const unsigned long long hash = runAndCompareThreads([hmem, flags]() {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_RAW, hmem, flags);
+		assert(dib != NULL);
+		const unsigned long long hash = hashBitmap(dib);
+		FreeImage_Unload(dib);
+		return hash;
+	}, thread_count);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_RAW, hmem, flags);
+	assert(hashBitmap(dib) == hash);
+
+	return dib;
+}
+
+void testParallelRAW(unsigned thread_count) {
+	printf("testParallelRAW ...\n");
+
+	// several AHD tiles across and down, odd sizes
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	createBayerDNG(hmem, 1234, 1102);
+
+	FIBITMAP *dib = loadRAWAndCompareThreads(hmem, RAW_DEFAULT, thread_count);
+	assert((FreeImage_GetImageType(dib) == FIT_RGB16) && (FreeImage_GetWidth(dib) == 1234) && (FreeImage_GetHeight(dib) == 1102));
+	FreeImage_Unload(dib);
+	dib = loadRAWAndCompareThreads(hmem, RAW_DISPLAY, thread_count);
+	assert((FreeImage_GetBPP(dib) == 24) && (FreeImage_GetWidth(dib) == 1234));
+	FreeImage_Unload(dib);
+	dib = loadRAWAndCompareThreads(hmem, RAW_HALFSIZE, thread_count);
+	assert((FreeImage_GetWidth(dib) == 617) && (FreeImage_GetHeight(dib) == 551));
+	FreeImage_Unload(dib);
+	FreeImage_CloseMemory(hmem);
+}
+
+// ----------------------------------------------------------
+
+/**
+Apply a LUT to the given bytes of each pixel, using plain loops
+*/
+static void referenceCurve(FIBITMAP *dib, const BYTE *LUT, const int *offsets, int count) {
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(dib); x++, bits += bytespp) {
+			for(int k = 0; k < count; k++) {
+				bits[offsets[k]] = LUT[bits[offsets[k]]];
+			}
+		}
+	}
+}
+
+/**
+Compute the histogram of a byte of each pixel (or of its grey level if offset is -1), using plain loops
+*/
+static void referenceHistogram(FIBITMAP *dib, DWORD *histo, int offset) {
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+	memset(histo, 0, 256 * sizeof(DWORD));
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(dib); x++, bits += bytespp) {
+			if(offset < 0) {
+				// Rec. 709 luma, as used by FreeImage
+				histo[(BYTE)(0.2126F * bits[FI_RGBA_RED] + 0.7152F * bits[FI_RGBA_GREEN] + 0.0722F * bits[FI_RGBA_BLUE] + 0.5F)]++;
+			} else {
+				histo[bits[offset]]++;
+			}
+		}
+	}
+}
+
+void testParallelColors(unsigned thread_count) {
+	printf("testParallelColors ...\n");
+
+	// odd sizes, so that the last words of the 8-bit rows are partial
+	const unsigned width = 1031;
+	const unsigned height = 517;
+	FIBITMAP *dib32 = FreeImage_Allocate(width, height, 32);
+	assert(dib32 != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib32, y);
+		for(unsigned x = 0; x < width; x++, bits += 4) {
+			bits[FI_RGBA_RED] = (BYTE)x;
+			bits[FI_RGBA_GREEN] = (BYTE)y;
+			bits[FI_RGBA_BLUE] = (BYTE)((x ^ y) >> 2);
+			bits[FI_RGBA_ALPHA] = (BYTE)(x + y);
+		}
+	}
+	FIBITMAP *dib8 = FreeImage_ConvertToGreyscale(dib32);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib32);
+	FIBITMAP *images[] = { dib8, dib24, dib32 };
+
+	BYTE LUT[256];
+	FreeImage_GetAdjustColorsLookupTable(LUT, 20, -15, 1.6, TRUE);
+
+	const FREE_IMAGE_COLOR_CHANNEL channels[] = { FICC_RGB, FICC_RED, FICC_GREEN, FICC_BLUE, FICC_ALPHA, FICC_BLACK };
+	const int rgb[] = { FI_RGBA_BLUE, FI_RGBA_GREEN, FI_RGBA_RED };
+	const int red[] = { FI_RGBA_RED }, green[] = { FI_RGBA_GREEN }, blue[] = { FI_RGBA_BLUE }, alpha[] = { FI_RGBA_ALPHA };
+	const int *offsets[] = { rgb, red, green, blue, alpha, NULL };
+	const int counts[] = { 3, 1, 1, 1, 1, 0 };
+
+	for(int i = 0; i < 3; i++) {
+		const unsigned bpp = FreeImage_GetBPP(images[i]);
+		for(int c = 0; c < 6; c++) {
+			// the curve matches plain loops for any number of threads
+			FIBITMAP *expected = FreeImage_Clone(images[i]);
+			if(bpp == 8) {
+				referenceCurve(expected, LUT, blue, 1);
+			} else if((channels[c] != FICC_ALPHA) || (bpp == 32)) {
+				referenceCurve(expected, LUT, offsets[c], counts[c]);
+			}
+			FIBITMAP *src = images[i];
+			const FREE_IMAGE_COLOR_CHANNEL channel = channels[c];
+			const unsigned long long hash = runAndCompareThreads([src, &LUT, channel]() {
+				FIBITMAP *dib = FreeImage_Clone(src);
+				BOOL bResult = FreeImage_AdjustCurve(dib, LUT, channel);
+				assert(bResult == TRUE);
+				const unsigned long long hash = hashBitmap(dib);
+				FreeImage_Unload(dib);
+				return hash;
+			}, thread_count);
+			assert(hash == hashBitmap(expected));
+			FreeImage_Unload(expected);
+
+			// so does the histogram
+			if((channels[c] == FICC_ALPHA) || ((bpp == 8) && (c > 0))) {
+				continue;
+			}
+			DWORD expected_histo[256];
+			referenceHistogram(images[i], expected_histo, (bpp == 8) ? 0 : ((offsets[c] && (counts[c] == 1)) ? offsets[c][0] : -1));
+			const unsigned long long histo_hash = runAndCompareThreads([src, channel]() {
+				DWORD histo[256];
+				BOOL bResult = FreeImage_GetHistogram(src, histo, channel);
+				assert(bResult == TRUE);
+				return hashBuffer(histo, sizeof(histo));
+			}, thread_count);
+			assert(histo_hash == hashBuffer(expected_histo, sizeof(expected_histo)));
+		}
+
+		// inverting twice gives back the original image
+		FreeImage_SetThreadCount(thread_count);
+		FIBITMAP *dib = FreeImage_Clone(images[i]);
+		FreeImage_Invert(dib);
+		const BYTE *bits = FreeImage_GetScanLine(dib, 1);
+		assert(bits[7] == (BYTE)~FreeImage_GetScanLine(images[i], 1)[7]);
+		FreeImage_Invert(dib);
+		assert(hashBitmap(dib) == hashBitmap(images[i]));
+		FreeImage_Unload(dib);
+	}
+	FreeImage_SetThreadCount(0);
+
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+	FreeImage_Unload(dib32);
+}
+
+// ----------------------------------------------------------
+
+/**
+Alpha blend src over dst at (left, top) using plain loops: constant alpha (0 to 255) for any 8-, 24- or 32-bit image, 
+per pixel premultiplied alpha (alpha == -1) or straight alpha (alpha == -2) for 32-bit images
+*/
+static void referenceBlend(FIBITMAP *dst, FIBITMAP *src, unsigned left, unsigned top, int alpha) {
+	const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+	const unsigned height = FreeImage_GetHeight(src);
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *s = FreeImage_GetScanLine(src, y);
+		BYTE *d = FreeImage_GetScanLine(dst, FreeImage_GetHeight(dst) - top - height + y) + left * bytespp;
+		for(unsigned x = 0; x < FreeImage_GetWidth(src); x++, s += bytespp, d += bytespp) {
+			if(alpha >= 0) {
+				for(unsigned c = 0; c < bytespp; c++) {
+					d[c] = (BYTE)(((s[c] - d[c]) * alpha + (d[c] << 8)) >> 8);
+				}
+			} else if(alpha == -1) {
+				for(unsigned c = 0; c < 4; c++) {
+					const int value = s[c] + (d[c] * (255 - s[FI_RGBA_ALPHA]) + 127) / 255;
+					d[c] = (BYTE)((value > 255) ? 255 : value);
+				}
+			} else if(s[FI_RGBA_ALPHA] != 0) {
+				const double sa = s[FI_RGBA_ALPHA] / 255.0;
+				const double w = (d[FI_RGBA_ALPHA] / 255.0) * (1 - sa);
+				for(unsigned c = 0; c < 3; c++) {
+					d[c] = (BYTE)floor((s[c] * sa + d[c] * w) / (sa + w) + 0.5);
+				}
+				d[FI_RGBA_ALPHA] = (BYTE)floor(255 * (sa + w) + 0.5);
+			}
+		}
+	}
+}
+
+/**
+Count the bytes of two images differing by more than tolerance
+*/
+static unsigned countDifferences(FIBITMAP *dib1, FIBITMAP *dib2, int tolerance) {
+	unsigned count = 0;
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		const BYTE *bits1 = FreeImage_GetScanLine(dib1, y);
+		const BYTE *bits2 = FreeImage_GetScanLine(dib2, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib1); x++) {
+			if(abs((int)bits1[x] - (int)bits2[x]) > tolerance) {
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+Blend RGBAF pixels of src over dst at (left, top) using plain loops, holding premultiplied or straight alpha
+*/
+static void referenceBlendF(FIBITMAP *dst, FIBITMAP *src, unsigned left, unsigned top, BOOL premultiplied) {
+	const unsigned height = FreeImage_GetHeight(src);
+	for(unsigned y = 0; y < height; y++) {
+		const FIRGBAF *s = (FIRGBAF*)FreeImage_GetScanLine(src, y);
+		FIRGBAF *d = (FIRGBAF*)FreeImage_GetScanLine(dst, FreeImage_GetHeight(dst) - top - height + y) + left;
+		for(unsigned x = 0; x < FreeImage_GetWidth(src); x++, s++, d++) {
+			if(premultiplied) {
+				const float inv = 1 - s->alpha;
+				d->red   = s->red   + d->red   * inv;
+				d->green = s->green + d->green * inv;
+				d->blue  = s->blue  + d->blue  * inv;
+				d->alpha = s->alpha + d->alpha * inv;
+			} else {
+				const float w = d->alpha * (1 - s->alpha);
+				const float alpha = s->alpha + w;
+				if(alpha > 0) {
+					d->red   = (s->red   * s->alpha + d->red   * w) / alpha;
+					d->green = (s->green * s->alpha + d->green * w) / alpha;
+					d->blue  = (s->blue  * s->alpha + d->blue  * w) / alpha;
+				} else {
+					d->red = d->green = d->blue = 0;
+				}
+				d->alpha = alpha;
+			}
+		}
+	}
+}
+
+void testParallelBlend(unsigned thread_count) {
+	printf("testParallelBlend ...\n");
+
+	// odd sizes and offsets, so that the vector loops leave a remainder
+	const unsigned width = 777, height = 333;
+	const unsigned left = 45, top = 31;
+	const unsigned bpps[] = { 8, 24, 32 };
+
+	for(int i = 0; i < 3; i++) {
+		FIBITMAP *src = createBlendImage(width, height, bpps[i], 3);
+		FIBITMAP *background = createBlendImage(width + 2 * left, height + 2 * top, bpps[i], 101);
+
+		// constant alpha blending and plain copy
+		const int alphas[] = { 0, 1, 77, 128, 255, 256 };
+		for(int a = 0; a < 6; a++) {
+			FIBITMAP *expected = FreeImage_Clone(background);
+			if(alphas[a] > 255) {
+				FreeImage_Paste(expected, src, left, top, 256);
+			} else {
+				referenceBlend(expected, src, left, top, alphas[a]);
+			}
+			const int alpha = alphas[a];
+			const unsigned long long hash = runAndCompareThreads([background, src, alpha]() {
+				FIBITMAP *dst = FreeImage_Clone(background);
+				BOOL bResult = FreeImage_Paste(dst, src, left, top, alpha);
+				assert(bResult == TRUE);
+				const unsigned long long hash = hashBitmap(dst);
+				FreeImage_Unload(dst);
+				return hash;
+			}, thread_count);
+			assert(hash == hashBitmap(expected));
+			FreeImage_Unload(expected);
+		}
+
+		// per pixel alpha
+		if(bpps[i] == 32) {
+			FIBITMAP *src_p = FreeImage_Clone(src);
+			FIBITMAP *background_p = FreeImage_Clone(background);
+			FreeImage_PreMultiplyWithAlpha(src_p);
+			FreeImage_PreMultiplyWithAlpha(background_p);
+
+			FIBITMAP *expected_p = FreeImage_Clone(background_p);
+			referenceBlend(expected_p, src_p, left, top, -1);
+			FIBITMAP *expected_s = FreeImage_Clone(background);
+			referenceBlend(expected_s, src, left, top, -2);
+
+			const unsigned long long hash_p = runAndCompareThreads([background_p, src_p]() {
+				FIBITMAP *dst = FreeImage_Clone(background_p);
+				BOOL bResult = FreeImage_PasteWithAlpha(dst, src_p, left, top, TRUE);
+				assert(bResult == TRUE);
+				const unsigned long long hash = hashBitmap(dst);
+				FreeImage_Unload(dst);
+				return hash;
+			}, thread_count);
+			assert(hash_p == hashBitmap(expected_p));
+
+			// integer rounding of the straight alpha blend differs at most by one from the exact value
+			runAndCompareThreads([background, src, expected_s]() {
+				FIBITMAP *dst = FreeImage_Clone(background);
+				BOOL bResult = FreeImage_PasteWithAlpha(dst, src, left, top, FALSE);
+				assert(bResult == TRUE);
+				assert(countDifferences(dst, expected_s, 1) == 0);
+				const unsigned long long hash = hashBitmap(dst);
+				FreeImage_Unload(dst);
+				return hash;
+			}, thread_count);
+			FreeImage_Unload(expected_s);
+			FreeImage_Unload(expected_p);
+
+			// premultiplication matches plain loops, and un-premultiplying is reversible
+			FIBITMAP *dib = FreeImage_Clone(src);
+			for(unsigned y = 0; y < height; y++) {
+				BYTE *bits = FreeImage_GetScanLine(dib, y);
+				for(unsigned x = 0; x < width; x++, bits += 4) {
+					for(int c = 0; c < 3; c++) {
+						bits[c] = (BYTE)((bits[FI_RGBA_ALPHA] * bits[c] + 127) / 255);
+					}
+				}
+			}
+			assert(hashBitmap(dib) == hashBitmap(src_p));
+			BOOL bResult = FreeImage_UnPreMultiplyWithAlpha(dib);
+			assert(bResult == TRUE);
+			FreeImage_PreMultiplyWithAlpha(dib);
+			assert(hashBitmap(dib) == hashBitmap(src_p));
+			FreeImage_Unload(dib);
+
+			// so does the composition over the checkerboard background
+			runAndCompareThreads([src]() {
+				FIBITMAP *composite = FreeImage_Composite(src, FALSE, NULL, NULL);
+				assert(composite != NULL);
+				const unsigned long long hash = hashBitmap(composite);
+				FreeImage_Unload(composite);
+				return hash;
+			}, thread_count);
+
+			// RGBAF images match plain loops for any number of threads
+			FIBITMAP *srcf = FreeImage_ConvertToRGBAF(src);
+			FIBITMAP *backgroundf = FreeImage_ConvertToRGBAF(background);
+			for(int p = 0; p < 2; p++) {
+				FIBITMAP *expectedf = FreeImage_Clone(backgroundf);
+				referenceBlendF(expectedf, srcf, left, top, p);
+				const BOOL premultiplied = p;
+				const unsigned long long hashf = runAndCompareThreads([backgroundf, srcf, premultiplied]() {
+					FIBITMAP *dstf = FreeImage_Clone(backgroundf);
+					BOOL bResult = FreeImage_PasteWithAlpha(dstf, srcf, left, top, premultiplied);
+					assert(bResult == TRUE);
+					const unsigned long long hash = hashBitmap(dstf);
+					FreeImage_Unload(dstf);
+					return hash;
+				}, thread_count);
+				assert(hashf == hashBitmap(expectedf));
+				// the blended alpha remains a unit value
+				const FIRGBAF *pixel = (FIRGBAF*)FreeImage_GetScanLine(expectedf, FreeImage_GetHeight(expectedf) / 2) + left + 1;
+				assert(pixel->alpha >= 0 && pixel->alpha <= 1);
+				FreeImage_Unload(expectedf);
+			}
+			FreeImage_Unload(backgroundf);
+			FreeImage_Unload(srcf);
+
+			FreeImage_Unload(background_p);
+			FreeImage_Unload(src_p);
+		}
+
+		FreeImage_Unload(background);
+		FreeImage_Unload(src);
+	}
+}
+
+// ----------------------------------------------------------
+
+/**
+Check a 1-bit image against the thresholding of a greyscale image, using plain loops
+*/
+static BOOL checkThreshold(FIBITMAP *dib1, FIBITMAP *dib8, BYTE T) {
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib8); y++) {
+		const BYTE *bits8 = FreeImage_GetScanLine(dib8, y);
+		const BYTE *bits1 = FreeImage_GetScanLine(dib1, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(dib8); x++) {
+			const BOOL bit = (bits1[x >> 3] & (0x80 >> (x & 0x7))) != 0;
+			if(bit != (bits8[x] >= T)) {
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+void testParallelDither(unsigned thread_count) {
+	printf("testParallelDither ...\n");
+
+	// odd sizes, so that the rows end with partial bytes
+	const unsigned width = 1031;
+	const unsigned height = 517;
+	FIBITMAP *dib8 = FreeImage_Allocate(width, height, 8);
+	assert(dib8 != NULL);
+	RGBQUAD *pal = FreeImage_GetPalette(dib8);
+	for(int i = 0; i < 256; i++) {
+		pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
+	}
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib8, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[x] = (BYTE)((x * 7 + y * 13) ^ ((x * y) >> 3));
+		}
+	}
+
+	// the thresholding matches plain loops
+	const BYTE thresholds[] = { 0, 1, 100, 128, 255 };
+	for(int i = 0; i < 5; i++) {
+		const BYTE T = thresholds[i];
+		runAndCompareThreads([dib8, T]() {
+			FIBITMAP *dib1 = FreeImage_Threshold(dib8, T);
+			assert((dib1 != NULL) && (FreeImage_GetBPP(dib1) == 1));
+			assert(checkThreshold(dib1, dib8, T));
+			const unsigned long long hash = hashBitmap(dib1);
+			FreeImage_Unload(dib1);
+			return hash;
+		}, thread_count);
+	}
+
+	// the dithering gives the same result for any number of threads
+	const FREE_IMAGE_DITHER algorithms[] = { FID_FS, FID_BAYER4x4, FID_BAYER8x8, FID_BAYER16x16, FID_CLUSTER6x6, FID_CLUSTER8x8, FID_CLUSTER16x16 };
+	for(int i = 0; i < 7; i++) {
+		const FREE_IMAGE_DITHER algorithm = algorithms[i];
+		runAndCompareThreads([dib8, algorithm]() {
+			FIBITMAP *dib1 = FreeImage_Dither(dib8, algorithm);
+			assert((dib1 != NULL) && (FreeImage_GetBPP(dib1) == 1));
+			const unsigned long long hash = hashBitmap(dib1);
+			FreeImage_Unload(dib1);
+			return hash;
+		}, thread_count);
+	}
+
+	// a flat mid-grey gives a balanced pattern
+	FIBITMAP *grey = FreeImage_Allocate(256, 256, 8);
+	for(unsigned y = 0; y < 256; y++) {
+		memset(FreeImage_GetScanLine(grey, y), 128, 256);
+	}
+	for(int i = 0; i < 7; i++) {
+		FreeImage_SetThreadCount(thread_count);
+		FIBITMAP *dib1 = FreeImage_Dither(grey, algorithms[i]);
+		unsigned white = 0;
+		for(unsigned y = 0; y < 256; y++) {
+			const BYTE *bits = FreeImage_GetScanLine(dib1, y);
+			for(unsigned x = 0; x < 256; x++) {
+				white += (bits[x >> 3] >> (7 - (x & 0x7))) & 1;
+			}
+		}
+		assert((white > 256 * 256 * 2 / 5) && (white < 256 * 256 * 3 / 5));
+		FreeImage_Unload(dib1);
+	}
+	FreeImage_Unload(grey);
+	FreeImage_SetThreadCount(0);
+
+	FreeImage_Unload(dib8);
+}
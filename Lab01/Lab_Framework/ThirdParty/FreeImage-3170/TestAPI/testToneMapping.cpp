@@ -0,0 +1,177 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <math.h>
+#include <string.h>
+
+// ----------------------------------------------------------
+
+/**
+Largest difference between the samples of two 24-bit images
+*/
+static int maxDifference(FIBITMAP *dib1, FIBITMAP *dib2) {
+	assert(FreeImage_GetWidth(dib1) == FreeImage_GetWidth(dib2));
+	assert(FreeImage_GetHeight(dib1) == FreeImage_GetHeight(dib2));
+
+	int max_diff = 0;
+	const unsigned line = FreeImage_GetLine(dib1);
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		const BYTE *bits1 = FreeImage_GetScanLine(dib1, y);
+		const BYTE *bits2 = FreeImage_GetScanLine(dib2, y);
+		for(unsigned x = 0; x < line; x++) {
+			const int diff = abs((int)bits1[x] - (int)bits2[x]);
+			max_diff = (diff > max_diff) ? diff : max_diff;
+		}
+	}
+	return max_diff;
+}
+
+/**
+Apply an operator with or without the fast math
+*/
+static FIBITMAP* applyOperator(FIBITMAP *src, int tmo, BOOL fast_math) {
+	FreeImage_SetToneMappingFastMath(fast_math);
+	assert(FreeImage_GetToneMappingFastMath() == fast_math);
+
+	FIBITMAP *dst = NULL;
+	switch(tmo) {
+		case FITMO_DRAGO03:
+			dst = FreeImage_TmoDrago03(src, 2.2, 0);
+			break;
+		case FITMO_REINHARD05:
+			dst = FreeImage_TmoReinhard05(src, 0, 0);
+			break;
+		case FITMO_FATTAL02:
+			dst = FreeImage_TmoFattal02(src, 0.5, 0.85);
+			break;
+		default:
+			// local adaptation and color correction
+			dst = FreeImage_TmoReinhard05Ex(src, 0, 0, 0.5, 0.5);
+			break;
+	}
+
+	assert(dst != NULL);
+	assert(FreeImage_GetBPP(dst) == 24);
+	return dst;
+}
+
+// ----------------------------------------------------------
+
+/**
+The exact math gives the same image whatever the number of threads,
+the fast math stays within one level of it
+*/
+void testToneMapping(unsigned width, unsigned height, unsigned thread_count) {
+	const int operators[] = { FITMO_DRAGO03, FITMO_REINHARD05, -1, FITMO_FATTAL02 };
+
+	printf("testToneMapping (%d threads) ...\n", thread_count);
+
+	FIBITMAP *src = createHDRImage(width, height);
+	assert(src != NULL);
+
+	for(int i = 0; i < 4; i++) {
+		const int tmo = operators[i];
+
+		FIBITMAP *exact = NULL;
+		runAndCompareThreads([&]() {
+			FreeImage_Unload(exact);
+			exact = applyOperator(src, tmo, FALSE);
+			return hashBitmap(exact);
+		}, thread_count);
+
+		FreeImage_SetThreadCount(thread_count);
+		FIBITMAP *fast = applyOperator(src, tmo, TRUE);
+		FreeImage_SetThreadCount(0);
+
+		assert(maxDifference(exact, fast) <= 1);
+
+		FreeImage_Unload(fast);
+		FreeImage_Unload(exact);
+	}
+
+	FreeImage_Unload(src);
+
+	FreeImage_SetToneMappingFastMath(FALSE);
+}
+
+/**
+Solve the Poisson equation for the Laplacian of a known function, 
+then tone map a larger image with the gradient domain operator
+*/
+void testMultigridPoissonSolver(unsigned thread_count) {
+	printf("testMultigridPoissonSolver (%d threads) ...\n", thread_count);
+
+	// u(x, y) = sin(pi.x / N).sin(pi.y / N) is null on the border of the (N + 1)x(N + 1) grid 
+	// used by the solver, and its discrete Laplacian is -2.(2 - 2.cos(pi / N)).u(x, y)
+	const int N = 256;
+	const double PI = 3.14159265358979323846;
+	const double eigenvalue = -2 * (2 - 2 * cos(PI / N));
+
+	FIBITMAP *laplacian = FreeImage_AllocateT(FIT_FLOAT, N - 1, N - 1);
+	FIBITMAP *expected = FreeImage_AllocateT(FIT_FLOAT, N - 1, N - 1);
+	assert(laplacian && expected);
+	for(int y = 0; y < N - 1; y++) {
+		float *lap = (float*)FreeImage_GetScanLine(laplacian, y);
+		float *u = (float*)FreeImage_GetScanLine(expected, y);
+		for(int x = 0; x < N - 1; x++) {
+			u[x] = (float)(sin(PI * (x + 1) / N) * sin(PI * (y + 1) / N));
+			lap[x] = (float)(eigenvalue * u[x]);
+		}
+	}
+
+	FIBITMAP *solution = NULL;
+	runAndCompareThreads([&]() {
+		FreeImage_Unload(solution);
+		solution = FreeImage_MultigridPoissonSolver(laplacian, 3);
+		return hashBitmap(solution);
+	}, thread_count);
+	assert(solution != NULL);
+
+	// the solution is remapped to [0..1], as is u up to the border values
+	float max_error = 0;
+	for(int y = 0; y < N - 1; y++) {
+		const float *u = (float*)FreeImage_GetScanLine(expected, y);
+		const float *s = (float*)FreeImage_GetScanLine(solution, y);
+		for(int x = 0; x < N - 1; x++) {
+			const float error = (float)fabs(s[x] - u[x]);
+			max_error = (error > max_error) ? error : max_error;
+		}
+	}
+	assert(max_error < 0.01F);
+
+	FreeImage_Unload(solution);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(laplacian);
+
+	// gradient domain tone mapping of an image whose sides are not powers of two
+	FIBITMAP *src = createHDRImage(600, 300);
+	assert(src != NULL);
+
+	runAndCompareThreads([src]() {
+		FIBITMAP *dst = FreeImage_TmoFattal02(src, 0.5, 0.85);
+		assert(dst != NULL);
+		const unsigned long long hash = hashBitmap(dst);
+		FreeImage_Unload(dst);
+		return hash;
+	}, thread_count);
+
+	FreeImage_Unload(src);
+}
@@ -22,6 +22,14 @@
 
 #include "TestSuite.h"
 
+#include <string.h>
+
+#if (defined(WIN32) || defined(__WIN32__))
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
 
 // ----------------------------------------------------------
 
@@ -80,3 +88,232 @@ FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale) {
 	return dst;
 }
 
+/**
+Create a RGBF image whose luminance spans 7 decades from left to right,
+with a different pattern on each channel
+*/
+FIBITMAP* createHDRImage(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	if(!dib) return NULL;
+
+	for(unsigned y = 0; y < height; y++) {
+		FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++) {
+			const double L = pow(10.0, -3.0 + 7.0 * x / width);
+			const double phase = (double)(x * x + y * y) / (width + height);
+			pixel[x].red   = (float)(L * (0.55 + 0.45 * sin(phase)));
+			pixel[x].green = (float)(L * (0.55 + 0.45 * sin(phase + 2.1)));
+			pixel[x].blue  = (float)(L * (0.55 + 0.45 * sin(phase + 4.2)));
+		}
+	}
+
+	return dib;
+}
+
+/**
+Build a little-endian DNG holding an uncompressed 12-bit RGGB Bayer image of a colored zone plate
+*/
+void createBayerDNG(FIMEMORY *hmem, unsigned width, unsigned height) {
+	struct Entry { WORD tag; WORD type; DWORD count; DWORD value; };
+	const char make[] = "FreeImage";
+	const char model[] = "FreeImage TestAPI";
+	// XYZ to camera matrix (sRGB primaries) and as-shot white balance
+	const int color_matrix[9] = { 32406, -15372, -4986, -9689, 18758, 415, 557, -2040, 10570 };
+	const DWORD neutral[3] = { 2, 1, 3 };
+
+	const WORD entry_count = 20;
+	const DWORD make_offset = 8 + 2 + entry_count * 12 + 4;
+	const DWORD model_offset = make_offset + sizeof(make);
+	const DWORD matrix_offset = model_offset + sizeof(model);
+	const DWORD neutral_offset = matrix_offset + 9 * 8;
+	const DWORD strip_offset = neutral_offset + 3 * 8;
+	const BYTE cfa_pattern[4] = { 0, 1, 1, 2 };
+	const BYTE dng_version[4] = { 1, 4, 0, 0 };
+	DWORD cfa_value, version_value;
+	memcpy(&cfa_value, cfa_pattern, 4);
+	memcpy(&version_value, dng_version, 4);
+
+	const Entry entries[entry_count] = {
+		{ 254, 4, 1, 0 },							// NewSubfileType
+		{ 256, 4, 1, width },						// ImageWidth
+		{ 257, 4, 1, height },						// ImageLength
+		{ 258, 3, 1, 16 },							// BitsPerSample
+		{ 259, 3, 1, 1 },							// Compression
+		{ 262, 3, 1, 32803 },						// PhotometricInterpretation (CFA)
+		{ 271, 2, sizeof(make), make_offset },		// Make
+		{ 272, 2, sizeof(model), model_offset },	// Model
+		{ 273, 4, 1, strip_offset },				// StripOffsets
+		{ 277, 3, 1, 1 },							// SamplesPerPixel
+		{ 278, 4, 1, height },						// RowsPerStrip
+		{ 279, 4, 1, width * height * 2 },			// StripByteCounts
+		{ 284, 3, 1, 1 },							// PlanarConfiguration
+		{ 33421, 3, 2, 2 | (2 << 16) },				// CFARepeatPatternDim
+		{ 33422, 1, 4, cfa_value },					// CFAPattern
+		{ 50706, 1, 4, version_value },				// DNGVersion
+		{ 50708, 2, sizeof(model), model_offset },	// UniqueCameraModel
+		{ 50717, 3, 1, 4095 },						// WhiteLevel
+		{ 50721, 10, 9, matrix_offset },			// ColorMatrix1
+		{ 50728, 5, 3, neutral_offset },			// AsShotNeutral
+	};
+	const BYTE header[8] = { 'I', 'I', 42, 0, 8, 0, 0, 0 };
+	FreeImage_WriteMemory(header, 8, 1, hmem);
+	FreeImage_WriteMemory(&entry_count, 2, 1, hmem);
+	for(WORD i = 0; i < entry_count; i++) {
+		const Entry& entry = entries[i];
+		FreeImage_WriteMemory(&entry.tag, 2, 1, hmem);
+		FreeImage_WriteMemory(&entry.type, 2, 1, hmem);
+		FreeImage_WriteMemory(&entry.count, 4, 1, hmem);
+		FreeImage_WriteMemory(&entry.value, 4, 1, hmem);
+	}
+	const DWORD next_ifd = 0;
+	FreeImage_WriteMemory(&next_ifd, 4, 1, hmem);
+	FreeImage_WriteMemory(make, sizeof(make), 1, hmem);
+	FreeImage_WriteMemory(model, sizeof(model), 1, hmem);
+	for(int i = 0; i < 9; i++) {
+		const int rational[2] = { color_matrix[i], 10000 };
+		FreeImage_WriteMemory(rational, 8, 1, hmem);
+	}
+	for(int i = 0; i < 3; i++) {
+		const DWORD rational[2] = { neutral[i], 3 };
+		FreeImage_WriteMemory(rational, 8, 1, hmem);
+	}
+
+	// RGGB mosaic of a zone plate with a horizontal and a vertical color ramp
+	std::vector<WORD> row(width);
+	for(unsigned y = 0; y < height; y++) {
+		for(unsigned x = 0; x < width; x++) {
+			const double dx = (double)x - width / 2;
+			const double dy = (double)y - height / 2;
+			double value;
+			switch(((y & 1) << 1) | (x & 1)) {
+				case 0:
+					value = 0.5 + 0.4 * cos((dx * dx + dy * dy) / 400.0) * x / width;
+					break;
+				case 3:
+					value = 0.5 + 0.4 * cos((dx * dx + dy * dy) / 400.0) * y / height;
+					break;
+				default:
+					value = 0.5 + 0.45 * cos((dx * dx + dy * dy) / 400.0);
+					break;
+			}
+			row[x] = (WORD)(value * 4095);
+		}
+		FreeImage_WriteMemory(&row[0], 2, width, hmem);
+	}
+}
+
+/**
+Create an image filled with a byte pattern, with a greyscale palette for 8-bit images
+*/
+FIBITMAP* createBlendImage(unsigned width, unsigned height, unsigned bpp, unsigned seed) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			bits[x] = (BYTE)((x * 7 + y * 13 + seed) ^ (x * y));
+		}
+	}
+	if(bpp == 8) {
+		RGBQUAD *pal = FreeImage_GetPalette(dib);
+		for(int i = 0; i < 256; i++) {
+			pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
+		}
+	}
+	return dib;
+}
+
+/**
+List the files of a directory
+*/
+std::vector<std::string> listFiles(const char *lpszDirectory) {
+	std::vector<std::string> files;
+
+#if (defined(WIN32) || defined(__WIN32__))
+	std::string pattern = std::string(lpszDirectory) + "/*.*";
+	_finddata_t find_data;
+	intptr_t find_handle = _findfirst(pattern.c_str(), &find_data);
+	if(find_handle != -1) {
+		do {
+			if((find_data.attrib & _A_SUBDIR) == 0) {
+				files.push_back(std::string(lpszDirectory) + "/" + find_data.name);
+			}
+		} while(_findnext(find_handle, &find_data) == 0);
+		_findclose(find_handle);
+	}
+#else
+	DIR *dir = opendir(lpszDirectory);
+	if(dir) {
+		struct dirent *entry;
+		while((entry = readdir(dir)) != NULL) {
+			if(entry->d_name[0] != '.') {
+				files.push_back(std::string(lpszDirectory) + "/" + entry->d_name);
+			}
+		}
+		closedir(dir);
+	}
+#endif
+
+	return files;
+}
+
+/**
+Compute a FNV-1a hash of a buffer, continuing from a previous hash
+*/
+unsigned long long hashBuffer(const void *data, size_t size, unsigned long long hash) {
+	const BYTE *bytes = (const BYTE*)data;
+	for(size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+Compute a FNV-1a hash of the image size, format, palette and pixels, returns 0 for a NULL image
+*/
+unsigned long long hashBitmap(FIBITMAP *dib) {
+	if(!dib) {
+		return 0;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned header[4] = { width, height, FreeImage_GetBPP(dib), (unsigned)FreeImage_GetImageType(dib) };
+	unsigned long long hash = hashBuffer(header, sizeof(header));
+
+	if(FreeImage_GetPalette(dib)) {
+		hash = hashBuffer(FreeImage_GetPalette(dib), FreeImage_GetColorsUsed(dib) * sizeof(RGBQUAD), hash);
+	}
+	if(FreeImage_HasPixels(dib)) {
+		const unsigned line = FreeImage_GetLine(dib);
+		for(unsigned y = 0; y < height; y++) {
+			hash = hashBuffer(FreeImage_GetScanLine(dib, y), line, hash);
+		}
+	}
+
+	return hash;
+}
+
+/**
+Run a computation with 1, 2 and thread_count worker threads (see FreeImage_SetThreadCount)
+and check that every run gives the same result. The default thread count is restored afterwards.
+@param run Computation, returns a hash of its result (e.g. using hashBitmap)
+@param thread_count Largest number of threads
+@return Returns the hash of the result
+*/
+unsigned long long runAndCompareThreads(const std::function<unsigned long long()>& run, unsigned thread_count) {
+	const unsigned counts[3] = { 1, 2, thread_count };
+
+	FreeImage_SetThreadCount(1);
+	const unsigned long long reference = run();
+	for(int i = 1; i < 3; i++) {
+		if(counts[i] > counts[i - 1]) {
+			FreeImage_SetThreadCount(counts[i]);
+			const unsigned long long hash = run();
+			assert(hash == reference);
+		}
+	}
+	FreeImage_SetThreadCount(0);
+
+	return reference;
+}
@@ -22,6 +22,8 @@
 
 #include "TestSuite.h"
 
+#include <cstring>
+
 // Local test functions
 // ----------------------------------------------------------
 
@@ -76,6 +78,97 @@ static void testViewport(FIBITMAP *dib) {
 	FreeImage_Unload(src);
 }
 
+/**
+Returns TRUE if two images of the same format have the same pixels
+*/
+static BOOL samePixels(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if(!dib1 || !dib2 || (FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2))) {
+		return FALSE;
+	}
+	const unsigned line = FreeImage_GetLine(dib1);
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), line) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static void testRescaleIntoView(FIBITMAP *dib) {
+	const int tile = 128;
+
+	// reference result
+	FIBITMAP *reference = FreeImage_Rescale(dib, tile, tile, FILTER_BILINEAR);
+	assert(reference != NULL);
+
+	// scale into the second tile of an atlas (no copy)
+	FIBITMAP *atlas = FreeImage_AllocateT(FreeImage_GetImageType(dib), 2 * tile, tile, FreeImage_GetBPP(dib));
+	assert(atlas != NULL);
+	FIBITMAP *view = FreeImage_CreateView(atlas, tile, 0, 2 * tile, tile);
+	assert(view != NULL);
+	BOOL bResult = FreeImage_RescaleInto(view, dib, FILTER_BILINEAR, FI_RESCALE_OMIT_METADATA);
+	assert(bResult == TRUE);
+	assert(samePixels(view, reference));
+
+	// views are accepted as inputs as well
+	FIBITMAP *grey_view = FreeImage_ConvertToGreyscale(view);
+	FIBITMAP *grey_reference = FreeImage_ConvertToGreyscale(reference);
+	assert(samePixels(grey_view, grey_reference));
+
+	// a destination with another pixel format is rejected
+	FIBITMAP *other = FreeImage_AllocateT(FIT_RGBF, tile, tile);
+	bResult = FreeImage_RescaleInto(other, dib, FILTER_BILINEAR);
+	assert(bResult == FALSE);
+
+	FreeImage_Unload(other);
+	FreeImage_Unload(grey_reference);
+	FreeImage_Unload(grey_view);
+	FreeImage_Unload(view);
+	FreeImage_Unload(atlas);
+	FreeImage_Unload(reference);
+}
+
+static void testMappedBitmap(FIBITMAP *dib) {
+	const char *lpszPathName = "mapped.raw";
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	const int size = 96;
+	// any offset may be used, e.g. to skip a file header
+	const UINT64 offset = 100;
+
+	remove(lpszPathName);
+
+	FIBITMAP *reference = FreeImage_Rescale(dib, size, size, FILTER_BOX);
+	assert(reference != NULL);
+
+	// scale into a new file backed bitmap
+	FIBITMAP *mapped = FreeImage_MapRawFile(lpszPathName, offset, 0, FALSE, type, size, size, bpp);
+	assert(mapped != NULL);
+	BOOL bResult = FreeImage_RescaleInto(mapped, dib, FILTER_BOX, FI_RESCALE_OMIT_METADATA);
+	assert(bResult == TRUE);
+	FreeImage_Unload(mapped);
+
+	// map the file again, read-only
+	mapped = FreeImage_MapRawFile(lpszPathName, offset, 0, TRUE, type, size, size, bpp);
+	assert(mapped != NULL);
+	assert(samePixels(mapped, reference));
+
+	// clones own their pixels
+	FIBITMAP *clone = FreeImage_Clone(mapped);
+	assert(clone != NULL);
+	FreeImage_Unload(mapped);
+	assert(samePixels(clone, reference));
+
+	// a read-only mapping cannot be larger than the file
+	FIBITMAP *oversized = FreeImage_MapRawFile(lpszPathName, offset, 0, TRUE, type, size, 2 * size, bpp);
+	assert(oversized == NULL);
+
+	FreeImage_Unload(clone);
+	FreeImage_Unload(reference);
+
+	remove(lpszPathName);
+}
+
 // Main test functions
 // ----------------------------------------------------------
 
@@ -108,6 +201,11 @@ void testWrappedBuffer(const char *lpszPathName, int flags) {
 	// test another use-case : viewport
 	testViewport(dib);
 
+	// test views and file backed bitmaps as rescaling outputs
+	testRescaleIntoView(dib);
+
+	testMappedBitmap(dib);
+
 	// unload the user provided buffer
 	// -------------------------------
 	FreeImage_Unload(dib);
@@ -0,0 +1,202 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <string.h>
+
+// ----------------------------------------------------------
+
+static unsigned s_store_calls = 0;
+
+/**
+Test backend: the 'compressed' buffer is the source size followed by the source
+*/
+static DWORD DLL_CALLCONV
+storeCompress(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size, int /*level*/) {
+	s_store_calls++;
+	if(target_size < source_size + 4) {
+		return 0;
+	}
+	memcpy(target, &source_size, 4);
+	memcpy(target + 4, source, source_size);
+	return source_size + 4;
+}
+
+static DWORD DLL_CALLCONV
+storeUncompress(BYTE *target, DWORD target_size, const BYTE *source, DWORD source_size) {
+	s_store_calls++;
+	DWORD size = 0;
+	if(source_size < 4) {
+		return 0;
+	}
+	memcpy(&size, source, 4);
+	if((size > target_size) || (size + 4 != source_size)) {
+		return 0;
+	}
+	memcpy(target, source + 4, size);
+	return size;
+}
+
+static DWORD DLL_CALLCONV
+storeCRC32(DWORD crc, const BYTE * /*source*/, DWORD source_size) {
+	s_store_calls++;
+	return crc + source_size;
+}
+
+/**
+Compress and uncompress a buffer at each level, then with the GZIP layout
+*/
+static void testZLibRoundTrip(BYTE *source, DWORD source_size) {
+	// 0.1% larger than source_size plus 24 bytes
+	const DWORD target_size = source_size + source_size / 1000 + 24;
+	BYTE *compressed = (BYTE*)malloc(target_size);
+	BYTE *uncompressed = (BYTE*)malloc(source_size);
+	assert(compressed && uncompressed);
+
+	for(int level = 0; level <= 9; level++) {
+		DWORD size = FreeImage_ZLibCompressLevel(compressed, target_size, source, source_size, level);
+		assert(size > 0);
+		memset(uncompressed, 0, source_size);
+		size = FreeImage_ZLibUncompress(uncompressed, source_size, compressed, size);
+		assert(size == source_size);
+		assert(memcmp(uncompressed, source, source_size) == 0);
+	}
+
+	DWORD size = FreeImage_ZLibGZip(compressed, target_size, source, source_size);
+	assert(size > 0);
+	memset(uncompressed, 0, source_size);
+	DWORD unzipped = FreeImage_ZLibGUnzip(uncompressed, source_size, compressed, size);
+	assert(unzipped == source_size);
+	assert(memcmp(uncompressed, source, source_size) == 0);
+
+	// the GZIP trailer holds the crc and the size of the source
+	DWORD crc = FreeImage_ZLibCRC32(0, source, source_size);
+	assert(memcmp(compressed + size - 8, &crc, 4) == 0);
+	assert(memcmp(compressed + size - 4, &source_size, 4) == 0);
+
+	free(uncompressed);
+	free(compressed);
+}
+
+/**
+The built-in backends write standard ZLib streams: each one decodes the streams of the other, 
+and both compute the same CRC-32 whatever the alignment and the size of the buffer
+*/
+static void testZLibBackends(BYTE *source, DWORD source_size) {
+	const FIDEFLATEBACKEND *fastdeflate = FreeImage_FindDeflateBackend("fastdeflate");
+	const FIDEFLATEBACKEND *zlib = FreeImage_FindDeflateBackend("zlib");
+	assert(fastdeflate && zlib);
+	assert(FreeImage_FindDeflateBackend("unknown") == NULL);
+	assert(FreeImage_FindDeflateBackend(NULL) == NULL);
+
+	const DWORD target_size = source_size + source_size / 1000 + 12;
+	BYTE *compressed = (BYTE*)malloc(target_size);
+	BYTE *uncompressed = (BYTE*)malloc(source_size);
+	assert(compressed && uncompressed);
+
+	const FIDEFLATEBACKEND *backends[2] = { fastdeflate, zlib };
+	for(int encoder = 0; encoder < 2; encoder++) {
+		for(int level = 0; level <= 9; level++) {
+			const DWORD size = backends[encoder]->compress_proc(compressed, target_size, source, source_size, level);
+			assert(size > 0);
+			const DWORD unpacked = backends[1 - encoder]->uncompress_proc(uncompressed, source_size, compressed, size);
+			assert(unpacked == source_size);
+			assert(memcmp(uncompressed, source, source_size) == 0);
+		}
+	}
+
+	for(DWORD offset = 0; offset < 16; offset++) {
+		for(DWORD length = 0; length + offset <= 1024; length += 1 + length / 4) {
+			assert(fastdeflate->crc32_proc(0, source + offset, length) == zlib->crc32_proc(0, source + offset, length));
+		}
+	}
+	assert(fastdeflate->crc32_proc(0, source, source_size) == zlib->crc32_proc(0, source, source_size));
+
+	free(uncompressed);
+	free(compressed);
+}
+
+// ----------------------------------------------------------
+
+void testZLib() {
+	printf("testZLib ...\n");
+
+	// CRC-32 check value, computed at once and as a running crc
+	BYTE check[] = "123456789";
+	assert(FreeImage_ZLibCRC32(0, NULL, 0) == 0);
+	assert(FreeImage_ZLibCRC32(0, check, 9) == 0xCBF43926);
+	assert(FreeImage_ZLibCRC32(FreeImage_ZLibCRC32(0, check, 4), check + 4, 5) == 0xCBF43926);
+
+	FIBITMAP *dib = createZonePlateImage(512, 512, 128);
+	assert(dib != NULL);
+	BYTE *bits = FreeImage_GetBits(dib);
+	const DWORD size = FreeImage_GetPitch(dib) * FreeImage_GetHeight(dib);
+
+	testZLibRoundTrip(bits, size);
+	testZLibBackends(bits, size);
+
+	// a user defined backend replaces the built-in one
+	const char *name = FreeImage_GetDeflateBackend();
+	assert(strcmp(name, "fastdeflate") == 0);
+
+	FIDEFLATEBACKEND incomplete = { "incomplete", storeCompress, NULL, storeCRC32 };
+	BOOL bResult = FreeImage_SetDeflateBackend(&incomplete);
+	assert(bResult == FALSE);
+	assert(strcmp(FreeImage_GetDeflateBackend(), name) == 0);
+
+	FIDEFLATEBACKEND backend = { "store", storeCompress, storeUncompress, storeCRC32 };
+	bResult = FreeImage_SetDeflateBackend(&backend);
+	assert(bResult == TRUE);
+	assert(strcmp(FreeImage_GetDeflateBackend(), "store") == 0);
+
+	BYTE *compressed = (BYTE*)malloc(size + 4);
+	BYTE *uncompressed = (BYTE*)malloc(size);
+	DWORD packed = FreeImage_ZLibCompress(compressed, size + 4, bits, size);
+	assert(packed == size + 4);
+	DWORD unpacked = FreeImage_ZLibUncompress(uncompressed, size, compressed, packed);
+	assert(unpacked == size);
+	assert(memcmp(uncompressed, bits, size) == 0);
+	DWORD crc = FreeImage_ZLibCRC32(1, bits, size);
+	assert(crc == size + 1);
+	assert(s_store_calls == 3);
+	free(uncompressed);
+	free(compressed);
+
+	// selecting the same backend again reuses its copy
+	bResult = FreeImage_SetDeflateBackend(FreeImage_FindDeflateBackend("zlib"));
+	assert(bResult == TRUE);
+	bResult = FreeImage_SetDeflateBackend(&backend);
+	assert(bResult == TRUE);
+	assert(strcmp(FreeImage_GetDeflateBackend(), "store") == 0);
+
+	// the bundled ZLib is still available
+	bResult = FreeImage_SetDeflateBackend(FreeImage_FindDeflateBackend("zlib"));
+	assert(bResult == TRUE);
+	assert(strcmp(FreeImage_GetDeflateBackend(), "zlib") == 0);
+	testZLibRoundTrip(bits, size);
+
+	bResult = FreeImage_SetDeflateBackend(NULL);
+	assert(bResult == TRUE);
+	assert(strcmp(FreeImage_GetDeflateBackend(), name) == 0);
+
+	testZLibRoundTrip(bits, size);
+
+	FreeImage_Unload(dib);
+}